@@ -12,13 +12,15 @@ def buildShaders():
 
 	# For each file in the current directory
 	for filename in os.listdir('.'):
-		if filename.endswith(".frag") or filename.endswith(".vert"):
+		if filename.endswith(".frag") or filename.endswith(".vert") or filename.endswith(".comp"):
 			outFileName = Path(filename).stem;
 
 			if filename.endswith(".frag"):
 				outFileName += "_frag";
 			elif filename.endswith(".vert"):
 				outFileName += "_vert";
+			elif filename.endswith(".comp"):
+				outFileName += "_comp";
 
 			outFileName += ".spv"
 			# Find the name that we should output to
@@ -24,7 +24,11 @@ layout (binding = 6) uniform LightingData
     uint PointLightCount;
 
 	DirLight DirLights[8];  // see @GeometrySubpass.h for the defintions of this
-    PointLight PointLights[128];
+
+    // Tiles across, tiles down and depth slices of the light clusters
+    uvec4 ClusterCounts;
+    // Scale and bias of log(depth) that gives the depth slice
+    vec4 ClusterParams;
 } lights;
 
 // Camera info UBO that we will use for PBR
@@ -37,6 +41,18 @@ layout (binding = 7) uniform UBO
     float exposure;
 } ubo;
 
+// Every point light in the scene
+layout (std430, binding = 8) readonly buffer PointLightData
+{
+    PointLight PointLights[];
+} pointLights;
+
+// An offset and count per cluster, followed by the light indices that they point to. See @LightClusterGrid.h
+layout (std430, binding = 9) readonly buffer ClusterData
+{
+    uint Data[];
+} clusters;
+
 void main() 
 {
 	// Get G-Buffer values
@@ -69,18 +85,30 @@ void main()
     }
 
 	// Point lights -------------------------
-    for(uint i = 0; i < lights.PointLightCount; i++)
+    // Find the cluster of this pixel from its screen tile and the depth slice of its view space depth
+    float viewDepth = max(-(ubo.modelview * vec4(fragPos, 1.0)).z, 0.0001);
+    uint slice = min(uint(max(log(viewDepth) * lights.ClusterParams.x + lights.ClusterParams.y, 0.0)), lights.ClusterCounts.z - 1);
+    uint tileX = min(uint(inUV.x * float(lights.ClusterCounts.x)), lights.ClusterCounts.x - 1);
+    uint tileY = min(uint(inUV.y * float(lights.ClusterCounts.y)), lights.ClusterCounts.y - 1);
+    uint cluster = (slice * lights.ClusterCounts.y + tileY) * lights.ClusterCounts.x + tileX;
+
+    uint clusterOffset = clusters.Data[cluster * 2];
+    uint clusterCount = clusters.Data[cluster * 2 + 1];
+
+    for(uint i = 0; i < clusterCount; i++)
     {
+        uint lightIndex = clusters.Data[clusterOffset + i];
+
         // Vector to light
-		vec3 L = lights.PointLights[i].Pos.xyz - fragPos;
+		vec3 L = pointLights.PointLights[lightIndex].Pos.xyz - fragPos;
 		// Distance from light to fragment position
 		float dist = length(L);
 
         // Only calculate lights that are in the range of this light
-        if(dist < lights.PointLights[i].Range)
+        if(dist < pointLights.PointLights[lightIndex].Range)
         {
             LightColor += CalculatePointLight( 
-                lights.PointLights[ i ], 
+                pointLights.PointLights[ lightIndex ], 
                 normal, 
                 fragPos,
                 ubo.camPos.xyz, 
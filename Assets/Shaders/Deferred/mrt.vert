@@ -7,12 +7,13 @@ layout(location = 2) in vec3 inTangent;
 layout(location = 3) in vec3 inNormal;
 layout(location = 4) in vec2 inUV;
 
+// Instance bindings, see InstanceData in @Vertex.h. A mat4 takes locations 5 - 8
+layout(location = 5) in mat4 inModel;
+
 layout (binding = 0) uniform UBO 
 {
 	mat4 projection;
-	mat4 model;
 	mat4 view;
-	vec3 objPos;
 } ubo;
 
 layout (location = 0) out vec3 outNormal;
@@ -35,9 +36,9 @@ void main()
 	// Currently just vertex color
 	outColor = inColor;
 	
-	outWorldPos = (ubo.model * vec4(inPos, 1.0)).rgb;
-	outNormal = mat3(ubo.model) * normalize(inNormal);
+	outWorldPos = (inModel * vec4(inPos, 1.0)).rgb;
+	outNormal = mat3(inModel) * normalize(inNormal);
 
 	gl_Position =  ubo.projection * ubo.view * vec4(outWorldPos, 1.0);
-	outTangent = normalize( inTangent * mat3(ubo.model) );
+	outTangent = normalize( inTangent * mat3(inModel) );
 }
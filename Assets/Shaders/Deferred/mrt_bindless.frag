@@ -0,0 +1,58 @@
+#version 450
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Every texture that is loaded, see BindlessTextures
+layout (set = 1, binding = 0) uniform sampler2D textures[];
+
+// Texture slots of each material: x color, y normal, z metal, w roughness
+layout (std430, binding = 1) readonly buffer Materials
+{
+	uvec4 Textures[];
+} materials;
+
+// Inputs from the mrt vert shader
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inColor;
+layout (location = 3) in vec3 inWorldPos;
+layout (location = 4) in vec3 inTangent;
+layout (location = 5) flat in uint inMaterial;
+
+// Outputs set as the frame buffer
+layout (location = 0) out vec4 outPosition;
+layout (location = 1) out vec4 outNormal;
+layout (location = 2) out vec4 outAlbedo;
+layout (location = 3) out vec4 outMetal;
+layout (location = 4) out vec4 outRoughness;
+
+// Perturb normal, see http://www.thetenthplanet.de/archives/1180
+vec3 perturbNormal()
+{
+	vec3 tangentNormal = texture(textures[nonuniformEXT(materials.Textures[inMaterial].y)], inUV).xyz * 2.0 - 1.0;
+
+	vec3 q1 = dFdx(inWorldPos);
+	vec3 q2 = dFdy(inWorldPos);
+	vec2 st1 = dFdx(inUV);
+	vec2 st2 = dFdy(inUV);
+
+	vec3 N = normalize(inNormal);
+	vec3 T = normalize(q1 * st2.t - q2 * st1.t);
+	vec3 B = -normalize(cross(N, T));
+	mat3 TBN = mat3(T, B, N);
+
+	return normalize(TBN * tangentNormal);
+}
+
+void main() 
+{
+	// Use the perturbed normal for our calculations 
+	vec3 N = normalize(inNormal);
+	outNormal = vec4(perturbNormal(), 1.0);
+
+	outPosition = vec4(inWorldPos, 1.0);
+	outAlbedo = texture(textures[nonuniformEXT(materials.Textures[inMaterial].x)], inUV);
+
+	outMetal = texture(textures[nonuniformEXT(materials.Textures[inMaterial].z)], inUV);
+	outRoughness = texture(textures[nonuniformEXT(materials.Textures[inMaterial].w)], inUV);
+}
\ No newline at end of file
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Bounds.h"
+
+#include <vector>
+
+namespace Fling
+{
+	/**
+	* @brief	A dynamic bounding volume hierarchy of boxes. Leaves are inserted next to the sibling
+	*			that adds the least surface area to the tree and every node on the path back to the
+	*			root is refit and rotated if that makes it smaller.
+	*
+	*			Each leaf keeps a "fat" box that is a little bigger than the box it was given, so
+	*			objects that only move a small amount just update their box instead of being reinserted.
+	*/
+	class AABBTree
+	{
+	public:
+
+		static const int32 NULL_NODE = -1;
+
+		/** A leaf that a ray passes through and how far along the ray it is entered */
+		struct RayHit
+		{
+			uint32 UserData = 0;
+			float Distance = 0.0f;
+		};
+
+		/** @param t_FatMargin	How much bigger than their box the fat box of each leaf is on every side */
+		explicit AABBTree(float t_FatMargin = 0.1f);
+
+		/** Add a box to the tree. Returns the proxy id that is used to move or remove it */
+		int32 CreateProxy(const AABB& t_Box, uint32 t_UserData);
+
+		void DestroyProxy(int32 t_Proxy);
+
+		/**
+		* @brief	Update the box of a proxy. It is only reinserted if the box leaves its fat box or
+		*			has shrunk well inside of it
+		* @return	True if the proxy was reinserted
+		*/
+		bool MoveProxy(int32 t_Proxy, const AABB& t_Box);
+
+		/** Remove every proxy, keeping the memory */
+		void Clear();
+
+		FORCEINLINE uint32 GetUserData(int32 t_Proxy) const { return m_Nodes[t_Proxy].UserData; }
+
+		/** The box that was given to the proxy the last time it was created or moved */
+		FORCEINLINE const AABB& GetBox(int32 t_Proxy) const { return m_Nodes[t_Proxy].Tight; }
+
+		FORCEINLINE const AABB& GetFatBox(int32 t_Proxy) const { return m_Nodes[t_Proxy].Box; }
+
+		FORCEINLINE uint32 GetProxyCount() const { return m_ProxyCount; }
+
+		/** Height of the root, a tree with only one leaf has a height of 0 */
+		FORCEINLINE int32 GetHeight() const { return m_Root == NULL_NODE ? 0 : m_Nodes[m_Root].Height; }
+
+		/** Append the user data of every proxy whose box is at least partly inside of the frustum */
+		void QueryFrustum(const Frustum& t_Frustum, std::vector<uint32>& t_OutUserData) const;
+
+		/** Append the user data of every proxy whose box overlaps t_Box */
+		void QueryAABB(const AABB& t_Box, std::vector<uint32>& t_OutUserData) const;
+
+		/** Append the user data of every proxy whose box is at least partly within t_Radius of t_Center */
+		void QuerySphere(const glm::vec3& t_Center, float t_Radius, std::vector<uint32>& t_OutUserData) const;
+
+		/**
+		* @brief	Append every proxy whose box is hit by a ray, closest first
+		* @param t_Direction	Does not need to be normalized, distances are in world units
+		* @param t_MaxDistance	Boxes that are entered further along the ray than this are ignored
+		*/
+		void RayCast(const glm::vec3& t_Origin, const glm::vec3& t_Direction, float t_MaxDistance, std::vector<RayHit>& t_OutHits) const;
+
+		/** Check the links, heights and boxes of every node. Used by the tests */
+		bool Validate() const;
+
+	private:
+
+		struct Node
+		{
+			/** The fat box of a leaf, or the union of both children */
+			AABB Box;
+
+			/** The box that was given to a leaf */
+			AABB Tight;
+
+			/** Parent of this node, or the next free node while this is on the free list */
+			int32 Parent = NULL_NODE;
+			int32 Child1 = NULL_NODE;
+			int32 Child2 = NULL_NODE;
+
+			/** 0 for leaves, -1 while free */
+			int32 Height = -1;
+
+			uint32 UserData = 0;
+
+			FORCEINLINE bool IsLeaf() const { return Child1 == NULL_NODE; }
+		};
+
+		int32 AllocateNode();
+
+		void FreeNode(int32 t_Node);
+
+		void InsertLeaf(int32 t_Leaf);
+
+		void RemoveLeaf(int32 t_Leaf);
+
+		/** Branch and bound search for the node that adds the least area when t_Box is put next to it */
+		int32 FindBestSibling(const AABB& t_Box) const;
+
+		/** Refit the boxes and heights from t_Node up to the root, rotating each node on the way */
+		void Refit(int32 t_Node);
+
+		/** Swap a child of t_Node with a grandchild if it lowers the area of the node that changes */
+		void Rotate(int32 t_Node);
+
+		/** Append the user data of every leaf under t_Node without testing them */
+		void AddSubtree(int32 t_Node, std::vector<uint32>& t_OutUserData) const;
+
+		static FORCEINLINE AABB Union(const AABB& A, const AABB& B)
+		{
+			return AABB { glm::min(A.Min, B.Min), glm::max(A.Max, B.Max) };
+		}
+
+		static FORCEINLINE float Area(const AABB& t_Box)
+		{
+			const glm::vec3 Size = t_Box.Max - t_Box.Min;
+			return 2.0f * (Size.x * Size.y + Size.y * Size.z + Size.z * Size.x);
+		}
+
+		static FORCEINLINE bool Contains(const AABB& t_Outer, const AABB& t_Inner)
+		{
+			return glm::all(glm::lessThanEqual(t_Outer.Min, t_Inner.Min)) && glm::all(glm::greaterThanEqual(t_Outer.Max, t_Inner.Max));
+		}
+
+		static FORCEINLINE bool Overlaps(const AABB& A, const AABB& B)
+		{
+			return glm::all(glm::lessThanEqual(A.Min, B.Max)) && glm::all(glm::greaterThanEqual(A.Max, B.Min));
+		}
+
+		std::vector<Node> m_Nodes;
+
+		int32 m_Root = NULL_NODE;
+		int32 m_FreeList = NULL_NODE;
+		uint32 m_ProxyCount = 0;
+
+		float m_FatMargin = 0.1f;
+	};
+}   // namespace Fling
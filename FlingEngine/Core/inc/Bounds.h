@@ -0,0 +1,60 @@
+#pragma once
+
+#include "FlingMath.h"
+#include "FlingTypes.h"
+
+namespace Fling
+{
+	/** Axis aligned bounding box */
+	struct AABB
+	{
+		glm::vec3 Min { 0.0f };
+		glm::vec3 Max { 0.0f };
+
+		FORCEINLINE glm::vec3 GetCenter() const { return (Min + Max) * 0.5f; }
+
+		/** Half of the size of the box on each axis */
+		FORCEINLINE glm::vec3 GetExtents() const { return (Max - Min) * 0.5f; }
+
+		/** Box around this one after it has been transformed by t_Mat. Rotated boxes get bigger to stay axis aligned */
+		AABB Transform(const glm::mat4& t_Mat) const;
+	};
+
+	struct BoundingSphere
+	{
+		glm::vec3 Center { 0.0f };
+		float Radius = 0.0f;
+
+		/** Sphere around this one after it has been transformed by t_Mat. Non uniform scales use the largest axis */
+		BoundingSphere Transform(const glm::mat4& t_Mat) const;
+	};
+
+	/**
+	* @brief	The six planes of a camera's view volume. Each plane is normalized and its
+	*			normal (xyz) points into the frustum, so a point p is inside of it if
+	*			dot(Plane.xyz, p) + Plane.w >= 0
+	*/
+	struct Frustum
+	{
+		enum Side
+		{
+			Left,
+			Right,
+			Bottom,
+			Top,
+			Near,
+			Far,
+			Count
+		};
+
+		glm::vec4 Planes[Side::Count] = {};
+
+		/** Extract the planes of a projection * view matrix with a [0, 1] depth range */
+		static Frustum FromViewProjection(const glm::mat4& t_ViewProj);
+
+		/** True if any part of the box may be inside of the frustum. Boxes near the corners can be false positives */
+		bool Intersects(const AABB& t_Box) const;
+
+		bool Intersects(const BoundingSphere& t_Sphere) const;
+	};
+}   // namespace Fling
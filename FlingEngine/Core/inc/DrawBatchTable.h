@@ -0,0 +1,74 @@
+#pragma once
+
+#include "FlingTypes.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace Fling
+{
+	/**
+	* @brief	Groups objects that are drawn with the same model and material into batches for indirect
+	*			draws, where the GPU decides how many instances of each batch are drawn. Every batch owns
+	*			a contiguous range of instances with room for all of its objects, so a culling shader can
+	*			write the visible ones without knowing about any other batch.
+	*
+	*			Batches are sorted by material and then model, the same order as a DrawKey, so that
+	*			neighbouring batches share as many bindings as they can.
+	*/
+	class DrawBatchTable
+	{
+	public:
+
+		struct Batch
+		{
+			uint32 Model = 0;
+			uint32 Material = 0;
+
+			/** Objects in this batch, which is the most instances that it can draw */
+			uint32 ObjectCount = 0;
+
+			/** Index of this batch's first instance. The instances of the batches before it come first */
+			uint32 FirstInstance = 0;
+		};
+
+		/** Batch of an object that isn't drawn */
+		static constexpr uint32 INVALID_BATCH = ~0u;
+
+		/** Remove every object and batch, keeping the memory */
+		void Clear();
+
+		/** Add an object that is drawn with these IDs. Its index is the number of objects before it */
+		void Add(uint32 t_Model, uint32 t_Material);
+
+		/** Add an object that is not drawn, so that the indices of the objects after it still line up */
+		void AddEmpty();
+
+		/** Sort the batches and give each one its range of instances. Call after the last Add */
+		void Build();
+
+		FORCEINLINE uint32 GetObjectCount() const { return static_cast<uint32>(m_ObjectBatches.size()); }
+
+		/** Index into GetBatches of an object's batch, or INVALID_BATCH. Only valid after Build */
+		FORCEINLINE uint32 GetObjectBatch(uint32 t_Object) const { return m_ObjectBatches[t_Object]; }
+
+		FORCEINLINE const std::vector<Batch>& GetBatches() const { return m_Batches; }
+
+		/** Instances that every batch has room for together */
+		FORCEINLINE uint32 GetInstanceCount() const { return m_InstanceCount; }
+
+	private:
+
+		std::vector<Batch> m_Batches;
+
+		std::vector<uint32> m_ObjectBatches;
+
+		/** Unsorted index of each batch by its material and model */
+		std::unordered_map<uint64, uint32> m_BatchIds;
+
+		/** Sorted index of each unsorted batch */
+		std::vector<uint32> m_SortedIndices;
+
+		uint32 m_InstanceCount = 0;
+	};
+}   // namespace Fling
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Bounds.h"
+
+#include <vector>
+
+namespace Fling
+{
+	/**
+	* @brief	A list of world space boxes that are tested against a frustum 8 at a time with AVX,
+	*			or 4 at a time with SSE if AVX isn't enabled for this build. The boxes are stored as
+	*			a structure of arrays of their centers and extents, padded to a multiple of 8.
+	*/
+	class FrustumCuller
+	{
+	public:
+
+		/** Boxes that are tested together, the arrays are always padded to a multiple of this */
+		static const uint32 BATCH_SIZE = 8;
+
+		/** Remove every box, keeping the memory */
+		void Clear();
+
+		/** Transform a box by its world matrix and add it to the list. Its index is the number of boxes before it */
+		void Add(const AABB& t_LocalBox, const glm::mat4& t_World);
+
+		FORCEINLINE uint32 GetCount() const { return m_Count; }
+
+		/**
+		* @brief	Test every box against the frustum
+		* @param t_OutVisible	Gets the index of every box that is at least partly inside. Must have room for GetCount() indices
+		* @return	Number of visible boxes
+		*/
+		uint32 Cull(const Frustum& t_Frustum, uint32* t_OutVisible) const;
+
+	private:
+
+		std::vector<float> m_CenterX;
+		std::vector<float> m_CenterY;
+		std::vector<float> m_CenterZ;
+
+		std::vector<float> m_ExtentX;
+		std::vector<float> m_ExtentY;
+		std::vector<float> m_ExtentZ;
+
+		uint32 m_Count = 0;
+	};
+}   // namespace Fling
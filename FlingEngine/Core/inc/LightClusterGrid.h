@@ -0,0 +1,100 @@
+#pragma once
+
+#include "FlingMath.h"
+#include "FlingTypes.h"
+
+#include <vector>
+
+namespace Fling
+{
+	/**
+	* @brief	Splits the view frustum into clusters, tiles across the screen and exponential slices in depth,
+	*			and finds the point lights that touch each one. The lighting pass then only loops over the
+	*			lights in the cluster of each pixel instead of every light in the scene.
+	*
+	*			Lights are binned into the depth slices that they cover, then each slice is built on its own
+	*			job, testing its clusters against 8 lights at a time with AVX, or 4 with SSE.
+	*
+	*			Tile rows go from the top of the screen down, the same way as texture coordinates, and
+	*			a cluster's index is (Slice * CountY + TileY) * CountX + TileX.
+	*/
+	class LightClusterGrid
+	{
+	public:
+
+		LightClusterGrid(uint32 t_CountX = 16, uint32 t_CountY = 9, uint32 t_CountZ = 24);
+
+		/**
+		* @brief	Find the lights that touch each cluster. Blocks until every slice is done
+		* @param t_View			World to view matrix of the camera
+		* @param t_Projection	Symmetric perspective projection of the camera, before the Y flip for Vulkan
+		* @param t_Lights		World position of each light in xyz and its range in w
+		*/
+		void Build(const glm::mat4& t_View, const glm::mat4& t_Projection, float t_Near, float t_Far, const glm::vec4* t_Lights, uint32 t_LightCount);
+
+		/**
+		* @brief	An offset and a count for each cluster, followed by the light indices that the offsets point to.
+		*			Offsets are from the start of the array. This is what gets copied to the GPU
+		*/
+		FORCEINLINE const std::vector<uint32>& GetData() const { return m_Data; }
+
+		/** Slice of a depth in front of the camera, the same way that the lighting shader finds it */
+		uint32 GetSlice(float t_Depth) const;
+
+		FORCEINLINE uint32 GetClusterIndex(uint32 t_TileX, uint32 t_TileY, uint32 t_Slice) const { return (t_Slice * m_CountY + t_TileY) * m_CountX + t_TileX; }
+
+		FORCEINLINE uint32 GetClusterCount() const { return m_CountX * m_CountY * m_CountZ; }
+
+		FORCEINLINE uint32 GetLightCount(uint32 t_Cluster) const { return m_Data[t_Cluster * 2 + 1]; }
+
+		FORCEINLINE const uint32* GetLights(uint32 t_Cluster) const { return m_Data.data() + m_Data[t_Cluster * 2]; }
+
+		/** Tiles across, tiles down, and depth slices */
+		FORCEINLINE glm::uvec3 GetCounts() const { return glm::uvec3(m_CountX, m_CountY, m_CountZ); }
+
+		/** log(depth) * scale + bias is the slice of a depth */
+		FORCEINLINE float GetSliceScale() const { return m_SliceScale; }
+		FORCEINLINE float GetSliceBias() const { return m_SliceBias; }
+
+	private:
+
+		/** Lights that touch one depth slice in view space, one array per component */
+		struct Slice
+		{
+			std::vector<float> X;
+			std::vector<float> Y;
+			std::vector<float> Depth;
+			std::vector<float> RadiusSq;
+			std::vector<uint32> Index;
+
+			/** Light indices of each cluster in the slice, in cluster order */
+			std::vector<uint32> ClusterLights;
+		};
+
+		/** Test every cluster of a slice against the lights that were binned into it */
+		void BuildSlice(uint32 t_Slice);
+
+		/** Distance in front of the camera where a slice starts */
+		float GetSliceDepth(uint32 t_Slice) const;
+
+		std::vector<Slice> m_Slices;
+
+		/** Lights in each cluster, written by the job of its slice */
+		std::vector<uint32> m_ClusterCounts;
+
+		std::vector<uint32> m_Data;
+
+		uint32 m_CountX = 0;
+		uint32 m_CountY = 0;
+		uint32 m_CountZ = 0;
+
+		float m_Near = 0.1f;
+		float m_Far = 1000.0f;
+		float m_SliceScale = 0.0f;
+		float m_SliceBias = 0.0f;
+
+		/** Scale from view space to NDC at a depth of 1, from the projection */
+		float m_ProjX = 1.0f;
+		float m_ProjY = 1.0f;
+	};
+}   // namespace Fling
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Bounds.h"
+
+#include <vector>
+
+namespace Fling
+{
+	/** Low poly triangles that hide whatever is behind them. @see Material::GetOccluder */
+	struct OccluderMesh
+	{
+		std::vector<glm::vec3> Positions;
+		std::vector<uint32> Indices;
+
+		FORCEINLINE bool IsEmpty() const { return Indices.empty(); }
+	};
+
+	/**
+	* @brief	A small CPU depth buffer that occluders are rasterized into so that meshes hidden
+	*			behind them can be skipped before any draws are recorded. Rows are rasterized 8 pixels
+	*			at a time with AVX, or 4 with SSE, and bands of tiles are split across the JobSystem.
+	*
+	*			Each tile keeps the furthest depth of its pixels. A box is tested against the tiles it
+	*			covers first and only looks at single pixels of tiles that can't reject it. Depth is
+	*			[0, 1] with 1 being the far plane, like the projection matrices of the engine.
+	*/
+	class OcclusionBuffer
+	{
+	public:
+
+		static const uint32 TILE_WIDTH = 8;
+		static const uint32 TILE_HEIGHT = 4;
+
+		/** The width and height are rounded up to a multiple of the tile size */
+		explicit OcclusionBuffer(uint32 t_Width = 512, uint32 t_Height = 256);
+
+		/** Clear the depth and drop the occluders of the last frame */
+		void Begin(const glm::mat4& t_ViewProj);
+
+		/**
+		* @brief	Project an occluder's triangles to the screen. Triangles that cross the near plane
+		*			are skipped, which only makes the buffer less likely to hide anything
+		*/
+		void AddOccluder(const OccluderMesh& t_Mesh, const glm::mat4& t_World);
+
+		/** Rasterize every occluder that was added since Begin. Blocks until all of the bands are done */
+		void Rasterize();
+
+		/** False if every pixel that the box covers has an occluder in front of it. Safe from any thread after Rasterize */
+		bool IsVisible(const AABB& t_WorldBox) const;
+
+		FORCEINLINE uint32 GetWidth() const { return m_Width; }
+		FORCEINLINE uint32 GetHeight() const { return m_Height; }
+
+		FORCEINLINE uint32 GetTriangleCount() const { return static_cast<uint32>(m_Triangles.size()); }
+
+		FORCEINLINE float GetDepth(uint32 t_X, uint32 t_Y) const { return m_Depth[t_Y * m_Width + t_X]; }
+
+	private:
+
+		/** A triangle in pixels, wound so that its area is positive */
+		struct ScreenTriangle
+		{
+			float X[3];
+			float Y[3];
+			float Z[3];
+		};
+
+		/** Rasterize the triangles that touch the rows of these tiles and find the furthest depth of each tile */
+		void RasterizeTileRows(uint32 t_FirstTileRow, uint32 t_EndTileRow);
+
+		void RasterizeTriangle(const ScreenTriangle& t_Tri, uint32 t_FirstRow, uint32 t_EndRow);
+
+		/** Projects a world position, false if it is behind the near plane */
+		bool ProjectToScreen(const glm::vec4& t_Clip, glm::vec3& t_OutScreen) const;
+
+		std::vector<float> m_Depth;
+
+		/** Furthest depth in each tile */
+		std::vector<float> m_TileMaxDepth;
+
+		std::vector<ScreenTriangle> m_Triangles;
+
+		/** Screen positions of the vertices of the occluder being added, and if they are in front of the near plane */
+		std::vector<glm::vec3> m_ProjectedVerts;
+		std::vector<uint8> m_ProjectedValid;
+
+		glm::mat4 m_ViewProj { 1.0f };
+
+		uint32 m_Width = 0;
+		uint32 m_Height = 0;
+		uint32 m_TilesX = 0;
+		uint32 m_TilesY = 0;
+	};
+}   // namespace Fling
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "FlingMath.h"
+#include "FlingTypes.h"
+
+namespace Fling
+{
+	/**
+	* @brief	Builds world matrices for a block of up to WIDTH transforms at once. Positions, rotations and
+	*			scales are gathered into one array per component so that every lane of a register is a
+	*			different transform, which lets the whole block be composed with AVX (8 wide) or SSE (4 wide).
+	*			Rotations are quaternions, so nothing in here needs any trigonometry.
+	*
+	*			Each thread keeps its own batch on the stack, @see Transform::CalculateWorldMatrices
+	*/
+	struct TransformBatch
+	{
+		static const uint32 WIDTH = 8;
+
+		/** Add a transform to the block. @return True if the block is full and has to be flushed */
+		FORCEINLINE bool Add(const glm::vec3& t_Pos, const glm::quat& t_Rot, const glm::vec3& t_Scale, glm::mat4* t_OutWorld)
+		{
+			PosX[Count] = t_Pos.x;
+			PosY[Count] = t_Pos.y;
+			PosZ[Count] = t_Pos.z;
+			RotX[Count] = t_Rot.x;
+			RotY[Count] = t_Rot.y;
+			RotZ[Count] = t_Rot.z;
+			RotW[Count] = t_Rot.w;
+			ScaleX[Count] = t_Scale.x;
+			ScaleY[Count] = t_Scale.y;
+			ScaleZ[Count] = t_Scale.z;
+			Outputs[Count] = t_OutWorld;
+			return ++Count == WIDTH;
+		}
+
+		/** Write the world matrix of every transform in the block and empty it */
+		void Flush();
+
+		/** Translation * rotation * scale, the same matrix that Flush writes */
+		static glm::mat4 Compose(const glm::vec3& t_Pos, const glm::quat& t_Rot, const glm::vec3& t_Scale);
+
+		/**
+		* @brief	Quaternion of a rotation in degrees around each axis, applied in the same order as glm::yawPitchRoll
+		*			with the yaw around Y, pitch around X, and roll around Z
+		*/
+		static glm::quat EulerToQuat(const glm::vec3& t_Degrees);
+
+		alignas(32) float PosX[WIDTH];
+		alignas(32) float PosY[WIDTH];
+		alignas(32) float PosZ[WIDTH];
+		alignas(32) float RotX[WIDTH];
+		alignas(32) float RotY[WIDTH];
+		alignas(32) float RotZ[WIDTH];
+		alignas(32) float RotW[WIDTH];
+		alignas(32) float ScaleX[WIDTH];
+		alignas(32) float ScaleY[WIDTH];
+		alignas(32) float ScaleZ[WIDTH];
+
+		glm::mat4* Outputs[WIDTH];
+
+		uint32 Count = 0;
+	};
+}   // namespace Fling
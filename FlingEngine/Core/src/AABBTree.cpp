@@ -0,0 +1,644 @@
+#include "pch.h"
+#include "AABBTree.h"
+
+#include <algorithm>
+
+namespace Fling
+{
+	namespace
+	{
+		enum class FrustumTest
+		{
+			Outside,
+			Intersects,
+			Inside
+		};
+
+		FrustumTest ClassifyBox(const Frustum& t_Frustum, const AABB& t_Box)
+		{
+			const glm::vec3 Center = t_Box.GetCenter();
+			const glm::vec3 Extents = t_Box.GetExtents();
+
+			FrustumTest Result = FrustumTest::Inside;
+			for (const glm::vec4& Plane : t_Frustum.Planes)
+			{
+				const glm::vec3 Normal = glm::vec3(Plane);
+				const float Distance = glm::dot(Normal, Center) + Plane.w;
+				const float Radius = glm::dot(glm::abs(Normal), Extents);
+				if (Distance + Radius < 0.0f)
+				{
+					return FrustumTest::Outside;
+				}
+				if (Distance - Radius < 0.0f)
+				{
+					Result = FrustumTest::Intersects;
+				}
+			}
+			return Result;
+		}
+
+		/** Slab test. Sets t_Enter to how far along the ray the box is entered, 0 if the origin is inside of it */
+		bool RayHitsBox(const glm::vec3& t_Origin, const glm::vec3& t_InvDir, float t_MaxDistance, const AABB& t_Box, float& t_Enter)
+		{
+			const glm::vec3 T0 = (t_Box.Min - t_Origin) * t_InvDir;
+			const glm::vec3 T1 = (t_Box.Max - t_Origin) * t_InvDir;
+			const glm::vec3 Near = glm::min(T0, T1);
+			const glm::vec3 Far = glm::max(T0, T1);
+
+			const float Enter = std::max(std::max(Near.x, Near.y), std::max(Near.z, 0.0f));
+			const float Exit = std::min(std::min(Far.x, Far.y), std::min(Far.z, t_MaxDistance));
+
+			t_Enter = Enter;
+			return Enter <= Exit;
+		}
+	}
+
+	AABBTree::AABBTree(float t_FatMargin)
+		: m_FatMargin(t_FatMargin)
+	{
+	}
+
+	int32 AABBTree::CreateProxy(const AABB& t_Box, uint32 t_UserData)
+	{
+		const int32 Proxy = AllocateNode();
+		Node& Leaf = m_Nodes[Proxy];
+		Leaf.Tight = t_Box;
+		Leaf.Box = AABB { t_Box.Min - glm::vec3(m_FatMargin), t_Box.Max + glm::vec3(m_FatMargin) };
+		Leaf.UserData = t_UserData;
+		Leaf.Height = 0;
+
+		InsertLeaf(Proxy);
+		++m_ProxyCount;
+		return Proxy;
+	}
+
+	void AABBTree::DestroyProxy(int32 t_Proxy)
+	{
+		assert(t_Proxy >= 0 && t_Proxy < static_cast<int32>(m_Nodes.size()) && m_Nodes[t_Proxy].IsLeaf());
+
+		RemoveLeaf(t_Proxy);
+		FreeNode(t_Proxy);
+		--m_ProxyCount;
+	}
+
+	bool AABBTree::MoveProxy(int32 t_Proxy, const AABB& t_Box)
+	{
+		assert(t_Proxy >= 0 && t_Proxy < static_cast<int32>(m_Nodes.size()) && m_Nodes[t_Proxy].IsLeaf());
+
+		Node& Leaf = m_Nodes[t_Proxy];
+		Leaf.Tight = t_Box;
+
+		const AABB FatBox = { t_Box.Min - glm::vec3(m_FatMargin), t_Box.Max + glm::vec3(m_FatMargin) };
+
+		// Keep the old fat box unless the new box left it, or the fat box is now much too big
+		if (Contains(Leaf.Box, t_Box))
+		{
+			const AABB LooseBox = { FatBox.Min - glm::vec3(4.0f * m_FatMargin), FatBox.Max + glm::vec3(4.0f * m_FatMargin) };
+			if (Contains(LooseBox, Leaf.Box))
+			{
+				return false;
+			}
+		}
+
+		RemoveLeaf(t_Proxy);
+		m_Nodes[t_Proxy].Box = FatBox;
+		InsertLeaf(t_Proxy);
+		return true;
+	}
+
+	void AABBTree::Clear()
+	{
+		m_Nodes.clear();
+		m_Root = NULL_NODE;
+		m_FreeList = NULL_NODE;
+		m_ProxyCount = 0;
+	}
+
+	int32 AABBTree::AllocateNode()
+	{
+		if (m_FreeList == NULL_NODE)
+		{
+			m_Nodes.emplace_back();
+			return static_cast<int32>(m_Nodes.size() - 1);
+		}
+
+		const int32 Index = m_FreeList;
+		m_FreeList = m_Nodes[Index].Parent;
+		m_Nodes[Index] = Node {};
+		return Index;
+	}
+
+	void AABBTree::FreeNode(int32 t_Node)
+	{
+		Node& Freed = m_Nodes[t_Node];
+		Freed.Parent = m_FreeList;
+		Freed.Child1 = NULL_NODE;
+		Freed.Child2 = NULL_NODE;
+		Freed.Height = -1;
+		m_FreeList = t_Node;
+	}
+
+	int32 AABBTree::FindBestSibling(const AABB& t_Box) const
+	{
+		// The cost of putting the box next to a node is the area of their union, plus how much every
+		// ancestor of the node grows. The growth is inherited by the children, and a child can never
+		// cost less than the area of the new box plus what it inherited, so whole subtrees are skipped
+		struct Candidate
+		{
+			int32 Index;
+			float InheritedCost;
+		};
+
+		const float BoxArea = Area(t_Box);
+
+		int32 Best = m_Root;
+		float BestCost = Area(Union(m_Nodes[m_Root].Box, t_Box));
+
+		std::vector<Candidate> Stack;
+		Stack.reserve(64);
+		Stack.push_back({ m_Root, 0.0f });
+
+		while (!Stack.empty())
+		{
+			const Candidate Cur = Stack.back();
+			Stack.pop_back();
+
+			const Node& CurNode = m_Nodes[Cur.Index];
+			const float DirectCost = Area(Union(CurNode.Box, t_Box));
+			const float Cost = DirectCost + Cur.InheritedCost;
+			if (Cost < BestCost)
+			{
+				BestCost = Cost;
+				Best = Cur.Index;
+			}
+
+			if (CurNode.IsLeaf())
+			{
+				continue;
+			}
+
+			const float ChildInherited = Cur.InheritedCost + DirectCost - Area(CurNode.Box);
+			if (BoxArea + ChildInherited < BestCost)
+			{
+				Stack.push_back({ CurNode.Child1, ChildInherited });
+				Stack.push_back({ CurNode.Child2, ChildInherited });
+			}
+		}
+
+		return Best;
+	}
+
+	void AABBTree::InsertLeaf(int32 t_Leaf)
+	{
+		if (m_Root == NULL_NODE)
+		{
+			m_Root = t_Leaf;
+			m_Nodes[t_Leaf].Parent = NULL_NODE;
+			return;
+		}
+
+		const int32 Sibling = FindBestSibling(m_Nodes[t_Leaf].Box);
+		const int32 OldParent = m_Nodes[Sibling].Parent;
+
+		// Allocating can grow the node array, so only take references after it
+		const int32 NewParent = AllocateNode();
+		Node& Parent = m_Nodes[NewParent];
+		Parent.Parent = OldParent;
+		Parent.Box = Union(m_Nodes[Sibling].Box, m_Nodes[t_Leaf].Box);
+		Parent.Height = m_Nodes[Sibling].Height + 1;
+		Parent.Child1 = Sibling;
+		Parent.Child2 = t_Leaf;
+
+		if (OldParent != NULL_NODE)
+		{
+			Node& Grand = m_Nodes[OldParent];
+			if (Grand.Child1 == Sibling)
+			{
+				Grand.Child1 = NewParent;
+			}
+			else
+			{
+				Grand.Child2 = NewParent;
+			}
+		}
+		else
+		{
+			m_Root = NewParent;
+		}
+
+		m_Nodes[Sibling].Parent = NewParent;
+		m_Nodes[t_Leaf].Parent = NewParent;
+
+		Refit(OldParent);
+	}
+
+	void AABBTree::RemoveLeaf(int32 t_Leaf)
+	{
+		if (t_Leaf == m_Root)
+		{
+			m_Root = NULL_NODE;
+			return;
+		}
+
+		const int32 Parent = m_Nodes[t_Leaf].Parent;
+		const int32 Grand = m_Nodes[Parent].Parent;
+		const int32 Sibling = m_Nodes[Parent].Child1 == t_Leaf ? m_Nodes[Parent].Child2 : m_Nodes[Parent].Child1;
+
+		// The sibling takes the place of the parent
+		if (Grand != NULL_NODE)
+		{
+			if (m_Nodes[Grand].Child1 == Parent)
+			{
+				m_Nodes[Grand].Child1 = Sibling;
+			}
+			else
+			{
+				m_Nodes[Grand].Child2 = Sibling;
+			}
+			m_Nodes[Sibling].Parent = Grand;
+			FreeNode(Parent);
+
+			Refit(Grand);
+		}
+		else
+		{
+			m_Root = Sibling;
+			m_Nodes[Sibling].Parent = NULL_NODE;
+			FreeNode(Parent);
+		}
+
+		m_Nodes[t_Leaf].Parent = NULL_NODE;
+	}
+
+	void AABBTree::Refit(int32 t_Node)
+	{
+		int32 Index = t_Node;
+		while (Index != NULL_NODE)
+		{
+			Node& Cur = m_Nodes[Index];
+			const Node& Child1 = m_Nodes[Cur.Child1];
+			const Node& Child2 = m_Nodes[Cur.Child2];
+
+			Cur.Box = Union(Child1.Box, Child2.Box);
+			Cur.Height = 1 + std::max(Child1.Height, Child2.Height);
+
+			Rotate(Index);
+
+			Index = m_Nodes[Index].Parent;
+		}
+	}
+
+	void AABBTree::Rotate(int32 t_Node)
+	{
+		Node& A = m_Nodes[t_Node];
+		if (A.Height < 2)
+		{
+			return;
+		}
+
+		const int32 B = A.Child1;
+		const int32 C = A.Child2;
+
+		// Swapping a child with one of its sibling's children changes the box of the sibling and nothing
+		// else, so the best rotation is the one that shrinks that box the most
+		enum Rotation { None, BF, BG, CD, CE };
+		Rotation BestRotation = None;
+		float BestDelta = 0.0f;
+
+		const Node& NodeB = m_Nodes[B];
+		const Node& NodeC = m_Nodes[C];
+
+		if (!NodeC.IsLeaf())
+		{
+			const float AreaC = Area(NodeC.Box);
+
+			const float DeltaBF = Area(Union(NodeB.Box, m_Nodes[NodeC.Child2].Box)) - AreaC;
+			if (DeltaBF < BestDelta)
+			{
+				BestDelta = DeltaBF;
+				BestRotation = BF;
+			}
+
+			const float DeltaBG = Area(Union(NodeB.Box, m_Nodes[NodeC.Child1].Box)) - AreaC;
+			if (DeltaBG < BestDelta)
+			{
+				BestDelta = DeltaBG;
+				BestRotation = BG;
+			}
+		}
+
+		if (!NodeB.IsLeaf())
+		{
+			const float AreaB = Area(NodeB.Box);
+
+			const float DeltaCD = Area(Union(NodeC.Box, m_Nodes[NodeB.Child2].Box)) - AreaB;
+			if (DeltaCD < BestDelta)
+			{
+				BestDelta = DeltaCD;
+				BestRotation = CD;
+			}
+
+			const float DeltaCE = Area(Union(NodeC.Box, m_Nodes[NodeB.Child1].Box)) - AreaB;
+			if (DeltaCE < BestDelta)
+			{
+				BestDelta = DeltaCE;
+				BestRotation = CE;
+			}
+		}
+
+		// Swap t_Child of t_Node with the grandchild t_Grandchild, whose parent is t_Uncle
+		auto Swap = [this](int32 t_Parent, int32 t_Child, int32 t_Uncle, int32 t_Grandchild)
+		{
+			Node& Parent = m_Nodes[t_Parent];
+			Node& Uncle = m_Nodes[t_Uncle];
+
+			if (Parent.Child1 == t_Child)
+			{
+				Parent.Child1 = t_Grandchild;
+			}
+			else
+			{
+				Parent.Child2 = t_Grandchild;
+			}
+
+			if (Uncle.Child1 == t_Grandchild)
+			{
+				Uncle.Child1 = t_Child;
+			}
+			else
+			{
+				Uncle.Child2 = t_Child;
+			}
+
+			m_Nodes[t_Grandchild].Parent = t_Parent;
+			m_Nodes[t_Child].Parent = t_Uncle;
+
+			const Node& UncleChild1 = m_Nodes[Uncle.Child1];
+			const Node& UncleChild2 = m_Nodes[Uncle.Child2];
+			Uncle.Box = Union(UncleChild1.Box, UncleChild2.Box);
+			Uncle.Height = 1 + std::max(UncleChild1.Height, UncleChild2.Height);
+
+			Parent.Height = 1 + std::max(m_Nodes[Parent.Child1].Height, m_Nodes[Parent.Child2].Height);
+		};
+
+		switch (BestRotation)
+		{
+		case BF:
+			Swap(t_Node, B, C, NodeC.Child1);
+			break;
+		case BG:
+			Swap(t_Node, B, C, NodeC.Child2);
+			break;
+		case CD:
+			Swap(t_Node, C, B, NodeB.Child1);
+			break;
+		case CE:
+			Swap(t_Node, C, B, NodeB.Child2);
+			break;
+		case None:
+		default:
+			break;
+		}
+	}
+
+	void AABBTree::AddSubtree(int32 t_Node, std::vector<uint32>& t_OutUserData) const
+	{
+		std::vector<int32> Stack;
+		Stack.reserve(64);
+		Stack.push_back(t_Node);
+
+		while (!Stack.empty())
+		{
+			const Node& Cur = m_Nodes[Stack.back()];
+			Stack.pop_back();
+
+			if (Cur.IsLeaf())
+			{
+				t_OutUserData.push_back(Cur.UserData);
+			}
+			else
+			{
+				Stack.push_back(Cur.Child1);
+				Stack.push_back(Cur.Child2);
+			}
+		}
+	}
+
+	void AABBTree::QueryFrustum(const Frustum& t_Frustum, std::vector<uint32>& t_OutUserData) const
+	{
+		FLING_PROFILE_SCOPE("AABBTree::QueryFrustum");
+
+		if (m_Root == NULL_NODE)
+		{
+			return;
+		}
+
+		std::vector<int32> Stack;
+		Stack.reserve(64);
+		Stack.push_back(m_Root);
+
+		while (!Stack.empty())
+		{
+			const int32 Index = Stack.back();
+			Stack.pop_back();
+
+			const Node& Cur = m_Nodes[Index];
+			if (Cur.IsLeaf())
+			{
+				if (t_Frustum.Intersects(Cur.Tight))
+				{
+					t_OutUserData.push_back(Cur.UserData);
+				}
+				continue;
+			}
+
+			switch (ClassifyBox(t_Frustum, Cur.Box))
+			{
+			case FrustumTest::Inside:
+				// Every fat box is inside of its parent, and every box is inside of its fat box
+				AddSubtree(Index, t_OutUserData);
+				break;
+			case FrustumTest::Intersects:
+				Stack.push_back(Cur.Child1);
+				Stack.push_back(Cur.Child2);
+				break;
+			case FrustumTest::Outside:
+			default:
+				break;
+			}
+		}
+	}
+
+	void AABBTree::QueryAABB(const AABB& t_Box, std::vector<uint32>& t_OutUserData) const
+	{
+		if (m_Root == NULL_NODE)
+		{
+			return;
+		}
+
+		std::vector<int32> Stack;
+		Stack.reserve(64);
+		Stack.push_back(m_Root);
+
+		while (!Stack.empty())
+		{
+			const Node& Cur = m_Nodes[Stack.back()];
+			Stack.pop_back();
+
+			if (Cur.IsLeaf())
+			{
+				if (Overlaps(Cur.Tight, t_Box))
+				{
+					t_OutUserData.push_back(Cur.UserData);
+				}
+			}
+			else if (Overlaps(Cur.Box, t_Box))
+			{
+				Stack.push_back(Cur.Child1);
+				Stack.push_back(Cur.Child2);
+			}
+		}
+	}
+
+	void AABBTree::QuerySphere(const glm::vec3& t_Center, float t_Radius, std::vector<uint32>& t_OutUserData) const
+	{
+		if (m_Root == NULL_NODE)
+		{
+			return;
+		}
+
+		const float RadiusSq = t_Radius * t_Radius;
+
+		// Distance from the center to the closest point of the box
+		auto Touches = [&](const AABB& t_Box)
+		{
+			const glm::vec3 Closest = glm::clamp(t_Center, t_Box.Min, t_Box.Max);
+			const glm::vec3 Offset = Closest - t_Center;
+			return glm::dot(Offset, Offset) <= RadiusSq;
+		};
+
+		std::vector<int32> Stack;
+		Stack.reserve(64);
+		Stack.push_back(m_Root);
+
+		while (!Stack.empty())
+		{
+			const Node& Cur = m_Nodes[Stack.back()];
+			Stack.pop_back();
+
+			if (Cur.IsLeaf())
+			{
+				if (Touches(Cur.Tight))
+				{
+					t_OutUserData.push_back(Cur.UserData);
+				}
+			}
+			else if (Touches(Cur.Box))
+			{
+				Stack.push_back(Cur.Child1);
+				Stack.push_back(Cur.Child2);
+			}
+		}
+	}
+
+	void AABBTree::RayCast(const glm::vec3& t_Origin, const glm::vec3& t_Direction, float t_MaxDistance, std::vector<RayHit>& t_OutHits) const
+	{
+		const float Length = glm::length(t_Direction);
+		if (m_Root == NULL_NODE || Length <= 0.0f)
+		{
+			return;
+		}
+
+		// Division by zero gives infinities which the slab test handles
+		const glm::vec3 InvDir = 1.0f / (t_Direction / Length);
+
+		const size_t FirstHit = t_OutHits.size();
+
+		std::vector<int32> Stack;
+		Stack.reserve(64);
+		Stack.push_back(m_Root);
+
+		while (!Stack.empty())
+		{
+			const Node& Cur = m_Nodes[Stack.back()];
+			Stack.pop_back();
+
+			float Enter = 0.0f;
+			if (Cur.IsLeaf())
+			{
+				if (RayHitsBox(t_Origin, InvDir, t_MaxDistance, Cur.Tight, Enter))
+				{
+					t_OutHits.push_back({ Cur.UserData, Enter });
+				}
+			}
+			else if (RayHitsBox(t_Origin, InvDir, t_MaxDistance, Cur.Box, Enter))
+			{
+				Stack.push_back(Cur.Child1);
+				Stack.push_back(Cur.Child2);
+			}
+		}
+
+		std::sort(t_OutHits.begin() + FirstHit, t_OutHits.end(), [](const RayHit& A, const RayHit& B)
+		{
+			return A.Distance < B.Distance;
+		});
+	}
+
+	bool AABBTree::Validate() const
+	{
+		if (m_Root == NULL_NODE)
+		{
+			return m_ProxyCount == 0;
+		}
+
+		if (m_Nodes[m_Root].Parent != NULL_NODE)
+		{
+			return false;
+		}
+
+		uint32 LeafCount = 0;
+
+		std::vector<int32> Stack;
+		Stack.push_back(m_Root);
+
+		while (!Stack.empty())
+		{
+			const int32 Index = Stack.back();
+			Stack.pop_back();
+
+			const Node& Cur = m_Nodes[Index];
+			if (Cur.IsLeaf())
+			{
+				if (Cur.Height != 0 || Cur.Child2 != NULL_NODE || !Contains(Cur.Box, Cur.Tight))
+				{
+					return false;
+				}
+				++LeafCount;
+				continue;
+			}
+
+			const Node& Child1 = m_Nodes[Cur.Child1];
+			const Node& Child2 = m_Nodes[Cur.Child2];
+
+			if (Child1.Parent != Index || Child2.Parent != Index)
+			{
+				return false;
+			}
+
+			if (Cur.Height != 1 + std::max(Child1.Height, Child2.Height))
+			{
+				return false;
+			}
+
+			if (!Contains(Cur.Box, Child1.Box) || !Contains(Cur.Box, Child2.Box))
+			{
+				return false;
+			}
+
+			Stack.push_back(Cur.Child1);
+			Stack.push_back(Cur.Child2);
+		}
+
+		return LeafCount == m_ProxyCount;
+	}
+}   // namespace Fling
@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "Bounds.h"
+
+namespace Fling
+{
+	AABB AABB::Transform(const glm::mat4& t_Mat) const
+	{
+		// Transform the center, and project the extents onto each world axis with the absolute rotation and scale
+		const glm::vec3 Center = glm::vec3(t_Mat * glm::vec4(GetCenter(), 1.0f));
+		const glm::vec3 Extents = GetExtents();
+
+		glm::vec3 WorldExtents;
+		for (int Axis = 0; Axis < 3; ++Axis)
+		{
+			WorldExtents[Axis] =
+				glm::abs(t_Mat[0][Axis]) * Extents.x +
+				glm::abs(t_Mat[1][Axis]) * Extents.y +
+				glm::abs(t_Mat[2][Axis]) * Extents.z;
+		}
+
+		return AABB { Center - WorldExtents, Center + WorldExtents };
+	}
+
+	BoundingSphere BoundingSphere::Transform(const glm::mat4& t_Mat) const
+	{
+		const float MaxScale = glm::sqrt(glm::max(
+			glm::dot(glm::vec3(t_Mat[0]), glm::vec3(t_Mat[0])),
+			glm::max(glm::dot(glm::vec3(t_Mat[1]), glm::vec3(t_Mat[1])), glm::dot(glm::vec3(t_Mat[2]), glm::vec3(t_Mat[2])))));
+
+		return BoundingSphere { glm::vec3(t_Mat * glm::vec4(Center, 1.0f)), Radius * MaxScale };
+	}
+
+	Frustum Frustum::FromViewProjection(const glm::mat4& t_ViewProj)
+	{
+		// Gribb/Hartmann plane extraction, with the rows of the matrix. Depth is [0, 1] so near is just the third row
+		const glm::vec4 Row0 = glm::vec4(t_ViewProj[0][0], t_ViewProj[1][0], t_ViewProj[2][0], t_ViewProj[3][0]);
+		const glm::vec4 Row1 = glm::vec4(t_ViewProj[0][1], t_ViewProj[1][1], t_ViewProj[2][1], t_ViewProj[3][1]);
+		const glm::vec4 Row2 = glm::vec4(t_ViewProj[0][2], t_ViewProj[1][2], t_ViewProj[2][2], t_ViewProj[3][2]);
+		const glm::vec4 Row3 = glm::vec4(t_ViewProj[0][3], t_ViewProj[1][3], t_ViewProj[2][3], t_ViewProj[3][3]);
+
+		Frustum Result = {};
+		Result.Planes[Left] = Row3 + Row0;
+		Result.Planes[Right] = Row3 - Row0;
+		Result.Planes[Bottom] = Row3 + Row1;
+		Result.Planes[Top] = Row3 - Row1;
+		Result.Planes[Near] = Row2;
+		Result.Planes[Far] = Row3 - Row2;
+
+		for (glm::vec4& Plane : Result.Planes)
+		{
+			const float Length = glm::length(glm::vec3(Plane));
+			if (Length > 0.0f)
+			{
+				Plane /= Length;
+			}
+		}
+
+		return Result;
+	}
+
+	bool Frustum::Intersects(const AABB& t_Box) const
+	{
+		const glm::vec3 Center = t_Box.GetCenter();
+		const glm::vec3 Extents = t_Box.GetExtents();
+
+		for (const glm::vec4& Plane : Planes)
+		{
+			const glm::vec3 Normal = glm::vec3(Plane);
+			const float Distance = glm::dot(Normal, Center) + Plane.w;
+			const float Radius = glm::dot(glm::abs(Normal), Extents);
+			if (Distance + Radius < 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Frustum::Intersects(const BoundingSphere& t_Sphere) const
+	{
+		for (const glm::vec4& Plane : Planes)
+		{
+			if (glm::dot(glm::vec3(Plane), t_Sphere.Center) + Plane.w < -t_Sphere.Radius)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}   // namespace Fling
@@ -0,0 +1,79 @@
+#include "pch.h"
+#include "DrawBatchTable.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace Fling
+{
+	void DrawBatchTable::Clear()
+	{
+		m_Batches.clear();
+		m_ObjectBatches.clear();
+		m_BatchIds.clear();
+		m_InstanceCount = 0;
+	}
+
+	void DrawBatchTable::Add(uint32 t_Model, uint32 t_Material)
+	{
+		const uint64 Key = (static_cast<uint64>(t_Material) << 32) | t_Model;
+
+		auto It = m_BatchIds.find(Key);
+		if (It == m_BatchIds.end())
+		{
+			It = m_BatchIds.emplace(Key, static_cast<uint32>(m_Batches.size())).first;
+
+			Batch& New = m_Batches.emplace_back();
+			New.Model = t_Model;
+			New.Material = t_Material;
+		}
+
+		++m_Batches[It->second].ObjectCount;
+		m_ObjectBatches.emplace_back(It->second);
+	}
+
+	void DrawBatchTable::AddEmpty()
+	{
+		m_ObjectBatches.emplace_back(INVALID_BATCH);
+	}
+
+	void DrawBatchTable::Build()
+	{
+		const uint32 BatchCount = static_cast<uint32>(m_Batches.size());
+
+		// Objects point at the unsorted batches until they are remapped at the end
+		std::vector<uint32> Order(BatchCount);
+		std::iota(Order.begin(), Order.end(), 0u);
+		std::sort(Order.begin(), Order.end(), [this](uint32 t_A, uint32 t_B)
+		{
+			const Batch& A = m_Batches[t_A];
+			const Batch& B = m_Batches[t_B];
+			return A.Material != B.Material ? A.Material < B.Material : A.Model < B.Model;
+		});
+
+		std::vector<Batch> Sorted(BatchCount);
+		m_SortedIndices.resize(BatchCount);
+		m_InstanceCount = 0;
+		for (uint32 i = 0; i < BatchCount; ++i)
+		{
+			Sorted[i] = m_Batches[Order[i]];
+			Sorted[i].FirstInstance = m_InstanceCount;
+			m_InstanceCount += Sorted[i].ObjectCount;
+			m_SortedIndices[Order[i]] = i;
+		}
+		m_Batches.swap(Sorted);
+
+		for (uint32& ObjectBatch : m_ObjectBatches)
+		{
+			if (ObjectBatch != INVALID_BATCH)
+			{
+				ObjectBatch = m_SortedIndices[ObjectBatch];
+			}
+		}
+
+		for (auto& Pair : m_BatchIds)
+		{
+			Pair.second = m_SortedIndices[Pair.second];
+		}
+	}
+}   // namespace Fling
@@ -5,6 +5,8 @@
 #include "VulkanApp.h"
 #include "Misc/CommandLine.h"
 #include "Foundation.h"
+#include "Texture.h"
+#include "Model.h"
 
 namespace Fling
 {
@@ -12,6 +14,7 @@ namespace Fling
 	{	
 		Random::Init();
 		Logger::Get().Init();
+		FLING_PROFILE_THREAD("Main");
 		
 		CommandLine::Set(CommandLine::BuildFromArgs(argc, argv));
 		F_LOG_TRACE("Command line args: {}\t", CommandLine::Get());
@@ -38,6 +41,20 @@ namespace Fling
 			F_LOG_WARN("NO EngineConf.ini has been provided! This may result in unexpected behavior from Fling!");
 		}
 
+		// Unreferenced resources are unloaded once they go over these, 0 means no limit
+		const uint64 ToBytes = 1024 * 1024;
+		ResourceManager::Get().SetMemoryBudget(
+			static_cast<uint64>(std::max(FlingConfig::GetInt("Engine", "ResourceCpuBudgetMB", 0), 0)) * ToBytes,
+			static_cast<uint64>(std::max(FlingConfig::GetInt("Engine", "ResourceGpuBudgetMB", 0), 0)) * ToBytes);
+
+		Texture::SetCpuDataPolicy(FlingConfig::GetBool("Engine", "KeepTexturePixels", false) ? CpuDataPolicy::Keep : CpuDataPolicy::Release);
+		Model::SetCpuDataPolicy(FlingConfig::GetBool("Engine", "KeepModelVertices", false) ? CpuDataPolicy::Keep : CpuDataPolicy::Release);
+
+		// The main thread becomes worker 0 of the job system, 0 workers means one per core
+		JobSystem::Get().Init(
+			static_cast<uint32>(std::max(FlingConfig::GetInt("Engine", "JobWorkerThreads", 0), 0)),
+			FlingConfig::GetBool("Engine", "PinJobThreads", false));
+
 		VulkanApp::Get().Init(
 			static_cast<PipelineFlags>(PipelineFlags::DEFERRED | PipelineFlags::IMGUI),
 			g_Registry,
@@ -51,6 +68,7 @@ namespace Fling
 
 		m_World = new World(g_Registry, m_GameImpl);
 		m_GameImpl->m_OwningWorld = m_World;
+		VulkanApp::Get().SetSpatialTree(&m_World->GetSpatialTree());
 		
 #if WITH_EDITOR
 		m_Editor->m_OwningWorld = m_World;
@@ -77,6 +95,9 @@ namespace Fling
 
 		while(!VkApp.GetCurrentWindow()->ShouldClose())
 		{
+			FLING_PROFILE_FRAME();
+			FLING_PROFILE_SCOPE("Engine::Tick");
+
             // Update timing
             Timing.Update();
             DeltaTime = Timing.GetDeltaTime();
@@ -86,6 +107,12 @@ namespace Fling
 			
 			Input::Poll();
 
+			// Finish any resources that were loaded async and let their callbacks run before gameplay
+			{
+				FLING_PROFILE_SCOPE("ResourceManager::Update");
+				ResourceManager::Get().Update();
+			}
+
 			// World update will handle the starting, updating, and stopping of game logic
 			m_World->Update(DeltaTime);
 
@@ -103,6 +130,9 @@ namespace Fling
 
 	void Engine::Shutdown()
 	{
+		// Nothing can be destroyed while the GPU is still using it or uploading to it
+		VulkanApp::Get().WaitForIdle();
+
 		// Cleanup game play stuff
 		if(m_World)
 		{
@@ -112,12 +142,15 @@ namespace Fling
     	delete m_GameImpl;
     	m_GameImpl = nullptr;
 
+		VulkanApp::Get().SetSpatialTree(nullptr);
     	delete m_World;
     	m_World = nullptr;
 		
 		// Cleanup any resources
+		JobSystem::Get().Shutdown();
 		Input::Shutdown();
         ResourceManager::Get().Shutdown();
+		Profiler::Get().Shutdown();
 		Logger::Get().Shutdown();
         FlingConfig::Get().Shutdown();
 		Timing::Get().Shutdown();
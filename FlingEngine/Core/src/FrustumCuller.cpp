@@ -0,0 +1,174 @@
+#include "pch.h"
+#include "FrustumCuller.h"
+
+#if defined(__AVX__)
+#	include <immintrin.h>
+#	define FLING_CULL_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define FLING_CULL_SSE 1
+#endif
+
+namespace Fling
+{
+	void FrustumCuller::Clear()
+	{
+		m_Count = 0;
+		m_CenterX.clear();
+		m_CenterY.clear();
+		m_CenterZ.clear();
+		m_ExtentX.clear();
+		m_ExtentY.clear();
+		m_ExtentZ.clear();
+	}
+
+	void FrustumCuller::Add(const AABB& t_LocalBox, const glm::mat4& t_World)
+	{
+		const AABB WorldBox = t_LocalBox.Transform(t_World);
+		const glm::vec3 Center = WorldBox.GetCenter();
+		const glm::vec3 Extents = WorldBox.GetExtents();
+
+		// Start a new batch of padding, the padded boxes are never written out as visible
+		if (m_Count % BATCH_SIZE == 0)
+		{
+			const size_t PaddedSize = m_Count + BATCH_SIZE;
+			m_CenterX.resize(PaddedSize, 0.0f);
+			m_CenterY.resize(PaddedSize, 0.0f);
+			m_CenterZ.resize(PaddedSize, 0.0f);
+			m_ExtentX.resize(PaddedSize, 0.0f);
+			m_ExtentY.resize(PaddedSize, 0.0f);
+			m_ExtentZ.resize(PaddedSize, 0.0f);
+		}
+
+		m_CenterX[m_Count] = Center.x;
+		m_CenterY[m_Count] = Center.y;
+		m_CenterZ[m_Count] = Center.z;
+		m_ExtentX[m_Count] = Extents.x;
+		m_ExtentY[m_Count] = Extents.y;
+		m_ExtentZ[m_Count] = Extents.z;
+		++m_Count;
+	}
+
+	uint32 FrustumCuller::Cull(const Frustum& t_Frustum, uint32* t_OutVisible) const
+	{
+		FLING_PROFILE_SCOPE("FrustumCuller::Cull");
+
+		uint32 VisibleCount = 0;
+
+#if FLING_CULL_AVX || FLING_CULL_SSE
+		// Writes the boxes of a batch whose bit is set in the mask
+		auto WriteVisible = [&](uint32 t_First, uint32 t_Mask)
+		{
+			for (uint32 i = 0; i < BATCH_SIZE; ++i)
+			{
+				if ((t_Mask & (1u << i)) && t_First + i < m_Count)
+				{
+					t_OutVisible[VisibleCount++] = t_First + i;
+				}
+			}
+		};
+#endif
+
+		// A box is outside if it is fully behind any plane: dot(n, c) + w + dot(|n|, e) < 0
+#if FLING_CULL_AVX
+		const __m256 SignMask = _mm256_set1_ps(-0.0f);
+
+		__m256 PlaneX[Frustum::Count], PlaneY[Frustum::Count], PlaneZ[Frustum::Count], PlaneW[Frustum::Count];
+		for (uint32 p = 0; p < Frustum::Count; ++p)
+		{
+			PlaneX[p] = _mm256_set1_ps(t_Frustum.Planes[p].x);
+			PlaneY[p] = _mm256_set1_ps(t_Frustum.Planes[p].y);
+			PlaneZ[p] = _mm256_set1_ps(t_Frustum.Planes[p].z);
+			PlaneW[p] = _mm256_set1_ps(t_Frustum.Planes[p].w);
+		}
+
+		for (uint32 First = 0; First < m_Count; First += BATCH_SIZE)
+		{
+			const __m256 Cx = _mm256_loadu_ps(&m_CenterX[First]);
+			const __m256 Cy = _mm256_loadu_ps(&m_CenterY[First]);
+			const __m256 Cz = _mm256_loadu_ps(&m_CenterZ[First]);
+			const __m256 Ex = _mm256_loadu_ps(&m_ExtentX[First]);
+			const __m256 Ey = _mm256_loadu_ps(&m_ExtentY[First]);
+			const __m256 Ez = _mm256_loadu_ps(&m_ExtentZ[First]);
+
+			__m256 Outside = _mm256_setzero_ps();
+			for (uint32 p = 0; p < Frustum::Count; ++p)
+			{
+				const __m256 Distance = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(Cx, PlaneX[p]), _mm256_mul_ps(Cy, PlaneY[p])),
+					_mm256_add_ps(_mm256_mul_ps(Cz, PlaneZ[p]), PlaneW[p]));
+
+				const __m256 Radius = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(Ex, _mm256_andnot_ps(SignMask, PlaneX[p])), _mm256_mul_ps(Ey, _mm256_andnot_ps(SignMask, PlaneY[p]))),
+					_mm256_mul_ps(Ez, _mm256_andnot_ps(SignMask, PlaneZ[p])));
+
+				Outside = _mm256_or_ps(Outside, _mm256_cmp_ps(_mm256_add_ps(Distance, Radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+			}
+
+			WriteVisible(First, ~static_cast<uint32>(_mm256_movemask_ps(Outside)) & 0xFFu);
+		}
+#elif FLING_CULL_SSE
+		const __m128 SignMask = _mm_set1_ps(-0.0f);
+
+		__m128 PlaneX[Frustum::Count], PlaneY[Frustum::Count], PlaneZ[Frustum::Count], PlaneW[Frustum::Count];
+		for (uint32 p = 0; p < Frustum::Count; ++p)
+		{
+			PlaneX[p] = _mm_set1_ps(t_Frustum.Planes[p].x);
+			PlaneY[p] = _mm_set1_ps(t_Frustum.Planes[p].y);
+			PlaneZ[p] = _mm_set1_ps(t_Frustum.Planes[p].z);
+			PlaneW[p] = _mm_set1_ps(t_Frustum.Planes[p].w);
+		}
+
+		for (uint32 First = 0; First < m_Count; First += BATCH_SIZE)
+		{
+			uint32 VisibleMask = 0;
+
+			// Two halves of 4 for each batch
+			for (uint32 Half = 0; Half < BATCH_SIZE; Half += 4)
+			{
+				const uint32 i = First + Half;
+				const __m128 Cx = _mm_loadu_ps(&m_CenterX[i]);
+				const __m128 Cy = _mm_loadu_ps(&m_CenterY[i]);
+				const __m128 Cz = _mm_loadu_ps(&m_CenterZ[i]);
+				const __m128 Ex = _mm_loadu_ps(&m_ExtentX[i]);
+				const __m128 Ey = _mm_loadu_ps(&m_ExtentY[i]);
+				const __m128 Ez = _mm_loadu_ps(&m_ExtentZ[i]);
+
+				__m128 Outside = _mm_setzero_ps();
+				for (uint32 p = 0; p < Frustum::Count; ++p)
+				{
+					const __m128 Distance = _mm_add_ps(
+						_mm_add_ps(_mm_mul_ps(Cx, PlaneX[p]), _mm_mul_ps(Cy, PlaneY[p])),
+						_mm_add_ps(_mm_mul_ps(Cz, PlaneZ[p]), PlaneW[p]));
+
+					const __m128 Radius = _mm_add_ps(
+						_mm_add_ps(_mm_mul_ps(Ex, _mm_andnot_ps(SignMask, PlaneX[p])), _mm_mul_ps(Ey, _mm_andnot_ps(SignMask, PlaneY[p]))),
+						_mm_mul_ps(Ez, _mm_andnot_ps(SignMask, PlaneZ[p])));
+
+					Outside = _mm_or_ps(Outside, _mm_cmplt_ps(_mm_add_ps(Distance, Radius), _mm_setzero_ps()));
+				}
+
+				VisibleMask |= (~static_cast<uint32>(_mm_movemask_ps(Outside)) & 0xFu) << Half;
+			}
+
+			WriteVisible(First, VisibleMask);
+		}
+#else
+		for (uint32 i = 0; i < m_Count; ++i)
+		{
+			AABB Box = {};
+			const glm::vec3 Center(m_CenterX[i], m_CenterY[i], m_CenterZ[i]);
+			const glm::vec3 Extents(m_ExtentX[i], m_ExtentY[i], m_ExtentZ[i]);
+			Box.Min = Center - Extents;
+			Box.Max = Center + Extents;
+
+			if (t_Frustum.Intersects(Box))
+			{
+				t_OutVisible[VisibleCount++] = i;
+			}
+		}
+#endif
+
+		return VisibleCount;
+	}
+}   // namespace Fling
@@ -0,0 +1,246 @@
+#include "pch.h"
+#include "LightClusterGrid.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#	include <immintrin.h>
+#	define FLING_CLUSTER_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define FLING_CLUSTER_SSE 1
+#endif
+
+namespace Fling
+{
+	namespace
+	{
+		/** Lights are tested this many at a time, the slice arrays are padded to a multiple of it */
+		const uint32 LIGHT_BLOCK = 8;
+	}
+
+	LightClusterGrid::LightClusterGrid(uint32 t_CountX, uint32 t_CountY, uint32 t_CountZ)
+		: m_CountX(std::max(t_CountX, 1u))
+		, m_CountY(std::max(t_CountY, 1u))
+		, m_CountZ(std::max(t_CountZ, 1u))
+	{
+		m_Slices.resize(m_CountZ);
+		m_ClusterCounts.resize(GetClusterCount(), 0);
+		m_Data.resize(GetClusterCount() * 2, 0);
+	}
+
+	uint32 LightClusterGrid::GetSlice(float t_Depth) const
+	{
+		const float Slice = std::log(std::max(t_Depth, m_Near)) * m_SliceScale + m_SliceBias;
+		return std::min(static_cast<uint32>(std::max(Slice, 0.0f)), m_CountZ - 1);
+	}
+
+	float LightClusterGrid::GetSliceDepth(uint32 t_Slice) const
+	{
+		return m_Near * std::pow(m_Far / m_Near, static_cast<float>(t_Slice) / static_cast<float>(m_CountZ));
+	}
+
+	void LightClusterGrid::Build(const glm::mat4& t_View, const glm::mat4& t_Projection, float t_Near, float t_Far, const glm::vec4* t_Lights, uint32 t_LightCount)
+	{
+		FLING_PROFILE_SCOPE("LightClusterGrid::Build");
+
+		m_Near = t_Near;
+		m_Far = t_Far;
+		m_ProjX = t_Projection[0][0];
+		m_ProjY = t_Projection[1][1];
+
+		const float LogDepthRange = std::log(m_Far / m_Near);
+		m_SliceScale = static_cast<float>(m_CountZ) / LogDepthRange;
+		m_SliceBias = -static_cast<float>(m_CountZ) * std::log(m_Near) / LogDepthRange;
+
+		for (Slice& S : m_Slices)
+		{
+			S.X.clear();
+			S.Y.clear();
+			S.Depth.clear();
+			S.RadiusSq.clear();
+			S.Index.clear();
+		}
+
+		// Bin each light into every slice between its nearest and furthest depth
+		for (uint32 i = 0; i < t_LightCount; ++i)
+		{
+			const glm::vec4 ViewPos = t_View * glm::vec4(glm::vec3(t_Lights[i]), 1.0f);
+			const float Depth = -ViewPos.z;
+			const float Radius = t_Lights[i].w;
+
+			if (Radius <= 0.0f || Depth + Radius < m_Near || Depth - Radius > m_Far)
+			{
+				continue;
+			}
+
+			const uint32 FirstSlice = GetSlice(Depth - Radius);
+			const uint32 LastSlice = GetSlice(std::min(Depth + Radius, m_Far));
+			for (uint32 s = FirstSlice; s <= LastSlice; ++s)
+			{
+				Slice& S = m_Slices[s];
+				S.X.push_back(ViewPos.x);
+				S.Y.push_back(ViewPos.y);
+				S.Depth.push_back(Depth);
+				S.RadiusSq.push_back(Radius * Radius);
+				S.Index.push_back(i);
+			}
+		}
+
+		// Each slice only writes its own clusters, so they can all be built at the same time
+		JobSystem::Get().ParallelFor(m_CountZ, [this](uint32 t_Begin, uint32 t_End)
+		{
+			for (uint32 s = t_Begin; s < t_End; ++s)
+			{
+				BuildSlice(s);
+			}
+		}, 1);
+
+		// Clusters of a slice are contiguous, so the light lists can be appended one slice after another
+		const uint32 ClusterCount = GetClusterCount();
+
+		uint32 Offset = ClusterCount * 2;
+		for (uint32 Cluster = 0; Cluster < ClusterCount; ++Cluster)
+		{
+			m_Data[Cluster * 2] = Offset;
+			m_Data[Cluster * 2 + 1] = m_ClusterCounts[Cluster];
+			Offset += m_ClusterCounts[Cluster];
+		}
+
+		m_Data.resize(Offset);
+		uint32* Out = m_Data.data() + ClusterCount * 2;
+		for (const Slice& S : m_Slices)
+		{
+			std::copy(S.ClusterLights.begin(), S.ClusterLights.end(), Out);
+			Out += S.ClusterLights.size();
+		}
+
+		assert(Out == m_Data.data() + m_Data.size());
+	}
+
+	void LightClusterGrid::BuildSlice(uint32 t_Slice)
+	{
+		Slice& S = m_Slices[t_Slice];
+		S.ClusterLights.clear();
+
+		const uint32 LightCount = static_cast<uint32>(S.Index.size());
+		const uint32 FirstCluster = GetClusterIndex(0, 0, t_Slice);
+
+		if (LightCount == 0)
+		{
+			std::fill(m_ClusterCounts.begin() + FirstCluster, m_ClusterCounts.begin() + FirstCluster + m_CountX * m_CountY, 0u);
+			return;
+		}
+
+		// Padding lights have a negative radius, so nothing can be inside of them
+		const uint32 PaddedCount = (LightCount + LIGHT_BLOCK - 1) / LIGHT_BLOCK * LIGHT_BLOCK;
+		S.X.resize(PaddedCount, 0.0f);
+		S.Y.resize(PaddedCount, 0.0f);
+		S.Depth.resize(PaddedCount, 0.0f);
+		S.RadiusSq.resize(PaddedCount, -1.0f);
+
+		const float NearDepth = GetSliceDepth(t_Slice);
+		const float FarDepth = GetSliceDepth(t_Slice + 1);
+
+		for (uint32 TileY = 0; TileY < m_CountY; ++TileY)
+		{
+			// Row 0 is the top of the screen
+			const float NdcTop = 1.0f - 2.0f * static_cast<float>(TileY) / static_cast<float>(m_CountY);
+			const float NdcBottom = 1.0f - 2.0f * static_cast<float>(TileY + 1) / static_cast<float>(m_CountY);
+			const float MinY = std::min(NdcBottom * NearDepth, NdcBottom * FarDepth) / m_ProjY;
+			const float MaxY = std::max(NdcTop * NearDepth, NdcTop * FarDepth) / m_ProjY;
+
+			for (uint32 TileX = 0; TileX < m_CountX; ++TileX)
+			{
+				const float NdcLeft = -1.0f + 2.0f * static_cast<float>(TileX) / static_cast<float>(m_CountX);
+				const float NdcRight = -1.0f + 2.0f * static_cast<float>(TileX + 1) / static_cast<float>(m_CountX);
+				const float MinX = std::min(NdcLeft * NearDepth, NdcLeft * FarDepth) / m_ProjX;
+				const float MaxX = std::max(NdcRight * NearDepth, NdcRight * FarDepth) / m_ProjX;
+
+				const uint32 CountBefore = static_cast<uint32>(S.ClusterLights.size());
+
+				// A sphere touches the box if the closest point of the box to its center is inside of it
+#if FLING_CLUSTER_AVX
+
+				const __m256 Zero = _mm256_setzero_ps();
+				const __m256 BoxMinX = _mm256_set1_ps(MinX);
+				const __m256 BoxMaxX = _mm256_set1_ps(MaxX);
+				const __m256 BoxMinY = _mm256_set1_ps(MinY);
+				const __m256 BoxMaxY = _mm256_set1_ps(MaxY);
+				const __m256 BoxMinZ = _mm256_set1_ps(NearDepth);
+				const __m256 BoxMaxZ = _mm256_set1_ps(FarDepth);
+
+				for (uint32 First = 0; First < PaddedCount; First += 8)
+				{
+					const __m256 X = _mm256_loadu_ps(S.X.data() + First);
+					const __m256 Y = _mm256_loadu_ps(S.Y.data() + First);
+					const __m256 Z = _mm256_loadu_ps(S.Depth.data() + First);
+
+					const __m256 DX = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(BoxMinX, X), _mm256_sub_ps(X, BoxMaxX)), Zero);
+					const __m256 DY = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(BoxMinY, Y), _mm256_sub_ps(Y, BoxMaxY)), Zero);
+					const __m256 DZ = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(BoxMinZ, Z), _mm256_sub_ps(Z, BoxMaxZ)), Zero);
+					const __m256 DistSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(DX, DX), _mm256_mul_ps(DY, DY)), _mm256_mul_ps(DZ, DZ));
+
+					const int Mask = _mm256_movemask_ps(_mm256_cmp_ps(DistSq, _mm256_loadu_ps(S.RadiusSq.data() + First), _CMP_LE_OQ));
+					for (uint32 Lane = 0; Mask && Lane < 8; ++Lane)
+					{
+						if (Mask & (1 << Lane))
+						{
+							S.ClusterLights.push_back(S.Index[First + Lane]);
+						}
+					}
+				}
+
+#elif FLING_CLUSTER_SSE
+
+				const __m128 Zero = _mm_setzero_ps();
+				const __m128 BoxMinX = _mm_set1_ps(MinX);
+				const __m128 BoxMaxX = _mm_set1_ps(MaxX);
+				const __m128 BoxMinY = _mm_set1_ps(MinY);
+				const __m128 BoxMaxY = _mm_set1_ps(MaxY);
+				const __m128 BoxMinZ = _mm_set1_ps(NearDepth);
+				const __m128 BoxMaxZ = _mm_set1_ps(FarDepth);
+
+				for (uint32 First = 0; First < PaddedCount; First += 4)
+				{
+					const __m128 X = _mm_loadu_ps(S.X.data() + First);
+					const __m128 Y = _mm_loadu_ps(S.Y.data() + First);
+					const __m128 Z = _mm_loadu_ps(S.Depth.data() + First);
+
+					const __m128 DX = _mm_max_ps(_mm_max_ps(_mm_sub_ps(BoxMinX, X), _mm_sub_ps(X, BoxMaxX)), Zero);
+					const __m128 DY = _mm_max_ps(_mm_max_ps(_mm_sub_ps(BoxMinY, Y), _mm_sub_ps(Y, BoxMaxY)), Zero);
+					const __m128 DZ = _mm_max_ps(_mm_max_ps(_mm_sub_ps(BoxMinZ, Z), _mm_sub_ps(Z, BoxMaxZ)), Zero);
+					const __m128 DistSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(DX, DX), _mm_mul_ps(DY, DY)), _mm_mul_ps(DZ, DZ));
+
+					const int Mask = _mm_movemask_ps(_mm_cmple_ps(DistSq, _mm_loadu_ps(S.RadiusSq.data() + First)));
+					for (uint32 Lane = 0; Mask && Lane < 4; ++Lane)
+					{
+						if (Mask & (1 << Lane))
+						{
+							S.ClusterLights.push_back(S.Index[First + Lane]);
+						}
+					}
+				}
+
+#else
+
+				for (uint32 i = 0; i < LightCount; ++i)
+				{
+					const float DX = std::max(std::max(MinX - S.X[i], S.X[i] - MaxX), 0.0f);
+					const float DY = std::max(std::max(MinY - S.Y[i], S.Y[i] - MaxY), 0.0f);
+					const float DZ = std::max(std::max(NearDepth - S.Depth[i], S.Depth[i] - FarDepth), 0.0f);
+					if (DX * DX + DY * DY + DZ * DZ <= S.RadiusSq[i])
+					{
+						S.ClusterLights.push_back(S.Index[i]);
+					}
+				}
+
+#endif
+
+				m_ClusterCounts[GetClusterIndex(TileX, TileY, t_Slice)] = static_cast<uint32>(S.ClusterLights.size()) - CountBefore;
+			}
+		}
+	}
+}   // namespace Fling
@@ -0,0 +1,321 @@
+#include "pch.h"
+#include "OcclusionBuffer.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX__)
+#	include <immintrin.h>
+#	define FLING_OCCLUSION_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define FLING_OCCLUSION_SSE 1
+#endif
+
+namespace Fling
+{
+	OcclusionBuffer::OcclusionBuffer(uint32 t_Width, uint32 t_Height)
+	{
+		m_TilesX = std::max<uint32>(1u, (t_Width + TILE_WIDTH - 1) / TILE_WIDTH);
+		m_TilesY = std::max<uint32>(1u, (t_Height + TILE_HEIGHT - 1) / TILE_HEIGHT);
+		m_Width = m_TilesX * TILE_WIDTH;
+		m_Height = m_TilesY * TILE_HEIGHT;
+
+		m_Depth.resize(m_Width * m_Height, 1.0f);
+		m_TileMaxDepth.resize(m_TilesX * m_TilesY, 1.0f);
+	}
+
+	void OcclusionBuffer::Begin(const glm::mat4& t_ViewProj)
+	{
+		m_ViewProj = t_ViewProj;
+		m_Triangles.clear();
+		std::fill(m_Depth.begin(), m_Depth.end(), 1.0f);
+		std::fill(m_TileMaxDepth.begin(), m_TileMaxDepth.end(), 1.0f);
+	}
+
+	bool OcclusionBuffer::ProjectToScreen(const glm::vec4& t_Clip, glm::vec3& t_OutScreen) const
+	{
+		// Depth is [0, 1], so anything with a negative z is in front of the near plane
+		if (t_Clip.w <= 1e-5f || t_Clip.z < 0.0f)
+		{
+			return false;
+		}
+
+		const float InvW = 1.0f / t_Clip.w;
+		t_OutScreen.x = (t_Clip.x * InvW * 0.5f + 0.5f) * static_cast<float>(m_Width);
+		t_OutScreen.y = (t_Clip.y * InvW * 0.5f + 0.5f) * static_cast<float>(m_Height);
+		t_OutScreen.z = t_Clip.z * InvW;
+		return true;
+	}
+
+	void OcclusionBuffer::AddOccluder(const OccluderMesh& t_Mesh, const glm::mat4& t_World)
+	{
+		const glm::mat4 WorldViewProj = m_ViewProj * t_World;
+
+		const size_t VertCount = t_Mesh.Positions.size();
+		m_ProjectedVerts.resize(VertCount);
+		m_ProjectedValid.resize(VertCount);
+		for (size_t i = 0; i < VertCount; ++i)
+		{
+			m_ProjectedValid[i] = ProjectToScreen(WorldViewProj * glm::vec4(t_Mesh.Positions[i], 1.0f), m_ProjectedVerts[i]) ? 1 : 0;
+		}
+
+		const float Width = static_cast<float>(m_Width);
+		const float Height = static_cast<float>(m_Height);
+
+		for (size_t i = 0; i + 2 < t_Mesh.Indices.size(); i += 3)
+		{
+			const uint32 I0 = t_Mesh.Indices[i];
+			uint32 I1 = t_Mesh.Indices[i + 1];
+			uint32 I2 = t_Mesh.Indices[i + 2];
+			if (I0 >= VertCount || I1 >= VertCount || I2 >= VertCount || !m_ProjectedValid[I0] || !m_ProjectedValid[I1] || !m_ProjectedValid[I2])
+			{
+				continue;
+			}
+
+			// Occluders are drawn from both sides, so wind everything the same way
+			const float Area =
+				(m_ProjectedVerts[I1].x - m_ProjectedVerts[I0].x) * (m_ProjectedVerts[I2].y - m_ProjectedVerts[I0].y) -
+				(m_ProjectedVerts[I2].x - m_ProjectedVerts[I0].x) * (m_ProjectedVerts[I1].y - m_ProjectedVerts[I0].y);
+			if (std::fabs(Area) < 1e-6f)
+			{
+				continue;
+			}
+			if (Area < 0.0f)
+			{
+				std::swap(I1, I2);
+			}
+
+			const glm::vec3& V0 = m_ProjectedVerts[I0];
+			const glm::vec3& V1 = m_ProjectedVerts[I1];
+			const glm::vec3& V2 = m_ProjectedVerts[I2];
+
+			if (std::max({ V0.x, V1.x, V2.x }) < 0.0f || std::min({ V0.x, V1.x, V2.x }) > Width ||
+				std::max({ V0.y, V1.y, V2.y }) < 0.0f || std::min({ V0.y, V1.y, V2.y }) > Height ||
+				std::min({ V0.z, V1.z, V2.z }) > 1.0f)
+			{
+				continue;
+			}
+
+			m_Triangles.push_back({ { V0.x, V1.x, V2.x }, { V0.y, V1.y, V2.y }, { V0.z, V1.z, V2.z } });
+		}
+	}
+
+	void OcclusionBuffer::Rasterize()
+	{
+		FLING_PROFILE_SCOPE("OcclusionBuffer::Rasterize");
+
+		// Each band only writes to its own rows and tiles, so they don't need to be synchronized
+		JobSystem::Get().ParallelFor(m_TilesY, [this](uint32 t_Begin, uint32 t_End)
+		{
+			RasterizeTileRows(t_Begin, t_End);
+		});
+	}
+
+	void OcclusionBuffer::RasterizeTileRows(uint32 t_FirstTileRow, uint32 t_EndTileRow)
+	{
+		const uint32 FirstRow = t_FirstTileRow * TILE_HEIGHT;
+		const uint32 EndRow = t_EndTileRow * TILE_HEIGHT;
+
+		for (const ScreenTriangle& Tri : m_Triangles)
+		{
+			const float MinY = std::min({ Tri.Y[0], Tri.Y[1], Tri.Y[2] });
+			const float MaxY = std::max({ Tri.Y[0], Tri.Y[1], Tri.Y[2] });
+			if (MaxY >= static_cast<float>(FirstRow) && MinY <= static_cast<float>(EndRow))
+			{
+				RasterizeTriangle(Tri, FirstRow, EndRow);
+			}
+		}
+
+		for (uint32 TileY = t_FirstTileRow; TileY < t_EndTileRow; ++TileY)
+		{
+			for (uint32 TileX = 0; TileX < m_TilesX; ++TileX)
+			{
+				float MaxDepth = 0.0f;
+				for (uint32 y = TileY * TILE_HEIGHT; y < (TileY + 1) * TILE_HEIGHT; ++y)
+				{
+					const float* Row = &m_Depth[y * m_Width + TileX * TILE_WIDTH];
+					for (uint32 x = 0; x < TILE_WIDTH; ++x)
+					{
+						MaxDepth = std::max(MaxDepth, Row[x]);
+					}
+				}
+				m_TileMaxDepth[TileY * m_TilesX + TileX] = MaxDepth;
+			}
+		}
+	}
+
+	void OcclusionBuffer::RasterizeTriangle(const ScreenTriangle& t_Tri, uint32 t_FirstRow, uint32 t_EndRow)
+	{
+#if FLING_OCCLUSION_AVX
+		const int32 Lanes = 8;
+#elif FLING_OCCLUSION_SSE
+		const int32 Lanes = 4;
+#else
+		const int32 Lanes = 1;
+#endif
+
+		const int32 MinX = std::max(0, static_cast<int32>(std::floor(std::min({ t_Tri.X[0], t_Tri.X[1], t_Tri.X[2] }))));
+		const int32 MaxX = std::min(static_cast<int32>(m_Width) - 1, static_cast<int32>(std::ceil(std::max({ t_Tri.X[0], t_Tri.X[1], t_Tri.X[2] }))));
+		const int32 MinY = std::max(static_cast<int32>(t_FirstRow), static_cast<int32>(std::floor(std::min({ t_Tri.Y[0], t_Tri.Y[1], t_Tri.Y[2] }))));
+		const int32 MaxY = std::min(static_cast<int32>(t_EndRow) - 1, static_cast<int32>(std::ceil(std::max({ t_Tri.Y[0], t_Tri.Y[1], t_Tri.Y[2] }))));
+		if (MinX > MaxX || MinY > MaxY)
+		{
+			return;
+		}
+
+		// Edge i goes from vertex i to the next one, E(x, y) = A * x + B * y + C is positive inside
+		float A[3], B[3], C[3];
+		for (int32 i = 0; i < 3; ++i)
+		{
+			const int32 j = (i + 1) % 3;
+			A[i] = t_Tri.Y[i] - t_Tri.Y[j];
+			B[i] = t_Tri.X[j] - t_Tri.X[i];
+			C[i] = (t_Tri.Y[j] - t_Tri.Y[i]) * t_Tri.X[i] - (t_Tri.X[j] - t_Tri.X[i]) * t_Tri.Y[i];
+		}
+
+		// Post projection depth is linear in screen space, so it is a plane over the triangle
+		const float X1 = t_Tri.X[1] - t_Tri.X[0], Y1 = t_Tri.Y[1] - t_Tri.Y[0], Z1 = t_Tri.Z[1] - t_Tri.Z[0];
+		const float X2 = t_Tri.X[2] - t_Tri.X[0], Y2 = t_Tri.Y[2] - t_Tri.Y[0], Z2 = t_Tri.Z[2] - t_Tri.Z[0];
+		const float InvArea = 1.0f / (X1 * Y2 - X2 * Y1);
+		const float DzDx = (Z1 * Y2 - Z2 * Y1) * InvArea;
+		const float DzDy = (Z2 * X1 - Z1 * X2) * InvArea;
+		const float Z0 = t_Tri.Z[0] - DzDx * t_Tri.X[0] - DzDy * t_Tri.Y[0];
+
+		const int32 FirstX = MinX - (MinX % Lanes);
+
+#if FLING_OCCLUSION_AVX
+		const __m256 LaneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+		const __m256 Zero = _mm256_setzero_ps();
+		const __m256 A0 = _mm256_set1_ps(A[0]), A1 = _mm256_set1_ps(A[1]), A2 = _mm256_set1_ps(A[2]);
+		const __m256 ZStep = _mm256_set1_ps(DzDx);
+#elif FLING_OCCLUSION_SSE
+		const __m128 LaneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 Zero = _mm_setzero_ps();
+		const __m128 A0 = _mm_set1_ps(A[0]), A1 = _mm_set1_ps(A[1]), A2 = _mm_set1_ps(A[2]);
+		const __m128 ZStep = _mm_set1_ps(DzDx);
+#endif
+
+		for (int32 y = MinY; y <= MaxY; ++y)
+		{
+			const float PixelY = static_cast<float>(y) + 0.5f;
+			const float Row0 = B[0] * PixelY + C[0];
+			const float Row1 = B[1] * PixelY + C[1];
+			const float Row2 = B[2] * PixelY + C[2];
+			const float RowZ = Z0 + DzDy * PixelY;
+
+			float* Row = &m_Depth[y * m_Width];
+
+			for (int32 x = FirstX; x <= MaxX; x += Lanes)
+			{
+#if FLING_OCCLUSION_AVX
+				const __m256 PixelX = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), LaneOffsets);
+				const __m256 E0 = _mm256_add_ps(_mm256_mul_ps(A0, PixelX), _mm256_set1_ps(Row0));
+				const __m256 E1 = _mm256_add_ps(_mm256_mul_ps(A1, PixelX), _mm256_set1_ps(Row1));
+				const __m256 E2 = _mm256_add_ps(_mm256_mul_ps(A2, PixelX), _mm256_set1_ps(Row2));
+				const __m256 Inside = _mm256_and_ps(_mm256_cmp_ps(E0, Zero, _CMP_GE_OQ), _mm256_and_ps(_mm256_cmp_ps(E1, Zero, _CMP_GE_OQ), _mm256_cmp_ps(E2, Zero, _CMP_GE_OQ)));
+				if (_mm256_movemask_ps(Inside) == 0)
+				{
+					continue;
+				}
+
+				const __m256 Depth = _mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(ZStep, PixelX), _mm256_set1_ps(RowZ)), Zero);
+				const __m256 Old = _mm256_loadu_ps(Row + x);
+				_mm256_storeu_ps(Row + x, _mm256_blendv_ps(Old, _mm256_min_ps(Old, Depth), Inside));
+#elif FLING_OCCLUSION_SSE
+				const __m128 PixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), LaneOffsets);
+				const __m128 E0 = _mm_add_ps(_mm_mul_ps(A0, PixelX), _mm_set1_ps(Row0));
+				const __m128 E1 = _mm_add_ps(_mm_mul_ps(A1, PixelX), _mm_set1_ps(Row1));
+				const __m128 E2 = _mm_add_ps(_mm_mul_ps(A2, PixelX), _mm_set1_ps(Row2));
+				const __m128 Inside = _mm_and_ps(_mm_cmpge_ps(E0, Zero), _mm_and_ps(_mm_cmpge_ps(E1, Zero), _mm_cmpge_ps(E2, Zero)));
+				if (_mm_movemask_ps(Inside) == 0)
+				{
+					continue;
+				}
+
+				const __m128 Depth = _mm_max_ps(_mm_add_ps(_mm_mul_ps(ZStep, PixelX), _mm_set1_ps(RowZ)), Zero);
+				const __m128 Old = _mm_loadu_ps(Row + x);
+				const __m128 New = _mm_min_ps(Old, Depth);
+				_mm_storeu_ps(Row + x, _mm_or_ps(_mm_and_ps(Inside, New), _mm_andnot_ps(Inside, Old)));
+#else
+				const float PixelX = static_cast<float>(x) + 0.5f;
+				if (A[0] * PixelX + Row0 >= 0.0f && A[1] * PixelX + Row1 >= 0.0f && A[2] * PixelX + Row2 >= 0.0f)
+				{
+					Row[x] = std::min(Row[x], std::max(DzDx * PixelX + RowZ, 0.0f));
+				}
+#endif
+			}
+		}
+	}
+
+	bool OcclusionBuffer::IsVisible(const AABB& t_WorldBox) const
+	{
+		glm::vec2 ScreenMin(std::numeric_limits<float>::max());
+		glm::vec2 ScreenMax(-std::numeric_limits<float>::max());
+		float NearestDepth = std::numeric_limits<float>::max();
+
+		for (uint32 Corner = 0; Corner < 8; ++Corner)
+		{
+			const glm::vec4 Pos(
+				(Corner & 1) ? t_WorldBox.Max.x : t_WorldBox.Min.x,
+				(Corner & 2) ? t_WorldBox.Max.y : t_WorldBox.Min.y,
+				(Corner & 4) ? t_WorldBox.Max.z : t_WorldBox.Min.z,
+				1.0f);
+
+			// A box that crosses the near plane covers too much of the screen to be worth testing
+			glm::vec3 Screen;
+			if (!ProjectToScreen(m_ViewProj * Pos, Screen))
+			{
+				return true;
+			}
+
+			ScreenMin = glm::min(ScreenMin, glm::vec2(Screen));
+			ScreenMax = glm::max(ScreenMax, glm::vec2(Screen));
+			NearestDepth = std::min(NearestDepth, Screen.z);
+		}
+
+		// None of it is on the screen
+		if (ScreenMax.x < 0.0f || ScreenMax.y < 0.0f || ScreenMin.x >= static_cast<float>(m_Width) || ScreenMin.y >= static_cast<float>(m_Height))
+		{
+			return false;
+		}
+
+		const uint32 MinX = static_cast<uint32>(std::max(0.0f, std::floor(ScreenMin.x)));
+		const uint32 MinY = static_cast<uint32>(std::max(0.0f, std::floor(ScreenMin.y)));
+		const uint32 MaxX = std::min(m_Width - 1, static_cast<uint32>(ScreenMax.x));
+		const uint32 MaxY = std::min(m_Height - 1, static_cast<uint32>(ScreenMax.y));
+
+		for (uint32 TileY = MinY / TILE_HEIGHT; TileY <= MaxY / TILE_HEIGHT; ++TileY)
+		{
+			for (uint32 TileX = MinX / TILE_WIDTH; TileX <= MaxX / TILE_WIDTH; ++TileX)
+			{
+				// Everything in this tile is closer than the box
+				if (NearestDepth > m_TileMaxDepth[TileY * m_TilesX + TileX])
+				{
+					continue;
+				}
+
+				const uint32 X0 = std::max(MinX, TileX * TILE_WIDTH);
+				const uint32 X1 = std::min(MaxX, (TileX + 1) * TILE_WIDTH - 1);
+				const uint32 Y0 = std::max(MinY, TileY * TILE_HEIGHT);
+				const uint32 Y1 = std::min(MaxY, (TileY + 1) * TILE_HEIGHT - 1);
+
+				for (uint32 y = Y0; y <= Y1; ++y)
+				{
+					const float* Row = &m_Depth[y * m_Width];
+					for (uint32 x = X0; x <= X1; ++x)
+					{
+						if (NearestDepth <= Row[x])
+						{
+							return true;
+						}
+					}
+				}
+			}
+		}
+
+		return false;
+	}
+}   // namespace Fling
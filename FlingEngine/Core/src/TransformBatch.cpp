@@ -0,0 +1,210 @@
+#include "pch.h"
+#include "TransformBatch.h"
+
+#include <algorithm>
+
+#if defined(__AVX__)
+#	include <immintrin.h>
+#	define FLING_TRANSFORM_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define FLING_TRANSFORM_SSE 1
+#endif
+
+namespace Fling
+{
+	namespace
+	{
+#if FLING_TRANSFORM_AVX || FLING_TRANSFORM_SSE
+		/**
+		* Write one column of 4 matrices. Each input has a row of that column for all 4 of them,
+		* so a transpose gives each matrix its whole column
+		*/
+		FORCEINLINE void StoreColumn(__m128 t_X, __m128 t_Y, __m128 t_Z, __m128 t_W, glm::mat4* const* t_Outputs, uint32 t_Count, uint32 t_Column)
+		{
+			_MM_TRANSPOSE4_PS(t_X, t_Y, t_Z, t_W);
+
+			const __m128 Columns[4] = { t_X, t_Y, t_Z, t_W };
+			for (uint32 Lane = 0; Lane < t_Count; ++Lane)
+			{
+				_mm_storeu_ps(&(*t_Outputs[Lane])[t_Column][0], Columns[Lane]);
+			}
+		}
+#endif
+
+#if FLING_TRANSFORM_AVX
+		FORCEINLINE void StoreColumns(__m256 t_X, __m256 t_Y, __m256 t_Z, __m256 t_W, glm::mat4* const* t_Outputs, uint32 t_Count, uint32 t_Column)
+		{
+			StoreColumn(_mm256_castps256_ps128(t_X), _mm256_castps256_ps128(t_Y), _mm256_castps256_ps128(t_Z), _mm256_castps256_ps128(t_W), t_Outputs, std::min(t_Count, 4u), t_Column);
+			if (t_Count > 4)
+			{
+				StoreColumn(_mm256_extractf128_ps(t_X, 1), _mm256_extractf128_ps(t_Y, 1), _mm256_extractf128_ps(t_Z, 1), _mm256_extractf128_ps(t_W, 1), t_Outputs + 4, t_Count - 4, t_Column);
+			}
+		}
+#endif
+	}
+
+	void TransformBatch::Flush()
+	{
+		if (Count == 0)
+		{
+			return;
+		}
+
+		// Unused lanes are still composed, so give them something harmless
+		for (uint32 Lane = Count; Lane < WIDTH; ++Lane)
+		{
+			PosX[Lane] = PosY[Lane] = PosZ[Lane] = 0.0f;
+			RotX[Lane] = RotY[Lane] = RotZ[Lane] = 0.0f;
+			RotW[Lane] = 1.0f;
+			ScaleX[Lane] = ScaleY[Lane] = ScaleZ[Lane] = 1.0f;
+		}
+
+#if FLING_TRANSFORM_AVX
+
+		const __m256 One = _mm256_set1_ps(1.0f);
+		const __m256 Two = _mm256_set1_ps(2.0f);
+		const __m256 Zero = _mm256_setzero_ps();
+
+		const __m256 X = _mm256_load_ps(RotX);
+		const __m256 Y = _mm256_load_ps(RotY);
+		const __m256 Z = _mm256_load_ps(RotZ);
+		const __m256 W = _mm256_load_ps(RotW);
+
+		const __m256 X2 = _mm256_mul_ps(X, Two);
+		const __m256 Y2 = _mm256_mul_ps(Y, Two);
+		const __m256 Z2 = _mm256_mul_ps(Z, Two);
+
+		const __m256 XX = _mm256_mul_ps(X, X2);
+		const __m256 YY = _mm256_mul_ps(Y, Y2);
+		const __m256 ZZ = _mm256_mul_ps(Z, Z2);
+		const __m256 XY = _mm256_mul_ps(X, Y2);
+		const __m256 XZ = _mm256_mul_ps(X, Z2);
+		const __m256 YZ = _mm256_mul_ps(Y, Z2);
+		const __m256 WX = _mm256_mul_ps(W, X2);
+		const __m256 WY = _mm256_mul_ps(W, Y2);
+		const __m256 WZ = _mm256_mul_ps(W, Z2);
+
+		const __m256 SX = _mm256_load_ps(ScaleX);
+		const __m256 SY = _mm256_load_ps(ScaleY);
+		const __m256 SZ = _mm256_load_ps(ScaleZ);
+
+		StoreColumns(
+			_mm256_mul_ps(_mm256_sub_ps(One, _mm256_add_ps(YY, ZZ)), SX),
+			_mm256_mul_ps(_mm256_add_ps(XY, WZ), SX),
+			_mm256_mul_ps(_mm256_sub_ps(XZ, WY), SX),
+			Zero, Outputs, Count, 0);
+
+		StoreColumns(
+			_mm256_mul_ps(_mm256_sub_ps(XY, WZ), SY),
+			_mm256_mul_ps(_mm256_sub_ps(One, _mm256_add_ps(XX, ZZ)), SY),
+			_mm256_mul_ps(_mm256_add_ps(YZ, WX), SY),
+			Zero, Outputs, Count, 1);
+
+		StoreColumns(
+			_mm256_mul_ps(_mm256_add_ps(XZ, WY), SZ),
+			_mm256_mul_ps(_mm256_sub_ps(YZ, WX), SZ),
+			_mm256_mul_ps(_mm256_sub_ps(One, _mm256_add_ps(XX, YY)), SZ),
+			Zero, Outputs, Count, 2);
+
+		StoreColumns(_mm256_load_ps(PosX), _mm256_load_ps(PosY), _mm256_load_ps(PosZ), One, Outputs, Count, 3);
+
+#elif FLING_TRANSFORM_SSE
+
+		const __m128 One = _mm_set1_ps(1.0f);
+		const __m128 Two = _mm_set1_ps(2.0f);
+		const __m128 Zero = _mm_setzero_ps();
+
+		for (uint32 First = 0; First < Count; First += 4)
+		{
+			const uint32 LaneCount = std::min(Count - First, 4u);
+			glm::mat4* const* Outs = Outputs + First;
+
+			const __m128 X = _mm_load_ps(RotX + First);
+			const __m128 Y = _mm_load_ps(RotY + First);
+			const __m128 Z = _mm_load_ps(RotZ + First);
+			const __m128 W = _mm_load_ps(RotW + First);
+
+			const __m128 X2 = _mm_mul_ps(X, Two);
+			const __m128 Y2 = _mm_mul_ps(Y, Two);
+			const __m128 Z2 = _mm_mul_ps(Z, Two);
+
+			const __m128 XX = _mm_mul_ps(X, X2);
+			const __m128 YY = _mm_mul_ps(Y, Y2);
+			const __m128 ZZ = _mm_mul_ps(Z, Z2);
+			const __m128 XY = _mm_mul_ps(X, Y2);
+			const __m128 XZ = _mm_mul_ps(X, Z2);
+			const __m128 YZ = _mm_mul_ps(Y, Z2);
+			const __m128 WX = _mm_mul_ps(W, X2);
+			const __m128 WY = _mm_mul_ps(W, Y2);
+			const __m128 WZ = _mm_mul_ps(W, Z2);
+
+			const __m128 SX = _mm_load_ps(ScaleX + First);
+			const __m128 SY = _mm_load_ps(ScaleY + First);
+			const __m128 SZ = _mm_load_ps(ScaleZ + First);
+
+			StoreColumn(
+				_mm_mul_ps(_mm_sub_ps(One, _mm_add_ps(YY, ZZ)), SX),
+				_mm_mul_ps(_mm_add_ps(XY, WZ), SX),
+				_mm_mul_ps(_mm_sub_ps(XZ, WY), SX),
+				Zero, Outs, LaneCount, 0);
+
+			StoreColumn(
+				_mm_mul_ps(_mm_sub_ps(XY, WZ), SY),
+				_mm_mul_ps(_mm_sub_ps(One, _mm_add_ps(XX, ZZ)), SY),
+				_mm_mul_ps(_mm_add_ps(YZ, WX), SY),
+				Zero, Outs, LaneCount, 1);
+
+			StoreColumn(
+				_mm_mul_ps(_mm_add_ps(XZ, WY), SZ),
+				_mm_mul_ps(_mm_sub_ps(YZ, WX), SZ),
+				_mm_mul_ps(_mm_sub_ps(One, _mm_add_ps(XX, YY)), SZ),
+				Zero, Outs, LaneCount, 2);
+
+			StoreColumn(_mm_load_ps(PosX + First), _mm_load_ps(PosY + First), _mm_load_ps(PosZ + First), One, Outs, LaneCount, 3);
+		}
+
+#else
+
+		for (uint32 Lane = 0; Lane < Count; ++Lane)
+		{
+			*Outputs[Lane] = Compose(
+				glm::vec3(PosX[Lane], PosY[Lane], PosZ[Lane]),
+				glm::quat(RotW[Lane], RotX[Lane], RotY[Lane], RotZ[Lane]),
+				glm::vec3(ScaleX[Lane], ScaleY[Lane], ScaleZ[Lane]));
+		}
+
+#endif
+
+		Count = 0;
+	}
+
+	glm::mat4 TransformBatch::Compose(const glm::vec3& t_Pos, const glm::quat& t_Rot, const glm::vec3& t_Scale)
+	{
+		const float XX = t_Rot.x * t_Rot.x * 2.0f;
+		const float YY = t_Rot.y * t_Rot.y * 2.0f;
+		const float ZZ = t_Rot.z * t_Rot.z * 2.0f;
+		const float XY = t_Rot.x * t_Rot.y * 2.0f;
+		const float XZ = t_Rot.x * t_Rot.z * 2.0f;
+		const float YZ = t_Rot.y * t_Rot.z * 2.0f;
+		const float WX = t_Rot.w * t_Rot.x * 2.0f;
+		const float WY = t_Rot.w * t_Rot.y * 2.0f;
+		const float WZ = t_Rot.w * t_Rot.z * 2.0f;
+
+		glm::mat4 World;
+		World[0] = glm::vec4((1.0f - (YY + ZZ)) * t_Scale.x, (XY + WZ) * t_Scale.x, (XZ - WY) * t_Scale.x, 0.0f);
+		World[1] = glm::vec4((XY - WZ) * t_Scale.y, (1.0f - (XX + ZZ)) * t_Scale.y, (YZ + WX) * t_Scale.y, 0.0f);
+		World[2] = glm::vec4((XZ + WY) * t_Scale.z, (YZ - WX) * t_Scale.z, (1.0f - (XX + YY)) * t_Scale.z, 0.0f);
+		World[3] = glm::vec4(t_Pos, 1.0f);
+		return World;
+	}
+
+	glm::quat TransformBatch::EulerToQuat(const glm::vec3& t_Degrees)
+	{
+		// yawPitchRoll is Ry * Rx * Rz
+		const glm::quat Yaw = glm::angleAxis(glm::radians(t_Degrees.y), glm::vec3(0.0f, 1.0f, 0.0f));
+		const glm::quat Pitch = glm::angleAxis(glm::radians(t_Degrees.x), glm::vec3(1.0f, 0.0f, 0.0f));
+		const glm::quat Roll = glm::angleAxis(glm::radians(t_Degrees.z), glm::vec3(0.0f, 0.0f, 1.0f));
+		return Yaw * Pitch * Roll;
+	}
+}   // namespace Fling
@@ -3,6 +3,7 @@
 #include <imgui.h>
 #include <entt/entity/registry.hpp>
 #include "imgui_entt_entity_editor.hpp"
+#include "Profiler.h"
 
 namespace Fling
 {
@@ -42,6 +43,13 @@ namespace Fling
 		bool m_DisplayWorldOutline = true;
 		bool m_DisplayWindowOptions = false;
         bool m_DisplayCameraOptions = false;
+        bool m_DisplayProfiler = false;
+
+        /** The frame that the profiler window shows. Kept while paused */
+        bool m_IsProfilerPaused = false;
+        std::vector<ProfileThreadEvents> m_ProfilerFrame;
+        uint64 m_ProfilerFrameStart = 0;
+        uint64 m_ProfilerFrameEnd = 0;
 
 		/** Component editor so that we can draw our component window */
 		entt::entity m_CompEditorEntityType = entt::null;
@@ -58,8 +66,14 @@ namespace Fling
         /** assumes that m_DisplayComponentEditor is true */
 		void DrawComponentEditor(entt::registry& t_Reg);
 
+        /** Select the entity under the mouse when the scene is clicked. @see SpatialTree::RayCastClosest */
+        void PickEntity();
+
 		void DrawWindowOptions();
 
+        /** Flame graph of the last frame's profiler zones */
+        void DrawProfiler();
+
         class World* m_OwningWorld = nullptr;
 
         class Game* m_Game = nullptr;
@@ -4,10 +4,17 @@
 #include "BaseEditor.h"
 #include "VulkanApp.h"
 #include "PhyscialDevice.h"
+#include "DeviceMemoryAllocator.h"
+#include "GpuProfiler.h"
+#include "MeshArena.h"
+#include "DescriptorAllocator.h"
+#include "Stats.h"
+#include "ResourceManager.h"
 #include "FirstPersonCamera.h"
 
 // We have to draw the ImGUI stuff somewhere, so we miind as well keep it all here!
 #include "Components/Transform.h"
+#include "Components/StaticBatch.h"
 #include "MeshRenderer.h"
 #include "Lighting/DirectionalLight.hpp"
 #include "Lighting/PointLight.hpp"
@@ -25,9 +32,14 @@ namespace Fling
     {
         void Transform(Fling::Transform& t)
         {
-            ImGui::InputFloat3( "Position", ( float* ) &t.m_Pos );
-            ImGui::InputFloat3( "Scale", ( float* )  &t.m_Scale );
-            ImGui::InputFloat3( "Rotation", ( float* )  &t.m_Rotation );
+            bool Changed = ImGui::InputFloat3( "Position", ( float* ) &t.m_Pos );
+            Changed |= ImGui::InputFloat3( "Scale", ( float* )  &t.m_Scale );
+            Changed |= ImGui::InputFloat3( "Rotation", ( float* )  &t.m_Rotation );
+
+            if (Changed)
+            {
+                t.MarkDirty();
+            }
         }
 
         void PointLight(Fling::PointLight& t_Light)
@@ -44,6 +56,24 @@ namespace Fling
             ImGui::InputFloat( "Intensity", &t_Light.Intensity );
         }
 
+        void StaticBatch(Fling::StaticBatch& t_Batch)
+        {
+            int Group = static_cast<int>(t_Batch.Group);
+            if (ImGui::InputInt("Group", &Group))
+            {
+                t_Batch.Group = static_cast<uint32>(std::max(Group, 0));
+            }
+
+            if (t_Batch.MergedInto != entt::null)
+            {
+                ImGui::Text("Merged into entity %u", static_cast<uint32>(t_Batch.MergedInto));
+            }
+            else
+            {
+                ImGui::Text("Drawn on its own");
+            }
+        }
+
         void MeshRenderer(Fling::MeshRenderer& t_MeshRend, entt::registry& t_Reg, entt::entity t_Entity)
         {
             // Model -----------------------
@@ -173,6 +203,16 @@ namespace Fling
             }
         );
 
+        m_ComponentEditor.registerTrivial<Fling::StaticBatch>(t_Reg, "Static Batch");
+        m_ComponentEditor.registerComponentWidgetFn(
+            t_Reg.type<Fling::StaticBatch>(),
+            [](entt::registry& reg, auto e)
+            {
+                auto& t = reg.get<Fling::StaticBatch>(e);
+                Widgets::StaticBatch(t);
+            }
+        );
+
         m_ComponentEditor.registerTrivial<Fling::MeshRenderer>(t_Reg, "Mesh Renderer");
         m_ComponentEditor.registerComponentWidgetFn(
             t_Reg.type<Fling::MeshRenderer>(),
@@ -200,6 +240,7 @@ namespace Fling
 
         if(m_DisplayComponentEditor)
         {
+            PickEntity();
             DrawComponentEditor(t_Reg);
         }
 
@@ -212,6 +253,11 @@ namespace Fling
         {
             DrawCameraOptions();
         }
+
+        if (m_DisplayProfiler)
+        {
+            DrawProfiler();
+        }
     }
 
     void BaseEditor::DrawCameraOptions()
@@ -302,6 +348,123 @@ namespace Fling
         }
     }
 
+    void BaseEditor::PickEntity()
+    {
+        ImGuiIO& IO = ImGui::GetIO();
+        if (IO.WantCaptureMouse || !ImGui::IsMouseClicked(0) || !m_OwningWorld)
+        {
+            return;
+        }
+
+        FirstPersonCamera* Cam = VulkanApp::Get().GetCamera();
+        if (!Cam || IO.DisplaySize.x <= 0.0f || IO.DisplaySize.y <= 0.0f)
+        {
+            return;
+        }
+
+        // Unproject the mouse at the near and far plane to get a ray through the scene
+        const glm::mat4 InvViewProj = glm::inverse(Cam->GetProjectionMatrix() * Cam->GetViewMatrix());
+        const float NdcX = 2.0f * IO.MousePos.x / IO.DisplaySize.x - 1.0f;
+        const float NdcY = 2.0f * IO.MousePos.y / IO.DisplaySize.y - 1.0f;
+
+        glm::vec4 Near = InvViewProj * glm::vec4(NdcX, NdcY, 0.0f, 1.0f);
+        glm::vec4 Far = InvViewProj * glm::vec4(NdcX, NdcY, 1.0f, 1.0f);
+        Near /= Near.w;
+        Far /= Far.w;
+
+        const glm::vec3 Origin = glm::vec3(Near);
+        const glm::vec3 Direction = glm::vec3(Far) - Origin;
+
+        // Bounds are boxes, so this picks the closest box under the mouse. Merged static meshes cover
+        // the meshes that they were made of, which are still in the tree, so those are picked instead
+        std::vector<SpatialTree::RayHit> Hits;
+        m_OwningWorld->GetSpatialTree().RayCast(Origin, Direction, glm::length(Direction), Hits);
+
+        const entt::registry& Reg = m_OwningWorld->GetRegistry();
+        for (const SpatialTree::RayHit& Hit : Hits)
+        {
+            if (!Reg.has<StaticBatchMesh>(Hit.Entity))
+            {
+                m_CompEditorEntityType = Hit.Entity;
+                break;
+            }
+        }
+    }
+
+    void BaseEditor::DrawProfiler()
+    {
+        ImGui::Begin("Profiler");
+        ImGui::SetWindowSize(ImVec2(800.0f, 300.0f), ImGuiCond_FirstUseEver);
+
+        Profiler& Prof = Profiler::Get();
+
+#if !WITH_PROFILER
+        ImGui::Text("Profiler zones are compiled out, enable WITH_PROFILER_FLAG to see them");
+#endif
+
+        ImGui::Checkbox("Pause", &m_IsProfilerPaused);
+        ImGui::SameLine();
+        if (ImGui::Button("Save Chrome Trace"))
+        {
+            Prof.WriteChromeTrace(FlingPaths::EngineLogDir() + "/Trace.json");
+        }
+
+        if (!m_IsProfilerPaused)
+        {
+            Prof.GetLastFrame(m_ProfilerFrame, m_ProfilerFrameStart, m_ProfilerFrameEnd);
+        }
+
+        if (m_ProfilerFrameEnd <= m_ProfilerFrameStart)
+        {
+            ImGui::End();
+            return;
+        }
+
+        const double NsToMs = 1.0 / 1000000.0;
+        ImGui::Text("Frame: %.3f ms", (m_ProfilerFrameEnd - m_ProfilerFrameStart) * NsToMs);
+
+        ImDrawList* DrawList = ImGui::GetWindowDrawList();
+        const float RowHeight = ImGui::GetTextLineHeightWithSpacing();
+        const float Width = ImGui::GetContentRegionAvail().x;
+        const double ToPixels = Width / static_cast<double>(m_ProfilerFrameEnd - m_ProfilerFrameStart);
+
+        for (const ProfileThreadEvents& Thread : m_ProfilerFrame)
+        {
+            ImGui::TextUnformatted(Thread.ThreadName.c_str());
+
+            const ImVec2 Origin = ImGui::GetCursorScreenPos();
+            uint32 MaxDepth = 0;
+
+            for (const ProfileEvent& Event : Thread.Events)
+            {
+                MaxDepth = std::max(MaxDepth, Event.Depth);
+
+                const float x0 = Origin.x + static_cast<float>((Event.Start - m_ProfilerFrameStart) * ToPixels);
+                const float x1 = std::max(x0 + 1.0f, Origin.x + static_cast<float>((Event.End - m_ProfilerFrameStart) * ToPixels));
+                const float y0 = Origin.y + Event.Depth * RowHeight;
+                const ImVec2 Min(x0, y0);
+                const ImVec2 Max(x1, y0 + RowHeight - 1.0f);
+
+                // Color by the name's address so that a zone keeps its color from frame to frame
+                const float Hue = static_cast<float>((reinterpret_cast<uintptr_t>(Event.Name) >> 3) % 32) / 32.0f;
+                DrawList->AddRectFilled(Min, Max, ImColor::HSV(Hue, 0.5f, 0.6f));
+
+                DrawList->PushClipRect(Min, Max, true);
+                DrawList->AddText(ImVec2(x0 + 2.0f, y0), IM_COL32_WHITE, Event.Name);
+                DrawList->PopClipRect();
+
+                if (ImGui::IsMouseHoveringRect(Min, Max))
+                {
+                    ImGui::SetTooltip("%s: %.3f ms", Event.Name, (Event.End - Event.Start) * NsToMs);
+                }
+            }
+
+            ImGui::Dummy(ImVec2(Width, (MaxDepth + 1) * RowHeight));
+        }
+
+        ImGui::End();
+    }
+
     void BaseEditor::DrawWindowOptions()
     {
         ImGui::Begin("Window Options");
@@ -414,6 +577,7 @@ namespace Fling
             {
                 ImGui::Checkbox("GPU Info", &m_DisplayGPUInfo);
 				ImGui::Checkbox("Camera Options", &m_DisplayCameraOptions);
+                ImGui::Checkbox("Profiler", &m_DisplayProfiler);
                 ImGui::EndMenu();
             }
 
@@ -501,6 +665,154 @@ namespace Fling
             ImGui::Text("FPS: %f", frameTime);
             ImGui::PlotLines("FPS", &fpsGraph[0], fpsGraph.size(), 0, "", m_FrameTimeMin, m_FrameTimeMax, ImVec2(0, 80));
         }
+
+        if (DeviceMemoryAllocator* Allocator = VulkanApp::Get().GetMemoryAllocator())
+        {
+            if (ImGui::CollapsingHeader("Device Memory"))
+            {
+                const DeviceMemoryStats Stats = Allocator->GetStats();
+                const float ToMB = 1.0f / (1024.0f * 1024.0f);
+
+                ImGui::Text("Blocks: %u (%.2f / %.2f MB used)", Stats.BlockCount, Stats.BlockUsedBytes * ToMB, Stats.BlockBytes * ToMB);
+                ImGui::Text("Dedicated: %u (%.2f MB)", Stats.DedicatedAllocationCount, Stats.DedicatedBytes * ToMB);
+                ImGui::Text("Allocations: %u", Stats.AllocationCount);
+                ImGui::Text("vkAllocateMemory calls: %u / %u", Stats.VkAllocationCount, PhysDev->GetDeviceProps().limits.maxMemoryAllocationCount);
+                ImGui::Text("Fragmentation: %.1f%% (%u free regions)", Stats.Fragmentation * 100.0f, Stats.FreeRegionCount);
+
+                for (size_t i = 0; i < static_cast<size_t>(DeviceMemoryCategory::Count); ++i)
+                {
+                    ImGui::BulletText("%s: %.2f MB", DeviceMemoryCategoryToString(static_cast<DeviceMemoryCategory>(i)), Stats.CategoryBytes[i] * ToMB);
+                }
+            }
+        }
+
+        if (GpuProfiler* GpuProf = VulkanApp::Get().GetGpuProfiler())
+        {
+            if (ImGui::CollapsingHeader("GPU Passes"))
+            {
+                if (!GpuProf->SupportsTimestamps())
+                {
+                    ImGui::Text("This device does not support timestamp queries");
+                }
+                else
+                {
+                    bool IsEnabled = GpuProf->WantsEnabled();
+                    if (ImGui::Checkbox("Enabled", &IsEnabled))
+                    {
+                        GpuProf->SetEnabled(IsEnabled);
+                    }
+
+                    ImGui::Text("Frame %llu: %.3f ms (avg %.3f ms)",
+                        static_cast<unsigned long long>(Stats::Gpu::GetFrameNumber()), Stats::Gpu::GetFrameTimeMs(), Stats::Gpu::GetAverageFrameTimeMs());
+
+                    ImGui::Columns(GpuProf->SupportsPipelineStatistics() ? 4 : 2, "GpuPasses");
+                    ImGui::Text("Pass"); ImGui::NextColumn();
+                    ImGui::Text("ms"); ImGui::NextColumn();
+                    if (GpuProf->SupportsPipelineStatistics())
+                    {
+                        ImGui::Text("Vertices"); ImGui::NextColumn();
+                        ImGui::Text("Fragments"); ImGui::NextColumn();
+                    }
+                    ImGui::Separator();
+
+                    for (const Stats::GpuPass& Pass : Stats::Gpu::GetPasses())
+                    {
+                        ImGui::Text("%s", Pass.Name.c_str()); ImGui::NextColumn();
+                        ImGui::Text("%.3f", Pass.TimeMs); ImGui::NextColumn();
+                        if (GpuProf->SupportsPipelineStatistics())
+                        {
+                            ImGui::Text("%llu", static_cast<unsigned long long>(Pass.VertexInvocations)); ImGui::NextColumn();
+                            ImGui::Text("%llu", static_cast<unsigned long long>(Pass.FragmentInvocations)); ImGui::NextColumn();
+                        }
+                    }
+                    ImGui::Columns(1);
+
+                    if (GpuProf->IsDumping())
+                    {
+                        if (ImGui::Button("Stop Dump"))
+                        {
+                            GpuProf->StopDump();
+                        }
+                    }
+                    else
+                    {
+                        if (ImGui::Button("Dump CSV"))
+                        {
+                            GpuProf->StartDump(FlingPaths::EngineLogDir() + "/GpuStats.csv");
+                        }
+                        ImGui::SameLine();
+                        if (ImGui::Button("Dump JSON"))
+                        {
+                            GpuProf->StartDump(FlingPaths::EngineLogDir() + "/GpuStats.json");
+                        }
+                    }
+                }
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Draw Calls"))
+        {
+            const Stats::DrawCounts& Draws = Stats::Draws::GetLastFrame();
+            ImGui::Text("Meshes: %u submitted, %u culled, %u occluded", Draws.MeshesSubmitted, Draws.MeshesCulled, Draws.MeshesOccluded);
+            ImGui::Text("Draw calls: %u (%u instances)", Draws.DrawCalls, Draws.Instances);
+            ImGui::Text("Pipeline binds: %u", Draws.PipelineBinds);
+            ImGui::Text("Descriptor set binds: %u", Draws.DescriptorSetBinds);
+            ImGui::Text("Vertex buffer binds: %u", Draws.VertexBufferBinds);
+            ImGui::Text("Index buffer binds: %u", Draws.IndexBufferBinds);
+        }
+
+        if (ImGui::CollapsingHeader("Resources"))
+        {
+            const ResourceManager& Resources = ResourceManager::Get();
+            const float ToMB = 1.0f / (1024.0f * 1024.0f);
+
+            ImGui::Text("CPU: %.2f MB", Resources.GetCpuMemoryUsage() * ToMB);
+            ImGui::Text("GPU: %.2f MB", Resources.GetGpuMemoryUsage() * ToMB);
+            ImGui::Text("Pending loads: %u", static_cast<uint32>(Resources.GetPendingLoadCount()));
+            ImGui::Text("Unloaded to stay in budget: %u", static_cast<uint32>(Resources.GetEvictionCount()));
+
+            if (MeshArena* Arena = VulkanApp::Get().GetMeshArena())
+            {
+                const MeshArenaStats ArenaStats = Arena->GetStats();
+                ImGui::Separator();
+                ImGui::Text("Mesh arena: %u meshes", ArenaStats.MeshCount);
+                ImGui::Text("Vertices: %.2f / %.2f MB", ArenaStats.VertexBytesUsed * ToMB, ArenaStats.VertexBytes * ToMB);
+                ImGui::Text("Indices: %.2f / %.2f MB", ArenaStats.IndexBytesUsed * ToMB, ArenaStats.IndexBytes * ToMB);
+                ImGui::Text("Free regions: %u, rebuilt %u times", ArenaStats.FreeRegionCount, ArenaStats.RebuildCount);
+                if (ImGui::Button("Compact"))
+                {
+                    Arena->Compact();
+                }
+            }
+
+            if (DescriptorAllocator* Descriptors = VulkanApp::Get().GetDescriptorAllocator())
+            {
+                const DescriptorAllocatorStats DescStats = Descriptors->GetStats();
+                ImGui::Separator();
+                ImGui::Text("Descriptor sets: %u in %u pools", DescStats.PersistentSets, DescStats.PersistentPools);
+                ImGui::Text("Transient: %u sets this frame, %u pools", DescStats.TransientSetsThisFrame, DescStats.TransientPools);
+                ImGui::Text("Cached: %u sets, %llu hits, %llu misses", DescStats.CachedSets,
+                    static_cast<unsigned long long>(DescStats.CacheHits), static_cast<unsigned long long>(DescStats.CacheMisses));
+                ImGui::Text("Pools made since startup: %u", DescStats.PoolsCreated);
+            }
+
+            if (m_OwningWorld)
+            {
+                uint32 SourceCount = 0;
+                auto Merged = m_OwningWorld->GetRegistry().view<StaticBatchMesh>();
+                for (entt::entity Ent : Merged)
+                {
+                    SourceCount += static_cast<uint32>(Merged.get(Ent).Sources.size());
+                }
+
+                ImGui::Separator();
+                ImGui::Text("Static batches: %u meshes merged into %u", SourceCount, static_cast<uint32>(Merged.size()));
+                if (ImGui::Button("Rebuild Static Batches"))
+                {
+                    m_OwningWorld->BuildStaticBatches();
+                }
+            }
+        }
         ImGui::End();
     }
 }   // namespace Fling
@@ -1,10 +1,6 @@
 #pragma once
 
+// The core building blocks of the engine. Nothing in here can depend on the rest of Fling
 #include "FoundationAPI.h"
-
-class FOUNDATION_API FoundationClass
-{
-public:
-    static bool RunFoundationFunction();
-
-};
\ No newline at end of file
+#include "JobSystem.h"
+#include "RadixSort.h"
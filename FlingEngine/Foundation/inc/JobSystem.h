@@ -0,0 +1,278 @@
+#pragma once
+
+#include "FoundationAPI.h"
+#include "WorkStealingQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Fling
+{
+	class JobSystem;
+
+	/**
+	 * @brief 	Counts jobs that have not finished yet. Pass one to JobSystem::Run for every job in a
+	 *			group and JobSystem::Wait on it to wait for the whole group.
+	 */
+	class FOUNDATION_API JobCounter
+	{
+		friend class JobSystem;
+
+	public:
+
+		JobCounter() = default;
+
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		bool IsDone() const { return m_Count.load(std::memory_order_acquire) == 0; }
+
+	private:
+
+		std::atomic<int32_t> m_Count { 0 };
+	};
+
+	/**
+	 * @brief 	A unit of work. Jobs are allocated from a ring per worker, and a slot is only handed out
+	 *			again once its job has finished. A job that is created has to be run, or its slot is never
+	 *			given back. Fits in two cache lines so that neighboring jobs don't false share.
+	 */
+	struct alignas(64) Job
+	{
+		/** Most continuations a single job can have */
+		static constexpr int32_t MAX_CONTINUATIONS = 4;
+
+		/** Bytes available for a lambda's captures */
+		static constexpr size_t DATA_SIZE = 64;
+
+		typedef void (*JobFunction)(Job&);
+
+		JobFunction Function = nullptr;
+
+		/** Finishes when this and all of its children have finished */
+		Job* Parent = nullptr;
+
+		JobCounter* Counter = nullptr;
+
+		/** This job plus any children that are not done */
+		std::atomic<int32_t> UnfinishedJobs { 0 };
+
+		std::atomic<int32_t> ContinuationCount { 0 };
+
+		/** Run once this job is finished */
+		Job* Continuations[MAX_CONTINUATIONS] = {};
+
+		/** Where the lambda is stored. @see JobSystem::CreateJob */
+		alignas(16) unsigned char Data[DATA_SIZE];
+	};
+
+	static_assert(sizeof(Job) == 128, "Jobs should stay at two cache lines");
+
+	/**
+	 * @brief 	A work stealing job system with one worker per core. The thread that calls Init is
+	 *			worker 0, and helps run jobs whenever it waits on one. Every worker has a Chase-Lev
+	 *			deque, and idle workers steal from random other workers.
+	 *
+	 *			Jobs can be created and run from any thread. Threads that are not workers share
+	 *			a locked queue instead of having their own.
+	 *
+	 * @see https://blog.molecular-matters.com/2015/08/24/job-system-2-0-lock-free-work-stealing-part-1-basics/
+	 */
+	class FOUNDATION_API JobSystem
+	{
+	public:
+
+		/** Jobs in the ring of a single worker. Also the most jobs a worker can have queued */
+		static constexpr uint32_t MAX_JOBS_PER_WORKER = 4096;
+
+		static_assert((MAX_JOBS_PER_WORKER & (MAX_JOBS_PER_WORKER - 1)) == 0, "MAX_JOBS_PER_WORKER must be a power of 2!");
+
+		/** Most jobs a single ParallelFor makes, so that it leaves room in the ring for other jobs */
+		static constexpr uint32_t MAX_PARALLEL_FOR_CHUNKS = MAX_JOBS_PER_WORKER / 8;
+
+		static JobSystem& Get();
+
+		~JobSystem();
+
+		/**
+		 * @brief	Start the worker threads. The calling thread becomes worker 0.
+		 * @param t_WorkerCount 	Total workers including the calling thread. 0 means one per core
+		 * @param t_PinThreads 		Pin each worker thread to its own core
+		 */
+		void Init(uint32_t t_WorkerCount = 0, bool t_PinThreads = false);
+
+		/** Stop and join the workers. Jobs that have not been run yet are dropped */
+		void Shutdown();
+
+		/** Number of workers including the thread that called Init. 1 if not initialized */
+		uint32_t GetWorkerCount() const { return std::max<uint32_t>(static_cast<uint32_t>(m_Workers.size()), 1u); }
+
+		bool IsInitialized() const { return !m_Workers.empty(); }
+
+		/** Create a job that calls t_Func(). The lambda has to fit in Job::DATA_SIZE */
+		template<typename F>
+		Job* CreateJob(F&& t_Func);
+
+		/** Create a job that t_Parent will not be finished without */
+		template<typename F>
+		Job* CreateChildJob(Job* t_Parent, F&& t_Func);
+
+		/**
+		 * @brief	Run t_Continuation once t_Job is finished. Has to be called before t_Job is run
+		 * @return False if t_Job already has Job::MAX_CONTINUATIONS
+		 */
+		bool AddContinuation(Job* t_Job, Job* t_Continuation);
+
+		/**
+		 * @brief	Queue a job to be run on any worker
+		 * @param t_Counter 	Optional counter to track this job with
+		 */
+		void Run(Job* t_Job, JobCounter* t_Counter = nullptr);
+
+		/** Run other jobs on this thread until t_Job and its children are finished */
+		void Wait(const Job* t_Job);
+
+		/** Run other jobs on this thread until every job on the counter is finished */
+		void Wait(const JobCounter& t_Counter);
+
+		/**
+		 * @brief	Call t_Func(Begin, End) over [0, t_Count) split into chunks across the workers.
+		 *			Blocks until every chunk is done, with this thread helping.
+		 * @param t_ChunkSize 	Indices per job. 0 picks enough chunks to balance across the workers.
+		 *						Raised if it would take more than MAX_PARALLEL_FOR_CHUNKS jobs
+		 */
+		template<typename F>
+		void ParallelFor(uint32_t t_Count, F&& t_Func, uint32_t t_ChunkSize = 0);
+
+	private:
+
+		struct Worker;
+
+		JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		/** Get a free job from the ring of the current thread, running other jobs until one finishes if they are all in use */
+		Job* AllocateJob();
+
+		/** Find a job to run: own queue first, then the shared queue, then steal */
+		Job* GetJob();
+
+		void Execute(Job* t_Job);
+
+		void Finish(Job* t_Job);
+
+		void WorkerThreadMain(uint32_t t_Index, bool t_PinThread);
+
+		/** Thunk that calls the lambda stored in a job's data and destroys it */
+		template<typename F>
+		static void CallStoredFunction(Job& t_Job);
+
+		std::vector<std::unique_ptr<Worker>> m_Workers;
+
+		/** Jobs from threads that are not workers */
+		std::deque<Job*> m_SharedQueue;
+
+		/** Size of m_SharedQueue, so workers can skip the lock when it is empty */
+		std::atomic<uint32_t> m_SharedQueueSize { 0 };
+
+		std::mutex m_SharedMutex;
+
+		/** Ring for threads that are not workers, shared with an atomic index */
+		std::unique_ptr<Job[]> m_SharedJobPool;
+
+		std::atomic<uint32_t> m_SharedJobIndex { 0 };
+
+		std::atomic<bool> m_IsRunning { false };
+
+		/** Idle workers sleep on this until there is new work */
+		std::condition_variable m_WakeCondition;
+
+		std::mutex m_WakeMutex;
+
+		std::atomic<int32_t> m_SleepingWorkers { 0 };
+	};
+
+	template<typename F>
+	inline void JobSystem::CallStoredFunction(Job& t_Job)
+	{
+		F* Func = std::launder(reinterpret_cast<F*>(t_Job.Data));
+		(*Func)();
+		Func->~F();
+	}
+
+	template<typename F>
+	inline Job* JobSystem::CreateJob(F&& t_Func)
+	{
+		typedef typename std::decay<F>::type FuncType;
+		static_assert(sizeof(FuncType) <= Job::DATA_SIZE, "Job lambda captures too much! Capture pointers instead");
+		static_assert(alignof(FuncType) <= 16, "Job lambda is over aligned");
+
+		Job* NewJob = AllocateJob();
+		NewJob->Function = &JobSystem::CallStoredFunction<FuncType>;
+		NewJob->Parent = nullptr;
+		NewJob->Counter = nullptr;
+		NewJob->UnfinishedJobs.store(1, std::memory_order_relaxed);
+		NewJob->ContinuationCount.store(0, std::memory_order_relaxed);
+		new (NewJob->Data) FuncType(std::forward<F>(t_Func));
+		return NewJob;
+	}
+
+	template<typename F>
+	inline Job* JobSystem::CreateChildJob(Job* t_Parent, F&& t_Func)
+	{
+		Job* NewJob = CreateJob(std::forward<F>(t_Func));
+		if (t_Parent)
+		{
+			t_Parent->UnfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+			NewJob->Parent = t_Parent;
+		}
+		return NewJob;
+	}
+
+	template<typename F>
+	inline void JobSystem::ParallelFor(uint32_t t_Count, F&& t_Func, uint32_t t_ChunkSize)
+	{
+		if (t_Count == 0)
+		{
+			return;
+		}
+
+		// A few chunks per worker so that stealing can even out chunks that take longer
+		if (t_ChunkSize == 0)
+		{
+			t_ChunkSize = std::max<uint32_t>(1u, t_Count / (GetWorkerCount() * 4u));
+		}
+
+		// Small chunks of a huge range would fill the ring, so make them bigger instead
+		const uint32_t MinChunkSize = t_Count / MAX_PARALLEL_FOR_CHUNKS + ((t_Count % MAX_PARALLEL_FOR_CHUNKS) ? 1u : 0u);
+		t_ChunkSize = std::max(t_ChunkSize, MinChunkSize);
+
+		if (t_Count <= t_ChunkSize || GetWorkerCount() == 1)
+		{
+			t_Func(0u, t_Count);
+			return;
+		}
+
+		JobCounter Counter;
+		for (uint32_t Begin = 0; Begin < t_Count; Begin += t_ChunkSize)
+		{
+			const uint32_t End = std::min(Begin + t_ChunkSize, t_Count);
+			typename std::remove_reference<F>::type* Func = &t_Func;
+			Run(CreateJob([Func, Begin, End]() { (*Func)(Begin, End); }), &Counter);
+		}
+
+		Wait(Counter);
+	}
+}   // namespace Fling
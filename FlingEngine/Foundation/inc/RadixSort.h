@@ -0,0 +1,22 @@
+#pragma once
+
+#include "FoundationAPI.h"
+
+#include <cstdint>
+
+namespace Fling
+{
+	/**
+	 * @brief	Sort 64 bit keys in ascending order and move a 32 bit value along with each key.
+	 *			This is a stable LSD radix sort with 8 bit digits. Any digit that is the same in
+	 *			every key is skipped, so keys that only use their low bits sort faster. Large
+	 *			arrays have their histogram and scatter passes split across the JobSystem workers.
+	 *
+	 * @param t_Keys 		Keys to sort. Sorted in place
+	 * @param t_Values 		Value of each key. Reordered the same way as the keys
+	 * @param t_TempKeys 	Scratch space for t_Count keys
+	 * @param t_TempValues 	Scratch space for t_Count values
+	 * @param t_Count 		Number of keys
+	 */
+	FOUNDATION_API void RadixSort(uint64_t* t_Keys, uint32_t* t_Values, uint64_t* t_TempKeys, uint32_t* t_TempValues, uint32_t t_Count);
+}   // namespace Fling
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Fling
+{
+	struct Job;
+
+	/**
+	 * @brief 	A fixed size Chase-Lev work stealing deque of jobs. The owning worker pushes and
+	 *			pops at the bottom (LIFO, so it works on what is hot in its cache) while other
+	 *			workers steal from the top (FIFO). Only the owner may call Push and Pop.
+	 *
+	 * @see https://blog.molecular-matters.com/2015/09/25/job-system-2-0-lock-free-work-stealing-part-3-going-lock-free/
+	 */
+	class WorkStealingQueue
+	{
+	public:
+
+		/** Must be a power of 2 so that indices can be masked */
+		static constexpr int64_t CAPACITY = 4096;
+
+		WorkStealingQueue() = default;
+
+		WorkStealingQueue(const WorkStealingQueue&) = delete;
+		WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+		/** @return False if the queue is full. Owner only */
+		bool Push(Job* t_Job);
+
+		/** @return The most recently pushed job, or nullptr if empty. Owner only */
+		Job* Pop();
+
+		/** @return The oldest job, or nullptr if empty or another thread got it first. Any thread */
+		Job* Steal();
+
+		/** Approximate, other threads may be pushing or stealing */
+		size_t Size() const;
+
+	private:
+
+		static_assert((CAPACITY & (CAPACITY - 1)) == 0, "WorkStealingQueue::CAPACITY must be a power of 2!");
+
+		static constexpr int64_t MASK = CAPACITY - 1;
+
+		// Top and bottom are on their own cache lines because thieves hammer top
+		alignas(64) std::atomic<int64_t> m_Top { 0 };
+
+		alignas(64) std::atomic<int64_t> m_Bottom { 0 };
+
+		alignas(64) std::atomic<Job*> m_Jobs[CAPACITY] = {};
+	};
+
+	inline bool WorkStealingQueue::Push(Job* t_Job)
+	{
+		const int64_t Bottom = m_Bottom.load(std::memory_order_relaxed);
+		const int64_t Top = m_Top.load(std::memory_order_acquire);
+		if (Bottom - Top >= CAPACITY)
+		{
+			return false;
+		}
+
+		m_Jobs[Bottom & MASK].store(t_Job, std::memory_order_relaxed);
+
+		// The job has to be visible before a thief can see the new bottom
+		m_Bottom.store(Bottom + 1, std::memory_order_release);
+		return true;
+	}
+
+	inline Job* WorkStealingQueue::Pop()
+	{
+		const int64_t Bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+		m_Bottom.store(Bottom, std::memory_order_relaxed);
+
+		// The store to bottom has to happen before reading top or a thief could take the same job
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		int64_t Top = m_Top.load(std::memory_order_relaxed);
+		if (Top > Bottom)
+		{
+			// Empty, put bottom back
+			m_Bottom.store(Bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Job* Result = m_Jobs[Bottom & MASK].load(std::memory_order_relaxed);
+		if (Top != Bottom)
+		{
+			// More than one job left, no thief can be racing for this one
+			return Result;
+		}
+
+		// This is the last job, so race any thieves for it
+		if (!m_Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			Result = nullptr;
+		}
+		m_Bottom.store(Bottom + 1, std::memory_order_relaxed);
+		return Result;
+	}
+
+	inline Job* WorkStealingQueue::Steal()
+	{
+		int64_t Top = m_Top.load(std::memory_order_acquire);
+
+		// Top has to be read before bottom, the opposite order of Pop
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		const int64_t Bottom = m_Bottom.load(std::memory_order_acquire);
+		if (Top >= Bottom)
+		{
+			return nullptr;
+		}
+
+		Job* Result = m_Jobs[Top & MASK].load(std::memory_order_relaxed);
+
+		// Another thief or the owner may have taken it in the meantime
+		if (!m_Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return nullptr;
+		}
+		return Result;
+	}
+
+	inline size_t WorkStealingQueue::Size() const
+	{
+		const int64_t Count = m_Bottom.load(std::memory_order_relaxed) - m_Top.load(std::memory_order_relaxed);
+		return Count > 0 ? static_cast<size_t>(Count) : 0;
+	}
+}   // namespace Fling
@@ -1,6 +0,0 @@
-#include "Foundation.h"
-
-bool FoundationClass::RunFoundationFunction()
-{
-    return true;
-}
\ No newline at end of file
@@ -0,0 +1,404 @@
+#include "JobSystem.h"
+
+#include <chrono>
+
+#if _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#elif __linux__
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+namespace Fling
+{
+	namespace
+	{
+		const uint32_t NOT_A_WORKER = ~0u;
+
+		/** How many times an idle worker looks for work before going to sleep */
+		const uint32_t IDLE_SPIN_COUNT = 64;
+
+		/** Index of the worker that is running on this thread */
+		thread_local uint32_t CurrentWorkerIndex = NOT_A_WORKER;
+
+		/** Picks who to steal from first so that idle workers don't all hit the same queue */
+		thread_local uint32_t StealSeed = 0x9E3779B9u;
+
+		uint32_t NextStealIndex()
+		{
+			// xorshift32
+			uint32_t x = StealSeed;
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			StealSeed = x;
+			return x;
+		}
+
+		void PinCurrentThread(uint32_t t_Core)
+		{
+			const uint32_t CoreCount = std::max(1u, std::thread::hardware_concurrency());
+			t_Core %= CoreCount;
+
+#if _WIN32
+			SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << (t_Core % 64));
+#elif __linux__
+			cpu_set_t CpuSet;
+			CPU_ZERO(&CpuSet);
+			CPU_SET(t_Core % CPU_SETSIZE, &CpuSet);
+			pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &CpuSet);
+#endif
+		}
+	}
+
+	struct JobSystem::Worker
+	{
+		WorkStealingQueue Queue;
+
+		std::unique_ptr<Job[]> JobPool { new Job[MAX_JOBS_PER_WORKER] };
+
+		/** Only touched by the thread that owns this worker */
+		uint32_t AllocatedJobs = 0;
+
+		std::thread Thread;
+	};
+
+	JobSystem& JobSystem::Get()
+	{
+		static JobSystem Instance;
+		return Instance;
+	}
+
+	JobSystem::JobSystem()
+		: m_SharedJobPool(new Job[MAX_JOBS_PER_WORKER])
+	{
+	}
+
+	JobSystem::~JobSystem()
+	{
+		Shutdown();
+	}
+
+	void JobSystem::Init(uint32_t t_WorkerCount, bool t_PinThreads)
+	{
+		if (IsInitialized())
+		{
+			return;
+		}
+
+		if (t_WorkerCount == 0)
+		{
+			t_WorkerCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		// Every worker has to exist before any thread starts stealing from them
+		m_Workers.reserve(t_WorkerCount);
+		for (uint32_t i = 0; i < t_WorkerCount; ++i)
+		{
+			m_Workers.emplace_back(std::make_unique<Worker>());
+		}
+
+		m_IsRunning = true;
+
+		// The calling thread is worker 0, it runs jobs while it waits on them
+		CurrentWorkerIndex = 0;
+		if (t_PinThreads)
+		{
+			PinCurrentThread(0);
+		}
+
+		for (uint32_t i = 1; i < t_WorkerCount; ++i)
+		{
+			m_Workers[i]->Thread = std::thread(&JobSystem::WorkerThreadMain, this, i, t_PinThreads);
+		}
+	}
+
+	void JobSystem::Shutdown()
+	{
+		if (!IsInitialized())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> Lock(m_WakeMutex);
+			m_IsRunning = false;
+		}
+		m_WakeCondition.notify_all();
+
+		for (std::unique_ptr<Worker>& Cur : m_Workers)
+		{
+			if (Cur->Thread.joinable())
+			{
+				Cur->Thread.join();
+			}
+		}
+		m_Workers.clear();
+
+		{
+			std::lock_guard<std::mutex> Lock(m_SharedMutex);
+			m_SharedQueue.clear();
+			m_SharedQueueSize = 0;
+		}
+
+		// Dropped jobs will never finish, so give their slots in the shared ring back
+		for (uint32_t i = 0; i < MAX_JOBS_PER_WORKER; ++i)
+		{
+			m_SharedJobPool[i].UnfinishedJobs.store(0, std::memory_order_relaxed);
+		}
+
+		CurrentWorkerIndex = NOT_A_WORKER;
+	}
+
+	bool JobSystem::AddContinuation(Job* t_Job, Job* t_Continuation)
+	{
+		const int32_t Index = t_Job->ContinuationCount.fetch_add(1, std::memory_order_relaxed);
+		if (Index >= Job::MAX_CONTINUATIONS)
+		{
+			t_Job->ContinuationCount.fetch_sub(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		t_Job->Continuations[Index] = t_Continuation;
+		return true;
+	}
+
+	void JobSystem::Run(Job* t_Job, JobCounter* t_Counter)
+	{
+		if (t_Counter)
+		{
+			t_Counter->m_Count.fetch_add(1, std::memory_order_relaxed);
+			t_Job->Counter = t_Counter;
+		}
+
+		// Without any workers everything runs right away
+		if (!IsInitialized())
+		{
+			Execute(t_Job);
+			return;
+		}
+
+		bool IsQueued = false;
+		const uint32_t Index = CurrentWorkerIndex;
+		if (Index < m_Workers.size())
+		{
+			IsQueued = m_Workers[Index]->Queue.Push(t_Job);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> Lock(m_SharedMutex);
+			m_SharedQueue.push_back(t_Job);
+			m_SharedQueueSize.fetch_add(1, std::memory_order_release);
+			IsQueued = true;
+		}
+
+		// A full queue means there is already plenty for the other workers to steal
+		if (!IsQueued)
+		{
+			Execute(t_Job);
+			return;
+		}
+
+		if (m_SleepingWorkers.load(std::memory_order_relaxed) > 0)
+		{
+			m_WakeCondition.notify_one();
+		}
+	}
+
+	void JobSystem::Wait(const Job* t_Job)
+	{
+		while (t_Job->UnfinishedJobs.load(std::memory_order_acquire) > 0)
+		{
+			if (Job* Next = GetJob())
+			{
+				Execute(Next);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void JobSystem::Wait(const JobCounter& t_Counter)
+	{
+		while (!t_Counter.IsDone())
+		{
+			if (Job* Next = GetJob())
+			{
+				Execute(Next);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	Job* JobSystem::AllocateJob()
+	{
+		const uint32_t Index = CurrentWorkerIndex;
+		Worker* Cur = Index < m_Workers.size() ? m_Workers[Index].get() : nullptr;
+		Job* Pool = Cur ? Cur->JobPool.get() : m_SharedJobPool.get();
+
+		while (true)
+		{
+			// Skip over slots whose job is still queued or running. The slot is claimed with a CAS
+			// because the shared ring is used by more than one thread
+			for (uint32_t i = 0; i < MAX_JOBS_PER_WORKER; ++i)
+			{
+				const uint32_t Next = Cur ? Cur->AllocatedJobs++ : m_SharedJobIndex.fetch_add(1, std::memory_order_relaxed);
+				Job& Slot = Pool[Next & (MAX_JOBS_PER_WORKER - 1u)];
+
+				int32_t Unfinished = 0;
+				if (Slot.UnfinishedJobs.compare_exchange_strong(Unfinished, 1, std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					return &Slot;
+				}
+			}
+
+			// Every job in the ring is still in use, so help finish one of them
+			if (Job* Next = GetJob())
+			{
+				Execute(Next);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	Job* JobSystem::GetJob()
+	{
+		const uint32_t WorkerCount = static_cast<uint32_t>(m_Workers.size());
+		const uint32_t Index = CurrentWorkerIndex;
+
+		if (Index < WorkerCount)
+		{
+			if (Job* Own = m_Workers[Index]->Queue.Pop())
+			{
+				return Own;
+			}
+		}
+
+		if (m_SharedQueueSize.load(std::memory_order_acquire) > 0)
+		{
+			std::lock_guard<std::mutex> Lock(m_SharedMutex);
+			if (!m_SharedQueue.empty())
+			{
+				Job* Shared = m_SharedQueue.front();
+				m_SharedQueue.pop_front();
+				m_SharedQueueSize.fetch_sub(1, std::memory_order_relaxed);
+				return Shared;
+			}
+		}
+
+		// Try every other worker, starting from a random one
+		const uint32_t Start = WorkerCount ? NextStealIndex() % WorkerCount : 0;
+		for (uint32_t i = 0; i < WorkerCount; ++i)
+		{
+			const uint32_t Victim = (Start + i) % WorkerCount;
+			if (Victim == Index)
+			{
+				continue;
+			}
+
+			if (Job* Stolen = m_Workers[Victim]->Queue.Steal())
+			{
+				return Stolen;
+			}
+		}
+
+		return nullptr;
+	}
+
+	void JobSystem::Execute(Job* t_Job)
+	{
+		t_Job->Function(*t_Job);
+		Finish(t_Job);
+	}
+
+	void JobSystem::Finish(Job* t_Job)
+	{
+		// Read everything before the job is marked as done, its slot in the ring can be
+		// reused by whoever was waiting on it as soon as it is
+		Job* Parent = t_Job->Parent;
+		JobCounter* Counter = t_Job->Counter;
+
+		Job* Continuations[Job::MAX_CONTINUATIONS] = {};
+		const int32_t ContinuationCount = std::min(t_Job->ContinuationCount.load(std::memory_order_acquire), Job::MAX_CONTINUATIONS);
+		for (int32_t i = 0; i < ContinuationCount; ++i)
+		{
+			Continuations[i] = t_Job->Continuations[i];
+		}
+
+		// Children that are still running will finish this job
+		if (t_Job->UnfinishedJobs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		{
+			return;
+		}
+
+		for (int32_t i = 0; i < ContinuationCount; ++i)
+		{
+			Run(Continuations[i]);
+		}
+
+		if (Counter)
+		{
+			Counter->m_Count.fetch_sub(1, std::memory_order_release);
+		}
+
+		if (Parent)
+		{
+			Finish(Parent);
+		}
+	}
+
+	void JobSystem::WorkerThreadMain(uint32_t t_Index, bool t_PinThread)
+	{
+		CurrentWorkerIndex = t_Index;
+		StealSeed = 0x9E3779B9u * (t_Index + 1u);
+
+		if (t_PinThread)
+		{
+			PinCurrentThread(t_Index);
+		}
+
+		uint32_t IdleCount = 0;
+		while (m_IsRunning.load(std::memory_order_relaxed))
+		{
+			if (Job* Next = GetJob())
+			{
+				Execute(Next);
+				IdleCount = 0;
+				continue;
+			}
+
+			if (++IdleCount < IDLE_SPIN_COUNT)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			// Nothing to do for a while, so sleep until a job is queued. The timeout covers a
+			// job that was queued right before this worker started waiting
+			std::unique_lock<std::mutex> Lock(m_WakeMutex);
+			if (m_IsRunning)
+			{
+				m_SleepingWorkers.fetch_add(1, std::memory_order_relaxed);
+				m_WakeCondition.wait_for(Lock, std::chrono::milliseconds(1));
+				m_SleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+			}
+			IdleCount = 0;
+		}
+
+		CurrentWorkerIndex = NOT_A_WORKER;
+	}
+}   // namespace Fling
@@ -0,0 +1,133 @@
+#include "RadixSort.h"
+#include "JobSystem.h"
+
+#include <cstring>
+#include <vector>
+
+namespace Fling
+{
+	namespace
+	{
+		const uint32_t RADIX_BITS = 8;
+
+		const uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+
+		const uint32_t DIGIT_COUNT = 64 / RADIX_BITS;
+
+		/** Arrays smaller than this per worker are not worth splitting up */
+		const uint32_t MIN_KEYS_PER_CHUNK = 4096;
+
+		inline uint32_t GetDigit(uint64_t t_Key, uint32_t t_Digit)
+		{
+			return static_cast<uint32_t>(t_Key >> (t_Digit * RADIX_BITS)) & (RADIX_SIZE - 1);
+		}
+	}
+
+	void RadixSort(uint64_t* t_Keys, uint32_t* t_Values, uint64_t* t_TempKeys, uint32_t* t_TempValues, uint32_t t_Count)
+	{
+		if (t_Count < 2)
+		{
+			return;
+		}
+
+		JobSystem& Jobs = JobSystem::Get();
+
+		const uint32_t ChunkCount = std::max(1u, std::min(Jobs.GetWorkerCount(), t_Count / MIN_KEYS_PER_CHUNK));
+		const uint32_t ChunkSize = (t_Count + ChunkCount - 1) / ChunkCount;
+
+		// Find the bits that are not the same in every key
+		std::vector<uint64_t> ChunkDifferences(ChunkCount, 0);
+		Jobs.ParallelFor(ChunkCount, [&](uint32_t t_Begin, uint32_t t_End)
+		{
+			for (uint32_t Chunk = t_Begin; Chunk < t_End; ++Chunk)
+			{
+				const uint32_t Begin = Chunk * ChunkSize;
+				const uint32_t End = std::min(Begin + ChunkSize, t_Count);
+
+				uint64_t Difference = 0;
+				for (uint32_t i = Begin; i < End; ++i)
+				{
+					Difference |= t_Keys[i] ^ t_Keys[0];
+				}
+				ChunkDifferences[Chunk] = Difference;
+			}
+		}, 1);
+
+		uint64_t Difference = 0;
+		for (uint64_t ChunkDifference : ChunkDifferences)
+		{
+			Difference |= ChunkDifference;
+		}
+
+		// Histograms are indexed [Chunk][Digit value], and turned into scatter offsets in place
+		std::vector<uint32_t> Offsets(static_cast<size_t>(ChunkCount) * RADIX_SIZE);
+
+		uint64_t* SrcKeys = t_Keys;
+		uint32_t* SrcValues = t_Values;
+		uint64_t* DstKeys = t_TempKeys;
+		uint32_t* DstValues = t_TempValues;
+
+		for (uint32_t Digit = 0; Digit < DIGIT_COUNT; ++Digit)
+		{
+			if (GetDigit(Difference, Digit) == 0)
+			{
+				continue;
+			}
+
+			Jobs.ParallelFor(ChunkCount, [&](uint32_t t_Begin, uint32_t t_End)
+			{
+				for (uint32_t Chunk = t_Begin; Chunk < t_End; ++Chunk)
+				{
+					uint32_t* Histogram = &Offsets[static_cast<size_t>(Chunk) * RADIX_SIZE];
+					memset(Histogram, 0, sizeof(uint32_t) * RADIX_SIZE);
+
+					const uint32_t End = std::min((Chunk + 1) * ChunkSize, t_Count);
+					for (uint32_t i = Chunk * ChunkSize; i < End; ++i)
+					{
+						++Histogram[GetDigit(SrcKeys[i], Digit)];
+					}
+				}
+			}, 1);
+
+			// Each chunk writes its keys with a given digit after every earlier chunk's keys with that digit,
+			// which keeps the sort stable
+			uint32_t Total = 0;
+			for (uint32_t Value = 0; Value < RADIX_SIZE; ++Value)
+			{
+				for (uint32_t Chunk = 0; Chunk < ChunkCount; ++Chunk)
+				{
+					uint32_t& Offset = Offsets[static_cast<size_t>(Chunk) * RADIX_SIZE + Value];
+					const uint32_t Count = Offset;
+					Offset = Total;
+					Total += Count;
+				}
+			}
+
+			Jobs.ParallelFor(ChunkCount, [&](uint32_t t_Begin, uint32_t t_End)
+			{
+				for (uint32_t Chunk = t_Begin; Chunk < t_End; ++Chunk)
+				{
+					uint32_t* ChunkOffsets = &Offsets[static_cast<size_t>(Chunk) * RADIX_SIZE];
+
+					const uint32_t End = std::min((Chunk + 1) * ChunkSize, t_Count);
+					for (uint32_t i = Chunk * ChunkSize; i < End; ++i)
+					{
+						const uint32_t Dst = ChunkOffsets[GetDigit(SrcKeys[i], Digit)]++;
+						DstKeys[Dst] = SrcKeys[i];
+						DstValues[Dst] = SrcValues[i];
+					}
+				}
+			}, 1);
+
+			std::swap(SrcKeys, DstKeys);
+			std::swap(SrcValues, DstValues);
+		}
+
+		// An odd number of passes leaves the result in the scratch arrays
+		if (SrcKeys != t_Keys)
+		{
+			memcpy(t_Keys, SrcKeys, sizeof(uint64_t) * t_Count);
+			memcpy(t_Values, SrcValues, sizeof(uint32_t) * t_Count);
+		}
+	}
+}   // namespace Fling
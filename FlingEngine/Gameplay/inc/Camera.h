@@ -1,5 +1,6 @@
 #pragma once
 #include "FlingMath.h"
+#include "Bounds.h"
 
 namespace Fling
 {
@@ -64,6 +65,13 @@ namespace Fling
 		 */
 		const glm::mat4& GetProjectionMatrix() const { return m_projectionMatrix; }
 
+		/**
+		 * @brief Gets the planes of the view frustrum in world space, updated with the view and projection matrices
+		 * 
+		 * @return const Frustum& m_Frustum
+		 */
+		const Frustum& GetFrustum() const { return m_Frustum; }
+
 		float GetGamma() const { return m_Gamma; }
 		void SetGamma(float t_Gam) { m_Gamma = t_Gam; }
 
@@ -71,9 +79,14 @@ namespace Fling
 		void SetExposure(float t_Val) { m_Exposure = t_Val; }
 
 	protected:
+		/** Call whenever the view or projection matrix changes */
+		void UpdateFrustum() { m_Frustum = Frustum::FromViewProjection(m_projectionMatrix * m_viewMatrix); }
+
 		glm::mat4 m_viewMatrix;
 		glm::mat4 m_projectionMatrix;
 
+		Frustum m_Frustum;
+
 	PROTECTED_WITH_EDITOR:
 		glm::vec3 m_position;
 		float m_speed; //padding 12 + 4 = 16
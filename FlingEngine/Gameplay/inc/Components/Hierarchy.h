@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Serilization.h"
+#include "FlingTypes.h"
+
+#include <entt/entity/registry.hpp>
+
+namespace Fling
+{
+	/**
+	* @brief	Places an entity under a parent, so that its Transform is relative to the parent's world matrix.
+	*			Children are an intrusive list through their siblings, so no component owns a container.
+	*			Use TransformHierarchy::SetParent to change it, which keeps both sides of the links in sync.
+	* @see TransformHierarchy
+	*/
+	struct Hierarchy
+	{
+		entt::entity Parent = entt::null;
+		entt::entity FirstChild = entt::null;
+		entt::entity PrevSibling = entt::null;
+		entt::entity NextSibling = entt::null;
+		uint32 ChildCount = 0;
+
+		/** Top of this entity's tree and how far below it this is. Kept up to date by TransformHierarchy */
+		entt::entity Root = entt::null;
+		uint32 Depth = 0;
+
+		inline bool HasParent() const { return Parent != entt::null; }
+
+		template<class Archive>
+		void save(Archive& t_Archive) const;
+
+		template<class Archive>
+		void load(Archive& t_Archive);
+	};
+
+	/** Serialization to an archive. Level snapshots keep their entity identifiers, so the links can be written as is */
+	template<class Archive>
+	inline void Hierarchy::save(Archive& t_Archive) const
+	{
+		const uint32 ParentId = static_cast<uint32>(Parent);
+		const uint32 FirstChildId = static_cast<uint32>(FirstChild);
+		const uint32 PrevSiblingId = static_cast<uint32>(PrevSibling);
+		const uint32 NextSiblingId = static_cast<uint32>(NextSibling);
+
+		t_Archive(
+			cereal::make_nvp("PARENT", ParentId),
+			cereal::make_nvp("FIRST_CHILD", FirstChildId),
+			cereal::make_nvp("PREV_SIBLING", PrevSiblingId),
+			cereal::make_nvp("NEXT_SIBLING", NextSiblingId),
+			cereal::make_nvp("CHILD_COUNT", ChildCount)
+		);
+	}
+
+	template<class Archive>
+	inline void Hierarchy::load(Archive& t_Archive)
+	{
+		uint32 ParentId = 0;
+		uint32 FirstChildId = 0;
+		uint32 PrevSiblingId = 0;
+		uint32 NextSiblingId = 0;
+
+		t_Archive(
+			cereal::make_nvp("PARENT", ParentId),
+			cereal::make_nvp("FIRST_CHILD", FirstChildId),
+			cereal::make_nvp("PREV_SIBLING", PrevSiblingId),
+			cereal::make_nvp("NEXT_SIBLING", NextSiblingId),
+			cereal::make_nvp("CHILD_COUNT", ChildCount)
+		);
+
+		Parent = static_cast<entt::entity>(ParentId);
+		FirstChild = static_cast<entt::entity>(FirstChildId);
+		PrevSibling = static_cast<entt::entity>(PrevSiblingId);
+		NextSibling = static_cast<entt::entity>(NextSiblingId);
+	}
+}   // namespace Fling
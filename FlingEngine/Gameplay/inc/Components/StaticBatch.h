@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Serilization.h"
+#include "FlingTypes.h"
+
+#include <entt/entity/registry.hpp>
+
+#include <vector>
+
+namespace Fling
+{
+	/**
+	* @brief	Marks a mesh that never moves, so that it can be merged with the other static meshes around it
+	*			that have the same material when the level is loaded. Merged meshes aren't drawn on their own,
+	*			but keep their MeshRenderer and stay in the SpatialTree so that they can still be picked.
+	*
+	*			Moving a merged mesh won't move what is drawn until the batches are built again.
+	* @see World::BuildStaticBatches
+	*/
+	struct StaticBatch
+	{
+		/** Meshes are only merged with others in the same group. Use it to keep meshes that are toggled together apart */
+		uint32 Group = 0;
+
+		/** The entity that this mesh was merged into, or null if it is drawn on its own. Not saved */
+		entt::entity MergedInto = entt::null;
+
+		template<class Archive>
+		void serialize(Archive& t_Archive)
+		{
+			t_Archive(
+				cereal::make_nvp("GROUP", Group)
+			);
+		}
+	};
+
+	/**
+	* @brief	A mesh made by merging StaticBatch meshes. Created by the world when a level is loaded and
+	*			never saved. Maps the merged mesh back to the entities that it was made of for the editor.
+	*/
+	struct StaticBatchMesh
+	{
+		/** Entities that were merged into this mesh */
+		std::vector<entt::entity> Sources;
+
+		/** Where each source's triangles start in the merged model's indices. Parallel to Sources */
+		std::vector<uint32> SourceFirstIndex;
+
+		/** The source that an index of the merged model came from, or null */
+		entt::entity GetSource(uint32 t_Index) const
+		{
+			for (size_t i = Sources.size(); i-- > 0;)
+			{
+				if (SourceFirstIndex[i] <= t_Index)
+				{
+					return Sources[i];
+				}
+			}
+			return entt::null;
+		}
+	};
+}   // namespace Fling
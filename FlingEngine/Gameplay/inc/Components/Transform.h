@@ -9,8 +9,15 @@ namespace Fling
     {   
         glm::mat4 GetWorldMatrix() const;
 
+		/** Recalculate the world matrix from the position, rotation and scale, and clear the dirty flag */
 		static void CalculateWorldMatrix(Transform& t_Trans);
 
+		/**
+		* @brief	Recalculate the world matrices of the dirty transforms in a contiguous array, a batch of
+		*			them at a time with SIMD. Flags which ones changed. @see TransformBatch
+		*/
+		static void CalculateWorldMatrices(Transform* t_Transforms, uint32 t_Count);
+
         bool operator==(const Transform &other) const;
 	    bool operator!=(const Transform &other) const;
         friend std::ostream& operator << (std::ostream& t_OutStream, const Fling::Transform& t_Transform); 
@@ -27,11 +34,33 @@ namespace Fling
         void SetScale(const glm::vec3& t_Scale);
         void SetRotation(const glm::vec3& t_Rot);
 
+        /** True if the position, rotation or scale changed since the world matrix was last calculated */
+        inline bool IsDirty() const { return m_IsDirty; }
+
+        /** Has to be called after editing the position, rotation or scale without the setters */
+        inline void MarkDirty() { m_IsDirty = true; }
+
+        /** True if the transform system recalculated the world matrix this frame. @see World::RegisterEngineSystems */
+        inline bool HasWorldChanged() const { return m_WorldChanged; }
+
     //private:
         glm::vec3 m_Pos { 0.0f, 0.0f, 0.0f };
         glm::vec3 m_Rotation { 0.0f, 0.0f, 0.0f };
         glm::vec3 m_Scale { 1.0f, 1.0f, 1.0f };
-		glm::mat4 m_worldMat {};
+		glm::mat4 m_worldMat { 1.0f };
+
+        /** New transforms are dirty so that they get a world matrix on their first frame */
+        bool m_IsDirty = true;
+        bool m_WorldChanged = false;
+
+    private:
+
+        /** Rebuild the rotation quaternion if the euler angles changed since it was built */
+        void UpdateRotationQuat();
+
+        /** Rotation as a quaternion, only rebuilt when m_Rotation changes */
+        glm::quat m_RotationQuat { 1.0f, 0.0f, 0.0f, 0.0f };
+        glm::vec3 m_RotationQuatEuler { 0.0f, 0.0f, 0.0f };
     };
     
     /** Serilazation to an archive */
@@ -8,6 +8,7 @@
 namespace Fling
 {
 	class World;
+	class SystemScheduler;
 
 	/**
 	 * @brief   The game class is mean to be overridden on a per-game instance.
@@ -38,6 +39,13 @@ namespace Fling
 		*/
 		virtual void Update(entt::registry& t_Reg, float DeltaTime) = 0;
 
+		/**
+		* Called by the World after Init. Systems added here run every frame while the game is playing,
+		* in parallel with each other when their components allow it
+		* @see SystemScheduler
+		*/
+		virtual void RegisterSystems(SystemScheduler& t_Scheduler) {}
+
 		/**
 		* Called when the game should stop
 		*/
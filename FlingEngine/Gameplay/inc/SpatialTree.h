@@ -0,0 +1,93 @@
+#pragma once
+
+#include "NonCopyable.hpp"
+#include "AABBTree.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include <entt/entity/registry.hpp>
+
+namespace Fling
+{
+	struct MeshRenderer;
+	class Model;
+
+	/**
+	 * @brief	World space bounds of every entity with a Transform and a MeshRenderer, kept in an
+	 *			AABBTree. Entities are added and removed as those components are, and moved by the
+	 *			"Spatial Tree Refit" engine system once the world matrices are up to date.
+	 *
+	 *			The editor uses it for picking, gameplay for proximity tests, and the renderer
+	 *			culls whole branches of it against the camera.
+	 * @see World::RegisterEngineSystems
+	 */
+	class SpatialTree : public NonCopyable
+	{
+	public:
+
+		struct RayHit
+		{
+			entt::entity Entity = entt::null;
+			float Distance = 0.0f;
+		};
+
+		explicit SpatialTree(entt::registry& t_Reg);
+		~SpatialTree();
+
+		/** Move entities whose world matrix changed this frame or whose model finished loading */
+		void Refit(entt::registry& t_Reg);
+
+		/** Append every entity whose bounds are at least partly inside of the frustum */
+		void QueryFrustum(const Frustum& t_Frustum, std::vector<entt::entity>& t_OutEntities) const;
+
+		/** Append every entity whose bounds overlap the box */
+		void QueryAABB(const AABB& t_Box, std::vector<entt::entity>& t_OutEntities) const;
+
+		/** Append every entity whose bounds are at least partly within t_Radius of t_Center */
+		void QuerySphere(const glm::vec3& t_Center, float t_Radius, std::vector<entt::entity>& t_OutEntities) const;
+
+		/** Append every entity whose bounds are hit by the ray, closest first */
+		void RayCast(const glm::vec3& t_Origin, const glm::vec3& t_Direction, float t_MaxDistance, std::vector<RayHit>& t_OutHits) const;
+
+		/**
+		 * @brief	Find the closest entity whose bounds are hit by the ray
+		 * @return	The entity or entt::null if nothing was hit
+		 */
+		entt::entity RayCastClosest(const glm::vec3& t_Origin, const glm::vec3& t_Direction, float t_MaxDistance, float* t_OutDistance = nullptr) const;
+
+		FORCEINLINE const AABBTree& GetTree() const { return m_Tree; }
+
+	private:
+
+		void OnRenderableAdded(entt::entity t_Ent, entt::registry& t_Reg);
+
+		void OnRenderableRemoved(entt::entity t_Ent, entt::registry& t_Reg);
+
+		void OnMeshRendererReplaced(entt::entity t_Ent, entt::registry& t_Reg, MeshRenderer& t_MeshRend);
+
+		/** Listener for either component of a renderable being added */
+		template<class T>
+		void OnComponentAdded(entt::entity t_Ent, entt::registry& t_Reg, T& t_Comp) { OnRenderableAdded(t_Ent, t_Reg); }
+
+		/** World space box of an entity. A small box at its position until its model has loaded */
+		static AABB GetWorldBounds(entt::registry& t_Reg, entt::entity t_Ent);
+
+		/** Convert tree results back to entities */
+		static void AppendEntities(const std::vector<uint32>& t_UserData, std::vector<entt::entity>& t_OutEntities);
+
+		entt::registry& m_Registry;
+
+		AABBTree m_Tree;
+
+		struct Proxy
+		{
+			int32 Id = AABBTree::NULL_NODE;
+			/** The model the bounds were built from, null if it hadn't loaded yet */
+			const Model* BoundsModel = nullptr;
+		};
+
+		/** The tree proxy of each entity */
+		std::unordered_map<entt::entity, Proxy> m_Proxies;
+	};
+}   // namespace Fling
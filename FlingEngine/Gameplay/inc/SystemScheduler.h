@@ -0,0 +1,231 @@
+#pragma once
+
+#include "NonCopyable.hpp"
+#include "FlingTypes.h"
+#include "JobSystem.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <entt/entity/registry.hpp>
+
+namespace Fling
+{
+	typedef uint32 SystemId;
+
+	static const SystemId INVALID_SYSTEM_ID = ~0u;
+
+	/**
+	 * @brief 	Runs gameplay and engine systems in parallel on the JobSystem. Every system declares
+	 *			which components it reads and writes, and two systems only run at the same time if
+	 *			neither one writes something that the other one touches. Systems that conflict run
+	 *			in the order that they were added.
+	 *
+	 *			Systems may only change component values while they run. Anything that creates or
+	 *			destroys entities, or adds or removes components, has to be marked Exclusive so that
+	 *			nothing else is touching the registry at the time.
+	 *
+	 * @see World::Update
+	 */
+	class SystemScheduler : public NonCopyable
+	{
+	public:
+
+		typedef std::function<void(entt::registry&, float)> SystemFunction;
+
+		/** Declares what a system touches. Returned from AddSystem */
+		class SystemBuilder
+		{
+			friend class SystemScheduler;
+
+		public:
+
+			template<class ...COMPONENTS>
+			SystemBuilder& Reads();
+
+			template<class ...COMPONENTS>
+			SystemBuilder& Writes();
+
+			/** Never run with any other system. Needed for any structural change to the registry */
+			SystemBuilder& Exclusive();
+
+			/** Run after another system even if they don't share any components */
+			SystemBuilder& After(SystemId t_Other);
+
+			/** Run even while the game is not playing, for engine systems that the editor needs */
+			SystemBuilder& AlwaysRun();
+
+			SystemId GetId() const { return m_Id; }
+
+			operator SystemId() const { return m_Id; }
+
+		private:
+
+			SystemBuilder(SystemScheduler& t_Scheduler, SystemId t_Id)
+				: m_Scheduler(t_Scheduler)
+				, m_Id(t_Id)
+			{}
+
+			SystemScheduler& m_Scheduler;
+
+			SystemId m_Id;
+		};
+
+		explicit SystemScheduler(entt::registry& t_Reg);
+
+		/**
+		 * @brief	Add a system that is called once per frame
+		 * @param t_Name 	Shown in the editor and in logs
+		 */
+		SystemBuilder AddSystem(const std::string& t_Name, SystemFunction t_Function);
+
+		void RemoveSystem(SystemId t_Id);
+
+		/** Disabled systems keep their place in the order but are not called */
+		void SetSystemEnabled(SystemId t_Id, bool t_Enabled);
+
+		void Clear();
+
+		/**
+		 * @brief	Run every enabled system, and wait for all of them to finish
+		 * @param t_IsPlaying 	If false then only AlwaysRun systems are called
+		 */
+		void Run(float t_DeltaTime, bool t_IsPlaying);
+
+		uint32 GetSystemCount() const { return static_cast<uint32>(m_Systems.size()); }
+
+		const std::string& GetSystemName(uint32 t_Index) const { return m_Systems[t_Index]->Name; }
+
+		/** How long a system took the last time it ran, in milliseconds */
+		float GetSystemTime(uint32 t_Index) const { return m_Systems[t_Index]->LastTimeMs; }
+
+		/** How many systems the longest chain of dependencies has. 1 means everything ran in parallel */
+		uint32 GetCriticalPathLength() const { return m_CriticalPathLength; }
+
+		/**
+		 * @brief	Call t_Func(entity, components&...) for every entity in a view, split into chunks across
+		 *			the job system once the view is big enough. Use from inside of a system, the same rules apply
+		 * @param t_MinParallelSize 	Views smaller than this are run on the calling thread
+		 */
+		template<class ...COMPONENTS, class F>
+		static void ParallelEach(entt::registry& t_Reg, F&& t_Func, uint32 t_MinParallelSize = 1024);
+
+	private:
+
+		typedef entt::registry::component_type ComponentType;
+
+		struct System
+		{
+			std::string Name;
+
+			SystemFunction Function;
+
+			SystemId Id = INVALID_SYSTEM_ID;
+
+			std::vector<ComponentType> Reads;
+
+			std::vector<ComponentType> Writes;
+
+			std::vector<SystemId> RunAfter;
+
+			bool IsExclusive = false;
+
+			bool IsAlwaysRun = false;
+
+			bool IsEnabled = true;
+
+			float LastTimeMs = 0.0f;
+
+			/** Indices of systems that wait on this one. Built by BuildGraph */
+			std::vector<uint32> Dependents;
+
+			uint32 DependencyCount = 0;
+
+			std::atomic<uint32> PendingDependencies { 0 };
+		};
+
+		/** Work out which systems have to wait on each other, in the order they were added */
+		void BuildGraph();
+
+		bool Conflicts(const System& t_First, const System& t_Second) const;
+
+		System* FindSystem(SystemId t_Id);
+
+		/** Run one system and queue any of its dependents that are now ready */
+		void RunSystem(uint32 t_Index);
+
+		void QueueSystem(uint32 t_Index);
+
+		entt::registry& m_Registry;
+
+		std::vector<std::unique_ptr<System>> m_Systems;
+
+		SystemId m_NextId = 0;
+
+		uint32 m_CriticalPathLength = 0;
+
+		/** Set whenever systems are added or removed so the graph is rebuilt before the next run */
+		bool m_IsGraphDirty = true;
+
+		/** Only valid during Run */
+		float m_DeltaTime = 0.0f;
+
+		bool m_IsPlaying = false;
+
+		JobCounter* m_FrameCounter = nullptr;
+	};
+
+	template<class ...COMPONENTS>
+	SystemScheduler::SystemBuilder& SystemScheduler::SystemBuilder::Reads()
+	{
+		System* Sys = m_Scheduler.FindSystem(m_Id);
+		assert(Sys);
+		(Sys->Reads.push_back(m_Scheduler.m_Registry.type<COMPONENTS>()), ...);
+		m_Scheduler.m_IsGraphDirty = true;
+		return *this;
+	}
+
+	template<class ...COMPONENTS>
+	SystemScheduler::SystemBuilder& SystemScheduler::SystemBuilder::Writes()
+	{
+		System* Sys = m_Scheduler.FindSystem(m_Id);
+		assert(Sys);
+		(Sys->Writes.push_back(m_Scheduler.m_Registry.type<COMPONENTS>()), ...);
+		m_Scheduler.m_IsGraphDirty = true;
+		return *this;
+	}
+
+	template<class ...COMPONENTS, class F>
+	void SystemScheduler::ParallelEach(entt::registry& t_Reg, F&& t_Func, uint32 t_MinParallelSize)
+	{
+		auto View = t_Reg.view<COMPONENTS...>();
+
+		JobSystem& Jobs = JobSystem::Get();
+		if (Jobs.GetWorkerCount() == 1 || View.size() < t_MinParallelSize)
+		{
+			View.each(t_Func);
+			return;
+		}
+
+		// Views over more than one component are filtered, so gather the entities first to be
+		// able to split them up
+		std::vector<entt::entity> Entities;
+		Entities.reserve(View.size());
+		for (entt::entity Ent : View)
+		{
+			Entities.push_back(Ent);
+		}
+
+		Jobs.ParallelFor(static_cast<uint32>(Entities.size()), [&t_Reg, &Entities, &t_Func](uint32 t_Begin, uint32 t_End)
+		{
+			for (uint32 i = t_Begin; i < t_End; ++i)
+			{
+				const entt::entity Ent = Entities[i];
+				t_Func(Ent, t_Reg.template get<COMPONENTS>(Ent)...);
+			}
+		});
+	}
+}   // namespace Fling
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "NonCopyable.hpp"
+#include "Components/Hierarchy.h"
+
+#include <vector>
+
+#include <entt/entity/registry.hpp>
+
+namespace Fling
+{
+	/**
+	 * @brief	Updates the world matrix of every Transform, applying the parents of entities with a Hierarchy.
+	 *
+	 *			The Hierarchy pool is sorted by root and then depth whenever parents change, so each root's
+	 *			subtree is one contiguous range with parents before their children. Every frame the ranges
+	 *			are walked once to pass dirty flags down to children and once to multiply in the parents'
+	 *			world matrices, in parallel across subtrees. Subtrees with nothing dirty are skipped.
+	 * @see World::RegisterEngineSystems
+	 */
+	class TransformHierarchy : public NonCopyable
+	{
+	public:
+
+		explicit TransformHierarchy(entt::registry& t_Reg);
+		~TransformHierarchy();
+
+		/**
+		 * @brief	Put t_Child under t_Parent, or make it a root if t_Parent is entt::null. Both get a
+		 *			Hierarchy if they don't have one. The child's Transform stays relative, so it moves with the parent
+		 * @return	False if t_Parent is t_Child or one of its descendants
+		 */
+		bool SetParent(entt::entity t_Child, entt::entity t_Parent);
+
+		/** Recalculate the dirty world matrices, children of dirty transforms included */
+		void UpdateWorldMatrices(entt::registry& t_Reg);
+
+		/** Call t_Func(entt::entity) for each direct child of t_Ent */
+		template<class F>
+		void EachChild(entt::entity t_Ent, F&& t_Func) const;
+
+	private:
+
+		/** Unlink an entity from its parent and siblings */
+		void Detach(entt::entity t_Ent, Hierarchy& t_Node);
+
+		/** Find the root and depth of every node and sort the pool so that each subtree is contiguous */
+		void SortHierarchy();
+
+		/** Mark children of dirty transforms dirty, in depth order so it reaches the whole subtree */
+		void PropagateDirty();
+
+		/** Multiply the parent's world matrix into each child whose local matrix was recalculated */
+		void ApplyParents();
+
+		void OnHierarchyAdded(entt::entity t_Ent, entt::registry& t_Reg, Hierarchy& t_Node);
+
+		/** Children of a destroyed entity become roots */
+		void OnHierarchyRemoved(entt::entity t_Ent, entt::registry& t_Reg);
+
+		entt::registry& m_Registry;
+
+		/** Hierarchy entities in pool order after the last sort */
+		std::vector<entt::entity> m_Sorted;
+
+		/** First index in m_Sorted of each root's subtree, plus the size at the end */
+		std::vector<uint32> m_SubtreeStarts;
+
+		/** 1 for each subtree that has a dirty transform this frame */
+		std::vector<uint8> m_SubtreeDirty;
+
+		/** Parents changed since the pool was last sorted */
+		bool m_NeedsSort = true;
+	};
+
+	template<class F>
+	void TransformHierarchy::EachChild(entt::entity t_Ent, F&& t_Func) const
+	{
+		const Hierarchy* Node = m_Registry.try_get<Hierarchy>(t_Ent);
+		entt::entity Child = Node ? Node->FirstChild : entt::null;
+		while (Child != entt::null)
+		{
+			t_Func(Child);
+			Child = m_Registry.get<Hierarchy>(Child).NextSibling;
+		}
+	}
+}   // namespace Fling
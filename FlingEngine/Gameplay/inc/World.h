@@ -4,6 +4,9 @@
 #include "Level.h"
 #include "Game.h"
 #include "FlingConfig.h"
+#include "SystemScheduler.h"
+#include "SpatialTree.h"
+#include "TransformHierarchy.h"
 
 #include <string>
 #include <fstream>
@@ -80,8 +83,27 @@ namespace Fling
 		template<class ...ARGS>
 		bool LoadLevelFile(const std::string& t_LevelToLoad);
 
+		/**
+		 * @brief	Merge the meshes of StaticBatch entities that share a material and a cell of the world into
+		 *			combined models, and stop drawing the meshes that were merged. Any batches that were already
+		 *			built are cleared first, so call it again after moving a static mesh in the editor.
+		 *			Called by LoadLevelFile. @see StaticBatch
+		 */
+		void BuildStaticBatches();
+
+		/** Destroy the merged meshes and draw the meshes that they were made of on their own again */
+		void ClearStaticBatches();
+
 		FORCEINLINE entt::registry& GetRegistry() const { return m_Registry; }
 
+		FORCEINLINE SystemScheduler& GetSystems() { return m_Systems; }
+
+		/** Bounds of every entity with a Transform and MeshRenderer, for picking, proximity tests and culling */
+		FORCEINLINE const SpatialTree& GetSpatialTree() const { return m_SpatialTree; }
+
+		/** Parent and child relationships between entities. @see Hierarchy */
+		FORCEINLINE TransformHierarchy& GetHierarchy() { return m_Hierarchy; }
+
 		// The current state of the game, is it playing, stopped, paused, etc
 		enum class WorldState : uint8
 		{
@@ -103,6 +125,15 @@ namespace Fling
 
     private:
 
+		/** Add the systems that the engine needs every frame, after the game's so they see its changes */
+		void RegisterEngineSystems();
+
+		/**
+		 * @brief	Start async loads of every mesh and material that a level file references, so
+		 *			that they decode in parallel while the level is deserialized
+		 */
+		void PrefetchLevelResources(const std::string& t_FullPath);
+
 		WorldState m_CurrentState = WorldState::NONE;
 		
 		/** The registry and represents all active entities in this world */
@@ -111,6 +142,15 @@ namespace Fling
 		/** The game will allow users to specify their own update/read/write functions */
 		Fling::Game* m_Game = nullptr;
 
+		/** Game and engine systems that are run every frame */
+		SystemScheduler m_Systems;
+
+		/** Refit by the "Spatial Tree Refit" system after the world matrices are updated */
+		SpatialTree m_SpatialTree;
+
+		/** Updates the world matrices in the "Transform World Matrices" system */
+		TransformHierarchy m_Hierarchy;
+
 		/** Flag if the world should quit or not! */
 		uint8 m_ShouldQuit : 1;
     };
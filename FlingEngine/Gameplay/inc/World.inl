@@ -2,13 +2,15 @@
 
 #include "World.h"
 #include "Components/Transform.h"
+#include "Components/Hierarchy.h"
+#include "Components/StaticBatch.h"
 #include "MeshRenderer.h"
 #include "Lighting/DirectionalLight.hpp"
 #include "Lighting/PointLight.hpp"
 
 // Definition of what world components we want to serialize to the disk when
 // saving and loading a scene
-#define WORLD_COMPONENTS Fling::Transform, MeshRenderer, DirectionalLight, PointLight
+#define WORLD_COMPONENTS Fling::Transform, Fling::Hierarchy, MeshRenderer, DirectionalLight, PointLight, StaticBatch
 
 namespace Fling
 {
@@ -26,12 +28,23 @@ namespace Fling
 		
 		F_LOG_TRACE("Outputting Level file to {}", FullPath);
 
-    	cereal::JSONOutputArchive archive(OutStream);
+		// Merged meshes are made when the level is loaded, only the meshes that they were made of are saved
+		const bool HadStaticBatches = !m_Registry.view<StaticBatchMesh>().empty();
+		ClearStaticBatches();
 
-		// Write out a copy of what is in this registry 
-		m_Registry.snapshot()
-			.entities(archive)
-			.component<WORLD_COMPONENTS, ARGS...>(archive);
+		{
+			cereal::JSONOutputArchive archive(OutStream);
+
+			// Write out a copy of what is in this registry 
+			m_Registry.snapshot()
+				.entities(archive)
+				.component<WORLD_COMPONENTS, ARGS...>(archive);
+		}
+
+		if (HadStaticBatches)
+		{
+			BuildStaticBatches();
+		}
 		
 		return true;
 	}
@@ -53,6 +66,9 @@ namespace Fling
 
 		F_LOG_TRACE("Loading Level file from {}", FullPath);
 
+		// Components load their resources as they are read in, which joins these loads
+		PrefetchLevelResources(FullPath);
+
     	cereal::JSONInputArchive archive(InputStream);
 
 		// This type of loader requires the registry to be cleared first
@@ -62,6 +78,9 @@ namespace Fling
 		m_Registry.loader()
 			.entities(archive)
 			.component<WORLD_COMPONENTS, ARGS...>(archive);
+
+		// Every mesh and material is loaded by now
+		BuildStaticBatches();
 		
 		return true;
 	}
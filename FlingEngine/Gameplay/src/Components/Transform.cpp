@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "Components/Transform.h"
+#include "TransformBatch.h"
 
 namespace Fling
 {
@@ -36,27 +37,60 @@ namespace Fling
 
 	void Transform::CalculateWorldMatrix(Transform& t_Trans)
 	{
-		//assert(t_OutMat);
-		//*t_OutMat = glm::translate(glm::mat4(1.0f), t_Trans.m_Pos);
-		//*t_OutMat = *t_OutMat * glm::yawPitchRoll(glm::radians(t_Trans.m_Rotation.y), glm::radians(t_Trans.m_Rotation.x), glm::radians(t_Trans.m_Rotation.z));
-		//*t_OutMat = glm::scale(*t_OutMat, t_Trans.m_Scale);
-		t_Trans.m_worldMat = glm::translate(glm::mat4(1.0f), t_Trans.m_Pos);;
-		t_Trans.m_worldMat= t_Trans.m_worldMat * glm::yawPitchRoll(glm::radians(t_Trans.m_Rotation.y), glm::radians(t_Trans.m_Rotation.x), glm::radians(t_Trans.m_Rotation.z));
-		t_Trans.m_worldMat = glm::scale(t_Trans.m_worldMat, t_Trans.m_Scale);
+		t_Trans.UpdateRotationQuat();
+		t_Trans.m_worldMat = TransformBatch::Compose(t_Trans.m_Pos, t_Trans.m_RotationQuat, t_Trans.m_Scale);
+		t_Trans.m_IsDirty = false;
+	}
+
+	void Transform::CalculateWorldMatrices(Transform* t_Transforms, uint32 t_Count)
+	{
+		TransformBatch Batch;
+
+		for (uint32 i = 0; i < t_Count; ++i)
+		{
+			Transform& Trans = t_Transforms[i];
+			Trans.m_WorldChanged = Trans.m_IsDirty;
+			if (!Trans.m_IsDirty)
+			{
+				continue;
+			}
+
+			Trans.UpdateRotationQuat();
+			Trans.m_IsDirty = false;
+			if (Batch.Add(Trans.m_Pos, Trans.m_RotationQuat, Trans.m_Scale, &Trans.m_worldMat))
+			{
+				Batch.Flush();
+			}
+		}
+
+		Batch.Flush();
+	}
+
+	void Transform::UpdateRotationQuat()
+	{
+		// Most transforms are moved or scaled without being rotated, which skips the trigonometry
+		if (m_Rotation != m_RotationQuatEuler)
+		{
+			m_RotationQuat = TransformBatch::EulerToQuat(m_Rotation);
+			m_RotationQuatEuler = m_Rotation;
+		}
 	}
 
     void Transform::SetPos(const glm::vec3& t_Pos)
     {
         m_Pos = t_Pos;
+        m_IsDirty = true;
     }
 
     void Transform::SetScale(const glm::vec3& t_Scale)
     {
         m_Scale = t_Scale;
+        m_IsDirty = true;
     }
 
     void Transform::SetRotation(const glm::vec3& t_Rot)
     {
         m_Rotation = t_Rot;
+        m_IsDirty = true;
     }
 }   // namespace Fling
\ No newline at end of file
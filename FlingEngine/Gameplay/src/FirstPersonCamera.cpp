@@ -137,6 +137,7 @@ namespace Fling
 		UpdateCameraVectors();
 		UpdateProjectionMatrix();
 		UpdateViewMatrix();
+		UpdateFrustum();
     }
 
 	void FirstPersonCamera::UpdateViewMatrix()
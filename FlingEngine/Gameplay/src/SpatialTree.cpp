@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "SpatialTree.h"
+#include "Components/Transform.h"
+#include "MeshRenderer.h"
+#include "Model.h"
+
+namespace Fling
+{
+	SpatialTree::SpatialTree(entt::registry& t_Reg)
+		: m_Registry(t_Reg)
+	{
+		// entt has no update signal, components that are changed in place are picked up by Refit
+		t_Reg.on_construct<Transform>().connect<&SpatialTree::OnComponentAdded<Transform>>(*this);
+		t_Reg.on_construct<MeshRenderer>().connect<&SpatialTree::OnComponentAdded<MeshRenderer>>(*this);
+		t_Reg.on_replace<MeshRenderer>().connect<&SpatialTree::OnMeshRendererReplaced>(*this);
+		t_Reg.on_destroy<Transform>().connect<&SpatialTree::OnRenderableRemoved>(*this);
+		t_Reg.on_destroy<MeshRenderer>().connect<&SpatialTree::OnRenderableRemoved>(*this);
+
+		// Anything that was created before the world
+		t_Reg.view<Transform, MeshRenderer>().each([&](entt::entity t_Ent, Transform& t_Trans, MeshRenderer& t_MeshRend)
+		{
+			OnRenderableAdded(t_Ent, t_Reg);
+		});
+	}
+
+	SpatialTree::~SpatialTree()
+	{
+		m_Registry.on_construct<Transform>().disconnect<&SpatialTree::OnComponentAdded<Transform>>(*this);
+		m_Registry.on_construct<MeshRenderer>().disconnect<&SpatialTree::OnComponentAdded<MeshRenderer>>(*this);
+		m_Registry.on_replace<MeshRenderer>().disconnect<&SpatialTree::OnMeshRendererReplaced>(*this);
+		m_Registry.on_destroy<Transform>().disconnect<&SpatialTree::OnRenderableRemoved>(*this);
+		m_Registry.on_destroy<MeshRenderer>().disconnect<&SpatialTree::OnRenderableRemoved>(*this);
+	}
+
+	void SpatialTree::Refit(entt::registry& t_Reg)
+	{
+		FLING_PROFILE_SCOPE("SpatialTree::Refit");
+
+		// Static entities are skipped entirely, most of the others stay inside of their fat box
+		for (auto& Entry : m_Proxies)
+		{
+			const Model* CurModel = t_Reg.get<MeshRenderer>(Entry.first).m_Model.Get();
+			if (!t_Reg.get<Transform>(Entry.first).HasWorldChanged() && CurModel == Entry.second.BoundsModel)
+			{
+				continue;
+			}
+
+			Entry.second.BoundsModel = CurModel;
+			m_Tree.MoveProxy(Entry.second.Id, GetWorldBounds(t_Reg, Entry.first));
+		}
+	}
+
+	void SpatialTree::OnRenderableAdded(entt::entity t_Ent, entt::registry& t_Reg)
+	{
+		// Called for both components, the entity is added once it has the second one
+		if (!t_Reg.has<Transform, MeshRenderer>(t_Ent) || m_Proxies.find(t_Ent) != m_Proxies.end())
+		{
+			return;
+		}
+
+		Proxy NewProxy = {};
+		NewProxy.Id = m_Tree.CreateProxy(GetWorldBounds(t_Reg, t_Ent), static_cast<uint32>(t_Ent));
+		NewProxy.BoundsModel = t_Reg.get<MeshRenderer>(t_Ent).m_Model.Get();
+		m_Proxies.emplace(t_Ent, NewProxy);
+	}
+
+	void SpatialTree::OnRenderableRemoved(entt::entity t_Ent, entt::registry& t_Reg)
+	{
+		auto It = m_Proxies.find(t_Ent);
+		if (It != m_Proxies.end())
+		{
+			m_Tree.DestroyProxy(It->second.Id);
+			m_Proxies.erase(It);
+		}
+	}
+
+	void SpatialTree::OnMeshRendererReplaced(entt::entity t_Ent, entt::registry& t_Reg, MeshRenderer& t_MeshRend)
+	{
+		auto It = m_Proxies.find(t_Ent);
+		if (It != m_Proxies.end())
+		{
+			It->second.BoundsModel = t_MeshRend.m_Model.Get();
+			m_Tree.MoveProxy(It->second.Id, GetWorldBounds(t_Reg, t_Ent));
+		}
+	}
+
+	AABB SpatialTree::GetWorldBounds(entt::registry& t_Reg, entt::entity t_Ent)
+	{
+		const glm::mat4& World = t_Reg.get<Transform>(t_Ent).GetWorldMat();
+
+		if (const Model* Model = t_Reg.get<MeshRenderer>(t_Ent).m_Model.Get())
+		{
+			return Model->GetBounds().Transform(World);
+		}
+
+		const glm::vec3 Pos = glm::vec3(World[3]);
+		return AABB { Pos - glm::vec3(0.5f), Pos + glm::vec3(0.5f) };
+	}
+
+	void SpatialTree::AppendEntities(const std::vector<uint32>& t_UserData, std::vector<entt::entity>& t_OutEntities)
+	{
+		t_OutEntities.reserve(t_OutEntities.size() + t_UserData.size());
+		for (uint32 Id : t_UserData)
+		{
+			t_OutEntities.push_back(static_cast<entt::entity>(Id));
+		}
+	}
+
+	void SpatialTree::QueryFrustum(const Frustum& t_Frustum, std::vector<entt::entity>& t_OutEntities) const
+	{
+		std::vector<uint32> Results;
+		m_Tree.QueryFrustum(t_Frustum, Results);
+		AppendEntities(Results, t_OutEntities);
+	}
+
+	void SpatialTree::QueryAABB(const AABB& t_Box, std::vector<entt::entity>& t_OutEntities) const
+	{
+		std::vector<uint32> Results;
+		m_Tree.QueryAABB(t_Box, Results);
+		AppendEntities(Results, t_OutEntities);
+	}
+
+	void SpatialTree::QuerySphere(const glm::vec3& t_Center, float t_Radius, std::vector<entt::entity>& t_OutEntities) const
+	{
+		std::vector<uint32> Results;
+		m_Tree.QuerySphere(t_Center, t_Radius, Results);
+		AppendEntities(Results, t_OutEntities);
+	}
+
+	void SpatialTree::RayCast(const glm::vec3& t_Origin, const glm::vec3& t_Direction, float t_MaxDistance, std::vector<RayHit>& t_OutHits) const
+	{
+		std::vector<AABBTree::RayHit> Hits;
+		m_Tree.RayCast(t_Origin, t_Direction, t_MaxDistance, Hits);
+
+		t_OutHits.reserve(t_OutHits.size() + Hits.size());
+		for (const AABBTree::RayHit& Hit : Hits)
+		{
+			t_OutHits.push_back({ static_cast<entt::entity>(Hit.UserData), Hit.Distance });
+		}
+	}
+
+	entt::entity SpatialTree::RayCastClosest(const glm::vec3& t_Origin, const glm::vec3& t_Direction, float t_MaxDistance, float* t_OutDistance) const
+	{
+		std::vector<AABBTree::RayHit> Hits;
+		m_Tree.RayCast(t_Origin, t_Direction, t_MaxDistance, Hits);
+		if (Hits.empty())
+		{
+			return entt::null;
+		}
+
+		if (t_OutDistance)
+		{
+			*t_OutDistance = Hits[0].Distance;
+		}
+		return static_cast<entt::entity>(Hits[0].UserData);
+	}
+}   // namespace Fling
@@ -0,0 +1,238 @@
+#include "pch.h"
+#include "SystemScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace Fling
+{
+	SystemScheduler::SystemBuilder& SystemScheduler::SystemBuilder::Exclusive()
+	{
+		System* Sys = m_Scheduler.FindSystem(m_Id);
+		assert(Sys);
+		Sys->IsExclusive = true;
+		m_Scheduler.m_IsGraphDirty = true;
+		return *this;
+	}
+
+	SystemScheduler::SystemBuilder& SystemScheduler::SystemBuilder::After(SystemId t_Other)
+	{
+		System* Sys = m_Scheduler.FindSystem(m_Id);
+		assert(Sys);
+		Sys->RunAfter.push_back(t_Other);
+		m_Scheduler.m_IsGraphDirty = true;
+		return *this;
+	}
+
+	SystemScheduler::SystemBuilder& SystemScheduler::SystemBuilder::AlwaysRun()
+	{
+		System* Sys = m_Scheduler.FindSystem(m_Id);
+		assert(Sys);
+		Sys->IsAlwaysRun = true;
+		return *this;
+	}
+
+	SystemScheduler::SystemScheduler(entt::registry& t_Reg)
+		: m_Registry(t_Reg)
+	{
+	}
+
+	SystemScheduler::SystemBuilder SystemScheduler::AddSystem(const std::string& t_Name, SystemFunction t_Function)
+	{
+		assert(t_Function);
+
+		std::unique_ptr<System> NewSystem = std::make_unique<System>();
+		NewSystem->Name = t_Name;
+		NewSystem->Function = std::move(t_Function);
+		NewSystem->Id = m_NextId++;
+
+		const SystemId Id = NewSystem->Id;
+		m_Systems.emplace_back(std::move(NewSystem));
+		m_IsGraphDirty = true;
+
+		return SystemBuilder(*this, Id);
+	}
+
+	void SystemScheduler::RemoveSystem(SystemId t_Id)
+	{
+		auto It = std::find_if(m_Systems.begin(), m_Systems.end(), [t_Id](const std::unique_ptr<System>& t_Sys) { return t_Sys->Id == t_Id; });
+		if (It != m_Systems.end())
+		{
+			m_Systems.erase(It);
+			m_IsGraphDirty = true;
+		}
+	}
+
+	void SystemScheduler::SetSystemEnabled(SystemId t_Id, bool t_Enabled)
+	{
+		if (System* Sys = FindSystem(t_Id))
+		{
+			Sys->IsEnabled = t_Enabled;
+		}
+	}
+
+	void SystemScheduler::Clear()
+	{
+		m_Systems.clear();
+		m_IsGraphDirty = true;
+	}
+
+	SystemScheduler::System* SystemScheduler::FindSystem(SystemId t_Id)
+	{
+		for (std::unique_ptr<System>& Sys : m_Systems)
+		{
+			if (Sys->Id == t_Id)
+			{
+				return Sys.get();
+			}
+		}
+		return nullptr;
+	}
+
+	bool SystemScheduler::Conflicts(const System& t_First, const System& t_Second) const
+	{
+		if (t_First.IsExclusive || t_Second.IsExclusive)
+		{
+			return true;
+		}
+
+		auto Contains = [](const std::vector<ComponentType>& t_Types, ComponentType t_Type)
+		{
+			return std::find(t_Types.begin(), t_Types.end(), t_Type) != t_Types.end();
+		};
+
+		// Anything one writes can't be read or written by the other
+		for (ComponentType Type : t_First.Writes)
+		{
+			if (Contains(t_Second.Writes, Type) || Contains(t_Second.Reads, Type))
+			{
+				return true;
+			}
+		}
+
+		for (ComponentType Type : t_Second.Writes)
+		{
+			if (Contains(t_First.Reads, Type))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void SystemScheduler::BuildGraph()
+	{
+		const uint32 Count = static_cast<uint32>(m_Systems.size());
+		for (std::unique_ptr<System>& Sys : m_Systems)
+		{
+			Sys->Dependents.clear();
+			Sys->DependencyCount = 0;
+		}
+
+		// Longest chain of dependencies that ends at each system
+		std::vector<uint32> Depth(Count, 1);
+		m_CriticalPathLength = Count ? 1 : 0;
+
+		for (uint32 Later = 0; Later < Count; ++Later)
+		{
+			System& Cur = *m_Systems[Later];
+			for (uint32 Earlier = 0; Earlier < Later; ++Earlier)
+			{
+				System& Prev = *m_Systems[Earlier];
+
+				const bool IsExplicit = std::find(Cur.RunAfter.begin(), Cur.RunAfter.end(), Prev.Id) != Cur.RunAfter.end();
+				if (!IsExplicit && !Conflicts(Prev, Cur))
+				{
+					continue;
+				}
+
+				Prev.Dependents.push_back(Later);
+				++Cur.DependencyCount;
+				Depth[Later] = std::max(Depth[Later], Depth[Earlier] + 1);
+			}
+
+			m_CriticalPathLength = std::max(m_CriticalPathLength, Depth[Later]);
+		}
+
+		// Systems can only wait on ones that were added before them, so anything else is ignored
+		for (uint32 i = 0; i < Count; ++i)
+		{
+			for (SystemId Other : m_Systems[i]->RunAfter)
+			{
+				auto It = std::find_if(m_Systems.begin(), m_Systems.end(), [Other](const std::unique_ptr<System>& t_Sys) { return t_Sys->Id == Other; });
+				if (It != m_Systems.end() && static_cast<uint32>(std::distance(m_Systems.begin(), It)) > i)
+				{
+					F_LOG_WARN("System {} is set to run after {}, which was added after it. Ignoring the dependency", m_Systems[i]->Name, (*It)->Name);
+				}
+			}
+		}
+
+		m_IsGraphDirty = false;
+	}
+
+	void SystemScheduler::Run(float t_DeltaTime, bool t_IsPlaying)
+	{
+		FLING_PROFILE_SCOPE("SystemScheduler::Run");
+
+		if (m_IsGraphDirty)
+		{
+			BuildGraph();
+		}
+
+		if (m_Systems.empty())
+		{
+			return;
+		}
+
+		m_DeltaTime = t_DeltaTime;
+		m_IsPlaying = t_IsPlaying;
+
+		for (std::unique_ptr<System>& Sys : m_Systems)
+		{
+			Sys->PendingDependencies.store(Sys->DependencyCount, std::memory_order_relaxed);
+		}
+
+		JobCounter FrameCounter;
+		m_FrameCounter = &FrameCounter;
+
+		for (uint32 i = 0; i < m_Systems.size(); ++i)
+		{
+			if (m_Systems[i]->DependencyCount == 0)
+			{
+				QueueSystem(i);
+			}
+		}
+
+		// The calling thread helps out until every system is done
+		JobSystem::Get().Wait(FrameCounter);
+		m_FrameCounter = nullptr;
+	}
+
+	void SystemScheduler::QueueSystem(uint32 t_Index)
+	{
+		JobSystem& Jobs = JobSystem::Get();
+		Jobs.Run(Jobs.CreateJob([this, t_Index]() { RunSystem(t_Index); }), m_FrameCounter);
+	}
+
+	void SystemScheduler::RunSystem(uint32 t_Index)
+	{
+		System& Sys = *m_Systems[t_Index];
+
+		if (Sys.IsEnabled && (m_IsPlaying || Sys.IsAlwaysRun))
+		{
+			const auto Start = std::chrono::high_resolution_clock::now();
+			Sys.Function(m_Registry, m_DeltaTime);
+			Sys.LastTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+		}
+
+		// Dependents are queued before this job finishes so the frame counter can't hit 0 early
+		for (uint32 Dependent : Sys.Dependents)
+		{
+			if (m_Systems[Dependent]->PendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				QueueSystem(Dependent);
+			}
+		}
+	}
+}   // namespace Fling
@@ -0,0 +1,286 @@
+#include "pch.h"
+#include "TransformHierarchy.h"
+#include "Components/Transform.h"
+#include "JobSystem.h"
+
+namespace Fling
+{
+	TransformHierarchy::TransformHierarchy(entt::registry& t_Reg)
+		: m_Registry(t_Reg)
+	{
+		// Levels are loaded by assigning components, so this also catches hierarchies that are read from a file
+		t_Reg.on_construct<Hierarchy>().connect<&TransformHierarchy::OnHierarchyAdded>(*this);
+		t_Reg.on_destroy<Hierarchy>().connect<&TransformHierarchy::OnHierarchyRemoved>(*this);
+	}
+
+	TransformHierarchy::~TransformHierarchy()
+	{
+		m_Registry.on_construct<Hierarchy>().disconnect<&TransformHierarchy::OnHierarchyAdded>(*this);
+		m_Registry.on_destroy<Hierarchy>().disconnect<&TransformHierarchy::OnHierarchyRemoved>(*this);
+	}
+
+	bool TransformHierarchy::SetParent(entt::entity t_Child, entt::entity t_Parent)
+	{
+		// A child can't be above itself
+		for (entt::entity Cur = t_Parent; Cur != entt::null; )
+		{
+			if (Cur == t_Child)
+			{
+				F_LOG_WARN("Can't parent entity {} to {}, it would be its own ancestor", static_cast<uint32>(t_Child), static_cast<uint32>(t_Parent));
+				return false;
+			}
+
+			const Hierarchy* Node = m_Registry.try_get<Hierarchy>(Cur);
+			Cur = Node ? Node->Parent : entt::null;
+		}
+
+		// Assign both before taking references, adding to the pool can move its components
+		if (t_Parent != entt::null)
+		{
+			m_Registry.get_or_assign<Hierarchy>(t_Parent);
+		}
+		Hierarchy& Child = m_Registry.get_or_assign<Hierarchy>(t_Child);
+
+		Detach(t_Child, Child);
+
+		if (t_Parent != entt::null)
+		{
+			Hierarchy& Parent = m_Registry.get<Hierarchy>(t_Parent);
+			Child.Parent = t_Parent;
+			Child.NextSibling = Parent.FirstChild;
+			if (Parent.FirstChild != entt::null)
+			{
+				m_Registry.get<Hierarchy>(Parent.FirstChild).PrevSibling = t_Child;
+			}
+			Parent.FirstChild = t_Child;
+			++Parent.ChildCount;
+		}
+
+		if (Transform* Trans = m_Registry.try_get<Transform>(t_Child))
+		{
+			Trans->MarkDirty();
+		}
+
+		m_NeedsSort = true;
+		return true;
+	}
+
+	void TransformHierarchy::Detach(entt::entity t_Ent, Hierarchy& t_Node)
+	{
+		// Entities that are part of the same tree can be destroyed in any order when the registry is reset
+		auto GetNode = [this](entt::entity t_Other) -> Hierarchy*
+		{
+			return (t_Other != entt::null && m_Registry.valid(t_Other)) ? m_Registry.try_get<Hierarchy>(t_Other) : nullptr;
+		};
+
+		Hierarchy* Parent = GetNode(t_Node.Parent);
+
+		if (Hierarchy* Prev = GetNode(t_Node.PrevSibling))
+		{
+			Prev->NextSibling = t_Node.NextSibling;
+		}
+		else if (Parent && Parent->FirstChild == t_Ent)
+		{
+			Parent->FirstChild = t_Node.NextSibling;
+		}
+
+		if (Hierarchy* Next = GetNode(t_Node.NextSibling))
+		{
+			Next->PrevSibling = t_Node.PrevSibling;
+		}
+
+		if (Parent && Parent->ChildCount > 0)
+		{
+			--Parent->ChildCount;
+		}
+
+		t_Node.Parent = entt::null;
+		t_Node.PrevSibling = entt::null;
+		t_Node.NextSibling = entt::null;
+	}
+
+	void TransformHierarchy::UpdateWorldMatrices(entt::registry& t_Reg)
+	{
+		FLING_PROFILE_SCOPE("TransformHierarchy::UpdateWorldMatrices");
+
+		if (m_NeedsSort)
+		{
+			SortHierarchy();
+		}
+
+		PropagateDirty();
+
+		// Every dirty transform gets its local matrix. The storage is contiguous, so each job batches its own range
+		auto View = t_Reg.view<Transform>();
+		Transform* Transforms = View.raw();
+		JobSystem::Get().ParallelFor(static_cast<uint32>(View.size()), [Transforms](uint32 t_Begin, uint32 t_End)
+		{
+			Transform::CalculateWorldMatrices(Transforms + t_Begin, t_End - t_Begin);
+		}, 4096);
+
+		ApplyParents();
+	}
+
+	void TransformHierarchy::SortHierarchy()
+	{
+		FLING_PROFILE_SCOPE("TransformHierarchy::SortHierarchy");
+
+		auto View = m_Registry.view<Hierarchy>();
+		const uint32 NodeCount = static_cast<uint32>(View.size());
+
+		for (entt::entity Ent : View)
+		{
+			// Stop after as many steps as there are nodes in case a level file has a loop in it
+			entt::entity Root = Ent;
+			uint32 Depth = 0;
+			while (Depth < NodeCount)
+			{
+				const entt::entity Parent = m_Registry.get<Hierarchy>(Root).Parent;
+				if (Parent == entt::null || !m_Registry.valid(Parent) || !m_Registry.has<Hierarchy>(Parent))
+				{
+					break;
+				}
+				Root = Parent;
+				++Depth;
+			}
+
+			Hierarchy& Node = View.get(Ent);
+			Node.Root = Root;
+			Node.Depth = Depth;
+		}
+
+		// Iterating the pool now visits one subtree at a time, with every parent before its children
+		m_Registry.sort<Hierarchy>([](const Hierarchy& t_A, const Hierarchy& t_B)
+		{
+			if (t_A.Root != t_B.Root)
+			{
+				return static_cast<uint32>(t_A.Root) < static_cast<uint32>(t_B.Root);
+			}
+			return t_A.Depth < t_B.Depth;
+		});
+
+		m_Sorted.clear();
+		m_SubtreeStarts.clear();
+		entt::entity CurRoot = entt::null;
+		for (entt::entity Ent : View)
+		{
+			const entt::entity Root = View.get(Ent).Root;
+			if (m_Sorted.empty() || Root != CurRoot)
+			{
+				m_SubtreeStarts.push_back(static_cast<uint32>(m_Sorted.size()));
+				CurRoot = Root;
+			}
+			m_Sorted.push_back(Ent);
+		}
+		m_SubtreeStarts.push_back(static_cast<uint32>(m_Sorted.size()));
+
+		m_NeedsSort = false;
+	}
+
+	void TransformHierarchy::PropagateDirty()
+	{
+		FLING_PROFILE_SCOPE("TransformHierarchy::PropagateDirty");
+
+		const uint32 SubtreeCount = static_cast<uint32>(m_SubtreeStarts.size()) - 1;
+		m_SubtreeDirty.assign(SubtreeCount, 0);
+
+		// Subtrees don't share any entities, so each one can be walked on a different thread
+		JobSystem::Get().ParallelFor(SubtreeCount, [this](uint32 t_Begin, uint32 t_End)
+		{
+			for (uint32 Subtree = t_Begin; Subtree < t_End; ++Subtree)
+			{
+				for (uint32 i = m_SubtreeStarts[Subtree]; i < m_SubtreeStarts[Subtree + 1]; ++i)
+				{
+					const entt::entity Ent = m_Sorted[i];
+					Transform* Trans = m_Registry.try_get<Transform>(Ent);
+					if (!Trans)
+					{
+						continue;
+					}
+
+					const Hierarchy& Node = m_Registry.get<Hierarchy>(Ent);
+					if (Node.HasParent())
+					{
+						const Transform* ParentTrans = m_Registry.try_get<Transform>(Node.Parent);
+						if (ParentTrans && ParentTrans->IsDirty())
+						{
+							Trans->MarkDirty();
+						}
+					}
+
+					m_SubtreeDirty[Subtree] |= Trans->IsDirty() ? 1 : 0;
+				}
+			}
+		});
+	}
+
+	void TransformHierarchy::ApplyParents()
+	{
+		FLING_PROFILE_SCOPE("TransformHierarchy::ApplyParents");
+
+		const uint32 SubtreeCount = static_cast<uint32>(m_SubtreeDirty.size());
+		JobSystem::Get().ParallelFor(SubtreeCount, [this](uint32 t_Begin, uint32 t_End)
+		{
+			for (uint32 Subtree = t_Begin; Subtree < t_End; ++Subtree)
+			{
+				if (!m_SubtreeDirty[Subtree])
+				{
+					continue;
+				}
+
+				// Parents come first, so their world matrix is final by the time their children get here
+				for (uint32 i = m_SubtreeStarts[Subtree]; i < m_SubtreeStarts[Subtree + 1]; ++i)
+				{
+					const entt::entity Ent = m_Sorted[i];
+					const Hierarchy& Node = m_Registry.get<Hierarchy>(Ent);
+					Transform* Trans = Node.HasParent() ? m_Registry.try_get<Transform>(Ent) : nullptr;
+					if (!Trans || !Trans->HasWorldChanged())
+					{
+						continue;
+					}
+
+					if (const Transform* ParentTrans = m_Registry.try_get<Transform>(Node.Parent))
+					{
+						Trans->m_worldMat = ParentTrans->GetWorldMat() * Trans->m_worldMat;
+					}
+				}
+			}
+		});
+	}
+
+	void TransformHierarchy::OnHierarchyAdded(entt::entity t_Ent, entt::registry& t_Reg, Hierarchy& t_Node)
+	{
+		m_NeedsSort = true;
+	}
+
+	void TransformHierarchy::OnHierarchyRemoved(entt::entity t_Ent, entt::registry& t_Reg)
+	{
+		Hierarchy& Node = t_Reg.get<Hierarchy>(t_Ent);
+		Detach(t_Ent, Node);
+
+		entt::entity Child = Node.FirstChild;
+		while (Child != entt::null && t_Reg.valid(Child))
+		{
+			Hierarchy* ChildNode = t_Reg.try_get<Hierarchy>(Child);
+			if (!ChildNode)
+			{
+				break;
+			}
+
+			const entt::entity Next = ChildNode->NextSibling;
+			ChildNode->Parent = entt::null;
+			ChildNode->PrevSibling = entt::null;
+			ChildNode->NextSibling = entt::null;
+
+			if (Transform* Trans = t_Reg.try_get<Transform>(Child))
+			{
+				Trans->MarkDirty();
+			}
+			Child = Next;
+		}
+
+		Node.FirstChild = entt::null;
+		Node.ChildCount = 0;
+		m_NeedsSort = true;
+	}
+}   // namespace Fling
@@ -1,11 +1,53 @@
 #include "pch.h"
 #include "World.h"
+#include "ResourceManager.h"
+#include "Model.h"
+#include "Material.h"
+#include "Components/Transform.h"
+#include "Components/Hierarchy.h"
+#include "Components/StaticBatch.h"
+#include "MeshRenderer.h"
+#include "StaticMeshMerger.h"
+#include "JobSystem.h"
+#include "Lighting/PointLight.hpp"
+
+#include <deque>
+#include <unordered_map>
 
 namespace Fling
 {
+	namespace
+	{
+		/** A Guid only points at its string, so the names of merged models have to outlive them */
+		std::deque<std::string> StaticBatchModelNames;
+
+		/**
+		 * World matrix of an entity that was just loaded, before the transform system has run. Follows
+		 * the parents up, with a limit in case a level file has a loop in it
+		 */
+		glm::mat4 GetLoadedWorldMatrix(const entt::registry& t_Reg, entt::entity t_Ent)
+		{
+			glm::mat4 World = t_Reg.get<Transform>(t_Ent).GetWorldMatrix();
+
+			const Hierarchy* Node = t_Reg.try_get<Hierarchy>(t_Ent);
+			for (uint32 Depth = 0; Node && Node->HasParent() && t_Reg.valid(Node->Parent) && Depth < 256; ++Depth)
+			{
+				if (const Transform* ParentTrans = t_Reg.try_get<Transform>(Node->Parent))
+				{
+					World = ParentTrans->GetWorldMatrix() * World;
+				}
+				Node = t_Reg.try_get<Hierarchy>(Node->Parent);
+			}
+			return World;
+		}
+	}
+
 	World::World(entt::registry& t_Reg, Fling::Game* t_Game)
 		: m_Registry(t_Reg)
 		, m_Game(t_Game)
+		, m_Systems(t_Reg)
+		, m_SpatialTree(t_Reg)
+		, m_Hierarchy(t_Reg)
 		, m_ShouldQuit(false)
 	{ }
 
@@ -20,6 +62,9 @@ namespace Fling
 		// Initialize the game! Here is where people will load lua scripts and binnd input callbacks
 		m_Game->Init(m_Registry);
 
+		m_Game->RegisterSystems(m_Systems);
+		RegisterEngineSystems();
+
 		m_CurrentState = WorldState::Initalized;
     }
 
@@ -35,6 +80,9 @@ namespace Fling
 		// Shut down the game
 		m_Game->Shutdown(m_Registry);
 
+		// Game systems can reference the game, which is about to be deleted
+		m_Systems.Clear();
+
 		F_LOG_TRACE("World shutdown complete!");
     }
 
@@ -61,8 +109,275 @@ namespace Fling
 		// Load a level back so that we clear out the game state
 	}
 	
+	void World::RegisterEngineSystems()
+	{
+		// Only transforms that were moved, or whose parent was, get a new matrix. Static ones just clear their changed flag
+		m_Systems.AddSystem("Transform World Matrices", [this](entt::registry& t_Reg, float t_DeltaTime)
+		{
+			m_Hierarchy.UpdateWorldMatrices(t_Reg);
+		})
+		.Writes<Transform, Hierarchy>()
+		.AlwaysRun();
+
+		m_Systems.AddSystem("Point Light Positions", [](entt::registry& t_Reg, float t_DeltaTime)
+		{
+			t_Reg.view<PointLight, Transform>().each([](entt::entity t_Ent, PointLight& t_Light, const Transform& t_Trans)
+			{
+				// The position can be relative to a parent
+				t_Light.SetPos(t_Trans.GetWorldMat()[3]);
+			});
+		})
+		.Reads<Transform>()
+		.Writes<PointLight>()
+		.AlwaysRun();
+
+		// The tree isn't a component, but the scheduler treats it like one so nothing else touches it at the same time
+		m_Systems.AddSystem("Spatial Tree Refit", [this](entt::registry& t_Reg, float t_DeltaTime)
+		{
+			m_SpatialTree.Refit(t_Reg);
+		})
+		.Reads<Transform, MeshRenderer>()
+		.Writes<SpatialTree>()
+		.AlwaysRun();
+	}
+
+	void World::PrefetchLevelResources(const std::string& t_FullPath)
+	{
+		nlohmann::json LevelData;
+		try
+		{
+			std::ifstream InputStream(t_FullPath);
+			if (!InputStream.is_open())
+			{
+				return;
+			}
+			InputStream >> LevelData;
+		}
+		catch (std::exception& e)
+		{
+			F_LOG_WARN("Failed to prefetch level resources from {} : {}", t_FullPath, e.what());
+			return;
+		}
+
+		uint32 RequestCount = 0;
+
+		// Mesh renderers can be anywhere in the snapshot, so look through all of it
+		std::vector<const nlohmann::json*> ToVisit = { &LevelData };
+		while (!ToVisit.empty())
+		{
+			const nlohmann::json* Cur = ToVisit.back();
+			ToVisit.pop_back();
+
+			if (Cur->is_object())
+			{
+				for (auto It = Cur->begin(); It != Cur->end(); ++It)
+				{
+					if (It.value().is_string())
+					{
+						const std::string& Path = It.value().get_ref<const std::string&>();
+						if (It.key() == "MESH_NAME")
+						{
+							ResourceManager::LoadResourceAsync<Model>(HS(Path.c_str()));
+							++RequestCount;
+						}
+						else if (It.key() == "MATERIAL_NAME")
+						{
+							ResourceManager::LoadResourceAsync<Material>(HS(Path.c_str()));
+							++RequestCount;
+						}
+					}
+					else if (It.value().is_structured())
+					{
+						ToVisit.push_back(&It.value());
+					}
+				}
+			}
+			else if (Cur->is_array())
+			{
+				for (const nlohmann::json& Elm : *Cur)
+				{
+					if (Elm.is_structured())
+					{
+						ToVisit.push_back(&Elm);
+					}
+				}
+			}
+		}
+
+		F_LOG_TRACE("Prefetching {} level resources", RequestCount);
+	}
+
+	void World::BuildStaticBatches()
+	{
+		FLING_PROFILE_SCOPE("World::BuildStaticBatches");
+
+		ClearStaticBatches();
+
+		if (!FlingConfig::GetBool("Engine", "StaticBatching", true))
+		{
+			return;
+		}
+
+		// Only meshes that the G-Buffer pass draws are merged, other material types are drawn by their own subpasses
+		std::vector<entt::entity> Entities;
+		m_Registry.view<StaticBatch, Transform, MeshRenderer>().each([&](entt::entity t_Ent, StaticBatch& t_Batch, Transform& t_Trans, MeshRenderer& t_MeshRend)
+		{
+			if (t_MeshRend.m_Model && t_MeshRend.m_Material && m_Registry.has<entt::tag<"Default"_hs>>(t_Ent))
+			{
+				Entities.emplace_back(t_Ent);
+			}
+		});
+
+		if (Entities.size() < 2)
+		{
+			return;
+		}
+
+		// Models usually release their vertices once they are uploaded, so those are read from their file again
+		std::unordered_map<const Model*, uint32> ModelIds;
+		std::vector<const Model*> Models;
+		for (entt::entity Ent : Entities)
+		{
+			const Model* EntModel = m_Registry.get<MeshRenderer>(Ent).m_Model.Get();
+			if (ModelIds.emplace(EntModel, static_cast<uint32>(Models.size())).second)
+			{
+				Models.emplace_back(EntModel);
+			}
+		}
+
+		std::vector<std::unique_ptr<Model::LoadData>> Decoded(Models.size());
+		JobSystem::Get().ParallelFor(static_cast<uint32>(Models.size()), [&Models, &Decoded](uint32 t_Begin, uint32 t_End)
+		{
+			for (uint32 i = t_Begin; i < t_End; ++i)
+			{
+				const std::string& Path = Models[i]->GetGuidString();
+				const bool IsFile = Path.size() > 4 && Path.compare(Path.size() - 4, 4, ".obj") == 0;
+				if (Models[i]->GetVerts().empty() && IsFile)
+				{
+					Decoded[i] = Model::Decode(HS(Path.c_str()));
+				}
+			}
+		}, 1);
+
+		std::unordered_map<const Material*, uint32> MaterialIds;
+		std::vector<Handle<Material>> Materials;
+
+		StaticMeshMerger Merger(static_cast<float>(FlingConfig::GetInt("Engine", "StaticBatchCellSize", 32)));
+		std::vector<entt::entity> SourceEntities;
+		SourceEntities.reserve(Entities.size());
+
+		for (entt::entity Ent : Entities)
+		{
+			const MeshRenderer& MeshRend = m_Registry.get<MeshRenderer>(Ent);
+			const uint32 ModelId = ModelIds[MeshRend.m_Model.Get()];
+
+			const std::vector<Vertex>* Verts = &Models[ModelId]->GetVerts();
+			const std::vector<uint32>* Indices = &Models[ModelId]->GetIndices();
+			if (Decoded[ModelId])
+			{
+				Verts = &Decoded[ModelId]->Verts;
+				Indices = &Decoded[ModelId]->Indices;
+			}
+
+			// Models that were made in code and didn't keep their vertices are drawn on their own
+			if (Verts->empty() || Indices->empty())
+			{
+				continue;
+			}
+
+			auto MatId = MaterialIds.emplace(MeshRend.m_Material.Get(), static_cast<uint32>(Materials.size()));
+			if (MatId.second)
+			{
+				Materials.emplace_back(MeshRend.m_Material);
+			}
+
+			StaticMeshMerger::Source Src = {};
+			Src.Verts = Verts->data();
+			Src.VertexCount = static_cast<uint32>(Verts->size());
+			Src.Indices = Indices->data();
+			Src.IndexCount = static_cast<uint32>(Indices->size());
+			Src.World = GetLoadedWorldMatrix(m_Registry, Ent);
+			Src.Material = MatId.first->second;
+			Src.Group = m_Registry.get<StaticBatch>(Ent).Group;
+
+			Merger.Add(Src);
+			SourceEntities.emplace_back(Ent);
+		}
+
+		Merger.Build();
+
+		// Models and entities can only be created on the main thread
+		uint32 MergedCount = 0;
+		uint32 MergedSourceCount = 0;
+		for (StaticMeshMerger::MergedMesh& Mesh : Merger.GetMeshes())
+		{
+			// Merging a mesh with nothing else only adds another copy of it
+			if (Mesh.Sources.size() < 2)
+			{
+				continue;
+			}
+
+			StaticBatchModelNames.emplace_back("StaticBatch_" + std::to_string(StaticBatchModelNames.size()));
+			const Guid ModelId = HS(StaticBatchModelNames.back().c_str());
+
+			std::unique_ptr<Model::LoadData> Data = std::make_unique<Model::LoadData>();
+			Data->Verts = std::move(Mesh.Verts);
+			Data->Indices = std::move(Mesh.Indices);
+			ResourceManager::LoadResource<Model>(ModelId, std::move(Data));
+
+			entt::entity Merged = m_Registry.create();
+			m_Registry.assign<Transform>(Merged);
+			m_Registry.assign<MeshRenderer>(Merged, ResourceManager::LoadHandle<Model>(ModelId), Materials[Mesh.Material]);
+
+			StaticBatchMesh& Batch = m_Registry.assign<StaticBatchMesh>(Merged);
+			Batch.SourceFirstIndex = std::move(Mesh.SourceFirstIndex);
+			Batch.Sources.reserve(Mesh.Sources.size());
+			for (uint32 Source : Mesh.Sources)
+			{
+				const entt::entity SourceEnt = SourceEntities[Source];
+				Batch.Sources.emplace_back(SourceEnt);
+
+				// The source stays in the spatial tree for picking, it just isn't drawn
+				m_Registry.get<StaticBatch>(SourceEnt).MergedInto = Merged;
+				m_Registry.remove<entt::tag<"Default"_hs>>(SourceEnt);
+			}
+			++MergedCount;
+			MergedSourceCount += static_cast<uint32>(Mesh.Sources.size());
+		}
+
+		F_LOG_TRACE("Merged {} static meshes into {}", MergedSourceCount, MergedCount);
+	}
+
+	void World::ClearStaticBatches()
+	{
+		auto MergedView = m_Registry.view<StaticBatchMesh>();
+		if (MergedView.empty())
+		{
+			return;
+		}
+
+		std::vector<entt::entity> Merged(MergedView.begin(), MergedView.end());
+		m_Registry.destroy(Merged.begin(), Merged.end());
+
+		m_Registry.view<StaticBatch>().each([this](entt::entity t_Ent, StaticBatch& t_Batch)
+		{
+			if (t_Batch.MergedInto == entt::null)
+			{
+				return;
+			}
+
+			t_Batch.MergedInto = entt::null;
+			if (!m_Registry.has<entt::tag<"Default"_hs>>(t_Ent))
+			{
+				m_Registry.assign<entt::tag<"Default"_hs>>(t_Ent);
+			}
+		});
+	}
+
     void World::Update(float t_DeltaTime)
     {
+		FLING_PROFILE_SCOPE("World::Update");
+
 		if(m_CurrentState == WorldState::Playing)
 		{
 			// Once we are done with core updates, then call the game!
@@ -70,5 +385,8 @@ namespace Fling
 
 			// #TODO Update physics here
 		}
+
+		// Engine systems still run while stopped so the editor sees up to date transforms
+		m_Systems.Run(t_DeltaTime, IsPlaying());
     }
 } // namespace Fling
\ No newline at end of file
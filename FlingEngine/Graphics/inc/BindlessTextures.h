@@ -0,0 +1,79 @@
+#pragma once
+
+#include "FlingVulkan.h"
+#include "FlingTypes.h"
+#include "NonCopyable.hpp"
+
+#include <vector>
+
+namespace Fling
+{
+	class LogicalDevice;
+
+	/**
+	* @brief	One global array of combined image samplers that every texture registers itself into, so
+	*			that a shader picks its textures with an index instead of each material having its own
+	*			descriptor set. Binding this set once is enough for any number of materials.
+	*
+	*			The set is update after bind and partially bound, so textures can be added and removed
+	*			while frames that use the set are in flight, and slots without a texture are fine as
+	*			long as no shader reads them.
+	*
+	* @note		Only exists if the device has descriptor indexing. Main thread only. @see VulkanApp::GetBindlessTextures
+	*/
+	class BindlessTextures : public NonCopyable
+	{
+	public:
+
+		/** Slot of a texture that isn't in the array */
+		static const uint32 INVALID_SLOT = ~0u;
+
+		/** Set that shaders declare the array in. Set 0 is the pipeline's own */
+		static const uint32 SET_INDEX = 1;
+
+		/** Binding of the array in its set */
+		static const uint32 TEXTURE_BINDING = 0;
+
+		/**
+		* @param t_Dev		Device that has descriptor indexing enabled. @see LogicalDevice::IsDescriptorIndexingEnabled
+		* @param t_Capacity	Most textures that can be registered at once. Clamped to the device's limits
+		*/
+		BindlessTextures(const LogicalDevice* t_Dev, uint32 t_Capacity);
+
+		~BindlessTextures();
+
+		/** Put an image in the array. @return Its slot, or INVALID_SLOT if the array is full */
+		uint32 Register(const VkDescriptorImageInfo& t_Image);
+
+		/** Give up a slot so that another texture can use it. Nothing may read it after this */
+		void Unregister(uint32 t_Slot);
+
+		FORCEINLINE VkDescriptorSetLayout GetSetLayout() const { return m_SetLayout; }
+
+		FORCEINLINE VkDescriptorSet GetSet() const { return m_Set; }
+
+		FORCEINLINE uint32 GetCapacity() const { return m_Capacity; }
+
+		/** Number of textures that are registered */
+		FORCEINLINE uint32 GetCount() const { return m_Count; }
+
+	private:
+
+		const LogicalDevice* m_Device = nullptr;
+
+		VkDescriptorSetLayout m_SetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool m_Pool = VK_NULL_HANDLE;
+		VkDescriptorSet m_Set = VK_NULL_HANDLE;
+
+		uint32 m_Capacity = 0;
+		uint32 m_Count = 0;
+
+		/** Slots below this have been handed out at least once */
+		uint32 m_NextSlot = 0;
+
+		/** Slots that were unregistered and can be handed out again */
+		std::vector<uint32> m_FreeSlots;
+
+		bool m_HasLoggedFull = false;
+	};
+}   // namespace Fling
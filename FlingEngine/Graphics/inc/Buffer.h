@@ -2,6 +2,7 @@
 
 #include "FlingVulkan.h"
 #include "FlingExports.h"
+#include "DeviceMemoryAllocator.h"
 
 namespace Fling
 {
@@ -18,7 +19,7 @@ namespace Fling
         Buffer()
             : m_Size(0)
             , m_Buffer(VK_NULL_HANDLE)
-            , m_BufferMemory(VK_NULL_HANDLE)
+            , m_Allocation{}
             , m_Descriptor{}
             , m_MappedMem(nullptr)
         {
@@ -52,7 +53,11 @@ namespace Fling
 
         FORCEINLINE const VkBuffer& GetVkBuffer() const { return m_Buffer; }
 
-        FORCEINLINE const VkDeviceMemory& GetVkDeviceMemory() const { return m_BufferMemory; }
+        /** The memory block this buffer lives in. Shared with other resources, so use GetMemoryOffset too */
+        FORCEINLINE const VkDeviceMemory& GetVkDeviceMemory() const { return m_Allocation.Memory; }
+
+        /** Offset of this buffer inside of its VkDeviceMemory */
+        FORCEINLINE VkDeviceSize GetMemoryOffset() const { return m_Allocation.Offset; }
 
         FORCEINLINE const VkDeviceSize& GetSize() const { return m_Size; }
 
@@ -78,12 +83,14 @@ namespace Fling
          * 
          * @return true     memory is not null and the size is greater than 0
          */
-        bool IsUsed() const { return m_BufferMemory != VK_NULL_HANDLE && m_Buffer != VK_NULL_HANDLE && m_Size; }
+        bool IsUsed() const { return m_Allocation.IsValid() && m_Buffer != VK_NULL_HANDLE && m_Size; }
 
         /**
-         * @brief Map the memory of this buffer to the given data
+         * @brief Map the memory of this buffer to m_MappedMem. Host visible memory is persistently
+         *        mapped by the allocator, so this is just pointer math
          *
-         * @param t_Data    Where to map this buffer's data to
+         * @param t_Size    Size of the range to map (Unused, the whole buffer is always mapped)
+         * @param t_Offset  Offset from the start of this buffer
          */
         VkResult MapMemory(VkDeviceSize t_Size = VK_WHOLE_SIZE, VkDeviceSize t_Offset = 0);
         
@@ -126,8 +133,8 @@ namespace Fling
         /** Vulkan logical buffer object */
         VkBuffer m_Buffer;
 
-        /** Pointer to the physical device memory for this buffer */
-        VkDeviceMemory m_BufferMemory;
+        /** The device memory for this buffer, sub-allocated by the DeviceMemoryAllocator */
+        DeviceAllocation m_Allocation;
 
         /** The descriptor stores info about the offset, buffer, and; size of this */
         VkDescriptorBufferInfo m_Descriptor;
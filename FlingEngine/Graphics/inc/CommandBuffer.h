@@ -32,7 +32,7 @@ namespace Fling
 			Executable,
 		};
 
-		CommandBuffer(const LogicalDevice* t_Device, VkCommandPool t_CmdPool);
+		CommandBuffer(const LogicalDevice* t_Device, VkCommandPool t_CmdPool, VkCommandBufferLevel t_Level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 		~CommandBuffer();
 
 		inline VkCommandBuffer GetHandle() const { return m_Handle; }
@@ -42,7 +42,15 @@ namespace Fling
 		/** Begin recording for this command buffer */
 		void Begin(VkCommandBufferUsageFlagBits t_Usage = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
 
-		void BeginRenderPass(const FrameBuffer& t_frameBuf, const std::vector<VkClearValue>& t_ClearVales);
+		/**
+		 * @brief Begin recording a secondary command buffer that will be executed inside of a subpass
+		 * of the frame buffer's render pass. @see ExecuteCommands
+		 * @param t_InheritedStatistics	Has to include the statistics of any pipeline statistics query that is active when this is executed
+		 */
+		void BeginSecondary(const FrameBuffer& t_frameBuf, uint32 t_Subpass = 0, VkQueryPipelineStatisticFlags t_InheritedStatistics = 0);
+
+		/** Use VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS if the first subpass is recorded in secondary command buffers */
+		void BeginRenderPass(const FrameBuffer& t_frameBuf, const std::vector<VkClearValue>& t_ClearVales, VkSubpassContents t_Contents = VK_SUBPASS_CONTENTS_INLINE);
 
 		void NextSubpass();
 
@@ -54,16 +62,23 @@ namespace Fling
 
 		void EndRenderPass();
 
+		/** Execute secondary command buffers that have finished recording */
+		void ExecuteCommands(const std::vector<VkCommandBuffer>& t_Secondaries);
+
 		/** Stop recording commands to the command buffer */
 		void End();
 
 		inline bool IsRecording() const { return m_State == State::Recording; }
 
+		inline VkCommandBufferLevel GetLevel() const { return m_Level; }
+
 	private:
 		const LogicalDevice* m_Device;
 
 		const VkCommandPool m_Pool;
 
+		const VkCommandBufferLevel m_Level;
+
 		VkCommandBuffer m_Handle = VK_NULL_HANDLE;
 
 		// Keep track of the state of this command buffer
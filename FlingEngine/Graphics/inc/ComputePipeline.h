@@ -0,0 +1,40 @@
+#pragma once
+
+#include "FlingVulkan.h"
+#include "Shader.h"
+
+namespace Fling
+{
+    /**
+    * @brief    A pipeline with a single compute shader. The descriptor set layout is reflected from the
+    *           shader like a GraphicsPipeline's, with one push constant range if the shader uses one.
+    */
+    class ComputePipeline
+    {
+    public:
+
+        ComputePipeline(Shader* t_Shader, VkDevice t_LogicalDevice, uint32 t_PushConstantSize = 0);
+
+        ~ComputePipeline();
+
+        void Bind(VkCommandBuffer t_CommandBuffer) const;
+
+        /** Dispatch enough work groups to cover this many invocations in each dimension */
+        void Dispatch(VkCommandBuffer t_CommandBuffer, uint32 t_X, uint32 t_Y = 1, uint32 t_Z = 1) const;
+
+        Shader* GetShader() const { return m_Shader; }
+        const VkDescriptorSetLayout& GetDescriptorSetLayout() const { return m_DescriptorSetLayout; }
+        const VkPipeline& GetPipeline() const { return m_Pipeline; }
+        const VkPipelineLayout& GetPipelineLayout() const { return m_PipelineLayout; }
+
+    private:
+
+        Shader* m_Shader = nullptr;
+
+        VkDevice m_Device = VK_NULL_HANDLE;
+
+        VkPipeline m_Pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+        VkDescriptorSetLayout m_DescriptorSetLayout = VK_NULL_HANDLE;
+    };
+}   // namespace Fling
@@ -78,7 +78,7 @@ namespace Fling
             VkIndexType GetIndexType() const { return m_Cube->GetIndexType(); }
 
             VkImage GetImage() const { return m_Image; }
-            VkDeviceMemory GetImageMemory() const{ return m_ImageMemory; }
+            const DeviceAllocation& GetImageMemory() const{ return m_ImageMemory; }
             VkDescriptorImageInfo& GetImageInfo() { return m_DescriptorImageInfo; }
 
         private:
@@ -104,7 +104,7 @@ namespace Fling
             VkImage m_Image;
             VkImageView m_Imageview;
             VkImageLayout m_ImageLayout;
-            VkDeviceMemory m_ImageMemory;
+            DeviceAllocation m_ImageMemory;
             VkSampler m_Sampler;
             
             VkDescriptorSetLayout m_DescriptorSetLayout;
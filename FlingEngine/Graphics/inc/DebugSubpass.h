@@ -10,6 +10,7 @@ namespace Fling
 	struct MeshRenderer;
 	class Swapchain;
 	class FirstPersonCamera;
+	class UniformBufferRing;
 
 	class DebugSubpass : public Subpass
 	{
@@ -26,9 +27,11 @@ namespace Fling
 
 		virtual ~DebugSubpass();
 
+		const char* GetName() const override { return "Debug"; }
+
 		void Draw(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight, entt::registry& t_reg, float DeltaTime) override;
 
-		void CreateDescriptorSets(VkDescriptorPool t_Pool, entt::registry& t_reg) override;
+		void CreateDescriptorSets(DescriptorAllocator& t_Allocator, entt::registry& t_reg) override;
 
 		void PrepareAttachments() override;
 
@@ -40,7 +43,7 @@ namespace Fling
 
 		void OnMeshRendererAdded(entt::entity t_Ent, entt::registry& t_Reg, MeshRenderer& t_MeshRend);
 
-		void CreateMeshDescriptorSet(MeshRenderer& t_MeshRend);
+		void CreateUniformDescriptorSet();
 
 		VkRenderPass m_GlobalRenderPass = VK_NULL_HANDLE;
 
@@ -52,6 +55,9 @@ namespace Fling
 			glm::mat4 Model;
 		} m_Ubo;
 
-		VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
+		/** Every debug mesh shares this set, the UBO is picked with a dynamic offset into the ring */
+		VkDescriptorSet m_DescriptorSet = VK_NULL_HANDLE;
+
+		std::unique_ptr<UniformBufferRing> m_UniformRing;
 	};
 }   // namespace Fling
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "FlingVulkan.h"
+#include "DeviceMemoryAllocator.h"
 
 namespace Fling
 {
@@ -14,7 +15,7 @@ namespace Fling
 		~DepthBuffer();
 
 		FORCEINLINE const VkImage& GetVkImage() const { return m_Image; }
-		FORCEINLINE const VkDeviceMemory& GetVkMemory() const { return m_Memory; }
+		FORCEINLINE const DeviceAllocation& GetVkMemory() const { return m_Memory; }
 		FORCEINLINE const VkImageView& GetVkImageView() const { return m_ImageView; }
 		FORCEINLINE const VkFormat& GetFormat() const { return m_Format; }
 
@@ -45,7 +46,7 @@ namespace Fling
 		const LogicalDevice* m_Device;
 
 		VkImage m_Image = VK_NULL_HANDLE;
-		VkDeviceMemory m_Memory = VK_NULL_HANDLE;
+		DeviceAllocation m_Memory = {};
 		VkImageView m_ImageView = VK_NULL_HANDLE;
 		VkFormat m_Format{};
 		VkExtent2D m_Extents{};
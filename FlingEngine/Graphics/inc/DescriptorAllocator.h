@@ -0,0 +1,201 @@
+#pragma once
+
+#include "FlingVulkan.h"
+#include "FlingTypes.h"
+#include "NonCopyable.hpp"
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace Fling
+{
+	class LogicalDevice;
+
+	struct DescriptorAllocatorStats
+	{
+		/** Pools of long lived sets, and the sets that are allocated out of them */
+		uint32 PersistentPools = 0;
+		uint32 PersistentSets = 0;
+
+		/** Pools that transient sets are allocated out of, including the ones that are waiting to be reused */
+		uint32 TransientPools = 0;
+
+		/** Transient sets allocated since the frame in flight was last started */
+		uint32 TransientSetsThisFrame = 0;
+
+		/** Sets in the cache, and how often a set was found in it or had to be written */
+		uint32 CachedSets = 0;
+		uint64 CacheHits = 0;
+		uint64 CacheMisses = 0;
+
+		/** Pools made since startup. Every one after the first of its kind was made because the others were full */
+		uint32 PoolsCreated = 0;
+	};
+
+	/**
+	* @brief	Allocates every descriptor set out of pools that it makes as they are needed, so that
+	*			nothing has to guess how many sets it will need up front. When a pool is out of room or
+	*			fragmented another one is made, each new one holding twice as many sets as the last up to
+	*			a limit.
+	*
+	*			The room left in each pool is tracked here, so a pool is never asked for more than it has
+	*			even without VK_KHR_maintenance1. That needs the descriptors of each layout. @see RegisterLayout
+	*
+	*			Long lived sets come from pools that can free single sets. Transient sets come from
+	*			pools that belong to a frame in flight, and are reset as a whole when the frame comes
+	*			around again. Sets can also be cached by their layout and what they point at, so that
+	*			users with the same bindings share one set.
+	*
+	* @note		Main thread only. Update after bind layouts need their own pool, @see BindlessTextures
+	* @see		VulkanApp::GetDescriptorAllocator
+	*/
+	class DescriptorAllocator : public NonCopyable
+	{
+	public:
+
+		/** Most sets that one pool is made with, no matter how many pools there are */
+		static constexpr uint32 MAX_SETS_PER_POOL = 4096;
+
+		/** Descriptor types that pools are made with. Every core type, but none from extensions */
+		static constexpr uint32 DESCRIPTOR_TYPE_COUNT = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT + 1;
+
+		/** Descriptors of each type, indexed by VkDescriptorType */
+		struct DescriptorCounts
+		{
+			uint32 Count[DESCRIPTOR_TYPE_COUNT] = {};
+		};
+
+		/**
+		* @param t_Dev				Device to make the pools with
+		* @param t_FramesInFlight	Number of frames that have their own transient pools
+		* @param t_SetsPerPool		Sets in the first pool of each kind. Later pools are larger
+		*/
+		DescriptorAllocator(const LogicalDevice* t_Dev, uint32 t_FramesInFlight, uint32 t_SetsPerPool);
+
+		~DescriptorAllocator();
+
+		/**
+		* @brief	Remember the descriptors that a layout has so that sets of it only go in pools with room
+		*			for them, and the first pool that it is allocated from is big enough. A new layout with
+		*			the same handle replaces the old one. @see Shader::CreateSetLayout
+		*/
+		void RegisterLayout(VkDescriptorSetLayout t_Layout, const std::vector<VkDescriptorSetLayoutBinding>& t_Bindings);
+
+		/** Allocate a set that is valid until it is given to Free */
+		VkDescriptorSet Allocate(VkDescriptorSetLayout t_Layout);
+
+		/** Give a set from Allocate back. Nothing can use it after this */
+		void Free(VkDescriptorSet t_Set);
+
+		/** Allocate a set that is only valid until t_FrameInFlight is started again. @see BeginFrame */
+		VkDescriptorSet AllocateTransient(VkDescriptorSetLayout t_Layout, uint32 t_FrameInFlight);
+
+		/** Reset the transient pools of a frame. Its fence has to have been waited on */
+		void BeginFrame(uint32 t_FrameInFlight);
+
+		/**
+		* @brief	Get a set of this layout with these writes, writing a new one the first time. Each call
+		*			adds a reference to the set, which ReleaseCached takes away. The dstSet of the writes is
+		*			ignored, and every resource they point at has to outlive the set
+		*/
+		VkDescriptorSet GetCached(VkDescriptorSetLayout t_Layout, const std::vector<VkWriteDescriptorSet>& t_Writes);
+
+		/** Take away a reference from GetCached, freeing the set once there are none left */
+		void ReleaseCached(VkDescriptorSet t_Set);
+
+		DescriptorAllocatorStats GetStats() const;
+
+	private:
+
+		struct Pool
+		{
+			VkDescriptorPool Handle = VK_NULL_HANDLE;
+
+			/** What the pool was made with */
+			uint32 MaxSets = 0;
+			DescriptorCounts MaxDescriptors;
+
+			/** What is left in it */
+			uint32 FreeSets = 0;
+			DescriptorCounts FreeDescriptors;
+		};
+
+		struct PoolList
+		{
+			std::vector<Pool> Pools;
+
+			/** Sets that the next pool is made with */
+			uint32 NextPoolSets = 0;
+		};
+
+		struct TransientFrame
+		{
+			/** Indices into m_Transient of pools with sets from this frame. The last one is allocated out of */
+			std::vector<uint32> UsedPools;
+
+			uint32 SetCount = 0;
+		};
+
+		/** The pool that a long lived set came from, and what it took from it */
+		struct PersistentSet
+		{
+			uint32 PoolIndex = 0;
+			DescriptorCounts Descriptors;
+		};
+
+		struct CacheEntry
+		{
+			VkDescriptorSet Set = VK_NULL_HANDLE;
+			uint32 RefCount = 0;
+		};
+
+		/**
+		* @brief	Make a pool that holds t_List.NextPoolSets sets, and double the size of the next one
+		* @param t_MinDescriptors	The pool has at least this many of each type, so that the set it was made for fits
+		* @return	Index of the pool in t_List
+		*/
+		uint32 CreatePool(PoolList& t_List, VkDescriptorPoolCreateFlags t_Flags, const DescriptorCounts& t_MinDescriptors);
+
+		/** Try to allocate a set out of a single pool. @return False if the pool is out of room */
+		bool TryAllocate(Pool& t_Pool, VkDescriptorSetLayout t_Layout, const DescriptorCounts& t_Descriptors, VkDescriptorSet& t_OutSet) const;
+
+		/** Descriptors in a layout, or none if it was never registered */
+		const DescriptorCounts& GetLayoutDescriptors(VkDescriptorSetLayout t_Layout);
+
+		/** The layout, then the binding, type and resources of every write */
+		typedef std::vector<uint64> CacheKey;
+
+		static CacheKey MakeCacheKey(VkDescriptorSetLayout t_Layout, const std::vector<VkWriteDescriptorSet>& t_Writes);
+
+		const LogicalDevice* m_Device = nullptr;
+
+		PoolList m_Persistent;
+
+		std::unordered_map<VkDescriptorSet, PersistentSet> m_PersistentSets;
+
+		PoolList m_Transient;
+
+		/** Indices into m_Transient of pools that have been reset and can be used by any frame */
+		std::vector<uint32> m_FreeTransientPools;
+
+		/** @see RegisterLayout */
+		std::unordered_map<VkDescriptorSetLayout, DescriptorCounts> m_LayoutDescriptors;
+
+		bool m_HasLoggedUnknownLayout = false;
+
+		std::vector<TransientFrame> m_Frames;
+
+		/** Index into m_Frames of the frame that was started last */
+		uint32 m_CurrentFrame = 0;
+
+		std::map<CacheKey, CacheEntry> m_Cache;
+
+		/** Key of each cached set, to find its entry when it is released */
+		std::unordered_map<VkDescriptorSet, CacheKey> m_CacheKeys;
+
+		uint64 m_CacheHits = 0;
+		uint64 m_CacheMisses = 0;
+		uint32 m_PoolsCreated = 0;
+	};
+}   // namespace Fling
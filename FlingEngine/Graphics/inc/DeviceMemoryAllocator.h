@@ -0,0 +1,210 @@
+#pragma once
+
+#include "FlingVulkan.h"
+#include "FlingTypes.h"
+#include "NonCopyable.hpp"
+#include "TlsfAllocator.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Fling
+{
+	class LogicalDevice;
+	struct DeviceMemoryBlock;
+
+	/** What an allocation is used for. Only used to keep track of stats */
+	enum class DeviceMemoryCategory : uint8
+	{
+		Geometry,		// Vertex and index buffers
+		Uniform,		// Uniform and storage buffers
+		Staging,		// Host visible transfer sources
+		Texture,		// Sampled images
+		RenderTarget,	// Color and depth attachments
+		Other,
+
+		Count
+	};
+
+	const char* DeviceMemoryCategoryToString(DeviceMemoryCategory t_Category);
+
+	/**
+	* @brief	A piece of device memory. Resources should be bound to Memory at Offset.
+	*			Many allocations can share the same VkDeviceMemory, so never free or map it directly.
+	*/
+	struct DeviceAllocation
+	{
+		VkDeviceMemory Memory = VK_NULL_HANDLE;
+
+		VkDeviceSize Offset = 0;
+
+		VkDeviceSize Size = 0;
+
+		/** Mapped pointer to the start of this allocation. nullptr if the memory is not host visible */
+		void* MappedData = nullptr;
+
+		uint32 MemoryTypeIndex = 0;
+
+		DeviceMemoryCategory Category = DeviceMemoryCategory::Other;
+
+		/** The block this was sub-allocated from, nullptr for dedicated allocations */
+		DeviceMemoryBlock* Block = nullptr;
+
+		TlsfAllocator::Allocation SubAllocation = {};
+
+		bool IsValid() const { return Memory != VK_NULL_HANDLE; }
+
+		bool IsDedicated() const { return IsValid() && Block == nullptr; }
+	};
+
+	struct DeviceMemoryStats
+	{
+		/** Number of large blocks that are sub-allocated from */
+		uint32 BlockCount = 0;
+
+		/** Number of resources that have their own VkDeviceMemory */
+		uint32 DedicatedAllocationCount = 0;
+
+		/** Number of live allocations, including dedicated ones */
+		uint32 AllocationCount = 0;
+
+		/** Total bytes reserved by blocks */
+		VkDeviceSize BlockBytes = 0;
+
+		/** Bytes in use inside of blocks */
+		VkDeviceSize BlockUsedBytes = 0;
+
+		VkDeviceSize DedicatedBytes = 0;
+
+		/** Largest free region of any block */
+		VkDeviceSize LargestFreeRegion = 0;
+
+		uint32 FreeRegionCount = 0;
+
+		/** 0 if all free memory in the blocks is one region, closer to 1 the more it is split up */
+		float Fragmentation = 0.0f;
+
+		VkDeviceSize CategoryBytes[static_cast<size_t>(DeviceMemoryCategory::Count)] = {};
+
+		/** Number of live vkAllocateMemory calls. Has to stay below maxMemoryAllocationCount */
+		uint32 VkAllocationCount = 0;
+	};
+
+	/**
+	* @brief	Sub-allocates device memory out of large blocks instead of calling vkAllocateMemory
+	*			for every resource. Each memory type has separate blocks for buffers and images so that
+	*			bufferImageGranularity never has to be taken into account. Blocks are managed with a
+	*			TLSF allocator. Large resources (and render targets that ask for it) get a dedicated
+	*			allocation. Host visible blocks are persistently mapped. Thread safe.
+	*
+	* @see VulkanApp::GetMemoryAllocator
+	*/
+	class DeviceMemoryAllocator : public NonCopyable
+	{
+	public:
+
+		/**
+		* @param t_Dev				The logical device to allocate from
+		* @param t_BlockSize		Preferred size of a single block. Smaller heaps will use smaller blocks
+		*/
+		DeviceMemoryAllocator(const LogicalDevice* t_Dev, VkDeviceSize t_BlockSize);
+
+		/** Frees all blocks. Any allocations that are still alive are reported as leaks */
+		~DeviceMemoryAllocator();
+
+		/**
+		* @brief	Allocate memory for the given requirements
+		*
+		* @param t_Reqs			Memory requirements of the resource
+		* @param t_Props		Properties that the memory type must have
+		* @param t_Category		What this memory is used for (stats only)
+		* @param t_IsLinear		True for buffers and linear images, false for optimal tiling images
+		* @param t_Dedicated	Prefer to give this resource its own VkDeviceMemory
+		*/
+		DeviceAllocation Allocate(
+			const VkMemoryRequirements& t_Reqs,
+			VkMemoryPropertyFlags t_Props,
+			DeviceMemoryCategory t_Category,
+			bool t_IsLinear,
+			bool t_Dedicated = false);
+
+		/** Allocate and bind memory for the given buffer */
+		DeviceAllocation AllocateForBuffer(VkBuffer t_Buffer, VkMemoryPropertyFlags t_Props, DeviceMemoryCategory t_Category);
+
+		/**
+		* @brief	Allocate and bind memory for the given image. Render targets that are at least
+		*			VkConfig::DEDICATED_RENDER_TARGET_SIZE_MB always get a dedicated allocation
+		*/
+		DeviceAllocation AllocateForImage(
+			VkImage t_Image,
+			VkMemoryPropertyFlags t_Props,
+			DeviceMemoryCategory t_Category,
+			bool t_IsLinear = false,
+			bool t_Dedicated = false);
+
+		/** Return the allocation and reset it. Safe to call on an invalid allocation */
+		void Free(DeviceAllocation& t_Alloc);
+
+		/**
+		* @brief	Flush a range of a host visible allocation to the device. Does nothing if the
+		*			memory is HOST_COHERENT
+		*/
+		void Flush(const DeviceAllocation& t_Alloc, VkDeviceSize t_Offset = 0, VkDeviceSize t_Size = VK_WHOLE_SIZE);
+
+		DeviceMemoryStats GetStats() const;
+
+		void LogStats() const;
+
+		/** Guess the stats category of a buffer based on how it is used */
+		static DeviceMemoryCategory GetBufferCategory(VkBufferUsageFlags t_Usage, VkMemoryPropertyFlags t_Props);
+
+	private:
+
+		/** All blocks of one memory type for either linear or optimal resources */
+		struct MemoryPool
+		{
+			std::vector<std::unique_ptr<DeviceMemoryBlock>> Blocks;
+		};
+
+		FORCEINLINE uint32 GetPoolIndex(uint32 t_MemoryType, bool t_IsLinear) const { return t_MemoryType * 2 + (t_IsLinear ? 0 : 1); }
+
+		/** Size of new blocks for this memory type, smaller heaps use smaller blocks */
+		VkDeviceSize GetBlockSize(uint32 t_MemoryType) const;
+
+		DeviceMemoryBlock* CreateBlock(uint32 t_MemoryType, bool t_IsLinear, VkDeviceSize t_Size);
+
+		void DestroyBlock(DeviceMemoryBlock* t_Block);
+
+		DeviceAllocation AllocateDedicated(uint32 t_MemoryType, VkDeviceSize t_Size, DeviceMemoryCategory t_Category);
+
+		VkResult AllocateVkMemory(uint32 t_MemoryType, VkDeviceSize t_Size, VkDeviceMemory& t_OutMemory, void** t_OutMapped);
+
+		bool IsHostVisible(uint32 t_MemoryType) const;
+
+		bool IsHostCoherent(uint32 t_MemoryType) const;
+
+		VkDevice m_Device = VK_NULL_HANDLE;
+
+		VkPhysicalDeviceMemoryProperties m_MemoryProperties = {};
+
+		VkDeviceSize m_BlockSize = 0;
+
+		VkDeviceSize m_NonCoherentAtomSize = 1;
+
+		uint32 m_MaxAllocationCount = 0;
+
+		std::vector<MemoryPool> m_Pools;
+
+		/** Live dedicated allocations so that they can be reported on shutdown */
+		uint32 m_DedicatedCount = 0;
+
+		VkDeviceSize m_DedicatedBytes = 0;
+
+		uint32 m_AllocationCount = 0;
+
+		VkDeviceSize m_CategoryBytes[static_cast<size_t>(DeviceMemoryCategory::Count)] = {};
+
+		mutable std::mutex m_Mutex;
+	};
+}   // namespace Fling
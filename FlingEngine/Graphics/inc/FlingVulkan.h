@@ -31,7 +31,40 @@ namespace Fling
 
 	namespace VkConfig
 	{
-		static const int MAX_FRAMES_IN_FLIGHT = 2;
+		/** Number of frames the CPU may record ahead of the GPU if EngineConf.ini does not specify one */
+		static const int DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+		/** Upper bound on [Vulkan] FramesInFlight. Per-frame resources can be sized with this at compile time */
+		static const int MAX_FRAMES_IN_FLIGHT = 3;
+
+		/** Per frame size of the dynamic uniform buffer rings if [Vulkan] UniformRingSizeKB is not specified */
+		static const int DEFAULT_UNIFORM_RING_SIZE_KB = 4096;
+
+		/** Size of the CPU occlusion depth buffer if [Vulkan] OcclusionBufferWidth and OcclusionBufferHeight are not specified */
+		static const int DEFAULT_OCCLUSION_BUFFER_WIDTH = 512;
+		static const int DEFAULT_OCCLUSION_BUFFER_HEIGHT = 256;
+
+		/** Size of the device memory blocks that resources are sub-allocated from if [Vulkan] MemoryBlockSizeMB is not specified */
+		static const int DEFAULT_MEMORY_BLOCK_SIZE_MB = 64;
+
+		/** Render targets this size or larger get their own VkDeviceMemory instead of living in a block */
+		static const int DEDICATED_RENDER_TARGET_SIZE_MB = 8;
+
+		/** Size of the upload staging ring if [Vulkan] UploadRingSizeMB is not specified */
+		static const int DEFAULT_UPLOAD_RING_SIZE_MB = 32;
+
+		/** Starting size of the mesh arena's vertex and index buffers if [Vulkan] MeshArenaVertexMB and MeshArenaIndexMB are not specified */
+		static const int DEFAULT_MESH_ARENA_VERTEX_MB = 32;
+		static const int DEFAULT_MESH_ARENA_INDEX_MB = 8;
+
+		/** Sets in the first descriptor pool if [Vulkan] DescriptorSetsPerPool is not specified. Pools after it are larger */
+		static const int DEFAULT_DESCRIPTOR_SETS_PER_POOL = 64;
+
+		/** Most textures that can be registered with the bindless texture array if [Vulkan] BindlessTextureCapacity is not specified */
+		static const int DEFAULT_BINDLESS_TEXTURE_CAPACITY = 4096;
+
+		/** Number of upload batches that can be in flight at once. One more than the frames in flight so recording never waits */
+		static const int UPLOAD_BATCH_COUNT = MAX_FRAMES_IN_FLIGHT + 1;
 	}
 
 }   // namespace Fling
\ No newline at end of file
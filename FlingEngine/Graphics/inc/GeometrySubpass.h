@@ -5,6 +5,7 @@
 #include "Lighting/DirectionalLight.hpp"
 #include "Lighting/PointLight.hpp"
 #include "Lighting/Lighting.hpp"
+#include "LightClusterGrid.h"
 
 namespace Fling
 {
@@ -19,7 +20,7 @@ namespace Fling
 	class FirstPersonCamera;
 
 	/**
-	* @brief	Settings for the max directional lights and max point lights.
+	* @brief	Settings for the max directional lights and the point light clusters.
 	*			These settings are used 
 	* @todo		Ideally we would load these settings in from the game config file
 	*/
@@ -28,8 +29,13 @@ namespace Fling
 		/** Dir Lights */
 		static const uint32 MaxDirectionalLights = 8;
 
-		/** Point Lights */
-		static const uint32 MaxPointLights = 128;
+		/** Point lights are in a storage buffer, so there is no max. They are culled to a grid of clusters */
+		static const uint32 ClusterCountX = 16;
+		static const uint32 ClusterCountY = 9;
+		static const uint32 ClusterCountZ = 24;
+
+		/** Point lights that fit in each frame's light buffer before it has to grow */
+		static const uint32 InitialPointLightCapacity = 256;
 	};
 
 	/** Uniform buffer for passing lights to our final screen pass */
@@ -40,7 +46,11 @@ namespace Fling
 
 		alignas(16) DirectionalLight DirLightBuffer[DeferredLightSettings::MaxDirectionalLights] = {};
 
-		alignas(16) PointLight PointLightBuffer[DeferredLightSettings::MaxPointLights] = {};
+		/** Tiles across, tiles down and depth slices of the light clusters. @see LightClusterGrid */
+		alignas(16) glm::uvec4 ClusterCounts = {};
+
+		/** Scale and bias of log(depth) that gives the depth slice of a pixel */
+		alignas(16) glm::vec4 ClusterParams = {};
 	};
 
 	struct CameraInfoUbo
@@ -74,9 +84,11 @@ namespace Fling
 
 		virtual ~GeometrySubpass();
 
+		const char* GetName() const override { return "Geometry"; }
+
 		void Draw(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight, entt::registry& t_reg, float DeltaTime) override;
 
-		void CreateDescriptorSets(VkDescriptorPool t_Pool, entt::registry& t_reg) override;
+		void CreateDescriptorSets(DescriptorAllocator& t_Allocator, entt::registry& t_reg) override;
 
 		/** 
 		* @param t_FrameBuffer	The swap chain frame buffer
@@ -91,24 +103,44 @@ namespace Fling
 
 		void UpdateLightingUBO(entt::registry& t_Reg, uint32 t_ActiveFrame);
 
+		/**
+		* @brief	Copy the point lights and their clusters to this frame's storage buffers, growing them if they are too small.
+		*			A frame's descriptor set is rewritten when one of its buffers is replaced
+		*/
+		void UploadLightBuffers(uint32 t_ActiveFrame);
+
+		/** Point the light and cluster bindings of a frame's descriptor set at its current buffers */
+		void WriteLightBufferDescriptors(uint32 t_Frame);
+
 		// Global render pass for frame buffer writes
 		std::shared_ptr<Model> m_QuadModel;
 
 		VkRenderPass m_GlobalRenderPass = VK_NULL_HANDLE;
-		VkDescriptorPool m_DescPool = VK_NULL_HANDLE;
 
 		const FirstPersonCamera* m_Camera;
 
 		/** The offscreen frame buffer that has the G Buffer attachments */
 		FrameBuffer* m_OffscreenFrameBuf = nullptr;
 
-		// Descriptor sets and Uniform buffers -- one per swap image
+		// Descriptor sets and Uniform buffers -- one per frame in flight
 		std::vector<VkDescriptorSet> m_DescriptorSets;
 		std::vector<Buffer*> m_LightingUboBuffers;
 		std::vector<Buffer*> m_CameraUboBuffers;
 
 		std::vector<Buffer*> m_QuadUboBuffer;
 
+		/** Every point light, in the order that the cluster light indices refer to */
+		std::vector<std::unique_ptr<Buffer>> m_PointLightBuffers;
+
+		/** The cluster offsets and counts followed by their light indices. @see LightClusterGrid::GetData */
+		std::vector<std::unique_ptr<Buffer>> m_ClusterBuffers;
+
+		LightClusterGrid m_LightClusters;
+
+		/** Point lights of this frame and their world position and range, for building the clusters */
+		std::vector<PointLight> m_PointLights;
+		std::vector<glm::vec4> m_PointLightSpheres;
+
 		LightingUbo m_LightingUBO = {};
 
 		CameraInfoUbo m_CamInfoUBO = {};
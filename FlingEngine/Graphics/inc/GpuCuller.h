@@ -0,0 +1,219 @@
+#pragma once
+
+#include "FlingVulkan.h"
+#include "Buffer.h"
+#include "Bounds.h"
+
+namespace Fling
+{
+	class LogicalDevice;
+	class Shader;
+	class ComputePipeline;
+	class DrawBatchTable;
+	class Model;
+	struct FrameBufferAttachment;
+
+	/** An object in the GPU culling object buffer. Matches Object in cull.comp (std430) */
+	struct GpuObject
+	{
+		glm::mat4 World { 1.0f };
+
+		/** Center and extents of the model's local bounds. W is unused */
+		glm::vec4 Center { 0.0f };
+		glm::vec4 Extents { 0.0f };
+
+		/** Index of the object's draw command, or DrawBatchTable::INVALID_BATCH if it isn't drawn */
+		uint32 Batch = ~0u;
+		uint32 Pad[3] = {};
+	};
+	static_assert(sizeof(GpuObject) == 112, "GpuObject has to match the std430 layout of cull.comp");
+
+	/** An indexed indirect draw, plus where the culling shader writes its instances. Matches DrawCommand in cull.comp */
+	struct GpuDrawCommand
+	{
+		VkDrawIndexedIndirectCommand Command;
+		uint32 InstanceOffset;
+		uint32 Pad[2];
+	};
+	static_assert(sizeof(GpuDrawCommand) == 32, "GpuDrawCommand has to match the std430 layout of cull.comp");
+
+	/** Uniforms of the culling shader. Matches CullData in cull.comp */
+	struct GpuCullData
+	{
+		/** The camera that the depth pyramid was rendered with */
+		glm::mat4 PrevViewProjection;
+		glm::vec4 FrustumPlanes[Frustum::Side::Count];
+		glm::vec2 DepthSize;
+		uint32 ObjectCount;
+		uint32 Flags;
+		int32 PyramidMaxLevel;
+		uint32 Pad[3];
+
+		static const uint32 FLAG_FRUSTUM = 1 << 0;
+		static const uint32 FLAG_OCCLUSION = 1 << 1;
+	};
+	static_assert(sizeof(GpuCullData) == 192, "GpuCullData has to match the std140 layout of cull.comp");
+
+	/**
+	* @brief	Culls objects in a compute shader and writes the survivors to the instance data of indirect draws,
+	*			so that the CPU only has to record one draw per batch no matter how many objects there are.
+	*
+	*			Objects live in a device local buffer that only the pages with changed objects are copied to
+	*			each frame. Each frame in flight has its own draw commands, instance data and uniforms.
+	*
+	*			Occlusion is tested against a max depth pyramid of the last frame's G-Buffer depth, which is
+	*			built after the G-Buffer pass. Meshes that come out from behind an occluder show up a frame late.
+	*/
+	class GpuCuller
+	{
+	public:
+
+		/** Objects are uploaded in pages of this many when any of them changes */
+		static const uint32 OBJECTS_PER_PAGE = 256;
+
+		/** A depth pyramid this deep covers a 64k wide depth buffer */
+		static const uint32 MAX_PYRAMID_LEVELS = 16;
+
+		GpuCuller(const LogicalDevice* t_Dev, Shader* t_CullShader, Shader* t_DepthReduceShader, uint32 t_FramesInFlight);
+
+		~GpuCuller();
+
+		/** True if a depth buffer of this format can be sampled in a compute shader to build the depth pyramid */
+		static bool SupportsDepthPyramid(const LogicalDevice* t_Dev, VkFormat t_DepthFormat);
+
+		/** Resize the object list. Growing the object buffer marks every object as dirty */
+		void SetObjectCount(uint32 t_Count);
+
+		FORCEINLINE uint32 GetObjectCount() const { return static_cast<uint32>(m_Objects.size()); }
+
+		FORCEINLINE GpuObject& GetObject(uint32 t_Index) { return m_Objects[t_Index]; }
+
+		/** Upload this object's page next frame. Objects in different pages can be marked from different threads */
+		FORCEINLINE void MarkDirty(uint32 t_Index) { m_DirtyPages[t_Index / OBJECTS_PER_PAGE] = 1; }
+
+		void MarkAllDirty();
+
+		/**
+		* @brief	Create a draw command for each batch of the table. t_Models are the models by their ID in the table
+		* @param t_UseFirstInstance		Point each command at its batch's instances. Needs drawIndirectFirstInstance,
+		*								otherwise the instance buffer has to be bound at the batch's instances
+		*/
+		void SetBatches(const DrawBatchTable& t_Table, const std::vector<Model*>& t_Models, bool t_UseFirstInstance);
+
+		/**
+		* @brief	Write this frame's draw commands and uniforms. The frame's fence has to have been waited on
+		* @return	Instances drawn the last time that this frame in flight was used
+		*/
+		uint32 BeginFrame(uint32 t_ActiveFrameInFlight, const Frustum& t_Frustum, bool t_FrustumCulling, bool t_OcclusionCulling);
+
+		/** Upload the dirty objects and cull them. Has to be recorded outside of a render pass, before the draws */
+		void RecordCull(VkCommandBuffer t_Cmd, uint32 t_ActiveFrameInFlight);
+
+		/** Rebuild the depth pyramid from the G-Buffer depth. Record after the render pass that wrote the depth */
+		void RecordDepthPyramid(VkCommandBuffer t_Cmd, FrameBufferAttachment& t_Depth, const glm::mat4& t_ViewProjection);
+
+		/** Recreate the depth pyramid for a new depth buffer. The device has to be idle */
+		void OnResize(FrameBufferAttachment& t_Depth, uint32 t_Width, uint32 t_Height);
+
+		FORCEINLINE VkBuffer GetDrawBuffer(uint32 t_ActiveFrameInFlight) const;
+		FORCEINLINE VkBuffer GetInstanceBuffer(uint32 t_ActiveFrameInFlight) const;
+
+	private:
+
+		void CreatePyramid(FrameBufferAttachment& t_Depth, uint32 t_Width, uint32 t_Height);
+
+		void ReleasePyramid();
+
+		/** Write the cull descriptor set of a frame with its current buffers */
+		void UpdateCullSet(uint32 t_ActiveFrameInFlight);
+
+		/** Copy the dirty pages to the object buffer through this frame's staging buffer */
+		void RecordObjectUpload(VkCommandBuffer t_Cmd, uint32 t_ActiveFrameInFlight);
+
+		const LogicalDevice* m_Device = nullptr;
+
+		ComputePipeline* m_CullPipeline = nullptr;
+		ComputePipeline* m_ReducePipeline = nullptr;
+
+		/** CPU copy of every object, what the dirty pages are copied from */
+		std::vector<GpuObject> m_Objects;
+
+		/** 1 for each page of m_Objects that has changed since it was last uploaded */
+		std::vector<uint8> m_DirtyPages;
+
+		/** Device local objects that the culling shader reads */
+		std::unique_ptr<Buffer> m_ObjectBuffer;
+
+		/** Object buffers that were replaced while a frame in flight could still be reading them */
+		struct RetiredBuffer
+		{
+			std::unique_ptr<Buffer> Buf;
+			uint32 FramesLeft = 0;
+		};
+		std::vector<RetiredBuffer> m_RetiredBuffers;
+
+		/** Draw command of each batch, with no instances. The culling shader counts them up */
+		std::vector<GpuDrawCommand> m_Commands;
+
+		/** Copies of this frame's object upload */
+		std::vector<VkBufferCopy> m_CopyRegions;
+
+		/** Instances that every batch has room for together */
+		uint32 m_InstanceCount = 0;
+
+		struct FrameResources
+		{
+			/** Host visible so that the commands can be written each frame and the counts read back */
+			std::unique_ptr<Buffer> Draws;
+
+			/** Model matrices of the visible objects, written by the culling shader */
+			std::unique_ptr<Buffer> Instances;
+
+			std::unique_ptr<Buffer> Uniforms;
+
+			/** Host visible source of this frame's object upload */
+			std::unique_ptr<Buffer> Staging;
+
+			VkDescriptorSet CullSet = VK_NULL_HANDLE;
+
+			/** Draw commands that were written the last time that this frame was used */
+			uint32 CommandCount = 0;
+		};
+		std::vector<FrameResources> m_Frames;
+
+		// Depth pyramid ------------
+		VkImage m_PyramidImage = VK_NULL_HANDLE;
+		DeviceAllocation m_PyramidMemory {};
+
+		/** Every level, what the culling shader samples */
+		VkImageView m_PyramidView = VK_NULL_HANDLE;
+
+		/** One view per level, what each reduction writes to and the next one reads from */
+		std::vector<VkImageView> m_PyramidLevelViews;
+
+		/** Reduction set of each level, allocated once for the most levels there can be */
+		VkDescriptorSet m_ReduceSets[MAX_PYRAMID_LEVELS] = {};
+
+		std::vector<VkExtent2D> m_PyramidSizes;
+
+		VkSampler m_PyramidSampler = VK_NULL_HANDLE;
+
+		VkExtent2D m_DepthSize {};
+
+		/** The camera that the pyramid was built with */
+		glm::mat4 m_PyramidViewProjection { 1.0f };
+
+		/** False until the pyramid has been built for the current depth buffer */
+		bool m_PyramidValid = false;
+	};
+
+	FORCEINLINE VkBuffer GpuCuller::GetDrawBuffer(uint32 t_ActiveFrameInFlight) const
+	{
+		return m_Frames[t_ActiveFrameInFlight].Draws->GetVkBuffer();
+	}
+
+	FORCEINLINE VkBuffer GpuCuller::GetInstanceBuffer(uint32 t_ActiveFrameInFlight) const
+	{
+		return m_Frames[t_ActiveFrameInFlight].Instances->GetVkBuffer();
+	}
+}   // namespace Fling
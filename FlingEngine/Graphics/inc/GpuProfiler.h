@@ -0,0 +1,154 @@
+#pragma once
+
+#include "FlingVulkan.h"
+#include "FlingTypes.h"
+#include "NonCopyable.hpp"
+#include "Stats.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace Fling
+{
+	class LogicalDevice;
+
+	/** Identifies a pass that is timed by the GPU profiler. @see GpuProfiler::RegisterScope */
+	typedef uint32 GpuScopeId;
+
+	static const GpuScopeId INVALID_GPU_SCOPE = ~0u;
+
+	/**
+	* @brief	Times render passes on the GPU with timestamp queries, and counts their vertex and
+	*			fragment shader invocations with pipeline statistics queries if the device supports them.
+	*
+	*			Every frame in flight has its own query pools. They are only read back once the frame
+	*			fence has been waited on (@see BeginFrame), so the results are always available and
+	*			reading them never stalls. Results are published to Stats::Gpu and can be dumped to a
+	*			CSV or JSON file every frame.
+	*
+	*			Queries can't be reset inside of a render pass, so every scope has to be reset with
+	*			ResetScope before the render pass that it is used in begins.
+	*
+	* @note		Render thread only
+	*/
+	class GpuProfiler : public NonCopyable
+	{
+	public:
+
+		/** Max number of passes that can be timed */
+		static const uint32 MAX_SCOPES = 32;
+
+		/**
+		* @param t_Dev				Device to create the query pools on
+		* @param t_FramesInFlight	Number of frames that can be recorded while the GPU is still rendering
+		*/
+		GpuProfiler(const LogicalDevice* t_Dev, uint32 t_FramesInFlight);
+
+		/** The device must be idle */
+		~GpuProfiler();
+
+		/** Add a pass to time. Names should be unique @return INVALID_GPU_SCOPE if there are too many scopes */
+		GpuScopeId RegisterScope(const std::string& t_Name);
+
+		/**
+		* @brief	Read back the results from the last time that this frame in flight was recorded
+		*			and publish them to Stats::Gpu. Call after the frame fence has been waited on and
+		*			before anything is recorded for this frame
+		*/
+		void BeginFrame(uint32 t_FrameInFlight);
+
+		/** Reset the queries of a scope. Has to be recorded outside of a render pass */
+		void ResetScope(VkCommandBuffer t_Cmd, uint32 t_FrameInFlight, GpuScopeId t_Scope);
+
+		/**
+		* @param t_ExecutesSecondaries	If secondary command buffers will be executed in this scope. Pipeline statistics are
+		*								only counted for them if the device supports inherited queries, @see GetInheritedStatistics
+		*/
+		void BeginScope(VkCommandBuffer t_Cmd, uint32 t_FrameInFlight, GpuScopeId t_Scope, bool t_ExecutesSecondaries = false);
+
+		/** Has to be recorded in the same subpass (or outside of a render pass) as BeginScope was */
+		void EndScope(VkCommandBuffer t_Cmd, uint32 t_FrameInFlight, GpuScopeId t_Scope);
+
+		/**
+		* @brief	Write the results of every frame to a file until StopDump is called.
+		*			Files ending in .json are written as JSON, anything else as CSV
+		* @return	True if the file could be opened
+		*/
+		bool StartDump(const std::string& t_FilePath);
+
+		void StopDump();
+
+		FORCEINLINE bool IsDumping() const { return m_DumpFile.is_open(); }
+
+		FORCEINLINE bool IsEnabled() const { return m_IsEnabled; }
+
+		/** Timing can be turned off at runtime. Takes effect on the next BeginFrame so that no scope is left open */
+		FORCEINLINE void SetEnabled(bool t_Enabled) { m_WantsEnabled = t_Enabled && m_SupportsTimestamps; }
+
+		FORCEINLINE bool WantsEnabled() const { return m_WantsEnabled; }
+
+		FORCEINLINE bool SupportsTimestamps() const { return m_SupportsTimestamps; }
+
+		FORCEINLINE bool SupportsPipelineStatistics() const { return m_SupportsPipelineStatistics; }
+
+		/** Pipeline statistics that secondary command buffers have to be begun with this frame. 0 if none are counted */
+		VkQueryPipelineStatisticFlags GetInheritedStatistics() const;
+
+	private:
+
+		struct FrameQueries
+		{
+			/** Two timestamps per scope, the start and the end */
+			VkQueryPool Timestamps = VK_NULL_HANDLE;
+
+			/** One pipeline statistics query per scope */
+			VkQueryPool Statistics = VK_NULL_HANDLE;
+
+			/** Scopes that have been ended since this frame was last read back */
+			std::vector<bool> IsScopeWritten;
+
+			/** Scopes that have begun a pipeline statistics query that has to be ended */
+			std::vector<bool> IsStatisticsActive;
+
+			/** CPU frame that this frame in flight was last recorded in */
+			uint64 FrameNumber = 0;
+		};
+
+		void WriteDumpFrame(uint64 t_FrameNumber, const std::vector<Stats::GpuPass>& t_Passes);
+
+		const LogicalDevice* m_Device = nullptr;
+
+		std::vector<FrameQueries> m_Frames;
+
+		std::vector<std::string> m_ScopeNames;
+
+		/** Passes of the frame that was read back last, swapped into Stats::Gpu */
+		std::vector<Stats::GpuPass> m_Results;
+
+		/** Nanoseconds per timestamp tick */
+		double m_TimestampPeriod = 1.0;
+
+		/** Timestamps only have this many valid bits on the graphics queue */
+		uint64 m_TimestampMask = ~0ull;
+
+		bool m_SupportsTimestamps = false;
+
+		bool m_SupportsPipelineStatistics = false;
+
+		bool m_SupportsInheritedStatistics = false;
+
+		/** If scopes are recorded this frame */
+		bool m_IsEnabled = false;
+
+		bool m_WantsEnabled = false;
+
+		uint64 m_FrameNumber = 0;
+
+		std::ofstream m_DumpFile;
+
+		bool m_IsDumpJson = false;
+
+		bool m_IsFirstDumpFrame = true;
+	};
+}   // namespace Fling
@@ -30,12 +30,21 @@ namespace Fling
         */
         uint32 FindMemoryType(VkPhysicalDevice t_PhysicalDevice, uint32 t_Filter, VkMemoryPropertyFlags t_Props);
 
-        void CreateBuffer(VkDevice t_Device, VkPhysicalDevice t_PhysicalDevice, VkDeviceSize t_Size, VkBufferUsageFlags t_Usage, VkMemoryPropertyFlags t_Properties, VkBuffer& t_Buffer, VkDeviceMemory& t_BuffMemory);
+        uint32 FindMemoryType(const VkPhysicalDeviceMemoryProperties& t_MemProperties, uint32 t_Filter, VkMemoryPropertyFlags t_Props);
+
+        /**
+        * Create a buffer and sub-allocate its memory. Free t_Allocation with the DeviceMemoryAllocator
+        */
+        void CreateBuffer(VkDevice t_Device, VkDeviceSize t_Size, VkBufferUsageFlags t_Usage, VkMemoryPropertyFlags t_Properties, VkBuffer& t_Buffer, DeviceAllocation& t_Allocation);
 
         VkCommandBuffer BeginSingleTimeCommands();
         
         void EndSingleTimeCommands(VkCommandBuffer t_CommandBuffer);
 
+        /**
+        * Create an image and sub-allocate its memory. Attachments are tracked as render targets,
+        * everything else as textures. Free t_Memory with the DeviceMemoryAllocator
+        */
         void CreateVkImage(
 			VkDevice t_Dev,
             uint32 t_Width,
@@ -45,7 +54,7 @@ namespace Fling
             VkImageUsageFlags t_Useage,
             VkMemoryPropertyFlags t_Props,
             VkImage& t_Image,
-            VkDeviceMemory& t_Memory,
+            DeviceAllocation& t_Memory,
 			VkSampleCountFlagBits t_NumSamples = VK_SAMPLE_COUNT_1_BIT
         );
 
@@ -64,7 +73,7 @@ namespace Fling
             VkMemoryPropertyFlags t_Props,
             VkImageCreateFlags t_flags,
             VkImage& t_Image,
-            VkDeviceMemory& t_Memory,
+            DeviceAllocation& t_Memory,
             VkSampleCountFlagBits t_NumSamples = VK_SAMPLE_COUNT_1_BIT
         );
 
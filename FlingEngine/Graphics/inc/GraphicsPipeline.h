@@ -24,11 +24,18 @@ namespace Fling
             Depth t_Depth = Depth::ReadWrite,
             VkPrimitiveTopology t_Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
             VkCullModeFlags t_CullMode = VK_CULL_MODE_BACK_BIT,
-            VkFrontFace t_FrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE);
+            VkFrontFace t_FrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+            uint32 t_DynamicUniformBindings = 0);
 
         void BindGraphicsPipeline(const VkCommandBuffer& t_CommandBuffer);
         void CreateGraphicsPipeline(VkRenderPass& t_RenderPass, Multisampler* t_Sampler);
 
+        /**
+         * @brief   Use layouts that aren't owned by this pipeline for sets 1 and up, like the bindless textures.
+         *          Set 0 is still the reflected one. Has to be called before CreateGraphicsPipeline
+         */
+        void SetExtraSetLayouts(const std::vector<VkDescriptorSetLayout>& t_Layouts);
+
         const std::vector<Shader*> GetShaders() const { return m_Shaders; }
 
         Depth GetDepth() const { return m_Depth; }
@@ -64,6 +71,10 @@ namespace Fling
 
         VkDescriptorSetLayout m_DescriptorSetLayout;
         VkPipelineVertexInputStateCreateInfo m_VertexInputStateCreateInfo = {};
+
+        /** Any vertex bindings and attributes used in addition to the Vertex ones, like per instance data */
+        std::vector<VkVertexInputBindingDescription> m_ExtraVertexBindings;
+        std::vector<VkVertexInputAttributeDescription> m_ExtraVertexAttributes;
         VkPipelineInputAssemblyStateCreateInfo m_InputAssemblyState = {};
         VkPipelineRasterizationStateCreateInfo m_RasterizationState = {};
         std::vector<VkPipelineColorBlendAttachmentState> m_ColorBlendAttachmentStates;
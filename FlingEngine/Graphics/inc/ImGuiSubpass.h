@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Subpass.h"
+#include "DeviceMemoryAllocator.h"
 
 namespace Fling
 {
@@ -26,9 +27,11 @@ namespace Fling
 
 		virtual ~ImGuiSubpass();
 
+		const char* GetName() const override { return "ImGui"; }
+
 		void Draw(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight, entt::registry& t_reg, float DeltaTime) override;
 
-		void CreateDescriptorSets(VkDescriptorPool t_Pool, entt::registry& t_reg) override;
+		void CreateDescriptorSets(DescriptorAllocator& t_Allocator, entt::registry& t_reg) override;
 
 		void PrepareAttachments() override;
 
@@ -42,9 +45,9 @@ namespace Fling
 
 		void PrepareResources();
 
-		void BuildCommandBuffer(VkCommandBuffer t_commandBuffer);
+		void BuildCommandBuffer(VkCommandBuffer t_commandBuffer, uint32 t_ActiveFrameInFlight);
 
-		void UpdateUniforms();
+		void UpdateUniforms(uint32 t_ActiveFrameInFlight);
 
 		struct PushConstBlock
 		{
@@ -52,8 +55,9 @@ namespace Fling
 			glm::vec2 translate;
 		} pushConstBlock;
 
-		std::unique_ptr<class Buffer> m_vertexBuffer;
-		std::unique_ptr<class Buffer> m_indexBuffer;
+		/** Vertex and index buffers for each frame in flight, because the GPU may still be drawing the previous frame's UI */
+		std::vector<std::unique_ptr<class Buffer>> m_vertexBuffers;
+		std::vector<std::unique_ptr<class Buffer>> m_indexBuffers;
 
 		VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
 		VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
@@ -65,7 +69,7 @@ namespace Fling
 
 		FlingWindow* m_Window = nullptr;
 
-		VkDeviceMemory m_fontMemory = VK_NULL_HANDLE;
+		DeviceAllocation m_fontMemory = {};
 		VkImage m_fontImage = VK_NULL_HANDLE;
 		VkImageView m_fontImageView = VK_NULL_HANDLE;
 		VkSampler m_sampler = VK_NULL_HANDLE;
@@ -73,8 +77,8 @@ namespace Fling
 		/** Instance of the editor that we will get what commands to build from */
 		std::shared_ptr<Fling::BaseEditor> m_Editor;
 
-		int32 m_vertexCount = 0;
-		int32 m_indexCount = 0;
+		std::vector<int32> m_vertexCounts;
+		std::vector<int32> m_indexCounts;
 
 		VkRenderPass m_GlobalRenderPass = VK_NULL_HANDLE;
 	};
@@ -26,6 +26,9 @@ namespace Fling
 
 		const std::vector<const char*>& GetEnabledExtensions() const { return m_DeviceExtensions; };
 
+		/** True if VK_KHR_get_physical_device_properties2 is enabled, so that extended device features can be queried */
+		bool HasPhysicalDeviceProperties2() const { return m_HasPhysicalDeviceProperties2; }
+
     private:
 
         /** The Vulkan instance */
@@ -37,6 +40,8 @@ namespace Fling
          */
         uint8 m_EnableValidationLayers : 1;
 
+        bool m_HasPhysicalDeviceProperties2 = false;
+
         /**
          * @brief Create the VkInstance of this object and application information
          */
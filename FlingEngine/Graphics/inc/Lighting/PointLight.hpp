@@ -31,6 +31,7 @@ namespace Fling
         void serialize(Archive & t_Archive);
 
 		FORCEINLINE void SetPos(const glm::vec4& t_Pos) { Pos = t_Pos; }
+		FORCEINLINE const glm::vec4& GetPos() const { return Pos; }
     };
 
      /** Serilazation to an archive */
@@ -23,6 +23,9 @@ namespace Fling
 		const VkQueue& GetGraphicsQueue() const { return m_GraphicsQueue; }
 		const VkQueue& GetPresentQueue() const { return m_PresentQueue; }
 
+		/** Queue for copies. The same as the graphics queue if there is no dedicated transfer family */
+		const VkQueue& GetTransferQueue() const { return m_TransferQueue; }
+
 		const VkQueueFlags& GetSupportedQueues() const { return m_SupportedQueues; }
 
 		const PhysicalDevice* GetPhysicalDevice() const { return m_PhysicalDevice; }
@@ -30,6 +33,16 @@ namespace Fling
 
 		uint32 GetGraphicsFamily() const { return m_GraphicsFamily; }
 		uint32 GetPresentFamily() const { return m_PresentFamily; }
+		uint32 GetTransferFamily() const { return m_TransferFamily; }
+
+		/** True if copies can run on a queue family separate from graphics (usually a DMA engine) */
+		bool HasDedicatedTransferQueue() const { return m_TransferFamily != m_GraphicsFamily; }
+
+		/** True if the descriptor indexing features that BindlessTextures needs are enabled. Set by [Vulkan] BindlessTextures */
+		bool IsDescriptorIndexingEnabled() const { return m_DescriptorIndexingEnabled; }
+
+		/** True if VK_KHR_maintenance1 is enabled, which it is whenever the device supports it */
+		bool IsMaintenance1Enabled() const { return m_Maintenance1Enabled; }
 
 		void WaitForIdle();
 
@@ -49,6 +62,9 @@ namespace Fling
         /** Handle to the presentation queue */
         VkQueue m_PresentQueue = VK_NULL_HANDLE;
 
+        /** Handle to the transfer queue */
+        VkQueue m_TransferQueue = VK_NULL_HANDLE;
+
 		/** Queue families */
 		VkQueueFlags m_SupportedQueues{};
 		uint32 m_GraphicsFamily = 0;
@@ -56,6 +72,10 @@ namespace Fling
 		uint32 m_ComputeFamily = 0;
 		uint32 m_TransferFamily = 0;
 
+		bool m_DescriptorIndexingEnabled = false;
+
+		bool m_Maintenance1Enabled = false;
+
 		/**
 		 * @brief	Get what queue Indecies/families this device should use
 		 */
@@ -2,8 +2,10 @@
 
 #include "Shader.h"
 #include "Texture.h"
+#include "ResourceManager.h"
 #include "JsonFile.h"
 #include "ShaderPrograms/ShaderProgram.h"
+#include "OcclusionBuffer.h"
 
 namespace Fling
 {
@@ -12,10 +14,10 @@ namespace Fling
     */
     struct PBRTextures
     {
-        Texture* m_AlbedoTexture        = nullptr;
-        Texture* m_NormalTexture        = nullptr;
-        Texture* m_RoughnessTexture    = nullptr;
-        Texture* m_MetalTexture        = nullptr;
+        Handle<Texture> m_AlbedoTexture;
+        Handle<Texture> m_NormalTexture;
+        Handle<Texture> m_RoughnessTexture;
+        Handle<Texture> m_MetalTexture;
     };
 
     /**
@@ -38,12 +40,36 @@ namespace Fling
 
 		static std::shared_ptr<Fling::Material> GetDefaultMat();
 
+        /** The material file read by Decode. @see IsAsyncLoadable */
+        struct LoadData
+        {
+            nlohmann::json Json;
+
+            /** Decoded from the file's "occluder" model, if it has one */
+            OccluderMesh Occluder;
+        };
+
+        /**
+        * @brief    Read the material file and start loading its textures. Safe to call from any thread
+        */
+        static std::unique_ptr<LoadData> Decode(Guid t_ID);
+
         explicit Material(Guid t_ID);
 
+        /** Create a material from an already read file. Main thread only */
+        Material(Guid t_ID, std::unique_ptr<LoadData> t_Data);
+
         const PBRTextures& GetPBRTextures() const { return m_Textures; }
 
 		Material::Type GetType() const { return m_Type; }
 
+        /**
+        * @brief    Low poly mesh that meshes with this material hide other meshes with. Set by the
+        *           optional "occluder" model path in the file, empty if the material doesn't occlude
+        * @see      OcclusionBuffer
+        */
+        const OccluderMesh& GetOccluder() const { return m_Occluder; }
+
 		static Material::Type GetTypeFromStr(const std::string& t_Str);
 
 		static const std::string& GetStringFromType(const Material::Type);
@@ -54,6 +80,8 @@ namespace Fling
 
         // Textures that this material uses
         PBRTextures m_Textures = {};
+
+        OccluderMesh m_Occluder;
         
 		Material::Type m_Type = Type::Default;
 
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "FlingVulkan.h"
+#include "FlingTypes.h"
+#include "NonCopyable.hpp"
+#include "TlsfAllocator.h"
+#include "UploadManager.h"
+#include "Vertex.h"
+
+#include <memory>
+#include <vector>
+
+namespace Fling
+{
+	class Buffer;
+	class LogicalDevice;
+
+	struct MeshArenaStats
+	{
+		/** Size of the vertex and index buffers, in bytes */
+		VkDeviceSize VertexBytes = 0;
+		VkDeviceSize IndexBytes = 0;
+
+		/** Bytes of the vertex and index buffers that meshes are in */
+		VkDeviceSize VertexBytesUsed = 0;
+		VkDeviceSize IndexBytesUsed = 0;
+
+		uint32 MeshCount = 0;
+
+		/** Free regions of both buffers. More than one per buffer means that removed meshes left gaps */
+		uint32 FreeRegionCount = 0;
+
+		/** Times that either buffer was grown or compacted since startup */
+		uint32 RebuildCount = 0;
+	};
+
+	/**
+	* @brief	Every mesh's vertices and indices, sub-allocated out of one large device local vertex
+	*			buffer and one index buffer. Binding the arena once lets any mesh in it be drawn by its
+	*			first index and vertex offset, so draws of different meshes don't rebind anything and
+	*			indirect draws of them can be merged.
+	*
+	*			Ranges are managed with a TLSF allocator per buffer. When a buffer is out of space it is
+	*			recreated, compacted and grown if it has to be, with a copy on the GPU. Meshes are
+	*			referred to by a handle because their ranges move when that happens.
+	*
+	* @note		Main thread only. @see VulkanApp::GetMeshArena
+	*/
+	class MeshArena : public NonCopyable
+	{
+	public:
+
+		typedef uint32 Handle;
+
+		static const Handle INVALID_HANDLE = ~0u;
+
+		/** Where a mesh is in the arena, in vertices and indices */
+		struct Range
+		{
+			uint32 FirstVertex = 0;
+			uint32 VertexCount = 0;
+			uint32 FirstIndex = 0;
+			uint32 IndexCount = 0;
+		};
+
+		/**
+		* @param t_Dev				The logical device to create the buffers with
+		* @param t_Uploader			Uploads the meshes and copies them when the buffers are recreated
+		* @param t_FramesInFlight	Frames that may still be reading from a buffer after it is recreated
+		* @param t_VertexBytes		Starting size of the vertex buffer
+		* @param t_IndexBytes		Starting size of the index buffer
+		*/
+		MeshArena(const LogicalDevice* t_Dev, UploadManager* t_Uploader, uint32 t_FramesInFlight, VkDeviceSize t_VertexBytes, VkDeviceSize t_IndexBytes);
+
+		~MeshArena();
+
+		/**
+		* @brief	Copy a mesh into the arena in the next upload batch. Indices are relative to the mesh's own
+		*			vertices, draws add the vertex offset
+		* @return	Handle of the mesh, or INVALID_HANDLE if it has no vertices or indices
+		*/
+		Handle Add(const Vertex* t_Verts, uint32 t_VertexCount, const uint32* t_Indices, uint32 t_IndexCount);
+
+		/** Give a mesh's ranges back. Nothing in flight can still be drawing it */
+		void Remove(Handle t_Mesh);
+
+		FORCEINLINE const Range& GetRange(Handle t_Mesh) const { return m_Meshes[t_Mesh].MeshRange; }
+
+		/** Bind the vertex buffer to binding 0 and the index buffer. Any mesh in the arena can be drawn after this */
+		void Bind(VkCommandBuffer t_Cmd) const;
+
+		FORCEINLINE Buffer* GetVertexBuffer() const { return m_Pools[VERTEX_POOL].Buf.get(); }
+		FORCEINLINE Buffer* GetIndexBuffer() const { return m_Pools[INDEX_POOL].Buf.get(); }
+
+		constexpr static VkIndexType GetIndexType() { return VK_INDEX_TYPE_UINT32; }
+
+		/** Move every mesh to the start of new buffers, closing the gaps that removed meshes left behind */
+		void Compact();
+
+		/** Release the buffers that were replaced once no frame can be using them. Call once per frame, after its fence */
+		void Update();
+
+		/** Changes every time that meshes move. Anything that keeps a Range has to get it again */
+		FORCEINLINE uint32 GetLayoutVersion() const { return m_LayoutVersion; }
+
+		MeshArenaStats GetStats() const;
+
+	private:
+
+		enum PoolType : uint32
+		{
+			VERTEX_POOL,
+			INDEX_POOL,
+			POOL_COUNT
+		};
+
+		/** One of the arena buffers. Its allocator works in elements, not bytes, so offsets are first vertices and indices */
+		struct Pool
+		{
+			std::unique_ptr<Buffer> Buf;
+			std::unique_ptr<TlsfAllocator> Allocator;
+			VkBufferUsageFlags Usage = 0;
+			uint32 Stride = 0;
+		};
+
+		struct Mesh
+		{
+			Range MeshRange;
+			TlsfAllocator::Allocation Allocs[POOL_COUNT];
+			bool InUse = false;
+		};
+
+		/** A replaced buffer that a frame in flight or the copy out of it could still be reading */
+		struct RetiredBuffer
+		{
+			std::unique_ptr<Buffer> Buf;
+			UploadTicket Ticket = 0;
+			uint32 FramesLeft = 0;
+		};
+
+		void CreatePool(PoolType t_Type, VkDeviceSize t_Bytes, uint32 t_Stride, VkBufferUsageFlags t_Usage);
+
+		/** Allocate elements of a pool, recreating it if there is no room */
+		TlsfAllocator::Allocation Allocate(PoolType t_Type, uint32 t_Count);
+
+		/** Recreate a pool with this many elements and copy every mesh to the start of it, in the order that they were in */
+		void Rebuild(PoolType t_Type, uint64 t_Capacity);
+
+		static uint32& GetFirst(Range& t_Range, PoolType t_Type) { return t_Type == VERTEX_POOL ? t_Range.FirstVertex : t_Range.FirstIndex; }
+		static uint32 GetCount(const Range& t_Range, PoolType t_Type) { return t_Type == VERTEX_POOL ? t_Range.VertexCount : t_Range.IndexCount; }
+
+		const LogicalDevice* m_Device = nullptr;
+
+		UploadManager* m_Uploader = nullptr;
+
+		uint32 m_FramesInFlight = 1;
+
+		Pool m_Pools[POOL_COUNT];
+
+		/** Indexed by handle. Handles of removed meshes are reused */
+		std::vector<Mesh> m_Meshes;
+
+		std::vector<Handle> m_FreeHandles;
+
+		std::vector<RetiredBuffer> m_RetiredBuffers;
+
+		uint32 m_LayoutVersion = 0;
+
+		uint32 m_RebuildCount = 0;
+	};
+}   // namespace Fling
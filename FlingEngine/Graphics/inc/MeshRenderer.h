@@ -21,25 +21,20 @@ namespace Fling
 
         /** 
         * Create a mesh renderer with the given material and model.
-        * If the material is null than it will load the default material
+        * If the material is empty than it will load the default material
         */
-		MeshRenderer(Model* t_Model, Material* t_Mat = nullptr);
+		MeshRenderer(Handle<Model> t_Model, Handle<Material> t_Mat = {});
 
         // Cleanup is handled by the rendering systems
 		~MeshRenderer() = default;
 
-        /** Pointer to the actual model  */
-        Model* m_Model = nullptr;
+        /** Handle to the actual model. Keeps it loaded while this mesh renderer exists  */
+        Handle<Model> m_Model;
 
-        /** Pointer to the material that this mesh renderer uses */
-        Material* m_Material = nullptr;
+        /** Handle to the material that this mesh renderer uses */
+        Handle<Material> m_Material;
 
-        /** We need a uniform buffer per-swap chain image */
-        Buffer* m_UniformBuffer = nullptr;
-
-        VkDescriptorSet m_DescriptorSet  = VK_NULL_HANDLE;
-
-        void Release();
+        // Per draw uniform data and descriptor sets are owned by the subpasses. @see UniformBufferRing
 
         bool operator==(const MeshRenderer& other) const;
         bool operator!=(const MeshRenderer& other) const;
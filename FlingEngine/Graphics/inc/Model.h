@@ -4,13 +4,19 @@
 
 #include "Buffer.h"
 #include "Vertex.h"
+#include "Bounds.h"
+#include "MeshArena.h"
 
 namespace Fling
 {
+	struct OccluderMesh;
+
 	/**
 	 * @brief 	A model represents a 3D model (.obj files for now) with vertices
-	 * 			and indecies. A model has a vertex and index buffer and can be 
-	 * 			bound to a command buffer.
+	 * 			and indecies. The vertices and indices live in the mesh arena,
+	 * 			so draws have to use the model's first index and vertex offset.
+	 *
+	 * @see		MeshArena
 	 */
     class Model : public Resource
     {
@@ -21,12 +27,33 @@ namespace Fling
 		/** Creates a quad primitive model */
 		static std::shared_ptr<Fling::Model> Quad();
 
+		/** Vertices and indices parsed out of the file by Decode. @see IsAsyncLoadable */
+		struct LoadData
+		{
+			std::vector<Vertex> Verts;
+			std::vector<uint32> Indices;
+		};
+
+		/** Parse the .obj file with Tiny Obj loader and calculate tangents. Safe to call from any thread */
+		static std::unique_ptr<LoadData> Decode(Guid t_ID);
+
+		/** Read only the positions and triangles of an .obj file, for CPU occlusion culling. Safe to call from any thread */
+		static bool DecodeOccluder(Guid t_ID, OccluderMesh& t_OutMesh);
+
+		/** Set if models keep their vertices and indices after they are uploaded. Defaults to Release */
+		static void SetCpuDataPolicy(CpuDataPolicy t_Policy) { VertexDataPolicy = t_Policy; }
+
+		static CpuDataPolicy GetCpuDataPolicy() { return VertexDataPolicy; }
+
 		/**
 		 * @brief	Construct a new model object
 		 * @param t_ID              The GUID that represents the file path to this model
 		 */
 		Model(Guid t_ID);
 
+		/** Create the vertex and index buffers from already parsed data. Main thread only */
+		Model(Guid t_ID, std::unique_ptr<LoadData> t_Data);
+
 		/**
 		 * @param	t_ID The GUID that represents a unique name for this model. It's up to the user to ensure uniqueness
 		 */
@@ -34,14 +61,30 @@ namespace Fling
 
 		~Model();
 
-		FORCEINLINE Buffer* GetVertexBuffer() const { return m_VertexBuffer; }
-		FORCEINLINE Buffer* GetIndexBuffer() const { return m_IndexBuffer; }
+		/** The mesh arena's buffers, shared by every model */
+		FORCEINLINE Buffer* GetVertexBuffer() const { return m_Arena->GetVertexBuffer(); }
+		FORCEINLINE Buffer* GetIndexBuffer() const { return m_Arena->GetIndexBuffer(); }
+
+		/** Where this model is in the arena's index buffer. Can change when the arena grows or compacts */
+		FORCEINLINE uint32 GetFirstIndex() const { return m_ArenaMesh != MeshArena::INVALID_HANDLE ? m_Arena->GetRange(m_ArenaMesh).FirstIndex : 0; }
+
+		/** Added to each index of this model to get to its vertices in the arena */
+		FORCEINLINE int32 GetVertexOffset() const { return m_ArenaMesh != MeshArena::INVALID_HANDLE ? static_cast<int32>(m_Arena->GetRange(m_ArenaMesh).FirstVertex) : 0; }
 
+		/** CPU copies of the mesh data. Empty if they were released after upload. @see CpuDataPolicy */
 		FORCEINLINE const std::vector<Vertex>& GetVerts() const { return m_Verts; }
 		FORCEINLINE const std::vector<uint32>& GetIndices() const { return m_Indices; }
 
-		FORCEINLINE uint32 GetIndexCount() const { return static_cast<uint32>(m_Indices.size()); }
-		FORCEINLINE uint32 GetVertexCount() const { return static_cast<uint32>(m_Verts.size()); }
+		FORCEINLINE uint32 GetIndexCount() const { return m_IndexCount; }
+		FORCEINLINE uint32 GetVertexCount() const { return m_VertexCount; }
+
+		/** Local space bounds of the vertices, calculated when the model is loaded */
+		FORCEINLINE const AABB& GetBounds() const { return m_Bounds; }
+		FORCEINLINE const BoundingSphere& GetBoundingSphere() const { return m_BoundingSphere; }
+
+		virtual uint64 GetCpuMemoryUsage() const override;
+
+		virtual uint64 GetGpuMemoryUsage() const override;
 
 		constexpr static VkIndexType GetIndexType() { return VK_INDEX_TYPE_UINT32; }
 
@@ -49,18 +92,24 @@ namespace Fling
 
 		void CreateBuffers();
 
+		/** Fit the bounding box and sphere to m_Verts. Has to be called before the vertices are released */
+		void CalculateBounds();
+
 		static void CalculateVertexTangents(Vertex* verts, uint32 numVerts, uint32* indices, uint32 numIndices);
 
 		std::vector<Vertex> m_Verts;
 		std::vector<uint32> m_Indices;
 
-		Buffer* m_VertexBuffer = nullptr;
-		Buffer* m_IndexBuffer = nullptr;
+		uint32 m_VertexCount = 0;
+		uint32 m_IndexCount = 0;
 
-		/**
-		 * @brief	Load this model from Tiny Obj loader
-		 */
-		void LoadModel();
+		AABB m_Bounds;
+		BoundingSphere m_BoundingSphere;
+
+		MeshArena* m_Arena = nullptr;
+		MeshArena::Handle m_ArenaMesh = MeshArena::INVALID_HANDLE;
+
+		static CpuDataPolicy VertexDataPolicy;
 
     };
 }   // namespace Fling
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
 
 #include "Subpass.h"
+#include "Vertex.h"
+#include "Stats.h"
+#include "FrustumCuller.h"
+#include "OcclusionBuffer.h"
+#include "DrawBatchTable.h"
 
 namespace Fling
 {
@@ -10,14 +15,54 @@ namespace Fling
 	struct MeshRenderer;
 	class Swapchain;
 	class FirstPersonCamera;
+	class Material;
+	class Resource;
+	class UniformBufferRing;
+	class Model;
+	class Buffer;
+	class GpuCuller;
+	class BindlessTextures;
 
-	/** UBO for mesh data */
+	/**
+	* Sort key of a mesh in the G-Buffer pass, from the most to least significant bits:
+	*	[63:56] Pipeline
+	*	[55:40] Material
+	*	[39:24] Model
+	*	[23:0]  View depth, so that instances of a draw go front to back
+	* Sorting by these groups meshes by their most expensive state changes first
+	*/
+	namespace DrawKey
+	{
+		static const uint32 PIPELINE_SHIFT = 56;
+		static const uint32 MATERIAL_SHIFT = 40;
+		static const uint32 MODEL_SHIFT = 24;
+
+		static const uint64 PIPELINE_MASK = 0xFF;
+		static const uint64 MATERIAL_MASK = 0xFFFF;
+		static const uint64 MODEL_MASK = 0xFFFF;
+		static const uint64 DEPTH_MASK = 0xFFFFFF;
+
+		inline uint64 Make(uint32 t_Pipeline, uint32 t_Material, uint32 t_Model, uint32 t_Depth)
+		{
+			return ((t_Pipeline & PIPELINE_MASK) << PIPELINE_SHIFT) |
+				((t_Material & MATERIAL_MASK) << MATERIAL_SHIFT) |
+				((t_Model & MODEL_MASK) << MODEL_SHIFT) |
+				(t_Depth & DEPTH_MASK);
+		}
+
+		inline uint32 GetPipeline(uint64 t_Key) { return static_cast<uint32>((t_Key >> PIPELINE_SHIFT) & PIPELINE_MASK); }
+		inline uint32 GetMaterial(uint64 t_Key) { return static_cast<uint32>((t_Key >> MATERIAL_SHIFT) & MATERIAL_MASK); }
+		inline uint32 GetModel(uint64 t_Key) { return static_cast<uint32>((t_Key >> MODEL_SHIFT) & MODEL_MASK); }
+
+		/** Keys that can be drawn with the same instanced draw */
+		inline uint64 GetBatch(uint64 t_Key) { return t_Key >> MODEL_SHIFT; }
+	}
+
+	/** UBO for the camera, once per frame. Model matrices are per instance, @see InstanceData */
 	struct alignas(16) OffscreenUBO
 	{
 		glm::mat4 Projection;
-		glm::mat4 Model;
 		glm::mat4 View;
-		glm::vec3 ObjPos;
 	};
 
 	// Uses the MRT shaders (mulitple render targets)
@@ -30,14 +75,20 @@ namespace Fling
 			entt::registry& t_reg,
 			FirstPersonCamera* t_Cam,
 			std::shared_ptr<Fling::Shader> t_Vert,
-			std::shared_ptr<Fling::Shader> t_Frag
+			std::shared_ptr<Fling::Shader> t_Frag,
+			std::shared_ptr<Fling::Shader> t_Cull = nullptr,
+			std::shared_ptr<Fling::Shader> t_DepthReduce = nullptr
 		);
 
 		virtual ~OffscreenSubpass();
 
+		const char* GetName() const override final { return "Offscreen"; }
+
+		bool RecordsOwnCommandBuffer() const override final { return true; }
+
 		FrameBuffer* GetOffscreenFrameBuffer() const { return m_OffscreenFrameBuf; }
 
-		void Draw(CommandBuffer& t_CmdBuf, uint32 t_ActiveSwapImage, entt::registry& t_reg, float DeltaTime) override final;
+		void Draw(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight, entt::registry& t_reg, float DeltaTime) override final;
 
 		void PrepareAttachments() override final;
 
@@ -46,7 +97,6 @@ namespace Fling
 		void GatherPresentDependencies(
 			std::vector<CommandBuffer*>& t_CmdBuffs,
 			std::vector<VkSemaphore>& t_Deps,
-			uint32 t_ActiveFrameIndex,
 			uint32 t_CurrentFrameInFlight) override final;
 
 		void CleanUp(entt::registry& t_reg) override final;
@@ -59,23 +109,309 @@ namespace Fling
 
 		void OnMeshRendererDestroyed(entt::registry& t_Reg, MeshRenderer& t_MeshRend);
 
-		void CreateMeshDescriptorSet(MeshRenderer& t_MeshRend);
+		/** Free the descriptor set of a material that is being unloaded */
+		void OnResourceEvicted(Resource& t_Res);
+
+		/**
+		* @brief	Get the descriptor set that is used by every mesh with this material, creating it
+		*			if it does not exist yet. Binding 0 points at the uniform ring with a dynamic offset.
+		*/
+		VkDescriptorSet GetMaterialDescriptorSet(Material* t_Mat);
+
+		/**
+		* @brief	Get the slot of a material in the bindless materials buffer, giving it one if it does not
+		*			have one yet. Its texture slots are copied to each frame's buffer before it is drawn
+		*/
+		uint32 GetBindlessMaterial(Material* t_Mat);
+
+		/** Bindless texture slots of a material's textures, using the default material's for any that are missing */
+		glm::uvec4 GetBindlessTextureSlots(const Material* t_Mat) const;
+
+		/**
+		* @brief	Copy the material table and the material slot of each instance to this frame's buffers if
+		*			they changed since the frame last used them, and point its set 0 at them
+		*/
+		void UpdateBindlessFrame(uint32 t_ActiveFrameInFlight);
+
+		/** Bind this frame's set 0 and the bindless textures at set 1, which every draw in the pass shares */
+		void BindBindlessSets(VkCommandBuffer t_Cmd, uint32 t_ActiveFrameInFlight, uint32 t_DynamicOffset, Stats::DrawCounts& t_Counts);
 
 		void BuildOffscreenCommandBuffer(entt::registry& t_reg, uint32 t_ActiveFrameInFlight);
 
+		/**
+		* @brief	Gather the meshes to draw and rebuild the sorted draw list if any of them moved, or if the
+		*			camera or the set of meshes changed since the last frame. Otherwise last frame's list is reused
+		*/
+		void BuildDrawList(entt::registry& t_reg, uint32 t_ActiveFrameInFlight);
+
+		/**
+		* @brief	Frustum and occlusion cull the candidates, give the visible ones a DrawKey, radix sort them,
+		*			and put their instance data in m_SortedInstances
+		*/
+		void RebuildDrawList(uint32 t_CandidateCount);
+
+		/**
+		* @brief	Bring the GPU culling objects up to date with the render group. Only the objects that moved
+		*			are copied, unless a mesh was added, removed or changed its model or material
+		*/
+		void UpdateGpuObjects(entt::registry& t_reg);
+
+		/**
+		* Record the indirect draws of m_GpuBatches into this frame's first secondary command buffer. With
+		* multiDrawIndirect this is one draw per material, or one for every batch with bindless textures.
+		* Otherwise it is one per batch
+		*/
+		void RecordIndirectDraws(uint32 t_ActiveFrameInFlight, uint32 t_DynamicOffset, const VkViewport& t_Viewport, const VkRect2D& t_Scissor);
+
+		/** Copy the sorted instances to this frame's instance buffer unless it already has this draw list */
+		void UploadInstances(uint32 t_ActiveFrameInFlight);
+
+		/**
+		* @brief	Rasterize the occluders of the visible candidates and remove the ones that are hidden
+		*			behind them from m_VisibleCandidates. Candidates with an occluder are always kept
+		* @return	Number of visible candidates that are left
+		*/
+		uint32 CullOccludedCandidates(uint32 t_VisibleCount);
+
+		/**
+		* @brief	Split the sorted draw list into chunks and record each one into a secondary command
+		*			buffer on the job system. m_ChunkCmdBufs has the buffers to execute afterwards
+		*/
+		void RecordDrawChunks(uint32 t_ActiveFrameInFlight, uint32 t_DynamicOffset, const VkViewport& t_Viewport, const VkRect2D& t_Scissor);
+
+		/**
+		* @brief	Record [t_First, t_Last) of the sorted draw list. Neighbouring meshes with the same model and
+		*			material are one instanced draw, and each binding only changes when its part of the key does.
+		*			Safe to call from any thread as long as each thread has its own command buffer and counts
+		*/
+		void RecordDrawList(
+			CommandBuffer& t_CmdBuf,
+			uint32 t_ActiveFrameInFlight,
+			uint32 t_DynamicOffset,
+			uint32 t_First,
+			uint32 t_Last,
+			Stats::DrawCounts& t_Counts);
+
+		/** Get the small ID of a model or material for a draw key, assigning one if it does not have one yet */
+		template<class T>
+		static uint32 GetDrawId(T* t_Ptr, std::unordered_map<const T*, uint32>& t_Ids, std::vector<T*>& t_Ptrs);
+
 		// We need an offscreen semaphore for each possible frame in flight because the swap chain
 		// presentation will depend on this command buffer being complete
 		std::vector<VkSemaphore> m_OffscreenSemaphores;
 
-		VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+		/** Command pools of one frame in flight. They are reset as a whole at the start of the frame's Draw */
+		struct FrameCommands
+		{
+			/** Pool of the primary offscreen command buffer */
+			VkCommandPool PrimaryPool = VK_NULL_HANDLE;
+
+			/** One pool per chunk so that chunks can be recorded on different threads */
+			std::vector<VkCommandPool> ChunkPools;
+
+			/** Secondary command buffer of each chunk */
+			std::vector<CommandBuffer*> Secondaries;
 
-		// Offscreen command buffers for populating the GBuffer
+			/** What each chunk recorded, added to Stats::Draws once they are all done */
+			std::vector<Stats::DrawCounts> ChunkCounts;
+		};
+
+		std::vector<FrameCommands> m_FrameCommands;
+
+		// Offscreen command buffers for populating the GBuffer, one per frame in flight
 		std::vector<CommandBuffer*> m_OffscreenCmdBufs;
 
+		/** First draw of each chunk this frame, plus the draw count at the end */
+		std::vector<uint32> m_ChunkStarts;
+
+		/** Secondary command buffers recorded this frame */
+		std::vector<VkCommandBuffer> m_ChunkCmdBufs;
+
 		FrameBuffer* m_OffscreenFrameBuf = nullptr;
 
 		const FirstPersonCamera* m_Camera;
 
-		VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
+		/** The camera's OffscreenUBO is allocated from this every frame */
+		std::unique_ptr<UniformBufferRing> m_UniformRing;
+
+		/** Host visible instance data for each frame in flight. Grows when there are more instances than fit */
+		std::vector<std::unique_ptr<Buffer>> m_InstanceBuffers;
+
+		/** The m_DrawListGeneration that each instance buffer was last written with */
+		std::vector<uint64> m_InstanceBufferGenerations;
+
+		/** A mesh that will be drawn if it passes culling */
+		struct DrawCandidate
+		{
+			Fling::Model* Model = nullptr;
+			Material* Mat = nullptr;
+			const glm::mat4* World = nullptr;
+
+			bool operator==(const DrawCandidate& t_Other) const
+			{
+				return Model == t_Other.Model && Mat == t_Other.Mat && World == t_Other.World;
+			}
+		};
+
+		std::vector<DrawCandidate> m_DrawCandidates;
+
+		/** Candidates of the last frame, to tell if the draw list can be reused */
+		std::vector<DrawCandidate> m_PrevDrawCandidates;
+
+		/** Camera and candidate count that the draw list was built with */
+		glm::mat4 m_DrawListView { 1.0f };
+		glm::mat4 m_DrawListProjection { 1.0f };
+		uint32 m_DrawListCandidateCount = 0;
+
+		/** Culling counts of the draw list, added to the stats each frame that it is drawn */
+		Stats::DrawCounts m_DrawListCounts;
+
+		/** Incremented every time that the draw list is rebuilt */
+		uint64 m_DrawListGeneration = 0;
+
+		/** False until the first draw list is built, and after any resource is evicted since its address could be reused */
+		bool m_DrawListValid = false;
+
+		/** World bounds of each candidate */
+		FrustumCuller m_Culler;
+
+		/** Indices of the candidates that are inside of the camera's frustum */
+		std::vector<uint32> m_VisibleCandidates;
+
+		/** [Vulkan] FrustumCulling, every candidate is drawn if this is off */
+		bool m_FrustumCulling = true;
+
+		/** [Vulkan] HierarchicalCulling, cull with the world's SpatialTree instead of testing every mesh */
+		bool m_HierarchicalCulling = true;
+
+		/** Entities that the spatial tree found inside of the frustum */
+		std::vector<entt::entity> m_TreeVisible;
+
+		/** [Vulkan] OcclusionCulling, skip meshes that are hidden behind the occluders of other materials */
+		bool m_OcclusionCulling = true;
+
+		/** Occluders of this frame's visible candidates are rasterized here. @see Material::GetOccluder */
+		std::unique_ptr<OcclusionBuffer> m_Occlusion;
+
+		/** 1 for each visible candidate that is not behind an occluder */
+		std::vector<uint8> m_CandidateUnoccluded;
+
+		/** [Vulkan] GpuCulling, cull in a compute shader and draw with indirect commands instead of the draw list */
+		bool m_GpuCulling = true;
+
+		/** True if the G-Buffer depth can be sampled to build the depth pyramid for GPU occlusion culling */
+		bool m_GpuOcclusion = false;
+
+		std::unique_ptr<GpuCuller> m_GpuCuller;
+
+		std::shared_ptr<Fling::Shader> m_CullShader;
+		std::shared_ptr<Fling::Shader> m_DepthReduceShader;
+
+		/** Index of the depth attachment in the offscreen frame buffer */
+		uint32 m_DepthAttachment = 0;
+
+		/** Batch of each GPU culling object, by the model and material IDs in m_DrawModels and m_DrawMaterials */
+		DrawBatchTable m_GpuBatches;
+
+		/** What each GPU culling object was built from, to tell when the batches have to be rebuilt */
+		std::vector<entt::entity> m_GpuObjectEntities;
+		std::vector<const Fling::Model*> m_GpuObjectModels;
+		std::vector<const Material*> m_GpuObjectMaterials;
+
+		/** Objects that have a model, the most that the GPU can draw */
+		uint32 m_GpuDrawableCount = 0;
+
+		/** False when the GPU culling objects and batches have to be rebuilt from scratch */
+		bool m_GpuObjectsValid = false;
+
+		/** True if the batches of a material can be drawn together, every mesh is in the same arena buffers */
+		bool m_MultiDrawIndirect = false;
+
+		/** Mesh arena layout that the draw commands were made with. @see MeshArena::GetLayoutVersion */
+		uint32 m_GpuArenaVersion = 0;
+
+		/** Sort key of each mesh this frame. @see DrawKey */
+		std::vector<uint64> m_DrawKeys;
+
+		/** Index into m_UnsortedInstances of each key */
+		std::vector<uint32> m_DrawIndices;
+
+		/** Radix sort scratch space */
+		std::vector<uint64> m_DrawKeysTemp;
+		std::vector<uint32> m_DrawIndicesTemp;
+
+		std::vector<InstanceData> m_UnsortedInstances;
+
+		/** Instance data in draw key order, what gets copied to the instance buffers */
+		std::vector<InstanceData> m_SortedInstances;
+
+		/** Models and materials of this frame by their draw key ID */
+		std::vector<Fling::Model*> m_DrawModels;
+		std::vector<Material*> m_DrawMaterials;
+
+		/** Descriptor set of each material in m_DrawMaterials, looked up before recording starts */
+		std::vector<VkDescriptorSet> m_DrawMaterialSets;
+
+		std::unordered_map<const Fling::Model*, uint32> m_DrawModelIds;
+		std::unordered_map<const Material*, uint32> m_DrawMaterialIds;
+
+		/** Descriptor sets are shared between all meshes with the same material. @see DescriptorAllocator::GetCached */
+		std::unordered_map<const Material*, VkDescriptorSet> m_MaterialDescriptorSets;
+
+		/** Textures of every material are read out of this when it is set. Null if each material has its own set */
+		BindlessTextures* m_Bindless = nullptr;
+
+		/** The bindless buffers and set 0 of one frame in flight */
+		struct BindlessFrame
+		{
+			/** Texture slots of each material slot. Read by the fragment shader at set 0, binding 1 */
+			std::unique_ptr<Buffer> Materials;
+
+			/** Material slot of each instance, vertex binding 2 */
+			std::unique_ptr<Buffer> InstanceMaterials;
+
+			/** Camera UBO and the materials buffer of this frame. Transient, so only valid for the frame that wrote it */
+			VkDescriptorSet Set = VK_NULL_HANDLE;
+
+			/** m_BindlessMaterialsGeneration and m_InstanceMaterialsGeneration that the buffers were last written with */
+			uint64 MaterialsGeneration = 0;
+			uint64 InstanceMaterialsGeneration = 0;
+		};
+
+		std::vector<BindlessFrame> m_BindlessFrames;
+
+		/** Texture slots of each bindless material slot. @see GetBindlessTextureSlots */
+		std::vector<glm::uvec4> m_BindlessMaterials;
+
+		/** Material in each slot, null if the slot is free */
+		std::vector<const Material*> m_BindlessMaterialOwners;
+
+		std::unordered_map<const Material*, uint32> m_BindlessMaterialSlots;
+
+		/** Slots of materials that were unloaded */
+		std::vector<uint32> m_FreeBindlessMaterials;
+
+		/** Incremented every time that m_BindlessMaterials changes */
+		uint64 m_BindlessMaterialsGeneration = 1;
+
+		/** A texture was unloaded, so the texture slots of every material are looked up again */
+		bool m_BindlessMaterialsStale = false;
+
+		/**
+		* Bindless material slot of each instance, in the same order as the instance data. For the GPU
+		* culling path every instance in a batch's range has the batch's material
+		*/
+		std::vector<uint32> m_InstanceMaterials;
+
+		/** Material slot of each unsorted instance */
+		std::vector<uint32> m_UnsortedInstanceMaterials;
+
+		/** Incremented every time that m_InstanceMaterials changes */
+		uint64 m_InstanceMaterialsGeneration = 1;
+
+		/** Only warn once if the uniform ring runs out of space, it would otherwise spam every frame */
+		bool m_HasLoggedRingOverflow = false;
+
+		bool m_HasLoggedDrawKeyOverflow = false;
 	};
 }   // namespace Fling
\ No newline at end of file
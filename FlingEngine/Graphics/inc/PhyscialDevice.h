@@ -23,6 +23,16 @@ namespace Fling
 		const VkPhysicalDeviceProperties& GetDeviceProps() const { return m_DeviceProperties; }
         const VkPhysicalDeviceFeatures& GetDeivceFeatures() const { return m_DeviceFeatures; } 
 
+		/** Descriptor indexing features and limits. Everything is false or 0 if the device doesn't have VK_EXT_descriptor_indexing */
+		const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& GetDescriptorIndexingFeatures() const { return m_DescriptorIndexingFeatures; }
+		const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& GetDescriptorIndexingProps() const { return m_DescriptorIndexingProps; }
+
+		/** True if the device has every descriptor indexing feature that an array of textures indexed per material needs. @see BindlessTextures */
+		bool SupportsBindlessTextures() const;
+
+		/** True if the device supports the given device extension */
+		bool HasExtension(const char* t_Name) const;
+
         /**
          * @brief Get a string representing the device vendor
          * 
@@ -47,6 +57,9 @@ namespace Fling
 
     private:
 
+		/** Fill in the features and limits that can only be asked for with VK_KHR_get_physical_device_properties2 */
+		void QueryExtendedFeatures();
+
 		/**
 		 * Choose the best available physical device on this machine favoring discrete GPU's and
 		 * those who match all instance extensions
@@ -64,6 +77,12 @@ namespace Fling
         VkPhysicalDeviceFeatures m_DeviceFeatures{};
 		VkPhysicalDeviceMemoryProperties m_MemoryProperties{};
 
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT m_DescriptorIndexingFeatures{};
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT m_DescriptorIndexingProps{};
+
+		/** Device extensions that this device supports */
+		std::vector<VkExtensionProperties> m_Extensions;
+
 		/** The max supported MSSA level on this device */
 		VkSampleCountFlagBits m_MSAASamples = VK_SAMPLE_COUNT_1_BIT;
     };
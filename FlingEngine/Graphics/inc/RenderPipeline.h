@@ -23,12 +23,18 @@ namespace Fling
 		RenderPipeline(entt::registry& t_Reg, LogicalDevice* t_dev, Swapchain* t_Swap, std::vector<std::unique_ptr<Subpass>>& t_Subpasses);
 		~RenderPipeline();
 
+		/**
+		* @brief	Record anything that has to happen before the swap chain render pass begins, like
+		*			resetting the GPU timing queries of the subpasses that are drawn inside of it
+		*/
+		void PrepareDraw(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight);
+
 		void Draw(CommandBuffer& t_CmdBuf, VkFramebuffer t_PresentFrameBuf, uint32 t_ActiveFrameInFlight, entt::registry& t_Reg, float DeltaTime);
 
-		/** Given a frame index, get any semaphores that the swap chain command buffer needs to wait for */
-		void GatherPresentDependencies(std::vector<CommandBuffer*>& t_CmdBuffs, std::vector<VkSemaphore>& t_Deps, uint32 t_ActiveFrameIndex, uint32 t_CurrentFrameInFlight);
+		/** Given a frame in flight, get any semaphores that the swap chain command buffer needs to wait for */
+		void GatherPresentDependencies(std::vector<CommandBuffer*>& t_CmdBuffs, std::vector<VkSemaphore>& t_Deps, uint32 t_CurrentFrameInFlight);
 
-		void GatherPresentBuffers(std::vector<CommandBuffer*>& t_CmdBuffs, uint32 t_ActiveFrameIndex);
+		void GatherPresentBuffers(std::vector<CommandBuffer*>& t_CmdBuffs, uint32 t_CurrentFrameInFlight);
 
 		/** Clean up any allocated VK resources that may have been set in a sub pass and need the registry */
 		void CleanUp(entt::registry& t_reg);
@@ -39,14 +45,12 @@ namespace Fling
 	private:
 
 		/**
-		* @brief	Creates the descriptor pool and the descriptor sets for each sub pass to use
+		* @brief	Creates the descriptor sets for each sub pass to use out of the shared allocator
 		*/
 		void CreateDescriptors(entt::registry& t_Reg);
 
 		std::vector<std::unique_ptr<Subpass>> m_Subpasses;
 
-		VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
-
 		const LogicalDevice* m_Device;
 
 		/** Keep track of the swap chain so that we know how many frame buffers to create and what extents to use */
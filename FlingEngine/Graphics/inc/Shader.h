@@ -93,15 +93,32 @@ namespace Fling
         /** get the Vulkan stage bit flags that we should bind to */
 		VkShaderStageFlagBits GetStage() const { return m_Stage; }
 
+		/** The work group size of a compute shader, used to work out how many groups to dispatch */
+		uint32 GetLocalSizeX() const { return localSizeX; }
+		uint32 GetLocalSizeY() const { return localSizeY; }
+		uint32 GetLocalSizeZ() const { return localSizeZ; }
+
+		/** True if this shader reads push constants, so a pipeline layout needs a range for them */
+		bool UsesPushConstants() const { return m_UsesPushConstants; }
+
 		/**
 		* @breif	Release any resrources created by this shader (the module)
 		*/
 		void Release();
 
-		static VkDescriptorSetLayout CreateSetLayout(VkDevice t_Dev, std::vector<Shader*>& t_Shaders, bool t_SupportPushDescriptor = false);
+		/**
+		* @brief	Create a descriptor set layout from the reflected resources of the given shaders
+		*
+		* @param t_DynamicUniformBindings	Bitmask of uniform buffer bindings that should be created as
+		*									VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC instead. @see UniformBufferRing
+		*/
+		static VkDescriptorSetLayout CreateSetLayout(VkDevice t_Dev, std::vector<Shader*>& t_Shaders, bool t_SupportPushDescriptor = false, uint32 t_DynamicUniformBindings = 0);
 
 		static VkPipelineLayout CreatePipelineLayout(VkDevice t_Dev, VkDescriptorSetLayout t_SetLayout, VkShaderStageFlags t_PushConstantStages, size_t t_PushConstantSize);
 
+		/** Pipeline layout with more than one set. The first layout is set 0 */
+		static VkPipelineLayout CreatePipelineLayout(VkDevice t_Dev, const std::vector<VkDescriptorSetLayout>& t_SetLayouts, VkShaderStageFlags t_PushConstantStages, size_t t_PushConstantSize);
+
     private:
 
 		static uint32 GatherResources(const std::vector<Shader*>& t_Shaders, VkDescriptorType(&t_ResourceTypes)[32]);
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "FlingTypes.h"
+#include "Vertex.h"
+#include "Bounds.h"
+
+#include <vector>
+
+namespace Fling
+{
+	/**
+	* @brief	Bakes the world transforms of static meshes into their vertices and merges the ones that share
+	*			a material into larger meshes, so that a level of small props is a few draws instead of one
+	*			per prop. Meshes are only merged with others in the same cell of a world space grid, so
+	*			the merged meshes stay small enough to be culled.
+	*
+	*			Sources are transformed on the job system. Each merged mesh keeps which sources went into it
+	*			and where each one's indices start, so that it can be traced back to them.
+	* @see World::BuildStaticBatches
+	*/
+	class StaticMeshMerger
+	{
+	public:
+
+		/** Merged meshes are split before they get more vertices than this, unless a single source has more */
+		static const uint32 DEFAULT_MAX_VERTICES = 1 << 16;
+
+		/** A mesh to merge. The vertices and indices are only read, and have to live until Build is done */
+		struct Source
+		{
+			const Vertex* Verts = nullptr;
+			uint32 VertexCount = 0;
+			const uint32* Indices = nullptr;
+			uint32 IndexCount = 0;
+
+			glm::mat4 World { 1.0f };
+
+			/** Sources are only merged with others that have the same material and group */
+			uint32 Material = 0;
+			uint32 Group = 0;
+		};
+
+		struct MergedMesh
+		{
+			uint32 Material = 0;
+			uint32 Group = 0;
+
+			/** World space vertices. Indices are relative to this mesh's vertices */
+			std::vector<Vertex> Verts;
+			std::vector<uint32> Indices;
+
+			AABB Bounds;
+
+			/** Index of each source in this mesh, in the order that they were added to it */
+			std::vector<uint32> Sources;
+
+			/** Where each source's indices start in Indices. Parallel to Sources */
+			std::vector<uint32> SourceFirstIndex;
+		};
+
+		/**
+		* @param t_CellSize		Size of the grid cells that meshes are merged within, in world units
+		* @param t_MaxVertices	Most vertices that a merged mesh gets before it is split
+		*/
+		StaticMeshMerger(float t_CellSize = 32.0f, uint32 t_MaxVertices = DEFAULT_MAX_VERTICES);
+
+		/** Add a mesh to merge. Its index is the number of sources before it */
+		void Add(const Source& t_Source);
+
+		/** Remove every source and merged mesh, keeping the memory */
+		void Clear();
+
+		/** Merge the sources. Blocks until every job is done */
+		void Build();
+
+		FORCEINLINE uint32 GetSourceCount() const { return static_cast<uint32>(m_Sources.size()); }
+
+		FORCEINLINE const std::vector<MergedMesh>& GetMeshes() const { return m_Meshes; }
+
+		FORCEINLINE std::vector<MergedMesh>& GetMeshes() { return m_Meshes; }
+
+		/** Cell of the grid that a point is in */
+		glm::ivec3 GetCell(const glm::vec3& t_Pos) const;
+
+	private:
+
+		/** Where a source ends up once the sources have been grouped */
+		struct Placement
+		{
+			uint32 Mesh = 0;
+			uint32 FirstVertex = 0;
+			uint32 FirstIndex = 0;
+		};
+
+		/** Write a source's transformed vertices and indices into its merged mesh */
+		void WriteSource(uint32 t_Source);
+
+		float m_CellSize = 32.0f;
+		uint32 m_MaxVertices = DEFAULT_MAX_VERTICES;
+
+		std::vector<Source> m_Sources;
+
+		/** World space bounds of each source */
+		std::vector<AABB> m_SourceBounds;
+
+		std::vector<Placement> m_Placements;
+
+		/** Sources sorted by material, group and cell */
+		std::vector<uint32> m_SortedSources;
+
+		std::vector<MergedMesh> m_Meshes;
+	};
+}   // namespace Fling
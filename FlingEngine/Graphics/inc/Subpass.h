@@ -2,6 +2,7 @@
 
 #include "Shader.h"
 #include "NonCopyable.hpp"
+#include "GpuProfiler.h"
 
 #include <entt/entity/registry.hpp>
 #include <entt/entity/helper.hpp>
@@ -13,6 +14,7 @@ namespace Fling
 	class FrameBuffer;
 	class Swapchain;
 	class GraphicsPipeline;
+	class DescriptorAllocator;
 
 	/**
 	* @brief	A subpass represents one part of a RenderPipeline. Each subpass should 
@@ -25,7 +27,16 @@ namespace Fling
 	class Subpass : public NonCopyable
 	{
 	public:
-		Subpass(const LogicalDevice* t_Dev, const Swapchain* t_Swap, std::shared_ptr<Fling::Shader> t_Vert, std::shared_ptr<Fling::Shader> t_Frag);
+		/**
+		* @param t_DynamicUniformBindings	Bitmask of uniform buffer bindings that should use dynamic offsets.
+		*									@see UniformBufferRing
+		*/
+		Subpass(
+			const LogicalDevice* t_Dev,
+			const Swapchain* t_Swap,
+			std::shared_ptr<Fling::Shader> t_Vert,
+			std::shared_ptr<Fling::Shader> t_Frag,
+			uint32 t_DynamicUniformBindings = 0);
 		
 		virtual ~Subpass();
 
@@ -34,6 +45,10 @@ namespace Fling
 
 		virtual void CreateGraphicsPipeline() = 0;
 
+		/**
+		* @brief	Record this subpass. Any per-frame resources (UBO's, descriptor sets, command buffers)
+		*			should be indexed with t_ActiveFrameInFlight, NOT the swap chain image index
+		*/
 		virtual void Draw(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight, entt::registry& t_reg, float DeltaTime) = 0;
 
 		/** Cleanup any allocated resources that you may need a registry for */
@@ -42,25 +57,39 @@ namespace Fling
 		/**
 		* @brief	Given the frame buffers and the registry, create any descriptor sets that we may need
 		*			Assumes that the frame buffer has been prepared with it's attachments already.
-		* @param t_FrameBuffer	The swap chain frame buffer
+		* @param t_Allocator	Allocator for the sets. Sets from it have to be freed before the subpass is destroyed
 		*/		
-		virtual void CreateDescriptorSets(VkDescriptorPool t_Pool, entt::registry& t_reg) {};
+		virtual void CreateDescriptorSets(DescriptorAllocator& t_Allocator, entt::registry& t_reg) {};
 		
 		/**
 		 * @brief	If a subpass has a command buffer that the final swap chain presentation is dependent on, 
 		 *			then add it this vector. The Deferred offscreen GBuffer is an example of this
+		 * @param t_CurrentFrameInFlight	The frame in flight that is being submitted. @see VulkanApp::GetFramesInFlight
 		 */
-		virtual void GatherPresentDependencies(std::vector<CommandBuffer*>& t_CmdBuffs, std::vector<VkSemaphore>& t_Deps, uint32 t_ActiveFrameIndex, uint32 t_CurrentFrameInFlight) {}
+		virtual void GatherPresentDependencies(std::vector<CommandBuffer*>& t_CmdBuffs, std::vector<VkSemaphore>& t_Deps, uint32 t_CurrentFrameInFlight) {}
 		
 		/**
 		* @brief	If a subpass has an additional command buffer to add to the final swap chain draw submission
 		*			but it is not dependent on it, then add it here. ImGUI is an example of this
 		*/
-		virtual void GatherPresentBuffers(std::vector<CommandBuffer*>& t_CmdBuffs, uint32 t_ActiveFrameIndex) {}
+		virtual void GatherPresentBuffers(std::vector<CommandBuffer*>& t_CmdBuffs, uint32 t_CurrentFrameInFlight) {}
 
 		/** Function that is called when the swap chain is resized. Put any logic that may depend on Swapchain extents */
 		virtual void OnSwapchainResized(entt::registry& t_reg) {}
 
+		/** Name of this pass in GPU timings */
+		virtual const char* GetName() const { return "Subpass"; }
+
+		/**
+		* @brief	Subpasses that record into their own command buffer instead of the one given to Draw
+		*			have to time themselves with BeginGpuScope and EndGpuScope. Any other subpass is
+		*			timed by the RenderPipeline
+		*/
+		virtual bool RecordsOwnCommandBuffer() const { return false; }
+
+		inline void SetGpuScope(GpuScopeId t_Scope) { m_GpuScope = t_Scope; }
+		inline GpuScopeId GetGpuScope() const { return m_GpuScope; }
+
 		inline GraphicsPipeline* GetGraphicsPipeline() const noexcept { return m_GraphicsPipeline; }
 		inline const std::vector<VkClearValue>& GetClearValues() const { return m_ClearValues; }
 
@@ -70,6 +99,11 @@ namespace Fling
 
 		void DestroyGraphicsPipeline();
 
+		/** Reset and start the GPU timing of this subpass. Has to be recorded outside of a render pass */
+		void BeginGpuScope(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight, bool t_ExecutesSecondaries = false);
+
+		void EndGpuScope(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight);
+
 		// Get default graphics Pipeline
 		const LogicalDevice* m_Device;
 		const Swapchain* m_SwapChain;
@@ -83,5 +117,11 @@ namespace Fling
 
 		/** Layouts created in the constructor via shader reflection */
 		GraphicsPipeline* m_GraphicsPipeline = nullptr;
+
+		/** Uniform buffer bindings that are created as VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC */
+		uint32 m_DynamicUniformBindings = 0;
+
+		/** Set by the RenderPipeline. @see GpuProfiler */
+		GpuScopeId m_GpuScope = INVALID_GPU_SCOPE;
 	};
 }
\ No newline at end of file
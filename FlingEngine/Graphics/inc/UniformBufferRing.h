@@ -0,0 +1,89 @@
+#pragma once
+
+#include "FlingVulkan.h"
+#include "FlingTypes.h"
+#include "NonCopyable.hpp"
+
+namespace Fling
+{
+	class Buffer;
+	class LogicalDevice;
+
+	/**
+	* @brief	One large, persistently mapped uniform buffer that is split into a region per frame
+	*			in flight. Per-draw uniform data is bump allocated out of the current frame's region
+	*			and bound with a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC offset, so that a single
+	*			descriptor set can be shared between every draw that uses it.
+	*
+	* @note		Regions are only reset in BeginFrame, so the in flight fence of that frame must
+	*			have been waited on before calling it. @see VulkanApp::Update
+	*/
+	class UniformBufferRing : public NonCopyable
+	{
+	public:
+
+		/**
+		* @param t_Dev				Logical device used to query the offset alignment of uniform buffers
+		* @param t_BytesPerFrame	How many bytes can be allocated in a single frame
+		* @param t_FrameCount		Number of frames in flight (regions) that this ring has
+		*/
+		UniformBufferRing(const LogicalDevice* t_Dev, VkDeviceSize t_BytesPerFrame, uint32 t_FrameCount);
+
+		~UniformBufferRing();
+
+		/** Start allocating from the beginning of the given frame's region */
+		void BeginFrame(uint32 t_FrameInFlight);
+
+		/**
+		* @brief	Allocate some space in the current frame's region
+		*
+		* @param t_Size				Size in bytes of the allocation
+		* @param t_OutDynamicOffset	Offset to pass to vkCmdBindDescriptorSets for this allocation
+		*
+		* @return	Mapped pointer to write the uniform data to. nullptr if this frame is out of space
+		*/
+		void* Allocate(VkDeviceSize t_Size, uint32& t_OutDynamicOffset);
+
+		template<class T>
+		T* Allocate(uint32& t_OutDynamicOffset) { return static_cast<T*>(Allocate(sizeof(T), t_OutDynamicOffset)); }
+
+		/**
+		* @brief	Get a buffer info that can be written to a UNIFORM_BUFFER_DYNAMIC descriptor
+		*
+		* @param t_Range	Size of the structure that the shader reads at each dynamic offset
+		*/
+		VkDescriptorBufferInfo GetDescriptorInfo(VkDeviceSize t_Range) const;
+
+		FORCEINLINE Buffer* GetBuffer() const { return m_Buffer; }
+
+		/** Alignment that every allocation is rounded up to (minUniformBufferOffsetAlignment) */
+		FORCEINLINE VkDeviceSize GetAlignment() const { return m_Alignment; }
+
+		FORCEINLINE VkDeviceSize GetBytesPerFrame() const { return m_BytesPerFrame; }
+
+		/** Bytes allocated so far in the current frame */
+		FORCEINLINE VkDeviceSize GetBytesUsed() const { return m_Head - m_FrameStart; }
+
+		/** True if an allocation has failed since the last BeginFrame */
+		FORCEINLINE bool HasOverflowed() const { return m_Overflowed; }
+
+	private:
+
+		/** The backing uniform buffer, HOST_VISIBLE and mapped for its whole lifetime */
+		Buffer* m_Buffer = nullptr;
+
+		VkDeviceSize m_BytesPerFrame = 0;
+
+		VkDeviceSize m_Alignment = 256;
+
+		/** Start of the region of the current frame */
+		VkDeviceSize m_FrameStart = 0;
+
+		/** Next free byte in the current frame */
+		VkDeviceSize m_Head = 0;
+
+		uint32 m_FrameCount = 0;
+
+		bool m_Overflowed = false;
+	};
+}   // namespace Fling
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "FlingVulkan.h"
+#include "FlingTypes.h"
+#include "NonCopyable.hpp"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Fling
+{
+	class Buffer;
+	class LogicalDevice;
+
+	/**
+	* Identifies the batch that an upload was recorded in. 0 is never used by a batch, so it
+	* can mean "nothing to wait for"
+	*/
+	typedef uint64 UploadTicket;
+
+	/** Describes how data should be copied into an image. @see UploadManager::UploadImage */
+	struct ImageUpload
+	{
+		VkImage Image = VK_NULL_HANDLE;
+
+		VkFormat Format = VK_FORMAT_R8G8B8A8_UNORM;
+
+		uint32 Width = 0;
+
+		uint32 Height = 0;
+
+		uint32 MipLevels = 1;
+
+		uint32 ArrayLayers = 1;
+
+		/**
+		* Copy regions with buffer offsets relative to the start of the uploaded data.
+		* If empty, the data is copied to mip 0 of every layer, one layer after the other
+		*/
+		std::vector<VkBufferImageCopy> Regions;
+
+		/** Blit the rest of the mip chain down from mip 0 after the copy */
+		bool GenerateMips = false;
+
+		/** Layout that the whole image will be in once the upload is complete */
+		VkImageLayout FinalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	};
+
+	/**
+	* @brief	Batches every upload of a frame into a single command buffer instead of submitting and
+	*			waiting for each one. Data is copied into a persistently mapped staging ring and the
+	*			batch is submitted once per frame (@see VulkanApp::Update), on the dedicated transfer
+	*			queue if the device has one. Ownership of the resources is then handed to the graphics
+	*			queue, which also does anything a transfer queue can't (like mip map blits).
+	*
+	*			Any resource that was uploaded before a frame is submitted can be used in that frame,
+	*			queue ordering takes care of the rest. Batches are tracked with a fence so that the
+	*			staging space can be reused, the CPU only ever waits if the ring is full.
+	*
+	* @note		Submission happens on the render thread, recording uploads is thread safe.
+	*/
+	class UploadManager : public NonCopyable
+	{
+	public:
+
+		/**
+		* @param t_Dev			The logical device to upload with
+		* @param t_StagingSize	Size of the staging ring in bytes. Larger uploads get their own staging buffer
+		*/
+		UploadManager(const LogicalDevice* t_Dev, VkDeviceSize t_StagingSize);
+
+		/** Waits for all batches to complete */
+		~UploadManager();
+
+		/**
+		* @brief	Copy data into a device local buffer. The buffer needs VK_BUFFER_USAGE_TRANSFER_DST_BIT
+		*
+		* @param t_Dst			Buffer to copy into
+		* @param t_Data			Data to copy, it is copied to staging memory before this returns
+		* @param t_Size			Size of the data in bytes
+		* @param t_DstOffset	Offset into the destination buffer
+		*/
+		UploadTicket UploadBuffer(const Buffer* t_Dst, const void* t_Data, VkDeviceSize t_Size, VkDeviceSize t_DstOffset = 0);
+
+		/**
+		* @brief	Copy data into an image and transition it to its final layout. The image is expected
+		*			to be in VK_IMAGE_LAYOUT_UNDEFINED and needs TRANSFER_DST usage (and TRANSFER_SRC if
+		*			generating mips)
+		*/
+		UploadTicket UploadImage(const ImageUpload& t_Desc, const void* t_Data, VkDeviceSize t_Size);
+
+		/**
+		* @brief	Copy regions of one device local buffer to another, after every upload that is already
+		*			in the batch. Both buffers have to be owned by the graphics queue, which does the copy.
+		*			t_Src needs TRANSFER_SRC usage and t_Dst needs TRANSFER_DST usage
+		*/
+		UploadTicket CopyBuffer(const Buffer* t_Src, const Buffer* t_Dst, const std::vector<VkBufferCopy>& t_Regions);
+
+		/** Submit the batch that is being recorded, if it has any work in it. Render thread only */
+		void Submit();
+
+		/** Retire any batches that the GPU has finished with, freeing their staging space */
+		void Update();
+
+		/** True if the batch of the given ticket has finished executing on the GPU */
+		bool IsComplete(UploadTicket t_Ticket) const;
+
+		/** Block until the given upload is complete, submitting it if needed. Render thread only */
+		void Wait(UploadTicket t_Ticket);
+
+		/** Submit and wait for every upload. Render thread only */
+		void WaitIdle();
+
+		FORCEINLINE bool UsesTransferQueue() const { return m_UseTransferQueue; }
+
+		FORCEINLINE VkDeviceSize GetStagingSize() const { return m_StagingSize; }
+
+		/** Number of batches submitted since startup */
+		FORCEINLINE uint64 GetSubmittedBatchCount() const { return m_SubmittedBatchCount; }
+
+	private:
+
+		/** A command buffer worth of uploads that is submitted together */
+		struct UploadBatch
+		{
+			/** Copies. The same as GraphicsCmd if there is no dedicated transfer queue */
+			VkCommandBuffer TransferCmd = VK_NULL_HANDLE;
+
+			/** Ownership acquires and mip generation */
+			VkCommandBuffer GraphicsCmd = VK_NULL_HANDLE;
+
+			/** Signaled by the transfer queue for the graphics queue to wait on */
+			VkSemaphore TransferComplete = VK_NULL_HANDLE;
+
+			/** Signaled once the whole batch is done */
+			VkFence Fence = VK_NULL_HANDLE;
+
+			UploadTicket Ticket = 0;
+
+			/** Where the staging ring head was when this batch was last used */
+			uint64 StagingEnd = 0;
+
+			/** Staging buffers for uploads that did not fit in the ring */
+			std::vector<std::unique_ptr<Buffer>> LargeStagingBuffers;
+
+			bool IsRecording = false;
+
+			bool IsSubmitted = false;
+		};
+
+		/** Make sure the current batch is recording and return it */
+		UploadBatch& BeginBatch();
+
+		/**
+		* Get a staging region for the given size. Can wait on older batches if the ring is full
+		*
+		* @param t_OutBuffer	Buffer that the region is in
+		* @param t_OutOffset	Offset of the region in t_OutBuffer
+		* @return				Mapped pointer to the region
+		*/
+		void* AllocateStaging(VkDeviceSize t_Size, VkBuffer& t_OutBuffer, VkDeviceSize& t_OutOffset);
+
+		/** Record the blits to fill in every mip past 0. Leaves the whole image in t_Desc.FinalLayout */
+		void RecordMipChain(VkCommandBuffer t_Cmd, const ImageUpload& t_Desc);
+
+		void SubmitLocked();
+
+		/** Wait for the oldest submitted batch to complete. Returns false if nothing was submitted */
+		bool WaitOldestLocked();
+
+		void RetireLocked(UploadBatch& t_Batch);
+
+		const LogicalDevice* m_Device = nullptr;
+
+		/** Copy on the dedicated transfer queue and hand ownership to the graphics queue */
+		bool m_UseTransferQueue = false;
+
+		VkCommandPool m_GraphicsPool = VK_NULL_HANDLE;
+
+		VkCommandPool m_TransferPool = VK_NULL_HANDLE;
+
+		/** Batches are used round robin, so the next batch is always the oldest one */
+		std::vector<UploadBatch> m_Batches;
+
+		uint32 m_CurrentBatch = 0;
+
+		/** Persistently mapped, host coherent staging ring */
+		Buffer* m_StagingBuffer = nullptr;
+
+		VkDeviceSize m_StagingSize = 0;
+
+		VkDeviceSize m_StagingAlignment = 16;
+
+		/**
+		* Ever increasing head and tail positions of the ring. The offset in the buffer is the
+		* position modulo the ring size
+		*/
+		uint64 m_StagingHead = 0;
+
+		uint64 m_StagingTail = 0;
+
+		UploadTicket m_NextTicket = 1;
+
+		UploadTicket m_CompletedTicket = 0;
+
+		uint64 m_SubmittedBatchCount = 0;
+
+		mutable std::mutex m_Mutex;
+	};
+}   // namespace Fling
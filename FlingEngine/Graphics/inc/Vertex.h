@@ -67,6 +67,43 @@ namespace Fling
         }
 
     };
+
+	/**
+	* Per instance data of an instanced draw, read from vertex binding 1. @see OffscreenSubpass
+	*/
+	struct InstanceData
+	{
+		glm::mat4 Model { 1.0f };
+
+		/**
+		 * @brief	Gets the shader binding of an instance
+		 */
+		static VkVertexInputBindingDescription GetBindingDescription()
+		{
+			VkVertexInputBindingDescription bindingDescription = {};
+			bindingDescription.binding = 1;
+			bindingDescription.stride = sizeof(InstanceData);
+			bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+			return bindingDescription;
+		}
+
+		/** A mat4 is passed as four vec4 columns, starting after the Vertex attributes */
+		static std::array<VkVertexInputAttributeDescription, 4> GetAttributeDescriptions()
+		{
+			std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions = {};
+
+			for (uint32 i = 0; i < 4; ++i)
+			{
+				attributeDescriptions[i].binding = 1;
+				attributeDescriptions[i].location = 5 + i;
+				attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+				attributeDescriptions[i].offset = offsetof(InstanceData, Model) + sizeof(glm::vec4) * i;
+			}
+
+			return attributeDescriptions;
+		}
+	};
 }   // namespace Fling
 
 // Hash function for a vertex so that we can put thing std::maps and what not
@@ -31,6 +31,13 @@ namespace Fling
 	class FirstPersonCamera;
 	class DepthBuffer;
 	class BaseEditor;
+	class DeviceMemoryAllocator;
+	class UploadManager;
+	class MeshArena;
+	class BindlessTextures;
+	class DescriptorAllocator;
+	class GpuProfiler;
+	class SpatialTree;
 
 	/**
 	* @brief	Core rendering functionality of the Fling Engine. Controls what Render pipelines 
@@ -62,6 +69,37 @@ namespace Fling
 		inline FirstPersonCamera* GetCamera() const { return m_Camera; }
 		inline VkRenderPass GetGlobalRenderPass() const { return m_RenderPass; }
 
+		/** All buffers and images should get their device memory from here. @see DeviceMemoryAllocator */
+		inline DeviceMemoryAllocator* GetMemoryAllocator() const { return m_MemoryAllocator; }
+
+		/** Uploads to device local buffers and images should be recorded here. @see UploadManager */
+		inline UploadManager* GetUploadManager() const { return m_UploadManager; }
+
+		/** Vertices and indices of every model. @see MeshArena */
+		inline MeshArena* GetMeshArena() const { return m_MeshArena; }
+
+		/** Every descriptor set that isn't bindless is allocated out of this. @see DescriptorAllocator */
+		inline DescriptorAllocator* GetDescriptorAllocator() const { return m_DescriptorAllocator; }
+
+		/** Array that every texture is registered in. Null if the device doesn't have descriptor indexing. @see BindlessTextures */
+		inline BindlessTextures* GetBindlessTextures() const { return m_BindlessTextures; }
+
+		/** Times every subpass on the GPU. @see GpuProfiler */
+		inline GpuProfiler* GetGpuProfiler() const { return m_GpuProfiler; }
+
+		/** Bounds of the world's renderables, used to cull the scene. Null if there is no world yet. @see World::GetSpatialTree */
+		inline const SpatialTree* GetSpatialTree() const { return m_SpatialTree; }
+		inline void SetSpatialTree(const SpatialTree* t_Tree) { m_SpatialTree = t_Tree; }
+
+		/** Block until every upload and all submitted work is complete */
+		void WaitForIdle();
+
+		/** The number of frames that the CPU can record while the GPU is still working. Read from [Vulkan] FramesInFlight */
+		inline uint32 GetFramesInFlight() const { return m_FramesInFlight; }
+
+		/** Index of the frame in flight that is currently being recorded. Always less than GetFramesInFlight */
+		inline uint32 GetCurrentFrameIndex() const { return static_cast<uint32>(CurrentFrameIndex); }
+
 		/** Callback for when a window is resized and to what width and height */
 		void OnWindowResized(int Width, int Height);
 
@@ -134,14 +172,24 @@ namespace Fling
 		// Stages that the swap chain needs to wait on in order to present
 		VkPipelineStageFlags m_WaitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 
-		/** Keep a vector of command buffers that we want to use so that we can have one for each active frame */
+		/** Keep a vector of command buffers that we want to use so that we can have one for each frame in flight */
 		std::vector<CommandBuffer*> m_DrawCmdBuffers;
 
+		/** The draw command buffer of each frame in flight is allocated from its own pool, which is reset once per frame */
+		std::vector<VkCommandPool> m_FrameCommandPools;
+
 		/** Synchronization primitives for drawing the frame. @see VulkanApp::CreateFrameSyncResources */
 		std::vector<VkSemaphore> m_PresentCompleteSemaphores;
 		std::vector<VkSemaphore> m_RenderFinishedSemaphores;
 		std::vector<VkFence> m_InFlightFences;
 
+		/** The in flight fence that last rendered to each swap chain image, so that we don't render 
+		to an image that an older frame is still using */
+		std::vector<VkFence> m_ImagesInFlight;
+
+		/** How many frames can be recorded before we have to wait for the GPU. @see VkConfig */
+		uint32 m_FramesInFlight = VkConfig::DEFAULT_FRAMES_IN_FLIGHT;
+
 		/** Handle to the surface extension used to interact with the windows system */
 		VkSurfaceKHR m_Surface = VK_NULL_HANDLE;
 		
@@ -157,6 +205,25 @@ namespace Fling
 		/** The Vulkan app will specify the current camera and be limited to one for now */
 		FirstPersonCamera* m_Camera = nullptr;
 
-		// #TODO VMA Allocator
+		/** Sub-allocates device memory for every buffer and image. Created right after the logical device */
+		DeviceMemoryAllocator* m_MemoryAllocator = nullptr;
+
+		/** Batches staging copies, submitted once per frame before the frame's own work */
+		UploadManager* m_UploadManager = nullptr;
+
+		/** Uploads through the upload manager, so it is created right after it */
+		MeshArena* m_MeshArena = nullptr;
+
+		/** Created with the device so that every subpass can allocate sets out of it */
+		DescriptorAllocator* m_DescriptorAllocator = nullptr;
+
+		/** Only created if [Vulkan] BindlessTextures is on and the device supports it */
+		BindlessTextures* m_BindlessTextures = nullptr;
+
+		/** Has query pools for each frame in flight, so it is created once the frame count is known */
+		GpuProfiler* m_GpuProfiler = nullptr;
+
+		/** Owned by the world, which the engine sets once it is created */
+		const SpatialTree* m_SpatialTree = nullptr;
     };
 }   // namespace Fling
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "pch.h"
+#include "BindlessTextures.h"
+#include "LogicalDevice.h"
+#include "PhyscialDevice.h"
+#include "GraphicsHelpers.h"
+
+#include <algorithm>
+
+namespace Fling
+{
+	BindlessTextures::BindlessTextures(const LogicalDevice* t_Dev, uint32 t_Capacity)
+		: m_Device(t_Dev)
+	{
+		assert(m_Device && m_Device->IsDescriptorIndexingEnabled());
+
+		// Every texture is a sampled image and a sampler, and the whole array is visible to the fragment stage
+		const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& Props = m_Device->GetPhysicalDevice()->GetDescriptorIndexingProps();
+		const uint32 DeviceLimit = std::min({
+			Props.maxDescriptorSetUpdateAfterBindSampledImages,
+			Props.maxDescriptorSetUpdateAfterBindSamplers,
+			Props.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			Props.maxPerStageDescriptorUpdateAfterBindSamplers });
+
+		m_Capacity = std::max(std::min(t_Capacity, DeviceLimit), 1u);
+		if (m_Capacity < t_Capacity)
+		{
+			F_LOG_WARN("Bindless texture capacity of {} is more than the device supports! Using {}", t_Capacity, m_Capacity);
+		}
+
+		VkDescriptorSetLayoutBinding Binding = {};
+		Binding.binding = TEXTURE_BINDING;
+		Binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		Binding.descriptorCount = m_Capacity;
+		Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		// Slots are written while frames that read other slots are in flight, and unused ones are never written
+		const VkDescriptorBindingFlagsEXT BindingFlags =
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT BindingFlagsInfo = {};
+		BindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		BindingFlagsInfo.bindingCount = 1;
+		BindingFlagsInfo.pBindingFlags = &BindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo LayoutInfo = {};
+		LayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		LayoutInfo.pNext = &BindingFlagsInfo;
+		LayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		LayoutInfo.bindingCount = 1;
+		LayoutInfo.pBindings = &Binding;
+
+		if (vkCreateDescriptorSetLayout(m_Device->GetVkDevice(), &LayoutInfo, nullptr, &m_SetLayout) != VK_SUCCESS)
+		{
+			F_LOG_FATAL("Failed to create the bindless texture set layout!");
+		}
+
+		VkDescriptorPoolSize PoolSize = Initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_Capacity);
+
+		VkDescriptorPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		PoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		PoolInfo.maxSets = 1;
+		PoolInfo.poolSizeCount = 1;
+		PoolInfo.pPoolSizes = &PoolSize;
+
+		if (vkCreateDescriptorPool(m_Device->GetVkDevice(), &PoolInfo, nullptr, &m_Pool) != VK_SUCCESS)
+		{
+			F_LOG_FATAL("Failed to create the bindless texture descriptor pool!");
+		}
+
+		VkDescriptorSetAllocateInfo AllocInfo = Initializers::DescriptorSetAllocateInfo(m_Pool, &m_SetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(m_Device->GetVkDevice(), &AllocInfo, &m_Set));
+
+		F_LOG_TRACE("Bindless texture array created with {} slots", m_Capacity);
+	}
+
+	BindlessTextures::~BindlessTextures()
+	{
+		if (m_Count > 0)
+		{
+			F_LOG_WARN("Bindless textures destroyed with {} textures still registered!", m_Count);
+		}
+
+		// The set is freed along with its pool
+		vkDestroyDescriptorPool(m_Device->GetVkDevice(), m_Pool, nullptr);
+		vkDestroyDescriptorSetLayout(m_Device->GetVkDevice(), m_SetLayout, nullptr);
+	}
+
+	uint32 BindlessTextures::Register(const VkDescriptorImageInfo& t_Image)
+	{
+		uint32 Slot = INVALID_SLOT;
+		if (!m_FreeSlots.empty())
+		{
+			Slot = m_FreeSlots.back();
+			m_FreeSlots.pop_back();
+		}
+		else if (m_NextSlot < m_Capacity)
+		{
+			Slot = m_NextSlot++;
+		}
+		else
+		{
+			if (!m_HasLoggedFull)
+			{
+				F_LOG_WARN("Bindless texture array is full ({} textures)! Increase [Vulkan] BindlessTextureCapacity", m_Capacity);
+				m_HasLoggedFull = true;
+			}
+			return INVALID_SLOT;
+		}
+
+		VkWriteDescriptorSet Write = {};
+		Write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		Write.dstSet = m_Set;
+		Write.dstBinding = TEXTURE_BINDING;
+		Write.dstArrayElement = Slot;
+		Write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		Write.descriptorCount = 1;
+		Write.pImageInfo = &t_Image;
+		vkUpdateDescriptorSets(m_Device->GetVkDevice(), 1, &Write, 0, nullptr);
+
+		++m_Count;
+		return Slot;
+	}
+
+	void BindlessTextures::Unregister(uint32 t_Slot)
+	{
+		if (t_Slot == INVALID_SLOT || t_Slot >= m_NextSlot)
+		{
+			return;
+		}
+
+		// The old descriptor stays in the slot until it is reused, which partially bound allows as long as it isn't read
+		assert(std::find(m_FreeSlots.begin(), m_FreeSlots.end(), t_Slot) == m_FreeSlots.end());
+		m_FreeSlots.emplace_back(t_Slot);
+		--m_Count;
+	}
+}   // namespace Fling
@@ -10,7 +10,7 @@ namespace Fling
     Buffer::Buffer(const VkDeviceSize& size, const VkBufferUsageFlags& t_Usage, const VkMemoryPropertyFlags& t_Properties, const void* t_Data)
 		: m_Size(size)
 		, m_Buffer(VK_NULL_HANDLE)
-		, m_BufferMemory(VK_NULL_HANDLE)
+		, m_Allocation{}
 	{
 		CreateBuffer(m_Size, t_Usage, t_Properties, false, t_Data);
 
@@ -27,7 +27,7 @@ namespace Fling
 			m_MappedMem = t_Other.m_MappedMem;
 			m_Size = t_Other.m_Size;
 			m_Buffer = t_Other.m_Buffer;
-			m_BufferMemory = t_Other.m_BufferMemory;
+			m_Allocation = t_Other.m_Allocation;
 			m_Descriptor = t_Other.m_Descriptor;
 		}
 	}
@@ -44,20 +44,26 @@ namespace Fling
 
 	VkResult Buffer::MapMemory(VkDeviceSize t_Size, VkDeviceSize t_Offset)
 	{
-		LogicalDevice* Dev = VulkanApp::Get().GetLogicalDevice();
-		assert(Dev);
-		VkDevice Device = Dev->GetVkDevice();
-		return vkMapMemory(Device, m_BufferMemory, t_Offset, t_Size, 0, &m_MappedMem);
+		// The block that this buffer lives in is already mapped, other resources share it
+		// so we can't call vkMapMemory on it
+		if (!m_Allocation.MappedData)
+		{
+			F_LOG_ERROR("Tried to map a buffer that is not host visible!");
+			return VK_ERROR_MEMORY_MAP_FAILED;
+		}
+
+		m_MappedMem = static_cast<char*>(m_Allocation.MappedData) + t_Offset;
+		return VK_SUCCESS;
 	}
 
 	void Buffer::UnmapMemory()
 	{
 		if (m_MappedMem)
 		{
-			LogicalDevice* Dev = VulkanApp::Get().GetLogicalDevice();
-			assert(Dev);
-			VkDevice Device = Dev->GetVkDevice();			
-			vkUnmapMemory(Device, m_BufferMemory);
+			// Make sure any writes are visible before we give up the pointer
+			DeviceMemoryAllocator* Allocator = VulkanApp::Get().GetMemoryAllocator();
+			assert(Allocator);
+			Allocator->Flush(m_Allocation);
 			m_MappedMem = nullptr;
 		}
 	}
@@ -73,9 +79,8 @@ namespace Fling
 		assert(Dev);
 		VkDevice Device = Dev->GetVkDevice();
 
-		PhysicalDevice* Phys = VulkanApp::Get().GetPhysicalDevice();
-		assert(Phys);
-		VkPhysicalDevice PhysicalDevice = Phys->GetVkPhysicalDevice();
+		DeviceMemoryAllocator* Allocator = VulkanApp::Get().GetMemoryAllocator();
+		assert(Allocator);
 
 		VkBufferCreateInfo bufferInfo = {};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -88,49 +93,24 @@ namespace Fling
 			F_LOG_FATAL("Failed to create buffer!");
 		}
 		m_Size = t_size;
-		//Get the memory requirements
-		VkMemoryRequirements MemRequirments = {};
-		vkGetBufferMemoryRequirements(Device, m_Buffer, &MemRequirments);
-
-		VkMemoryAllocateInfo AllocInfo = {};
-		AllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		AllocInfo.allocationSize = MemRequirments.size;
-		//Using VK_MEMORY_PROPERTY_HOST_COHERENT_BIT may cause worse perf,
-		//we could use explicit flushing with vkFlushMappedMemoryRanges
-		AllocInfo.memoryTypeIndex = GraphicsHelpers::FindMemoryType(PhysicalDevice, MemRequirments.memoryTypeBits, t_Properties);
-
-		//Allocate the vertex buffer memory
-		if (vkAllocateMemory(Device, &AllocInfo, nullptr, &m_BufferMemory) != VK_SUCCESS)
-		{
-			F_LOG_FATAL("Failed to alocate buffer memory!");
-		}
+
+		// Sub-allocate and bind the memory for this buffer
+		m_Allocation = Allocator->AllocateForBuffer(m_Buffer, t_Properties, DeviceMemoryAllocator::GetBufferCategory(t_Usage, t_Properties));
 
 		//Map this buffer and copy the data to the given data pointer if one was specified
 		if (t_Data)
 		{
-			MapMemory();
+			VK_CHECK_RESULT(MapMemory());
 			memcpy(m_MappedMem, t_Data, m_Size);
 
-			if ((t_Properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
-			{
-				VkMappedMemoryRange MappedRange{};
-				MappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-				MappedRange.memory = m_BufferMemory;
-				MappedRange.offset = 0;
-				MappedRange.size = m_Size;
-				vkFlushMappedMemoryRanges(Device, 1, &MappedRange);
-			}
+			// Does nothing for HOST_COHERENT memory
+			Allocator->Flush(m_Allocation, 0, m_Size);
 
 			if (t_unmapBuffer)
 			{
 				UnmapMemory();
 			}
 		}
-
-		if ((vkBindBufferMemory(Device, m_Buffer, m_BufferMemory, 0) != VK_SUCCESS))
-		{
-			F_LOG_FATAL("Failed to bind buffer memory!");
-		}
 	}
 	
 	void Buffer::CopyBuffer(Buffer* t_SrcBuffer, Buffer* t_DstBuffer, VkDeviceSize t_Size)
@@ -151,19 +131,9 @@ namespace Fling
 
 	void Buffer::Flush(VkDeviceSize t_size, VkDeviceSize t_offset)
 	{
-		LogicalDevice* Dev = VulkanApp::Get().GetLogicalDevice();
-		assert(Dev);
-		VkDevice LogicalDevice = Dev->GetVkDevice();
-
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = m_BufferMemory;
-		mappedRange.offset = t_offset;
-		mappedRange.size = t_size;
-		if (vkFlushMappedMemoryRanges(LogicalDevice, 1, &mappedRange) != VK_SUCCESS)
-		{
-			F_LOG_ERROR("Mapped buffer could not flush memory");
-		}
+		DeviceMemoryAllocator* Allocator = VulkanApp::Get().GetMemoryAllocator();
+		assert(Allocator);
+		Allocator->Flush(m_Allocation, t_offset, t_size);
 	}
 
 	void Buffer::Release()
@@ -180,10 +150,11 @@ namespace Fling
 			m_Buffer = nullptr;
 		}
 
-		if(m_BufferMemory)
+		if (m_Allocation.IsValid())
 		{
-			vkFreeMemory(Device, m_BufferMemory, nullptr);
-			m_BufferMemory = nullptr;
+			DeviceMemoryAllocator* Allocator = VulkanApp::Get().GetMemoryAllocator();
+			assert(Allocator);
+			Allocator->Free(m_Allocation);
 		}
 	}
 
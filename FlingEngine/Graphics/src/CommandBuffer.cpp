@@ -6,16 +6,17 @@
 
 namespace Fling
 {
-	CommandBuffer::CommandBuffer(const LogicalDevice* t_Device, VkCommandPool t_CmdPool)
+	CommandBuffer::CommandBuffer(const LogicalDevice* t_Device, VkCommandPool t_CmdPool, VkCommandBufferLevel t_Level)
 		: m_Device(t_Device)
 		, m_Pool(t_CmdPool)
+		, m_Level(t_Level)
 	{
 		assert(m_Device);
 		VkCommandBufferAllocateInfo allocate_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
 
 		allocate_info.commandPool = m_Pool;
 		allocate_info.commandBufferCount = 1;
-		allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocate_info.level = m_Level;
 
 		VkResult result = vkAllocateCommandBuffers(m_Device->GetVkDevice(), &allocate_info, &m_Handle);
 
@@ -48,7 +49,26 @@ namespace Fling
 		VK_CHECK_RESULT(vkBeginCommandBuffer(GetHandle(), &beginInfo));
 	}
 
-	void CommandBuffer::BeginRenderPass(const FrameBuffer& t_frameBuf, const std::vector<VkClearValue>& t_ClearVales)
+	void CommandBuffer::BeginSecondary(const FrameBuffer& t_frameBuf, uint32 t_Subpass, VkQueryPipelineStatisticFlags t_InheritedStatistics)
+	{
+		assert(!IsRecording());
+		assert(m_Level == VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+		m_State = State::Recording;
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+		inheritanceInfo.renderPass = t_frameBuf.GetRenderPassHandle();
+		inheritanceInfo.subpass = t_Subpass;
+		inheritanceInfo.framebuffer = t_frameBuf.GetHandle();
+		inheritanceInfo.pipelineStatistics = t_InheritedStatistics;
+
+		VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(GetHandle(), &beginInfo));
+	}
+
+	void CommandBuffer::BeginRenderPass(const FrameBuffer& t_frameBuf, const std::vector<VkClearValue>& t_ClearVales, VkSubpassContents t_Contents)
 	{
 		VkRenderPassBeginInfo begin_info{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
 		// Frame buf info
@@ -64,7 +84,7 @@ namespace Fling
 		begin_info.clearValueCount = to_u32(t_ClearVales.size());
 		begin_info.pClearValues = t_ClearVales.data();
 
-		vkCmdBeginRenderPass(GetHandle(), &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(GetHandle(), &begin_info, t_Contents);
 	}
 
 	void CommandBuffer::NextSubpass()
@@ -94,6 +114,16 @@ namespace Fling
 		vkCmdEndRenderPass(GetHandle());
 	}
 
+	void CommandBuffer::ExecuteCommands(const std::vector<VkCommandBuffer>& t_Secondaries)
+	{
+		assert(m_Level == VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+		if (!t_Secondaries.empty())
+		{
+			vkCmdExecuteCommands(GetHandle(), to_u32(t_Secondaries.size()), t_Secondaries.data());
+		}
+	}
+
 	void CommandBuffer::End()
 	{
 		assert(IsRecording() && "Command buffer is not recording, please call begin before end");
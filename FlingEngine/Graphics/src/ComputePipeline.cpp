@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "ComputePipeline.h"
+
+namespace Fling
+{
+    ComputePipeline::ComputePipeline(Shader* t_Shader, VkDevice t_LogicalDevice, uint32 t_PushConstantSize)
+        : m_Shader(t_Shader)
+        , m_Device(t_LogicalDevice)
+    {
+        assert(m_Shader && m_Shader->GetStage() == VK_SHADER_STAGE_COMPUTE_BIT);
+
+        std::vector<Shader*> Shaders = { m_Shader };
+        m_DescriptorSetLayout = Shader::CreateSetLayout(m_Device, Shaders);
+        m_PipelineLayout = Shader::CreatePipelineLayout(
+            m_Device,
+            m_DescriptorSetLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            m_Shader->UsesPushConstants() ? t_PushConstantSize : 0);
+
+        VkPipelineShaderStageCreateInfo StageInfo = {};
+        StageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        StageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        StageInfo.module = m_Shader->GetShaderModule();
+        StageInfo.pName = "main";
+
+        VkComputePipelineCreateInfo CreateInfo = {};
+        CreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        CreateInfo.stage = StageInfo;
+        CreateInfo.layout = m_PipelineLayout;
+
+        if (vkCreateComputePipelines(m_Device, VK_NULL_HANDLE, 1, &CreateInfo, nullptr, &m_Pipeline) != VK_SUCCESS)
+        {
+            F_LOG_FATAL("Failed to create compute pipeline");
+        }
+    }
+
+    void ComputePipeline::Bind(VkCommandBuffer t_CommandBuffer) const
+    {
+        vkCmdBindPipeline(t_CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+    }
+
+    void ComputePipeline::Dispatch(VkCommandBuffer t_CommandBuffer, uint32 t_X, uint32 t_Y, uint32 t_Z) const
+    {
+        const uint32 SizeX = std::max(m_Shader->GetLocalSizeX(), 1u);
+        const uint32 SizeY = std::max(m_Shader->GetLocalSizeY(), 1u);
+        const uint32 SizeZ = std::max(m_Shader->GetLocalSizeZ(), 1u);
+
+        vkCmdDispatch(
+            t_CommandBuffer,
+            (t_X + SizeX - 1) / SizeX,
+            (t_Y + SizeY - 1) / SizeY,
+            (t_Z + SizeZ - 1) / SizeZ);
+    }
+
+    ComputePipeline::~ComputePipeline()
+    {
+        vkDestroyPipeline(m_Device, m_Pipeline, nullptr);
+        vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(m_Device, m_DescriptorSetLayout, nullptr);
+    }
+}   // namespace Fling
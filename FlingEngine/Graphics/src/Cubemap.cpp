@@ -5,6 +5,7 @@
 #include "PhyscialDevice.h"
 #include "HDRImage.h"
 #include "VulkanApp.h"
+#include "UploadManager.h"
 
 namespace Fling
 {
@@ -44,10 +45,11 @@ namespace Fling
 
     Cubemap::~Cubemap()
     {
-        if (m_ImageMemory)
+        if (m_ImageMemory.IsValid())
         {
-            vkFreeMemory(m_Device->GetVkDevice(), m_ImageMemory, nullptr);
-            m_ImageMemory = nullptr;
+            DeviceMemoryAllocator* Allocator = VulkanApp::Get().GetMemoryAllocator();
+            assert(Allocator);
+            Allocator->Free(m_ImageMemory);
         }
 
         delete m_GraphicsPipeline;
@@ -111,17 +113,6 @@ namespace Fling
         //m_MipLevels = 1.0f;
         m_Format = image->GetVkImageFormat();
 
-        std::unique_ptr<Buffer> stagingBuffer = std::make_unique<Buffer>();
-        stagingBuffer->CreateBuffer(m_ImageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_SHARING_MODE_EXCLUSIVE, true);
-        stagingBuffer->MapMemory();
-
-        float* pixelDst = (float*)(stagingBuffer->m_MappedMem);
-        const float* pixels = image->GetPixelData();
-        memcpy(pixelDst, pixels, m_ImageSize);
-
-        stagingBuffer->UnmapMemory();
-
-
         GraphicsHelpers::CreateVkImage(
 			m_Device->GetVkDevice(),
             image->GetWidth(),
@@ -137,12 +128,16 @@ namespace Fling
             m_Image,
             m_ImageMemory);
 
-        VkCommandBuffer copyCmd = GraphicsHelpers::BeginSingleTimeCommands();
+        // Every face reads from the start of the image, there is only one image worth of data
+        ImageUpload Upload = {};
+        Upload.Image = m_Image;
+        Upload.Format = m_Format;
+        Upload.Width = image->GetWidth();
+        Upload.Height = image->GetHeight();
+        Upload.MipLevels = m_MipLevels;
+        Upload.ArrayLayers = 6;
 
-        std::vector< VkBufferImageCopy> bufferCopyRegions;
-        VkDeviceSize offset = 0;
-
-        for (size_t face = 0; face < 6; face++)
+        for (uint32 face = 0; face < 6; face++)
         {
             VkBufferImageCopy bufferCopyRegion = {};
             bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -152,53 +147,16 @@ namespace Fling
             bufferCopyRegion.imageExtent.width = image->GetWidth();
             bufferCopyRegion.imageExtent.height = image->GetHeight();
             bufferCopyRegion.imageExtent.depth = 1;
-            bufferCopyRegion.bufferOffset = offset;
+            bufferCopyRegion.bufferOffset = 0;
 
-            bufferCopyRegions.push_back(bufferCopyRegion);
-
-            // Increase offset into staging buffer for next level / face
-            offset += image->GetImageSize();
+            Upload.Regions.push_back(bufferCopyRegion);
         }
 
-        // Image barrier for optimal image (target)
-        // Set initial layout for all array layers (faces) of the optimal (target) tiled texture
-        VkImageSubresourceRange subresourceRange = {};
-        subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        subresourceRange.baseMipLevel = 0;
-        subresourceRange.levelCount = m_MipLevels;
-        subresourceRange.layerCount = 6;
-
-        GraphicsHelpers::SetImageLayout(
-            copyCmd,
-            m_Image,
-            VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            subresourceRange,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
-
-        // Copy the cube map faces from the staging buffer to the optimal tiled image
-        vkCmdCopyBufferToImage(
-            copyCmd,
-            stagingBuffer->GetVkBuffer(),
-            m_Image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            static_cast<uint32_t>(bufferCopyRegions.size()),
-            bufferCopyRegions.data()
-        );
-
-        // Change texture image layout to shader read after all faces have been copied
+        // All faces end up in shader read once the upload batch is done
         m_ImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        GraphicsHelpers::SetImageLayout(
-            copyCmd,
-            m_Image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            m_ImageLayout,
-            subresourceRange,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        Upload.FinalLayout = m_ImageLayout;
 
-        GraphicsHelpers::EndSingleTimeCommands(copyCmd);
+        VulkanApp::Get().GetUploadManager()->UploadImage(Upload, image->GetPixelData(), m_ImageSize);
 
         // Create sampler
         VkSamplerCreateInfo sampler = Initializers::SamplerCreateInfo();
@@ -250,42 +208,51 @@ namespace Fling
         Guid t_PosZ_ID, 
         Guid t_NegZ_ID)
     {
-        std::array<std::shared_ptr<Texture>, 6> images =
+        // Only the pixels are needed, so decode the faces instead of loading each as its own texture
+        std::array<std::unique_ptr<Texture::LoadData>, 6> images =
         {
-            ResourceManager::LoadResource<Texture>(t_PosX_ID),
-            ResourceManager::LoadResource<Texture>(t_NegX_ID),
-            ResourceManager::LoadResource<Texture>(t_PosY_ID),
-            ResourceManager::LoadResource<Texture>(t_NegY_ID),
-            ResourceManager::LoadResource<Texture>(t_PosZ_ID),
-            ResourceManager::LoadResource<Texture>(t_NegZ_ID),
+            Texture::Decode(t_PosX_ID),
+            Texture::Decode(t_NegX_ID),
+            Texture::Decode(t_PosY_ID),
+            Texture::Decode(t_NegY_ID),
+            Texture::Decode(t_PosZ_ID),
+            Texture::Decode(t_NegZ_ID),
         };
 
-        m_ImageSize = images[0]->GetImageSize() * 6;
-        m_NumChannels = images[0]->GetChannels();
-        m_LayerSize = m_ImageSize / 6;
-        //TODO: add mip levels to image
-        m_MipLevels = images[0]->GetMipLevels();
-        m_Format = images[0]->GetVkImageFormat();
+        for (const std::unique_ptr<Texture::LoadData>& image : images)
+        {
+            if (!image->Pixels || image->Width != images[0]->Width || image->Height != images[0]->Height)
+            {
+                F_LOG_ERROR("Cubemap faces must all be loaded and be the same size!");
+                return;
+            }
+        }
 
+        const uint32 FaceWidth = static_cast<uint32>(images[0]->Width);
+        const uint32 FaceHeight = static_cast<uint32>(images[0]->Height);
+
+        // Faces are always decoded as RGBA
+        m_LayerSize = static_cast<VkDeviceSize>(FaceWidth) * FaceHeight * 4;
+        m_ImageSize = m_LayerSize * 6;
+        m_NumChannels = static_cast<uint32>(images[0]->Channels);
+        //TODO: add mip levels to image
+        m_MipLevels = Texture::CalculateMipLevels(FaceWidth, FaceHeight);
+        m_Format = VK_FORMAT_R8G8B8A8_UNORM;
 
-        std::unique_ptr<Buffer> stagingBuffer = std::make_unique<Buffer>();
-        stagingBuffer->CreateBuffer(m_ImageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_SHARING_MODE_EXCLUSIVE, true);
-        stagingBuffer->MapMemory();
 
-        stbi_uc* pixelDst = (stbi_uc*)(stagingBuffer->m_MappedMem);
+        // The upload wants all of the faces in one place
+        std::vector<stbi_uc> pixels(static_cast<size_t>(m_ImageSize));
+        stbi_uc* pixelDst = pixels.data();
         for (size_t i = 0; i < 6; i++)
         {
-            const stbi_uc* pixels = images[i]->GetPixelData();
-            memcpy(pixelDst, pixels, m_LayerSize);
+            memcpy(pixelDst, images[i]->Pixels, m_LayerSize);
             pixelDst += m_LayerSize;
         }
 
-        stagingBuffer->UnmapMemory();
-
         GraphicsHelpers::CreateVkImage(
 			m_Device->GetVkDevice(),
-            images[0]->GetWidth(),
-            images[0]->GetHeight(),
+            FaceWidth,
+            FaceHeight,
             m_MipLevels, // MipLevels
             1, // Depth
             6, // Array layers
@@ -297,68 +264,38 @@ namespace Fling
             m_Image,
             m_ImageMemory);
 
-        VkCommandBuffer copyCmd = GraphicsHelpers::BeginSingleTimeCommands();
+        ImageUpload Upload = {};
+        Upload.Image = m_Image;
+        Upload.Format = m_Format;
+        Upload.Width = FaceWidth;
+        Upload.Height = FaceHeight;
+        Upload.MipLevels = m_MipLevels;
+        Upload.ArrayLayers = 6;
 
-        std::vector< VkBufferImageCopy> bufferCopyRegions;
         VkDeviceSize offset = 0;
-
-        for (size_t face = 0; face < 6; face++)
+        for (uint32 face = 0; face < 6; face++)
         {
             VkBufferImageCopy bufferCopyRegion = {};
             bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             bufferCopyRegion.imageSubresource.mipLevel = 0;
             bufferCopyRegion.imageSubresource.baseArrayLayer = face;
             bufferCopyRegion.imageSubresource.layerCount = 1;
-            bufferCopyRegion.imageExtent.width = images[face]->GetWidth();
-            bufferCopyRegion.imageExtent.height = images[face]->GetHeight();
+            bufferCopyRegion.imageExtent.width = FaceWidth;
+            bufferCopyRegion.imageExtent.height = FaceHeight;
             bufferCopyRegion.imageExtent.depth = 1;
             bufferCopyRegion.bufferOffset = offset;
 
-            bufferCopyRegions.push_back(bufferCopyRegion);
+            Upload.Regions.push_back(bufferCopyRegion);
 
-            // Increase offset into staging buffer for next level / face
-            offset += images[face]->GetImageSize();
+            // Increase offset into the pixel data for the next face
+            offset += m_LayerSize;
         }
 
-        // Image barrier for optimal image (target)
-        // Set initial layout for all array layers (faces) of the optimal (target) tiled texture
-        VkImageSubresourceRange subresourceRange = {};
-        subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        subresourceRange.baseMipLevel = 0;
-        subresourceRange.levelCount = m_MipLevels;
-        subresourceRange.layerCount = 6;
-
-        GraphicsHelpers::SetImageLayout(
-            copyCmd,
-            m_Image,
-            VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            subresourceRange, 
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
-
-        // Copy the cube map faces from the staging buffer to the optimal tiled image
-        vkCmdCopyBufferToImage(
-            copyCmd,
-            stagingBuffer->GetVkBuffer(),
-            m_Image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            static_cast<uint32_t>(bufferCopyRegions.size()),
-            bufferCopyRegions.data()
-        );
-
-        // Change texture image layout to shader read after all faces have been copied
+        // All faces end up in shader read once the upload batch is done
         m_ImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        GraphicsHelpers::SetImageLayout(
-            copyCmd,
-            m_Image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            m_ImageLayout,
-            subresourceRange,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        Upload.FinalLayout = m_ImageLayout;
 
-        GraphicsHelpers::EndSingleTimeCommands(copyCmd);
+        VulkanApp::Get().GetUploadManager()->UploadImage(Upload, pixels.data(), m_ImageSize);
 
         // Create sampler
         VkSamplerCreateInfo sampler = Initializers::SamplerCreateInfo();
@@ -518,6 +455,6 @@ namespace Fling
         vkCmdBindVertexBuffers(t_CommandBuffer, 0, 1, &GetVertexBuffer()->GetVkBuffer(), offsets);
         vkCmdBindIndexBuffer(t_CommandBuffer, GetIndexBuffer()->GetVkBuffer(), 0, GetIndexType());
         vkCmdBindPipeline(t_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline->GetPipeline());
-        vkCmdDrawIndexed(t_CommandBuffer, GetIndexCount(), 1, 0, 0, 0);
+        vkCmdDrawIndexed(t_CommandBuffer, GetIndexCount(), 1, m_Cube->GetFirstIndex(), m_Cube->GetVertexOffset(), 0);
     }
 }
\ No newline at end of file
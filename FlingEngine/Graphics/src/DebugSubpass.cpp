@@ -10,9 +10,15 @@
 #include "UniformBufferObject.h"
 #include "FirstPersonCamera.h"
 #include "FlingVulkan.h"
+#include "VulkanApp.h"
+#include "UniformBufferRing.h"
+#include "DescriptorAllocator.h"
 
 #define FRAME_BUF_DIM 2048
 
+// Debug meshes are few and far between, so keep the ring small
+#define DEBUG_RING_BYTES_PER_FRAME (256 * 1024)
+
 namespace Fling
 {
 	DebugSubpass::DebugSubpass(
@@ -23,22 +29,26 @@ namespace Fling
 		FirstPersonCamera* t_Cam,
 		std::shared_ptr<Fling::Shader> t_Vert,
 		std::shared_ptr<Fling::Shader> t_Frag)
-		: Subpass(t_Dev, t_Swap, t_Vert, t_Frag)
+		: Subpass(t_Dev, t_Swap, t_Vert, t_Frag, /* Dynamic UBO at binding */ 1 << 0)
 		, m_GlobalRenderPass(t_GlobalRenderPass)
 		, m_Camera(t_Cam)
 	{
 		t_reg.on_construct<MeshRenderer>().connect<&DebugSubpass::OnMeshRendererAdded>(*this);
 
+		m_UniformRing = std::make_unique<UniformBufferRing>(m_Device, DEBUG_RING_BYTES_PER_FRAME, VulkanApp::Get().GetFramesInFlight());
+
 		PrepareAttachments();
 	}
 
 	DebugSubpass::~DebugSubpass()
 	{
-		
+		m_UniformRing.reset();
 	}
 
 	void DebugSubpass::Draw(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight, entt::registry& t_reg, float DeltaTime)
 	{
+		FLING_PROFILE_SCOPE("DebugSubpass::Draw");
+
 		// For every mesh bind it's model and descriptor set info
 		auto RenderGroup = t_reg.group<Transform>(entt::get<MeshRenderer, entt::tag<"Debug"_hs>>);
 
@@ -47,34 +57,33 @@ namespace Fling
 		m_Ubo.Projection[1][1] *= -1.0f;
 		VkDeviceSize offsets[1] = { 0 };
 
+		m_UniformRing->BeginFrame(t_ActiveFrameInFlight);
+
+		// The set is lazily created because it is freed in CleanUp
+		if (m_DescriptorSet == VK_NULL_HANDLE)
+		{
+			CreateUniformDescriptorSet();
+		}
+
 		RenderGroup.less([&](entt::entity ent, Transform& t_trans, MeshRenderer& t_MeshRend)
 		{
-			Fling::Model* Model = t_MeshRend.m_Model;
+			Fling::Model* Model = t_MeshRend.m_Model.Get();
 			if (!Model)
 			{
 				return;
 			}
 
-			// Update the UBO
-			Transform::CalculateWorldMatrix(t_trans);
-			m_Ubo.Model = t_trans.GetWorldMatrix();
-
-			// Memcpy to the buffer
-			Buffer* buf = t_MeshRend.m_UniformBuffer;
-			memcpy(
-				buf->m_MappedMem,
-				&m_Ubo,
-				buf->GetSize()
-			);
-
-			// If the mesh has no descriptor sets, then build them
-			// #TODO Investigate a better way to do this, probably by just moving the 
-			// descriptors off of the mesh
-			if (t_MeshRend.m_DescriptorSet == VK_NULL_HANDLE)
+			uint32 DynamicOffset = 0;
+			DebugUBO* MeshUBO = m_UniformRing->Allocate<DebugUBO>(DynamicOffset);
+			if (!MeshUBO)
 			{
-				CreateMeshDescriptorSet(t_MeshRend);
+				return;
 			}
 
+			// Update the UBO
+			m_Ubo.Model = t_trans.GetWorldMat();
+			memcpy(MeshUBO, &m_Ubo, sizeof(DebugUBO));
+
 			// Bind the descriptor set for rendering a mesh using the dynamic offset
 			vkCmdBindDescriptorSets(
 				t_CmdBuf.GetHandle(),
@@ -82,9 +91,9 @@ namespace Fling
 				m_GraphicsPipeline->GetPipelineLayout(),
 				0,
 				1,
-				&t_MeshRend.m_DescriptorSet,
-				0,
-				nullptr);
+				&m_DescriptorSet,
+				1,
+				&DynamicOffset);
 
 			vkCmdBindPipeline(t_CmdBuf.GetHandle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline->GetPipeline());
 
@@ -92,40 +101,29 @@ namespace Fling
 			// Render the mesh
 			vkCmdBindVertexBuffers(t_CmdBuf.GetHandle(), 0, 1, vertexBuffers, offsets);
 			vkCmdBindIndexBuffer(t_CmdBuf.GetHandle(), Model->GetIndexBuffer()->GetVkBuffer(), 0, Model->GetIndexType());
-			vkCmdDrawIndexed(t_CmdBuf.GetHandle(), Model->GetIndexCount(), 1, 0, 0, 0);
+			vkCmdDrawIndexed(t_CmdBuf.GetHandle(), Model->GetIndexCount(), 1, Model->GetFirstIndex(), Model->GetVertexOffset(), 0);
 		});
 	}
 
-	void DebugSubpass::CreateDescriptorSets(VkDescriptorPool t_Pool, entt::registry& t_reg)
+	void DebugSubpass::CreateDescriptorSets(DescriptorAllocator& t_Allocator, entt::registry& t_reg)
 	{
 		
 	}
 
-	void DebugSubpass::CreateMeshDescriptorSet(MeshRenderer& t_MeshRend)
+	void DebugSubpass::CreateUniformDescriptorSet()
 	{
-		// Only allocate new descriptor sets if there are none
-		// Some may exist if entt decides to re-use the component
-		if (t_MeshRend.m_DescriptorSet == VK_NULL_HANDLE)
-		{
-			VkDescriptorSetLayout layout = m_GraphicsPipeline->GetDescriptorSetLayout();
-			VkDescriptorSetAllocateInfo allocInfo = {};
-			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-			// If we have specified a specific pool then use that, otherwise use the one on the mesh
-			allocInfo.descriptorPool = m_DescriptorPool;
-			allocInfo.descriptorSetCount = 1;
-			allocInfo.pSetLayouts = &layout;
-
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(m_Device->GetVkDevice(), &allocInfo, &t_MeshRend.m_DescriptorSet));
-		}
+		m_DescriptorSet = VulkanApp::Get().GetDescriptorAllocator()->Allocate(m_GraphicsPipeline->GetDescriptorSetLayout());
+
+		VkDescriptorBufferInfo UniformInfo = m_UniformRing->GetDescriptorInfo(sizeof(DebugUBO));
 
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
 		{
 			// 0: UBO
-			Initializers::WriteDescriptorSetUniform(
-				t_MeshRend.m_UniformBuffer,
-				t_MeshRend.m_DescriptorSet,
-				0
-			),
+			Initializers::WriteDescriptorSet(
+				m_DescriptorSet,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+				0,
+				&UniformInfo),
 		};
 
 		vkUpdateDescriptorSets(m_Device->GetVkDevice(), static_cast<uint32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
@@ -133,24 +131,7 @@ namespace Fling
 
 	void DebugSubpass::PrepareAttachments()
 	{
-		// Create the descriptor pool for off screen things
-		uint32 DescriptorCount = 100 * m_SwapChain->GetImageViewCount();
-
-		std::vector<VkDescriptorPoolSize> poolSizes =
-		{
-			Initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 		DescriptorCount),			
-		};
-
-		VkDescriptorPoolCreateInfo poolInfo = {};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = static_cast<uint32>(poolSizes.size());
-		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = to_u32(100 * m_SwapChain->GetImageViewCount());
-
-		if (vkCreateDescriptorPool(m_Device->GetVkDevice(), &poolInfo, nullptr, &m_DescriptorPool) != VK_SUCCESS)
-		{
-			F_LOG_FATAL("Failed to create descriptor pool");
-		}
+		// Only a single set that is shared between every debug mesh is needed, which comes from the descriptor allocator
 	}
 
 	void DebugSubpass::CreateGraphicsPipeline()
@@ -169,10 +150,10 @@ namespace Fling
 
 	void DebugSubpass::CleanUp(entt::registry& t_reg)
 	{
-		if (m_DescriptorPool != VK_NULL_HANDLE)
+		if (m_DescriptorSet != VK_NULL_HANDLE)
 		{
-			vkDestroyDescriptorPool(m_Device->GetVkDevice(), m_DescriptorPool, nullptr);
-			m_DescriptorPool = VK_NULL_HANDLE;
+			VulkanApp::Get().GetDescriptorAllocator()->Free(m_DescriptorSet);
+			m_DescriptorSet = VK_NULL_HANDLE;
 		}
 	}
 
@@ -185,15 +166,5 @@ namespace Fling
 		}
 
 		t_Reg.assign<entt::tag<"Debug"_hs >>(t_Ent);
-
-		// Initialize and map the UBO of each mesh renderer
-		if (t_MeshRend.m_UniformBuffer == nullptr)
-		{
-			VkDeviceSize bufferSize = sizeof(DebugUBO);
-			t_MeshRend.m_UniformBuffer = new Buffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			t_MeshRend.m_UniformBuffer->MapMemory(bufferSize);
-		}
-
-		CreateMeshDescriptorSet(t_MeshRend);
 	}
 }   // namespace Fling
\ No newline at end of file
@@ -0,0 +1,392 @@
+#include "pch.h"
+#include "DescriptorAllocator.h"
+#include "LogicalDevice.h"
+#include "GraphicsHelpers.h"
+
+#include <algorithm>
+
+namespace Fling
+{
+	namespace
+	{
+		/** Descriptors of each type that a pool has room for per set that it holds, indexed by VkDescriptorType */
+		const float POOL_RATIOS[DescriptorAllocator::DESCRIPTOR_TYPE_COUNT] =
+		{
+			0.5f,	// VK_DESCRIPTOR_TYPE_SAMPLER
+			4.0f,	// VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+			0.0f,	// VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+			1.0f,	// VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+			0.0f,	// VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+			0.0f,	// VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+			1.0f,	// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+			2.0f,	// VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+			1.0f,	// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+			0.0f,	// VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
+			0.0f,	// VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
+		};
+
+		/** What a layout that was never registered is assumed to have. Only the set count is checked for it */
+		const DescriptorAllocator::DescriptorCounts NO_DESCRIPTORS = {};
+
+		/** Handles are pointers on 64 bit platforms and integers on 32 bit ones */
+		template<class T>
+		FORCEINLINE uint64 HandleToKey(T t_Handle)
+		{
+			return (uint64)(t_Handle);
+		}
+	}
+
+	DescriptorAllocator::DescriptorAllocator(const LogicalDevice* t_Dev, uint32 t_FramesInFlight, uint32 t_SetsPerPool)
+		: m_Device(t_Dev)
+	{
+		assert(m_Device && t_FramesInFlight > 0);
+
+		const uint32 FirstPoolSets = std::min(std::max(t_SetsPerPool, 1u), MAX_SETS_PER_POOL);
+		m_Persistent.NextPoolSets = FirstPoolSets;
+		m_Transient.NextPoolSets = FirstPoolSets;
+
+		m_Frames.resize(t_FramesInFlight);
+	}
+
+	DescriptorAllocator::~DescriptorAllocator()
+	{
+		if (!m_PersistentSets.empty())
+		{
+			F_LOG_WARN("Descriptor allocator destroyed with {} sets that were never freed!", m_PersistentSets.size());
+		}
+
+		// Every set is freed along with its pool
+		VkDevice Device = m_Device->GetVkDevice();
+		for (const Pool& Cur : m_Persistent.Pools)
+		{
+			vkDestroyDescriptorPool(Device, Cur.Handle, nullptr);
+		}
+		for (const Pool& Cur : m_Transient.Pools)
+		{
+			vkDestroyDescriptorPool(Device, Cur.Handle, nullptr);
+		}
+	}
+
+	void DescriptorAllocator::RegisterLayout(VkDescriptorSetLayout t_Layout, const std::vector<VkDescriptorSetLayoutBinding>& t_Bindings)
+	{
+		DescriptorCounts Descriptors;
+		for (const VkDescriptorSetLayoutBinding& Binding : t_Bindings)
+		{
+			if (Binding.descriptorType < DESCRIPTOR_TYPE_COUNT)
+			{
+				Descriptors.Count[Binding.descriptorType] += Binding.descriptorCount;
+			}
+			else
+			{
+				F_LOG_WARN("Descriptor type {} is not supported by the descriptor allocator!", Binding.descriptorType);
+			}
+		}
+
+		m_LayoutDescriptors[t_Layout] = Descriptors;
+	}
+
+	const DescriptorAllocator::DescriptorCounts& DescriptorAllocator::GetLayoutDescriptors(VkDescriptorSetLayout t_Layout)
+	{
+		auto It = m_LayoutDescriptors.find(t_Layout);
+		if (It != m_LayoutDescriptors.end())
+		{
+			return It->second;
+		}
+
+		if (!m_HasLoggedUnknownLayout)
+		{
+			F_LOG_WARN("Allocating a descriptor set of a layout that was never registered! Its pools can run out of room");
+			m_HasLoggedUnknownLayout = true;
+		}
+		return NO_DESCRIPTORS;
+	}
+
+	uint32 DescriptorAllocator::CreatePool(PoolList& t_List, VkDescriptorPoolCreateFlags t_Flags, const DescriptorCounts& t_MinDescriptors)
+	{
+		Pool NewPool = {};
+		NewPool.MaxSets = t_List.NextPoolSets;
+
+		std::vector<VkDescriptorPoolSize> PoolSizes;
+		for (uint32 Type = 0; Type < DESCRIPTOR_TYPE_COUNT; ++Type)
+		{
+			const uint32 Count = std::max(static_cast<uint32>(POOL_RATIOS[Type] * NewPool.MaxSets), t_MinDescriptors.Count[Type]);
+			NewPool.MaxDescriptors.Count[Type] = Count;
+			if (Count > 0)
+			{
+				PoolSizes.emplace_back(Initializers::DescriptorPoolSize(static_cast<VkDescriptorType>(Type), Count));
+			}
+		}
+
+		VkDescriptorPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		PoolInfo.flags = t_Flags;
+		PoolInfo.maxSets = NewPool.MaxSets;
+		PoolInfo.poolSizeCount = static_cast<uint32>(PoolSizes.size());
+		PoolInfo.pPoolSizes = PoolSizes.data();
+
+		if (vkCreateDescriptorPool(m_Device->GetVkDevice(), &PoolInfo, nullptr, &NewPool.Handle) != VK_SUCCESS)
+		{
+			F_LOG_FATAL("Failed to create a descriptor pool for {} sets!", NewPool.MaxSets);
+		}
+
+		NewPool.FreeSets = NewPool.MaxSets;
+		NewPool.FreeDescriptors = NewPool.MaxDescriptors;
+
+		t_List.Pools.emplace_back(NewPool);
+		t_List.NextPoolSets = std::min(NewPool.MaxSets * 2, MAX_SETS_PER_POOL);
+		++m_PoolsCreated;
+
+		F_LOG_TRACE("Descriptor pool created for {} sets, {} pools in total", NewPool.MaxSets, m_Persistent.Pools.size() + m_Transient.Pools.size());
+		return static_cast<uint32>(t_List.Pools.size() - 1);
+	}
+
+	bool DescriptorAllocator::TryAllocate(Pool& t_Pool, VkDescriptorSetLayout t_Layout, const DescriptorCounts& t_Descriptors, VkDescriptorSet& t_OutSet) const
+	{
+		// Asking a pool for more than it has left is invalid usage without VK_KHR_maintenance1, so check first
+		if (t_Pool.FreeSets == 0)
+		{
+			return false;
+		}
+		for (uint32 Type = 0; Type < DESCRIPTOR_TYPE_COUNT; ++Type)
+		{
+			if (t_Pool.FreeDescriptors.Count[Type] < t_Descriptors.Count[Type])
+			{
+				return false;
+			}
+		}
+
+		VkDescriptorSetAllocateInfo AllocInfo = Initializers::DescriptorSetAllocateInfo(t_Pool.Handle, &t_Layout, 1);
+		const VkResult Result = vkAllocateDescriptorSets(m_Device->GetVkDevice(), &AllocInfo, &t_OutSet);
+
+		// These mean that the pool is too fragmented, or full of a type of a layout that wasn't registered
+		if (Result == VK_ERROR_OUT_OF_POOL_MEMORY || Result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			return false;
+		}
+
+		VK_CHECK_RESULT(Result);
+
+		--t_Pool.FreeSets;
+		for (uint32 Type = 0; Type < DESCRIPTOR_TYPE_COUNT; ++Type)
+		{
+			t_Pool.FreeDescriptors.Count[Type] -= t_Descriptors.Count[Type];
+		}
+		return true;
+	}
+
+	VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout t_Layout)
+	{
+		const DescriptorCounts& Descriptors = GetLayoutDescriptors(t_Layout);
+		VkDescriptorSet Set = VK_NULL_HANDLE;
+
+		// The newest pool is the most likely to have room. Older ones only have the room of sets that were freed
+		for (size_t i = m_Persistent.Pools.size(); i-- > 0;)
+		{
+			if (TryAllocate(m_Persistent.Pools[i], t_Layout, Descriptors, Set))
+			{
+				m_PersistentSets.emplace(Set, PersistentSet { static_cast<uint32>(i), Descriptors });
+				return Set;
+			}
+		}
+
+		const uint32 PoolIndex = CreatePool(m_Persistent, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT, Descriptors);
+		if (!TryAllocate(m_Persistent.Pools[PoolIndex], t_Layout, Descriptors, Set))
+		{
+			F_LOG_FATAL("Descriptor set layout does not fit in an empty descriptor pool! Was it registered?");
+		}
+
+		m_PersistentSets.emplace(Set, PersistentSet { PoolIndex, Descriptors });
+		return Set;
+	}
+
+	void DescriptorAllocator::Free(VkDescriptorSet t_Set)
+	{
+		if (t_Set == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		auto It = m_PersistentSets.find(t_Set);
+		if (It == m_PersistentSets.end())
+		{
+			F_LOG_WARN("Tried to free a descriptor set that was not allocated with Allocate!");
+			return;
+		}
+
+		Pool& Owner = m_Persistent.Pools[It->second.PoolIndex];
+		vkFreeDescriptorSets(m_Device->GetVkDevice(), Owner.Handle, 1, &t_Set);
+
+		++Owner.FreeSets;
+		for (uint32 Type = 0; Type < DESCRIPTOR_TYPE_COUNT; ++Type)
+		{
+			Owner.FreeDescriptors.Count[Type] += It->second.Descriptors.Count[Type];
+		}
+
+		m_PersistentSets.erase(It);
+	}
+
+	VkDescriptorSet DescriptorAllocator::AllocateTransient(VkDescriptorSetLayout t_Layout, uint32 t_FrameInFlight)
+	{
+		TransientFrame& Frame = m_Frames[t_FrameInFlight];
+		const DescriptorCounts& Descriptors = GetLayoutDescriptors(t_Layout);
+
+		VkDescriptorSet Set = VK_NULL_HANDLE;
+		if (Frame.UsedPools.empty() || !TryAllocate(m_Transient.Pools[Frame.UsedPools.back()], t_Layout, Descriptors, Set))
+		{
+			// Take a pool that another frame gave back before making a new one
+			uint32 PoolIndex = 0;
+			if (!m_FreeTransientPools.empty())
+			{
+				PoolIndex = m_FreeTransientPools.back();
+				m_FreeTransientPools.pop_back();
+			}
+			else
+			{
+				PoolIndex = CreatePool(m_Transient, 0, Descriptors);
+			}
+			Frame.UsedPools.emplace_back(PoolIndex);
+
+			// A recycled pool can be too small for this layout, so fall back to a new one made for it
+			if (!TryAllocate(m_Transient.Pools[PoolIndex], t_Layout, Descriptors, Set))
+			{
+				PoolIndex = CreatePool(m_Transient, 0, Descriptors);
+				Frame.UsedPools.emplace_back(PoolIndex);
+
+				if (!TryAllocate(m_Transient.Pools[PoolIndex], t_Layout, Descriptors, Set))
+				{
+					F_LOG_FATAL("Descriptor set layout does not fit in an empty descriptor pool! Was it registered?");
+				}
+			}
+		}
+
+		++Frame.SetCount;
+		return Set;
+	}
+
+	void DescriptorAllocator::BeginFrame(uint32 t_FrameInFlight)
+	{
+		TransientFrame& Frame = m_Frames[t_FrameInFlight];
+		for (uint32 PoolIndex : Frame.UsedPools)
+		{
+			Pool& Cur = m_Transient.Pools[PoolIndex];
+			vkResetDescriptorPool(m_Device->GetVkDevice(), Cur.Handle, 0);
+			Cur.FreeSets = Cur.MaxSets;
+			Cur.FreeDescriptors = Cur.MaxDescriptors;
+
+			m_FreeTransientPools.emplace_back(PoolIndex);
+		}
+		Frame.UsedPools.clear();
+		Frame.SetCount = 0;
+
+		m_CurrentFrame = t_FrameInFlight;
+	}
+
+	DescriptorAllocator::CacheKey DescriptorAllocator::MakeCacheKey(VkDescriptorSetLayout t_Layout, const std::vector<VkWriteDescriptorSet>& t_Writes)
+	{
+		CacheKey Key;
+		Key.emplace_back(HandleToKey(t_Layout));
+
+		for (const VkWriteDescriptorSet& Write : t_Writes)
+		{
+			Key.emplace_back((static_cast<uint64>(Write.dstBinding) << 32) | Write.dstArrayElement);
+			Key.emplace_back((static_cast<uint64>(Write.descriptorType) << 32) | Write.descriptorCount);
+
+			// Vulkan ignores the pointers that don't match the type, so they can't be trusted to be null
+			const bool IsBuffer =
+				Write.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ||
+				Write.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+				Write.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER ||
+				Write.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+			const bool IsTexelBuffer =
+				Write.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER ||
+				Write.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+
+			for (uint32 i = 0; i < Write.descriptorCount; ++i)
+			{
+				if (IsBuffer)
+				{
+					const VkDescriptorBufferInfo& BufferInfo = Write.pBufferInfo[i];
+					Key.emplace_back(HandleToKey(BufferInfo.buffer));
+					Key.emplace_back(static_cast<uint64>(BufferInfo.offset));
+					Key.emplace_back(static_cast<uint64>(BufferInfo.range));
+				}
+				else if (IsTexelBuffer)
+				{
+					Key.emplace_back(HandleToKey(Write.pTexelBufferView[i]));
+				}
+				else
+				{
+					const VkDescriptorImageInfo& Image = Write.pImageInfo[i];
+					Key.emplace_back(HandleToKey(Image.imageView));
+					Key.emplace_back(HandleToKey(Image.sampler));
+					Key.emplace_back(static_cast<uint64>(Image.imageLayout));
+				}
+			}
+		}
+
+		return Key;
+	}
+
+	VkDescriptorSet DescriptorAllocator::GetCached(VkDescriptorSetLayout t_Layout, const std::vector<VkWriteDescriptorSet>& t_Writes)
+	{
+		CacheKey Key = MakeCacheKey(t_Layout, t_Writes);
+
+		auto It = m_Cache.find(Key);
+		if (It != m_Cache.end())
+		{
+			++It->second.RefCount;
+			++m_CacheHits;
+			return It->second.Set;
+		}
+
+		++m_CacheMisses;
+
+		VkDescriptorSet Set = Allocate(t_Layout);
+
+		std::vector<VkWriteDescriptorSet> Writes = t_Writes;
+		for (VkWriteDescriptorSet& Write : Writes)
+		{
+			Write.dstSet = Set;
+		}
+		vkUpdateDescriptorSets(m_Device->GetVkDevice(), static_cast<uint32>(Writes.size()), Writes.data(), 0, nullptr);
+
+		m_CacheKeys.emplace(Set, Key);
+		m_Cache.emplace(std::move(Key), CacheEntry { Set, 1 });
+		return Set;
+	}
+
+	void DescriptorAllocator::ReleaseCached(VkDescriptorSet t_Set)
+	{
+		auto KeyIt = m_CacheKeys.find(t_Set);
+		if (KeyIt == m_CacheKeys.end())
+		{
+			F_LOG_WARN("Tried to release a descriptor set that is not in the cache!");
+			return;
+		}
+
+		auto It = m_Cache.find(KeyIt->second);
+		assert(It != m_Cache.end() && It->second.RefCount > 0);
+		if (--It->second.RefCount > 0)
+		{
+			return;
+		}
+
+		m_Cache.erase(It);
+		m_CacheKeys.erase(KeyIt);
+		Free(t_Set);
+	}
+
+	DescriptorAllocatorStats DescriptorAllocator::GetStats() const
+	{
+		DescriptorAllocatorStats Stats = {};
+		Stats.PersistentPools = static_cast<uint32>(m_Persistent.Pools.size());
+		Stats.PersistentSets = static_cast<uint32>(m_PersistentSets.size());
+		Stats.TransientPools = static_cast<uint32>(m_Transient.Pools.size());
+		Stats.TransientSetsThisFrame = m_Frames[m_CurrentFrame].SetCount;
+		Stats.CachedSets = static_cast<uint32>(m_Cache.size());
+		Stats.CacheHits = m_CacheHits;
+		Stats.CacheMisses = m_CacheMisses;
+		Stats.PoolsCreated = m_PoolsCreated;
+		return Stats;
+	}
+}   // namespace Fling
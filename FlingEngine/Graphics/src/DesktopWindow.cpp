@@ -118,15 +118,18 @@ namespace Fling
 
 	void DesktopWindow::SetWindowIcon(Guid t_ID)
 	{
-		// Load an image 
-		std::shared_ptr<Texture> Icon = Texture::Create(t_ID);
-		assert(Icon);
+		// Load the pixels of the image, the icon never needs to be on the GPU
+		std::unique_ptr<Texture::LoadData> Icon = Texture::Decode(t_ID);
+		if (!Icon->Pixels)
+		{
+			return;
+		}
 
 		// Set the Pixel data for this image
 		GLFWimage GLFW_Image;
-		GLFW_Image.height = Icon->GetHeight();
-		GLFW_Image.width = Icon->GetWidth();
-		GLFW_Image.pixels = Icon->GetPixelData();
+		GLFW_Image.height = Icon->Height;
+		GLFW_Image.width = Icon->Width;
+		GLFW_Image.pixels = Icon->Pixels;
 
 		// Set it via GLFW
 		glfwSetWindowIcon(m_Window, 1, &GLFW_Image);
@@ -0,0 +1,465 @@
+#include "pch.h"
+#include "DeviceMemoryAllocator.h"
+#include "GraphicsHelpers.h"
+#include "LogicalDevice.h"
+#include "PhyscialDevice.h"
+
+namespace Fling
+{
+	/** A single VkDeviceMemory that is sub-allocated */
+	struct DeviceMemoryBlock
+	{
+		DeviceMemoryBlock(VkDeviceSize t_Size)
+			: Tlsf(t_Size)
+		{
+		}
+
+		VkDeviceMemory Memory = VK_NULL_HANDLE;
+
+		VkDeviceSize Size = 0;
+
+		/** Persistently mapped pointer to the block if it is host visible */
+		void* Mapped = nullptr;
+
+		uint32 MemoryType = 0;
+
+		uint32 PoolIndex = 0;
+
+		TlsfAllocator Tlsf;
+	};
+
+	namespace
+	{
+		inline VkDeviceSize AlignUp(VkDeviceSize t_Val, VkDeviceSize t_Align)
+		{
+			return (t_Val + t_Align - 1) & ~(t_Align - 1);
+		}
+
+		inline VkDeviceSize AlignDown(VkDeviceSize t_Val, VkDeviceSize t_Align)
+		{
+			return t_Val & ~(t_Align - 1);
+		}
+	}
+
+	const char* DeviceMemoryCategoryToString(DeviceMemoryCategory t_Category)
+	{
+		switch (t_Category)
+		{
+		case DeviceMemoryCategory::Geometry:		return "Geometry";
+		case DeviceMemoryCategory::Uniform:			return "Uniform";
+		case DeviceMemoryCategory::Staging:			return "Staging";
+		case DeviceMemoryCategory::Texture:			return "Texture";
+		case DeviceMemoryCategory::RenderTarget:	return "Render Target";
+		case DeviceMemoryCategory::Other:			return "Other";
+		default:									return "Unknown";
+		}
+	}
+
+	DeviceMemoryAllocator::DeviceMemoryAllocator(const LogicalDevice* t_Dev, VkDeviceSize t_BlockSize)
+		: m_BlockSize(t_BlockSize)
+	{
+		assert(t_Dev && t_Dev->GetPhysicalDevice());
+		assert(m_BlockSize > 0);
+
+		m_Device = t_Dev->GetVkDevice();
+
+		const PhysicalDevice* Phys = t_Dev->GetPhysicalDevice();
+		vkGetPhysicalDeviceMemoryProperties(Phys->GetVkPhysicalDevice(), &m_MemoryProperties);
+
+		const VkPhysicalDeviceLimits& Limits = Phys->GetDeviceProps().limits;
+		m_NonCoherentAtomSize = std::max<VkDeviceSize>(Limits.nonCoherentAtomSize, 1);
+		m_MaxAllocationCount = Limits.maxMemoryAllocationCount;
+
+		m_Pools.resize(m_MemoryProperties.memoryTypeCount * 2);
+
+		F_LOG_TRACE("Device memory allocator created with {} MB blocks", m_BlockSize / (1024 * 1024));
+	}
+
+	DeviceMemoryAllocator::~DeviceMemoryAllocator()
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+
+		if (m_AllocationCount > 0)
+		{
+			F_LOG_WARN("Device memory allocator destroyed with {} live allocations ({} dedicated)!", m_AllocationCount, m_DedicatedCount);
+		}
+
+		for (MemoryPool& Pool : m_Pools)
+		{
+			for (std::unique_ptr<DeviceMemoryBlock>& Block : Pool.Blocks)
+			{
+				vkFreeMemory(m_Device, Block->Memory, nullptr);
+			}
+			Pool.Blocks.clear();
+		}
+	}
+
+	DeviceAllocation DeviceMemoryAllocator::Allocate(
+		const VkMemoryRequirements& t_Reqs,
+		VkMemoryPropertyFlags t_Props,
+		DeviceMemoryCategory t_Category,
+		bool t_IsLinear,
+		bool t_Dedicated)
+	{
+		const uint32 MemoryType = GraphicsHelpers::FindMemoryType(m_MemoryProperties, t_Reqs.memoryTypeBits, t_Props);
+
+		VkDeviceSize Alignment = std::max<VkDeviceSize>(t_Reqs.alignment, 1);
+		VkDeviceSize Size = t_Reqs.size;
+
+		// Non coherent memory has to be flushed in whole atoms, so don't let allocations share one
+		if (IsHostVisible(MemoryType) && !IsHostCoherent(MemoryType))
+		{
+			Alignment = std::max(Alignment, m_NonCoherentAtomSize);
+			Size = AlignUp(Size, m_NonCoherentAtomSize);
+		}
+
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+
+		const VkDeviceSize BlockSize = GetBlockSize(MemoryType);
+		if (t_Dedicated || Size > BlockSize / 2)
+		{
+			return AllocateDedicated(MemoryType, Size, t_Category);
+		}
+
+		MemoryPool& Pool = m_Pools[GetPoolIndex(MemoryType, t_IsLinear)];
+
+		DeviceMemoryBlock* Block = nullptr;
+		TlsfAllocator::Allocation SubAlloc = {};
+
+		// Newer blocks are at the back and are more likely to have space
+		for (auto It = Pool.Blocks.rbegin(); It != Pool.Blocks.rend(); ++It)
+		{
+			SubAlloc = (*It)->Tlsf.Allocate(Size, Alignment);
+			if (SubAlloc.IsValid())
+			{
+				Block = It->get();
+				break;
+			}
+		}
+
+		if (!Block)
+		{
+			Block = CreateBlock(MemoryType, t_IsLinear, BlockSize);
+			if (!Block)
+			{
+				// We could be out of memory for a whole block, try to just allocate what we need
+				F_LOG_WARN("Failed to allocate a new {} byte memory block, falling back to a dedicated allocation", BlockSize);
+				return AllocateDedicated(MemoryType, Size, t_Category);
+			}
+
+			SubAlloc = Block->Tlsf.Allocate(Size, Alignment);
+			assert(SubAlloc.IsValid());
+		}
+
+		DeviceAllocation Alloc = {};
+		Alloc.Memory = Block->Memory;
+		Alloc.Offset = SubAlloc.Offset;
+		Alloc.Size = Size;
+		Alloc.MappedData = Block->Mapped ? static_cast<char*>(Block->Mapped) + SubAlloc.Offset : nullptr;
+		Alloc.MemoryTypeIndex = MemoryType;
+		Alloc.Category = t_Category;
+		Alloc.Block = Block;
+		Alloc.SubAllocation = SubAlloc;
+
+		++m_AllocationCount;
+		m_CategoryBytes[static_cast<size_t>(t_Category)] += Size;
+
+		return Alloc;
+	}
+
+	DeviceAllocation DeviceMemoryAllocator::AllocateForBuffer(VkBuffer t_Buffer, VkMemoryPropertyFlags t_Props, DeviceMemoryCategory t_Category)
+	{
+		VkMemoryRequirements MemRequirements = {};
+		vkGetBufferMemoryRequirements(m_Device, t_Buffer, &MemRequirements);
+
+		DeviceAllocation Alloc = Allocate(MemRequirements, t_Props, t_Category, /* t_IsLinear */ true);
+
+		if (vkBindBufferMemory(m_Device, t_Buffer, Alloc.Memory, Alloc.Offset) != VK_SUCCESS)
+		{
+			F_LOG_FATAL("Failed to bind buffer memory!");
+		}
+
+		return Alloc;
+	}
+
+	DeviceAllocation DeviceMemoryAllocator::AllocateForImage(
+		VkImage t_Image,
+		VkMemoryPropertyFlags t_Props,
+		DeviceMemoryCategory t_Category,
+		bool t_IsLinear,
+		bool t_Dedicated)
+	{
+		VkMemoryRequirements MemRequirements = {};
+		vkGetImageMemoryRequirements(m_Device, t_Image, &MemRequirements);
+
+		// Large render targets get recreated on resize, keep them from fragmenting the blocks
+		const VkDeviceSize DedicatedThreshold = static_cast<VkDeviceSize>(VkConfig::DEDICATED_RENDER_TARGET_SIZE_MB) * 1024 * 1024;
+		if (t_Category == DeviceMemoryCategory::RenderTarget && MemRequirements.size >= DedicatedThreshold)
+		{
+			t_Dedicated = true;
+		}
+
+		DeviceAllocation Alloc = Allocate(MemRequirements, t_Props, t_Category, t_IsLinear, t_Dedicated);
+
+		VK_CHECK_RESULT(vkBindImageMemory(m_Device, t_Image, Alloc.Memory, Alloc.Offset));
+
+		return Alloc;
+	}
+
+	void DeviceMemoryAllocator::Free(DeviceAllocation& t_Alloc)
+	{
+		if (!t_Alloc.IsValid())
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+
+		assert(m_AllocationCount > 0);
+		--m_AllocationCount;
+		m_CategoryBytes[static_cast<size_t>(t_Alloc.Category)] -= t_Alloc.Size;
+
+		if (t_Alloc.IsDedicated())
+		{
+			// Freeing the memory will also unmap it
+			vkFreeMemory(m_Device, t_Alloc.Memory, nullptr);
+			--m_DedicatedCount;
+			m_DedicatedBytes -= t_Alloc.Size;
+		}
+		else
+		{
+			DeviceMemoryBlock* Block = t_Alloc.Block;
+			Block->Tlsf.Free(t_Alloc.SubAllocation);
+
+			// Keep at least one block per pool around so that we don't thrash vkAllocateMemory
+			MemoryPool& Pool = m_Pools[Block->PoolIndex];
+			if (Block->Tlsf.IsEmpty() && Pool.Blocks.size() > 1)
+			{
+				DestroyBlock(Block);
+			}
+		}
+
+		t_Alloc = {};
+	}
+
+	void DeviceMemoryAllocator::Flush(const DeviceAllocation& t_Alloc, VkDeviceSize t_Offset, VkDeviceSize t_Size)
+	{
+		if (!t_Alloc.IsValid() || IsHostCoherent(t_Alloc.MemoryTypeIndex))
+		{
+			return;
+		}
+
+		assert(t_Offset <= t_Alloc.Size);
+		const VkDeviceSize Size = (t_Size == VK_WHOLE_SIZE) ? (t_Alloc.Size - t_Offset) : t_Size;
+
+		// Flush ranges have to be multiples of nonCoherentAtomSize
+		const VkDeviceSize MemorySize = t_Alloc.Block ? t_Alloc.Block->Size : t_Alloc.Size;
+		const VkDeviceSize Start = AlignDown(t_Alloc.Offset + t_Offset, m_NonCoherentAtomSize);
+		const VkDeviceSize End = std::min(AlignUp(t_Alloc.Offset + t_Offset + Size, m_NonCoherentAtomSize), MemorySize);
+
+		VkMappedMemoryRange MappedRange = {};
+		MappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		MappedRange.memory = t_Alloc.Memory;
+		MappedRange.offset = Start;
+		MappedRange.size = End - Start;
+
+		if (vkFlushMappedMemoryRanges(m_Device, 1, &MappedRange) != VK_SUCCESS)
+		{
+			F_LOG_ERROR("Failed to flush mapped device memory");
+		}
+	}
+
+	DeviceMemoryStats DeviceMemoryAllocator::GetStats() const
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+
+		DeviceMemoryStats Stats = {};
+		Stats.DedicatedAllocationCount = m_DedicatedCount;
+		Stats.DedicatedBytes = m_DedicatedBytes;
+		Stats.AllocationCount = m_AllocationCount;
+
+		VkDeviceSize FreeBytes = 0;
+		for (const MemoryPool& Pool : m_Pools)
+		{
+			for (const std::unique_ptr<DeviceMemoryBlock>& Block : Pool.Blocks)
+			{
+				++Stats.BlockCount;
+				Stats.BlockBytes += Block->Size;
+				Stats.BlockUsedBytes += Block->Tlsf.GetUsedBytes();
+				Stats.FreeRegionCount += Block->Tlsf.GetFreeRegionCount();
+				Stats.LargestFreeRegion = std::max<VkDeviceSize>(Stats.LargestFreeRegion, Block->Tlsf.GetLargestFreeRegion());
+				FreeBytes += Block->Tlsf.GetFreeBytes();
+			}
+		}
+
+		Stats.Fragmentation = FreeBytes > 0 ? 1.0f - static_cast<float>(Stats.LargestFreeRegion) / static_cast<float>(FreeBytes) : 0.0f;
+
+		for (size_t i = 0; i < static_cast<size_t>(DeviceMemoryCategory::Count); ++i)
+		{
+			Stats.CategoryBytes[i] = m_CategoryBytes[i];
+		}
+
+		Stats.VkAllocationCount = Stats.BlockCount + Stats.DedicatedAllocationCount;
+		return Stats;
+	}
+
+	void DeviceMemoryAllocator::LogStats() const
+	{
+		const DeviceMemoryStats Stats = GetStats();
+		const float ToMB = 1.0f / (1024.0f * 1024.0f);
+
+		F_LOG_TRACE("Device memory: {} allocations in {} blocks ({:.2f} / {:.2f} MB used), {} dedicated ({:.2f} MB)",
+			Stats.AllocationCount,
+			Stats.BlockCount,
+			Stats.BlockUsedBytes * ToMB,
+			Stats.BlockBytes * ToMB,
+			Stats.DedicatedAllocationCount,
+			Stats.DedicatedBytes * ToMB);
+
+		F_LOG_TRACE("Device memory: {} vkAllocateMemory's of max {}, fragmentation {:.2f}",
+			Stats.VkAllocationCount,
+			m_MaxAllocationCount,
+			Stats.Fragmentation);
+
+		for (size_t i = 0; i < static_cast<size_t>(DeviceMemoryCategory::Count); ++i)
+		{
+			F_LOG_TRACE("\t{}: {:.2f} MB", DeviceMemoryCategoryToString(static_cast<DeviceMemoryCategory>(i)), Stats.CategoryBytes[i] * ToMB);
+		}
+	}
+
+	DeviceMemoryCategory DeviceMemoryAllocator::GetBufferCategory(VkBufferUsageFlags t_Usage, VkMemoryPropertyFlags t_Props)
+	{
+		if (t_Usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+		{
+			return DeviceMemoryCategory::Geometry;
+		}
+		if (t_Usage & (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+		{
+			return DeviceMemoryCategory::Uniform;
+		}
+		if ((t_Usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) && (t_Props & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+		{
+			return DeviceMemoryCategory::Staging;
+		}
+		return DeviceMemoryCategory::Other;
+	}
+
+	VkDeviceSize DeviceMemoryAllocator::GetBlockSize(uint32 t_MemoryType) const
+	{
+		// Don't let a single block take up a large part of a small heap
+		const VkMemoryHeap& Heap = m_MemoryProperties.memoryHeaps[m_MemoryProperties.memoryTypes[t_MemoryType].heapIndex];
+		return std::min(m_BlockSize, std::max<VkDeviceSize>(Heap.size / 8, 1024 * 1024));
+	}
+
+	DeviceMemoryBlock* DeviceMemoryAllocator::CreateBlock(uint32 t_MemoryType, bool t_IsLinear, VkDeviceSize t_Size)
+	{
+		const VkDeviceSize Size = t_Size;
+
+		VkDeviceMemory Memory = VK_NULL_HANDLE;
+		void* Mapped = nullptr;
+		if (AllocateVkMemory(t_MemoryType, Size, Memory, &Mapped) != VK_SUCCESS)
+		{
+			return nullptr;
+		}
+
+		const uint32 PoolIndex = GetPoolIndex(t_MemoryType, t_IsLinear);
+
+		std::unique_ptr<DeviceMemoryBlock> Block = std::make_unique<DeviceMemoryBlock>(Size);
+		Block->Memory = Memory;
+		Block->Size = Size;
+		Block->Mapped = Mapped;
+		Block->MemoryType = t_MemoryType;
+		Block->PoolIndex = PoolIndex;
+
+		DeviceMemoryBlock* Result = Block.get();
+		m_Pools[PoolIndex].Blocks.emplace_back(std::move(Block));
+		return Result;
+	}
+
+	void DeviceMemoryAllocator::DestroyBlock(DeviceMemoryBlock* t_Block)
+	{
+		assert(t_Block && t_Block->Tlsf.IsEmpty());
+
+		std::vector<std::unique_ptr<DeviceMemoryBlock>>& Blocks = m_Pools[t_Block->PoolIndex].Blocks;
+		auto It = std::find_if(Blocks.begin(), Blocks.end(), [t_Block](const std::unique_ptr<DeviceMemoryBlock>& t_Other)
+		{
+			return t_Other.get() == t_Block;
+		});
+		assert(It != Blocks.end());
+
+		vkFreeMemory(m_Device, t_Block->Memory, nullptr);
+		Blocks.erase(It);
+	}
+
+	DeviceAllocation DeviceMemoryAllocator::AllocateDedicated(uint32 t_MemoryType, VkDeviceSize t_Size, DeviceMemoryCategory t_Category)
+	{
+		DeviceAllocation Alloc = {};
+
+		if (AllocateVkMemory(t_MemoryType, t_Size, Alloc.Memory, &Alloc.MappedData) != VK_SUCCESS)
+		{
+			F_LOG_FATAL("Failed to allocate {} bytes of device memory!", t_Size);
+		}
+
+		Alloc.Offset = 0;
+		Alloc.Size = t_Size;
+		Alloc.MemoryTypeIndex = t_MemoryType;
+		Alloc.Category = t_Category;
+
+		++m_DedicatedCount;
+		m_DedicatedBytes += t_Size;
+		++m_AllocationCount;
+		m_CategoryBytes[static_cast<size_t>(t_Category)] += t_Size;
+
+		return Alloc;
+	}
+
+	VkResult DeviceMemoryAllocator::AllocateVkMemory(uint32 t_MemoryType, VkDeviceSize t_Size, VkDeviceMemory& t_OutMemory, void** t_OutMapped)
+	{
+		uint32 LiveAllocations = m_DedicatedCount;
+		for (const MemoryPool& Pool : m_Pools)
+		{
+			LiveAllocations += static_cast<uint32>(Pool.Blocks.size());
+		}
+
+		if (LiveAllocations >= m_MaxAllocationCount)
+		{
+			F_LOG_ERROR("Reached maxMemoryAllocationCount of {}!", m_MaxAllocationCount);
+			return VK_ERROR_TOO_MANY_OBJECTS;
+		}
+
+		VkMemoryAllocateInfo AllocInfo = {};
+		AllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		AllocInfo.allocationSize = t_Size;
+		AllocInfo.memoryTypeIndex = t_MemoryType;
+
+		VkResult Result = vkAllocateMemory(m_Device, &AllocInfo, nullptr, &t_OutMemory);
+		if (Result != VK_SUCCESS)
+		{
+			return Result;
+		}
+
+		// Keep host visible memory mapped for its whole lifetime, a VkDeviceMemory can only be mapped once
+		*t_OutMapped = nullptr;
+		if (IsHostVisible(t_MemoryType))
+		{
+			Result = vkMapMemory(m_Device, t_OutMemory, 0, VK_WHOLE_SIZE, 0, t_OutMapped);
+			if (Result != VK_SUCCESS)
+			{
+				vkFreeMemory(m_Device, t_OutMemory, nullptr);
+				t_OutMemory = VK_NULL_HANDLE;
+			}
+		}
+
+		return Result;
+	}
+
+	bool DeviceMemoryAllocator::IsHostVisible(uint32 t_MemoryType) const
+	{
+		return (m_MemoryProperties.memoryTypes[t_MemoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	}
+
+	bool DeviceMemoryAllocator::IsHostCoherent(uint32 t_MemoryType) const
+	{
+		return (m_MemoryProperties.memoryTypes[t_MemoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+	}
+}   // namespace Fling
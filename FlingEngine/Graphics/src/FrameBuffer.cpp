@@ -1,6 +1,7 @@
 #include "FrameBuffer.h"
 #include "GraphicsHelpers.h"
 #include "LogicalDevice.h"
+#include "VulkanApp.h"
 
 namespace Fling
 {
@@ -105,9 +106,11 @@ namespace Fling
 			vkDestroyImageView(m_Device, m_ImageView, nullptr);
 		}
 
-		if (m_Memory != VK_NULL_HANDLE)
+		if (m_Memory.IsValid())
 		{
-			vkFreeMemory(m_Device, m_Memory, nullptr);
+			DeviceMemoryAllocator* Allocator = VulkanApp::Get().GetMemoryAllocator();
+			assert(Allocator);
+			Allocator->Free(m_Memory);
 		}
 	}
 
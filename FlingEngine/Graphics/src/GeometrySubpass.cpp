@@ -13,9 +13,41 @@
 #include "FirstPersonCamera.h"
 #include "Components/Transform.h"
 #include "VulkanApp.h"
+#include "DescriptorAllocator.h"
 
 namespace Fling
 {
+	namespace
+	{
+		std::unique_ptr<Buffer> CreateStorageBuffer(VkDeviceSize t_Size)
+		{
+			std::unique_ptr<Buffer> StorageBuffer = std::make_unique<Buffer>(
+				t_Size,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+			VK_CHECK_RESULT(StorageBuffer->MapMemory());
+			return StorageBuffer;
+		}
+
+		/** Double the size of a buffer until t_Size fits. @return True if the buffer was replaced */
+		bool GrowStorageBuffer(std::unique_ptr<Buffer>& t_Buffer, VkDeviceSize t_Size)
+		{
+			if (t_Buffer->GetSize() >= t_Size)
+			{
+				return false;
+			}
+
+			VkDeviceSize NewSize = t_Buffer->GetSize();
+			while (NewSize < t_Size)
+			{
+				NewSize *= 2;
+			}
+			t_Buffer = CreateStorageBuffer(NewSize);
+			return true;
+		}
+	}
+
 	GeometrySubpass::GeometrySubpass(
 		const LogicalDevice* t_Dev,
 		const Swapchain* t_Swap,
@@ -29,6 +61,7 @@ namespace Fling
 		, m_GlobalRenderPass(t_GlobalRenderPass)
 		, m_Camera(t_Cam)
 		, m_OffscreenFrameBuf(t_OffscreenDep)
+		, m_LightClusters(DeferredLightSettings::ClusterCountX, DeferredLightSettings::ClusterCountY, DeferredLightSettings::ClusterCountZ)
 	{
 		assert(m_GlobalRenderPass != VK_NULL_HANDLE);
 
@@ -43,8 +76,9 @@ namespace Fling
 		static_assert (sizeof(LightingUbo) < VULKAN_MAX_UBO_SIZE, "UBO size must be within the Vulkan Spec!");
 
 		VkDeviceSize bufferSize = sizeof(m_LightingUBO);
+		const uint32 FramesInFlight = VulkanApp::Get().GetFramesInFlight();
 
-		m_LightingUboBuffers.resize(m_SwapChain->GetImageCount());
+		m_LightingUboBuffers.resize(FramesInFlight);
 		for (size_t i = 0; i < m_LightingUboBuffers.size(); i++)
 		{
 			m_LightingUboBuffers[i] = new Buffer(
@@ -57,7 +91,7 @@ namespace Fling
 
 		// Build camera UBO's
 		bufferSize = sizeof(m_CamInfoUBO);
-		m_CameraUboBuffers.resize(m_SwapChain->GetImageCount());
+		m_CameraUboBuffers.resize(FramesInFlight);
 		for (size_t i = 0; i < m_CameraUboBuffers.size(); i++)
 		{
 			m_CameraUboBuffers[i] = new Buffer(
@@ -68,6 +102,16 @@ namespace Fling
 			m_CameraUboBuffers[i]->MapMemory(bufferSize);
 		}
 
+		// Point lights and the light lists of each cluster are storage buffers that grow with the scene
+		const VkDeviceSize ClusterHeaderSize = static_cast<VkDeviceSize>(m_LightClusters.GetClusterCount()) * 2 * sizeof(uint32);
+		m_PointLightBuffers.resize(FramesInFlight);
+		m_ClusterBuffers.resize(FramesInFlight);
+		for (uint32 i = 0; i < FramesInFlight; ++i)
+		{
+			m_PointLightBuffers[i] = CreateStorageBuffer(DeferredLightSettings::InitialPointLightCapacity * sizeof(PointLight));
+			m_ClusterBuffers[i] = CreateStorageBuffer(ClusterHeaderSize * 2);
+		}
+
 		t_reg.on_construct<PointLight>().connect<&GeometrySubpass::OnPointLightAdded>(*this);
 	}
 
@@ -89,11 +133,24 @@ namespace Fling
 		ClearBufferVector(m_QuadUboBuffer);
 		ClearBufferVector(m_CameraUboBuffers);
 
+		m_PointLightBuffers.clear();
+		m_ClusterBuffers.clear();
+
 		// Clean up any allocated descriptor sets
+		if (DescriptorAllocator* Allocator = VulkanApp::Get().GetDescriptorAllocator())
+		{
+			for (VkDescriptorSet Set : m_DescriptorSets)
+			{
+				Allocator->Free(Set);
+			}
+		}
+		m_DescriptorSets.clear();
 	}
 
 	void GeometrySubpass::Draw(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight, entt::registry& t_reg, float DeltaTime)
 	{
+		FLING_PROFILE_SCOPE("GeometrySubpass::Draw");
+
 		UpdateLightingUBO(t_reg, t_ActiveFrameInFlight);
 
 		// Update camera UBO's		
@@ -127,30 +184,22 @@ namespace Fling
 
 		vkCmdBindVertexBuffers(t_CmdBuf.GetHandle(), 0, 1, vertexBuffers, offsets);
 		vkCmdBindIndexBuffer(t_CmdBuf.GetHandle(), m_QuadModel->GetIndexBuffer()->GetVkBuffer(), 0, m_QuadModel->GetIndexType());
-		vkCmdDrawIndexed(t_CmdBuf.GetHandle(), m_QuadModel->GetIndexCount(), 1, 0, 0, 1);
+		vkCmdDrawIndexed(t_CmdBuf.GetHandle(), m_QuadModel->GetIndexCount(), 1, m_QuadModel->GetFirstIndex(), m_QuadModel->GetVertexOffset(), 1);
 	}
 
-	void GeometrySubpass::CreateDescriptorSets(VkDescriptorPool t_Pool, entt::registry& t_reg)
+	void GeometrySubpass::CreateDescriptorSets(DescriptorAllocator& t_Allocator, entt::registry& t_reg)
 	{
 		assert(m_OffscreenFrameBuf);
 
 		// We only need to do the actual allocation of sets ONCE
-		if(m_DescPool == VK_NULL_HANDLE)
+		if(m_DescriptorSets.empty())
 		{
-			m_DescPool = t_Pool;
-		
-			size_t ImageCount = m_SwapChain->GetImageCount();
-			m_DescriptorSets.resize(ImageCount);
-
-			std::vector<VkDescriptorSetLayout> layouts(ImageCount, m_GraphicsPipeline->GetDescriptorSetLayout());
-			VkDescriptorSetAllocateInfo allocInfo = {};
-			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-			// If we have specified a specific pool then use that, otherwise use the one on the mesh
-			allocInfo.descriptorPool = t_Pool;
-			allocInfo.descriptorSetCount = static_cast<uint32>(ImageCount);
-			allocInfo.pSetLayouts = layouts.data();
-
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(m_Device->GetVkDevice(), &allocInfo, m_DescriptorSets.data()));
+			const uint32 FramesInFlight = VulkanApp::Get().GetFramesInFlight();
+			m_DescriptorSets.resize(FramesInFlight);
+			for (VkDescriptorSet& Set : m_DescriptorSets)
+			{
+				Set = t_Allocator.Allocate(m_GraphicsPipeline->GetDescriptorSetLayout());
+			}
 		}
 
 		// Write to the sets
@@ -237,9 +286,31 @@ namespace Fling
 			};
 
 			vkUpdateDescriptorSets(m_Device->GetVkDevice(), static_cast<uint32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+			// 8 and 9 : Point lights and their clusters
+			WriteLightBufferDescriptors(static_cast<uint32>(i));
 		}
 	}
 
+	void GeometrySubpass::WriteLightBufferDescriptors(uint32 t_Frame)
+	{
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
+		{
+			Initializers::WriteDescriptorSet(
+				m_DescriptorSets[t_Frame],
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				8,
+				&m_PointLightBuffers[t_Frame]->GetDescriptor()),
+			Initializers::WriteDescriptorSet(
+				m_DescriptorSets[t_Frame],
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				9,
+				&m_ClusterBuffers[t_Frame]->GetDescriptor()),
+		};
+
+		vkUpdateDescriptorSets(m_Device->GetVkDevice(), static_cast<uint32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
 	void GeometrySubpass::CreateGraphicsPipeline()
 	{
 		// Use empty vertex descriptions here
@@ -279,7 +350,7 @@ namespace Fling
 		//CreateGraphicsPipeline();
 
 		//// Now create the descriptor sets, which are dependent on the newly updated offscreen frame buffer
-		//CreateDescriptorSets(m_DescPool, t_reg);
+		//CreateDescriptorSets(*VulkanApp::Get().GetDescriptorAllocator(), t_reg);
 	}
 
 	void GeometrySubpass::OnPointLightAdded(entt::entity t_Ent, entt::registry& t_Reg, PointLight& t_Light)
@@ -329,28 +400,57 @@ namespace Fling
 
 		m_LightingUBO.DirLightCount = CurLightCount;
 
-		CurLightCount = 0;
-
 		// Point lights ---------------------
+		m_PointLights.clear();
+		m_PointLightSpheres.clear();
 		for (auto entity : PointLightView)
 		{
-			if (CurLightCount < DeferredLightSettings::MaxPointLights)
-			{
-				PointLight& Light = PointLightView.get<PointLight>(entity);
-				Transform& Trans = PointLightView.get<Transform>(entity);
-
-				Light.SetPos(glm::vec4(Trans.GetPos(), 1.0f));
-				// Copy the point light info to the buffer
-				memcpy((m_LightingUBO.PointLightBuffer + (CurLightCount++)), &Light, sizeof(PointLight));
-			}
+			// The light's position is copied from its transform by a system in World::Update
+			const PointLight& Light = PointLightView.get<PointLight>(entity);
+			m_PointLights.push_back(Light);
+			m_PointLightSpheres.emplace_back(glm::vec3(Light.GetPos()), Light.Range);
 		}
 
+		// The shader finds the cluster of each pixel and only loops over the lights in it
+		m_LightClusters.Build(
+			m_Camera->GetViewMatrix(),
+			m_Camera->GetProjectionMatrix(),
+			m_Camera->GetNearPlane(),
+			m_Camera->GetFarPlane(),
+			m_PointLightSpheres.data(),
+			static_cast<uint32>(m_PointLightSpheres.size()));
+
+		m_LightingUBO.PointLightCount = static_cast<uint32>(m_PointLights.size());
+		m_LightingUBO.ClusterCounts = glm::uvec4(m_LightClusters.GetCounts(), 0u);
+		m_LightingUBO.ClusterParams = glm::vec4(m_LightClusters.GetSliceScale(), m_LightClusters.GetSliceBias(), 0.0f, 0.0f);
+
+		UploadLightBuffers(t_ActiveFrame);
+
 		// Memcpy to the buffer
-		m_LightingUBO.PointLightCount = CurLightCount;
-		
 		memcpy(
 			m_LightingUboBuffers[t_ActiveFrame]->m_MappedMem,
 			&m_LightingUBO,
 			sizeof(m_LightingUBO));
 	}
+
+	void GeometrySubpass::UploadLightBuffers(uint32 t_ActiveFrame)
+	{
+		const std::vector<uint32>& ClusterData = m_LightClusters.GetData();
+		const VkDeviceSize LightSize = static_cast<VkDeviceSize>(m_PointLights.size()) * sizeof(PointLight);
+		const VkDeviceSize ClusterSize = static_cast<VkDeviceSize>(ClusterData.size()) * sizeof(uint32);
+
+		// The frame fence has been waited on, so this frame's buffers can be replaced if they are too small
+		const bool LightsGrew = GrowStorageBuffer(m_PointLightBuffers[t_ActiveFrame], LightSize);
+		const bool ClustersGrew = GrowStorageBuffer(m_ClusterBuffers[t_ActiveFrame], ClusterSize);
+		if ((LightsGrew || ClustersGrew) && !m_DescriptorSets.empty())
+		{
+			WriteLightBufferDescriptors(t_ActiveFrame);
+		}
+
+		if (LightSize > 0)
+		{
+			memcpy(m_PointLightBuffers[t_ActiveFrame]->m_MappedMem, m_PointLights.data(), static_cast<size_t>(LightSize));
+		}
+		memcpy(m_ClusterBuffers[t_ActiveFrame]->m_MappedMem, ClusterData.data(), static_cast<size_t>(ClusterSize));
+	}
 }   // namespace Fling
\ No newline at end of file
@@ -0,0 +1,525 @@
+#include "pch.h"
+#include "GpuCuller.h"
+#include "ComputePipeline.h"
+#include "DrawBatchTable.h"
+#include "FrameBuffer.h"
+#include "GraphicsHelpers.h"
+#include "LogicalDevice.h"
+#include "PhyscialDevice.h"
+#include "Model.h"
+#include "Shader.h"
+#include "VulkanApp.h"
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+
+namespace Fling
+{
+	namespace
+	{
+		/** Size of the reduction shader's push constants, the input and output size of a level */
+		const uint32 REDUCE_PUSH_CONSTANT_SIZE = 4 * sizeof(int32);
+
+		/**
+		* Make sure that a buffer is at least t_Size bytes, replacing it with one that is twice as big if not.
+		* Only safe for buffers that no frame in flight can be using
+		*/
+		void EnsureBufferSize(std::unique_ptr<Buffer>& t_Buffer, VkDeviceSize t_Size, VkBufferUsageFlags t_Usage, VkMemoryPropertyFlags t_Properties)
+		{
+			if (t_Buffer && t_Buffer->GetSize() >= t_Size)
+			{
+				return;
+			}
+
+			VkDeviceSize NewSize = t_Buffer ? t_Buffer->GetSize() : t_Size;
+			while (NewSize < t_Size)
+			{
+				NewSize *= 2;
+			}
+
+			t_Buffer = std::make_unique<Buffer>(NewSize, t_Usage, t_Properties);
+			if (t_Properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+			{
+				VK_CHECK_RESULT(t_Buffer->MapMemory());
+			}
+		}
+
+		void CmdMemoryBarrier(VkCommandBuffer t_Cmd, VkPipelineStageFlags t_SrcStages, VkPipelineStageFlags t_DstStages, VkAccessFlags t_SrcAccess, VkAccessFlags t_DstAccess)
+		{
+			VkMemoryBarrier Barrier = {};
+			Barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			Barrier.srcAccessMask = t_SrcAccess;
+			Barrier.dstAccessMask = t_DstAccess;
+			vkCmdPipelineBarrier(t_Cmd, t_SrcStages, t_DstStages, 0, 1, &Barrier, 0, nullptr, 0, nullptr);
+		}
+	}
+
+	GpuCuller::GpuCuller(const LogicalDevice* t_Dev, Shader* t_CullShader, Shader* t_DepthReduceShader, uint32 t_FramesInFlight)
+		: m_Device(t_Dev)
+	{
+		assert(m_Device && t_CullShader && t_DepthReduceShader);
+
+		VkDevice Device = m_Device->GetVkDevice();
+
+		m_CullPipeline = new ComputePipeline(t_CullShader, Device);
+		m_ReducePipeline = new ComputePipeline(t_DepthReduceShader, Device, REDUCE_PUSH_CONSTANT_SIZE);
+
+		// A cull set per frame, and one reduction set per pyramid level that every frame shares
+		DescriptorAllocator* Allocator = VulkanApp::Get().GetDescriptorAllocator();
+		assert(Allocator);
+
+		for (VkDescriptorSet& ReduceSet : m_ReduceSets)
+		{
+			ReduceSet = Allocator->Allocate(m_ReducePipeline->GetDescriptorSetLayout());
+		}
+
+		m_Frames.resize(t_FramesInFlight);
+		for (FrameResources& Frame : m_Frames)
+		{
+			Frame.CullSet = Allocator->Allocate(m_CullPipeline->GetDescriptorSetLayout());
+
+			EnsureBufferSize(Frame.Draws, sizeof(GpuDrawCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			EnsureBufferSize(Frame.Instances, OBJECTS_PER_PAGE * sizeof(glm::mat4), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			EnsureBufferSize(Frame.Uniforms, sizeof(GpuCullData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+
+		EnsureBufferSize(m_ObjectBuffer, OBJECTS_PER_PAGE * sizeof(GpuObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		GraphicsHelpers::CreateVkSampler(
+			VK_FILTER_NEAREST,
+			VK_FILTER_NEAREST,
+			VK_SAMPLER_MIPMAP_MODE_NEAREST,
+			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+			m_PyramidSampler);
+	}
+
+	GpuCuller::~GpuCuller()
+	{
+		VkDevice Device = m_Device->GetVkDevice();
+
+		ReleasePyramid();
+
+		vkDestroySampler(Device, m_PyramidSampler, nullptr);
+
+		DescriptorAllocator* Allocator = VulkanApp::Get().GetDescriptorAllocator();
+		for (VkDescriptorSet ReduceSet : m_ReduceSets)
+		{
+			Allocator->Free(ReduceSet);
+		}
+		for (FrameResources& Frame : m_Frames)
+		{
+			Allocator->Free(Frame.CullSet);
+		}
+
+		delete m_CullPipeline;
+		m_CullPipeline = nullptr;
+
+		delete m_ReducePipeline;
+		m_ReducePipeline = nullptr;
+
+		m_Frames.clear();
+		m_RetiredBuffers.clear();
+		m_ObjectBuffer.reset();
+	}
+
+	bool GpuCuller::SupportsDepthPyramid(const LogicalDevice* t_Dev, VkFormat t_DepthFormat)
+	{
+		const PhysicalDevice* PhysDevice = t_Dev->GetPhysicalDevice();
+		assert(PhysDevice);
+
+		return (PhysDevice->GetFormatProperties(t_DepthFormat).optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+	}
+
+	void GpuCuller::SetObjectCount(uint32 t_Count)
+	{
+		m_Objects.resize(t_Count);
+		m_DirtyPages.resize((t_Count + OBJECTS_PER_PAGE - 1) / OBJECTS_PER_PAGE, 0);
+
+		const VkDeviceSize Size = static_cast<VkDeviceSize>(t_Count) * sizeof(GpuObject);
+		if (m_ObjectBuffer->GetSize() < Size)
+		{
+			// Frames in flight may still be culling with the old buffer
+			m_RetiredBuffers.push_back({ std::move(m_ObjectBuffer), static_cast<uint32>(m_Frames.size()) });
+			m_ObjectBuffer.reset();
+
+			VkDeviceSize NewSize = m_RetiredBuffers.back().Buf->GetSize();
+			while (NewSize < Size)
+			{
+				NewSize *= 2;
+			}
+			EnsureBufferSize(m_ObjectBuffer, NewSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+			MarkAllDirty();
+		}
+	}
+
+	void GpuCuller::MarkAllDirty()
+	{
+		std::fill(m_DirtyPages.begin(), m_DirtyPages.end(), static_cast<uint8>(1));
+	}
+
+	void GpuCuller::SetBatches(const DrawBatchTable& t_Table, const std::vector<Model*>& t_Models, bool t_UseFirstInstance)
+	{
+		const std::vector<DrawBatchTable::Batch>& Batches = t_Table.GetBatches();
+
+		m_Commands.resize(Batches.size());
+		for (size_t i = 0; i < Batches.size(); ++i)
+		{
+			GpuDrawCommand& Command = m_Commands[i];
+			Command = {};
+			const Model* BatchModel = t_Models[Batches[i].Model];
+			Command.Command.indexCount = BatchModel->GetIndexCount();
+			Command.Command.firstIndex = BatchModel->GetFirstIndex();
+			Command.Command.vertexOffset = BatchModel->GetVertexOffset();
+			Command.Command.firstInstance = t_UseFirstInstance ? Batches[i].FirstInstance : 0;
+			Command.InstanceOffset = Batches[i].FirstInstance;
+		}
+
+		m_InstanceCount = t_Table.GetInstanceCount();
+	}
+
+	uint32 GpuCuller::BeginFrame(uint32 t_ActiveFrameInFlight, const Frustum& t_Frustum, bool t_FrustumCulling, bool t_OcclusionCulling)
+	{
+		FLING_PROFILE_SCOPE("GpuCuller::BeginFrame");
+
+		// Every frame that could have used a retired buffer is done once it has waited out the frames in flight
+		for (RetiredBuffer& Retired : m_RetiredBuffers)
+		{
+			--Retired.FramesLeft;
+		}
+		m_RetiredBuffers.erase(
+			std::remove_if(m_RetiredBuffers.begin(), m_RetiredBuffers.end(), [](const RetiredBuffer& t_Retired) { return t_Retired.FramesLeft == 0; }),
+			m_RetiredBuffers.end());
+
+		FrameResources& Frame = m_Frames[t_ActiveFrameInFlight];
+
+		// The frame fence has been waited on, so the counts from the last time this frame was culled are done
+		uint32 DrawnInstances = 0;
+		const GpuDrawCommand* LastCommands = static_cast<const GpuDrawCommand*>(Frame.Draws->m_MappedMem);
+		for (uint32 i = 0; i < Frame.CommandCount; ++i)
+		{
+			DrawnInstances += LastCommands[i].Command.instanceCount;
+		}
+
+		const uint32 CommandCount = static_cast<uint32>(m_Commands.size());
+		EnsureBufferSize(Frame.Draws, static_cast<VkDeviceSize>(std::max(CommandCount, 1u)) * sizeof(GpuDrawCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		EnsureBufferSize(Frame.Instances, static_cast<VkDeviceSize>(std::max(m_InstanceCount, 1u)) * sizeof(glm::mat4), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (CommandCount > 0)
+		{
+			memcpy(Frame.Draws->m_MappedMem, m_Commands.data(), static_cast<size_t>(CommandCount) * sizeof(GpuDrawCommand));
+		}
+		Frame.CommandCount = CommandCount;
+
+		GpuCullData Data = {};
+		Data.PrevViewProjection = m_PyramidViewProjection;
+		for (uint32 Side = 0; Side < Frustum::Side::Count; ++Side)
+		{
+			Data.FrustumPlanes[Side] = t_Frustum.Planes[Side];
+		}
+		Data.DepthSize = glm::vec2(static_cast<float>(m_DepthSize.width), static_cast<float>(m_DepthSize.height));
+		Data.ObjectCount = GetObjectCount();
+		Data.Flags = (t_FrustumCulling ? GpuCullData::FLAG_FRUSTUM : 0) | (t_OcclusionCulling && m_PyramidValid ? GpuCullData::FLAG_OCCLUSION : 0);
+		Data.PyramidMaxLevel = static_cast<int32>(m_PyramidSizes.size()) - 1;
+		memcpy(Frame.Uniforms->m_MappedMem, &Data, sizeof(GpuCullData));
+
+		UpdateCullSet(t_ActiveFrameInFlight);
+
+		return DrawnInstances;
+	}
+
+	void GpuCuller::UpdateCullSet(uint32 t_ActiveFrameInFlight)
+	{
+		FrameResources& Frame = m_Frames[t_ActiveFrameInFlight];
+
+		VkDescriptorBufferInfo UniformInfo = { Frame.Uniforms->GetVkBuffer(), 0, sizeof(GpuCullData) };
+		VkDescriptorBufferInfo ObjectInfo = { m_ObjectBuffer->GetVkBuffer(), 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo DrawInfo = { Frame.Draws->GetVkBuffer(), 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo InstanceInfo = { Frame.Instances->GetVkBuffer(), 0, VK_WHOLE_SIZE };
+		VkDescriptorImageInfo PyramidInfo = Initializers::DescriptorImageInfo(m_PyramidSampler, m_PyramidView, VK_IMAGE_LAYOUT_GENERAL);
+
+		std::vector<VkWriteDescriptorSet> Writes =
+		{
+			Initializers::WriteDescriptorSet(Frame.CullSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &UniformInfo),
+			Initializers::WriteDescriptorSet(Frame.CullSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &ObjectInfo),
+			Initializers::WriteDescriptorSet(Frame.CullSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &DrawInfo),
+			Initializers::WriteDescriptorSet(Frame.CullSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &InstanceInfo),
+			Initializers::WriteDescriptorSet(Frame.CullSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &PyramidInfo)
+		};
+
+		vkUpdateDescriptorSets(m_Device->GetVkDevice(), static_cast<uint32>(Writes.size()), Writes.data(), 0, nullptr);
+	}
+
+	void GpuCuller::RecordObjectUpload(VkCommandBuffer t_Cmd, uint32 t_ActiveFrameInFlight)
+	{
+		const uint32 ObjectCount = GetObjectCount();
+		const uint32 PageCount = static_cast<uint32>(m_DirtyPages.size());
+
+		uint32 DirtyCount = 0;
+		for (uint8 Dirty : m_DirtyPages)
+		{
+			DirtyCount += Dirty;
+		}
+
+		if (DirtyCount == 0)
+		{
+			return;
+		}
+
+		FrameResources& Frame = m_Frames[t_ActiveFrameInFlight];
+		EnsureBufferSize(Frame.Staging, static_cast<VkDeviceSize>(DirtyCount) * OBJECTS_PER_PAGE * sizeof(GpuObject), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		// Neighbouring dirty pages are one copy
+		m_CopyRegions.clear();
+		uint8* Staging = static_cast<uint8*>(Frame.Staging->m_MappedMem);
+		VkDeviceSize StagingOffset = 0;
+		uint32 Page = 0;
+		while (Page < PageCount)
+		{
+			if (!m_DirtyPages[Page])
+			{
+				++Page;
+				continue;
+			}
+
+			uint32 LastPage = Page;
+			while (LastPage < PageCount && m_DirtyPages[LastPage])
+			{
+				m_DirtyPages[LastPage++] = 0;
+			}
+
+			const uint32 First = Page * OBJECTS_PER_PAGE;
+			const uint32 Count = std::min(LastPage * OBJECTS_PER_PAGE, ObjectCount) - First;
+			const VkDeviceSize Size = static_cast<VkDeviceSize>(Count) * sizeof(GpuObject);
+			memcpy(Staging + StagingOffset, m_Objects.data() + First, static_cast<size_t>(Size));
+
+			VkBufferCopy& Region = m_CopyRegions.emplace_back();
+			Region.srcOffset = StagingOffset;
+			Region.dstOffset = static_cast<VkDeviceSize>(First) * sizeof(GpuObject);
+			Region.size = Size;
+
+			StagingOffset += Size;
+			Page = LastPage;
+		}
+
+		// Last frame's cull may still be reading the objects that are about to be overwritten
+		CmdMemoryBarrier(t_Cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0);
+
+		vkCmdCopyBuffer(t_Cmd, Frame.Staging->GetVkBuffer(), m_ObjectBuffer->GetVkBuffer(), static_cast<uint32>(m_CopyRegions.size()), m_CopyRegions.data());
+	}
+
+	void GpuCuller::RecordCull(VkCommandBuffer t_Cmd, uint32 t_ActiveFrameInFlight)
+	{
+		FLING_PROFILE_SCOPE("GpuCuller::RecordCull");
+
+		RecordObjectUpload(t_Cmd, t_ActiveFrameInFlight);
+
+		// Wait for the object upload and for the depth pyramid that the last frame built
+		CmdMemoryBarrier(
+			t_Cmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		const uint32 ObjectCount = GetObjectCount();
+		if (ObjectCount > 0)
+		{
+			VkDescriptorSet CullSet = m_Frames[t_ActiveFrameInFlight].CullSet;
+			m_CullPipeline->Bind(t_Cmd);
+			vkCmdBindDescriptorSets(t_Cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipeline->GetPipelineLayout(), 0, 1, &CullSet, 0, nullptr);
+			m_CullPipeline->Dispatch(t_Cmd, ObjectCount);
+		}
+
+		// The draws read the counts and instances, and the CPU reads the counts back for stats next time
+		CmdMemoryBarrier(
+			t_Cmd,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_HOST_READ_BIT);
+	}
+
+	void GpuCuller::RecordDepthPyramid(VkCommandBuffer t_Cmd, FrameBufferAttachment& t_Depth, const glm::mat4& t_ViewProjection)
+	{
+		FLING_PROFILE_SCOPE("GpuCuller::RecordDepthPyramid");
+
+		if (m_PyramidImage == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		// The render pass leaves the depth read only, this makes its writes visible to the first reduction.
+		// Waiting on compute as well keeps the pyramid from being overwritten while this frame's cull reads it
+		VkImageMemoryBarrier DepthBarrier = {};
+		DepthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		DepthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		DepthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		DepthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		DepthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		DepthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		DepthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		DepthBarrier.image = t_Depth.GetImageHandle();
+		DepthBarrier.subresourceRange = t_Depth.GetSubresourceRange();
+
+		vkCmdPipelineBarrier(
+			t_Cmd,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &DepthBarrier);
+
+		m_ReducePipeline->Bind(t_Cmd);
+
+		VkExtent2D InputSize = m_DepthSize;
+		for (uint32 Level = 0; Level < static_cast<uint32>(m_PyramidSizes.size()); ++Level)
+		{
+			const VkExtent2D OutputSize = m_PyramidSizes[Level];
+
+			vkCmdBindDescriptorSets(t_Cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_ReducePipeline->GetPipelineLayout(), 0, 1, &m_ReduceSets[Level], 0, nullptr);
+
+			const int32 Sizes[4] =
+			{
+				static_cast<int32>(InputSize.width), static_cast<int32>(InputSize.height),
+				static_cast<int32>(OutputSize.width), static_cast<int32>(OutputSize.height)
+			};
+			vkCmdPushConstants(t_Cmd, m_ReducePipeline->GetPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, REDUCE_PUSH_CONSTANT_SIZE, Sizes);
+
+			m_ReducePipeline->Dispatch(t_Cmd, OutputSize.width, OutputSize.height);
+
+			// Each level reads the one before it
+			if (Level + 1 < static_cast<uint32>(m_PyramidSizes.size()))
+			{
+				CmdMemoryBarrier(t_Cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+			}
+
+			InputSize = OutputSize;
+		}
+
+		m_PyramidViewProjection = t_ViewProjection;
+		m_PyramidValid = true;
+	}
+
+	void GpuCuller::OnResize(FrameBufferAttachment& t_Depth, uint32 t_Width, uint32 t_Height)
+	{
+		ReleasePyramid();
+		CreatePyramid(t_Depth, t_Width, t_Height);
+	}
+
+	void GpuCuller::CreatePyramid(FrameBufferAttachment& t_Depth, uint32 t_Width, uint32 t_Height)
+	{
+		VkDevice Device = m_Device->GetVkDevice();
+
+		m_DepthSize = { t_Width, t_Height };
+
+		// Level 0 is half of the depth buffer, and every level after that halves again down to 1x1
+		m_PyramidSizes.clear();
+		VkExtent2D Size = { std::max((t_Width + 1) / 2, 1u), std::max((t_Height + 1) / 2, 1u) };
+		m_PyramidSizes.push_back(Size);
+		while ((Size.width > 1 || Size.height > 1) && m_PyramidSizes.size() < MAX_PYRAMID_LEVELS)
+		{
+			Size = { (Size.width + 1) / 2, (Size.height + 1) / 2 };
+			m_PyramidSizes.push_back(Size);
+		}
+		const uint32 LevelCount = static_cast<uint32>(m_PyramidSizes.size());
+
+		GraphicsHelpers::CreateVkImage(
+			Device,
+			m_PyramidSizes[0].width,
+			m_PyramidSizes[0].height,
+			LevelCount,
+			/* Depth */ 1,
+			/* ArrayLayers */ 1,
+			VK_FORMAT_R32_SFLOAT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			0,
+			m_PyramidImage,
+			m_PyramidMemory);
+
+		const VkImageSubresourceRange AllLevels = { VK_IMAGE_ASPECT_COLOR_BIT, 0, LevelCount, 0, 1 };
+
+		VkImageViewCreateInfo ViewInfo = Initializers::ImageViewCreateInfo();
+		ViewInfo.image = m_PyramidImage;
+		ViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		ViewInfo.format = VK_FORMAT_R32_SFLOAT;
+		ViewInfo.subresourceRange = AllLevels;
+		VK_CHECK_RESULT(vkCreateImageView(Device, &ViewInfo, nullptr, &m_PyramidView));
+
+		m_PyramidLevelViews.resize(LevelCount);
+		for (uint32 Level = 0; Level < LevelCount; ++Level)
+		{
+			ViewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, Level, 1, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(Device, &ViewInfo, nullptr, &m_PyramidLevelViews[Level]));
+		}
+
+		// The pyramid stays in the general layout so that it can be written and sampled without transitions
+		VkCommandBuffer Cmd = GraphicsHelpers::BeginSingleTimeCommands();
+		GraphicsHelpers::SetImageLayout(
+			Cmd,
+			m_PyramidImage,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_GENERAL,
+			AllLevels,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		GraphicsHelpers::EndSingleTimeCommands(Cmd);
+
+		// Level 0 reduces the depth buffer, the rest reduce the level before them
+		for (uint32 Level = 0; Level < LevelCount; ++Level)
+		{
+			VkDescriptorImageInfo InputInfo = Level == 0 ?
+				Initializers::DescriptorImageInfo(m_PyramidSampler, t_Depth.GetViewHandle(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) :
+				Initializers::DescriptorImageInfo(m_PyramidSampler, m_PyramidLevelViews[Level - 1], VK_IMAGE_LAYOUT_GENERAL);
+			VkDescriptorImageInfo OutputInfo = Initializers::DescriptorImageInfo(VK_NULL_HANDLE, m_PyramidLevelViews[Level], VK_IMAGE_LAYOUT_GENERAL);
+
+			VkWriteDescriptorSet Writes[2] =
+			{
+				Initializers::WriteDescriptorSet(m_ReduceSets[Level], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &InputInfo),
+				Initializers::WriteDescriptorSet(m_ReduceSets[Level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &OutputInfo)
+			};
+			vkUpdateDescriptorSets(Device, 2, Writes, 0, nullptr);
+		}
+
+		m_PyramidValid = false;
+	}
+
+	void GpuCuller::ReleasePyramid()
+	{
+		VkDevice Device = m_Device->GetVkDevice();
+
+		for (VkImageView View : m_PyramidLevelViews)
+		{
+			vkDestroyImageView(Device, View, nullptr);
+		}
+		m_PyramidLevelViews.clear();
+
+		if (m_PyramidView != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(Device, m_PyramidView, nullptr);
+			m_PyramidView = VK_NULL_HANDLE;
+		}
+
+		if (m_PyramidImage != VK_NULL_HANDLE)
+		{
+			vkDestroyImage(Device, m_PyramidImage, nullptr);
+			m_PyramidImage = VK_NULL_HANDLE;
+		}
+
+		if (m_PyramidMemory.IsValid())
+		{
+			DeviceMemoryAllocator* Allocator = VulkanApp::Get().GetMemoryAllocator();
+			assert(Allocator);
+			Allocator->Free(m_PyramidMemory);
+		}
+
+		m_PyramidSizes.clear();
+		m_PyramidValid = false;
+	}
+}   // namespace Fling
@@ -0,0 +1,313 @@
+#include "pch.h"
+#include "GpuProfiler.h"
+#include "LogicalDevice.h"
+#include "PhyscialDevice.h"
+#include "FlingConfig.h"
+
+namespace Fling
+{
+	namespace
+	{
+		/** The order of the flags is the order that the results are written in */
+		const VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+		VkQueryPool CreateQueryPool(VkDevice t_Device, VkQueryType t_Type, uint32 t_Count, VkQueryPipelineStatisticFlags t_Statistics = 0)
+		{
+			VkQueryPoolCreateInfo PoolInfo = {};
+			PoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			PoolInfo.queryType = t_Type;
+			PoolInfo.queryCount = t_Count;
+			PoolInfo.pipelineStatistics = t_Statistics;
+
+			VkQueryPool Pool = VK_NULL_HANDLE;
+			VK_CHECK_RESULT(vkCreateQueryPool(t_Device, &PoolInfo, nullptr, &Pool));
+			return Pool;
+		}
+	}
+
+	GpuProfiler::GpuProfiler(const LogicalDevice* t_Dev, uint32 t_FramesInFlight)
+		: m_Device(t_Dev)
+	{
+		assert(m_Device && m_Device->GetPhysicalDevice());
+		assert(t_FramesInFlight > 0);
+
+		const PhysicalDevice* PhysDevice = m_Device->GetPhysicalDevice();
+		VkDevice Device = m_Device->GetVkDevice();
+
+		// Timestamps are only supported if the graphics queue has some valid bits for them
+		uint32 QueueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(PhysDevice->GetVkPhysicalDevice(), &QueueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> QueueFamilies(QueueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(PhysDevice->GetVkPhysicalDevice(), &QueueFamilyCount, QueueFamilies.data());
+
+		const uint32 ValidBits = QueueFamilies[m_Device->GetGraphicsFamily()].timestampValidBits;
+		m_SupportsTimestamps = ValidBits > 0;
+		m_TimestampMask = ValidBits >= 64 ? ~0ull : ((1ull << ValidBits) - 1ull);
+		m_TimestampPeriod = static_cast<double>(PhysDevice->GetDeviceProps().limits.timestampPeriod);
+
+		// The feature is only enabled on the logical device if it is supported, @see LogicalDevice::CreateDevice
+		m_SupportsPipelineStatistics = m_SupportsTimestamps && PhysDevice->GetDeivceFeatures().pipelineStatisticsQuery;
+		m_SupportsInheritedStatistics = m_SupportsPipelineStatistics && PhysDevice->GetDeivceFeatures().inheritedQueries;
+
+		m_WantsEnabled = m_SupportsTimestamps && FlingConfig::GetBool("Vulkan", "GpuProfiling", true);
+		if (!m_SupportsTimestamps)
+		{
+			F_LOG_WARN("The graphics queue does not support timestamps, GPU pass timings will not be available");
+		}
+
+		m_Frames.resize(t_FramesInFlight);
+		for (FrameQueries& Frame : m_Frames)
+		{
+			Frame.IsScopeWritten.assign(MAX_SCOPES, false);
+			Frame.IsStatisticsActive.assign(MAX_SCOPES, false);
+
+			if (m_SupportsTimestamps)
+			{
+				Frame.Timestamps = CreateQueryPool(Device, VK_QUERY_TYPE_TIMESTAMP, MAX_SCOPES * 2);
+			}
+
+			if (m_SupportsPipelineStatistics)
+			{
+				Frame.Statistics = CreateQueryPool(Device, VK_QUERY_TYPE_PIPELINE_STATISTICS, MAX_SCOPES, PIPELINE_STATISTICS);
+			}
+		}
+
+		std::string DumpFile = FlingConfig::GetString("Vulkan", "GpuStatsDumpFile", "");
+		if (!DumpFile.empty())
+		{
+			StartDump(DumpFile);
+		}
+	}
+
+	GpuProfiler::~GpuProfiler()
+	{
+		StopDump();
+
+		VkDevice Device = m_Device->GetVkDevice();
+		for (FrameQueries& Frame : m_Frames)
+		{
+			if (Frame.Timestamps != VK_NULL_HANDLE)
+			{
+				vkDestroyQueryPool(Device, Frame.Timestamps, nullptr);
+			}
+
+			if (Frame.Statistics != VK_NULL_HANDLE)
+			{
+				vkDestroyQueryPool(Device, Frame.Statistics, nullptr);
+			}
+		}
+		m_Frames.clear();
+	}
+
+	GpuScopeId GpuProfiler::RegisterScope(const std::string& t_Name)
+	{
+		if (m_ScopeNames.size() >= MAX_SCOPES)
+		{
+			F_LOG_WARN("Too many GPU profiler scopes (max {})! {} will not be timed", MAX_SCOPES, t_Name);
+			return INVALID_GPU_SCOPE;
+		}
+
+		m_ScopeNames.emplace_back(t_Name);
+		return static_cast<GpuScopeId>(m_ScopeNames.size() - 1);
+	}
+
+	void GpuProfiler::BeginFrame(uint32 t_FrameInFlight)
+	{
+		assert(t_FrameInFlight < m_Frames.size());
+
+		FrameQueries& Frame = m_Frames[t_FrameInFlight];
+		VkDevice Device = m_Device->GetVkDevice();
+
+		m_Results.clear();
+
+		for (GpuScopeId Scope = 0; Scope < static_cast<GpuScopeId>(m_ScopeNames.size()); ++Scope)
+		{
+			if (!Frame.IsScopeWritten[Scope])
+			{
+				continue;
+			}
+			Frame.IsScopeWritten[Scope] = false;
+
+			// The frame fence has been waited on so these should always be ready, but never wait for them
+			// Each result is followed by its availability
+			uint64 Timestamps[4] = {};
+			VkResult Result = vkGetQueryPoolResults(
+				Device, Frame.Timestamps, Scope * 2, 2, sizeof(Timestamps), Timestamps, sizeof(uint64) * 2,
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+			if (Result != VK_SUCCESS || Timestamps[1] == 0 || Timestamps[3] == 0)
+			{
+				continue;
+			}
+
+			Stats::GpuPass Pass = {};
+			Pass.Name = m_ScopeNames[Scope];
+
+			const uint64 Start = Timestamps[0] & m_TimestampMask;
+			const uint64 End = Timestamps[2] & m_TimestampMask;
+			const uint64 Ticks = (End - Start) & m_TimestampMask;
+			Pass.TimeMs = static_cast<float>(static_cast<double>(Ticks) * m_TimestampPeriod / 1000000.0);
+
+			if (Frame.Statistics != VK_NULL_HANDLE)
+			{
+				uint64 Statistics[3] = {};
+				Result = vkGetQueryPoolResults(
+					Device, Frame.Statistics, Scope, 1, sizeof(Statistics), Statistics, sizeof(Statistics),
+					VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+				if (Result == VK_SUCCESS && Statistics[2] != 0)
+				{
+					Pass.VertexInvocations = Statistics[0];
+					Pass.FragmentInvocations = Statistics[1];
+				}
+			}
+
+			m_Results.emplace_back(std::move(Pass));
+		}
+
+		if (!m_Results.empty())
+		{
+			WriteDumpFrame(Frame.FrameNumber, m_Results);
+			Stats::Gpu::SetFrame(Frame.FrameNumber, m_Results);
+		}
+
+		Frame.FrameNumber = m_FrameNumber++;
+		m_IsEnabled = m_WantsEnabled;
+	}
+
+	void GpuProfiler::ResetScope(VkCommandBuffer t_Cmd, uint32 t_FrameInFlight, GpuScopeId t_Scope)
+	{
+		if (!m_IsEnabled || t_Scope == INVALID_GPU_SCOPE)
+		{
+			return;
+		}
+
+		const FrameQueries& Frame = m_Frames[t_FrameInFlight];
+		vkCmdResetQueryPool(t_Cmd, Frame.Timestamps, t_Scope * 2, 2);
+
+		if (Frame.Statistics != VK_NULL_HANDLE)
+		{
+			vkCmdResetQueryPool(t_Cmd, Frame.Statistics, t_Scope, 1);
+		}
+	}
+
+	void GpuProfiler::BeginScope(VkCommandBuffer t_Cmd, uint32 t_FrameInFlight, GpuScopeId t_Scope, bool t_ExecutesSecondaries)
+	{
+		if (!m_IsEnabled || t_Scope == INVALID_GPU_SCOPE)
+		{
+			return;
+		}
+
+		FrameQueries& Frame = m_Frames[t_FrameInFlight];
+		vkCmdWriteTimestamp(t_Cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, Frame.Timestamps, t_Scope * 2);
+
+		// Secondary command buffers can't be executed with a query active unless they inherit it
+		const bool CountStatistics = Frame.Statistics != VK_NULL_HANDLE && (!t_ExecutesSecondaries || m_SupportsInheritedStatistics);
+		if (CountStatistics)
+		{
+			vkCmdBeginQuery(t_Cmd, Frame.Statistics, t_Scope, 0);
+		}
+		Frame.IsStatisticsActive[t_Scope] = CountStatistics;
+	}
+
+	void GpuProfiler::EndScope(VkCommandBuffer t_Cmd, uint32 t_FrameInFlight, GpuScopeId t_Scope)
+	{
+		if (!m_IsEnabled || t_Scope == INVALID_GPU_SCOPE)
+		{
+			return;
+		}
+
+		FrameQueries& Frame = m_Frames[t_FrameInFlight];
+		if (Frame.IsStatisticsActive[t_Scope])
+		{
+			vkCmdEndQuery(t_Cmd, Frame.Statistics, t_Scope);
+			Frame.IsStatisticsActive[t_Scope] = false;
+		}
+
+		vkCmdWriteTimestamp(t_Cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, Frame.Timestamps, t_Scope * 2 + 1);
+		Frame.IsScopeWritten[t_Scope] = true;
+	}
+
+	VkQueryPipelineStatisticFlags GpuProfiler::GetInheritedStatistics() const
+	{
+		return (m_IsEnabled && m_SupportsInheritedStatistics) ? PIPELINE_STATISTICS : 0;
+	}
+
+	bool GpuProfiler::StartDump(const std::string& t_FilePath)
+	{
+		StopDump();
+
+		m_DumpFile.open(t_FilePath);
+		if (!m_DumpFile.is_open())
+		{
+			F_LOG_ERROR("Failed to open {} to write GPU stats to", t_FilePath);
+			return false;
+		}
+
+		const std::string JsonExtension = ".json";
+		m_IsDumpJson = t_FilePath.size() >= JsonExtension.size() &&
+			t_FilePath.compare(t_FilePath.size() - JsonExtension.size(), JsonExtension.size(), JsonExtension) == 0;
+		m_IsFirstDumpFrame = true;
+
+		if (m_IsDumpJson)
+		{
+			m_DumpFile << "{\"frames\":[";
+		}
+		else
+		{
+			m_DumpFile << "Frame,Pass,TimeMs,VertexInvocations,FragmentInvocations\n";
+		}
+
+		F_LOG_TRACE("Writing GPU stats to {}", t_FilePath);
+		return true;
+	}
+
+	void GpuProfiler::StopDump()
+	{
+		if (!m_DumpFile.is_open())
+		{
+			return;
+		}
+
+		if (m_IsDumpJson)
+		{
+			m_DumpFile << "\n]}\n";
+		}
+		m_DumpFile.close();
+	}
+
+	void GpuProfiler::WriteDumpFrame(uint64 t_FrameNumber, const std::vector<Stats::GpuPass>& t_Passes)
+	{
+		if (!m_DumpFile.is_open())
+		{
+			return;
+		}
+
+		if (m_IsDumpJson)
+		{
+			m_DumpFile << (m_IsFirstDumpFrame ? "\n" : ",\n") << "{\"frame\":" << t_FrameNumber << ",\"passes\":[";
+			for (size_t i = 0; i < t_Passes.size(); ++i)
+			{
+				const Stats::GpuPass& Pass = t_Passes[i];
+				m_DumpFile << (i == 0 ? "" : ",")
+					<< "{\"name\":\"" << Pass.Name
+					<< "\",\"timeMs\":" << Pass.TimeMs
+					<< ",\"vertexInvocations\":" << Pass.VertexInvocations
+					<< ",\"fragmentInvocations\":" << Pass.FragmentInvocations << "}";
+			}
+			m_DumpFile << "]}";
+		}
+		else
+		{
+			for (const Stats::GpuPass& Pass : t_Passes)
+			{
+				m_DumpFile << t_FrameNumber << "," << Pass.Name << "," << Pass.TimeMs << ","
+					<< Pass.VertexInvocations << "," << Pass.FragmentInvocations << "\n";
+			}
+		}
+
+		m_IsFirstDumpFrame = false;
+	}
+}   // namespace Fling
@@ -14,10 +14,15 @@ namespace Fling
             VkPhysicalDeviceMemoryProperties MemProperties;
             vkGetPhysicalDeviceMemoryProperties(t_PhysicalDevice, &MemProperties);
 
-            for (uint32 i = 0; i < MemProperties.memoryTypeCount; ++i)
+            return FindMemoryType(MemProperties, t_Filter, t_Props);
+        }
+
+        uint32 FindMemoryType(const VkPhysicalDeviceMemoryProperties& t_MemProperties, uint32 t_Filter, VkMemoryPropertyFlags t_Props)
+        {
+            for (uint32 i = 0; i < t_MemProperties.memoryTypeCount; ++i)
             {
                 // Check if this filter bit flag is set and it matches our memory properties
-                if ((t_Filter & (1 << i)) && (MemProperties.memoryTypes[i].propertyFlags & t_Props) == t_Props)
+                if ((t_Filter & (1 << i)) && (t_MemProperties.memoryTypes[i].propertyFlags & t_Props) == t_Props)
                 {
                     return i;
                 }
@@ -27,7 +32,7 @@ namespace Fling
             return 0;
         }
 
-        void CreateBuffer(VkDevice t_Device, VkPhysicalDevice t_PhysicalDevice, VkDeviceSize t_Size, VkBufferUsageFlags t_Usage, VkMemoryPropertyFlags t_Properties, VkBuffer& t_Buffer, VkDeviceMemory& t_BuffMemory)
+        void CreateBuffer(VkDevice t_Device, VkDeviceSize t_Size, VkBufferUsageFlags t_Usage, VkMemoryPropertyFlags t_Properties, VkBuffer& t_Buffer, DeviceAllocation& t_Allocation)
         {
             // Create a buffer
             VkBufferCreateInfo bufferInfo = {};
@@ -41,25 +46,9 @@ namespace Fling
                 F_LOG_FATAL("Failed to create buffer!");
             }
 
-            // Get the memory requirements
-            VkMemoryRequirements MemRequirments = {};
-            vkGetBufferMemoryRequirements(t_Device, t_Buffer, &MemRequirments);
-
-            VkMemoryAllocateInfo AllocInfo = {};
-            AllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            AllocInfo.allocationSize = MemRequirments.size;
-            // Using VK_MEMORY_PROPERTY_HOST_COHERENT_BIT may cause worse perf,
-            // we could use explicit flushing with vkFlushMappedMemoryRanges
-            AllocInfo.memoryTypeIndex = GraphicsHelpers::FindMemoryType(t_PhysicalDevice, MemRequirments.memoryTypeBits, t_Properties);
-
-            // Allocate the vertex buffer memory
-            // #TODO Don't call vkAllocateMemory every time, we should use a custom allocator or
-            // VulkanMemoryAllocator library
-            if (vkAllocateMemory(t_Device, &AllocInfo, nullptr, &t_BuffMemory) != VK_SUCCESS)
-            {
-                F_LOG_FATAL("Failed to alocate buffer memory!");
-            }
-            vkBindBufferMemory(t_Device, t_Buffer, t_BuffMemory, 0);
+            DeviceMemoryAllocator* Allocator = VulkanApp::Get().GetMemoryAllocator();
+            assert(Allocator);
+            t_Allocation = Allocator->AllocateForBuffer(t_Buffer, t_Properties, DeviceMemoryAllocator::GetBufferCategory(t_Usage, t_Properties));
         }
 
         VkCommandBuffer BeginSingleTimeCommands()
@@ -116,7 +105,7 @@ namespace Fling
             VkImageUsageFlags t_Useage, 
             VkMemoryPropertyFlags t_Props, 
             VkImage& t_Image,
-            VkDeviceMemory& t_Memory,
+            DeviceAllocation& t_Memory,
 			VkSampleCountFlagBits t_NumSamples
         )
         {
@@ -151,14 +140,13 @@ namespace Fling
             VkMemoryPropertyFlags t_Props, 
             VkImageCreateFlags t_flags,
             VkImage& t_Image, 
-            VkDeviceMemory& t_Memory, 
+            DeviceAllocation& t_Memory, 
             VkSampleCountFlagBits t_NumSamples
             )
         {
             VkDevice Device = t_Dev;
-			PhysicalDevice* Phys = VulkanApp::Get().GetPhysicalDevice();
-			assert(Phys);
-            VkPhysicalDevice PhysDevice = Phys->GetVkPhysicalDevice();
+            DeviceMemoryAllocator* Allocator = VulkanApp::Get().GetMemoryAllocator();
+            assert(Allocator);
 
             VkImageCreateInfo imageInfo = {};
             imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -184,20 +172,10 @@ namespace Fling
                 F_LOG_FATAL("Failed to create image!");
             }
 
-            VkMemoryRequirements memRequirements;
-            vkGetImageMemoryRequirements(Device, t_Image, &memRequirements);
-
-            VkMemoryAllocateInfo allocInfo = {};
-            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            allocInfo.allocationSize = memRequirements.size;
-            allocInfo.memoryTypeIndex = GraphicsHelpers::FindMemoryType(PhysDevice, memRequirements.memoryTypeBits, t_Props);
-
-            if (vkAllocateMemory(Device, &allocInfo, nullptr, &t_Memory) != VK_SUCCESS)
-            {
-                F_LOG_FATAL("Failed to allocate image memory!");
-            }
+            const bool IsAttachment = (t_Useage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
+            const DeviceMemoryCategory Category = IsAttachment ? DeviceMemoryCategory::RenderTarget : DeviceMemoryCategory::Texture;
 
-            VK_CHECK_RESULT(vkBindImageMemory(Device, t_Image, t_Memory, 0));
+            t_Memory = Allocator->AllocateForImage(t_Image, t_Props, Category, t_Tiling == VK_IMAGE_TILING_LINEAR);
         }
 
 		VkSemaphore CreateSemaphore(VkDevice t_Dev)
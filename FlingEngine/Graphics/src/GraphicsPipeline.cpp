@@ -12,7 +12,8 @@ namespace Fling
         Depth t_Depth,
         VkPrimitiveTopology t_Topology,
         VkCullModeFlags t_CullMode,
-        VkFrontFace t_FrontFace) :
+        VkFrontFace t_FrontFace,
+        uint32 t_DynamicUniformBindings) :
         m_Shaders(t_Shaders),
         m_Device(t_LogicalDevice),
         m_PolygonMode(t_Mode),
@@ -21,7 +22,7 @@ namespace Fling
         m_CullMode(t_CullMode),
         m_FrontFace(t_FrontFace)
     {
-		m_DescriptorSetLayout = Shader::CreateSetLayout(m_Device, m_Shaders);
+		m_DescriptorSetLayout = Shader::CreateSetLayout(m_Device, m_Shaders, false, t_DynamicUniformBindings);
 		m_PipelineLayout = Shader::CreatePipelineLayout(m_Device, m_DescriptorSetLayout, 0, 0);
 		
 		CreateAttributes(nullptr);
@@ -32,6 +33,17 @@ namespace Fling
         vkCmdBindPipeline(t_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline);
     }
 
+    void GraphicsPipeline::SetExtraSetLayouts(const std::vector<VkDescriptorSetLayout>& t_Layouts)
+    {
+        assert(m_Pipeline == VK_NULL_HANDLE);
+
+        std::vector<VkDescriptorSetLayout> Layouts = { m_DescriptorSetLayout };
+        Layouts.insert(Layouts.end(), t_Layouts.begin(), t_Layouts.end());
+
+        vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
+        m_PipelineLayout = Shader::CreatePipelineLayout(m_Device, Layouts, 0, 0);
+    }
+
     void GraphicsPipeline::CreateAttributes(Multisampler* t_Sampler)
     {
         // Input Assembly 
@@ -115,12 +127,16 @@ namespace Fling
         }
 
         // Vertex Input 
-        VkVertexInputBindingDescription BindingDescription = Vertex::GetBindingDescription();
-        std::array<VkVertexInputAttributeDescription, 5> AttributeDescriptions = Vertex::GetAttributeDescriptions();
+        std::vector<VkVertexInputBindingDescription> BindingDescriptions = { Vertex::GetBindingDescription() };
+        BindingDescriptions.insert(BindingDescriptions.end(), m_ExtraVertexBindings.begin(), m_ExtraVertexBindings.end());
+
+        std::array<VkVertexInputAttributeDescription, 5> VertexAttributes = Vertex::GetAttributeDescriptions();
+        std::vector<VkVertexInputAttributeDescription> AttributeDescriptions(VertexAttributes.begin(), VertexAttributes.end());
+        AttributeDescriptions.insert(AttributeDescriptions.end(), m_ExtraVertexAttributes.begin(), m_ExtraVertexAttributes.end());
 
         m_VertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        m_VertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
-        m_VertexInputStateCreateInfo.pVertexBindingDescriptions = &BindingDescription;
+        m_VertexInputStateCreateInfo.vertexBindingDescriptionCount = static_cast<uint32>(BindingDescriptions.size());
+        m_VertexInputStateCreateInfo.pVertexBindingDescriptions = BindingDescriptions.data();
         m_VertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32>(AttributeDescriptions.size());
         m_VertexInputStateCreateInfo.pVertexAttributeDescriptions = AttributeDescriptions.data();
 
@@ -11,6 +11,8 @@
 #include "FirstPersonCamera.h"
 #include "FlingVulkan.h"
 #include "BaseEditor.h"
+#include "VulkanApp.h"
+#include "UploadManager.h"
 
 #include <imgui.h>
 #include <algorithm>
@@ -59,7 +61,7 @@ namespace Fling
 
 		vkDestroyImage(logicalDevice, m_fontImage, nullptr);
 		vkDestroyImageView(logicalDevice, m_fontImageView, nullptr);
-		vkFreeMemory(logicalDevice, m_fontMemory, nullptr);
+		VulkanApp::Get().GetMemoryAllocator()->Free(m_fontMemory);
 		vkDestroySampler(logicalDevice, m_sampler, nullptr);
 		vkDestroyPipelineCache(logicalDevice, m_pipelineCache, nullptr);
 		vkDestroyPipeline(logicalDevice, m_pipeLine, nullptr);
@@ -70,6 +72,8 @@ namespace Fling
 
 	void ImGuiSubpass::Draw(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight, entt::registry& t_reg, float DeltaTime)
 	{
+		FLING_PROFILE_SCOPE("ImGuiSubpass::Draw");
+
 		ImGui::NewFrame();
 
 		if (m_Editor)
@@ -79,12 +83,12 @@ namespace Fling
 
 		ImGui::Render();
 
-		UpdateUniforms();
+		UpdateUniforms(t_ActiveFrameInFlight);
 
-		BuildCommandBuffer(t_CmdBuf.GetHandle());
+		BuildCommandBuffer(t_CmdBuf.GetHandle(), t_ActiveFrameInFlight);
 	}
 
-	void ImGuiSubpass::BuildCommandBuffer(VkCommandBuffer t_commandBuffer)
+	void ImGuiSubpass::BuildCommandBuffer(VkCommandBuffer t_commandBuffer, uint32 t_ActiveFrameInFlight)
 	{
 		ImGuiIO& io = ImGui::GetIO();
 
@@ -126,12 +130,12 @@ namespace Fling
 				t_commandBuffer,
 				0,
 				1,
-				&m_vertexBuffer->GetVkBuffer(),
+				&m_vertexBuffers[t_ActiveFrameInFlight]->GetVkBuffer(),
 				offsets);
 
 			vkCmdBindIndexBuffer(
 				t_commandBuffer,
-				m_indexBuffer->GetVkBuffer(),
+				m_indexBuffers[t_ActiveFrameInFlight]->GetVkBuffer(),
 				0,
 				VK_INDEX_TYPE_UINT16);
 
@@ -156,7 +160,7 @@ namespace Fling
 		}
 	}
 
-	void ImGuiSubpass::CreateDescriptorSets(VkDescriptorPool t_Pool, entt::registry& t_reg)
+	void ImGuiSubpass::CreateDescriptorSets(DescriptorAllocator& t_Allocator, entt::registry& t_reg)
 	{
 		
 	}
@@ -193,51 +197,15 @@ namespace Fling
 			VK_IMAGE_ASPECT_COLOR_BIT
 		);
 
-		Buffer stagingBuffer = Buffer(
-			uploadSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			fontData);
-
-		//Copy buffer data to font image
-		VkCommandBuffer copycmd = GraphicsHelpers::BeginSingleTimeCommands();
+		// Copy the font data to the image with the next upload batch
+		ImageUpload FontUpload = {};
+		FontUpload.Image = m_fontImage;
+		FontUpload.Format = VK_FORMAT_R8G8B8A8_UNORM;
+		FontUpload.Width = static_cast<uint32>(texWidth);
+		FontUpload.Height = static_cast<uint32>(texHeight);
+		FontUpload.FinalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		GraphicsHelpers::SetImageLayout(
-			copycmd,
-			m_fontImage,
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_PIPELINE_STAGE_HOST_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT);
-
-		//Copy
-		VkBufferImageCopy bufferCopyRegion = {};
-		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.width = texWidth;
-		bufferCopyRegion.imageExtent.height = texHeight;
-		bufferCopyRegion.imageExtent.depth = 1;
-
-		vkCmdCopyBufferToImage(
-			copycmd,
-			stagingBuffer.GetVkBuffer(),
-			m_fontImage,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&bufferCopyRegion
-		);
-
-		GraphicsHelpers::SetImageLayout(
-			copycmd,
-			m_fontImage,
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-
-		GraphicsHelpers::EndSingleTimeCommands(copycmd);
+		VulkanApp::Get().GetUploadManager()->UploadImage(FontUpload, fontData, uploadSize);
 
 		Fling::GraphicsHelpers::CreateVkSampler(
 			VK_FILTER_LINEAR,
@@ -434,12 +402,21 @@ namespace Fling
 
 	void ImGuiSubpass::PrepareResources()
 	{
-		// Create vert and index buffers for use with imgui geometry
-		m_indexBuffer = std::make_unique<Buffer>();
-		m_vertexBuffer = std::make_unique<Buffer>();
+		// Create vert and index buffers for use with imgui geometry for each frame in flight
+		const uint32 FramesInFlight = VulkanApp::Get().GetFramesInFlight();
+		m_vertexBuffers.resize(FramesInFlight);
+		m_indexBuffers.resize(FramesInFlight);
+		m_vertexCounts.assign(FramesInFlight, 0);
+		m_indexCounts.assign(FramesInFlight, 0);
+
+		for (uint32 i = 0; i < FramesInFlight; ++i)
+		{
+			m_vertexBuffers[i] = std::make_unique<Buffer>();
+			m_indexBuffers[i] = std::make_unique<Buffer>();
+		}
 	}
 	
-	void ImGuiSubpass::UpdateUniforms()
+	void ImGuiSubpass::UpdateUniforms(uint32 t_ActiveFrameInFlight)
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
 
@@ -451,30 +428,34 @@ namespace Fling
 			return;
 		}
 
-		if ((m_vertexBuffer->GetVkBuffer() == VK_NULL_HANDLE) ||
-			(m_vertexCount != imDrawData->TotalVtxCount))
+		// The fence for this frame has already been waited on, so it is safe to recreate these buffers
+		std::unique_ptr<Buffer>& VertexBuffer = m_vertexBuffers[t_ActiveFrameInFlight];
+		std::unique_ptr<Buffer>& IndexBuffer = m_indexBuffers[t_ActiveFrameInFlight];
+
+		if ((VertexBuffer->GetVkBuffer() == VK_NULL_HANDLE) ||
+			(m_vertexCounts[t_ActiveFrameInFlight] != imDrawData->TotalVtxCount))
 		{
-			m_vertexBuffer->UnmapMemory();
-			m_vertexBuffer->Release();
+			VertexBuffer->UnmapMemory();
+			VertexBuffer->Release();
 
-			m_vertexBuffer->CreateBuffer(vertexBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true);
-			m_vertexCount = imDrawData->TotalVtxCount;
-			m_vertexBuffer->MapMemory();
+			VertexBuffer->CreateBuffer(vertexBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true);
+			m_vertexCounts[t_ActiveFrameInFlight] = imDrawData->TotalVtxCount;
+			VertexBuffer->MapMemory();
 		}
 
-		if ((m_indexBuffer->GetVkBuffer() == VK_NULL_HANDLE) ||
-			(m_indexCount < imDrawData->TotalIdxCount))
+		if ((IndexBuffer->GetVkBuffer() == VK_NULL_HANDLE) ||
+			(m_indexCounts[t_ActiveFrameInFlight] < imDrawData->TotalIdxCount))
 		{
-			m_indexBuffer->UnmapMemory();
-			m_indexBuffer->Release();
+			IndexBuffer->UnmapMemory();
+			IndexBuffer->Release();
 
-			m_indexBuffer->CreateBuffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true);
-			m_indexCount = imDrawData->TotalIdxCount;
-			m_indexBuffer->MapMemory();
+			IndexBuffer->CreateBuffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true);
+			m_indexCounts[t_ActiveFrameInFlight] = imDrawData->TotalIdxCount;
+			IndexBuffer->MapMemory();
 		}
 
-		ImDrawVert* vtxDst = (ImDrawVert*)m_vertexBuffer->m_MappedMem;
-		ImDrawIdx* idxDst = (ImDrawIdx*)m_indexBuffer->m_MappedMem;
+		ImDrawVert* vtxDst = (ImDrawVert*)VertexBuffer->m_MappedMem;
+		ImDrawIdx* idxDst = (ImDrawIdx*)IndexBuffer->m_MappedMem;
 
 		for (int n = 0; n < imDrawData->CmdListsCount; ++n) {
 			const ImDrawList* cmd_list = imDrawData->CmdLists[n];
@@ -484,7 +465,7 @@ namespace Fling
 			idxDst += cmd_list->IdxBuffer.Size;
 		}
 
-		m_vertexBuffer->Flush(VK_WHOLE_SIZE, 0);
-		m_indexBuffer->Flush(VK_WHOLE_SIZE, 0);
+		VertexBuffer->Flush(VK_WHOLE_SIZE, 0);
+		IndexBuffer->Flush(VK_WHOLE_SIZE, 0);
 	}
 }   // namespace Fling
\ No newline at end of file
@@ -116,6 +116,21 @@ namespace Fling
 
 		std::vector<const char*> extensions( glfwExtensions, glfwExtensions + glfwExtensionCount );
 
+		// Needed to ask the physical device about features newer than 1.0, like descriptor indexing
+		uint32 availableCount = 0;
+		vkEnumerateInstanceExtensionProperties( nullptr, &availableCount, nullptr );
+		std::vector<VkExtensionProperties> available( availableCount );
+		vkEnumerateInstanceExtensionProperties( nullptr, &availableCount, available.data() );
+		for( const VkExtensionProperties& extension : available )
+		{
+			if( strcmp( extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME ) == 0 )
+			{
+				extensions.push_back( VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME );
+				m_HasPhysicalDeviceProperties2 = true;
+				break;
+			}
+		}
+
 		if( m_EnableValidationLayers ) 
 		{
 #if FLING_DEBUG
@@ -2,6 +2,7 @@
 #include "LogicalDevice.h"
 #include "Instance.h"
 #include "PhyscialDevice.h"
+#include "FlingConfig.h"
 
 namespace Fling
 {
@@ -31,7 +32,7 @@ namespace Fling
 		for (uint32_t i = 0; i < QueueFamilyCount; ++i)
 		{
 			// Check for graphics support.
-			if (QueueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			if (!graphicsFamily && (QueueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
 			{
 				graphicsFamily = i;
 				m_GraphicsFamily = i;
@@ -42,31 +43,29 @@ namespace Fling
 			VkBool32 presentSupport;
 			vkGetPhysicalDeviceSurfaceSupportKHR(m_PhysicalDevice->GetVkPhysicalDevice(), i, m_Surface, &presentSupport);
 
-			if (QueueFamilies[i].queueCount > 0 && presentSupport)
+			if (!presentFamily && QueueFamilies[i].queueCount > 0 && presentSupport)
 			{
 				presentFamily = i;
 				m_PresentFamily = i;
 			}
 
 			// Check for compute support.
-			if (QueueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT)
+			if (!computeFamily && (QueueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT))
 			{
 				computeFamily = i;
 				m_ComputeFamily = i;
 				m_SupportedQueues |= VK_QUEUE_COMPUTE_BIT;
 			}
 
-			// Check for transfer support.
-			if (QueueFamilies[i].queueFlags & VK_QUEUE_TRANSFER_BIT)
+			// Check for transfer support. Prefer a family without graphics or compute, which
+			// is usually a DMA engine that can copy while the graphics queue is busy
+			if (QueueFamilies[i].queueCount > 0 && (QueueFamilies[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && 
+				!(QueueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
 			{
-				transferFamily = i;
-				m_TransferFamily = i;
-				m_SupportedQueues |= VK_QUEUE_TRANSFER_BIT;
-			}
-
-			if (graphicsFamily && presentFamily && computeFamily && transferFamily)
-			{
-				break;
+				if (!transferFamily || !(QueueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT))
+				{
+					transferFamily = i;
+				}
 			}
 		}
 
@@ -74,11 +73,20 @@ namespace Fling
 		{
 			F_LOG_FATAL("Failed to find queue family supporting VK_QUEUE_GRAPHICS_BIT");
 		}
+
+		// Graphics queues can always do transfers
+		m_TransferFamily = transferFamily ? *transferFamily : m_GraphicsFamily;
+		m_SupportedQueues |= VK_QUEUE_TRANSFER_BIT;
+
+		if (HasDedicatedTransferQueue())
+		{
+			F_LOG_TRACE("Using dedicated transfer queue family {}", m_TransferFamily);
+		}
 	}
 
 	void LogicalDevice::CreateDevice()
     {
-        std::set<uint32> UniqueQueueFamilies = { m_GraphicsFamily, m_PresentFamily };
+        std::set<uint32> UniqueQueueFamilies = { m_GraphicsFamily, m_PresentFamily, m_TransferFamily };
 
         // Generate the CreatinInfo for each queue family 
 		std::vector<VkDeviceQueueCreateInfo> QueueCreateInfos;
@@ -98,17 +106,52 @@ namespace Fling
 		DevicesFeatures.samplerAnisotropy = VK_TRUE;
 		DevicesFeatures.sampleRateShading = VK_TRUE;
 
+		// Used by the GPU profiler to count shader invocations of each subpass
+		DevicesFeatures.pipelineStatisticsQuery = m_PhysicalDevice->GetDeivceFeatures().pipelineStatisticsQuery;
+
+		// Lets secondary command buffers be executed while one of those queries is active
+		DevicesFeatures.inheritedQueries = m_PhysicalDevice->GetDeivceFeatures().inheritedQueries;
+
+		// Lets the G-Buffer draw every batch of a material with one indirect draw out of the mesh arena
+		DevicesFeatures.multiDrawIndirect = m_PhysicalDevice->GetDeivceFeatures().multiDrawIndirect;
+		DevicesFeatures.drawIndirectFirstInstance = m_PhysicalDevice->GetDeivceFeatures().drawIndirectFirstInstance;
+
+		std::vector<const char*> Extensions = m_Instance->GetEnabledExtensions();
+
+		// Makes a full descriptor pool return VK_ERROR_OUT_OF_POOL_MEMORY instead of being invalid usage, @see DescriptorAllocator
+		m_Maintenance1Enabled = m_PhysicalDevice->HasExtension(VK_KHR_MAINTENANCE1_EXTENSION_NAME);
+		if (m_Maintenance1Enabled)
+		{
+			Extensions.emplace_back(VK_KHR_MAINTENANCE1_EXTENSION_NAME);
+		}
+
+		// Lets every texture be sampled out of one array that is indexed per material, @see BindlessTextures
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT IndexingFeatures = {};
+		IndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		m_DescriptorIndexingEnabled = FlingConfig::GetBool("Vulkan", "BindlessTextures", true) && m_PhysicalDevice->SupportsBindlessTextures();
+		if (m_DescriptorIndexingEnabled)
+		{
+			Extensions.emplace_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+			Extensions.emplace_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+			IndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+			IndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+			IndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+			IndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			IndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		}
 
         // Device creation 
         VkDeviceCreateInfo CreateInfo = {};
         CreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        CreateInfo.pNext = m_DescriptorIndexingEnabled ? &IndexingFeatures : nullptr;
         CreateInfo.queueCreateInfoCount = static_cast<uint32>(QueueCreateInfos.size());
         CreateInfo.pQueueCreateInfos = QueueCreateInfos.data();
         CreateInfo.pEnabledFeatures = &DevicesFeatures;
 
         // Set the enabled extensions
-        CreateInfo.enabledExtensionCount = static_cast<uint32>(m_Instance->GetEnabledExtensions().size());
-        CreateInfo.ppEnabledExtensionNames = m_Instance->GetEnabledExtensions().data();
+        CreateInfo.enabledExtensionCount = static_cast<uint32>(Extensions.size());
+        CreateInfo.ppEnabledExtensionNames = Extensions.data();
 
         if( m_Instance->IsValidationEnabled() ) 
         {
@@ -125,8 +168,19 @@ namespace Fling
             F_LOG_FATAL( "Failed to create logical Device!" );
         }
 
+        if (m_DescriptorIndexingEnabled)
+        {
+            F_LOG_TRACE("Descriptor indexing enabled, textures are bindless");
+        }
+
+        if (!m_Maintenance1Enabled)
+        {
+            F_LOG_TRACE("VK_KHR_maintenance1 is not supported, descriptor pools are only kept from overflowing by the descriptor allocator");
+        }
+
         vkGetDeviceQueue(m_Device, m_GraphicsFamily, 0, &m_GraphicsQueue);
         vkGetDeviceQueue(m_Device, m_PresentFamily, 0, &m_PresentQueue);
+        vkGetDeviceQueue(m_Device, m_TransferFamily, 0, &m_TransferQueue);
     }
 
 	void LogicalDevice::WaitForIdle()
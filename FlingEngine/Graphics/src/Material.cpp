@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "Material.h"
 #include "ResourceManager.h"
+#include "Model.h"
 #include <unordered_map>
 
 namespace Fling
@@ -23,9 +24,54 @@ namespace Fling
 		return Material::Create("Materials/Default.mat");
 	}
 
+    std::unique_ptr<Material::LoadData> Material::Decode(Guid t_ID)
+    {
+        std::unique_ptr<LoadData> Data = std::make_unique<LoadData>();
+        if (!ReadJsonFile(Resource::GetFilepathReleativeToAssets(t_ID), Data->Json))
+        {
+            return Data;
+        }
+
+        // Get the textures decoding in parallel, LoadMaterial will join these loads
+        if (GetTypeFromStr(Data->Json.value("pipeline", "DEFAULT")) == Material::Type::Default)
+        {
+            for (const char* Key : { "albedo", "normal", "metal", "rough" })
+            {
+                auto It = Data->Json.find(Key);
+                if (It != Data->Json.end() && It->is_string())
+                {
+                    const std::string& TexturePath = It->get_ref<const std::string&>();
+                    ResourceManager::LoadResourceAsync<Texture>(HS(TexturePath.c_str()));
+                }
+            }
+        }
+
+        // Occluders are only used on the CPU, so they are decoded here instead of being a Model resource
+        auto OccluderIt = Data->Json.find("occluder");
+        if (OccluderIt != Data->Json.end() && OccluderIt->is_string())
+        {
+            const std::string& OccluderPath = OccluderIt->get_ref<const std::string&>();
+            if (!Model::DecodeOccluder(HS(OccluderPath.c_str()), Data->Occluder))
+            {
+                F_LOG_WARN("Material {} has an occluder {} with no triangles", Resource::GetFilepathReleativeToAssets(t_ID), OccluderPath);
+            }
+        }
+
+        return Data;
+    }
+
     Material::Material(Guid t_ID)
-        : JsonFile(t_ID)
+        : Material(t_ID, Decode(t_ID))
+    {
+    }
+
+    Material::Material(Guid t_ID, std::unique_ptr<LoadData> t_Data)
+        : JsonFile(t_ID, t_Data ? std::move(t_Data->Json) : nlohmann::json {})
     {
+        if (t_Data)
+        {
+            m_Occluder = std::move(t_Data->Occluder);
+        }
         LoadMaterial();
     }
 
@@ -45,19 +91,19 @@ namespace Fling
             // Load Textures -------------
             // Albedo
             const std::string& AlbedoPath = m_JsonData["albedo"];
-            m_Textures.m_AlbedoTexture = Texture::Create(HS(AlbedoPath.c_str())).get();
+            m_Textures.m_AlbedoTexture = ResourceManager::LoadHandle<Texture>(HS(AlbedoPath.c_str()));
 
             // Normal
             const std::string& NormalPath = m_JsonData["normal"];
-            m_Textures.m_NormalTexture = Texture::Create(HS(NormalPath.c_str())).get();
+            m_Textures.m_NormalTexture = ResourceManager::LoadHandle<Texture>(HS(NormalPath.c_str()));
 
             // Metal
             const std::string& MetalPath = m_JsonData["metal"];
-            m_Textures.m_MetalTexture = Texture::Create(HS(MetalPath.c_str())).get();
+            m_Textures.m_MetalTexture = ResourceManager::LoadHandle<Texture>(HS(MetalPath.c_str()));
 
             // Rough
             const std::string& RoughPath = m_JsonData["rough"];
-            m_Textures.m_RoughnessTexture = Texture::Create(HS(RoughPath.c_str())).get();
+            m_Textures.m_RoughnessTexture = ResourceManager::LoadHandle<Texture>(HS(RoughPath.c_str()));
         }
         catch (std::exception& e)
         {
@@ -68,9 +114,11 @@ namespace Fling
 
 	Material::Type Material::GetTypeFromStr(const std::string& t_Str)
 	{
-		if (TypeMap.find(t_Str) != TypeMap.end())
+		// Only read from the map, this is called from loader threads too
+		auto It = TypeMap.find(t_Str);
+		if (It != TypeMap.end())
 		{
-			return TypeMap[t_Str];
+			return It->second;
 		}
 
 		return Type::Default;
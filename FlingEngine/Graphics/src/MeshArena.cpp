@@ -0,0 +1,270 @@
+#include "pch.h"
+#include "MeshArena.h"
+#include "Buffer.h"
+#include "LogicalDevice.h"
+
+#include <algorithm>
+
+namespace Fling
+{
+	MeshArena::MeshArena(const LogicalDevice* t_Dev, UploadManager* t_Uploader, uint32 t_FramesInFlight, VkDeviceSize t_VertexBytes, VkDeviceSize t_IndexBytes)
+		: m_Device(t_Dev)
+		, m_Uploader(t_Uploader)
+		, m_FramesInFlight(std::max(t_FramesInFlight, 1u))
+	{
+		assert(m_Device && m_Uploader);
+
+		CreatePool(VERTEX_POOL, t_VertexBytes, sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		CreatePool(INDEX_POOL, t_IndexBytes, sizeof(uint32), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	}
+
+	MeshArena::~MeshArena()
+	{
+		const uint32 MeshCount = static_cast<uint32>(m_Meshes.size() - m_FreeHandles.size());
+		if (MeshCount > 0)
+		{
+			F_LOG_WARN("Mesh arena destroyed with {} meshes still in it!", MeshCount);
+		}
+
+		m_RetiredBuffers.clear();
+		for (Pool& P : m_Pools)
+		{
+			P.Buf.reset();
+			P.Allocator.reset();
+		}
+	}
+
+	void MeshArena::CreatePool(PoolType t_Type, VkDeviceSize t_Bytes, uint32 t_Stride, VkBufferUsageFlags t_Usage)
+	{
+		Pool& P = m_Pools[t_Type];
+		P.Stride = t_Stride;
+
+		// Transfer source so that it can be copied out of when it is recreated
+		P.Usage = t_Usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+		const uint64 Capacity = std::max<uint64>(t_Bytes / t_Stride, 1);
+		P.Buf = std::make_unique<Buffer>(Capacity * t_Stride, P.Usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		P.Allocator = std::make_unique<TlsfAllocator>(Capacity);
+	}
+
+	MeshArena::Handle MeshArena::Add(const Vertex* t_Verts, uint32 t_VertexCount, const uint32* t_Indices, uint32 t_IndexCount)
+	{
+		if (!t_Verts || !t_Indices || t_VertexCount == 0 || t_IndexCount == 0)
+		{
+			return INVALID_HANDLE;
+		}
+
+		Handle NewHandle = INVALID_HANDLE;
+		if (!m_FreeHandles.empty())
+		{
+			NewHandle = m_FreeHandles.back();
+			m_FreeHandles.pop_back();
+		}
+		else
+		{
+			NewHandle = static_cast<Handle>(m_Meshes.size());
+			m_Meshes.emplace_back();
+		}
+
+		// In use before the ranges are allocated, so that rebuilding the index buffer still moves this mesh's vertices
+		Mesh& New = m_Meshes[NewHandle];
+		New = {};
+		New.InUse = true;
+		New.MeshRange.VertexCount = t_VertexCount;
+		New.MeshRange.IndexCount = t_IndexCount;
+
+		const void* Data[POOL_COUNT] = { t_Verts, t_Indices };
+		for (uint32 Type = 0; Type < POOL_COUNT; ++Type)
+		{
+			const PoolType PType = static_cast<PoolType>(Type);
+			const uint32 Count = GetCount(New.MeshRange, PType);
+
+			// A rebuild in here skips this range, its allocation isn't valid until it is stored
+			TlsfAllocator::Allocation Alloc = Allocate(PType, Count);
+			New.Allocs[Type] = Alloc;
+			GetFirst(New.MeshRange, PType) = static_cast<uint32>(Alloc.Offset);
+
+			const Pool& P = m_Pools[Type];
+			m_Uploader->UploadBuffer(P.Buf.get(), Data[Type], static_cast<VkDeviceSize>(Count) * P.Stride, Alloc.Offset * P.Stride);
+		}
+
+		return NewHandle;
+	}
+
+	void MeshArena::Remove(Handle t_Mesh)
+	{
+		if (t_Mesh == INVALID_HANDLE || t_Mesh >= m_Meshes.size() || !m_Meshes[t_Mesh].InUse)
+		{
+			return;
+		}
+
+		Mesh& Removed = m_Meshes[t_Mesh];
+		for (uint32 Type = 0; Type < POOL_COUNT; ++Type)
+		{
+			if (Removed.Allocs[Type].IsValid())
+			{
+				m_Pools[Type].Allocator->Free(Removed.Allocs[Type]);
+			}
+		}
+
+		Removed = {};
+		m_FreeHandles.emplace_back(t_Mesh);
+	}
+
+	void MeshArena::Bind(VkCommandBuffer t_Cmd) const
+	{
+		VkBuffer VertexBuffer = GetVertexBuffer()->GetVkBuffer();
+		VkDeviceSize Offset = 0;
+		vkCmdBindVertexBuffers(t_Cmd, 0, 1, &VertexBuffer, &Offset);
+		vkCmdBindIndexBuffer(t_Cmd, GetIndexBuffer()->GetVkBuffer(), 0, GetIndexType());
+	}
+
+	void MeshArena::Compact()
+	{
+		for (uint32 Type = 0; Type < POOL_COUNT; ++Type)
+		{
+			// A single free region already has all of the free space, compacting wouldn't make room for anything more
+			if (m_Pools[Type].Allocator->GetFreeRegionCount() > 1)
+			{
+				Rebuild(static_cast<PoolType>(Type), m_Pools[Type].Allocator->GetSize());
+			}
+		}
+	}
+
+	void MeshArena::Update()
+	{
+		for (RetiredBuffer& Retired : m_RetiredBuffers)
+		{
+			if (Retired.FramesLeft > 0)
+			{
+				--Retired.FramesLeft;
+			}
+		}
+
+		m_RetiredBuffers.erase(
+			std::remove_if(m_RetiredBuffers.begin(), m_RetiredBuffers.end(), [this](const RetiredBuffer& t_Retired)
+			{
+				return t_Retired.FramesLeft == 0 && m_Uploader->IsComplete(t_Retired.Ticket);
+			}),
+			m_RetiredBuffers.end());
+	}
+
+	MeshArenaStats MeshArena::GetStats() const
+	{
+		MeshArenaStats Stats = {};
+		Stats.VertexBytes = GetVertexBuffer()->GetSize();
+		Stats.IndexBytes = GetIndexBuffer()->GetSize();
+		Stats.VertexBytesUsed = m_Pools[VERTEX_POOL].Allocator->GetUsedBytes() * m_Pools[VERTEX_POOL].Stride;
+		Stats.IndexBytesUsed = m_Pools[INDEX_POOL].Allocator->GetUsedBytes() * m_Pools[INDEX_POOL].Stride;
+		Stats.MeshCount = static_cast<uint32>(m_Meshes.size() - m_FreeHandles.size());
+		Stats.RebuildCount = m_RebuildCount;
+
+		for (const Pool& P : m_Pools)
+		{
+			Stats.FreeRegionCount += P.Allocator->GetFreeRegionCount();
+		}
+		return Stats;
+	}
+
+	TlsfAllocator::Allocation MeshArena::Allocate(PoolType t_Type, uint32 t_Count)
+	{
+		TlsfAllocator::Allocation Alloc = m_Pools[t_Type].Allocator->Allocate(t_Count);
+
+		bool Compacted = false;
+		while (!Alloc.IsValid())
+		{
+			const TlsfAllocator& Allocator = *m_Pools[t_Type].Allocator;
+			uint64 Capacity = Allocator.GetSize();
+
+			// Compacting is enough if the room is only split up. If it would still be almost full, grow so
+			// that the next few meshes don't copy everything again
+			const uint64 Needed = Allocator.GetUsedBytes() + t_Count;
+			if (Compacted || Needed > Capacity - Capacity / 4)
+			{
+				Capacity = std::max(Capacity * 2, Needed);
+			}
+
+			Rebuild(t_Type, Capacity);
+			Compacted = true;
+
+			Alloc = m_Pools[t_Type].Allocator->Allocate(t_Count);
+		}
+
+		return Alloc;
+	}
+
+	void MeshArena::Rebuild(PoolType t_Type, uint64 t_Capacity)
+	{
+		FLING_PROFILE_SCOPE("MeshArena::Rebuild");
+
+		Pool& P = m_Pools[t_Type];
+
+		// Meshes keep their order, so a fresh allocator puts each one right after the last
+		std::vector<Handle> Live;
+		for (Handle i = 0; i < static_cast<Handle>(m_Meshes.size()); ++i)
+		{
+			if (m_Meshes[i].InUse && m_Meshes[i].Allocs[t_Type].IsValid())
+			{
+				Live.emplace_back(i);
+			}
+		}
+		std::sort(Live.begin(), Live.end(), [this, t_Type](Handle t_A, Handle t_B)
+		{
+			return m_Meshes[t_A].Allocs[t_Type].Offset < m_Meshes[t_B].Allocs[t_Type].Offset;
+		});
+
+		std::unique_ptr<Buffer> NewBuf = std::make_unique<Buffer>(t_Capacity * P.Stride, P.Usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		std::unique_ptr<TlsfAllocator> NewAllocator = std::make_unique<TlsfAllocator>(t_Capacity);
+
+		std::vector<VkBufferCopy> Regions;
+		for (Handle MeshHandle : Live)
+		{
+			Mesh& Moved = m_Meshes[MeshHandle];
+			const uint64 Count = GetCount(Moved.MeshRange, t_Type);
+
+			TlsfAllocator::Allocation NewAlloc = NewAllocator->Allocate(Count);
+			assert(NewAlloc.IsValid());
+
+			const VkDeviceSize Src = Moved.Allocs[t_Type].Offset * P.Stride;
+			const VkDeviceSize Dst = NewAlloc.Offset * P.Stride;
+			const VkDeviceSize Size = Count * P.Stride;
+
+			// Meshes that were already next to each other are copied together
+			if (!Regions.empty() && Regions.back().srcOffset + Regions.back().size == Src && Regions.back().dstOffset + Regions.back().size == Dst)
+			{
+				Regions.back().size += Size;
+			}
+			else
+			{
+				VkBufferCopy Region = {};
+				Region.srcOffset = Src;
+				Region.dstOffset = Dst;
+				Region.size = Size;
+				Regions.emplace_back(Region);
+			}
+
+			Moved.Allocs[t_Type] = NewAlloc;
+			GetFirst(Moved.MeshRange, t_Type) = static_cast<uint32>(NewAlloc.Offset);
+		}
+
+		UploadTicket Ticket = 0;
+		if (!Regions.empty())
+		{
+			Ticket = m_Uploader->CopyBuffer(P.Buf.get(), NewBuf.get(), Regions);
+		}
+
+		// Frames that were recorded before this still draw out of the old buffer
+		RetiredBuffer& Retired = m_RetiredBuffers.emplace_back();
+		Retired.Buf = std::move(P.Buf);
+		Retired.Ticket = Ticket;
+		Retired.FramesLeft = m_FramesInFlight;
+
+		F_LOG_TRACE("Mesh arena {} buffer rebuilt: {} -> {} bytes, {} meshes", t_Type == VERTEX_POOL ? "vertex" : "index", Retired.Buf->GetSize(), NewBuf->GetSize(), Live.size());
+
+		P.Buf = std::move(NewBuf);
+		P.Allocator = std::move(NewAllocator);
+
+		++m_LayoutVersion;
+		++m_RebuildCount;
+	}
+}   // namespace Fling
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "MeshRenderer.h"
+#include "ResourceManager.h"
 
 #include <entt/entity/helper.hpp>
 
@@ -17,9 +18,9 @@ namespace Fling
 		LoadMaterialFromPath(t_MaterialPath);
 	}
 
-	MeshRenderer::MeshRenderer(Model* t_Model, Material* t_Mat /** = nullptr */)
-		:m_Model(t_Model)
-		, m_Material(t_Mat)
+	MeshRenderer::MeshRenderer(Handle<Model> t_Model, Handle<Material> t_Mat /** = {} */)
+		:m_Model(std::move(t_Model))
+		, m_Material(std::move(t_Mat))
 	{
 		if (!m_Material)
 		{
@@ -27,12 +28,6 @@ namespace Fling
 		}
 	}
 
-	void MeshRenderer::Release()
-	{
-		delete m_UniformBuffer;
-		m_UniformBuffer = nullptr;
-	}
-
 	bool MeshRenderer::operator==(const MeshRenderer& other) const
 	{
 		return m_Model == other.m_Model && m_Material == other.m_Material;
@@ -46,13 +41,13 @@ namespace Fling
 	void MeshRenderer::LoadModelFromPath(const std::string& t_MeshPath)
 	{
 		// Load the model
-		m_Model = Model::Create(Guid{ t_MeshPath.c_str() }).get();
+		m_Model = ResourceManager::LoadHandle<Model>(Guid{ t_MeshPath.c_str() });
 		assert(m_Model);
 	}
 
 	void MeshRenderer::LoadMaterialFromPath(const std::string& t_MatPath)
 	{
-		m_Material = Material::Create(Guid{ t_MatPath.c_str() }).get();
+		m_Material = ResourceManager::LoadHandle<Material>(Guid{ t_MatPath.c_str() });
 		assert(m_Material);
 	}
 }   // namespace Fling
\ No newline at end of file
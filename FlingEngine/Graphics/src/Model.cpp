@@ -4,9 +4,13 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 #include "ResourceManager.h"
+#include "VulkanApp.h"
+#include "OcclusionBuffer.h"
 
 namespace Fling
 {
+	CpuDataPolicy Model::VertexDataPolicy = CpuDataPolicy::Release;
+
 	std::shared_ptr<Fling::Model> Model::Create(Guid t_ID)
 	{
 		return ResourceManager::LoadResource<Model>(t_ID);
@@ -74,31 +78,86 @@ namespace Fling
 	}
 
 	Model::Model(Guid t_ID)
+		: Model(t_ID, Decode(t_ID))
+	{
+	}
+
+	Model::Model(Guid t_ID, std::unique_ptr<LoadData> t_Data)
 		: Resource(t_ID)
+		, m_Arena(VulkanApp::Get().GetMeshArena())
 	{
-		LoadModel();
+		// A model that failed to load has nothing to upload
+		if (!t_Data || t_Data->Verts.empty())
+		{
+			return;
+		}
+
+		m_Verts = std::move(t_Data->Verts);
+		m_Indices = std::move(t_Data->Indices);
+
+		CalculateBounds();
+		CreateBuffers();
 	}
 
 	Model::Model(Guid t_ID, std::vector<Vertex>& t_Verts, std::vector<uint32> t_Indecies)
 		: Resource(t_ID)
+		, m_Arena(VulkanApp::Get().GetMeshArena())
 	{
 		m_Verts = t_Verts;
 		m_Indices = t_Indecies;
 
 		CalculateVertexTangents(m_Verts.data(), static_cast<uint32>(m_Verts.size()), m_Indices.data(), static_cast<uint32>(m_Indices.size()));
+		CalculateBounds();
 		CreateBuffers();
 	}
 
 	Model::~Model()
 	{
-		// #TODO Make the buffer allocations from a pool allocator instead of new's and deletes
-		delete m_VertexBuffer;
-		delete m_IndexBuffer;
+		if (m_Arena)
+		{
+			m_Arena->Remove(m_ArenaMesh);
+		}
+	}
+
+	bool Model::DecodeOccluder(Guid t_ID, OccluderMesh& t_OutMesh)
+	{
+		const std::string FilePath = Resource::GetFilepathReleativeToAssets(t_ID);
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn;
+		std::string err;
+
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, FilePath.c_str()))
+		{
+			F_LOG_ERROR("Failed to load occluder: {} {}", warn, err);
+			return false;
+		}
+
+		// Occluders don't need normals or UVs, so the positions are used as they are in the file
+		t_OutMesh.Positions.resize(attrib.vertices.size() / 3);
+		for (size_t i = 0; i < t_OutMesh.Positions.size(); ++i)
+		{
+			t_OutMesh.Positions[i] = glm::vec3(attrib.vertices[3 * i + 0], attrib.vertices[3 * i + 1], attrib.vertices[3 * i + 2]);
+		}
+
+		t_OutMesh.Indices.clear();
+		for (const tinyobj::shape_t& shape : shapes)
+		{
+			for (const tinyobj::index_t& index : shape.mesh.indices)
+			{
+				t_OutMesh.Indices.push_back(static_cast<uint32>(index.vertex_index));
+			}
+		}
+
+		return !t_OutMesh.IsEmpty();
 	}
 
-	void Model::LoadModel()
+	std::unique_ptr<Model::LoadData> Model::Decode(Guid t_ID)
 	{
-		const std::string FilePath = GetFilepathReleativeToAssets();
+		std::unique_ptr<LoadData> Data = std::make_unique<LoadData>();
+
+		const std::string FilePath = Resource::GetFilepathReleativeToAssets(t_ID);
 		tinyobj::attrib_t attrib;
 		std::vector<tinyobj::shape_t> shapes;
 		std::vector<tinyobj::material_t> materials;
@@ -110,7 +169,7 @@ namespace Fling
 		{
 			F_LOG_ERROR("Failed to load model: {} {}", warn, err);
 			
-			return;
+			return Data;
 		}
 
 		// Parse all shapes to get the verts and indecies of this object
@@ -141,31 +200,72 @@ namespace Fling
 
 				vertex.Color = { 1.0f, 1.0f, 1.0f };
 
-				m_Verts.push_back(vertex);
-				m_Indices.push_back(m_Indices.size());
+				Data->Verts.push_back(vertex);
+				Data->Indices.push_back(static_cast<uint32>(Data->Indices.size()));
 			}
 		}
 
 		// Calculate our tangent vectors for this model
-		CalculateVertexTangents(m_Verts.data(), static_cast<uint32>(m_Verts.size()), m_Indices.data(), static_cast<uint32>(m_Indices.size()));
+		CalculateVertexTangents(Data->Verts.data(), static_cast<uint32>(Data->Verts.size()), Data->Indices.data(), static_cast<uint32>(Data->Indices.size()));
 
-		CreateBuffers();
+		return Data;
+	}
+
+	uint64 Model::GetCpuMemoryUsage() const
+	{
+		return (m_Verts.capacity() * sizeof(Vertex)) + (m_Indices.capacity() * sizeof(uint32));
+	}
+
+	uint64 Model::GetGpuMemoryUsage() const
+	{
+		if (m_ArenaMesh == MeshArena::INVALID_HANDLE)
+		{
+			return 0;
+		}
+		return (static_cast<uint64>(m_VertexCount) * sizeof(Vertex)) + (static_cast<uint64>(m_IndexCount) * sizeof(uint32));
 	}
 
 	void Model::CreateBuffers()
 	{
-		// Create vertex buffer
-		VkDeviceSize VertBufferSize = sizeof(m_Verts[0]) * m_Verts.size();
-		// We use a staging buffer to get to a more optimial memory layout for the GPU
-		Buffer VertexStagingBuffer(VertBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_Verts.data());
-		m_VertexBuffer = new Buffer(VertBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		Buffer::CopyBuffer(&VertexStagingBuffer, m_VertexBuffer, VertBufferSize);
-
-		// Create Index buffer
-		VkDeviceSize IndexBufferSize = sizeof(m_Indices[0]) * GetIndexCount();
-		Buffer IndexStagingBuffer(IndexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_Indices.data());
-		m_IndexBuffer = new Buffer(IndexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		Buffer::CopyBuffer(&IndexStagingBuffer, m_IndexBuffer, IndexBufferSize);
+		m_VertexCount = static_cast<uint32>(m_Verts.size());
+		m_IndexCount = static_cast<uint32>(m_Indices.size());
+
+		// Both are copied into the arena in the next upload batch, which is submitted before any frame
+		// that could draw this model
+		assert(m_Arena);
+		m_ArenaMesh = m_Arena->Add(m_Verts.data(), m_VertexCount, m_Indices.data(), m_IndexCount);
+
+		// The uploader copied both into the staging ring already
+		if (VertexDataPolicy == CpuDataPolicy::Release)
+		{
+			std::vector<Vertex>().swap(m_Verts);
+			std::vector<uint32>().swap(m_Indices);
+		}
+	}
+
+	void Model::CalculateBounds()
+	{
+		if (m_Verts.empty())
+		{
+			return;
+		}
+
+		m_Bounds.Min = m_Bounds.Max = m_Verts[0].Pos;
+		for (const Vertex& Vert : m_Verts)
+		{
+			m_Bounds.Min = glm::min(m_Bounds.Min, Vert.Pos);
+			m_Bounds.Max = glm::max(m_Bounds.Max, Vert.Pos);
+		}
+
+		// Centered on the box, which is close enough to the smallest sphere for culling
+		m_BoundingSphere.Center = m_Bounds.GetCenter();
+		float MaxDistanceSq = 0.0f;
+		for (const Vertex& Vert : m_Verts)
+		{
+			const glm::vec3 Offset = Vert.Pos - m_BoundingSphere.Center;
+			MaxDistanceSq = glm::max(MaxDistanceSq, glm::dot(Offset, Offset));
+		}
+		m_BoundingSphere.Radius = glm::sqrt(MaxDistanceSq);
 	}
 
 	void Model::CalculateVertexTangents(Vertex* verts, uint32 numVerts, uint32* indices, uint32 numIndices)
@@ -68,10 +68,9 @@ namespace Fling
         //    m_ColorImageView = VK_NULL_HANDLE;
         //}
 
-        //if(m_ColorImageMemory != VK_NULL_HANDLE)
+        //if(m_ColorImageMemory.IsValid())
         //{
-        //    vkFreeMemory(device, m_ColorImageMemory, nullptr);
-        //    m_ColorImageMemory = VK_NULL_HANDLE;
+        //    VulkanApp::Get().GetMemoryAllocator()->Free(m_ColorImageMemory);
         //}
     }
 
@@ -10,20 +10,85 @@
 #include "UniformBufferObject.h"
 #include "FirstPersonCamera.h"
 #include "FlingVulkan.h"
+#include "VulkanApp.h"
+#include "UniformBufferRing.h"
+#include "FlingConfig.h"
+#include "ResourceManager.h"
+#include "Buffer.h"
+#include "RadixSort.h"
+#include "JobSystem.h"
+#include "SpatialTree.h"
+#include "GpuCuller.h"
+#include "MeshArena.h"
+#include "BindlessTextures.h"
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <atomic>
 
 namespace Fling
 {
+	namespace
+	{
+		/** Instances that fit in each frame's instance buffer before it has to grow */
+		const uint32 INITIAL_INSTANCE_CAPACITY = 1024;
+
+		/** Materials that fit in each frame's bindless materials buffer before it has to grow */
+		const uint32 INITIAL_BINDLESS_MATERIAL_CAPACITY = 256;
+
+		/** Fewer draws than this are not worth recording on another thread */
+		const uint32 MIN_DRAWS_PER_CHUNK = 512;
+
+		std::unique_ptr<Buffer> CreateMappedBuffer(VkDeviceSize t_Size, VkBufferUsageFlags t_Usage)
+		{
+			std::unique_ptr<Buffer> MappedBuffer = std::make_unique<Buffer>(
+				t_Size,
+				t_Usage,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+			VK_CHECK_RESULT(MappedBuffer->MapMemory());
+			return MappedBuffer;
+		}
+
+		std::unique_ptr<Buffer> CreateInstanceBuffer(uint32 t_Capacity)
+		{
+			return CreateMappedBuffer(static_cast<VkDeviceSize>(t_Capacity) * sizeof(InstanceData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		}
+
+		/** Replace a mapped buffer with one twice as large until it has t_Size bytes. @return True if it was replaced */
+		bool GrowMappedBuffer(std::unique_ptr<Buffer>& t_Buffer, VkDeviceSize t_Size, VkBufferUsageFlags t_Usage)
+		{
+			if (t_Buffer->GetSize() >= t_Size)
+			{
+				return false;
+			}
+
+			VkDeviceSize NewSize = t_Buffer->GetSize();
+			while (NewSize < t_Size)
+			{
+				NewSize *= 2;
+			}
+			t_Buffer = CreateMappedBuffer(NewSize, t_Usage);
+			return true;
+		}
+	}
+
 	OffscreenSubpass::OffscreenSubpass(
 		const LogicalDevice* t_Dev,
 		const Swapchain* t_Swap,
 		entt::registry& t_reg,
 		FirstPersonCamera* t_Cam,
 		std::shared_ptr<Fling::Shader> t_Vert,
-		std::shared_ptr<Fling::Shader> t_Frag)
-		: Subpass(t_Dev, t_Swap, t_Vert, t_Frag)
+		std::shared_ptr<Fling::Shader> t_Frag,
+		std::shared_ptr<Fling::Shader> t_Cull,
+		std::shared_ptr<Fling::Shader> t_DepthReduce)
+		: Subpass(t_Dev, t_Swap, t_Vert, t_Frag, /* Dynamic UBO at binding */ 1 << 0)
 		, m_Camera(t_Cam)
+		, m_CullShader(t_Cull)
+		, m_DepthReduceShader(t_DepthReduce)
 	{
 		t_reg.on_construct<MeshRenderer>().connect<&OffscreenSubpass::OnMeshRendererAdded>(*this);
+		ResourceManager::Get().OnResourceEvicted().connect<&OffscreenSubpass::OnResourceEvicted>(*this);
 
 		// Set the clear values for the G Buffer
 		m_ClearValues.resize(6);
@@ -31,29 +96,117 @@ namespace Fling
 		m_ClearValues[2].color = m_ClearValues[3].color = m_ClearValues[4].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
 		m_ClearValues[5].depthStencil = { 1.0f, 0 };
 
+		const uint32 FramesInFlight = VulkanApp::Get().GetFramesInFlight();
+
 		// Build offscreen semaphores -------
-		m_OffscreenSemaphores.resize(VkConfig::MAX_FRAMES_IN_FLIGHT);
-		for (int32 i = 0; i < VkConfig::MAX_FRAMES_IN_FLIGHT; i++)
+		m_OffscreenSemaphores.resize(FramesInFlight);
+		for (uint32 i = 0; i < FramesInFlight; i++)
 		{
 			m_OffscreenSemaphores[i] = GraphicsHelpers::CreateSemaphore(m_Device->GetVkDevice());
 		}
 
-		GraphicsHelpers::CreateCommandPool(&m_CommandPool, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+		// Each frame has a pool for the primary command buffer and one for every chunk that can be recorded at the same time.
+		// A command pool can only be used by one thread at a time, so each chunk's job records with its own
+		const uint32 ChunkCount = JobSystem::Get().GetWorkerCount();
 
-		// Build offscreen command buffers
-		m_OffscreenCmdBufs.resize(m_SwapChain->GetImageCount());
-		for (size_t i = 0; i < m_OffscreenCmdBufs.size(); ++i)
+		m_OffscreenCmdBufs.resize(FramesInFlight);
+		m_FrameCommands.resize(FramesInFlight);
+		for (uint32 i = 0; i < FramesInFlight; ++i)
 		{
-			m_OffscreenCmdBufs[i] = new Fling::CommandBuffer(m_Device, m_CommandPool);
+			FrameCommands& Frame = m_FrameCommands[i];
+
+			GraphicsHelpers::CreateCommandPool(&Frame.PrimaryPool, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+			m_OffscreenCmdBufs[i] = new Fling::CommandBuffer(m_Device, Frame.PrimaryPool);
 			assert(m_OffscreenCmdBufs[i] != nullptr);
+
+			Frame.ChunkPools.resize(ChunkCount);
+			Frame.Secondaries.resize(ChunkCount);
+			for (uint32 Chunk = 0; Chunk < ChunkCount; ++Chunk)
+			{
+				GraphicsHelpers::CreateCommandPool(&Frame.ChunkPools[Chunk], VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+				Frame.Secondaries[Chunk] = new Fling::CommandBuffer(m_Device, Frame.ChunkPools[Chunk], VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+			}
+		}
+
+		// Per draw uniform data is sub-allocated from a single ring instead of a buffer per mesh
+		int32 RingSizeKB = FlingConfig::GetInt("Vulkan", "UniformRingSizeKB", VkConfig::DEFAULT_UNIFORM_RING_SIZE_KB);
+		if (RingSizeKB <= 0)
+		{
+			F_LOG_WARN("UniformRingSizeKB of {} is invalid! Using default of {}", RingSizeKB, VkConfig::DEFAULT_UNIFORM_RING_SIZE_KB);
+			RingSizeKB = VkConfig::DEFAULT_UNIFORM_RING_SIZE_KB;
+		}
+		m_UniformRing = std::make_unique<UniformBufferRing>(m_Device, static_cast<VkDeviceSize>(RingSizeKB) * 1024, FramesInFlight);
+
+		m_FrustumCulling = FlingConfig::GetBool("Vulkan", "FrustumCulling", true);
+		m_HierarchicalCulling = FlingConfig::GetBool("Vulkan", "HierarchicalCulling", true);
+
+		m_OcclusionCulling = FlingConfig::GetBool("Vulkan", "OcclusionCulling", true);
+		int32 OcclusionWidth = FlingConfig::GetInt("Vulkan", "OcclusionBufferWidth", VkConfig::DEFAULT_OCCLUSION_BUFFER_WIDTH);
+		int32 OcclusionHeight = FlingConfig::GetInt("Vulkan", "OcclusionBufferHeight", VkConfig::DEFAULT_OCCLUSION_BUFFER_HEIGHT);
+		if (OcclusionWidth <= 0 || OcclusionHeight <= 0)
+		{
+			F_LOG_WARN("Occlusion buffer size of {}x{} is invalid! Using default of {}x{}", OcclusionWidth, OcclusionHeight, VkConfig::DEFAULT_OCCLUSION_BUFFER_WIDTH, VkConfig::DEFAULT_OCCLUSION_BUFFER_HEIGHT);
+			OcclusionWidth = VkConfig::DEFAULT_OCCLUSION_BUFFER_WIDTH;
+			OcclusionHeight = VkConfig::DEFAULT_OCCLUSION_BUFFER_HEIGHT;
+		}
+		m_Occlusion = std::make_unique<OcclusionBuffer>(static_cast<uint32>(OcclusionWidth), static_cast<uint32>(OcclusionHeight));
+
+		m_InstanceBuffers.resize(FramesInFlight);
+		for (std::unique_ptr<Buffer>& InstanceBuffer : m_InstanceBuffers)
+		{
+			InstanceBuffer = CreateInstanceBuffer(INITIAL_INSTANCE_CAPACITY);
+		}
+		m_InstanceBufferGenerations.assign(FramesInFlight, 0);
+
+		// With bindless textures the pass binds one set of textures for every material, and each instance
+		// says which material it is. The shaders were picked to match, @see VulkanApp::BuildRenderPipelines
+		m_Bindless = VulkanApp::Get().GetBindlessTextures();
+		if (m_Bindless)
+		{
+			m_GraphicsPipeline->SetExtraSetLayouts({ m_Bindless->GetSetLayout() });
+
+			m_BindlessFrames.resize(FramesInFlight);
+			for (BindlessFrame& Frame : m_BindlessFrames)
+			{
+				Frame.Materials = CreateMappedBuffer(INITIAL_BINDLESS_MATERIAL_CAPACITY * sizeof(glm::uvec4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+				Frame.InstanceMaterials = CreateMappedBuffer(INITIAL_INSTANCE_CAPACITY * sizeof(uint32), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+			}
+		}
+
+		// The depth attachment is only made sampleable for the depth pyramid, so this has to be known before the attachments
+		m_GpuCulling = FlingConfig::GetBool("Vulkan", "GpuCulling", true);
+		if (m_GpuCulling)
+		{
+			auto IsComputeShader = [](const std::shared_ptr<Fling::Shader>& t_Shader)
+			{
+				return t_Shader && t_Shader->GetShaderModule() != VK_NULL_HANDLE && t_Shader->GetStage() == VK_SHADER_STAGE_COMPUTE_BIT;
+			};
+
+			if (!IsComputeShader(m_CullShader) || !IsComputeShader(m_DepthReduceShader))
+			{
+				F_LOG_WARN("GPU culling shaders are missing! Culling on the CPU instead");
+				m_GpuCulling = false;
+			}
+
+			// Both are enabled on the device when they are supported
+			const VkPhysicalDeviceFeatures& Features = m_Device->GetPhysicalDevice()->GetDeivceFeatures();
+			m_MultiDrawIndirect = Features.multiDrawIndirect && Features.drawIndirectFirstInstance;
 		}
 
 		// Tell the Vulkan app that the draw command buffers need to WAIT on this offscreen semaphore
 		PrepareAttachments();
+
+		if (m_GpuCulling)
+		{
+			m_GpuCuller = std::make_unique<GpuCuller>(m_Device, m_CullShader.get(), m_DepthReduceShader.get(), FramesInFlight);
+			m_GpuCuller->OnResize(*m_OffscreenFrameBuf->GetAttachmentAtIndex(m_DepthAttachment), m_OffscreenFrameBuf->GetWidth(), m_OffscreenFrameBuf->GetHeight());
+		}
 	}
 
 	OffscreenSubpass::~OffscreenSubpass()
 	{
+		ResourceManager::Get().OnResourceEvicted().disconnect<&OffscreenSubpass::OnResourceEvicted>(*this);
+
 		// Destroy any allocated semaphores
 		for (size_t i = 0; i < m_OffscreenSemaphores.size(); ++i)
 		{
@@ -68,23 +221,52 @@ namespace Fling
 		}
 		m_OffscreenCmdBufs.clear();
 
-		vkDestroyCommandPool(m_Device->GetVkDevice(), m_CommandPool, nullptr);
+		for (FrameCommands& Frame : m_FrameCommands)
+		{
+			for (CommandBuffer* CmdBuf : Frame.Secondaries)
+			{
+				delete CmdBuf;
+			}
+
+			for (VkCommandPool Pool : Frame.ChunkPools)
+			{
+				vkDestroyCommandPool(m_Device->GetVkDevice(), Pool, nullptr);
+			}
+
+			vkDestroyCommandPool(m_Device->GetVkDevice(), Frame.PrimaryPool, nullptr);
+		}
+		m_FrameCommands.clear();
 
 		delete m_OffscreenFrameBuf;
 		m_OffscreenFrameBuf = nullptr;
+
+		m_UniformRing.reset();
+		m_InstanceBuffers.clear();
+		m_BindlessFrames.clear();
+		m_GpuCuller.reset();
 	}
 
 	void OffscreenSubpass::Draw(
 		CommandBuffer& t_CmdBuf, 
-		uint32 t_ActiveSwapImage, 
+		uint32 t_ActiveFrameInFlight, 
 		entt::registry& t_reg, 
 		float DeltaTime)
 	{
+		FLING_PROFILE_SCOPE("OffscreenSubpass::Draw");
+
 		assert(m_GraphicsPipeline);
 		// Don't use the given command buffer, instead build the OFFSCREEN command buffer
-		CommandBuffer* OffscreenCmdBuf = m_OffscreenCmdBufs[t_ActiveSwapImage];
+		CommandBuffer* OffscreenCmdBuf = m_OffscreenCmdBufs[t_ActiveFrameInFlight];
 		assert(OffscreenCmdBuf);
 
+		// The frame fence has been waited on, so every buffer from this frame's pools can be reset at once
+		const FrameCommands& Frame = m_FrameCommands[t_ActiveFrameInFlight];
+		vkResetCommandPool(m_Device->GetVkDevice(), Frame.PrimaryPool, 0);
+		for (VkCommandPool Pool : Frame.ChunkPools)
+		{
+			vkResetCommandPool(m_Device->GetVkDevice(), Pool, 0);
+		}
+
 		// Set viewport and scissors to the offscreen frame buffer
 		VkViewport viewport = Initializers::Viewport(
 			static_cast<float>(m_OffscreenFrameBuf->GetWidth()), 
@@ -100,126 +282,269 @@ namespace Fling
 		);
 
 		OffscreenCmdBuf->Begin();
-		OffscreenCmdBuf->BeginRenderPass(*m_OffscreenFrameBuf, m_ClearValues);
-
-		OffscreenCmdBuf->SetViewport(0, { viewport });
-		OffscreenCmdBuf->SetScissor(0, { scissor });
 
-		vkCmdBindPipeline(OffscreenCmdBuf->GetHandle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline->GetPipeline());
+		// This is not recorded into the swap chain command buffer so the render pipeline can't time it
+		BeginGpuScope(*OffscreenCmdBuf, t_ActiveFrameInFlight, /* t_ExecutesSecondaries */ true);
 
-		VkDeviceSize offsets[1] = { 0 };
+		// The GPU is done with this frame's region of the ring, the frame fence has been waited on
+		m_UniformRing->BeginFrame(t_ActiveFrameInFlight);
 
+		// Every draw shares the camera UBO
+		uint32 DynamicOffset = 0;
+		OffscreenUBO* CameraUBO = m_UniformRing->Allocate<OffscreenUBO>(DynamicOffset);
 		OffscreenUBO CurrentUBO = {};
-		// Invert the project value to match the proper coordinate space compared to OpenGL
-		CurrentUBO.Projection = m_Camera->GetProjectionMatrix();
-		CurrentUBO.Projection[1][1] *= -1.0f;
-		CurrentUBO.View = m_Camera->GetViewMatrix();	
-
-		// #TODO This is where a lot of the cost of our engine loop comes from
-		// We can improve this by doing some kind of dirty bit tracking to only
-		// update the UBO's on MeshRenders if they have changed
-		auto RenderGroup = t_reg.group<Transform>(entt::get<MeshRenderer, entt::tag<"Default"_hs>>);
-
-		RenderGroup.less([&](entt::entity ent, Transform& t_trans, MeshRenderer& t_MeshRend)
+		if (!CameraUBO)
 		{
-			Fling::Model* Model = t_MeshRend.m_Model;
-			if (!Model)
+			if (!m_HasLoggedRingOverflow)
 			{
-				return;
+				F_LOG_WARN("Uniform ring is out of space ({} bytes per frame)! Nothing will be drawn. Increase [Vulkan] UniformRingSizeKB", m_UniformRing->GetBytesPerFrame());
+				m_HasLoggedRingOverflow = true;
 			}
+		}
+		else
+		{
+			// Invert the project value to match the proper coordinate space compared to OpenGL
+			CurrentUBO.Projection = m_Camera->GetProjectionMatrix();
+			CurrentUBO.Projection[1][1] *= -1.0f;
+			CurrentUBO.View = m_Camera->GetViewMatrix();
+			memcpy(CameraUBO, &CurrentUBO, sizeof(OffscreenUBO));
 
-			// UPDATE UNIFORM BUF of the mesh --------
-			
-			Transform::CalculateWorldMatrix(t_trans);
-			CurrentUBO.Model = t_trans.GetWorldMatrix();
-			CurrentUBO.ObjPos = t_trans.GetPos();
+			if (m_GpuCulling)
+			{
+				UpdateGpuObjects(t_reg);
 
-			// Memcpy to the buffer
-			Buffer* buf = t_MeshRend.m_UniformBuffer;
-			memcpy(
-				buf->m_MappedMem, 
-				&CurrentUBO,
-				buf->GetSize()
-			);
+				// Counts come back once the frame is done, so the stats are a few frames behind
+				const uint32 DrawnInstances = m_GpuCuller->BeginFrame(t_ActiveFrameInFlight, m_Camera->GetFrustum(), m_FrustumCulling, m_OcclusionCulling && m_GpuOcclusion);
+				Stats::DrawCounts& Counts = Stats::Draws::GetCurrentFrame();
+				Counts.MeshesSubmitted += DrawnInstances;
+				Counts.MeshesCulled += m_GpuDrawableCount - std::min(DrawnInstances, m_GpuDrawableCount);
+				Counts.Instances += DrawnInstances;
 
-			// Bind the descriptor set for rendering a mesh using the dynamic offset
-			vkCmdBindDescriptorSets(
-				OffscreenCmdBuf->GetHandle(),
-				VK_PIPELINE_BIND_POINT_GRAPHICS,
-				m_GraphicsPipeline->GetPipelineLayout(),
-				0,
-				1,
-				&t_MeshRend.m_DescriptorSet,
-				0,
-				nullptr);
+				// Culling is a compute dispatch, which can't be in the render pass
+				m_GpuCuller->RecordCull(OffscreenCmdBuf->GetHandle(), t_ActiveFrameInFlight);
+			}
+			else
+			{
+				BuildDrawList(t_reg, t_ActiveFrameInFlight);
+			}
+
+			if (m_Bindless)
+			{
+				UpdateBindlessFrame(t_ActiveFrameInFlight);
+			}
+		}
 
-			VkBuffer vertexBuffers[1] = { Model->GetVertexBuffer()->GetVkBuffer() };
-			// Render the mesh
-			vkCmdBindVertexBuffers(OffscreenCmdBuf->GetHandle(), 0, 1, vertexBuffers, offsets);
-			vkCmdBindIndexBuffer(OffscreenCmdBuf->GetHandle(), Model->GetIndexBuffer()->GetVkBuffer(), 0, Model->GetIndexType());
-			vkCmdDrawIndexed(OffscreenCmdBuf->GetHandle(), Model->GetIndexCount(), 1, 0, 0, 0);
-		});
+		// The draws are all recorded in secondary command buffers, @see RecordDrawChunks
+		OffscreenCmdBuf->BeginRenderPass(*m_OffscreenFrameBuf, m_ClearValues, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		if (CameraUBO)
+		{
+			if (m_GpuCulling)
+			{
+				RecordIndirectDraws(t_ActiveFrameInFlight, DynamicOffset, viewport, scissor);
+			}
+			else
+			{
+				RecordDrawChunks(t_ActiveFrameInFlight, DynamicOffset, viewport, scissor);
+			}
+			OffscreenCmdBuf->ExecuteCommands(m_ChunkCmdBufs);
+		}
 
 		OffscreenCmdBuf->EndRenderPass();
 
+		// Next frame's occlusion culling tests against the depth that was just drawn
+		if (CameraUBO && m_GpuCulling && m_GpuOcclusion && m_OcclusionCulling)
+		{
+			m_GpuCuller->RecordDepthPyramid(
+				OffscreenCmdBuf->GetHandle(),
+				*m_OffscreenFrameBuf->GetAttachmentAtIndex(m_DepthAttachment),
+				CurrentUBO.Projection * CurrentUBO.View);
+		}
+
+		EndGpuScope(*OffscreenCmdBuf, t_ActiveFrameInFlight);
+
 		OffscreenCmdBuf->End();
 	}
 
-	void OffscreenSubpass::CreateMeshDescriptorSet(MeshRenderer& t_MeshRend)
+	VkDescriptorSet OffscreenSubpass::GetMaterialDescriptorSet(Material* t_Mat)
 	{
-		// Only allocate new descriptor sets if there are none
-		// Some may exist if entt decides to re-use the component
-		if (t_MeshRend.m_DescriptorSet == VK_NULL_HANDLE)
+		// Ensure that we have a material to try and sample from
+		if (t_Mat == nullptr)
 		{
-			VkDescriptorSetLayout layout = m_GraphicsPipeline->GetDescriptorSetLayout();
-			VkDescriptorSetAllocateInfo allocInfo = {};
-			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-			// If we have specified a specific pool then use that, otherwise use the one on the mesh
-			allocInfo.descriptorPool = m_DescriptorPool;
-			allocInfo.descriptorSetCount = 1;
-			allocInfo.pSetLayouts = &layout;
-
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(m_Device->GetVkDevice(), &allocInfo, &t_MeshRend.m_DescriptorSet));
+			t_Mat = Material::GetDefaultMat().get();
 		}
 
-		// Ensure that we have a material to try and sample from
-		if (t_MeshRend.m_Material == nullptr)
+		auto It = m_MaterialDescriptorSets.find(t_Mat);
+		if (It != m_MaterialDescriptorSets.end())
 		{
-			t_MeshRend.m_Material = Material::GetDefaultMat().get();
+			return It->second;
 		}
-		
+
+		// The set is written by the allocator, which shares it with every other material that has the same textures
+		const VkDescriptorSet DescriptorSet = VK_NULL_HANDLE;
+
+		// The same ring buffer is used for every frame, the frame region is picked by the dynamic offset
+		VkDescriptorBufferInfo UniformInfo = m_UniformRing->GetDescriptorInfo(sizeof(OffscreenUBO));
+
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
 		{
 			// 0: UBO
-			Initializers::WriteDescriptorSetUniform(
-				t_MeshRend.m_UniformBuffer,
-				t_MeshRend.m_DescriptorSet,
-				0
-			),
+			Initializers::WriteDescriptorSet(
+				DescriptorSet,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+				0,
+				&UniformInfo),
 			// 1: Color map 
 			Initializers::WriteDescriptorSetImage(
-				t_MeshRend.m_Material->GetPBRTextures().m_AlbedoTexture,
-				t_MeshRend.m_DescriptorSet,
+				t_Mat->GetPBRTextures().m_AlbedoTexture.Get(),
+				DescriptorSet,
 				1),
 			// 2: Normal map
 			Initializers::WriteDescriptorSetImage(
-				t_MeshRend.m_Material->GetPBRTextures().m_NormalTexture,
-				t_MeshRend.m_DescriptorSet,
+				t_Mat->GetPBRTextures().m_NormalTexture.Get(),
+				DescriptorSet,
 				2),
 			// 3: Metal map
 			Initializers::WriteDescriptorSetImage(
-				t_MeshRend.m_Material->GetPBRTextures().m_MetalTexture,
-				t_MeshRend.m_DescriptorSet,
+				t_Mat->GetPBRTextures().m_MetalTexture.Get(),
+				DescriptorSet,
 				3),
 			// 4: Roughness map
 			Initializers::WriteDescriptorSetImage(
-				t_MeshRend.m_Material->GetPBRTextures().m_RoughnessTexture,
-				t_MeshRend.m_DescriptorSet,
+				t_Mat->GetPBRTextures().m_RoughnessTexture.Get(),
+				DescriptorSet,
 				4)
 			// Any other PBR textures or other samplers go HERE and you add to the MRT shader
 		};
 
-		vkUpdateDescriptorSets(m_Device->GetVkDevice(), static_cast<uint32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		VkDescriptorSet CachedSet = VulkanApp::Get().GetDescriptorAllocator()->GetCached(m_GraphicsPipeline->GetDescriptorSetLayout(), writeDescriptorSets);
+
+		m_MaterialDescriptorSets.emplace(t_Mat, CachedSet);
+		return CachedSet;
+	}
+
+	uint32 OffscreenSubpass::GetBindlessMaterial(Material* t_Mat)
+	{
+		if (t_Mat == nullptr)
+		{
+			t_Mat = Material::GetDefaultMat().get();
+		}
+
+		auto It = m_BindlessMaterialSlots.find(t_Mat);
+		if (It != m_BindlessMaterialSlots.end())
+		{
+			return It->second;
+		}
+
+		uint32 Slot = static_cast<uint32>(m_BindlessMaterials.size());
+		if (!m_FreeBindlessMaterials.empty())
+		{
+			Slot = m_FreeBindlessMaterials.back();
+			m_FreeBindlessMaterials.pop_back();
+		}
+		else
+		{
+			m_BindlessMaterials.emplace_back();
+			m_BindlessMaterialOwners.emplace_back(nullptr);
+		}
+
+		m_BindlessMaterials[Slot] = GetBindlessTextureSlots(t_Mat);
+		m_BindlessMaterialOwners[Slot] = t_Mat;
+		m_BindlessMaterialSlots.emplace(t_Mat, Slot);
+		++m_BindlessMaterialsGeneration;
+		return Slot;
+	}
+
+	glm::uvec4 OffscreenSubpass::GetBindlessTextureSlots(const Material* t_Mat) const
+	{
+		const PBRTextures& Textures = t_Mat->GetPBRTextures();
+		const PBRTextures& Defaults = Material::GetDefaultMat()->GetPBRTextures();
+
+		// Slot 0 is the first texture that was loaded, which is better than reading a slot that was never written
+		auto GetSlot = [](const Handle<Texture>& t_Tex, const Handle<Texture>& t_Default)
+		{
+			for (const Texture* Tex : { t_Tex.Get(), t_Default.Get() })
+			{
+				if (Tex && Tex->GetBindlessSlot() != BindlessTextures::INVALID_SLOT)
+				{
+					return Tex->GetBindlessSlot();
+				}
+			}
+			return 0u;
+		};
+
+		return glm::uvec4(
+			GetSlot(Textures.m_AlbedoTexture, Defaults.m_AlbedoTexture),
+			GetSlot(Textures.m_NormalTexture, Defaults.m_NormalTexture),
+			GetSlot(Textures.m_MetalTexture, Defaults.m_MetalTexture),
+			GetSlot(Textures.m_RoughnessTexture, Defaults.m_RoughnessTexture));
+	}
+
+	void OffscreenSubpass::UpdateBindlessFrame(uint32 t_ActiveFrameInFlight)
+	{
+		FLING_PROFILE_SCOPE("OffscreenSubpass::UpdateBindlessFrame");
+
+		if (m_BindlessMaterialsStale)
+		{
+			for (size_t Slot = 0; Slot < m_BindlessMaterialOwners.size(); ++Slot)
+			{
+				if (m_BindlessMaterialOwners[Slot])
+				{
+					m_BindlessMaterials[Slot] = GetBindlessTextureSlots(m_BindlessMaterialOwners[Slot]);
+				}
+			}
+			++m_BindlessMaterialsGeneration;
+			m_BindlessMaterialsStale = false;
+		}
+
+		// The frame fence has been waited on, so this frame's buffers can be replaced if they are too small
+		BindlessFrame& Frame = m_BindlessFrames[t_ActiveFrameInFlight];
+
+		const size_t MaterialBytes = m_BindlessMaterials.size() * sizeof(glm::uvec4);
+		const bool MaterialsReplaced = GrowMappedBuffer(Frame.Materials, MaterialBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		if (MaterialsReplaced || Frame.MaterialsGeneration != m_BindlessMaterialsGeneration)
+		{
+			if (MaterialBytes > 0)
+			{
+				memcpy(Frame.Materials->m_MappedMem, m_BindlessMaterials.data(), MaterialBytes);
+			}
+			Frame.MaterialsGeneration = m_BindlessMaterialsGeneration;
+		}
+
+		const size_t InstanceBytes = m_InstanceMaterials.size() * sizeof(uint32);
+		const bool InstancesReplaced = GrowMappedBuffer(Frame.InstanceMaterials, InstanceBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		if (InstancesReplaced || Frame.InstanceMaterialsGeneration != m_InstanceMaterialsGeneration)
+		{
+			if (InstanceBytes > 0)
+			{
+				memcpy(Frame.InstanceMaterials->m_MappedMem, m_InstanceMaterials.data(), InstanceBytes);
+			}
+			Frame.InstanceMaterialsGeneration = m_InstanceMaterialsGeneration;
+		}
+
+		// The set only lives for this frame, and its pool is reset when the frame comes around again.
+		// Writing it every frame also picks up a materials buffer that was just replaced
+		Frame.Set = VulkanApp::Get().GetDescriptorAllocator()->AllocateTransient(m_GraphicsPipeline->GetDescriptorSetLayout(), t_ActiveFrameInFlight);
+
+		VkDescriptorBufferInfo UniformInfo = m_UniformRing->GetDescriptorInfo(sizeof(OffscreenUBO));
+		VkDescriptorBufferInfo MaterialsInfo = { Frame.Materials->GetVkBuffer(), 0, VK_WHOLE_SIZE };
+
+		std::vector<VkWriteDescriptorSet> Writes =
+		{
+			// 0: UBO
+			Initializers::WriteDescriptorSet(Frame.Set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &UniformInfo),
+			// 1: Texture slots of every material
+			Initializers::WriteDescriptorSet(Frame.Set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &MaterialsInfo)
+		};
+
+		vkUpdateDescriptorSets(m_Device->GetVkDevice(), static_cast<uint32>(Writes.size()), Writes.data(), 0, nullptr);
+	}
+
+	void OffscreenSubpass::BindBindlessSets(VkCommandBuffer t_Cmd, uint32 t_ActiveFrameInFlight, uint32 t_DynamicOffset, Stats::DrawCounts& t_Counts)
+	{
+		const VkDescriptorSet Sets[] = { m_BindlessFrames[t_ActiveFrameInFlight].Set, m_Bindless->GetSet() };
+		vkCmdBindDescriptorSets(t_Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline->GetPipelineLayout(), 0, 2, Sets, 1, &t_DynamicOffset);
+		++t_Counts.DescriptorSetBinds;
 	}
 
 	void OffscreenSubpass::BuildOffscreenCommandBuffer(entt::registry& t_reg, uint32 t_ActiveFrameInFlight)
@@ -227,6 +552,669 @@ namespace Fling
 
 	}
 
+	template<class T>
+	uint32 OffscreenSubpass::GetDrawId(T* t_Ptr, std::unordered_map<const T*, uint32>& t_Ids, std::vector<T*>& t_Ptrs)
+	{
+		auto It = t_Ids.find(t_Ptr);
+		if (It != t_Ids.end())
+		{
+			return It->second;
+		}
+
+		const uint32 Id = static_cast<uint32>(t_Ptrs.size());
+		t_Ptrs.emplace_back(t_Ptr);
+		t_Ids.emplace(t_Ptr, Id);
+		return Id;
+	}
+
+	uint32 OffscreenSubpass::CullOccludedCandidates(uint32 t_VisibleCount)
+	{
+		FLING_PROFILE_SCOPE("OffscreenSubpass::CullOccludedCandidates");
+
+		m_Occlusion->Begin(m_Camera->GetProjectionMatrix() * m_Camera->GetViewMatrix());
+
+		bool HasOccluders = false;
+		for (uint32 v = 0; v < t_VisibleCount; ++v)
+		{
+			const DrawCandidate& Candidate = m_DrawCandidates[m_VisibleCandidates[v]];
+			if (Candidate.Mat && !Candidate.Mat->GetOccluder().IsEmpty())
+			{
+				m_Occlusion->AddOccluder(Candidate.Mat->GetOccluder(), *Candidate.World);
+				HasOccluders = true;
+			}
+		}
+
+		if (!HasOccluders)
+		{
+			return t_VisibleCount;
+		}
+
+		m_Occlusion->Rasterize();
+
+		// The buffer is only read from now, so the candidates can be tested on any thread
+		// A few chunks per worker no matter how many candidates there are, but not so small that the jobs cost more than the tests
+		m_CandidateUnoccluded.resize(t_VisibleCount);
+		const uint32 ChunkSize = std::max(64u, t_VisibleCount / (JobSystem::Get().GetWorkerCount() * 4u));
+		JobSystem::Get().ParallelFor(t_VisibleCount, [this](uint32 t_Begin, uint32 t_End)
+		{
+			for (uint32 v = t_Begin; v < t_End; ++v)
+			{
+				const DrawCandidate& Candidate = m_DrawCandidates[m_VisibleCandidates[v]];
+
+				// Occluders are inside of their own bounds, so they would hide themselves
+				const bool IsOccluder = Candidate.Mat && !Candidate.Mat->GetOccluder().IsEmpty();
+				m_CandidateUnoccluded[v] = (IsOccluder || m_Occlusion->IsVisible(Candidate.Model->GetBounds().Transform(*Candidate.World))) ? 1 : 0;
+			}
+		}, ChunkSize);
+
+		uint32 UnoccludedCount = 0;
+		for (uint32 v = 0; v < t_VisibleCount; ++v)
+		{
+			if (m_CandidateUnoccluded[v])
+			{
+				m_VisibleCandidates[UnoccludedCount++] = m_VisibleCandidates[v];
+			}
+		}
+
+		return UnoccludedCount;
+	}
+
+	void OffscreenSubpass::BuildDrawList(entt::registry& t_reg, uint32 t_ActiveFrameInFlight)
+	{
+		FLING_PROFILE_SCOPE("OffscreenSubpass::BuildDrawList");
+
+		m_PrevDrawCandidates.swap(m_DrawCandidates);
+		m_DrawCandidates.clear();
+
+		// World matrices are updated by the transform system in World::Update, which flags the ones it changed
+		auto RenderGroup = t_reg.group<Transform>(entt::get<MeshRenderer, entt::tag<"Default"_hs>>);
+
+		uint32 CandidateCount = 0;
+		bool CandidateMoved = false;
+
+		const SpatialTree* Tree = VulkanApp::Get().GetSpatialTree();
+		if (m_FrustumCulling && m_HierarchicalCulling && Tree)
+		{
+			// Branches of the tree that are fully outside or inside are handled at once, so only visible meshes are visited
+			m_TreeVisible.clear();
+			Tree->QueryFrustum(m_Camera->GetFrustum(), m_TreeVisible);
+
+			for (entt::entity Ent : m_TreeVisible)
+			{
+				if (!t_reg.has<entt::tag<"Default"_hs>>(Ent))
+				{
+					continue;
+				}
+
+				MeshRenderer& MeshRend = t_reg.get<MeshRenderer>(Ent);
+				Fling::Model* Model = MeshRend.m_Model.Get();
+				if (Model)
+				{
+					const Transform& Trans = t_reg.get<Transform>(Ent);
+					m_DrawCandidates.push_back({ Model, MeshRend.m_Material.Get(), &Trans.GetWorldMat() });
+					CandidateMoved |= Trans.HasWorldChanged();
+				}
+			}
+
+			CandidateCount = static_cast<uint32>(RenderGroup.size());
+		}
+		else
+		{
+			RenderGroup.less([&](entt::entity ent, Transform& t_trans, MeshRenderer& t_MeshRend)
+			{
+				Fling::Model* Model = t_MeshRend.m_Model.Get();
+				if (!Model)
+				{
+					return;
+				}
+
+				m_DrawCandidates.push_back({ Model, t_MeshRend.m_Material.Get(), &t_trans.GetWorldMat() });
+				CandidateMoved |= t_trans.HasWorldChanged();
+			});
+
+			CandidateCount = static_cast<uint32>(m_DrawCandidates.size());
+		}
+
+		// A static scene seen from a still camera gets the same list every frame, so the last one is kept
+		const bool CanReuse =
+			m_DrawListValid &&
+			!CandidateMoved &&
+			CandidateCount == m_DrawListCandidateCount &&
+			m_Camera->GetViewMatrix() == m_DrawListView &&
+			m_Camera->GetProjectionMatrix() == m_DrawListProjection &&
+			m_DrawCandidates == m_PrevDrawCandidates;
+
+		if (!CanReuse)
+		{
+			RebuildDrawList(CandidateCount);
+		}
+
+		Stats::Draws::GetCurrentFrame() += m_DrawListCounts;
+
+		UploadInstances(t_ActiveFrameInFlight);
+	}
+
+	void OffscreenSubpass::RebuildDrawList(uint32 t_CandidateCount)
+	{
+		FLING_PROFILE_SCOPE("OffscreenSubpass::RebuildDrawList");
+
+		m_DrawKeys.clear();
+		m_DrawIndices.clear();
+		m_UnsortedInstances.clear();
+		m_UnsortedInstanceMaterials.clear();
+		m_DrawModels.clear();
+		m_DrawMaterials.clear();
+		m_DrawModelIds.clear();
+		m_DrawMaterialIds.clear();
+
+		// There is only one pipeline in this pass
+		const uint32 PipelineId = 0;
+
+		const glm::mat4& View = m_Camera->GetViewMatrix();
+		const float NearPlane = m_Camera->GetNearPlane();
+		const float DepthScale = static_cast<float>(DrawKey::DEPTH_MASK) / std::max(m_Camera->GetFarPlane() - NearPlane, 0.0001f);
+
+		const uint32 GatheredCount = static_cast<uint32>(m_DrawCandidates.size());
+		m_VisibleCandidates.resize(GatheredCount);
+
+		// Candidates from the spatial tree are already inside of the frustum
+		uint32 VisibleCount = GatheredCount;
+		const bool UsedTree = m_FrustumCulling && m_HierarchicalCulling && VulkanApp::Get().GetSpatialTree();
+		if (m_FrustumCulling && !UsedTree)
+		{
+			m_Culler.Clear();
+			for (const DrawCandidate& Candidate : m_DrawCandidates)
+			{
+				m_Culler.Add(Candidate.Model->GetBounds(), *Candidate.World);
+			}
+			VisibleCount = m_Culler.Cull(m_Camera->GetFrustum(), m_VisibleCandidates.data());
+		}
+		else
+		{
+			for (uint32 i = 0; i < GatheredCount; ++i)
+			{
+				m_VisibleCandidates[i] = i;
+			}
+		}
+
+		m_DrawListCounts = {};
+		m_DrawListCounts.MeshesCulled = t_CandidateCount - VisibleCount;
+
+		if (m_OcclusionCulling)
+		{
+			const uint32 UnoccludedCount = CullOccludedCandidates(VisibleCount);
+			m_DrawListCounts.MeshesOccluded = VisibleCount - UnoccludedCount;
+			VisibleCount = UnoccludedCount;
+		}
+
+		m_DrawListCounts.MeshesSubmitted = VisibleCount;
+
+		for (uint32 v = 0; v < VisibleCount; ++v)
+		{
+			const DrawCandidate& Candidate = m_DrawCandidates[m_VisibleCandidates[v]];
+
+			// Bindless instances carry their own material, so every mesh with the same model can be one draw
+			const uint32 ModelId = GetDrawId<Fling::Model>(Candidate.Model, m_DrawModelIds, m_DrawModels);
+			const uint32 MaterialId = m_Bindless ? 0 : GetDrawId<Material>(Candidate.Mat, m_DrawMaterialIds, m_DrawMaterials);
+			if (ModelId > DrawKey::MODEL_MASK || MaterialId > DrawKey::MATERIAL_MASK)
+			{
+				if (!m_HasLoggedDrawKeyOverflow)
+				{
+					F_LOG_WARN("Too many unique models or materials to fit in a draw key! Some meshes will not be drawn");
+					m_HasLoggedDrawKeyOverflow = true;
+				}
+				continue;
+			}
+
+			const glm::mat4& World = *Candidate.World;
+
+			// Distance in front of the camera, the view looks down -Z
+			const float ViewDepth = -(View[0][2] * World[3][0] + View[1][2] * World[3][1] + View[2][2] * World[3][2] + View[3][2]);
+			const float Depth = glm::clamp((ViewDepth - NearPlane) * DepthScale, 0.0f, static_cast<float>(DrawKey::DEPTH_MASK));
+
+			m_DrawKeys.emplace_back(DrawKey::Make(PipelineId, MaterialId, ModelId, static_cast<uint32>(Depth)));
+			m_DrawIndices.emplace_back(static_cast<uint32>(m_UnsortedInstances.size()));
+			m_UnsortedInstances.emplace_back().Model = World;
+			if (m_Bindless)
+			{
+				m_UnsortedInstanceMaterials.emplace_back(GetBindlessMaterial(Candidate.Mat));
+			}
+		}
+
+		const uint32 DrawCount = static_cast<uint32>(m_DrawKeys.size());
+
+		m_DrawKeysTemp.resize(DrawCount);
+		m_DrawIndicesTemp.resize(DrawCount);
+		RadixSort(m_DrawKeys.data(), m_DrawIndices.data(), m_DrawKeysTemp.data(), m_DrawIndicesTemp.data(), DrawCount);
+
+		m_SortedInstances.resize(DrawCount);
+		for (uint32 i = 0; i < DrawCount; ++i)
+		{
+			m_SortedInstances[i] = m_UnsortedInstances[m_DrawIndices[i]];
+		}
+
+		if (m_Bindless)
+		{
+			m_InstanceMaterials.resize(DrawCount);
+			for (uint32 i = 0; i < DrawCount; ++i)
+			{
+				m_InstanceMaterials[i] = m_UnsortedInstanceMaterials[m_DrawIndices[i]];
+			}
+			++m_InstanceMaterialsGeneration;
+		}
+
+		m_DrawListView = View;
+		m_DrawListProjection = m_Camera->GetProjectionMatrix();
+		m_DrawListCandidateCount = t_CandidateCount;
+		m_DrawListValid = true;
+		++m_DrawListGeneration;
+	}
+
+	void OffscreenSubpass::UploadInstances(uint32 t_ActiveFrameInFlight)
+	{
+		const uint32 DrawCount = static_cast<uint32>(m_SortedInstances.size());
+
+		// The frame fence has been waited on, so this frame's buffer can be replaced if it is too small
+		std::unique_ptr<Buffer>& InstanceBuffer = m_InstanceBuffers[t_ActiveFrameInFlight];
+		if (InstanceBuffer->GetSize() < static_cast<VkDeviceSize>(DrawCount) * sizeof(InstanceData))
+		{
+			uint32 NewCapacity = static_cast<uint32>(InstanceBuffer->GetSize() / sizeof(InstanceData));
+			while (NewCapacity < DrawCount)
+			{
+				NewCapacity *= 2;
+			}
+			InstanceBuffer = CreateInstanceBuffer(NewCapacity);
+		}
+		else if (m_InstanceBufferGenerations[t_ActiveFrameInFlight] == m_DrawListGeneration)
+		{
+			// This frame's buffer still has the same draw list from the last time it was used
+			return;
+		}
+
+		if (DrawCount > 0)
+		{
+			memcpy(InstanceBuffer->m_MappedMem, m_SortedInstances.data(), static_cast<size_t>(DrawCount) * sizeof(InstanceData));
+		}
+		m_InstanceBufferGenerations[t_ActiveFrameInFlight] = m_DrawListGeneration;
+	}
+
+	void OffscreenSubpass::UpdateGpuObjects(entt::registry& t_reg)
+	{
+		FLING_PROFILE_SCOPE("OffscreenSubpass::UpdateGpuObjects");
+
+		// World matrices are updated by the transform system in World::Update, which flags the ones it changed
+		auto RenderGroup = t_reg.group<Transform>(entt::get<MeshRenderer, entt::tag<"Default"_hs>>);
+		const uint32 ObjectCount = static_cast<uint32>(RenderGroup.size());
+		const entt::entity* Entities = RenderGroup.data();
+		const Transform* Transforms = RenderGroup.raw<Transform>();
+
+		if (ObjectCount != static_cast<uint32>(m_GpuObjectEntities.size()))
+		{
+			m_GpuObjectsValid = false;
+		}
+
+		if (m_GpuObjectsValid)
+		{
+			// Each job gets whole pages so that no two jobs mark the same page
+			std::atomic<bool> BatchesChanged { false };
+			const uint32 PageCount = (ObjectCount + GpuCuller::OBJECTS_PER_PAGE - 1) / GpuCuller::OBJECTS_PER_PAGE;
+			JobSystem::Get().ParallelFor(PageCount, [&](uint32 t_Begin, uint32 t_End)
+			{
+				const uint32 Last = std::min(t_End * GpuCuller::OBJECTS_PER_PAGE, ObjectCount);
+				for (uint32 i = t_Begin * GpuCuller::OBJECTS_PER_PAGE; i < Last; ++i)
+				{
+					const MeshRenderer& MeshRend = RenderGroup.get<MeshRenderer>(Entities[i]);
+					if (Entities[i] != m_GpuObjectEntities[i] ||
+						MeshRend.m_Model.Get() != m_GpuObjectModels[i] ||
+						MeshRend.m_Material.Get() != m_GpuObjectMaterials[i])
+					{
+						BatchesChanged = true;
+						return;
+					}
+
+					if (Transforms[i].HasWorldChanged())
+					{
+						m_GpuCuller->GetObject(i).World = Transforms[i].GetWorldMat();
+						m_GpuCuller->MarkDirty(i);
+					}
+				}
+			}, 4);
+
+			m_GpuObjectsValid = !BatchesChanged;
+		}
+
+		MeshArena* Arena = VulkanApp::Get().GetMeshArena();
+		if (m_GpuObjectsValid)
+		{
+			// Meshes moved in the arena since the commands were made
+			if (m_GpuArenaVersion != Arena->GetLayoutVersion())
+			{
+				m_GpuCuller->SetBatches(m_GpuBatches, m_DrawModels, m_MultiDrawIndirect);
+				m_GpuArenaVersion = Arena->GetLayoutVersion();
+			}
+			return;
+		}
+
+		// The objects are in group order, and each one with a model is in the batch of its model and material
+		m_DrawModels.clear();
+		m_DrawMaterials.clear();
+		m_DrawModelIds.clear();
+		m_DrawMaterialIds.clear();
+		m_GpuBatches.Clear();
+
+		m_GpuObjectEntities.assign(Entities, Entities + ObjectCount);
+		m_GpuObjectModels.resize(ObjectCount);
+		m_GpuObjectMaterials.resize(ObjectCount);
+		m_GpuCuller->SetObjectCount(ObjectCount);
+		m_GpuDrawableCount = 0;
+
+		for (uint32 i = 0; i < ObjectCount; ++i)
+		{
+			const MeshRenderer& MeshRend = RenderGroup.get<MeshRenderer>(Entities[i]);
+			Fling::Model* Model = MeshRend.m_Model.Get();
+			Material* Mat = MeshRend.m_Material.Get();
+			m_GpuObjectModels[i] = Model;
+			m_GpuObjectMaterials[i] = Mat;
+
+			GpuObject& Object = m_GpuCuller->GetObject(i);
+			Object.World = Transforms[i].GetWorldMat();
+
+			if (Model)
+			{
+				Object.Center = glm::vec4(Model->GetBounds().GetCenter(), 0.0f);
+				Object.Extents = glm::vec4(Model->GetBounds().GetExtents(), 0.0f);
+				m_GpuBatches.Add(GetDrawId<Fling::Model>(Model, m_DrawModelIds, m_DrawModels), GetDrawId<Material>(Mat, m_DrawMaterialIds, m_DrawMaterials));
+				++m_GpuDrawableCount;
+			}
+			else
+			{
+				m_GpuBatches.AddEmpty();
+			}
+		}
+
+		m_GpuBatches.Build();
+		for (uint32 i = 0; i < ObjectCount; ++i)
+		{
+			m_GpuCuller->GetObject(i).Batch = m_GpuBatches.GetObjectBatch(i);
+		}
+
+		// The culler packs each batch's visible instances at the start of its range, so the whole range gets its material
+		if (m_Bindless)
+		{
+			m_InstanceMaterials.clear();
+			for (const DrawBatchTable::Batch& Batch : m_GpuBatches.GetBatches())
+			{
+				m_InstanceMaterials.resize(Batch.FirstInstance + Batch.ObjectCount);
+				std::fill(
+					m_InstanceMaterials.begin() + Batch.FirstInstance,
+					m_InstanceMaterials.end(),
+					GetBindlessMaterial(m_DrawMaterials[Batch.Material]));
+			}
+			++m_InstanceMaterialsGeneration;
+		}
+
+		m_GpuCuller->SetBatches(m_GpuBatches, m_DrawModels, m_MultiDrawIndirect);
+		m_GpuArenaVersion = Arena->GetLayoutVersion();
+		m_GpuCuller->MarkAllDirty();
+		m_GpuObjectsValid = true;
+	}
+
+	void OffscreenSubpass::RecordIndirectDraws(uint32 t_ActiveFrameInFlight, uint32 t_DynamicOffset, const VkViewport& t_Viewport, const VkRect2D& t_Scissor)
+	{
+		FLING_PROFILE_SCOPE("OffscreenSubpass::RecordIndirectDraws");
+
+		FrameCommands& Frame = m_FrameCommands[t_ActiveFrameInFlight];
+
+		m_DrawMaterialSets.resize(m_Bindless ? 0 : m_DrawMaterials.size());
+		for (size_t i = 0; i < m_DrawMaterialSets.size(); ++i)
+		{
+			m_DrawMaterialSets[i] = GetMaterialDescriptorSet(m_DrawMaterials[i]);
+		}
+
+		GpuProfiler* Profiler = VulkanApp::Get().GetGpuProfiler();
+		const VkQueryPipelineStatisticFlags InheritedStatistics = Profiler ? Profiler->GetInheritedStatistics() : 0;
+
+		// There is one draw per batch no matter how many meshes there are, so this is never worth splitting up
+		CommandBuffer& Secondary = *Frame.Secondaries[0];
+		Secondary.BeginSecondary(*m_OffscreenFrameBuf, 0, InheritedStatistics);
+		Secondary.SetViewport(0, { t_Viewport });
+		Secondary.SetScissor(0, { t_Scissor });
+
+		VkCommandBuffer Cmd = Secondary.GetHandle();
+		VkBuffer DrawBuffer = m_GpuCuller->GetDrawBuffer(t_ActiveFrameInFlight);
+		VkBuffer InstanceBuffer = m_GpuCuller->GetInstanceBuffer(t_ActiveFrameInFlight);
+		VkBuffer MaterialBuffer = m_Bindless ? m_BindlessFrames[t_ActiveFrameInFlight].InstanceMaterials->GetVkBuffer() : VK_NULL_HANDLE;
+
+		Stats::DrawCounts Counts = {};
+
+		vkCmdBindPipeline(Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline->GetPipeline());
+		++Counts.PipelineBinds;
+
+		// Every model is in the arena, so this is the only mesh bind
+		VulkanApp::Get().GetMeshArena()->Bind(Cmd);
+		++Counts.VertexBufferBinds;
+		++Counts.IndexBufferBinds;
+
+		// Instance data and the material of each instance are next to each other at bindings 1 and 2
+		const VkBuffer InstanceBuffers[] = { InstanceBuffer, MaterialBuffer };
+		const uint32 InstanceBindingCount = m_Bindless ? 2 : 1;
+
+		// With first instance in the commands, every batch reads its instances out of the same binding
+		if (m_MultiDrawIndirect)
+		{
+			const VkDeviceSize InstanceOffsets[] = { 0, 0 };
+			vkCmdBindVertexBuffers(Cmd, 1, InstanceBindingCount, InstanceBuffers, InstanceOffsets);
+			++Counts.VertexBufferBinds;
+		}
+
+		// Every material's textures are in these, so nothing is bound per batch
+		if (m_Bindless)
+		{
+			BindBindlessSets(Cmd, t_ActiveFrameInFlight, t_DynamicOffset, Counts);
+		}
+
+		const uint32 MaxDrawCount = m_MultiDrawIndirect ? m_Device->GetPhysicalDevice()->GetDeviceProps().limits.maxDrawIndirectCount : 1;
+
+		const std::vector<DrawBatchTable::Batch>& Batches = m_GpuBatches.GetBatches();
+		const uint32 BatchCount = static_cast<uint32>(Batches.size());
+		uint32 BoundMaterial = ~0u;
+		uint32 First = 0;
+		while (First < BatchCount)
+		{
+			// Batches are sorted by material, so the ones that share its bindings are next to each other.
+			// Bindless batches share every binding, so they are drawn together up to the device's limit
+			const uint32 Material = Batches[First].Material;
+			uint32 Last = First + 1;
+			while (Last < BatchCount && Last - First < MaxDrawCount && (m_Bindless || Batches[Last].Material == Material))
+			{
+				++Last;
+			}
+
+			if (!m_Bindless && Material != BoundMaterial)
+			{
+				BoundMaterial = Material;
+				VkDescriptorSet MaterialSet = m_DrawMaterialSets[Material];
+				vkCmdBindDescriptorSets(Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline->GetPipelineLayout(), 0, 1, &MaterialSet, 1, &t_DynamicOffset);
+				++Counts.DescriptorSetBinds;
+			}
+
+			if (m_MultiDrawIndirect)
+			{
+				vkCmdDrawIndexedIndirect(Cmd, DrawBuffer, static_cast<VkDeviceSize>(First) * sizeof(GpuDrawCommand), Last - First, sizeof(GpuDrawCommand));
+				++Counts.DrawCalls;
+			}
+			else
+			{
+				for (uint32 b = First; b < Last; ++b)
+				{
+					// Without drawIndirectFirstInstance each batch's instance range is picked with the binding offset
+					const VkDeviceSize InstanceOffsets[] =
+					{
+						static_cast<VkDeviceSize>(Batches[b].FirstInstance) * sizeof(InstanceData),
+						static_cast<VkDeviceSize>(Batches[b].FirstInstance) * sizeof(uint32)
+					};
+					vkCmdBindVertexBuffers(Cmd, 1, InstanceBindingCount, InstanceBuffers, InstanceOffsets);
+					++Counts.VertexBufferBinds;
+
+					vkCmdDrawIndexedIndirect(Cmd, DrawBuffer, static_cast<VkDeviceSize>(b) * sizeof(GpuDrawCommand), 1, sizeof(GpuDrawCommand));
+					++Counts.DrawCalls;
+				}
+			}
+
+			First = Last;
+		}
+
+		Secondary.End();
+
+		Stats::Draws::GetCurrentFrame() += Counts;
+
+		m_ChunkCmdBufs.clear();
+		m_ChunkCmdBufs.emplace_back(Secondary.GetHandle());
+	}
+
+	void OffscreenSubpass::RecordDrawChunks(uint32 t_ActiveFrameInFlight, uint32 t_DynamicOffset, const VkViewport& t_Viewport, const VkRect2D& t_Scissor)
+	{
+		FLING_PROFILE_SCOPE("OffscreenSubpass::RecordDrawChunks");
+
+		FrameCommands& Frame = m_FrameCommands[t_ActiveFrameInFlight];
+
+		const uint32 DrawCount = static_cast<uint32>(m_DrawKeys.size());
+		const uint32 ChunkCount = std::min(static_cast<uint32>(Frame.Secondaries.size()), std::max(DrawCount / MIN_DRAWS_PER_CHUNK, 1u));
+
+		// Chunks only start on a new batch so that no instanced draw is split in two
+		m_ChunkStarts.resize(ChunkCount + 1);
+		m_ChunkStarts[0] = 0;
+		for (uint32 Chunk = 1; Chunk < ChunkCount; ++Chunk)
+		{
+			uint32 Start = std::max(m_ChunkStarts[Chunk - 1], static_cast<uint32>(static_cast<uint64>(DrawCount) * Chunk / ChunkCount));
+			while (Start > 0 && Start < DrawCount && DrawKey::GetBatch(m_DrawKeys[Start]) == DrawKey::GetBatch(m_DrawKeys[Start - 1]))
+			{
+				++Start;
+			}
+			m_ChunkStarts[Chunk] = Start;
+		}
+		m_ChunkStarts[ChunkCount] = DrawCount;
+
+		// Descriptor sets are created the first time a material is drawn, which has to happen on this thread
+		m_DrawMaterialSets.resize(m_DrawMaterials.size());
+		for (size_t i = 0; i < m_DrawMaterials.size(); ++i)
+		{
+			m_DrawMaterialSets[i] = GetMaterialDescriptorSet(m_DrawMaterials[i]);
+		}
+
+		Frame.ChunkCounts.assign(ChunkCount, {});
+
+		GpuProfiler* Profiler = VulkanApp::Get().GetGpuProfiler();
+		const VkQueryPipelineStatisticFlags InheritedStatistics = Profiler ? Profiler->GetInheritedStatistics() : 0;
+
+		// One job per chunk, chunk N always records with pool N
+		JobSystem::Get().ParallelFor(ChunkCount, [&](uint32 t_Begin, uint32 t_End)
+		{
+			for (uint32 Chunk = t_Begin; Chunk < t_End; ++Chunk)
+			{
+				FLING_PROFILE_SCOPE("OffscreenSubpass::RecordChunk");
+
+				CommandBuffer& Secondary = *Frame.Secondaries[Chunk];
+				Secondary.BeginSecondary(*m_OffscreenFrameBuf, 0, InheritedStatistics);
+
+				// Dynamic state is not inherited from the primary command buffer
+				Secondary.SetViewport(0, { t_Viewport });
+				Secondary.SetScissor(0, { t_Scissor });
+
+				RecordDrawList(Secondary, t_ActiveFrameInFlight, t_DynamicOffset, m_ChunkStarts[Chunk], m_ChunkStarts[Chunk + 1], Frame.ChunkCounts[Chunk]);
+
+				Secondary.End();
+			}
+		}, 1);
+
+		Stats::DrawCounts& Counts = Stats::Draws::GetCurrentFrame();
+		m_ChunkCmdBufs.clear();
+		for (uint32 Chunk = 0; Chunk < ChunkCount; ++Chunk)
+		{
+			Counts += Frame.ChunkCounts[Chunk];
+
+			m_ChunkCmdBufs.emplace_back(Frame.Secondaries[Chunk]->GetHandle());
+		}
+	}
+
+	void OffscreenSubpass::RecordDrawList(
+		CommandBuffer& t_CmdBuf,
+		uint32 t_ActiveFrameInFlight,
+		uint32 t_DynamicOffset,
+		uint32 t_First,
+		uint32 t_Last,
+		Stats::DrawCounts& t_Counts)
+	{
+		VkCommandBuffer Cmd = t_CmdBuf.GetHandle();
+
+		// Instances are in sorted order, each draw picks its range with the first instance. The bindless
+		// material of each instance is in the same order at the next binding
+		const VkBuffer InstanceBuffers[] =
+		{
+			m_InstanceBuffers[t_ActiveFrameInFlight]->GetVkBuffer(),
+			m_Bindless ? m_BindlessFrames[t_ActiveFrameInFlight].InstanceMaterials->GetVkBuffer() : VK_NULL_HANDLE
+		};
+		const VkDeviceSize InstanceOffsets[] = { 0, 0 };
+		vkCmdBindVertexBuffers(Cmd, 1, m_Bindless ? 2 : 1, InstanceBuffers, InstanceOffsets);
+		++t_Counts.VertexBufferBinds;
+
+		// Every model is in the arena, so switching models only changes the draw's offsets
+		VulkanApp::Get().GetMeshArena()->Bind(Cmd);
+		++t_Counts.VertexBufferBinds;
+		++t_Counts.IndexBufferBinds;
+
+		const uint32 NoId = ~0u;
+		uint32 BoundPipeline = NoId;
+		uint32 BoundMaterial = NoId;
+
+		uint32 First = t_First;
+		while (First < t_Last)
+		{
+			const uint64 Key = m_DrawKeys[First];
+			uint32 Last = First + 1;
+			while (Last < t_Last && DrawKey::GetBatch(m_DrawKeys[Last]) == DrawKey::GetBatch(Key))
+			{
+				++Last;
+			}
+
+			if (DrawKey::GetPipeline(Key) != BoundPipeline)
+			{
+				BoundPipeline = DrawKey::GetPipeline(Key);
+				vkCmdBindPipeline(Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline->GetPipeline());
+				++t_Counts.PipelineBinds;
+
+				// Every material's textures are in the bindless sets, so they are only bound once
+				if (m_Bindless)
+				{
+					BindBindlessSets(Cmd, t_ActiveFrameInFlight, t_DynamicOffset, t_Counts);
+				}
+			}
+
+			if (!m_Bindless && DrawKey::GetMaterial(Key) != BoundMaterial)
+			{
+				BoundMaterial = DrawKey::GetMaterial(Key);
+				VkDescriptorSet MaterialSet = m_DrawMaterialSets[BoundMaterial];
+				vkCmdBindDescriptorSets(
+					Cmd,
+					VK_PIPELINE_BIND_POINT_GRAPHICS,
+					m_GraphicsPipeline->GetPipelineLayout(),
+					0,
+					1,
+					&MaterialSet,
+					1,
+					&t_DynamicOffset);
+				++t_Counts.DescriptorSetBinds;
+			}
+
+			const Fling::Model* Model = m_DrawModels[DrawKey::GetModel(Key)];
+			vkCmdDrawIndexed(Cmd, Model->GetIndexCount(), Last - First, Model->GetFirstIndex(), Model->GetVertexOffset(), First);
+			++t_Counts.DrawCalls;
+			t_Counts.Instances += Last - First;
+
+			First = Last;
+		}
+	}
+
 	void OffscreenSubpass::PrepareAttachments()
 	{
 		assert(m_OffscreenFrameBuf == nullptr);
@@ -276,35 +1264,26 @@ namespace Fling
 		// Attachment 3: Depth
 		attachmentInfo.Format = attDepthFormat;
 		attachmentInfo.Usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-		m_OffscreenFrameBuf->AddAttachment(attachmentInfo);
+
+		// Sampled depth is stored at the end of the pass, so it is only asked for when the depth pyramid needs it
+		m_GpuOcclusion = m_GpuCulling && GpuCuller::SupportsDepthPyramid(m_Device, attDepthFormat);
+		if (m_GpuCulling && !m_GpuOcclusion)
+		{
+			F_LOG_WARN("Depth format {} can't be sampled, GPU culling will not test occlusion", attDepthFormat);
+		}
+		if (m_GpuOcclusion)
+		{
+			attachmentInfo.Usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+		}
+		m_DepthAttachment = m_OffscreenFrameBuf->AddAttachment(attachmentInfo);
 
 		// Create sampler to sample from the color attachments
 		VK_CHECK_RESULT(m_OffscreenFrameBuf->CreateSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
 		VK_CHECK_RESULT(m_OffscreenFrameBuf->CreateRenderPass());
 		F_LOG_TRACE("Offscreen render pass created...");
 
-		// Create the descriptor pool for off screen things
-		uint32 DescriptorCount = 2000 * m_SwapChain->GetImageViewCount();
-
-		static std::vector<VkDescriptorPoolSize> poolSizes =
-		{
-			Initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 		DescriptorCount),
-			Initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 			DescriptorCount),
-			Initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_SAMPLER, 				DescriptorCount),
-			Initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, DescriptorCount),
-			Initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 		DescriptorCount)
-		};
-
-		VkDescriptorPoolCreateInfo poolInfo = {};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = static_cast<uint32>(poolSizes.size());
-		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = to_u32(1000 * m_SwapChain->GetImageViewCount());
-
-		if (vkCreateDescriptorPool(m_Device->GetVkDevice(), &poolInfo, nullptr, &m_DescriptorPool) != VK_SUCCESS)
-		{
-			F_LOG_FATAL("Failed to create descriptor pool");
-		}
+		// Descriptor sets are per material and shared between frames in flight thanks to the dynamic UBO.
+		// They come from the VulkanApp's descriptor allocator, so there is no limit on how many materials there are
 	}
 
 	void OffscreenSubpass::CreateGraphicsPipeline()
@@ -341,6 +1320,28 @@ namespace Fling
 
 		m_GraphicsPipeline->m_MultisampleState =
 			Initializers::PipelineMultiSampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+
+		// Model matrices come from the instance buffer
+		std::array<VkVertexInputAttributeDescription, 4> InstanceAttributes = InstanceData::GetAttributeDescriptions();
+		m_GraphicsPipeline->m_ExtraVertexBindings = { InstanceData::GetBindingDescription() };
+		m_GraphicsPipeline->m_ExtraVertexAttributes.assign(InstanceAttributes.begin(), InstanceAttributes.end());
+
+		// The bindless material slot of each instance, right after the model matrix
+		if (m_Bindless)
+		{
+			VkVertexInputBindingDescription MaterialBinding = {};
+			MaterialBinding.binding = 2;
+			MaterialBinding.stride = sizeof(uint32);
+			MaterialBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+			m_GraphicsPipeline->m_ExtraVertexBindings.emplace_back(MaterialBinding);
+
+			VkVertexInputAttributeDescription MaterialAttribute = {};
+			MaterialAttribute.binding = 2;
+			MaterialAttribute.location = 9;
+			MaterialAttribute.format = VK_FORMAT_R32_UINT;
+			MaterialAttribute.offset = 0;
+			m_GraphicsPipeline->m_ExtraVertexAttributes.emplace_back(MaterialAttribute);
+		}
 		
 		std::vector<VkDynamicState> dynamicStateEnables = 
 		{
@@ -357,25 +1358,27 @@ namespace Fling
 		m_GraphicsPipeline->CreateGraphicsPipeline(RenderPass, nullptr);
 	}
 
-	void OffscreenSubpass::GatherPresentDependencies(std::vector<CommandBuffer*>& t_CmdBuffs, std::vector<VkSemaphore>& t_Deps, uint32 t_ActiveFrameIndex, uint32 t_CurrentFrameInFlight)
+	void OffscreenSubpass::GatherPresentDependencies(std::vector<CommandBuffer*>& t_CmdBuffs, std::vector<VkSemaphore>& t_Deps, uint32 t_CurrentFrameInFlight)
 	{
-		t_CmdBuffs.emplace_back(m_OffscreenCmdBufs[t_ActiveFrameIndex]);
+		t_CmdBuffs.emplace_back(m_OffscreenCmdBufs[t_CurrentFrameInFlight]);
 		t_Deps.emplace_back(m_OffscreenSemaphores[t_CurrentFrameInFlight]);
 	}
 
 	void OffscreenSubpass::CleanUp(entt::registry& t_reg)
 	{
 		assert(m_Device != nullptr);
-		
-		t_reg.view<MeshRenderer>().each([](MeshRenderer& t_Mesh)
+
+		DescriptorAllocator* Allocator = VulkanApp::Get().GetDescriptorAllocator();
+		for (const auto& MatSet : m_MaterialDescriptorSets)
 		{
-			t_Mesh.Release();
-		});
+			Allocator->ReleaseCached(MatSet.second);
+		}
+		m_MaterialDescriptorSets.clear();
 
-		if (m_DescriptorPool != VK_NULL_HANDLE)
+		// The bindless sets are transient, so they are given back along with their frame's pools
+		for (BindlessFrame& Frame : m_BindlessFrames)
 		{
-			vkDestroyDescriptorPool(m_Device->GetVkDevice(), m_DescriptorPool, nullptr);
-			m_DescriptorPool = VK_NULL_HANDLE;
+			Frame.Set = VK_NULL_HANDLE;
 		}
 	}
 
@@ -385,6 +1388,11 @@ namespace Fling
 		if (m_OffscreenFrameBuf)
 		{
 			m_OffscreenFrameBuf->ResizeAndRecreate(NewSize.width, NewSize.height);
+
+			if (m_GpuCuller)
+			{
+				m_GpuCuller->OnResize(*m_OffscreenFrameBuf->GetAttachmentAtIndex(m_DepthAttachment), NewSize.width, NewSize.height);
+			}
 		}
 	}
 
@@ -397,16 +1405,54 @@ namespace Fling
 
 		t_Reg.assign<entt::tag<"Default"_hs >>(t_Ent);
 
-		// Initialize and map the UBO of each mesh renderer
-		if (t_MeshRend.m_UniformBuffer == nullptr)
+		// Joining the group can reorder it
+		m_GpuObjectsValid = false;
+
+		// Ensure that we have a material to try and sample from. Uniform data lives in the
+		// ring and descriptor sets are per material, so there is nothing else to create here
+		if (!t_MeshRend.m_Material)
 		{
-			VkDeviceSize bufferSize = sizeof(OffscreenUBO);
-			t_MeshRend.m_UniformBuffer = new Buffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			t_MeshRend.m_UniformBuffer->MapMemory(bufferSize);
+			t_MeshRend.m_Material = ResourceManager::LoadHandle<Material>("Materials/Default.mat");
 		}
-		
-		// I would love to create some descriptor sets here		
-		CreateMeshDescriptorSet(t_MeshRend);
+	}
+
+	void OffscreenSubpass::OnResourceEvicted(Resource& t_Res)
+	{
+		// A new model or material can be loaded at the same address, which the draw list would not notice
+		m_DrawListValid = false;
+		m_GpuObjectsValid = false;
+
+		// Materials that used an unloaded texture have to fall back to the default one
+		if (m_Bindless && dynamic_cast<const Texture*>(&t_Res) != nullptr)
+		{
+			m_BindlessMaterialsStale = true;
+			return;
+		}
+
+		// Nothing has drawn with an unloaded material for more than the frames in flight
+		const Material* Mat = dynamic_cast<const Material*>(&t_Res);
+		if (Mat == nullptr)
+		{
+			return;
+		}
+
+		auto BindlessIt = m_BindlessMaterialSlots.find(Mat);
+		if (BindlessIt != m_BindlessMaterialSlots.end())
+		{
+			m_BindlessMaterialOwners[BindlessIt->second] = nullptr;
+			m_FreeBindlessMaterials.emplace_back(BindlessIt->second);
+			m_BindlessMaterialSlots.erase(BindlessIt);
+		}
+
+		auto It = m_MaterialDescriptorSets.find(Mat);
+		if (It == m_MaterialDescriptorSets.end())
+		{
+			return;
+		}
+
+		// Other materials with the same textures can still be using the set
+		VulkanApp::Get().GetDescriptorAllocator()->ReleaseCached(It->second);
+		m_MaterialDescriptorSets.erase(It);
 	}
 
 	void OffscreenSubpass::OnMeshRendererDestroyed(entt::registry& t_Reg, MeshRenderer& t_MeshRend)
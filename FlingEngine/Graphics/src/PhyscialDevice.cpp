@@ -35,10 +35,77 @@ namespace Fling
 		vkGetPhysicalDeviceProperties(m_PhysicalDevice, &m_DeviceProperties);
 		vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &m_DeviceFeatures);
 		vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &m_MemoryProperties);
+
+		uint32 ExtensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &ExtensionCount, nullptr);
+		m_Extensions.resize(ExtensionCount);
+		vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &ExtensionCount, m_Extensions.data());
+
+		QueryExtendedFeatures();
 		
 		LogPhysicalDeviceInfo();
     }
 
+	void PhysicalDevice::QueryExtendedFeatures()
+	{
+		m_DescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		m_DescriptorIndexingProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+		// Descriptor indexing also needs maintenance3 to be enabled
+		if (!m_Instance->HasPhysicalDeviceProperties2() ||
+			!HasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) ||
+			!HasExtension(VK_KHR_MAINTENANCE3_EXTENSION_NAME))
+		{
+			return;
+		}
+
+		// These are instance extension functions, so they aren't exported by the loader
+		VkInstance RawInstance = m_Instance->GetRawVkInstance();
+		PFN_vkGetPhysicalDeviceFeatures2KHR GetFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(RawInstance, "vkGetPhysicalDeviceFeatures2KHR"));
+		PFN_vkGetPhysicalDeviceProperties2KHR GetProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(vkGetInstanceProcAddr(RawInstance, "vkGetPhysicalDeviceProperties2KHR"));
+		if (!GetFeatures2 || !GetProperties2)
+		{
+			return;
+		}
+
+		VkPhysicalDeviceFeatures2KHR Features2 = {};
+		Features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		Features2.pNext = &m_DescriptorIndexingFeatures;
+		GetFeatures2(m_PhysicalDevice, &Features2);
+
+		VkPhysicalDeviceProperties2KHR Properties2 = {};
+		Properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+		Properties2.pNext = &m_DescriptorIndexingProps;
+		GetProperties2(m_PhysicalDevice, &Properties2);
+
+		// Neither is chained to anything else
+		m_DescriptorIndexingFeatures.pNext = nullptr;
+		m_DescriptorIndexingProps.pNext = nullptr;
+	}
+
+	bool PhysicalDevice::SupportsBindlessTextures() const
+	{
+		const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& Features = m_DescriptorIndexingFeatures;
+		return
+			Features.runtimeDescriptorArray &&
+			Features.shaderSampledImageArrayNonUniformIndexing &&
+			Features.descriptorBindingPartiallyBound &&
+			Features.descriptorBindingSampledImageUpdateAfterBind &&
+			Features.descriptorBindingUpdateUnusedWhilePending;
+	}
+
+	bool PhysicalDevice::HasExtension(const char* t_Name) const
+	{
+		for (const VkExtensionProperties& Extension : m_Extensions)
+		{
+			if (strcmp(t_Name, Extension.extensionName) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
 	VkFormatProperties PhysicalDevice::GetFormatProperties(VkFormat t_Form) const
 	{
 		assert(m_PhysicalDevice != VK_NULL_HANDLE);
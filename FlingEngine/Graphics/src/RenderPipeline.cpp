@@ -5,6 +5,9 @@
 #include "SwapChain.h"
 #include "FrameBuffer.h"
 #include "MeshRenderer.h"
+#include "VulkanApp.h"
+#include "GpuProfiler.h"
+#include "DescriptorAllocator.h"
 
 namespace Fling
 {
@@ -22,6 +25,15 @@ namespace Fling
 		}
 		F_LOG_TRACE("Render pipeline Graphics Pipelines created...");
 
+		// Time each subpass on the GPU
+		if (GpuProfiler* Profiler = VulkanApp::Get().GetGpuProfiler())
+		{
+			for (const std::unique_ptr<Subpass>& pass : m_Subpasses)
+			{
+				pass->SetGpuScope(Profiler->RegisterScope(pass->GetName()));
+			}
+		}
+
 		// Build Descriptor sets -------
 		CreateDescriptors(t_Reg);
 
@@ -32,41 +44,74 @@ namespace Fling
 	{
 		assert(m_Device);
 
-		vkDestroyDescriptorPool(m_Device->GetVkDevice(), m_DescriptorPool, nullptr);
-
-		// Cleanup subpasses
+		// Cleanup subpasses. They give their descriptor sets back to the allocator
 		m_Subpasses.clear();
 	}
 
+	void RenderPipeline::PrepareDraw(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight)
+	{
+		GpuProfiler* Profiler = VulkanApp::Get().GetGpuProfiler();
+		if (!Profiler)
+		{
+			return;
+		}
+
+		// Queries can't be reset inside of a render pass. Subpasses with their own command buffers reset their own
+		for (const std::unique_ptr<Subpass>& pass : m_Subpasses)
+		{
+			if (!pass->RecordsOwnCommandBuffer())
+			{
+				Profiler->ResetScope(t_CmdBuf.GetHandle(), t_ActiveFrameInFlight, pass->GetGpuScope());
+			}
+		}
+	}
+
 	void RenderPipeline::Draw(CommandBuffer& t_CmdBuf, VkFramebuffer t_PresentFrameBuf, uint32 t_ActiveFrameInFlight, entt::registry& t_Reg, float DeltaTime)
 	{
 		assert(!m_Subpasses.empty() && "Render pipeline should contain at least one sub-pass");
 
+		FLING_PROFILE_SCOPE("RenderPipeline::Draw");
+
+		GpuProfiler* Profiler = VulkanApp::Get().GetGpuProfiler();
+
 		for (size_t i = 0; i < m_Subpasses.size(); ++i)
 		{
+			Subpass* Pass = m_Subpasses[i].get();
+			const bool IsTimedHere = Profiler && !Pass->RecordsOwnCommandBuffer();
+
+			if (IsTimedHere)
+			{
+				Profiler->BeginScope(t_CmdBuf.GetHandle(), t_ActiveFrameInFlight, Pass->GetGpuScope());
+			}
+
 			// Build the subpasses for the active frame in flight	
-			m_Subpasses[i]->Draw(
+			Pass->Draw(
 				t_CmdBuf, 
 				t_ActiveFrameInFlight, 
 				t_Reg,
 				DeltaTime
 			);
+
+			if (IsTimedHere)
+			{
+				Profiler->EndScope(t_CmdBuf.GetHandle(), t_ActiveFrameInFlight, Pass->GetGpuScope());
+			}
 		}
 	}
 
-	void RenderPipeline::GatherPresentDependencies(std::vector<CommandBuffer*>& t_CmdBuffs, std::vector<VkSemaphore>& t_Deps, uint32 t_ActiveFrameIndex, uint32 t_CurrentFrameInFlight)
+	void RenderPipeline::GatherPresentDependencies(std::vector<CommandBuffer*>& t_CmdBuffs, std::vector<VkSemaphore>& t_Deps, uint32 t_CurrentFrameInFlight)
 	{
 		for (const auto& subpass : m_Subpasses)
 		{
-			subpass->GatherPresentDependencies(t_CmdBuffs, t_Deps, t_ActiveFrameIndex, t_CurrentFrameInFlight);
+			subpass->GatherPresentDependencies(t_CmdBuffs, t_Deps, t_CurrentFrameInFlight);
 		}
 	}
 
-	void RenderPipeline::GatherPresentBuffers(std::vector<CommandBuffer*>& t_CmdBuffs, uint32 t_ActiveFrameIndex)
+	void RenderPipeline::GatherPresentBuffers(std::vector<CommandBuffer*>& t_CmdBuffs, uint32 t_CurrentFrameInFlight)
 	{
 		for (const auto& subpass : m_Subpasses)
 		{
-			subpass->GatherPresentBuffers(t_CmdBuffs, t_ActiveFrameIndex);
+			subpass->GatherPresentBuffers(t_CmdBuffs, t_CurrentFrameInFlight);
 		}
 	}
 
@@ -88,33 +133,16 @@ namespace Fling
 
 	void RenderPipeline::CreateDescriptors(entt::registry& t_Reg)
 	{
-		// Create the descriptor pool for us to use -------
-		const uint32 SwapImageCount = static_cast<uint32>(m_SwapChain->GetImageCount());
-		uint32 DescriptorCount = 1024;
-
-		std::vector<VkDescriptorPoolSize> poolSizes =
-		{
-			Initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, DescriptorCount),
-			Initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, DescriptorCount),
-			Initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_SAMPLER, DescriptorCount),
-			Initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, DescriptorCount),
-			Initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, DescriptorCount)
-		};
-
-		VkDescriptorPoolCreateInfo poolInfo = {};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = static_cast<uint32>(poolSizes.size());
-		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = SwapImageCount;
-
-		VK_CHECK_RESULT(vkCreateDescriptorPool(m_Device->GetVkDevice(), &poolInfo, nullptr, &m_DescriptorPool));
+		// Every subpass allocates its sets out of the shared allocator, which makes more pools as they are needed
+		DescriptorAllocator* Allocator = VulkanApp::Get().GetDescriptorAllocator();
+		assert(Allocator);
 
 		// Build all the descriptor SETS in each subpass
 		assert(!m_Subpasses.empty() && "Render pipeline should contain at least one sub-pass");
 
 		for (std::unique_ptr<Subpass>& Pass : m_Subpasses)
 		{	
-			Pass->CreateDescriptorSets(m_DescriptorPool, t_Reg);
+			Pass->CreateDescriptorSets(*Allocator, t_Reg);
 		}
 	}
 }
\ No newline at end of file
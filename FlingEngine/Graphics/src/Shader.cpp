@@ -2,6 +2,8 @@
 #include "Shader.h"
 #include "ResourceManager.h"
 #include "LogicalDevice.h"
+#include "VulkanApp.h"
+#include "DescriptorAllocator.h"
 
 namespace Fling
 {
@@ -13,6 +15,7 @@ namespace Fling
 		uint32_t storageClass{};
 		uint32_t binding{};
 		uint32_t set{};
+		bool bufferBlock{};
 	};
 
     std::shared_ptr<Fling::Shader> Shader::Create(Guid t_ID, LogicalDevice* t_Dev)
@@ -26,11 +29,19 @@ namespace Fling
 		, m_Device(t_Dev)
     {
 		assert(m_Device);
-        std::vector<char> RawCode = LoadRawBytes(GetFilepathReleativeToAssets());
+
+		// Shaders that the build compiles are in the build folder, the rest are only in the assets
+		std::string FilePath = FlingPaths::CompiledAssetsDir() + "/" + GetGuidString();
+		if (!std::ifstream(FilePath).good())
+		{
+			FilePath = GetFilepathReleativeToAssets();
+		}
+
+        std::vector<char> RawCode = LoadRawBytes(FilePath);
         
         if (CreateShaderModule(RawCode) != VK_SUCCESS)
         {
-            F_LOG_ERROR("Failed to create shader module for {}", GetFilepathReleativeToAssets());
+            F_LOG_ERROR("Failed to create shader module for {}", FilePath);
         }
 
 		assert(RawCode.size() % 4 == 0);
@@ -154,6 +165,9 @@ namespace Fling
 					assert(wordCount == 4);
 					ids[id].binding = insn[3];
 					break;
+				case SpvDecorationBufferBlock:
+					ids[id].bufferBlock = true;
+					break;
 				}
 			} break;
 			case SpvOpTypeStruct:
@@ -204,19 +218,27 @@ namespace Fling
 		{
 			if (id.opcode == SpvOpVariable && (id.storageClass == SpvStorageClassUniform || id.storageClass == SpvStorageClassUniformConstant || id.storageClass == SpvStorageClassStorageBuffer))
 			{
-				assert(id.set == 0);
+				// Only set 0 is reflected. Other sets use layouts that are shared between pipelines, like the bindless textures
+				if (id.set != 0)
+				{
+					continue;
+				}
+
 				assert(id.binding < 32);
 				assert(ids[id.typeId].opcode == SpvOpTypePointer);
 
 				assert((m_ResourceMask & (1 << id.binding)) == 0);
 
-				uint32_t typeKind = ids[ids[id.typeId].typeId].opcode;
+				const Id& type = ids[ids[id.typeId].typeId];
+				uint32_t typeKind = type.opcode;
 
 				switch (typeKind)
 				{
 				case SpvOpTypeStruct:
-					//m_ResourceTypes[id.binding] = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-					m_ResourceTypes[id.binding] = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+					// SPIR-V 1.0 marks storage buffers as uniform blocks with the BufferBlock decoration
+					m_ResourceTypes[id.binding] = (id.storageClass == SpvStorageClassStorageBuffer || type.bufferBlock) ?
+						VK_DESCRIPTOR_TYPE_STORAGE_BUFFER :
+						VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 
 					m_ResourceMask |= 1 << id.binding;
 					break;
@@ -279,7 +301,7 @@ namespace Fling
 		}
 	}
 
-	VkDescriptorSetLayout Shader::CreateSetLayout(VkDevice t_Dev, std::vector<Shader*>& t_Shaders, bool t_SupportPushDescriptor)
+	VkDescriptorSetLayout Shader::CreateSetLayout(VkDevice t_Dev, std::vector<Shader*>& t_Shaders, bool t_SupportPushDescriptor, uint32 t_DynamicUniformBindings)
 	{
 		std::vector<VkDescriptorSetLayoutBinding> setBindings;
 
@@ -295,6 +317,11 @@ namespace Fling
 				binding.descriptorType = resourceTypes[i];
 				binding.descriptorCount = 1;
 
+				if ((t_DynamicUniformBindings & (1 << i)) && binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+				{
+					binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+				}
+
 				binding.stageFlags = 0;
 				for (const Shader* shader : t_Shaders)
 				{
@@ -320,14 +347,25 @@ namespace Fling
 		{
 			F_LOG_FATAL("Failed to create descriptor set layout!");
 		}
+
+		// So that sets of this layout only go in descriptor pools with room for them
+		if (DescriptorAllocator* Allocator = VulkanApp::Get().GetDescriptorAllocator())
+		{
+			Allocator->RegisterLayout(setLayout, setBindings);
+		}
 		return setLayout;
 	}
 
 	VkPipelineLayout Shader::CreatePipelineLayout(VkDevice t_Dev, VkDescriptorSetLayout t_SetLayout, VkShaderStageFlags t_PushConstantStages, size_t t_PushConstantSize)
+	{
+		return CreatePipelineLayout(t_Dev, std::vector<VkDescriptorSetLayout> { t_SetLayout }, t_PushConstantStages, t_PushConstantSize);
+	}
+
+	VkPipelineLayout Shader::CreatePipelineLayout(VkDevice t_Dev, const std::vector<VkDescriptorSetLayout>& t_SetLayouts, VkShaderStageFlags t_PushConstantStages, size_t t_PushConstantSize)
 	{
 		VkPipelineLayoutCreateInfo createInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-		createInfo.setLayoutCount = 1;
-		createInfo.pSetLayouts = &t_SetLayout;
+		createInfo.setLayoutCount = static_cast<uint32>(t_SetLayouts.size());
+		createInfo.pSetLayouts = t_SetLayouts.data();
 
 		VkPushConstantRange pushConstantRange = {};
 
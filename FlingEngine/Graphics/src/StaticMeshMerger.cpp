@@ -0,0 +1,204 @@
+#include "pch.h"
+#include "StaticMeshMerger.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace Fling
+{
+	namespace
+	{
+		/** Placement of a source without any triangles, which isn't in a merged mesh */
+		const uint32 NO_MESH = ~0u;
+
+		/** Sources per job. Most props are small, so each job gets a few of them */
+		const uint32 SOURCES_PER_JOB = 8;
+
+		FORCEINLINE glm::vec3 NormalizeOrKeep(const glm::vec3& t_Vec)
+		{
+			const float LenSq = glm::dot(t_Vec, t_Vec);
+			return LenSq > 1e-12f ? t_Vec * glm::inversesqrt(LenSq) : t_Vec;
+		}
+	}
+
+	StaticMeshMerger::StaticMeshMerger(float t_CellSize, uint32 t_MaxVertices)
+		: m_CellSize(t_CellSize > 0.0f ? t_CellSize : 32.0f)
+		, m_MaxVertices(std::max(t_MaxVertices, 3u))
+	{
+	}
+
+	void StaticMeshMerger::Add(const Source& t_Source)
+	{
+		assert(t_Source.IndexCount == 0 || (t_Source.Verts && t_Source.Indices));
+		m_Sources.emplace_back(t_Source);
+	}
+
+	void StaticMeshMerger::Clear()
+	{
+		m_Sources.clear();
+		m_SourceBounds.clear();
+		m_Placements.clear();
+		m_SortedSources.clear();
+		m_Meshes.clear();
+	}
+
+	glm::ivec3 StaticMeshMerger::GetCell(const glm::vec3& t_Pos) const
+	{
+		return glm::ivec3(glm::floor(t_Pos / m_CellSize));
+	}
+
+	void StaticMeshMerger::Build()
+	{
+		FLING_PROFILE_SCOPE("StaticMeshMerger::Build");
+
+		m_Meshes.clear();
+
+		const uint32 SourceCount = GetSourceCount();
+		m_SourceBounds.resize(SourceCount);
+		m_Placements.assign(SourceCount, Placement { NO_MESH, 0, 0 });
+
+		// The cell of a source is where the center of its world bounds is, which needs every vertex transformed
+		JobSystem::Get().ParallelFor(SourceCount, [this](uint32 t_Begin, uint32 t_End)
+		{
+			for (uint32 i = t_Begin; i < t_End; ++i)
+			{
+				const Source& Src = m_Sources[i];
+				AABB& Bounds = m_SourceBounds[i];
+				Bounds.Min = Bounds.Max = glm::vec3(Src.World[3]);
+
+				for (uint32 v = 0; v < Src.VertexCount; ++v)
+				{
+					const glm::vec3 Pos = glm::vec3(Src.World * glm::vec4(Src.Verts[v].Pos, 1.0f));
+					if (v == 0)
+					{
+						Bounds.Min = Bounds.Max = Pos;
+					}
+					Bounds.Min = glm::min(Bounds.Min, Pos);
+					Bounds.Max = glm::max(Bounds.Max, Pos);
+				}
+			}
+		}, SOURCES_PER_JOB);
+
+		std::vector<glm::ivec3> Cells(SourceCount);
+		for (uint32 i = 0; i < SourceCount; ++i)
+		{
+			Cells[i] = GetCell(m_SourceBounds[i].GetCenter());
+		}
+
+		// Sources that can be merged end up next to each other. Ties keep the order that they were added in
+		m_SortedSources.resize(SourceCount);
+		std::iota(m_SortedSources.begin(), m_SortedSources.end(), 0u);
+		std::sort(m_SortedSources.begin(), m_SortedSources.end(), [this, &Cells](uint32 t_A, uint32 t_B)
+		{
+			const Source& A = m_Sources[t_A];
+			const Source& B = m_Sources[t_B];
+			if (A.Material != B.Material) return A.Material < B.Material;
+			if (A.Group != B.Group) return A.Group < B.Group;
+			if (Cells[t_A].x != Cells[t_B].x) return Cells[t_A].x < Cells[t_B].x;
+			if (Cells[t_A].y != Cells[t_B].y) return Cells[t_A].y < Cells[t_B].y;
+			if (Cells[t_A].z != Cells[t_B].z) return Cells[t_A].z < Cells[t_B].z;
+			return t_A < t_B;
+		});
+
+		// Lay out every merged mesh before anything is written, so that each job writes a range that no other one does
+		uint32 PrevSource = NO_MESH;
+		for (uint32 SourceIndex : m_SortedSources)
+		{
+			const Source& Src = m_Sources[SourceIndex];
+			if (Src.VertexCount == 0 || Src.IndexCount == 0)
+			{
+				continue;
+			}
+
+			bool NewMesh = m_Meshes.empty();
+			if (!NewMesh)
+			{
+				const Source& Prev = m_Sources[PrevSource];
+				const MergedMesh& Cur = m_Meshes.back();
+				NewMesh =
+					Prev.Material != Src.Material ||
+					Prev.Group != Src.Group ||
+					Cells[PrevSource] != Cells[SourceIndex] ||
+					Cur.Verts.size() + Src.VertexCount > m_MaxVertices;
+			}
+
+			if (NewMesh)
+			{
+				MergedMesh& Created = m_Meshes.emplace_back();
+				Created.Material = Src.Material;
+				Created.Group = Src.Group;
+				Created.Bounds = m_SourceBounds[SourceIndex];
+			}
+
+			MergedMesh& Mesh = m_Meshes.back();
+			Placement& Place = m_Placements[SourceIndex];
+			Place.Mesh = static_cast<uint32>(m_Meshes.size() - 1);
+			Place.FirstVertex = static_cast<uint32>(Mesh.Verts.size());
+			Place.FirstIndex = static_cast<uint32>(Mesh.Indices.size());
+
+			Mesh.Sources.emplace_back(SourceIndex);
+			Mesh.SourceFirstIndex.emplace_back(Place.FirstIndex);
+			Mesh.Bounds.Min = glm::min(Mesh.Bounds.Min, m_SourceBounds[SourceIndex].Min);
+			Mesh.Bounds.Max = glm::max(Mesh.Bounds.Max, m_SourceBounds[SourceIndex].Max);
+
+			// Sized here so that the jobs can write straight into them
+			Mesh.Verts.resize(Mesh.Verts.size() + Src.VertexCount);
+			Mesh.Indices.resize(Mesh.Indices.size() + Src.IndexCount);
+
+			PrevSource = SourceIndex;
+		}
+
+		JobSystem::Get().ParallelFor(SourceCount, [this](uint32 t_Begin, uint32 t_End)
+		{
+			for (uint32 i = t_Begin; i < t_End; ++i)
+			{
+				WriteSource(i);
+			}
+		}, SOURCES_PER_JOB);
+	}
+
+	void StaticMeshMerger::WriteSource(uint32 t_Source)
+	{
+		const Placement& Place = m_Placements[t_Source];
+		if (Place.Mesh == NO_MESH)
+		{
+			return;
+		}
+
+		const Source& Src = m_Sources[t_Source];
+		MergedMesh& Mesh = m_Meshes[Place.Mesh];
+
+		// Normals go through the inverse transpose so that non uniform scales keep them perpendicular to the surface
+		const glm::mat3 Linear = glm::mat3(Src.World);
+		const float Determinant = glm::determinant(Linear);
+		const glm::mat3 NormalMat = Determinant != 0.0f ? glm::transpose(glm::inverse(Linear)) : Linear;
+
+		Vertex* OutVerts = Mesh.Verts.data() + Place.FirstVertex;
+		for (uint32 v = 0; v < Src.VertexCount; ++v)
+		{
+			const Vertex& In = Src.Verts[v];
+			Vertex& Out = OutVerts[v];
+			Out = In;
+			Out.Pos = glm::vec3(Src.World * glm::vec4(In.Pos, 1.0f));
+			Out.Normal = NormalizeOrKeep(NormalMat * In.Normal);
+			Out.Tangent = NormalizeOrKeep(Linear * In.Tangent);
+		}
+
+		uint32* OutIndices = Mesh.Indices.data() + Place.FirstIndex;
+		for (uint32 i = 0; i < Src.IndexCount; ++i)
+		{
+			assert(Src.Indices[i] < Src.VertexCount);
+			OutIndices[i] = Src.Indices[i] + Place.FirstVertex;
+		}
+
+		// A mirroring transform turns the triangles inside out, so flip them back to keep the front faces
+		if (Determinant < 0.0f)
+		{
+			for (uint32 i = 0; i + 2 < Src.IndexCount; i += 3)
+			{
+				std::swap(OutIndices[i + 1], OutIndices[i + 2]);
+			}
+		}
+	}
+}   // namespace Fling
@@ -3,14 +3,22 @@
 #include "PhyscialDevice.h"
 #include "SwapChain.h"
 #include "GraphicsPipeline.h"
+#include "CommandBuffer.h"
+#include "VulkanApp.h"
 
 namespace Fling
 {
-	Subpass::Subpass(const LogicalDevice* t_Dev, const Swapchain* t_Swap, std::shared_ptr<Fling::Shader> t_Vert, std::shared_ptr<Fling::Shader> t_Frag)
+	Subpass::Subpass(
+		const LogicalDevice* t_Dev,
+		const Swapchain* t_Swap,
+		std::shared_ptr<Fling::Shader> t_Vert,
+		std::shared_ptr<Fling::Shader> t_Frag,
+		uint32 t_DynamicUniformBindings)
 		: m_Device(t_Dev)
 		, m_SwapChain(t_Swap)
 		, m_VertexShader(t_Vert)
 		, m_FragShader(t_Frag)
+		, m_DynamicUniformBindings(t_DynamicUniformBindings)
 	{
 		assert(m_Device && m_VertexShader && m_FragShader);
 
@@ -36,7 +44,8 @@ namespace Fling
 			GraphicsPipeline::Depth::ReadWrite,
 			VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
 			VK_CULL_MODE_FRONT_BIT,
-			VK_FRONT_FACE_COUNTER_CLOCKWISE);
+			VK_FRONT_FACE_COUNTER_CLOCKWISE,
+			m_DynamicUniformBindings);
 	}
 
 	void Subpass::DestroyGraphicsPipeline()
@@ -47,6 +56,23 @@ namespace Fling
 		m_GraphicsPipeline = nullptr;
 	}
 
+	void Subpass::BeginGpuScope(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight, bool t_ExecutesSecondaries)
+	{
+		if (GpuProfiler* Profiler = VulkanApp::Get().GetGpuProfiler())
+		{
+			Profiler->ResetScope(t_CmdBuf.GetHandle(), t_ActiveFrameInFlight, m_GpuScope);
+			Profiler->BeginScope(t_CmdBuf.GetHandle(), t_ActiveFrameInFlight, m_GpuScope, t_ExecutesSecondaries);
+		}
+	}
+
+	void Subpass::EndGpuScope(CommandBuffer& t_CmdBuf, uint32 t_ActiveFrameInFlight)
+	{
+		if (GpuProfiler* Profiler = VulkanApp::Get().GetGpuProfiler())
+		{
+			Profiler->EndScope(t_CmdBuf.GetHandle(), t_ActiveFrameInFlight, m_GpuScope);
+		}
+	}
+
 	Subpass::~Subpass()
 	{
 		DestroyGraphicsPipeline();
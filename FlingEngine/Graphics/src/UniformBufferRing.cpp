@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "UniformBufferRing.h"
+#include "Buffer.h"
+#include "LogicalDevice.h"
+#include "PhyscialDevice.h"
+#include "Memory.h"
+
+namespace Fling
+{
+	UniformBufferRing::UniformBufferRing(const LogicalDevice* t_Dev, VkDeviceSize t_BytesPerFrame, uint32 t_FrameCount)
+		: m_FrameCount(t_FrameCount)
+	{
+		assert(t_Dev && t_Dev->GetPhysicalDevice());
+		assert(m_FrameCount > 0 && t_BytesPerFrame > 0);
+
+		const VkPhysicalDeviceLimits& Limits = t_Dev->GetPhysicalDevice()->GetDeviceProps().limits;
+		m_Alignment = std::max<VkDeviceSize>(Limits.minUniformBufferOffsetAlignment, 16);
+
+		// Keep every frame region aligned so that the dynamic offsets are always valid
+		m_BytesPerFrame = static_cast<VkDeviceSize>(AlignAddress(static_cast<uintptr_t>(t_BytesPerFrame), static_cast<size_t>(m_Alignment)));
+
+		// Dynamic offsets are only 32 bits
+		const VkDeviceSize TotalSize = m_BytesPerFrame * m_FrameCount;
+		if (TotalSize > std::numeric_limits<uint32>::max())
+		{
+			F_LOG_FATAL("Uniform buffer ring is too large! Dynamic offsets must fit in 32 bits");
+		}
+
+		m_Buffer = new Buffer(
+			TotalSize,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		// Persistently map the whole ring, we never unmap it until destruction
+		VK_CHECK_RESULT(m_Buffer->MapMemory());
+
+		BeginFrame(0);
+	}
+
+	UniformBufferRing::~UniformBufferRing()
+	{
+		delete m_Buffer;
+		m_Buffer = nullptr;
+	}
+
+	void UniformBufferRing::BeginFrame(uint32 t_FrameInFlight)
+	{
+		assert(t_FrameInFlight < m_FrameCount);
+
+		m_FrameStart = m_BytesPerFrame * t_FrameInFlight;
+		m_Head = m_FrameStart;
+		m_Overflowed = false;
+	}
+
+	void* UniformBufferRing::Allocate(VkDeviceSize t_Size, uint32& t_OutDynamicOffset)
+	{
+		assert(m_Buffer && m_Buffer->m_MappedMem);
+
+		const VkDeviceSize AlignedSize = (t_Size + m_Alignment - 1) & ~(m_Alignment - 1);
+
+		if (m_Head + AlignedSize > m_FrameStart + m_BytesPerFrame)
+		{
+			m_Overflowed = true;
+			return nullptr;
+		}
+
+		t_OutDynamicOffset = static_cast<uint32>(m_Head);
+		void* Mem = static_cast<char*>(m_Buffer->m_MappedMem) + m_Head;
+		m_Head += AlignedSize;
+
+		return Mem;
+	}
+
+	VkDescriptorBufferInfo UniformBufferRing::GetDescriptorInfo(VkDeviceSize t_Range) const
+	{
+		assert(m_Buffer);
+
+		VkDescriptorBufferInfo Info = {};
+		Info.buffer = m_Buffer->GetVkBuffer();
+		// The dynamic offset is added to this base offset when the set is bound
+		Info.offset = 0;
+		Info.range = t_Range;
+		return Info;
+	}
+}   // namespace Fling
@@ -0,0 +1,644 @@
+#include "pch.h"
+#include "UploadManager.h"
+#include "Buffer.h"
+#include "GraphicsHelpers.h"
+#include "LogicalDevice.h"
+#include "PhyscialDevice.h"
+#include "FlingConfig.h"
+
+namespace Fling
+{
+	namespace
+	{
+		VkCommandPool CreateUploadCommandPool(VkDevice t_Device, uint32 t_QueueFamily)
+		{
+			VkCommandPoolCreateInfo PoolInfo = {};
+			PoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			PoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			PoolInfo.queueFamilyIndex = t_QueueFamily;
+
+			VkCommandPool Pool = VK_NULL_HANDLE;
+			VK_CHECK_RESULT(vkCreateCommandPool(t_Device, &PoolInfo, nullptr, &Pool));
+			return Pool;
+		}
+
+		VkCommandBuffer AllocateUploadCommandBuffer(VkDevice t_Device, VkCommandPool t_Pool)
+		{
+			VkCommandBufferAllocateInfo AllocInfo = {};
+			AllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			AllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			AllocInfo.commandPool = t_Pool;
+			AllocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer Cmd = VK_NULL_HANDLE;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(t_Device, &AllocInfo, &Cmd));
+			return Cmd;
+		}
+
+		/** What a resource in the given layout will be accessed with after the upload */
+		VkAccessFlags GetFinalAccessMask(VkImageLayout t_Layout)
+		{
+			return t_Layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_MEMORY_READ_BIT;
+		}
+	}
+
+	UploadManager::UploadManager(const LogicalDevice* t_Dev, VkDeviceSize t_StagingSize)
+		: m_Device(t_Dev)
+	{
+		assert(m_Device && m_Device->GetPhysicalDevice());
+		assert(t_StagingSize > 0);
+
+		VkDevice Device = m_Device->GetVkDevice();
+
+		m_UseTransferQueue = m_Device->HasDedicatedTransferQueue() && FlingConfig::GetBool("Vulkan", "UseTransferQueue", true);
+
+		m_GraphicsPool = CreateUploadCommandPool(Device, m_Device->GetGraphicsFamily());
+		if (m_UseTransferQueue)
+		{
+			m_TransferPool = CreateUploadCommandPool(Device, m_Device->GetTransferFamily());
+		}
+
+		VkFenceCreateInfo FenceInfo = {};
+		FenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		m_Batches.resize(VkConfig::UPLOAD_BATCH_COUNT);
+		for (UploadBatch& Batch : m_Batches)
+		{
+			Batch.GraphicsCmd = AllocateUploadCommandBuffer(Device, m_GraphicsPool);
+			if (m_UseTransferQueue)
+			{
+				Batch.TransferCmd = AllocateUploadCommandBuffer(Device, m_TransferPool);
+				Batch.TransferComplete = GraphicsHelpers::CreateSemaphore(Device);
+			}
+			else
+			{
+				Batch.TransferCmd = Batch.GraphicsCmd;
+			}
+
+			VK_CHECK_RESULT(vkCreateFence(Device, &FenceInfo, nullptr, &Batch.Fence));
+		}
+
+		// Copies out of the staging ring are fastest at this alignment, and it keeps every texel format happy
+		const VkPhysicalDeviceLimits& Limits = m_Device->GetPhysicalDevice()->GetDeviceProps().limits;
+		m_StagingAlignment = std::max<VkDeviceSize>(Limits.optimalBufferCopyOffsetAlignment, 16);
+		m_StagingSize = (t_StagingSize + m_StagingAlignment - 1) & ~(m_StagingAlignment - 1);
+
+		m_StagingBuffer = new Buffer(
+			m_StagingSize,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		// The ring stays mapped until destruction
+		VK_CHECK_RESULT(m_StagingBuffer->MapMemory());
+
+		F_LOG_TRACE("Upload manager created with a {} MB staging ring ({})", m_StagingSize / (1024 * 1024), m_UseTransferQueue ? "transfer queue" : "graphics queue");
+	}
+
+	UploadManager::~UploadManager()
+	{
+		WaitIdle();
+
+		delete m_StagingBuffer;
+		m_StagingBuffer = nullptr;
+
+		VkDevice Device = m_Device->GetVkDevice();
+		for (UploadBatch& Batch : m_Batches)
+		{
+			vkDestroyFence(Device, Batch.Fence, nullptr);
+			if (Batch.TransferComplete != VK_NULL_HANDLE)
+			{
+				vkDestroySemaphore(Device, Batch.TransferComplete, nullptr);
+			}
+		}
+		m_Batches.clear();
+
+		// Destroying the pools frees their command buffers
+		vkDestroyCommandPool(Device, m_GraphicsPool, nullptr);
+		if (m_TransferPool != VK_NULL_HANDLE)
+		{
+			vkDestroyCommandPool(Device, m_TransferPool, nullptr);
+		}
+	}
+
+	UploadTicket UploadManager::UploadBuffer(const Buffer* t_Dst, const void* t_Data, VkDeviceSize t_Size, VkDeviceSize t_DstOffset)
+	{
+		if (!t_Dst || !t_Data || t_Size == 0)
+		{
+			F_LOG_WARN("Invalid buffer upload! Skipping it");
+			return 0;
+		}
+
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+
+		VkBuffer StagingBuffer = VK_NULL_HANDLE;
+		VkDeviceSize StagingOffset = 0;
+		void* Staging = AllocateStaging(t_Size, StagingBuffer, StagingOffset);
+		memcpy(Staging, t_Data, static_cast<size_t>(t_Size));
+
+		UploadBatch& Batch = BeginBatch();
+
+		VkBufferCopy Region = {};
+		Region.srcOffset = StagingOffset;
+		Region.dstOffset = t_DstOffset;
+		Region.size = t_Size;
+		vkCmdCopyBuffer(Batch.TransferCmd, StagingBuffer, t_Dst->GetVkBuffer(), 1, &Region);
+
+		if (m_UseTransferQueue)
+		{
+			// Hand the buffer over to the graphics queue
+			VkBufferMemoryBarrier Barrier = {};
+			Barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			Barrier.srcQueueFamilyIndex = m_Device->GetTransferFamily();
+			Barrier.dstQueueFamilyIndex = m_Device->GetGraphicsFamily();
+			Barrier.buffer = t_Dst->GetVkBuffer();
+			Barrier.offset = t_DstOffset;
+			Barrier.size = t_Size;
+
+			// Release
+			Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			Barrier.dstAccessMask = 0;
+			vkCmdPipelineBarrier(Batch.TransferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &Barrier, 0, nullptr);
+
+			// Acquire
+			Barrier.srcAccessMask = 0;
+			Barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			vkCmdPipelineBarrier(Batch.GraphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &Barrier, 0, nullptr);
+		}
+		// Without a transfer queue, one memory barrier at the end of the batch covers every buffer
+
+		Batch.StagingEnd = m_StagingHead;
+		return Batch.Ticket;
+	}
+
+	UploadTicket UploadManager::CopyBuffer(const Buffer* t_Src, const Buffer* t_Dst, const std::vector<VkBufferCopy>& t_Regions)
+	{
+		if (!t_Src || !t_Dst || t_Regions.empty())
+		{
+			F_LOG_WARN("Invalid buffer copy! Skipping it");
+			return 0;
+		}
+
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+
+		UploadBatch& Batch = BeginBatch();
+
+		// The graphics command buffer runs after the transfer one, so this sees every upload before it
+		VkMemoryBarrier Barrier = {};
+		Barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		Barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(Batch.GraphicsCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &Barrier, 0, nullptr, 0, nullptr);
+
+		vkCmdCopyBuffer(Batch.GraphicsCmd, t_Src->GetVkBuffer(), t_Dst->GetVkBuffer(), static_cast<uint32>(t_Regions.size()), t_Regions.data());
+
+		// The end of batch barrier is only there without a transfer queue
+		Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		Barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(Batch.GraphicsCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &Barrier, 0, nullptr, 0, nullptr);
+
+		return Batch.Ticket;
+	}
+
+	UploadTicket UploadManager::UploadImage(const ImageUpload& t_Desc, const void* t_Data, VkDeviceSize t_Size)
+	{
+		if (t_Desc.Image == VK_NULL_HANDLE || !t_Data || t_Size == 0 || t_Desc.MipLevels == 0 || t_Desc.ArrayLayers == 0)
+		{
+			F_LOG_WARN("Invalid image upload! Skipping it");
+			return 0;
+		}
+
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+
+		VkBuffer StagingBuffer = VK_NULL_HANDLE;
+		VkDeviceSize StagingOffset = 0;
+		void* Staging = AllocateStaging(t_Size, StagingBuffer, StagingOffset);
+		memcpy(Staging, t_Data, static_cast<size_t>(t_Size));
+
+		UploadBatch& Batch = BeginBatch();
+
+		// Build the copy regions relative to where the data is in staging memory
+		std::vector<VkBufferImageCopy> Regions = t_Desc.Regions;
+		if (Regions.empty())
+		{
+			const VkDeviceSize LayerSize = t_Size / t_Desc.ArrayLayers;
+			for (uint32 Layer = 0; Layer < t_Desc.ArrayLayers; ++Layer)
+			{
+				VkBufferImageCopy Region = {};
+				Region.bufferOffset = LayerSize * Layer;
+				Region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				Region.imageSubresource.mipLevel = 0;
+				Region.imageSubresource.baseArrayLayer = Layer;
+				Region.imageSubresource.layerCount = 1;
+				Region.imageExtent = { t_Desc.Width, t_Desc.Height, 1 };
+				Regions.emplace_back(Region);
+			}
+		}
+
+		for (VkBufferImageCopy& Region : Regions)
+		{
+			Region.bufferOffset += StagingOffset;
+		}
+
+		VkImageMemoryBarrier Barrier = {};
+		Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		Barrier.image = t_Desc.Image;
+		Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		Barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		Barrier.subresourceRange.baseMipLevel = 0;
+		Barrier.subresourceRange.levelCount = t_Desc.MipLevels;
+		Barrier.subresourceRange.baseArrayLayer = 0;
+		Barrier.subresourceRange.layerCount = t_Desc.ArrayLayers;
+
+		// Every mip gets written to, either by the copy or by the mip chain
+		Barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		Barrier.srcAccessMask = 0;
+		Barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(Batch.TransferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+		vkCmdCopyBufferToImage(
+			Batch.TransferCmd,
+			StagingBuffer,
+			t_Desc.Image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32>(Regions.size()),
+			Regions.data());
+
+		// Blits can only be done on the graphics queue, so the mip chain keeps the image in TRANSFER_DST until then
+		const VkImageLayout HandoffLayout = t_Desc.GenerateMips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : t_Desc.FinalLayout;
+
+		Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		Barrier.newLayout = HandoffLayout;
+
+		if (m_UseTransferQueue)
+		{
+			Barrier.srcQueueFamilyIndex = m_Device->GetTransferFamily();
+			Barrier.dstQueueFamilyIndex = m_Device->GetGraphicsFamily();
+
+			// Release
+			Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			Barrier.dstAccessMask = 0;
+			vkCmdPipelineBarrier(Batch.TransferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+			// Acquire, with the exact same layout transition
+			Barrier.srcAccessMask = 0;
+			Barrier.dstAccessMask = t_Desc.GenerateMips ? (VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT) : GetFinalAccessMask(t_Desc.FinalLayout);
+			vkCmdPipelineBarrier(
+				Batch.GraphicsCmd,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				t_Desc.GenerateMips ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &Barrier);
+		}
+		else if (!t_Desc.GenerateMips)
+		{
+			Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			Barrier.dstAccessMask = GetFinalAccessMask(t_Desc.FinalLayout);
+			vkCmdPipelineBarrier(Batch.GraphicsCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+		}
+
+		if (t_Desc.GenerateMips)
+		{
+			RecordMipChain(Batch.GraphicsCmd, t_Desc);
+		}
+
+		Batch.StagingEnd = m_StagingHead;
+		return Batch.Ticket;
+	}
+
+	void UploadManager::RecordMipChain(VkCommandBuffer t_Cmd, const ImageUpload& t_Desc)
+	{
+		const VkAccessFlags FinalAccess = GetFinalAccessMask(t_Desc.FinalLayout);
+
+		VkImageMemoryBarrier Barrier = {};
+		Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		Barrier.image = t_Desc.Image;
+		Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		Barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		Barrier.subresourceRange.baseArrayLayer = 0;
+		Barrier.subresourceRange.layerCount = t_Desc.ArrayLayers;
+
+		// Check that we have linear filtering support on this device
+		VkFormatProperties FormatProperties = m_Device->GetPhysicalDevice()->GetFormatProperties(t_Desc.Format);
+		if (!(FormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+		{
+			F_LOG_ERROR("Image format does not support linear blitting! Only mip 0 will be valid");
+
+			Barrier.subresourceRange.baseMipLevel = 0;
+			Barrier.subresourceRange.levelCount = t_Desc.MipLevels;
+			Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			Barrier.newLayout = t_Desc.FinalLayout;
+			Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			Barrier.dstAccessMask = FinalAccess;
+			vkCmdPipelineBarrier(t_Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+			return;
+		}
+
+		Barrier.subresourceRange.levelCount = 1;
+
+		int32 MipWidth = static_cast<int32>(t_Desc.Width);
+		int32 MipHeight = static_cast<int32>(t_Desc.Height);
+
+		for (uint32 i = 1; i < t_Desc.MipLevels; ++i)
+		{
+			Barrier.subresourceRange.baseMipLevel = i - 1;
+			Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			Barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(t_Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+			VkImageBlit Blit = {};
+			Blit.srcOffsets[0] = { 0, 0, 0 };
+			Blit.srcOffsets[1] = { MipWidth, MipHeight, 1 };
+			Blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			Blit.srcSubresource.mipLevel = i - 1;
+			Blit.srcSubresource.baseArrayLayer = 0;
+			Blit.srcSubresource.layerCount = t_Desc.ArrayLayers;
+			Blit.dstOffsets[0] = { 0, 0, 0 };
+			Blit.dstOffsets[1] = { MipWidth > 1 ? MipWidth / 2 : 1, MipHeight > 1 ? MipHeight / 2 : 1, 1 };
+			Blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			Blit.dstSubresource.mipLevel = i;
+			Blit.dstSubresource.baseArrayLayer = 0;
+			Blit.dstSubresource.layerCount = t_Desc.ArrayLayers;
+
+			vkCmdBlitImage(
+				t_Cmd,
+				t_Desc.Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				t_Desc.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &Blit,
+				VK_FILTER_LINEAR);
+
+			Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			Barrier.newLayout = t_Desc.FinalLayout;
+			Barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			Barrier.dstAccessMask = FinalAccess;
+			vkCmdPipelineBarrier(t_Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+			if (MipWidth > 1)
+			{
+				MipWidth /= 2;
+			}
+			if (MipHeight > 1)
+			{
+				MipHeight /= 2;
+			}
+		}
+
+		// The last mip was only ever written to
+		Barrier.subresourceRange.baseMipLevel = t_Desc.MipLevels - 1;
+		Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		Barrier.newLayout = t_Desc.FinalLayout;
+		Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		Barrier.dstAccessMask = FinalAccess;
+		vkCmdPipelineBarrier(t_Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+	}
+
+	UploadManager::UploadBatch& UploadManager::BeginBatch()
+	{
+		UploadBatch& Batch = m_Batches[m_CurrentBatch];
+		assert(!Batch.IsSubmitted);
+
+		if (!Batch.IsRecording)
+		{
+			VkCommandBufferBeginInfo BeginInfo = {};
+			BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			VK_CHECK_RESULT(vkBeginCommandBuffer(Batch.GraphicsCmd, &BeginInfo));
+			if (m_UseTransferQueue)
+			{
+				VK_CHECK_RESULT(vkBeginCommandBuffer(Batch.TransferCmd, &BeginInfo));
+			}
+
+			Batch.Ticket = m_NextTicket++;
+			Batch.StagingEnd = m_StagingHead;
+			Batch.IsRecording = true;
+		}
+
+		return Batch;
+	}
+
+	void* UploadManager::AllocateStaging(VkDeviceSize t_Size, VkBuffer& t_OutBuffer, VkDeviceSize& t_OutOffset)
+	{
+		const VkDeviceSize Size = (t_Size + m_StagingAlignment - 1) & ~(m_StagingAlignment - 1);
+
+		// Too big for the ring, give it a staging buffer that lives as long as the batch
+		if (Size > m_StagingSize)
+		{
+			F_LOG_WARN("Upload of {} bytes is larger than the staging ring, consider increasing [Vulkan] UploadRingSizeMB", t_Size);
+
+			std::unique_ptr<Buffer> Staging = std::make_unique<Buffer>(
+				t_Size,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			VK_CHECK_RESULT(Staging->MapMemory());
+
+			t_OutBuffer = Staging->GetVkBuffer();
+			t_OutOffset = 0;
+			void* Mapped = Staging->m_MappedMem;
+
+			m_Batches[m_CurrentBatch].LargeStagingBuffers.emplace_back(std::move(Staging));
+			return Mapped;
+		}
+
+		while (true)
+		{
+			// An empty ring can start over from the beginning
+			if (m_StagingHead == m_StagingTail)
+			{
+				m_StagingHead = ((m_StagingHead + m_StagingSize - 1) / m_StagingSize) * m_StagingSize;
+				m_StagingTail = m_StagingHead;
+			}
+
+			// Allocations never wrap around the end of the ring, skip to the start instead
+			uint64 Start = m_StagingHead;
+			const VkDeviceSize Offset = Start % m_StagingSize;
+			if (Offset + Size > m_StagingSize)
+			{
+				Start += m_StagingSize - Offset;
+			}
+
+			if (Start + Size - m_StagingTail <= m_StagingSize)
+			{
+				m_StagingHead = Start + Size;
+
+				t_OutBuffer = m_StagingBuffer->GetVkBuffer();
+				t_OutOffset = Start % m_StagingSize;
+				return static_cast<char*>(m_StagingBuffer->m_MappedMem) + t_OutOffset;
+			}
+
+			// The ring is full, wait for the oldest batch to give back its space. If that is the
+			// batch we are recording then it has to be submitted first
+			if (!WaitOldestLocked())
+			{
+				SubmitLocked();
+				if (!WaitOldestLocked())
+				{
+					F_LOG_FATAL("Upload staging ring is full but there are no batches to wait on!");
+				}
+			}
+		}
+	}
+
+	void UploadManager::Submit()
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		SubmitLocked();
+	}
+
+	void UploadManager::SubmitLocked()
+	{
+		UploadBatch& Batch = m_Batches[m_CurrentBatch];
+		if (!Batch.IsRecording)
+		{
+			return;
+		}
+
+		if (m_UseTransferQueue)
+		{
+			VK_CHECK_RESULT(vkEndCommandBuffer(Batch.TransferCmd));
+			VK_CHECK_RESULT(vkEndCommandBuffer(Batch.GraphicsCmd));
+
+			VkSubmitInfo TransferSubmit = {};
+			TransferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			TransferSubmit.commandBufferCount = 1;
+			TransferSubmit.pCommandBuffers = &Batch.TransferCmd;
+			TransferSubmit.signalSemaphoreCount = 1;
+			TransferSubmit.pSignalSemaphores = &Batch.TransferComplete;
+			VK_CHECK_RESULT(vkQueueSubmit(m_Device->GetTransferQueue(), 1, &TransferSubmit, VK_NULL_HANDLE));
+
+			// The graphics side acquires ownership once the copies are done
+			const VkPipelineStageFlags WaitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			VkSubmitInfo GraphicsSubmit = {};
+			GraphicsSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			GraphicsSubmit.waitSemaphoreCount = 1;
+			GraphicsSubmit.pWaitSemaphores = &Batch.TransferComplete;
+			GraphicsSubmit.pWaitDstStageMask = &WaitStage;
+			GraphicsSubmit.commandBufferCount = 1;
+			GraphicsSubmit.pCommandBuffers = &Batch.GraphicsCmd;
+			VK_CHECK_RESULT(vkQueueSubmit(m_Device->GetGraphicsQueue(), 1, &GraphicsSubmit, Batch.Fence));
+		}
+		else
+		{
+			// Make every buffer copy in this batch visible to anything after it on the queue
+			VkMemoryBarrier Barrier = {};
+			Barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			Barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			vkCmdPipelineBarrier(Batch.GraphicsCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &Barrier, 0, nullptr, 0, nullptr);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(Batch.GraphicsCmd));
+
+			VkSubmitInfo GraphicsSubmit = {};
+			GraphicsSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			GraphicsSubmit.commandBufferCount = 1;
+			GraphicsSubmit.pCommandBuffers = &Batch.GraphicsCmd;
+			VK_CHECK_RESULT(vkQueueSubmit(m_Device->GetGraphicsQueue(), 1, &GraphicsSubmit, Batch.Fence));
+		}
+
+		Batch.IsRecording = false;
+		Batch.IsSubmitted = true;
+		++m_SubmittedBatchCount;
+
+		// Batches are used round robin, so the next one is the oldest
+		m_CurrentBatch = (m_CurrentBatch + 1) % static_cast<uint32>(m_Batches.size());
+		UploadBatch& Next = m_Batches[m_CurrentBatch];
+		if (Next.IsSubmitted)
+		{
+			VK_CHECK_RESULT(vkWaitForFences(m_Device->GetVkDevice(), 1, &Next.Fence, VK_TRUE, std::numeric_limits<uint64>::max()));
+			RetireLocked(Next);
+		}
+	}
+
+	void UploadManager::Update()
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+
+		// Retire in submission order, starting with the oldest
+		const uint32 BatchCount = static_cast<uint32>(m_Batches.size());
+		for (uint32 i = 1; i <= BatchCount; ++i)
+		{
+			UploadBatch& Batch = m_Batches[(m_CurrentBatch + i) % BatchCount];
+			if (!Batch.IsSubmitted)
+			{
+				continue;
+			}
+
+			if (vkGetFenceStatus(m_Device->GetVkDevice(), Batch.Fence) != VK_SUCCESS)
+			{
+				break;
+			}
+
+			RetireLocked(Batch);
+		}
+	}
+
+	bool UploadManager::WaitOldestLocked()
+	{
+		const uint32 BatchCount = static_cast<uint32>(m_Batches.size());
+		for (uint32 i = 1; i <= BatchCount; ++i)
+		{
+			UploadBatch& Batch = m_Batches[(m_CurrentBatch + i) % BatchCount];
+			if (Batch.IsSubmitted)
+			{
+				VK_CHECK_RESULT(vkWaitForFences(m_Device->GetVkDevice(), 1, &Batch.Fence, VK_TRUE, std::numeric_limits<uint64>::max()));
+				RetireLocked(Batch);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void UploadManager::RetireLocked(UploadBatch& t_Batch)
+	{
+		assert(t_Batch.IsSubmitted);
+
+		VK_CHECK_RESULT(vkResetFences(m_Device->GetVkDevice(), 1, &t_Batch.Fence));
+
+		t_Batch.LargeStagingBuffers.clear();
+		t_Batch.IsSubmitted = false;
+
+		m_StagingTail = t_Batch.StagingEnd;
+		m_CompletedTicket = t_Batch.Ticket;
+	}
+
+	bool UploadManager::IsComplete(UploadTicket t_Ticket) const
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		return t_Ticket <= m_CompletedTicket;
+	}
+
+	void UploadManager::Wait(UploadTicket t_Ticket)
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+
+		if (t_Ticket <= m_CompletedTicket)
+		{
+			return;
+		}
+
+		const UploadBatch& Current = m_Batches[m_CurrentBatch];
+		if (Current.IsRecording && Current.Ticket <= t_Ticket)
+		{
+			SubmitLocked();
+		}
+
+		while (m_CompletedTicket < t_Ticket && WaitOldestLocked())
+		{
+		}
+	}
+
+	void UploadManager::WaitIdle()
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+
+		SubmitLocked();
+
+		while (WaitOldestLocked())
+		{
+		}
+	}
+}   // namespace Fling
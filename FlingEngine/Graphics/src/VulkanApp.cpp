@@ -17,6 +17,12 @@
 #include "GraphicsHelpers.h"
 #include "DepthBuffer.h"
 #include "BaseEditor.h"
+#include "DeviceMemoryAllocator.h"
+#include "UploadManager.h"
+#include "MeshArena.h"
+#include "BindlessTextures.h"
+#include "DescriptorAllocator.h"
+#include "GpuProfiler.h"
 
 namespace Fling
 {
@@ -26,8 +32,6 @@ namespace Fling
 
 		Prepare();
 
-		// #TODO Build VMA allocator
-
 		BuildRenderPipelines(t_Conf, t_Reg, t_Editor);
 
 		// Set the window icon for this application
@@ -58,11 +62,75 @@ namespace Fling
 		m_LogicalDevice = new LogicalDevice(m_Instance, m_PhysicalDevice, m_Surface);
 		assert(m_LogicalDevice);
 
+		// Every buffer and image after this point sub-allocates its memory from here
+		int32 MemoryBlockSizeMB = FlingConfig::GetInt("Vulkan", "MemoryBlockSizeMB", VkConfig::DEFAULT_MEMORY_BLOCK_SIZE_MB);
+		if (MemoryBlockSizeMB <= 0)
+		{
+			F_LOG_WARN("MemoryBlockSizeMB of {} is invalid! Using default of {}", MemoryBlockSizeMB, VkConfig::DEFAULT_MEMORY_BLOCK_SIZE_MB);
+			MemoryBlockSizeMB = VkConfig::DEFAULT_MEMORY_BLOCK_SIZE_MB;
+		}
+		m_MemoryAllocator = new DeviceMemoryAllocator(m_LogicalDevice, static_cast<VkDeviceSize>(MemoryBlockSizeMB) * 1024 * 1024);
+
 		m_SwapChain = new Swapchain(ChooseSwapExtent(), m_LogicalDevice, m_PhysicalDevice, m_Surface);
 		assert(m_SwapChain);
 
 		GraphicsHelpers::CreateCommandPool(&m_CommandPool, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
+		int32 UploadRingSizeMB = FlingConfig::GetInt("Vulkan", "UploadRingSizeMB", VkConfig::DEFAULT_UPLOAD_RING_SIZE_MB);
+		if (UploadRingSizeMB <= 0)
+		{
+			F_LOG_WARN("UploadRingSizeMB of {} is invalid! Using default of {}", UploadRingSizeMB, VkConfig::DEFAULT_UPLOAD_RING_SIZE_MB);
+			UploadRingSizeMB = VkConfig::DEFAULT_UPLOAD_RING_SIZE_MB;
+		}
+		m_UploadManager = new UploadManager(m_LogicalDevice, static_cast<VkDeviceSize>(UploadRingSizeMB) * 1024 * 1024);
+
+		// Determine how many frames the CPU is allowed to get ahead of the GPU
+		int32 FramesInFlight = FlingConfig::GetInt("Vulkan", "FramesInFlight", VkConfig::DEFAULT_FRAMES_IN_FLIGHT);
+		if (FramesInFlight < 1 || FramesInFlight > VkConfig::MAX_FRAMES_IN_FLIGHT)
+		{
+			F_LOG_WARN("FramesInFlight of {} is invalid (must be 1 - {})! Using default of {}", FramesInFlight, VkConfig::MAX_FRAMES_IN_FLIGHT, VkConfig::DEFAULT_FRAMES_IN_FLIGHT);
+			FramesInFlight = VkConfig::DEFAULT_FRAMES_IN_FLIGHT;
+		}
+		m_FramesInFlight = static_cast<uint32>(FramesInFlight);
+		F_LOG_TRACE("Frames in flight: {}", m_FramesInFlight);
+
+		int32 MeshArenaVertexMB = FlingConfig::GetInt("Vulkan", "MeshArenaVertexMB", VkConfig::DEFAULT_MESH_ARENA_VERTEX_MB);
+		int32 MeshArenaIndexMB = FlingConfig::GetInt("Vulkan", "MeshArenaIndexMB", VkConfig::DEFAULT_MESH_ARENA_INDEX_MB);
+		if (MeshArenaVertexMB <= 0 || MeshArenaIndexMB <= 0)
+		{
+			F_LOG_WARN("Mesh arena size of {} MB vertices and {} MB indices is invalid! Using default of {} and {}", MeshArenaVertexMB, MeshArenaIndexMB, VkConfig::DEFAULT_MESH_ARENA_VERTEX_MB, VkConfig::DEFAULT_MESH_ARENA_INDEX_MB);
+			MeshArenaVertexMB = VkConfig::DEFAULT_MESH_ARENA_VERTEX_MB;
+			MeshArenaIndexMB = VkConfig::DEFAULT_MESH_ARENA_INDEX_MB;
+		}
+		m_MeshArena = new MeshArena(
+			m_LogicalDevice,
+			m_UploadManager,
+			m_FramesInFlight,
+			static_cast<VkDeviceSize>(MeshArenaVertexMB) * 1024 * 1024,
+			static_cast<VkDeviceSize>(MeshArenaIndexMB) * 1024 * 1024);
+
+		int32 DescriptorSetsPerPool = FlingConfig::GetInt("Vulkan", "DescriptorSetsPerPool", VkConfig::DEFAULT_DESCRIPTOR_SETS_PER_POOL);
+		if (DescriptorSetsPerPool <= 0)
+		{
+			F_LOG_WARN("DescriptorSetsPerPool of {} is invalid! Using default of {}", DescriptorSetsPerPool, VkConfig::DEFAULT_DESCRIPTOR_SETS_PER_POOL);
+			DescriptorSetsPerPool = VkConfig::DEFAULT_DESCRIPTOR_SETS_PER_POOL;
+		}
+		m_DescriptorAllocator = new DescriptorAllocator(m_LogicalDevice, m_FramesInFlight, static_cast<uint32>(DescriptorSetsPerPool));
+
+		// Textures register themselves in here when they are created, so it has to exist before any are loaded
+		if (m_LogicalDevice->IsDescriptorIndexingEnabled())
+		{
+			int32 BindlessCapacity = FlingConfig::GetInt("Vulkan", "BindlessTextureCapacity", VkConfig::DEFAULT_BINDLESS_TEXTURE_CAPACITY);
+			if (BindlessCapacity <= 0)
+			{
+				F_LOG_WARN("BindlessTextureCapacity of {} is invalid! Using default of {}", BindlessCapacity, VkConfig::DEFAULT_BINDLESS_TEXTURE_CAPACITY);
+				BindlessCapacity = VkConfig::DEFAULT_BINDLESS_TEXTURE_CAPACITY;
+			}
+			m_BindlessTextures = new BindlessTextures(m_LogicalDevice, static_cast<uint32>(BindlessCapacity));
+		}
+
+		m_GpuProfiler = new GpuProfiler(m_LogicalDevice, m_FramesInFlight);
+
 		CreateFrameSyncResources();
 
 		// Create the camera
@@ -83,12 +151,15 @@ namespace Fling
 		// This is a sanity check for when we are recreating the swap chain
 		assert(m_DrawCmdBuffers.size() == 0);
 
-		// Build command buffers (one for each swap chain image)
-		for (size_t i = 0; i < m_SwapChain->GetImageViewCount(); ++i)
+		// Build command buffers (one for each frame in flight)
+		for (uint32 i = 0; i < m_FramesInFlight; ++i)
 		{
-			m_DrawCmdBuffers.emplace_back(new CommandBuffer(m_LogicalDevice, m_CommandPool));
+			m_DrawCmdBuffers.emplace_back(new CommandBuffer(m_LogicalDevice, m_FrameCommandPools[i]));
 		}
 
+		// No frame is using any of the swap chain images yet
+		m_ImagesInFlight.assign(m_SwapChain->GetImageCount(), VK_NULL_HANDLE);
+
 		// Build the depth stencil
 		// The depth buffer can be not-null when we are recreating the swap chain
 		if(m_DepthBuffer == nullptr)
@@ -144,13 +215,16 @@ namespace Fling
 		subpass.pColorAttachments = &colorAttachmentRef;
 		subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+		// The depth buffer is shared between every frame in flight, so the depth tests have to 
+		// wait for the previous frame to finish with it as well as the color output
 		VkSubpassDependency dependency = {};
 		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependency.dstSubpass = 0;
-		dependency.srcStageMask = m_WaitStages;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = m_WaitStages;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.srcStageMask = m_WaitStages | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependency.dstStageMask = m_WaitStages | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | 
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
 		std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
 		VkRenderPassCreateInfo renderPassInfo = {};
@@ -200,15 +274,16 @@ namespace Fling
 	{
 		assert(m_LogicalDevice);
 
-		m_PresentCompleteSemaphores.resize(VkConfig::MAX_FRAMES_IN_FLIGHT);
-		m_RenderFinishedSemaphores.resize(VkConfig::MAX_FRAMES_IN_FLIGHT);
-		m_InFlightFences.resize(VkConfig::MAX_FRAMES_IN_FLIGHT);
+		m_PresentCompleteSemaphores.resize(m_FramesInFlight);
+		m_RenderFinishedSemaphores.resize(m_FramesInFlight);
+		m_InFlightFences.resize(m_FramesInFlight);
+		m_FrameCommandPools.resize(m_FramesInFlight);
 
 		VkFenceCreateInfo fenceInfo = {};
 		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-		for (int32 i = 0; i < VkConfig::MAX_FRAMES_IN_FLIGHT; i++)
+		for (uint32 i = 0; i < m_FramesInFlight; i++)
 		{
 			m_PresentCompleteSemaphores[i] = GraphicsHelpers::CreateSemaphore(m_LogicalDevice->GetVkDevice());
 			m_RenderFinishedSemaphores[i] = GraphicsHelpers::CreateSemaphore(m_LogicalDevice->GetVkDevice());
@@ -216,6 +291,9 @@ namespace Fling
 			{
 				F_LOG_FATAL("Failed to create fence!");
 			}
+
+			// Buffers from these are only ever reset with the whole pool
+			GraphicsHelpers::CreateCommandPool(&m_FrameCommandPools[i], VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
 		}
 	}
 
@@ -309,9 +387,13 @@ namespace Fling
 
 			// Offscreen pipeline ------
 			// These shaders have vertex input and fill in the buffers that the final pass uses
-			std::shared_ptr<Fling::Shader> OffscreenVert = Shader::Create(HS("Shaders/Deferred/mrt_vert.spv"), m_LogicalDevice);
-			std::shared_ptr<Fling::Shader> OffscreenFrag = Shader::Create(HS("Shaders/Deferred/mrt_frag.spv"), m_LogicalDevice);
-			Subpasses.emplace_back(std::make_unique<OffscreenSubpass>(m_LogicalDevice, m_SwapChain, t_Reg, m_Camera, OffscreenVert, OffscreenFrag));
+			// The bindless variants read every material's textures out of the global texture array
+			std::shared_ptr<Fling::Shader> OffscreenVert = Shader::Create(m_BindlessTextures ? HS("Shaders/Deferred/mrt_bindless_vert.spv") : HS("Shaders/Deferred/mrt_vert.spv"), m_LogicalDevice);
+			std::shared_ptr<Fling::Shader> OffscreenFrag = Shader::Create(m_BindlessTextures ? HS("Shaders/Deferred/mrt_bindless_frag.spv") : HS("Shaders/Deferred/mrt_frag.spv"), m_LogicalDevice);
+			// Compute shaders that cull the meshes and build the depth pyramid when [Vulkan] GpuCulling is on
+			std::shared_ptr<Fling::Shader> CullComp = Shader::Create(HS("Shaders/Deferred/cull_comp.spv"), m_LogicalDevice);
+			std::shared_ptr<Fling::Shader> DepthReduceComp = Shader::Create(HS("Shaders/Deferred/depth_reduce_comp.spv"), m_LogicalDevice);
+			Subpasses.emplace_back(std::make_unique<OffscreenSubpass>(m_LogicalDevice, m_SwapChain, t_Reg, m_Camera, OffscreenVert, OffscreenFrag, CullComp, DepthReduceComp));
 
 			// Create geometry pass ------
 			// These shaders do not have any vertex input and do the final processing to the screen
@@ -375,19 +457,36 @@ namespace Fling
 
 	void VulkanApp::Update(float DeltaTime, entt::registry& t_Reg)
 	{
+		FLING_PROFILE_SCOPE("VulkanApp::Update");
+
 		// Prepare the frame for submission by waiting for the swap chain
 		m_CurrentWindow->Update();
 		m_Camera->Update(DeltaTime);
 
+		// Give back the staging memory of any uploads that the GPU is done with
+		m_UploadManager->Update();
+
+		// Wait for the GPU to finish the last frame that used this frame's resources (N frames ago)
+		// so that we can safely re-record its command buffers and write to its UBO's
+		vkWaitForFences(m_LogicalDevice->GetVkDevice(), 1, &m_InFlightFences[CurrentFrameIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+		// Arena buffers that were replaced before the last use of this frame can't be in use anymore
+		m_MeshArena->Update();
+
+		// So are the transient descriptor sets of this frame
+		m_DescriptorAllocator->BeginFrame(static_cast<uint32>(CurrentFrameIndex));
+
+		// The queries of this frame are done now too, so they can be read without waiting
+		m_GpuProfiler->BeginFrame(static_cast<uint32>(CurrentFrameIndex));
+
 		// Aquire the active image index
 		VkResult iResult = m_SwapChain->AquireNextImage(m_PresentCompleteSemaphores[CurrentFrameIndex]);
 		uint32  ImageIndex = m_SwapChain->GetActiveImageIndex();
 
-		vkResetFences(m_LogicalDevice->GetVkDevice(), 1, &m_InFlightFences[CurrentFrameIndex]);
-
 		if (iResult == VK_ERROR_OUT_OF_DATE_KHR)
 		{
 			F_LOG_WARN("Swap chain out of date! ");
+			RecreateFrameResourcesForResize(t_Reg);
 			return;
 		}
 		else if (iResult != VK_SUCCESS && iResult != VK_SUBOPTIMAL_KHR)
@@ -395,6 +494,21 @@ namespace Fling
 			F_LOG_FATAL("Failed to acquire swap chain image!");
 		}
 
+		// The swap chain can give us back an image that an older frame is still rendering to
+		// if there are more swap images than frames in flight
+		if (m_ImagesInFlight[ImageIndex] != VK_NULL_HANDLE && m_ImagesInFlight[ImageIndex] != m_InFlightFences[CurrentFrameIndex])
+		{
+			vkWaitForFences(m_LogicalDevice->GetVkDevice(), 1, &m_ImagesInFlight[ImageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+		}
+		m_ImagesInFlight[ImageIndex] = m_InFlightFences[CurrentFrameIndex];
+
+		// Only reset the fence once we know that we will be submitting work with it
+		vkResetFences(m_LogicalDevice->GetVkDevice(), 1, &m_InFlightFences[CurrentFrameIndex]);
+
+		const uint32 FrameIndex = static_cast<uint32>(CurrentFrameIndex);
+
+		Stats::Draws::NewFrame();
+
 		// Fill this with the render pipelines
 		std::vector<VkSemaphore> SemaphoresToWaitOn = {};
 		std::vector<CommandBuffer*> DependentCmdBufs = {};
@@ -402,18 +516,24 @@ namespace Fling
 		// Vector of command buffers to be sent out with the final swap chain presentation
 		// the swap chain draw buffer is always first
 		std::vector<CommandBuffer*> FinalSubmissionBufs = {};
-		FinalSubmissionBufs.emplace_back(m_DrawCmdBuffers[ImageIndex]);
-
-		//vkResetCommandPool(m_LogicalDevice->GetVkDevice(), m_CommandPool, 0);
+		FinalSubmissionBufs.emplace_back(m_DrawCmdBuffers[FrameIndex]);
 
 		{
-			// Get the current drawing command buffer associated with the current swap chain image
-			CommandBuffer* CmdBuf = m_DrawCmdBuffers[ImageIndex];
+			// Get the drawing command buffer of this frame in flight, and the frame buffer of the swap chain image
+			CommandBuffer* CmdBuf = m_DrawCmdBuffers[FrameIndex];
 			VkFramebuffer FrameBuf = m_SwapChainFrameBuffers[ImageIndex];
 			assert(CmdBuf && FrameBuf != VK_NULL_HANDLE);
 
+			// The fence has been waited on, so nothing recorded for this frame is still in use
+			vkResetCommandPool(m_LogicalDevice->GetVkDevice(), m_FrameCommandPools[FrameIndex], 0);
+
 			CmdBuf->Begin();
 
+			for (RenderPipeline* Pipeline : m_RenderPipelines)
+			{
+				Pipeline->PrepareDraw(*CmdBuf, FrameIndex);
+			}
+
 			// Start a render pass using the global render pass settings
 			VkRenderPassBeginInfo renderPassBeginInfo = Initializers::RenderPassBeginInfo();
 			renderPassBeginInfo.renderPass = m_RenderPass;
@@ -439,7 +559,7 @@ namespace Fling
 			// Build the command buffers of the render pipelines
 			for (RenderPipeline* Pipeline : m_RenderPipelines)
 			{		
-				Pipeline->Draw(*CmdBuf, FrameBuf, ImageIndex, t_Reg, DeltaTime);
+				Pipeline->Draw(*CmdBuf, FrameBuf, FrameIndex, t_Reg, DeltaTime);
 			}
 
 			CmdBuf->EndRenderPass();
@@ -448,12 +568,15 @@ namespace Fling
 			CmdBuf->End();
 		}
 
+		// Anything uploaded so far (including during Draw) is submitted ahead of this frame's work
+		m_UploadManager->Submit();
+
 		// Gather deps for the current frame only
 		for (RenderPipeline* Pipeline : m_RenderPipelines)
 		{
 			// Gather the dependencies 
-			Pipeline->GatherPresentDependencies(DependentCmdBufs, SemaphoresToWaitOn, ImageIndex, CurrentFrameIndex);
-			Pipeline->GatherPresentBuffers(FinalSubmissionBufs, ImageIndex);
+			Pipeline->GatherPresentDependencies(DependentCmdBufs, SemaphoresToWaitOn, FrameIndex);
+			Pipeline->GatherPresentBuffers(FinalSubmissionBufs, FrameIndex);
 		}
 
 		// Wait for the color attachment to be done 
@@ -518,10 +641,9 @@ namespace Fling
 		FinalScreenSubmitInfo.signalSemaphoreCount = 1;
 		FinalScreenSubmitInfo.pSignalSemaphores = &m_RenderFinishedSemaphores[CurrentFrameIndex];
 
+		// The in flight fence is signaled once the GPU is done with this frame, which we wait on
+		// the next time that this frame index comes around
 		VK_CHECK_RESULT(vkQueueSubmit(m_LogicalDevice->GetGraphicsQueue(), 1, &FinalScreenSubmitInfo, m_InFlightFences[CurrentFrameIndex]));
-		
-		// Finish up the frame by setting the in flight fences to wait -----
-		vkWaitForFences(m_LogicalDevice->GetVkDevice(), 1, &m_InFlightFences[CurrentFrameIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
 	
 		// Present the swap chain with the renderer finished semaphore
 		iResult = m_SwapChain->QueuePresent(m_LogicalDevice->GetPresentQueue(), m_RenderFinishedSemaphores[CurrentFrameIndex]);
@@ -539,7 +661,7 @@ namespace Fling
 		}
 
 		// Update the current in flight frame index!
-		CurrentFrameIndex = (CurrentFrameIndex + 1) % VkConfig::MAX_FRAMES_IN_FLIGHT;
+		CurrentFrameIndex = (CurrentFrameIndex + 1) % m_FramesInFlight;
 	}
 	
 	VkExtent2D VulkanApp::ChooseSwapExtent()
@@ -569,6 +691,19 @@ namespace Fling
 		}
 	}
 
+	void VulkanApp::WaitForIdle()
+	{
+		if (m_UploadManager)
+		{
+			m_UploadManager->WaitIdle();
+		}
+
+		if (m_LogicalDevice)
+		{
+			m_LogicalDevice->WaitForIdle();
+		}
+	}
+
 	void VulkanApp::Shutdown(entt::registry& t_Reg)
 	{
 		Singleton<VulkanApp>::Shutdown();
@@ -607,10 +742,35 @@ namespace Fling
 		delete m_DepthBuffer;
 		m_DepthBuffer = nullptr;
 
-		// #TODO Cleanup VMA allocator -------------
+		// Every model has been unloaded by now. The copies out of its old buffers go through the upload manager
+		delete m_MeshArena;
+		m_MeshArena = nullptr;
+
+		// So are the textures, which unregistered themselves
+		delete m_BindlessTextures;
+		m_BindlessTextures = nullptr;
+
+		// Every subpass has given its sets back by now
+		delete m_DescriptorAllocator;
+		m_DescriptorAllocator = nullptr;
+
+		// Upload manager owns the staging ring, so it has to go before the allocator
+		delete m_UploadManager;
+		m_UploadManager = nullptr;
+
+		delete m_GpuProfiler;
+		m_GpuProfiler = nullptr;
+
+		// Cleanup memory allocator, every resource should have been released by now -------------
+		if (m_MemoryAllocator)
+		{
+			m_MemoryAllocator->LogStats();
+		}
+		delete m_MemoryAllocator;
+		m_MemoryAllocator = nullptr;
 
 		// Clean up Frame sync resources (created in CreateFrameSyncResources) --------------
-		for (size_t i = 0; i < VkConfig::MAX_FRAMES_IN_FLIGHT; i++)
+		for (size_t i = 0; i < m_InFlightFences.size(); i++)
 		{
 			vkDestroySemaphore(m_LogicalDevice->GetVkDevice(), m_RenderFinishedSemaphores[i], nullptr);
 			vkDestroySemaphore(m_LogicalDevice->GetVkDevice(), m_PresentCompleteSemaphores[i], nullptr);
@@ -625,6 +785,12 @@ namespace Fling
 		}
 		m_DrawCmdBuffers.clear();
 
+		for (VkCommandPool Pool : m_FrameCommandPools)
+		{
+			vkDestroyCommandPool(m_LogicalDevice->GetVkDevice(), Pool, nullptr);
+		}
+		m_FrameCommandPools.clear();
+
 		vkDestroyCommandPool(m_LogicalDevice->GetVkDevice(), m_CommandPool, nullptr);
 
 		// Clean up devices and surface (created in Prepare) --------------
@@ -15,6 +15,9 @@ namespace Fling
         
         /** Returns directory where engine assets are kept */
         static const std::string& EngineAssetsDir();
+
+        /** Returns directory where assets that the build makes out of the engine assets are kept, like compiled shaders */
+        static const std::string& CompiledAssetsDir();
         
         /** Returns directory where your current binary is */
         static const std::string& BinaryDir();
@@ -2,6 +2,7 @@
 
 #include "Resource.h"
 #include "stb_image.h"
+#include "DeviceMemoryAllocator.h"
 
 namespace Fling
 {
@@ -52,9 +53,6 @@ namespace Fling
 
         void CreateTextureSampler();
 
-        void CopyBufferToImage(VkBuffer t_Buffer);
-
-        void GenerateMipMaps(VkFormat t_ImageFormat);
 		const LogicalDevice* m_Device;
         VkImage m_Image;
 
@@ -62,7 +60,7 @@ namespace Fling
 
         VkSampler m_TextureSampler;
 
-        VkDeviceMemory m_Memory;
+        DeviceAllocation m_Memory;
 
         VkDescriptorImageInfo m_ImageInfo = {};
 
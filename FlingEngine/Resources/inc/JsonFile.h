@@ -26,6 +26,9 @@ namespace Fling
          */
         explicit JsonFile(Guid t_ID);
 
+        /** Construct from JSON that has already been read */
+        JsonFile(Guid t_ID, nlohmann::json&& t_Data);
+
 		virtual ~JsonFile() = default;
         
         /**
@@ -48,5 +51,8 @@ namespace Fling
          * @note All Guid paths are relative to the assets directory. 
          */
         void LoadJsonFile();
+
+        /** Read a JSON file into t_OutData. Safe to call from any thread. @return True on success */
+        static bool ReadJsonFile(const std::string& t_FilePath, nlohmann::json& t_OutData);
     };
 }   // namespace Fling
\ No newline at end of file
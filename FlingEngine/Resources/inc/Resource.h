@@ -5,6 +5,13 @@
 
 namespace Fling
 {
+	/** What a resource type does with its CPU side copy of the file data once it has been uploaded */
+	enum class CpuDataPolicy : uint8
+	{
+		Keep,		// Keep it around for anything that wants to read it later
+		Release,	// Free it as soon as the upload has copied it
+	};
+
 	/**
 	* Base class that represents a loaded resource in the engine
 	*/
@@ -41,10 +48,24 @@ namespace Fling
          */
         std::string GetFilepathReleativeToAssets() const;
 
+        /** The full file path of a Guid, for use before a resource is constructed */
+        static std::string GetFilepathReleativeToAssets(Guid t_ID);
+
+        /** Bytes of system memory held by this resource. Counted against the ResourceManager's budget */
+        virtual uint64 GetCpuMemoryUsage() const { return 0; }
+
+        /** Bytes of device memory held by this resource. Counted against the ResourceManager's budget */
+        virtual uint64 GetGpuMemoryUsage() const { return 0; }
+
     protected:
 
         Fling::Guid m_Guid;
 
 		std::string m_HumanReadableName;
+
+	private:
+
+		/** Index of this resource's slot in the ResourceManager. @see Handle */
+		uint32 m_SlotIndex = ~0u;
 	};
 }	// namespace Fling
\ No newline at end of file
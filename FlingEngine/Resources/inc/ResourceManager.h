@@ -3,19 +3,139 @@
 #include "Singleton.hpp"
 #include "Resource.h"
 #include "FlingTypes.h" // Guid
+#include "ConcurrentHashMap.hpp"
+#include "Profiler.h"
 
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
-#include <map>
+
+#include <entt/signal/sigh.hpp>
 
 namespace Fling
 {
+	/**
+	 * @brief 	A resource type can be decoded off of the main thread if it declares:
+	 *
+	 *			struct LoadData;										// CPU side file data
+	 *			static std::unique_ptr<LoadData> Decode(Guid t_ID);		// Any thread, no Vulkan calls
+	 *			T(Guid t_ID, std::unique_ptr<LoadData> t_Data);			// Main thread, creates GPU resources
+	 *
+	 *			Any other resource type is constructed on the main thread when it is loaded async.
+	 * @see ResourceManager::LoadResourceAsync
+	 */
+	template<class T, class = void>
+	struct IsAsyncLoadable : std::false_type {};
+
+	template<class T>
+	struct IsAsyncLoadable<T, std::void_t<typename T::LoadData>> : std::true_type {};
+
+	/**
+	 * @brief 	Handle to a resource that may still be loading
+	 * @see ResourceManager::LoadResourceAsync
+	 */
+	template<class T>
+	class AsyncResource
+	{
+	public:
+
+		AsyncResource() = default;
+
+		explicit AsyncResource(Guid_Handle t_ID) : m_ID(t_ID) {}
+
+		/** True once the resource has been finalized on the main thread */
+		bool IsReady() const;
+
+		/** The resource, or nullptr if it is still loading */
+		std::shared_ptr<T> Get() const;
+
+		Guid_Handle GetGuidHandle() const { return m_ID; }
+
+	private:
+
+		Guid_Handle m_ID = 0;
+	};
+
+	/** Slot index of an empty Handle */
+	static const uint32 INVALID_RESOURCE_SLOT = ~0u;
+
+	/**
+	 * @brief 	A reference counted handle to a loaded resource. A resource will not be unloaded while
+	 *			there is a handle to it. Once the last handle is gone it goes on the ResourceManager's
+	 *			LRU list, and is unloaded if unreferenced resources go over the memory budget.
+	 *
+	 *			Handles are generational, so a handle to a resource that has been unloaded resolves to
+	 *			nullptr even if its slot has been reused. Main thread only.
+	 * @see ResourceManager::LoadHandle
+	 */
+	template<class T>
+	class Handle
+	{
+		friend class ResourceManager;
+
+	public:
+
+		Handle() = default;
+
+		Handle(const Handle& t_Other);
+
+		Handle(Handle&& t_Other) noexcept;
+
+		Handle& operator=(const Handle& t_Other);
+
+		Handle& operator=(Handle&& t_Other) noexcept;
+
+		~Handle();
+
+		/** The resource, or nullptr if the handle is empty or the resource has been unloaded */
+		T* Get() const;
+
+		T* operator->() const { return Get(); }
+
+		T& operator*() const { return *Get(); }
+
+		explicit operator bool() const { return Get() != nullptr; }
+
+		bool operator==(const Handle& t_Other) const { return m_Index == t_Other.m_Index && m_Generation == t_Other.m_Generation; }
+
+		bool operator!=(const Handle& t_Other) const { return !(*this == t_Other); }
+
+		/** Drop this handle's reference and make it empty */
+		void Reset();
+
+		uint32 GetIndex() const { return m_Index; }
+
+		uint32 GetGeneration() const { return m_Generation; }
+
+	private:
+
+		/** The ResourceManager has already added the reference for this handle */
+		Handle(uint32 t_Index, uint32 t_Generation) : m_Index(t_Index), m_Generation(t_Generation) {}
+
+		uint32 m_Index = INVALID_RESOURCE_SLOT;
+
+		uint32 m_Generation = 0;
+	};
+
 	/**
 	 * @brief The resource manager handles loading of files off disk. Every Resource type
 	 * has a Guid. This Guid functions as both the file path (relative to the ASSETS directory)
-	 * as well as a hashed string for easy passing around of information. Each resource is only 
+	 * as well as a hashed string for easy passing around of information. Each resource is only
 	 * ever loaded into memory ONCE.
-	 * 
+	 *
+	 * Resources can be loaded async, in which case file data is decoded on loader threads and
+	 * the resource is finished on the main thread in Update. Any request for a resource that is
+	 * already loading joins the load that is in flight.
+	 *
+	 * Resources with no Handles and no outside shared_ptr's are kept on an LRU list, and the least
+	 * recently used ones are unloaded in Update when the memory budget is exceeded.
+	 *
 	 * @see Fling::Guid
 	 * @see Fling::Guid_Handle
 	 * @see Fling::Resource
@@ -24,22 +144,77 @@ namespace Fling
 	{
 	public:
 
+		/** Joins any loader threads that are still running if Shutdown was never called */
+		~ResourceManager();
+
 		virtual void Init() override;
 
 		virtual void Shutdown() override;
 
+		/**
+		 * @brief	Load a resource and block until it is ready. If the resource is being loaded async
+		 *			then this finishes that load instead of starting another. Main thread only.
+		 */
 		template<class T, class ...ARGS>
 		static std::shared_ptr<T> LoadResource(Guid t_ID, ARGS&& ... args)
 		{
 			return ResourceManager::Get().LoadResourceImpl<T>(t_ID, std::forward<ARGS>(args)...);
 		}
 
+		/**
+		 * @brief	Start loading a resource without blocking. Safe to call from any thread.
+		 *
+		 * @param t_ID			Guid of the resource (the file path relative to the assets dir)
+		 * @param t_OnLoaded	Called on the main thread during Update once the resource is ready
+		 * @return Handle to the resource that can be checked for when it is ready
+		 */
+		template<class T>
+		static AsyncResource<T> LoadResourceAsync(Guid t_ID, std::function<void(std::shared_ptr<T>)> t_OnLoaded = nullptr);
+
+		/**
+		 * @brief	Load a resource like LoadResource and get a counted handle to it. Main thread only.
+		 * @return Handle to the resource, empty if it could not be loaded
+		 */
+		template<class T>
+		static Handle<T> LoadHandle(Guid t_ID);
+
+		/**
+		 * @brief	Finish any async loads that are done decoding and call their callbacks.
+		 *			Called once per frame by the engine. Main thread only.
+		 */
+		void Update();
+
+		/** Block until every async load is finished. Main thread only */
+		void WaitForPendingLoads();
+
+		/** Number of async loads that have not been finished yet */
+		size_t GetPendingLoadCount() const;
+
+		/**
+		 * @brief	Set how much memory resources can use before unreferenced ones are unloaded
+		 * @param t_CpuBytes 	System memory budget, 0 for no limit
+		 * @param t_GpuBytes 	Device memory budget, 0 for no limit
+		 */
+		void SetMemoryBudget(uint64 t_CpuBytes, uint64 t_GpuBytes);
+
+		/** Bytes of system memory used by every loaded resource */
+		uint64 GetCpuMemoryUsage() const { return m_CpuMemoryUsage; }
+
+		/** Bytes of device memory used by every loaded resource */
+		uint64 GetGpuMemoryUsage() const { return m_GpuMemoryUsage; }
+
+		/** Number of resources that have been unloaded to stay in the budget */
+		uint64 GetEvictionCount() const { return m_EvictionCount; }
+
+		/** Signaled on the main thread right before a resource is unloaded to stay in the budget */
+		entt::sink<void(Resource&)> OnResourceEvicted() { return entt::sink<void(Resource&)>{ m_OnResourceEvicted }; }
+
 		template <class T>
 		std::shared_ptr<T> GetResourceOfType(Guid_Handle t_ID) const;
 
 		/**
-		 * @brief Get the already loaded resouce with this Guid. Returns nullptr if not loaded yet. 
-		 * 
+		 * @brief Get the already loaded resouce with this Guid. Returns nullptr if not loaded yet.
+		 *
 		 * @param t_ID 	Guid of the resource (a hashed string handle)
 		 * @return std::shared_ptr<Resource> Pointer to the resource
 		 */
@@ -53,14 +228,158 @@ namespace Fling
 
 	private:
 
+		template<class> friend class Handle;
+
+		typedef std::function<void(std::shared_ptr<Resource>)> LoadCallback;
+
+		/** Handle bookkeeping for a loaded resource. Main thread only */
+		struct ResourceSlot
+		{
+			/** Null if the slot is free */
+			std::shared_ptr<Resource> Res;
+
+			uint64 CpuMemory = 0;
+
+			uint64 GpuMemory = 0;
+
+			/** Frame the last handle to this resource was dropped on */
+			uint64 LastUsedFrame = 0;
+
+			/** Bumped every time the slot is freed so old handles can tell */
+			uint32 Generation = 0;
+
+			uint32 RefCount = 0;
+
+			uint32 LruPrev = INVALID_RESOURCE_SLOT;
+
+			uint32 LruNext = INVALID_RESOURCE_SLOT;
+		};
+
+		enum class LoadState : uint8
+		{
+			Queued,			// Waiting for a loader thread
+			Decoding,		// A thread is reading the file
+			Decoded,		// Waiting to be finished on the main thread
+			Finalized,		// In the resource map
+		};
+
+		/** An async load that is in flight. Everything but Path is guarded by m_PendingMutex */
+		struct PendingLoad
+		{
+			/** Owns the string that the Guid is made from, the caller's string may be long gone */
+			std::string Path;
+
+			/** Reads the file. Null if the type can't be decoded off the main thread */
+			std::function<void(Guid)> Decode;
+
+			/** Creates the resource from the decoded data */
+			std::function<std::shared_ptr<Resource>(Guid)> Finalize;
+
+			std::vector<LoadCallback> Callbacks;
+
+			LoadState State = LoadState::Queued;
+		};
+
 		template<class T, class ...ARGS>
 		std::shared_ptr<T> LoadResourceImpl(Guid t_ID, ARGS&& ... args);
 
-		typedef std::map<Fling::Guid_Handle, std::shared_ptr<Resource>>::iterator ResourceMapIt;
-		typedef std::map<Fling::Guid_Handle, std::shared_ptr<Resource>>::const_iterator ResourceMapConstIt;
-        
-		///** Map of currently loaded resources */
-		std::map<Fling::Guid_Handle, std::shared_ptr<Resource>> m_ResourceMap;
+		/** Start a load, or join the one that is already in flight for this Guid */
+		void QueueLoad(
+			Guid t_ID,
+			std::function<void(Guid)> t_Decode,
+			std::function<std::shared_ptr<Resource>(Guid)> t_Finalize,
+			LoadCallback t_OnLoaded);
+
+		/**
+		 * @brief	Finish the async load of this Guid right now, decoding it on this thread if
+		 *			a loader thread has not picked it up yet
+		 * @return The resource, or nullptr if it is not being loaded
+		 */
+		std::shared_ptr<Resource> FinishPendingLoad(Guid_Handle t_ID);
+
+		/** Create the resource of a decoded load, add it to the map, and call its callbacks */
+		std::shared_ptr<Resource> FinalizeLoad(const std::shared_ptr<PendingLoad>& t_Load);
+
+		void DecodeLoad(PendingLoad& t_Load);
+
+		/** Requires m_PendingMutex */
+		void StartLoadThreads();
+
+		void StopLoadThreads();
+
+		void LoadThreadMain();
+
+		/** Give a resource that was just added to the map a slot, and put it on the LRU list */
+		void RegisterResource(const std::shared_ptr<Resource>& t_Res);
+
+		/** Bump the generation of a slot so handles to it go stale, and make it available */
+		void FreeSlot(uint32 t_Index);
+
+		Resource* ResolveHandle(uint32 t_Index, uint32 t_Generation) const;
+
+		/** @return False if the handle is stale */
+		bool AddHandleRef(uint32 t_Index, uint32 t_Generation);
+
+		void ReleaseHandleRef(uint32 t_Index, uint32 t_Generation);
+
+		/** Most recently released resources are at the head, eviction starts from the tail */
+		void LruPushFront(uint32 t_Index);
+
+		void LruRemove(uint32 t_Index);
+
+		bool IsOverBudget() const;
+
+		/** Unload unreferenced resources, least recently used first, until usage is under budget */
+		void EvictUnusedResources();
+
+		/** Map of currently loaded resources. Safe to read from any thread */
+		ConcurrentHashMap<Fling::Guid_Handle, std::shared_ptr<Resource>> m_ResourceMap;
+
+		mutable std::mutex m_PendingMutex;
+
+		/** Loader threads wait on this for work */
+		std::condition_variable m_WorkCondition;
+
+		/** Signaled whenever a load is done decoding */
+		std::condition_variable m_DecodedCondition;
+
+		std::unordered_map<Fling::Guid_Handle, std::shared_ptr<PendingLoad>> m_PendingLoads;
+
+		std::deque<std::shared_ptr<PendingLoad>> m_DecodeQueue;
+
+		std::vector<std::shared_ptr<PendingLoad>> m_DecodedLoads;
+
+		/** Callbacks of async requests for resources that were already loaded */
+		std::vector<std::pair<LoadCallback, std::shared_ptr<Resource>>> m_ReadyCallbacks;
+
+		/** Started on the first async load. Count is [Engine] ResourceLoadThreads, 0 picks for you */
+		std::vector<std::thread> m_LoadThreads;
+
+		bool m_StopLoadThreads = false;
+
+		/** Indexed by Handle. Slots are never removed so that stale handles can always be checked */
+		std::vector<ResourceSlot> m_Slots;
+
+		std::vector<uint32> m_FreeSlots;
+
+		uint32 m_LruHead = INVALID_RESOURCE_SLOT;
+
+		uint32 m_LruTail = INVALID_RESOURCE_SLOT;
+
+		/** Counts calls to Update. Used to hold off on unloading anything a frame in flight may use */
+		uint64 m_FrameCount = 0;
+
+		uint64 m_CpuMemoryUsage = 0;
+
+		uint64 m_GpuMemoryUsage = 0;
+
+		uint64 m_CpuMemoryBudget = 0;
+
+		uint64 m_GpuMemoryBudget = 0;
+
+		uint64 m_EvictionCount = 0;
+
+		entt::sigh<void(Resource&)> m_OnResourceEvicted;
 	};
 
 
@@ -73,15 +392,77 @@ namespace Fling
 			return Existing;
 		}
 
+		// Join any async load of this file instead of loading it twice
+		if constexpr (sizeof...(ARGS) == 0)
+		{
+			if (std::shared_ptr<Resource> Loaded = FinishPendingLoad(t_ID))
+			{
+				return std::static_pointer_cast<T>(Loaded);
+			}
+		}
+
+		FLING_PROFILE_SCOPE("ResourceManager::LoadResource");
+
 		// Create a new resource of type T and return it
 		// Every resource type has an explict CTOR whose first arg has to be an ID
 		std::shared_ptr<Resource> NewResource = std::make_shared<T>(t_ID, std::forward<ARGS>(args)...);
 
 		// Keep track of this resource in the map
-		m_ResourceMap[t_ID] = NewResource;
+		m_ResourceMap.Insert(t_ID, NewResource);
+		RegisterResource(NewResource);
 		return std::static_pointer_cast<T>( NewResource );
 	}
 
+	template<class T>
+	inline AsyncResource<T> ResourceManager::LoadResourceAsync(Guid t_ID, std::function<void(std::shared_ptr<T>)> t_OnLoaded)
+	{
+		static_assert(std::is_base_of<Resource, T>::value, "LoadResourceAsync can only load Resource types!");
+
+		LoadCallback Callback = nullptr;
+		if (t_OnLoaded)
+		{
+			Callback = [t_OnLoaded](std::shared_ptr<Resource> t_Res) { t_OnLoaded(std::static_pointer_cast<T>(t_Res)); };
+		}
+
+		if constexpr (IsAsyncLoadable<T>::value)
+		{
+			// Shared between the decode and finalize steps, which run on different threads
+			std::shared_ptr<std::unique_ptr<typename T::LoadData>> Data = std::make_shared<std::unique_ptr<typename T::LoadData>>();
+
+			ResourceManager::Get().QueueLoad(
+				t_ID,
+				[Data](Guid t_Path) { *Data = T::Decode(t_Path); },
+				[Data](Guid t_Path) -> std::shared_ptr<Resource> { return std::make_shared<T>(t_Path, std::move(*Data)); },
+				Callback);
+		}
+		else
+		{
+			ResourceManager::Get().QueueLoad(
+				t_ID,
+				nullptr,
+				[](Guid t_Path) -> std::shared_ptr<Resource> { return std::make_shared<T>(t_Path); },
+				Callback);
+		}
+
+		return AsyncResource<T>(t_ID);
+	}
+
+	template<class T>
+	inline Handle<T> ResourceManager::LoadHandle(Guid t_ID)
+	{
+		std::shared_ptr<T> Res = LoadResource<T>(t_ID);
+		if (!Res)
+		{
+			return Handle<T>();
+		}
+
+		ResourceManager& Manager = ResourceManager::Get();
+		const uint32 Index = Res->m_SlotIndex;
+		const uint32 Generation = Manager.m_Slots[Index].Generation;
+		Manager.AddHandleRef(Index, Generation);
+		return Handle<T>(Index, Generation);
+	}
+
 	template<class T>
 	inline std::shared_ptr<T> ResourceManager::GetResourceOfType(Guid_Handle t_ID) const
 	{
@@ -91,4 +472,92 @@ namespace Fling
 		}
 		return nullptr;
 	}
-}	// namespace Fling
\ No newline at end of file
+
+	inline Resource* ResourceManager::ResolveHandle(uint32 t_Index, uint32 t_Generation) const
+	{
+		if (t_Index >= m_Slots.size())
+		{
+			return nullptr;
+		}
+
+		const ResourceSlot& Slot = m_Slots[t_Index];
+		return Slot.Generation == t_Generation ? Slot.Res.get() : nullptr;
+	}
+
+	template<class T>
+	inline bool AsyncResource<T>::IsReady() const
+	{
+		return ResourceManager::Get().IsLoaded(m_ID);
+	}
+
+	template<class T>
+	inline std::shared_ptr<T> AsyncResource<T>::Get() const
+	{
+		return ResourceManager::Get().GetResourceOfType<T>(m_ID);
+	}
+
+	template<class T>
+	inline Handle<T>::Handle(const Handle& t_Other)
+	{
+		if (ResourceManager::Get().AddHandleRef(t_Other.m_Index, t_Other.m_Generation))
+		{
+			m_Index = t_Other.m_Index;
+			m_Generation = t_Other.m_Generation;
+		}
+	}
+
+	template<class T>
+	inline Handle<T>::Handle(Handle&& t_Other) noexcept
+		: m_Index(t_Other.m_Index)
+		, m_Generation(t_Other.m_Generation)
+	{
+		t_Other.m_Index = INVALID_RESOURCE_SLOT;
+	}
+
+	template<class T>
+	inline Handle<T>& Handle<T>::operator=(const Handle& t_Other)
+	{
+		if (this != &t_Other)
+		{
+			// Add first in case both handles share the last reference
+			Handle Copy(t_Other);
+			*this = std::move(Copy);
+		}
+		return *this;
+	}
+
+	template<class T>
+	inline Handle<T>& Handle<T>::operator=(Handle&& t_Other) noexcept
+	{
+		if (this != &t_Other)
+		{
+			Reset();
+			m_Index = t_Other.m_Index;
+			m_Generation = t_Other.m_Generation;
+			t_Other.m_Index = INVALID_RESOURCE_SLOT;
+		}
+		return *this;
+	}
+
+	template<class T>
+	inline Handle<T>::~Handle()
+	{
+		Reset();
+	}
+
+	template<class T>
+	inline T* Handle<T>::Get() const
+	{
+		return static_cast<T*>(ResourceManager::Get().ResolveHandle(m_Index, m_Generation));
+	}
+
+	template<class T>
+	inline void Handle<T>::Reset()
+	{
+		if (m_Index != INVALID_RESOURCE_SLOT)
+		{
+			ResourceManager::Get().ReleaseHandleRef(m_Index, m_Generation);
+			m_Index = INVALID_RESOURCE_SLOT;
+		}
+	}
+}	// namespace Fling
@@ -2,6 +2,7 @@
 
 #include "Resource.h"
 #include "stb_image.h"
+#include "DeviceMemoryAllocator.h"
 
 namespace Fling
 {
@@ -14,7 +15,37 @@ namespace Fling
 
 		static std::shared_ptr<Fling::Texture> Create(Guid t_ID);
 
+        /** Pixels read off disk by Decode. @see IsAsyncLoadable */
+        struct LoadData
+        {
+            ~LoadData();
+
+            /** Owned until a Texture takes it */
+            stbi_uc* Pixels = nullptr;
+            int32 Width = 0;
+            int32 Height = 0;
+            int32 Channels = 0;
+        };
+
+        /** Read the image file with stb. Safe to call from any thread */
+        static std::unique_ptr<LoadData> Decode(Guid t_ID);
+
+        /** Number of mips in a full chain down to 1x1 */
+        static uint32 CalculateMipLevels(uint32 t_Width, uint32 t_Height);
+
+        /**
+         * @brief   Set if textures keep their pixels after they are uploaded. Defaults to Release,
+         *          anything that needs the pixels of an image should use Decode instead
+         */
+        static void SetCpuDataPolicy(CpuDataPolicy t_Policy) { PixelDataPolicy = t_Policy; }
+
+        static CpuDataPolicy GetCpuDataPolicy() { return PixelDataPolicy; }
+
         explicit Texture(Guid t_ID);
+
+        /** Create the Vulkan image from already decoded pixels. Main thread only */
+        Texture(Guid t_ID, std::unique_ptr<LoadData> t_Data);
+
         virtual ~Texture();
 
 		FORCEINLINE uint32 GetWidth() const { return m_Width; }
@@ -27,6 +58,9 @@ namespace Fling
 		FORCEINLINE const VkSampler& GetSampler() const { return m_TextureSampler; }
 		FORCEINLINE VkDescriptorImageInfo* GetDescriptorInfo() { return &m_ImageInfo; }
         FORCEINLINE const VkFormat& GetVkImageFormat() const { return m_Format; }
+
+        /** Slot of this texture in the bindless texture array, or BindlessTextures::INVALID_SLOT. @see VulkanApp::GetBindlessTextures */
+        FORCEINLINE uint32 GetBindlessSlot() const { return m_BindlessSlot; }
         /**
          * @brief   Get the Image Size object (width * height * 4)
          *          Multiply by 4 because the pixel is laid out row by row with 4 bytes per pixel
@@ -37,10 +71,14 @@ namespace Fling
         /**
          * @brief Get the Pixel Data object
          * 
-         * @return stbi_uc* 
+         * @return stbi_uc* The pixels, or nullptr if they were released after upload. @see CpuDataPolicy
          */
         stbi_uc* GetPixelData() const { return m_PixelData; }
 
+        virtual uint64 GetCpuMemoryUsage() const override { return m_PixelData ? GetImageSize() : 0; }
+
+        virtual uint64 GetGpuMemoryUsage() const override { return m_VkMemory.Size; }
+
 		/**
 		* @brief	Release the Vulkan resources of this image 
 		*/
@@ -60,10 +98,6 @@ namespace Fling
 
 		void CreateTextureSampler();
 
-		void CopyBufferToImage(VkBuffer t_Buffer);
-
-        void GenerateMipMaps(VkFormat imageFormat);
-
         /** Width of this image */
 		uint32 m_Width = 0;
 
@@ -84,13 +118,18 @@ namespace Fling
 		VkSampler m_TextureSampler;
 
 		/** The Vulkan memory resource for this image */
-		VkDeviceMemory m_VkMemory;
+		DeviceAllocation m_VkMemory;
 
 		VkDescriptorImageInfo m_ImageInfo{};
+
+        /** Where this texture is in the bindless texture array. ~0 if it isn't in one */
+        uint32 m_BindlessSlot = ~0u;
         
         /** Pixel data of image **/
-        stbi_uc* m_PixelData;
+        stbi_uc* m_PixelData = nullptr;
 
         VkFormat m_Format = VK_FORMAT_R8G8B8A8_UNORM;
+
+        static CpuDataPolicy PixelDataPolicy;
     };
 }   // namespace Fling
\ No newline at end of file
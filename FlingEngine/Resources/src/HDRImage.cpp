@@ -5,7 +5,8 @@
 #include "PhyscialDevice.h"
 #include "ResourceManager.h"
 #include "GraphicsHelpers.h"
-#include "Buffer.h"
+#include "UploadManager.h"
+#include "VulkanApp.h"
 
 namespace Fling
 {
@@ -76,24 +77,17 @@ namespace Fling
             m_Memory
         );
 
-        VkDeviceSize ImageSize = GetImageSize();
-        Buffer StagingBuffer(
-            ImageSize, 
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 
-            m_PixelData);
-
-        GraphicsHelpers::TransitionImageLayout(
-            m_Image,
-            m_Format,
-            VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            m_MipLevels
-        );
-
-        CopyBufferToImage(StagingBuffer.GetVkBuffer());
-
-        GenerateMipMaps(m_Format);
+        // Copy the pixels and blit the mip chain in the next upload batch
+        ImageUpload Upload = {};
+        Upload.Image = m_Image;
+        Upload.Format = m_Format;
+        Upload.Width = m_Width;
+        Upload.Height = m_Height;
+        Upload.MipLevels = m_MipLevels;
+        Upload.GenerateMips = true;
+        Upload.FinalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VulkanApp::Get().GetUploadManager()->UploadImage(Upload, m_PixelData, GetImageSize());
     }
 
     void HDRImage::CreateImageView()
@@ -120,137 +114,6 @@ namespace Fling
             m_TextureSampler);
     }
 
-    void HDRImage::CopyBufferToImage(VkBuffer t_Buffer)
-    {
-        VkCommandBuffer CommandBuffer = GraphicsHelpers::BeginSingleTimeCommands();
-
-        VkBufferImageCopy region = {};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = m_MipLevels;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-
-        region.imageOffset = { 0, 0, 0 };
-        region.imageExtent = {
-            m_Width,
-            m_Height,
-            1
-        };
-
-        vkCmdCopyBufferToImage(
-            CommandBuffer,
-            t_Buffer,
-            m_Image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1,
-            &region
-        );
-
-        GraphicsHelpers::EndSingleTimeCommands(CommandBuffer);
-    }
-
-    void HDRImage::GenerateMipMaps(VkFormat t_ImageFormat)
-    {
-        // Check that we have linear filtering support on this device
-        VkFormatProperties formatProperties = m_Device->GetPhysicalDevice()->GetFormatProperties(t_ImageFormat);
-
-        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
-        {
-            F_LOG_FATAL("Texture image format does not support linear blitting!");
-        }
-
-        VkCommandBuffer commandBuffer = GraphicsHelpers::BeginSingleTimeCommands();
-
-        VkImageMemoryBarrier barrier = {};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.image = m_Image;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.subresourceRange.levelCount = 1;
-
-        int32 mipWidth = m_Width;
-        int32 mipHeight = m_Height;
-
-        for (uint32 i = 1; i < m_MipLevels; i++)
-        {
-            barrier.subresourceRange.baseMipLevel = i - 1;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-            vkCmdPipelineBarrier(commandBuffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier
-            );
-
-            VkImageBlit blit = {};
-            blit.srcOffsets[0] = { 0, 0, 0 };
-            blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
-            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.srcSubresource.mipLevel = i - 1;
-            blit.srcSubresource.baseArrayLayer = 0;
-            blit.srcSubresource.layerCount = 1;
-            blit.dstOffsets[0] = { 0, 0, 0 };
-            blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.dstSubresource.mipLevel = i;
-            blit.dstSubresource.baseArrayLayer = 0;
-            blit.dstSubresource.layerCount = 1;
-
-            vkCmdBlitImage(commandBuffer,
-                m_Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1, &blit,
-                VK_FILTER_LINEAR
-            );
-
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            vkCmdPipelineBarrier(commandBuffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier
-            );
-
-            if (mipWidth > 1)
-            {
-                mipWidth /= 2;
-            }
-            if (mipHeight > 1)
-            {
-                mipHeight /= 2;
-            }
-        }
-
-        barrier.subresourceRange.baseMipLevel = m_MipLevels - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
-        GraphicsHelpers::EndSingleTimeCommands(commandBuffer);
-    }
-
     void HDRImage::Release()
     {
         // We don't need this stbi pixel data any more
@@ -271,10 +134,11 @@ namespace Fling
             m_Image = VK_NULL_HANDLE;
         }
 
-        if (m_Memory != VK_NULL_HANDLE)
+        if (m_Memory.IsValid())
         {
-            vkFreeMemory(Device, m_Memory, nullptr);
-            m_Memory = VK_NULL_HANDLE;
+            DeviceMemoryAllocator* Allocator = VulkanApp::Get().GetMemoryAllocator();
+            assert(Allocator);
+            Allocator->Free(m_Memory);
         }
         if (m_TextureSampler != VK_NULL_HANDLE)
         {
@@ -15,6 +15,12 @@ namespace Fling
         LoadJsonFile();
     }
 
+	JsonFile::JsonFile(Guid t_ID, nlohmann::json&& t_Data)
+        : Resource(t_ID)
+        , m_JsonData(std::move(t_Data))
+    {
+    }
+
 	void JsonFile::Write()
 	{
 		const std::string FilePath = GetFilepathReleativeToAssets();
@@ -35,20 +41,23 @@ namespace Fling
 
 	void JsonFile::LoadJsonFile()
     {
-        const std::string FilePath = GetFilepathReleativeToAssets();
-        std::ifstream ifs(FilePath.c_str());
+        ReadJsonFile(GetFilepathReleativeToAssets(), m_JsonData);
+    }
+
+	bool JsonFile::ReadJsonFile(const std::string& t_FilePath, nlohmann::json& t_OutData)
+    {
+        std::ifstream ifs(t_FilePath.c_str());
 
-        if (ifs.is_open())
-        {
-            // Store the info in the scene file in the JSON object
-            ifs >> m_JsonData;
-        }
-        else
+        if (!ifs.is_open())
         {
-            F_LOG_ERROR( "Failed to load JSON File: {}", FilePath);
+            F_LOG_ERROR( "Failed to load JSON File: {}", t_FilePath);
+            return false;
         }
 
+        // Store the info in the scene file in the JSON object
+        ifs >> t_OutData;
         ifs.close();
 
+        return true;
     }
-} // namespace Fling
\ No newline at end of file
+} // namespace Fling
@@ -7,4 +7,9 @@ namespace Fling
     {
         return (FlingPaths::EngineAssetsDir() + "/" + GetGuidString());
     }
+
+    std::string Resource::GetFilepathReleativeToAssets(Guid t_ID)
+    {
+        return (FlingPaths::EngineAssetsDir() + "/" + t_ID.data());
+    }
 }
\ No newline at end of file
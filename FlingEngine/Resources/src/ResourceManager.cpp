@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "ResourceManager.h"
+#include "FlingConfig.h"
+#include "FlingVulkan.h"
 
 namespace Fling
 {
@@ -23,26 +25,524 @@ namespace Fling
 		FlingPaths::GetCurrentWorkingDir(currentDir, 1024);
 	}
 
+	ResourceManager::~ResourceManager()
+	{
+		StopLoadThreads();
+	}
+
 	void ResourceManager::Shutdown()
 	{
+		// Nothing that is half loaded should outlive the manager
+		StopLoadThreads();
+
+		{
+			std::lock_guard<std::mutex> Lock(m_PendingMutex);
+			m_DecodeQueue.clear();
+			m_DecodedLoads.clear();
+			m_PendingLoads.clear();
+			m_ReadyCallbacks.clear();
+		}
+
 		// Unload all assets BB
 		// This will remove all owning references to the shared_ptr's
-		m_ResourceMap.clear();
+		m_ResourceMap.Clear();
+
+		// Keep the slots around so any handles that outlive this can tell they are stale
+		std::vector<std::shared_ptr<Resource>> Unloaded;
+		m_FreeSlots.clear();
+		for (uint32 i = 0; i < static_cast<uint32>(m_Slots.size()); ++i)
+		{
+			ResourceSlot& Slot = m_Slots[i];
+			if (Slot.Res)
+			{
+				Unloaded.emplace_back(std::move(Slot.Res));
+			}
+			FreeSlot(i);
+		}
+		m_LruHead = m_LruTail = INVALID_RESOURCE_SLOT;
+		m_CpuMemoryUsage = 0;
+		m_GpuMemoryUsage = 0;
+
+		// Resources can drop handles to other resources when they are destroyed, so that has
+		// to happen once the slots are in a good state
+		Unloaded.clear();
 	}
 
-	std::shared_ptr<Resource> ResourceManager::GetResource(Guid_Handle t_ID) const
+	void ResourceManager::Update()
+	{
+		std::vector<std::shared_ptr<PendingLoad>> Decoded;
+		std::vector<std::pair<LoadCallback, std::shared_ptr<Resource>>> Ready;
+		{
+			std::lock_guard<std::mutex> Lock(m_PendingMutex);
+			Decoded.swap(m_DecodedLoads);
+			Ready.swap(m_ReadyCallbacks);
+		}
+
+		for (std::pair<LoadCallback, std::shared_ptr<Resource>>& Callback : Ready)
+		{
+			Callback.first(Callback.second);
+		}
+
+		for (const std::shared_ptr<PendingLoad>& Load : Decoded)
+		{
+			// A blocking LoadResource call may have finished this one already
+			bool IsFinalized = false;
+			{
+				std::lock_guard<std::mutex> Lock(m_PendingMutex);
+				IsFinalized = Load->State == LoadState::Finalized;
+			}
+
+			if (!IsFinalized)
+			{
+				FinalizeLoad(Load);
+			}
+		}
+
+		++m_FrameCount;
+		EvictUnusedResources();
+	}
+
+	void ResourceManager::WaitForPendingLoads()
+	{
+		while (true)
+		{
+			Guid_Handle Next = 0;
+			{
+				std::lock_guard<std::mutex> Lock(m_PendingMutex);
+				if (m_PendingLoads.empty())
+				{
+					break;
+				}
+				Next = m_PendingLoads.begin()->first;
+			}
+
+			FinishPendingLoad(Next);
+		}
+
+		// Flush out any callbacks of resources that were already loaded
+		Update();
+	}
+
+	size_t ResourceManager::GetPendingLoadCount() const
+	{
+		std::lock_guard<std::mutex> Lock(m_PendingMutex);
+		return m_PendingLoads.size();
+	}
+
+	void ResourceManager::QueueLoad(
+		Guid t_ID,
+		std::function<void(Guid)> t_Decode,
+		std::function<std::shared_ptr<Resource>(Guid)> t_Finalize,
+		LoadCallback t_OnLoaded)
+	{
+		std::lock_guard<std::mutex> Lock(m_PendingMutex);
+
+		// Resources are added to the map before they leave the pending list, so checking
+		// here under the lock can't miss one that finished in between
+		std::shared_ptr<Resource> Existing = nullptr;
+		if (m_ResourceMap.Find(t_ID, Existing))
+		{
+			if (t_OnLoaded)
+			{
+				m_ReadyCallbacks.emplace_back(t_OnLoaded, Existing);
+			}
+			return;
+		}
+
+		// Someone else is already loading this, just wait for it with them
+		auto It = m_PendingLoads.find(t_ID);
+		if (It != m_PendingLoads.end())
+		{
+			if (t_OnLoaded)
+			{
+				It->second->Callbacks.emplace_back(t_OnLoaded);
+			}
+			return;
+		}
+
+		std::shared_ptr<PendingLoad> Load = std::make_shared<PendingLoad>();
+		Load->Path = t_ID.data();
+		Load->Decode = t_Decode;
+		Load->Finalize = t_Finalize;
+		if (t_OnLoaded)
+		{
+			Load->Callbacks.emplace_back(t_OnLoaded);
+		}
+
+		m_PendingLoads.emplace(t_ID, Load);
+
+		if (Load->Decode)
+		{
+			StartLoadThreads();
+			m_DecodeQueue.emplace_back(Load);
+			m_WorkCondition.notify_one();
+		}
+		else
+		{
+			// Nothing to do off of the main thread
+			Load->State = LoadState::Decoded;
+			m_DecodedLoads.emplace_back(Load);
+		}
+	}
+
+	std::shared_ptr<Resource> ResourceManager::FinishPendingLoad(Guid_Handle t_ID)
+	{
+		std::shared_ptr<PendingLoad> Load = nullptr;
+		{
+			std::unique_lock<std::mutex> Lock(m_PendingMutex);
+
+			auto It = m_PendingLoads.find(t_ID);
+			if (It == m_PendingLoads.end())
+			{
+				return nullptr;
+			}
+			Load = It->second;
+
+			if (Load->State == LoadState::Queued)
+			{
+				// No loader thread has picked this up yet, so it is faster to decode it here
+				// than to wait. Loader threads skip anything that isn't queued
+				Load->State = LoadState::Decoding;
+				Lock.unlock();
+
+				DecodeLoad(*Load);
+
+				Lock.lock();
+				Load->State = LoadState::Decoded;
+			}
+			else
+			{
+				m_DecodedCondition.wait(Lock, [&Load]() { return Load->State != LoadState::Decoding; });
+			}
+		}
+
+		return FinalizeLoad(Load);
+	}
+
+	std::shared_ptr<Resource> ResourceManager::FinalizeLoad(const std::shared_ptr<PendingLoad>& t_Load)
+	{
+		FLING_PROFILE_SCOPE("ResourceManager::FinalizeLoad");
+
+		const Guid ID { t_Load->Path.c_str() };
+
+		// Finalizing can load other resources (a material loads its textures), so no locks are held here
+		std::shared_ptr<Resource> NewResource = t_Load->Finalize(ID);
+
+		std::shared_ptr<Resource> Existing = nullptr;
+		if (m_ResourceMap.InsertIfAbsent(ID, NewResource, Existing))
+		{
+			RegisterResource(NewResource);
+		}
+		else
+		{
+			NewResource = Existing;
+		}
+
+		std::vector<LoadCallback> Callbacks;
+		{
+			std::lock_guard<std::mutex> Lock(m_PendingMutex);
+			t_Load->State = LoadState::Finalized;
+			Callbacks.swap(t_Load->Callbacks);
+			m_PendingLoads.erase(ID);
+		}
+
+		for (LoadCallback& Callback : Callbacks)
+		{
+			Callback(NewResource);
+		}
+
+		return NewResource;
+	}
+
+	void ResourceManager::DecodeLoad(PendingLoad& t_Load)
+	{
+		if (!t_Load.Decode)
+		{
+			return;
+		}
+
+		FLING_PROFILE_SCOPE("ResourceManager::DecodeLoad");
+
+		try
+		{
+			t_Load.Decode(Guid { t_Load.Path.c_str() });
+		}
+		catch (std::exception& e)
+		{
+			F_LOG_ERROR("Failed to decode resource {} : {}", t_Load.Path, e.what());
+		}
+	}
+
+	void ResourceManager::StartLoadThreads()
+	{
+		if (!m_LoadThreads.empty())
+		{
+			return;
+		}
+
+		int32 ThreadCount = FlingConfig::GetInt("Engine", "ResourceLoadThreads", 0);
+		if (ThreadCount <= 0)
+		{
+			// Leave room for the main thread and the driver
+			ThreadCount = std::max<int32>(1, static_cast<int32>(std::thread::hardware_concurrency()) / 2);
+		}
+
+		m_StopLoadThreads = false;
+		for (int32 i = 0; i < ThreadCount; ++i)
+		{
+			m_LoadThreads.emplace_back(&ResourceManager::LoadThreadMain, this);
+		}
+
+		F_LOG_TRACE("Started {} resource loader threads", ThreadCount);
+	}
+
+	void ResourceManager::StopLoadThreads()
 	{
-		ResourceMapConstIt It = m_ResourceMap.find(t_ID);
-		if (It != m_ResourceMap.end())
 		{
-			return It->second;
+			std::lock_guard<std::mutex> Lock(m_PendingMutex);
+			m_StopLoadThreads = true;
 		}
+		m_WorkCondition.notify_all();
 
-		return nullptr;
+		for (std::thread& Thread : m_LoadThreads)
+		{
+			if (Thread.joinable())
+			{
+				Thread.join();
+			}
+		}
+		m_LoadThreads.clear();
+	}
+
+	void ResourceManager::LoadThreadMain()
+	{
+		FLING_PROFILE_THREAD("Resource Loader");
+
+		while (true)
+		{
+			std::shared_ptr<PendingLoad> Load = nullptr;
+			{
+				std::unique_lock<std::mutex> Lock(m_PendingMutex);
+				m_WorkCondition.wait(Lock, [this]() { return m_StopLoadThreads || !m_DecodeQueue.empty(); });
+
+				if (m_StopLoadThreads)
+				{
+					return;
+				}
+
+				Load = m_DecodeQueue.front();
+				m_DecodeQueue.pop_front();
+
+				// The main thread took this one over
+				if (Load->State != LoadState::Queued)
+				{
+					continue;
+				}
+				Load->State = LoadState::Decoding;
+			}
+
+			DecodeLoad(*Load);
+
+			{
+				std::lock_guard<std::mutex> Lock(m_PendingMutex);
+				Load->State = LoadState::Decoded;
+				m_DecodedLoads.emplace_back(Load);
+			}
+			m_DecodedCondition.notify_all();
+		}
+	}
+
+	std::shared_ptr<Resource> ResourceManager::GetResource(Guid_Handle t_ID) const
+	{
+		std::shared_ptr<Resource> Res = nullptr;
+		m_ResourceMap.Find(t_ID, Res);
+		return Res;
 	}
 
 	bool ResourceManager::IsLoaded(Guid_Handle t_ID) const
 	{
-        return (m_ResourceMap.find(t_ID) != m_ResourceMap.end());
+		return m_ResourceMap.Contains(t_ID);
+	}
+
+	void ResourceManager::SetMemoryBudget(uint64 t_CpuBytes, uint64 t_GpuBytes)
+	{
+		m_CpuMemoryBudget = t_CpuBytes;
+		m_GpuMemoryBudget = t_GpuBytes;
+	}
+
+	void ResourceManager::RegisterResource(const std::shared_ptr<Resource>& t_Res)
+	{
+		uint32 Index = INVALID_RESOURCE_SLOT;
+		if (!m_FreeSlots.empty())
+		{
+			Index = m_FreeSlots.back();
+			m_FreeSlots.pop_back();
+		}
+		else
+		{
+			Index = static_cast<uint32>(m_Slots.size());
+			m_Slots.emplace_back();
+		}
+
+		ResourceSlot& Slot = m_Slots[Index];
+		Slot.Res = t_Res;
+		Slot.CpuMemory = t_Res->GetCpuMemoryUsage();
+		Slot.GpuMemory = t_Res->GetGpuMemoryUsage();
+		Slot.RefCount = 0;
+		t_Res->m_SlotIndex = Index;
+
+		m_CpuMemoryUsage += Slot.CpuMemory;
+		m_GpuMemoryUsage += Slot.GpuMemory;
+
+		// Nothing has a handle to this yet
+		Slot.LastUsedFrame = m_FrameCount;
+		LruPushFront(Index);
+	}
+
+	void ResourceManager::FreeSlot(uint32 t_Index)
+	{
+		ResourceSlot& Slot = m_Slots[t_Index];
+		const uint32 NextGeneration = Slot.Generation + 1;
+
+		Slot = ResourceSlot {};
+		Slot.Generation = NextGeneration;
+		m_FreeSlots.push_back(t_Index);
+	}
+
+	bool ResourceManager::AddHandleRef(uint32 t_Index, uint32 t_Generation)
+	{
+		if (!ResolveHandle(t_Index, t_Generation))
+		{
+			return false;
+		}
+
+		ResourceSlot& Slot = m_Slots[t_Index];
+		if (Slot.RefCount++ == 0)
+		{
+			LruRemove(t_Index);
+		}
+		return true;
+	}
+
+	void ResourceManager::ReleaseHandleRef(uint32 t_Index, uint32 t_Generation)
+	{
+		if (!ResolveHandle(t_Index, t_Generation))
+		{
+			return;
+		}
+
+		ResourceSlot& Slot = m_Slots[t_Index];
+		assert(Slot.RefCount > 0);
+		if (--Slot.RefCount == 0)
+		{
+			Slot.LastUsedFrame = m_FrameCount;
+			LruPushFront(t_Index);
+		}
+	}
+
+	void ResourceManager::LruPushFront(uint32 t_Index)
+	{
+		ResourceSlot& Slot = m_Slots[t_Index];
+		Slot.LruPrev = INVALID_RESOURCE_SLOT;
+		Slot.LruNext = m_LruHead;
+
+		if (m_LruHead != INVALID_RESOURCE_SLOT)
+		{
+			m_Slots[m_LruHead].LruPrev = t_Index;
+		}
+		m_LruHead = t_Index;
+
+		if (m_LruTail == INVALID_RESOURCE_SLOT)
+		{
+			m_LruTail = t_Index;
+		}
+	}
+
+	void ResourceManager::LruRemove(uint32 t_Index)
+	{
+		ResourceSlot& Slot = m_Slots[t_Index];
+
+		if (Slot.LruPrev != INVALID_RESOURCE_SLOT)
+		{
+			m_Slots[Slot.LruPrev].LruNext = Slot.LruNext;
+		}
+		else
+		{
+			m_LruHead = Slot.LruNext;
+		}
+
+		if (Slot.LruNext != INVALID_RESOURCE_SLOT)
+		{
+			m_Slots[Slot.LruNext].LruPrev = Slot.LruPrev;
+		}
+		else
+		{
+			m_LruTail = Slot.LruPrev;
+		}
+
+		Slot.LruPrev = Slot.LruNext = INVALID_RESOURCE_SLOT;
+	}
+
+	bool ResourceManager::IsOverBudget() const
+	{
+		return (m_CpuMemoryBudget && m_CpuMemoryUsage > m_CpuMemoryBudget) ||
+			(m_GpuMemoryBudget && m_GpuMemoryUsage > m_GpuMemoryBudget);
+	}
+
+	void ResourceManager::EvictUnusedResources()
+	{
+		if (!IsOverBudget())
+		{
+			return;
+		}
+
+		std::vector<std::shared_ptr<Resource>> Evicted;
+		{
+			// Loader threads look up resources in the map, which would keep one alive past here
+			std::lock_guard<std::mutex> Lock(m_PendingMutex);
+
+			uint32 Index = m_LruTail;
+			while (Index != INVALID_RESOURCE_SLOT && IsOverBudget())
+			{
+				ResourceSlot& Slot = m_Slots[Index];
+				const uint32 Prev = Slot.LruPrev;
+
+				// Frames in flight may still be reading from this. Everything closer to
+				// the head was released even more recently
+				if (Slot.LastUsedFrame + VkConfig::MAX_FRAMES_IN_FLIGHT >= m_FrameCount)
+				{
+					break;
+				}
+
+				// Someone is still holding on to a shared_ptr (one ref is the slot, one is the map)
+				if (Slot.Res.use_count() > 2)
+				{
+					Index = Prev;
+					continue;
+				}
+
+				LruRemove(Index);
+				m_ResourceMap.Erase(Slot.Res->GetGuidHandle());
+
+				m_CpuMemoryUsage -= Slot.CpuMemory;
+				m_GpuMemoryUsage -= Slot.GpuMemory;
+
+				Evicted.emplace_back(std::move(Slot.Res));
+				FreeSlot(Index);
+
+				Index = Prev;
+			}
+		}
+
+		for (const std::shared_ptr<Resource>& Res : Evicted)
+		{
+			F_LOG_TRACE("Unloading unused resource {}", Res->GetGuidString());
+			m_OnResourceEvicted.publish(*Res);
+		}
+		m_EvictionCount += Evicted.size();
+
+		// Destroying these can release handles to other resources, which will be
+		// considered for eviction next frame
+		Evicted.clear();
 	}
-}	// namespace Fling
\ No newline at end of file
+}	// namespace Fling
@@ -12,20 +12,81 @@
 
 #include "ResourceManager.h"
 #include "GraphicsHelpers.h"
-#include "Buffer.h"
+#include "UploadManager.h"
+#include "BindlessTextures.h"
 
 namespace Fling
 {
+	CpuDataPolicy Texture::PixelDataPolicy = CpuDataPolicy::Release;
+
 	std::shared_ptr<Fling::Texture> Texture::Create(Guid t_ID)
 	{
 		return ResourceManager::LoadResource<Fling::Texture>(t_ID);
 	}
 
+	Texture::LoadData::~LoadData()
+	{
+		if (Pixels)
+		{
+			stbi_image_free(Pixels);
+		}
+	}
+
+	std::unique_ptr<Texture::LoadData> Texture::Decode(Guid t_ID)
+	{
+		const std::string Filepath = Resource::GetFilepathReleativeToAssets(t_ID);
+
+		std::unique_ptr<LoadData> Data = std::make_unique<LoadData>();
+		Data->Pixels = stbi_load(
+			Filepath.c_str(),
+			&Data->Width,
+			&Data->Height,
+			&Data->Channels,
+			STBI_rgb_alpha
+		);
+
+		if (!Data->Pixels)
+		{
+			F_LOG_ERROR("Failed to load image file: {}", Filepath);
+		}
+
+		return Data;
+	}
+
+	uint32 Texture::CalculateMipLevels(uint32 t_Width, uint32 t_Height)
+	{
+		return static_cast<uint32>(std::floor(std::log2(std::max(std::max(t_Width, t_Height), 1u)))) + 1;
+	}
+
 	Texture::Texture(Guid t_ID)
+		: Texture(t_ID, Decode(t_ID))
+	{
+	}
+
+	Texture::Texture(Guid t_ID, std::unique_ptr<LoadData> t_Data)
         : Resource(t_ID)
     {
+		if (t_Data)
+		{
+			// Take ownership of the pixels, they are freed in Release
+			m_PixelData = t_Data->Pixels;
+			t_Data->Pixels = nullptr;
+
+			m_Width = static_cast<uint32>(t_Data->Width);
+			m_Height = static_cast<uint32>(t_Data->Height);
+			m_Channels = t_Data->Channels;
+		}
+		m_MipLevels = CalculateMipLevels(m_Width, m_Height);
+
         LoadVulkanImage();
 
+        // The upload has its own copy of the pixels by now
+        if (PixelDataPolicy == CpuDataPolicy::Release && m_PixelData)
+        {
+            stbi_image_free(m_PixelData);
+            m_PixelData = nullptr;
+        }
+
         // Create the image views for sampling
         CreateImageView();
 
@@ -34,32 +95,16 @@ namespace Fling
 		m_ImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		m_ImageInfo.imageView = m_ImageView;
 		m_ImageInfo.sampler = m_TextureSampler;
+
+		// Shaders that use the bindless array find this texture by its slot
+		if (BindlessTextures* Bindless = VulkanApp::Get().GetBindlessTextures())
+		{
+			m_BindlessSlot = Bindless->Register(m_ImageInfo);
+		}
 	}
 
     void Texture::LoadVulkanImage()
     {
-        const std::string Filepath = GetFilepathReleativeToAssets();
-
-        // Load the image from STB
-        int Width = 0;
-        int Height = 0;
-        m_PixelData = stbi_load(
-            Filepath.c_str(),
-            &Width,
-            &Height,
-            &m_Channels,
-            STBI_rgb_alpha
-        );
-
-        m_Width = static_cast<uint32>(Width);
-        m_Height = static_cast<uint32>(Height);
-        m_MipLevels = static_cast<uint32>(std::floor(std::log2(std::max(m_Width, m_Height)))) + 1;
-
-        if (!m_PixelData)
-        {
-            F_LOG_ERROR("Failed to load image file: {}", Filepath);
-        }
-
         GraphicsHelpers::CreateVkImage(
 			VulkanApp::Get().GetLogicalDevice()->GetVkDevice(),
             m_Width,
@@ -76,153 +121,18 @@ namespace Fling
             m_VkMemory
         );
 
-        // Put the image data in a staging buffer for Vulkan
-        VkDeviceSize ImageSize = GetImageSize();
-        Buffer StagingBuffer(ImageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_PixelData);
-        
-        // Transition and copy the image layout to the staging buffer
-        GraphicsHelpers::TransitionImageLayout(
-            m_vVkImage, 
-            VK_FORMAT_R8G8B8A8_UNORM, 
-            VK_IMAGE_LAYOUT_UNDEFINED, 
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            m_MipLevels
-        );
-        CopyBufferToImage(StagingBuffer.GetVkBuffer());
-
-        // Transition to image layout happens while generating mip maps
-        GenerateMipMaps(VK_FORMAT_R8G8B8A8_UNORM);
-    }
-
-    void Texture::GenerateMipMaps(VkFormat imageFormat)
-    {
-        // Check that we have linear filtering support on this device
-        VkFormatProperties formatProperties = VulkanApp::Get().GetPhysicalDevice()->GetFormatProperties(imageFormat);
-
-        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) 
-        {
-            F_LOG_FATAL("Texture image format does not support linear blitting!");
-        }
-
-        VkCommandBuffer commandBuffer = GraphicsHelpers::BeginSingleTimeCommands();
-
-        VkImageMemoryBarrier barrier = {};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.image = m_vVkImage;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.subresourceRange.levelCount = 1;
-
-        int32 mipWidth = m_Width;
-        int32 mipHeight = m_Height;
-
-        for(uint32 i = 1; i < m_MipLevels; i++)
-        {
-            barrier.subresourceRange.baseMipLevel = i - 1;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-            vkCmdPipelineBarrier(commandBuffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier
-            );
-
-            VkImageBlit blit = {};
-            blit.srcOffsets[0] = { 0, 0, 0 };
-            blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
-            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.srcSubresource.mipLevel = i - 1;
-            blit.srcSubresource.baseArrayLayer = 0;
-            blit.srcSubresource.layerCount = 1;
-            blit.dstOffsets[0] = { 0, 0, 0 };
-            blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.dstSubresource.mipLevel = i;
-            blit.dstSubresource.baseArrayLayer = 0;
-            blit.dstSubresource.layerCount = 1;
-
-            vkCmdBlitImage(commandBuffer,
-                m_vVkImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                m_vVkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1, &blit,
-                VK_FILTER_LINEAR
-            );
-
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            vkCmdPipelineBarrier(commandBuffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier
-            );
-
-            if (mipWidth > 1) 
-            {
-                mipWidth /= 2;
-            }
-            if (mipHeight > 1)
-            {
-                mipHeight /= 2;
-            } 
-        }
-
-        barrier.subresourceRange.baseMipLevel = m_MipLevels - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
-        GraphicsHelpers::EndSingleTimeCommands(commandBuffer);
-    }
-
-    void Texture::CopyBufferToImage(VkBuffer t_Buffer)
-    {
-        VkCommandBuffer commandBuffer = GraphicsHelpers::BeginSingleTimeCommands();
-
-        VkBufferImageCopy region = {};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-
-        region.imageOffset = { 0, 0, 0 };
-        region.imageExtent = {
-            m_Width,
-            m_Height,
-            1
-        };
-
-        vkCmdCopyBufferToImage(
-            commandBuffer,
-            t_Buffer,
-            m_vVkImage,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1,
-            &region
-        );
-
-        GraphicsHelpers::EndSingleTimeCommands(commandBuffer);
+        // Copy the pixels and blit the mip chain in the next upload batch. It is submitted before
+        // any frame that could sample this texture
+        ImageUpload Upload = {};
+        Upload.Image = m_vVkImage;
+        Upload.Format = VK_FORMAT_R8G8B8A8_UNORM;
+        Upload.Width = m_Width;
+        Upload.Height = m_Height;
+        Upload.MipLevels = m_MipLevels;
+        Upload.GenerateMips = true;
+        Upload.FinalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VulkanApp::Get().GetUploadManager()->UploadImage(Upload, m_PixelData, GetImageSize());
     }
 
     void Texture::CreateImageView()
@@ -272,7 +182,11 @@ namespace Fling
     void Texture::Release()
     {
         // We don't need this stbi pixel data any more
-        stbi_image_free(m_PixelData);
+        if (m_PixelData)
+        {
+            stbi_image_free(m_PixelData);
+            m_PixelData = nullptr;
+        }
         
 		LogicalDevice* LogDevice = VulkanApp::Get().GetLogicalDevice();
 		assert(LogDevice);
@@ -285,6 +199,15 @@ namespace Fling
             return;
         }
 
+        if (m_BindlessSlot != BindlessTextures::INVALID_SLOT)
+        {
+            if (BindlessTextures* Bindless = VulkanApp::Get().GetBindlessTextures())
+            {
+                Bindless->Unregister(m_BindlessSlot);
+            }
+            m_BindlessSlot = BindlessTextures::INVALID_SLOT;
+        }
+
         // Cleanup the Vulkan memory
         if (m_vVkImage != VK_NULL_HANDLE)
         {
@@ -292,10 +215,11 @@ namespace Fling
             m_vVkImage = VK_NULL_HANDLE;
         }
         
-        if (m_VkMemory != VK_NULL_HANDLE)
+        if (m_VkMemory.IsValid())
         {
-            vkFreeMemory(Device, m_VkMemory, nullptr);
-            m_VkMemory = VK_NULL_HANDLE;
+            DeviceMemoryAllocator* Allocator = VulkanApp::Get().GetMemoryAllocator();
+            assert(Allocator);
+            Allocator->Free(m_VkMemory);
         }
         if (m_TextureSampler != VK_NULL_HANDLE)
         {
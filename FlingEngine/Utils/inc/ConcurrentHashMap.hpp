@@ -0,0 +1,294 @@
+#pragma once
+
+#include "FlingTypes.h"
+
+#include <shared_mutex>
+#include <type_traits>
+#include <vector>
+
+namespace Fling
+{
+	/**
+	 * @brief 	An open addressing hash map with linear probing for keys that are already a good
+	 *			hash (like Guid_Handle), so the key is used as the hash directly. Lookups take a shared
+	 *			lock and can run in parallel, inserts and erases take an exclusive lock.
+	 *			Values are returned by copy so that they stay valid after the lock is released.
+	 *
+	 * @tparam K 	An integral key type. Every value is a valid key
+	 * @tparam V 	The type of value stored. Should be cheap to copy (like a shared_ptr)
+	 */
+	template<typename K, typename V>
+	class ConcurrentHashMap
+	{
+		static_assert(std::is_integral<K>::value, "ConcurrentHashMap keys must be integral hashes!");
+
+	public:
+
+		explicit ConcurrentHashMap(size_t t_InitialCapacity = 64);
+
+		~ConcurrentHashMap() = default;
+
+		/**
+		 * @brief 	Find the value of a key
+		 * @param t_OutValue 	Set to the value if the key was found
+		 * @return True if the key is in the map
+		 */
+		bool Find(K t_Key, V& t_OutValue) const;
+
+		bool Contains(K t_Key) const;
+
+		/** Insert a value or replace the value of a key that is already in the map */
+		void Insert(K t_Key, const V& t_Value);
+
+		/**
+		 * @brief 	Insert a value only if the key is not in the map yet
+		 * @param t_OutExisting 	Set to the value already in the map if there was one
+		 * @return True if the value was inserted
+		 */
+		bool InsertIfAbsent(K t_Key, const V& t_Value, V& t_OutExisting);
+
+		/** @return True if the key was in the map */
+		bool Erase(K t_Key);
+
+		void Clear();
+
+		size_t Size() const;
+
+		/** Call t_Func(key, value) for every entry. Holds the shared lock, so don't modify the map from t_Func */
+		template<typename F>
+		void ForEach(F&& t_Func) const;
+
+	private:
+
+		enum class SlotState : uint8
+		{
+			Empty,
+			Full,
+			Deleted,
+		};
+
+		struct Slot
+		{
+			K Key = {};
+			V Value = {};
+			SlotState State = SlotState::Empty;
+		};
+
+		/** Index of the slot holding t_Key, or m_Slots.size() if it is not in the map. Requires a lock */
+		size_t FindSlot(K t_Key) const;
+
+		/** Insert without checking for the key, the map must have room. Requires the exclusive lock */
+		void InsertNew(K t_Key, const V& t_Value);
+
+		/** Grow (or clean up tombstones) so there is room for one more entry. Requires the exclusive lock */
+		void ReserveOne();
+
+		std::vector<Slot> m_Slots;
+
+		/** Number of full slots */
+		size_t m_Count = 0;
+
+		/** Number of full and deleted slots, deleted slots still lengthen probes */
+		size_t m_Used = 0;
+
+		mutable std::shared_mutex m_Mutex;
+	};
+
+	template<typename K, typename V>
+	inline ConcurrentHashMap<K, V>::ConcurrentHashMap(size_t t_InitialCapacity)
+	{
+		// Capacity is always a power of 2 so that the probe can mask instead of mod
+		size_t Capacity = 8;
+		while (Capacity < t_InitialCapacity)
+		{
+			Capacity <<= 1;
+		}
+		m_Slots.resize(Capacity);
+	}
+
+	template<typename K, typename V>
+	inline size_t ConcurrentHashMap<K, V>::FindSlot(K t_Key) const
+	{
+		const size_t Mask = m_Slots.size() - 1;
+		size_t Index = static_cast<size_t>(t_Key) & Mask;
+
+		for (size_t Probe = 0; Probe < m_Slots.size(); ++Probe)
+		{
+			const Slot& Cur = m_Slots[Index];
+			if (Cur.State == SlotState::Empty)
+			{
+				break;
+			}
+			if (Cur.State == SlotState::Full && Cur.Key == t_Key)
+			{
+				return Index;
+			}
+			Index = (Index + 1) & Mask;
+		}
+
+		return m_Slots.size();
+	}
+
+	template<typename K, typename V>
+	inline bool ConcurrentHashMap<K, V>::Find(K t_Key, V& t_OutValue) const
+	{
+		std::shared_lock<std::shared_mutex> Lock(m_Mutex);
+
+		const size_t Index = FindSlot(t_Key);
+		if (Index == m_Slots.size())
+		{
+			return false;
+		}
+
+		t_OutValue = m_Slots[Index].Value;
+		return true;
+	}
+
+	template<typename K, typename V>
+	inline bool ConcurrentHashMap<K, V>::Contains(K t_Key) const
+	{
+		std::shared_lock<std::shared_mutex> Lock(m_Mutex);
+		return FindSlot(t_Key) != m_Slots.size();
+	}
+
+	template<typename K, typename V>
+	inline void ConcurrentHashMap<K, V>::Insert(K t_Key, const V& t_Value)
+	{
+		std::unique_lock<std::shared_mutex> Lock(m_Mutex);
+
+		const size_t Index = FindSlot(t_Key);
+		if (Index != m_Slots.size())
+		{
+			m_Slots[Index].Value = t_Value;
+			return;
+		}
+
+		ReserveOne();
+		InsertNew(t_Key, t_Value);
+	}
+
+	template<typename K, typename V>
+	inline bool ConcurrentHashMap<K, V>::InsertIfAbsent(K t_Key, const V& t_Value, V& t_OutExisting)
+	{
+		std::unique_lock<std::shared_mutex> Lock(m_Mutex);
+
+		const size_t Index = FindSlot(t_Key);
+		if (Index != m_Slots.size())
+		{
+			t_OutExisting = m_Slots[Index].Value;
+			return false;
+		}
+
+		ReserveOne();
+		InsertNew(t_Key, t_Value);
+		return true;
+	}
+
+	template<typename K, typename V>
+	inline bool ConcurrentHashMap<K, V>::Erase(K t_Key)
+	{
+		std::unique_lock<std::shared_mutex> Lock(m_Mutex);
+
+		const size_t Index = FindSlot(t_Key);
+		if (Index == m_Slots.size())
+		{
+			return false;
+		}
+
+		// Leave a tombstone so that probes past this slot still work
+		Slot& Cur = m_Slots[Index];
+		Cur.Value = V {};
+		Cur.State = SlotState::Deleted;
+		--m_Count;
+		return true;
+	}
+
+	template<typename K, typename V>
+	inline void ConcurrentHashMap<K, V>::Clear()
+	{
+		std::unique_lock<std::shared_mutex> Lock(m_Mutex);
+
+		for (Slot& Cur : m_Slots)
+		{
+			Cur = Slot {};
+		}
+		m_Count = 0;
+		m_Used = 0;
+	}
+
+	template<typename K, typename V>
+	inline size_t ConcurrentHashMap<K, V>::Size() const
+	{
+		std::shared_lock<std::shared_mutex> Lock(m_Mutex);
+		return m_Count;
+	}
+
+	template<typename K, typename V>
+	template<typename F>
+	inline void ConcurrentHashMap<K, V>::ForEach(F&& t_Func) const
+	{
+		std::shared_lock<std::shared_mutex> Lock(m_Mutex);
+
+		for (const Slot& Cur : m_Slots)
+		{
+			if (Cur.State == SlotState::Full)
+			{
+				t_Func(Cur.Key, Cur.Value);
+			}
+		}
+	}
+
+	template<typename K, typename V>
+	inline void ConcurrentHashMap<K, V>::InsertNew(K t_Key, const V& t_Value)
+	{
+		const size_t Mask = m_Slots.size() - 1;
+		size_t Index = static_cast<size_t>(t_Key) & Mask;
+
+		// Reuse the first tombstone or empty slot on the probe
+		while (m_Slots[Index].State == SlotState::Full)
+		{
+			Index = (Index + 1) & Mask;
+		}
+
+		Slot& Cur = m_Slots[Index];
+		if (Cur.State == SlotState::Empty)
+		{
+			++m_Used;
+		}
+
+		Cur.Key = t_Key;
+		Cur.Value = t_Value;
+		Cur.State = SlotState::Full;
+		++m_Count;
+	}
+
+	template<typename K, typename V>
+	inline void ConcurrentHashMap<K, V>::ReserveOne()
+	{
+		// Keep the load factor (including tombstones) under 70%
+		if ((m_Used + 1) * 10 <= m_Slots.size() * 7)
+		{
+			return;
+		}
+
+		// Only grow if the live entries need it, otherwise this just clears out the tombstones
+		size_t NewCapacity = m_Slots.size();
+		if ((m_Count + 1) * 10 > NewCapacity * 5)
+		{
+			NewCapacity <<= 1;
+		}
+
+		std::vector<Slot> OldSlots(NewCapacity);
+		OldSlots.swap(m_Slots);
+		m_Count = 0;
+		m_Used = 0;
+
+		for (const Slot& Cur : OldSlots)
+		{
+			if (Cur.State == SlotState::Full)
+			{
+				InsertNew(Cur.Key, Cur.Value);
+			}
+		}
+	}
+}   // namespace Fling
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "Singleton.hpp"
+#include "FlingTypes.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Zones are compiled out entirely unless the profiler is enabled, see WITH_PROFILER_FLAG
+#ifndef WITH_PROFILER
+	#define WITH_PROFILER 0
+#endif
+
+#define FLING_PROFILE_CONCAT_INNER(a, b) a##b
+#define FLING_PROFILE_CONCAT(a, b) FLING_PROFILE_CONCAT_INNER(a, b)
+
+#if WITH_PROFILER
+
+	/** Time the rest of the current scope. t_Name has to be a string literal, only the pointer is stored */
+	#define FLING_PROFILE_SCOPE(t_Name) Fling::ProfileScope FLING_PROFILE_CONCAT(ProfileScope_, __LINE__) { t_Name }
+
+	/** Mark the start of a new frame for the flame graph. Call once per frame on the main thread */
+	#define FLING_PROFILE_FRAME() Fling::Profiler::Get().NewFrame()
+
+	/** Name the calling thread in traces */
+	#define FLING_PROFILE_THREAD(t_Name) Fling::Profiler::Get().SetThreadName(t_Name)
+
+#else
+
+	#define FLING_PROFILE_SCOPE(t_Name)
+	#define FLING_PROFILE_FRAME()
+	#define FLING_PROFILE_THREAD(t_Name)
+
+#endif
+
+namespace Fling
+{
+	/** A finished zone. Times are in nanoseconds from Profiler::Now */
+	struct ProfileEvent
+	{
+		const char* Name = nullptr;
+		uint64 Start = 0;
+		uint64 End = 0;
+
+		/** How many zones this one is inside of */
+		uint32 Depth = 0;
+	};
+
+	/** Events from one thread */
+	struct ProfileThreadEvents
+	{
+		std::string ThreadName;
+		std::vector<ProfileEvent> Events;
+	};
+
+	/**
+	 * @brief 	Records scoped zones from any thread. Every thread writes to its own ring of events
+	 *			without any locks, and the newest events overwrite the oldest ones. Events can be
+	 *			exported as a Chrome Trace (chrome://tracing or ui.perfetto.dev) or read back a
+	 *			frame at a time for the editor's flame graph.
+	 *
+	 * @see FLING_PROFILE_SCOPE
+	 */
+	class Profiler : public Singleton<Profiler>
+	{
+	public:
+
+		/** Events kept per thread. Must be a power of 2 */
+		static const uint32 EVENTS_PER_THREAD = 32768;
+
+		/** @return Nanoseconds on a steady clock */
+		static uint64 Now();
+
+		virtual void Shutdown() override;
+
+		/** Zones that start while disabled are not recorded */
+		void SetEnabled(bool t_Enabled) { m_IsEnabled.store(t_Enabled, std::memory_order_relaxed); }
+
+		bool IsEnabled() const { return m_IsEnabled.load(std::memory_order_relaxed); }
+
+		/** Start a new frame. The frame that just ended is what GetLastFrame returns */
+		void NewFrame();
+
+		void SetThreadName(const std::string& t_Name);
+
+		/** Called by ProfileScope when it starts. @return The depth of the new zone */
+		uint32 BeginZone();
+
+		/** Called by ProfileScope when it ends */
+		void EndZone(const char* t_Name, uint64 t_Start, uint32 t_Depth);
+
+		/**
+		 * @brief	Get every zone that ran entirely inside of the last full frame
+		 * @param t_OutThreads 	One entry for every thread that has recorded something
+		 * @param t_OutFrameStart 	Start of the frame
+		 * @param t_OutFrameEnd 	End of the frame
+		 */
+		void GetLastFrame(std::vector<ProfileThreadEvents>& t_OutThreads, uint64& t_OutFrameStart, uint64& t_OutFrameEnd) const;
+
+		/**
+		 * @brief	Write every event that is still buffered as a Chrome Trace JSON file
+		 * @return True if the file was written
+		 */
+		bool WriteChromeTrace(const std::string& t_FilePath) const;
+
+	private:
+
+		static_assert((EVENTS_PER_THREAD & (EVENTS_PER_THREAD - 1)) == 0, "EVENTS_PER_THREAD must be a power of 2!");
+
+		struct ThreadBuffer
+		{
+			std::string Name;
+
+			uint32 Id = 0;
+
+			std::unique_ptr<ProfileEvent[]> Events { new ProfileEvent[EVENTS_PER_THREAD] };
+
+			/** Total events ever written. Only the owning thread writes it */
+			std::atomic<uint64> Head { 0 };
+
+			/** Depth of the next zone that starts on this thread */
+			uint32 Depth = 0;
+		};
+
+		/** Get the buffer of the calling thread, and create it the first time */
+		ThreadBuffer& GetThreadBuffer();
+
+		/**
+		 * @brief	Copy the events of another thread that ended in [t_Start, t_End). The owner can be writing
+		 *			at the same time, so anything that may have been overwritten during the copy is dropped
+		 */
+		static void CopyEvents(const ThreadBuffer& t_Buffer, uint64 t_Start, uint64 t_End, std::vector<ProfileEvent>& t_Out);
+
+		std::atomic<bool> m_IsEnabled { true };
+
+		/** Only locked when a thread records its first event or when reading events back */
+		mutable std::mutex m_ThreadsMutex;
+
+		std::vector<std::unique_ptr<ThreadBuffer>> m_Threads;
+
+		std::atomic<uint64> m_FrameStart { 0 };
+
+		std::atomic<uint64> m_LastFrameStart { 0 };
+	};
+
+	/** Records a zone from construction to destruction. Use FLING_PROFILE_SCOPE instead of this directly */
+	class ProfileScope
+	{
+	public:
+
+		explicit ProfileScope(const char* t_Name)
+			: m_Name(t_Name)
+		{
+			Profiler& Prof = Profiler::Get();
+			if (Prof.IsEnabled())
+			{
+				m_Depth = Prof.BeginZone();
+				m_Start = Profiler::Now();
+			}
+		}
+
+		~ProfileScope()
+		{
+			if (m_Start)
+			{
+				Profiler::Get().EndZone(m_Name, m_Start, m_Depth);
+			}
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+
+		const char* m_Name;
+
+		uint64 m_Start = 0;
+
+		uint32 m_Depth = 0;
+	};
+}   // namespace Fling
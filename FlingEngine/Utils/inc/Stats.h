@@ -1,6 +1,10 @@
 #pragma once
 
 #include "MovingAverage.hpp"
+#include "FlingTypes.h"
+
+#include <string>
+#include <vector>
 
 namespace Fling
 {
@@ -22,5 +26,105 @@ namespace Fling
 
             static MovingAverage<float, 100> FPSCounter;
         };
+
+        /** What was recorded in a frame. Compare the bind counts to DrawCalls to see how well draws are sorted */
+        struct DrawCounts
+        {
+            uint32 DrawCalls = 0;
+
+            uint32 Instances = 0;
+
+            uint32 PipelineBinds = 0;
+
+            uint32 DescriptorSetBinds = 0;
+
+            uint32 VertexBufferBinds = 0;
+
+            uint32 IndexBufferBinds = 0;
+
+            /** Meshes that passed culling and were added to the draw list */
+            uint32 MeshesSubmitted = 0;
+
+            uint32 MeshesCulled = 0;
+
+            /** Meshes inside of the frustum that were hidden behind occluders */
+            uint32 MeshesOccluded = 0;
+
+            DrawCounts& operator+=(const DrawCounts& t_Other)
+            {
+                DrawCalls += t_Other.DrawCalls;
+                Instances += t_Other.Instances;
+                PipelineBinds += t_Other.PipelineBinds;
+                DescriptorSetBinds += t_Other.DescriptorSetBinds;
+                VertexBufferBinds += t_Other.VertexBufferBinds;
+                IndexBufferBinds += t_Other.IndexBufferBinds;
+                MeshesSubmitted += t_Other.MeshesSubmitted;
+                MeshesCulled += t_Other.MeshesCulled;
+                MeshesOccluded += t_Other.MeshesOccluded;
+                return *this;
+            }
+        };
+
+        /** Draw counts of the render thread. Passes add to the current frame while they record */
+        struct Draws
+        {
+        public:
+            static const DrawCounts& GetLastFrame();
+
+            static DrawCounts& GetCurrentFrame();
+
+            /** The current frame becomes the last frame */
+            static void NewFrame();
+
+        private:
+
+            static DrawCounts CurrentFrame;
+
+            static DrawCounts LastFrame;
+        };
+
+        /** GPU cost of one render pass in a frame */
+        struct GpuPass
+        {
+            std::string Name;
+
+            /** Time between the start and end of the pass on the GPU, in milliseconds */
+            float TimeMs = 0.0f;
+
+            /** Zero if the device does not support pipeline statistics queries */
+            uint64 VertexInvocations = 0;
+
+            uint64 FragmentInvocations = 0;
+        };
+
+        /**
+        * GPU timings of the newest frame that has finished rendering. This lags behind the CPU
+        * by however many frames are in flight. @see GpuProfiler
+        */
+        struct Gpu
+        {
+        public:
+            static const std::vector<GpuPass>& GetPasses();
+
+            /** Sum of the pass times of the last frame */
+            static float GetFrameTimeMs();
+
+            static float GetAverageFrameTimeMs();
+
+            /** Frame number of the CPU frame that the current results were recorded in */
+            static uint64 GetFrameNumber();
+
+            static void SetFrame(uint64 t_FrameNumber, std::vector<GpuPass>& t_Passes);
+
+        private:
+
+            static std::vector<GpuPass> Passes;
+
+            static uint64 FrameNumber;
+
+            static float FrameTimeMs;
+
+            static MovingAverage<float, 128> FrameTimeCounter;
+        };
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <vector>
+
+#include "FlingTypes.h"
+#include "FlingExports.h"
+#include "Platform.h"
+
+namespace Fling
+{
+    /**
+     * @brief   Two-Level Segregated Fit allocator that manages offsets inside of a range [0, Size).
+     *          It never touches the memory that it is managing, so it can be used to sub-allocate
+     *          anything that is addressed by an offset, like a VkDeviceMemory block.
+     *          Allocation and free are O(1), and neighbouring free regions are always merged.
+     *
+     * @see     http://www.gii.upv.es/tlsf/files/papers/ecrts04_tlsf.pdf
+     */
+    class FLING_API TlsfAllocator
+    {
+    public:
+
+        static constexpr uint64 INVALID_OFFSET = ~0ull;
+
+        static constexpr uint32 INVALID_NODE = ~0u;
+
+        /** A single allocation out of this allocator. Keep the node to free it again */
+        struct Allocation
+        {
+            uint64 Offset = INVALID_OFFSET;
+            uint32 Node = INVALID_NODE;
+
+            bool IsValid() const { return Node != INVALID_NODE; }
+        };
+
+        /**
+         * @param t_Size    Size of the range that this allocator manages
+         */
+        explicit TlsfAllocator(uint64 t_Size);
+
+        ~TlsfAllocator() = default;
+
+        /**
+         * @brief   Find a free region for the given size and alignment
+         *
+         * @param t_Size        Size of the allocation
+         * @param t_Alignment   Alignment of the offset, must be a power of 2 (Default = 1)
+         *
+         * @return  The allocation. Not valid if there is no free region large enough
+         */
+        Allocation Allocate(uint64 t_Size, uint64 t_Alignment = 1);
+
+        /**
+         * @brief   Return an allocation to the allocator, merging it with any free neighbours
+         */
+        void Free(const Allocation& t_Alloc);
+
+        /** Size of the given allocation (could be slightly larger then what was requested) */
+        uint64 GetAllocationSize(const Allocation& t_Alloc) const;
+
+        FORCEINLINE uint64 GetSize() const { return m_Size; }
+
+        FORCEINLINE uint64 GetFreeBytes() const { return m_FreeBytes; }
+
+        FORCEINLINE uint64 GetUsedBytes() const { return m_Size - m_FreeBytes; }
+
+        FORCEINLINE uint32 GetAllocationCount() const { return m_AllocationCount; }
+
+        FORCEINLINE uint32 GetFreeRegionCount() const { return m_FreeRegionCount; }
+
+        FORCEINLINE bool IsEmpty() const { return m_AllocationCount == 0; }
+
+        /** Size of the largest free region, this is the biggest allocation that could succeed */
+        uint64 GetLargestFreeRegion() const;
+
+    private:
+
+        /** Number of second level bins per first level is 2^SL_INDEX_COUNT_LOG2 */
+        static constexpr uint32 SL_INDEX_COUNT_LOG2 = 4;
+        static constexpr uint32 SL_INDEX_COUNT = 1 << SL_INDEX_COUNT_LOG2;
+
+        /** Sizes below this are stored linearly in first level 0 */
+        static constexpr uint64 SMALL_BLOCK_SIZE = 1ull << SL_INDEX_COUNT_LOG2;
+
+        /** Enough first level bins for any 64 bit size */
+        static constexpr uint32 FL_INDEX_COUNT = 64 - SL_INDEX_COUNT_LOG2 + 1;
+
+        /** A region of the range, either free or allocated */
+        struct Node
+        {
+            uint64 Offset = 0;
+            uint64 Size = 0;
+
+            /** Neighbours by offset */
+            uint32 PrevPhysical = INVALID_NODE;
+            uint32 NextPhysical = INVALID_NODE;
+
+            /** Neighbours in the free list of its bin, or the next unused node when not in use */
+            uint32 PrevFree = INVALID_NODE;
+            uint32 NextFree = INVALID_NODE;
+
+            bool IsFree = false;
+        };
+
+        static void MappingInsert(uint64 t_Size, uint32& t_OutFl, uint32& t_OutSl);
+
+        static void MappingSearch(uint64 t_Size, uint32& t_OutFl, uint32& t_OutSl);
+
+        /** Find a free node that is at least as big as the given bin. INVALID_NODE if there is none */
+        uint32 FindSuitableNode(uint32 t_Fl, uint32 t_Sl) const;
+
+        void InsertFreeNode(uint32 t_Node);
+
+        void RemoveFreeNode(uint32 t_Node);
+
+        uint32 CreateNode();
+
+        void DestroyNode(uint32 t_Node);
+
+        /** Split the end of the given node off into a new free node */
+        void SplitTail(uint32 t_Node, uint64 t_NewSize);
+
+        /** Node storage, indices are stable so allocations can refer to them */
+        std::vector<Node> m_Nodes;
+
+        /** Head of the list of unused nodes in m_Nodes */
+        uint32 m_UnusedNodes = INVALID_NODE;
+
+        /** Bit per first level that has any free nodes */
+        uint64 m_FlBitmap = 0;
+
+        /** Bit per second level that has any free nodes */
+        uint32 m_SlBitmap[FL_INDEX_COUNT] = {};
+
+        uint32 m_FreeHeads[FL_INDEX_COUNT][SL_INDEX_COUNT];
+
+        uint64 m_Size = 0;
+
+        uint64 m_FreeBytes = 0;
+
+        uint32 m_AllocationCount = 0;
+
+        uint32 m_FreeRegionCount = 0;
+    };
+}   // namespace Fling
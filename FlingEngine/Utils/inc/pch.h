@@ -41,6 +41,7 @@
 #include "FlingMath.h"
 #include "Timing.h"
 #include "Memory.h"
+#include "Profiler.h"
 
 #define FLING_DEFAULT_WINDOW_WIDTH		800
 #define FLING_DEFAULT_WINDOW_HEIGHT		600
\ No newline at end of file
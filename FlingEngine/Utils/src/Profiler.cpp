@@ -0,0 +1,207 @@
+#include "pch.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+namespace Fling
+{
+	namespace
+	{
+		/** The calling thread's buffer, owned by the profiler */
+		thread_local void* CurrentThreadBuffer = nullptr;
+
+		void WriteEscaped(std::ofstream& t_Out, const char* t_Str)
+		{
+			for (const char* c = t_Str; *c; ++c)
+			{
+				if (*c == '"' || *c == '\\')
+				{
+					t_Out << '\\';
+				}
+				t_Out << *c;
+			}
+		}
+	}
+
+	uint64 Profiler::Now()
+	{
+		return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	void Profiler::Shutdown()
+	{
+		// Buffers stay alive so that threads which are still running can keep writing to them
+		SetEnabled(false);
+	}
+
+	void Profiler::NewFrame()
+	{
+		m_LastFrameStart.store(m_FrameStart.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		m_FrameStart.store(Now(), std::memory_order_relaxed);
+	}
+
+	void Profiler::SetThreadName(const std::string& t_Name)
+	{
+		ThreadBuffer& Buffer = GetThreadBuffer();
+
+		std::lock_guard<std::mutex> Lock(m_ThreadsMutex);
+		Buffer.Name = t_Name;
+	}
+
+	Profiler::ThreadBuffer& Profiler::GetThreadBuffer()
+	{
+		if (CurrentThreadBuffer)
+		{
+			return *static_cast<ThreadBuffer*>(CurrentThreadBuffer);
+		}
+
+		std::lock_guard<std::mutex> Lock(m_ThreadsMutex);
+		std::unique_ptr<ThreadBuffer> NewBuffer = std::make_unique<ThreadBuffer>();
+		NewBuffer->Id = static_cast<uint32>(m_Threads.size());
+		NewBuffer->Name = "Thread " + std::to_string(NewBuffer->Id);
+
+		CurrentThreadBuffer = NewBuffer.get();
+		m_Threads.emplace_back(std::move(NewBuffer));
+		return *m_Threads.back();
+	}
+
+	uint32 Profiler::BeginZone()
+	{
+		return GetThreadBuffer().Depth++;
+	}
+
+	void Profiler::EndZone(const char* t_Name, uint64 t_Start, uint32 t_Depth)
+	{
+		const uint64 End = Now();
+
+		ThreadBuffer& Buffer = GetThreadBuffer();
+		Buffer.Depth = t_Depth;
+
+		const uint64 Head = Buffer.Head.load(std::memory_order_relaxed);
+		ProfileEvent& Event = Buffer.Events[Head & (EVENTS_PER_THREAD - 1)];
+		Event.Name = t_Name;
+		Event.Start = t_Start;
+		Event.End = End;
+		Event.Depth = t_Depth;
+
+		// Publish the event to readers
+		Buffer.Head.store(Head + 1, std::memory_order_release);
+	}
+
+	void Profiler::CopyEvents(const ThreadBuffer& t_Buffer, uint64 t_Start, uint64 t_End, std::vector<ProfileEvent>& t_Out)
+	{
+		const uint64 Head = t_Buffer.Head.load(std::memory_order_acquire);
+		const uint64 First = Head > EVENTS_PER_THREAD ? Head - EVENTS_PER_THREAD : 0;
+
+		// Events are written in the order that they end, so walk back from the newest one and
+		// stop at the first that ended before t_Start
+		std::vector<ProfileEvent> Copied;
+		uint64 Oldest = Head;
+		while (Oldest > First)
+		{
+			const ProfileEvent& Event = t_Buffer.Events[(Oldest - 1) & (EVENTS_PER_THREAD - 1)];
+			if (Event.End < t_Start)
+			{
+				break;
+			}
+			Copied.push_back(Event);
+			--Oldest;
+		}
+
+		// The owner may have lapped the oldest events while they were copied, and those could be torn
+		const uint64 NewHead = t_Buffer.Head.load(std::memory_order_acquire);
+		const uint64 FirstValid = NewHead > EVENTS_PER_THREAD ? std::max(Oldest, NewHead - EVENTS_PER_THREAD) : Oldest;
+		const size_t ValidCount = static_cast<size_t>(Head - std::min(FirstValid, Head));
+
+		for (size_t i = ValidCount; i > 0; --i)
+		{
+			const ProfileEvent& Event = Copied[i - 1];
+			if (Event.End < t_End)
+			{
+				t_Out.push_back(Event);
+			}
+		}
+	}
+
+	void Profiler::GetLastFrame(std::vector<ProfileThreadEvents>& t_OutThreads, uint64& t_OutFrameStart, uint64& t_OutFrameEnd) const
+	{
+		t_OutFrameStart = m_LastFrameStart.load(std::memory_order_relaxed);
+		t_OutFrameEnd = m_FrameStart.load(std::memory_order_relaxed);
+		t_OutThreads.clear();
+
+		if (t_OutFrameStart == 0 || t_OutFrameEnd <= t_OutFrameStart)
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> Lock(m_ThreadsMutex);
+		for (const std::unique_ptr<ThreadBuffer>& Buffer : m_Threads)
+		{
+			ProfileThreadEvents Thread;
+			CopyEvents(*Buffer, t_OutFrameStart, t_OutFrameEnd, Thread.Events);
+
+			// Only zones that started in this frame too
+			Thread.Events.erase(std::remove_if(Thread.Events.begin(), Thread.Events.end(),
+				[t_OutFrameStart](const ProfileEvent& t_Event) { return t_Event.Start < t_OutFrameStart; }), Thread.Events.end());
+
+			if (!Thread.Events.empty())
+			{
+				Thread.ThreadName = Buffer->Name;
+				t_OutThreads.emplace_back(std::move(Thread));
+			}
+		}
+	}
+
+	bool Profiler::WriteChromeTrace(const std::string& t_FilePath) const
+	{
+		std::ofstream Out(t_FilePath);
+		if (!Out.is_open())
+		{
+			F_LOG_ERROR("Failed to open {} to write a trace to", t_FilePath);
+			return false;
+		}
+
+		std::vector<ProfileEvent> Events;
+		uint64 EventCount = 0;
+		bool IsFirst = true;
+
+		Out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+		std::lock_guard<std::mutex> Lock(m_ThreadsMutex);
+		for (const std::unique_ptr<ThreadBuffer>& Buffer : m_Threads)
+		{
+			if (!IsFirst)
+			{
+				Out << ",";
+			}
+			IsFirst = false;
+
+			Out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << Buffer->Id << ",\"args\":{\"name\":\"";
+			WriteEscaped(Out, Buffer->Name.c_str());
+			Out << "\"}}";
+
+			Events.clear();
+			CopyEvents(*Buffer, 0, ~0ull, Events);
+
+			// Complete events with microsecond timestamps
+			for (const ProfileEvent& Event : Events)
+			{
+				Out << ",\n{\"name\":\"";
+				WriteEscaped(Out, Event.Name);
+				Out << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << Buffer->Id
+					<< ",\"ts\":" << (Event.Start / 1000) << "." << (Event.Start % 1000) / 100
+					<< ",\"dur\":" << ((Event.End - Event.Start) / 1000) << "." << ((Event.End - Event.Start) % 1000) / 100
+					<< "}";
+			}
+			EventCount += Events.size();
+		}
+
+		Out << "\n]}\n";
+
+		F_LOG_TRACE("Wrote {} profiler events to {}", EventCount, t_FilePath);
+		return true;
+	}
+}   // namespace Fling
@@ -21,5 +21,63 @@ namespace Fling
         {
             FPSCounter.Push(t_DeltaTime);
         }
+
+        DrawCounts Draws::CurrentFrame = {};
+        DrawCounts Draws::LastFrame = {};
+
+        const DrawCounts& Draws::GetLastFrame()
+        {
+            return LastFrame;
+        }
+
+        DrawCounts& Draws::GetCurrentFrame()
+        {
+            return CurrentFrame;
+        }
+
+        void Draws::NewFrame()
+        {
+            LastFrame = CurrentFrame;
+            CurrentFrame = {};
+        }
+
+        std::vector<GpuPass> Gpu::Passes = {};
+        uint64 Gpu::FrameNumber = 0;
+        float Gpu::FrameTimeMs = 0.0f;
+        MovingAverage<float, 128> Gpu::FrameTimeCounter = {};
+
+        const std::vector<GpuPass>& Gpu::GetPasses()
+        {
+            return Passes;
+        }
+
+        float Gpu::GetFrameTimeMs()
+        {
+            return FrameTimeMs;
+        }
+
+        float Gpu::GetAverageFrameTimeMs()
+        {
+            return FrameTimeCounter.GetAverage();
+        }
+
+        uint64 Gpu::GetFrameNumber()
+        {
+            return FrameNumber;
+        }
+
+        void Gpu::SetFrame(uint64 t_FrameNumber, std::vector<GpuPass>& t_Passes)
+        {
+            // Swap so that the caller can reuse the old vector's memory
+            Passes.swap(t_Passes);
+            FrameNumber = t_FrameNumber;
+
+            FrameTimeMs = 0.0f;
+            for (const GpuPass& Pass : Passes)
+            {
+                FrameTimeMs += Pass.TimeMs;
+            }
+            FrameTimeCounter.Push(FrameTimeMs);
+        }
     }
-}
\ No newline at end of file
+}
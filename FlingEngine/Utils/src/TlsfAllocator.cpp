@@ -0,0 +1,384 @@
+#include "pch.h"
+#include "TlsfAllocator.h"
+
+#if FLING_WINDOWS
+#include <intrin.h>
+#endif
+
+namespace
+{
+    /** Index of the highest set bit. t_Val must not be 0 */
+    inline uint32 FindLastSet(uint64 t_Val)
+    {
+        assert(t_Val != 0);
+#if FLING_WINDOWS
+        unsigned long Index = 0;
+        _BitScanReverse64(&Index, t_Val);
+        return static_cast<uint32>(Index);
+#else
+        return 63u - static_cast<uint32>(__builtin_clzll(t_Val));
+#endif
+    }
+
+    /** Index of the lowest set bit. t_Val must not be 0 */
+    inline uint32 FindFirstSet(uint64 t_Val)
+    {
+        assert(t_Val != 0);
+#if FLING_WINDOWS
+        unsigned long Index = 0;
+        _BitScanForward64(&Index, t_Val);
+        return static_cast<uint32>(Index);
+#else
+        return static_cast<uint32>(__builtin_ctzll(t_Val));
+#endif
+    }
+
+    inline uint64 AlignUp(uint64 t_Val, uint64 t_Align)
+    {
+        return (t_Val + t_Align - 1) & ~(t_Align - 1);
+    }
+}
+
+namespace Fling
+{
+    TlsfAllocator::TlsfAllocator(uint64 t_Size)
+        : m_Size(t_Size)
+        , m_FreeBytes(t_Size)
+    {
+        for (uint32 fl = 0; fl < FL_INDEX_COUNT; ++fl)
+        {
+            for (uint32 sl = 0; sl < SL_INDEX_COUNT; ++sl)
+            {
+                m_FreeHeads[fl][sl] = INVALID_NODE;
+            }
+        }
+
+        if (m_Size > 0)
+        {
+            // The whole range starts out as one free region
+            uint32 Root = CreateNode();
+            m_Nodes[Root].Offset = 0;
+            m_Nodes[Root].Size = m_Size;
+            InsertFreeNode(Root);
+        }
+    }
+
+    TlsfAllocator::Allocation TlsfAllocator::Allocate(uint64 t_Size, uint64 t_Alignment)
+    {
+        if (t_Size == 0 || t_Size > m_FreeBytes)
+        {
+            return {};
+        }
+
+        if (t_Alignment == 0)
+        {
+            t_Alignment = 1;
+        }
+        assert((t_Alignment & (t_Alignment - 1)) == 0);
+
+        uint32 Fl = 0;
+        uint32 Sl = 0;
+        MappingSearch(t_Size, Fl, Sl);
+        uint32 Found = FindSuitableNode(Fl, Sl);
+
+        // The node is big enough for the size but the alignment could push the end out of it
+        if (Found != INVALID_NODE && t_Alignment > 1)
+        {
+            const Node& Candidate = m_Nodes[Found];
+            if (AlignUp(Candidate.Offset, t_Alignment) + t_Size > Candidate.Offset + Candidate.Size)
+            {
+                Found = INVALID_NODE;
+            }
+        }
+
+        // Search again for a region that is guaranteed to fit any alignment padding
+        if (Found == INVALID_NODE && t_Alignment > 1)
+        {
+            MappingSearch(t_Size + t_Alignment - 1, Fl, Sl);
+            Found = FindSuitableNode(Fl, Sl);
+        }
+
+        if (Found == INVALID_NODE)
+        {
+            return {};
+        }
+
+        RemoveFreeNode(Found);
+
+        const uint64 Offset = m_Nodes[Found].Offset;
+        const uint64 Padding = AlignUp(Offset, t_Alignment) - Offset;
+
+        // Give any padding at the front back as its own free region
+        if (Padding > 0)
+        {
+            uint32 Front = CreateNode();
+            Node& FrontNode = m_Nodes[Front];
+            Node& FoundNode = m_Nodes[Found];
+
+            FrontNode.Offset = FoundNode.Offset;
+            FrontNode.Size = Padding;
+            FrontNode.PrevPhysical = FoundNode.PrevPhysical;
+            FrontNode.NextPhysical = Found;
+
+            if (FoundNode.PrevPhysical != INVALID_NODE)
+            {
+                m_Nodes[FoundNode.PrevPhysical].NextPhysical = Front;
+            }
+
+            FoundNode.PrevPhysical = Front;
+            FoundNode.Offset += Padding;
+            FoundNode.Size -= Padding;
+
+            InsertFreeNode(Front);
+        }
+
+        SplitTail(Found, t_Size);
+
+        m_FreeBytes -= m_Nodes[Found].Size;
+        ++m_AllocationCount;
+
+        Allocation Alloc = {};
+        Alloc.Offset = m_Nodes[Found].Offset;
+        Alloc.Node = Found;
+        return Alloc;
+    }
+
+    void TlsfAllocator::Free(const Allocation& t_Alloc)
+    {
+        assert(t_Alloc.IsValid() && t_Alloc.Node < m_Nodes.size());
+        assert(!m_Nodes[t_Alloc.Node].IsFree);
+
+        uint32 Current = t_Alloc.Node;
+        m_FreeBytes += m_Nodes[Current].Size;
+        --m_AllocationCount;
+
+        // Merge with the previous region
+        uint32 Prev = m_Nodes[Current].PrevPhysical;
+        if (Prev != INVALID_NODE && m_Nodes[Prev].IsFree)
+        {
+            RemoveFreeNode(Prev);
+
+            m_Nodes[Prev].Size += m_Nodes[Current].Size;
+            m_Nodes[Prev].NextPhysical = m_Nodes[Current].NextPhysical;
+            if (m_Nodes[Current].NextPhysical != INVALID_NODE)
+            {
+                m_Nodes[m_Nodes[Current].NextPhysical].PrevPhysical = Prev;
+            }
+
+            DestroyNode(Current);
+            Current = Prev;
+        }
+
+        // Merge with the next region
+        uint32 Next = m_Nodes[Current].NextPhysical;
+        if (Next != INVALID_NODE && m_Nodes[Next].IsFree)
+        {
+            RemoveFreeNode(Next);
+
+            m_Nodes[Current].Size += m_Nodes[Next].Size;
+            m_Nodes[Current].NextPhysical = m_Nodes[Next].NextPhysical;
+            if (m_Nodes[Next].NextPhysical != INVALID_NODE)
+            {
+                m_Nodes[m_Nodes[Next].NextPhysical].PrevPhysical = Current;
+            }
+
+            DestroyNode(Next);
+        }
+
+        InsertFreeNode(Current);
+    }
+
+    uint64 TlsfAllocator::GetAllocationSize(const Allocation& t_Alloc) const
+    {
+        assert(t_Alloc.IsValid() && t_Alloc.Node < m_Nodes.size());
+        return m_Nodes[t_Alloc.Node].Size;
+    }
+
+    uint64 TlsfAllocator::GetLargestFreeRegion() const
+    {
+        if (m_FlBitmap == 0)
+        {
+            return 0;
+        }
+
+        // Everything in the highest non-empty bin is bigger than every other bin
+        const uint32 Fl = FindLastSet(m_FlBitmap);
+        const uint32 Sl = FindLastSet(m_SlBitmap[Fl]);
+
+        uint64 Largest = 0;
+        for (uint32 Cur = m_FreeHeads[Fl][Sl]; Cur != INVALID_NODE; Cur = m_Nodes[Cur].NextFree)
+        {
+            Largest = std::max(Largest, m_Nodes[Cur].Size);
+        }
+        return Largest;
+    }
+
+    void TlsfAllocator::MappingInsert(uint64 t_Size, uint32& t_OutFl, uint32& t_OutSl)
+    {
+        if (t_Size < SMALL_BLOCK_SIZE)
+        {
+            // Small sizes are stored linearly in the first bin
+            t_OutFl = 0;
+            t_OutSl = static_cast<uint32>(t_Size);
+        }
+        else
+        {
+            const uint32 Fls = FindLastSet(t_Size);
+            t_OutSl = static_cast<uint32>(t_Size >> (Fls - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+            t_OutFl = Fls - (SL_INDEX_COUNT_LOG2 - 1);
+        }
+    }
+
+    void TlsfAllocator::MappingSearch(uint64 t_Size, uint32& t_OutFl, uint32& t_OutSl)
+    {
+        // Round up to the next bin so that any node in it is big enough
+        if (t_Size >= SMALL_BLOCK_SIZE)
+        {
+            const uint64 Round = (1ull << (FindLastSet(t_Size) - SL_INDEX_COUNT_LOG2)) - 1;
+            t_Size += Round;
+        }
+        MappingInsert(t_Size, t_OutFl, t_OutSl);
+    }
+
+    uint32 TlsfAllocator::FindSuitableNode(uint32 t_Fl, uint32 t_Sl) const
+    {
+        if (t_Fl >= FL_INDEX_COUNT)
+        {
+            return INVALID_NODE;
+        }
+
+        // Any bins in this first level that are big enough?
+        uint32 SlMap = m_SlBitmap[t_Fl] & (~0u << t_Sl);
+        if (SlMap == 0)
+        {
+            // Otherwise use the next first level that has anything in it
+            const uint64 FlMap = m_FlBitmap & (~0ull << (t_Fl + 1));
+            if (FlMap == 0)
+            {
+                return INVALID_NODE;
+            }
+
+            t_Fl = FindFirstSet(FlMap);
+            SlMap = m_SlBitmap[t_Fl];
+        }
+
+        t_Sl = FindFirstSet(SlMap);
+        return m_FreeHeads[t_Fl][t_Sl];
+    }
+
+    void TlsfAllocator::InsertFreeNode(uint32 t_Node)
+    {
+        Node& N = m_Nodes[t_Node];
+
+        uint32 Fl = 0;
+        uint32 Sl = 0;
+        MappingInsert(N.Size, Fl, Sl);
+
+        N.IsFree = true;
+        N.PrevFree = INVALID_NODE;
+        N.NextFree = m_FreeHeads[Fl][Sl];
+
+        if (N.NextFree != INVALID_NODE)
+        {
+            m_Nodes[N.NextFree].PrevFree = t_Node;
+        }
+
+        m_FreeHeads[Fl][Sl] = t_Node;
+        m_FlBitmap |= (1ull << Fl);
+        m_SlBitmap[Fl] |= (1u << Sl);
+
+        ++m_FreeRegionCount;
+    }
+
+    void TlsfAllocator::RemoveFreeNode(uint32 t_Node)
+    {
+        Node& N = m_Nodes[t_Node];
+        assert(N.IsFree);
+
+        uint32 Fl = 0;
+        uint32 Sl = 0;
+        MappingInsert(N.Size, Fl, Sl);
+
+        if (N.PrevFree != INVALID_NODE)
+        {
+            m_Nodes[N.PrevFree].NextFree = N.NextFree;
+        }
+        if (N.NextFree != INVALID_NODE)
+        {
+            m_Nodes[N.NextFree].PrevFree = N.PrevFree;
+        }
+
+        if (m_FreeHeads[Fl][Sl] == t_Node)
+        {
+            m_FreeHeads[Fl][Sl] = N.NextFree;
+
+            // Clear the bitmaps if this bin is empty now
+            if (N.NextFree == INVALID_NODE)
+            {
+                m_SlBitmap[Fl] &= ~(1u << Sl);
+                if (m_SlBitmap[Fl] == 0)
+                {
+                    m_FlBitmap &= ~(1ull << Fl);
+                }
+            }
+        }
+
+        N.IsFree = false;
+        N.PrevFree = INVALID_NODE;
+        N.NextFree = INVALID_NODE;
+
+        --m_FreeRegionCount;
+    }
+
+    uint32 TlsfAllocator::CreateNode()
+    {
+        if (m_UnusedNodes != INVALID_NODE)
+        {
+            uint32 Index = m_UnusedNodes;
+            m_UnusedNodes = m_Nodes[Index].NextFree;
+            m_Nodes[Index] = {};
+            return Index;
+        }
+
+        m_Nodes.emplace_back();
+        return static_cast<uint32>(m_Nodes.size() - 1);
+    }
+
+    void TlsfAllocator::DestroyNode(uint32 t_Node)
+    {
+        m_Nodes[t_Node] = {};
+        m_Nodes[t_Node].NextFree = m_UnusedNodes;
+        m_UnusedNodes = t_Node;
+    }
+
+    void TlsfAllocator::SplitTail(uint32 t_Node, uint64 t_NewSize)
+    {
+        assert(m_Nodes[t_Node].Size >= t_NewSize);
+
+        const uint64 Remainder = m_Nodes[t_Node].Size - t_NewSize;
+        if (Remainder == 0)
+        {
+            return;
+        }
+
+        // Creating the node could grow the node vector, so don't hold any references before this
+        uint32 Tail = CreateNode();
+        Node& TailNode = m_Nodes[Tail];
+        Node& HeadNode = m_Nodes[t_Node];
+
+        TailNode.Offset = HeadNode.Offset + t_NewSize;
+        TailNode.Size = Remainder;
+        TailNode.PrevPhysical = t_Node;
+        TailNode.NextPhysical = HeadNode.NextPhysical;
+
+        if (HeadNode.NextPhysical != INVALID_NODE)
+        {
+            m_Nodes[HeadNode.NextPhysical].PrevPhysical = Tail;
+        }
+
+        HeadNode.NextPhysical = Tail;
+        HeadNode.Size = t_NewSize;
+
+        InsertFreeNode(Tail);
+    }
+}   // namespace Fling
@@ -9,6 +9,30 @@
 #include "pch.h"
 
 #include "Engine.h"
+#include "SystemScheduler.h"
+#include "FrustumCuller.h"
+#include "AABBTree.h"
+#include "OcclusionBuffer.h"
+#include "Components/Transform.h"
+#include "TransformBatch.h"
+#include "TransformHierarchy.h"
+#include "LightClusterGrid.h"
+#include "DrawBatchTable.h"
+#include "StaticMeshMerger.h"
+#include "Logger.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <string>
+
+namespace
+{
+    struct Position { float Value = 0.0f; };
+    struct Velocity { float Value = 1.0f; };
+    struct Health { int32 Value = 100; };
+}
 
 TEST_CASE("Smoke test", "[core]")
 {
@@ -29,4 +53,841 @@ TEST_CASE("Smoke test", "[core]")
         REQUIRE(true);
     }
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("System Scheduler", "[core]")
+{
+    using namespace Fling;
+
+    entt::registry Reg;
+    for (uint32 i = 0; i < 2000; ++i)
+    {
+        entt::entity Ent = Reg.create();
+        Reg.assign<Position>(Ent);
+        Reg.assign<Velocity>(Ent);
+        Reg.assign<Health>(Ent);
+    }
+
+    SystemScheduler Scheduler(Reg);
+
+    std::atomic<uint32> RunCount { 0 };
+    bool bReaderSawMovement = false;
+
+    Scheduler.AddSystem("Move", [&RunCount](entt::registry& t_Reg, float t_DeltaTime)
+    {
+        SystemScheduler::ParallelEach<Position, Velocity>(t_Reg, [t_DeltaTime](entt::entity t_Ent, Position& t_Pos, Velocity& t_Vel)
+        {
+            t_Pos.Value += t_Vel.Value * t_DeltaTime;
+        });
+        RunCount++;
+    })
+    .Reads<Velocity>()
+    .Writes<Position>();
+
+    // Doesn't touch anything that Move does, so it can run at the same time
+    Scheduler.AddSystem("Damage", [&RunCount](entt::registry& t_Reg, float t_DeltaTime)
+    {
+        t_Reg.view<Health>().each([](entt::entity t_Ent, Health& t_Health) { t_Health.Value -= 1; });
+        RunCount++;
+    })
+    .Writes<Health>();
+
+    // Reads what Move writes, so it has to wait for it
+    Scheduler.AddSystem("Check Positions", [&RunCount, &bReaderSawMovement](entt::registry& t_Reg, float t_DeltaTime)
+    {
+        bool bAllMoved = true;
+        t_Reg.view<Position>().each([&bAllMoved](entt::entity t_Ent, Position& t_Pos) { bAllMoved &= (t_Pos.Value > 0.0f); });
+        bReaderSawMovement = bAllMoved;
+        RunCount++;
+    })
+    .Reads<Position>();
+
+    SECTION("Conflicting systems run in order")
+    {
+        Scheduler.Run(1.0f, true);
+        REQUIRE(RunCount == 3);
+        REQUIRE(bReaderSawMovement);
+        REQUIRE(Scheduler.GetCriticalPathLength() == 2);
+    }
+
+    SECTION("Runs on the job system")
+    {
+        JobSystem::Get().Init(4);
+
+        for (uint32 Frame = 0; Frame < 10; ++Frame)
+        {
+            Scheduler.Run(1.0f, true);
+        }
+
+        JobSystem::Get().Shutdown();
+
+        REQUIRE(RunCount == 30);
+        REQUIRE(bReaderSawMovement);
+
+        bool bAllMoved = true;
+        Reg.view<Position>().each([&bAllMoved](entt::entity t_Ent, Position& t_Pos) { bAllMoved &= (t_Pos.Value == 10.0f); });
+        REQUIRE(bAllMoved);
+    }
+
+    SECTION("Only always run systems run while stopped")
+    {
+        Scheduler.AddSystem("Editor", [&RunCount](entt::registry& t_Reg, float t_DeltaTime) { RunCount += 10; })
+            .AlwaysRun();
+
+        Scheduler.Run(1.0f, false);
+        REQUIRE(RunCount == 10);
+    }
+
+    SECTION("Exclusive systems wait on everything")
+    {
+        Scheduler.AddSystem("Spawn", [](entt::registry& t_Reg, float t_DeltaTime) { t_Reg.create(); })
+            .Exclusive();
+
+        Scheduler.Run(1.0f, true);
+        REQUIRE(Scheduler.GetCriticalPathLength() == 3);
+    }
+}
+
+TEST_CASE("Frustum Culling", "[core]")
+{
+    using namespace Fling;
+
+    const glm::mat4 Proj = glm::perspective(glm::radians(45.0f), 1.6f, 0.1f, 100.0f);
+    const glm::mat4 View = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const Frustum CamFrustum = Frustum::FromViewProjection(Proj * View);
+
+    AABB UnitBox = {};
+    UnitBox.Min = glm::vec3(-0.5f);
+    UnitBox.Max = glm::vec3(0.5f);
+
+    SECTION("Boxes in front of the camera are visible")
+    {
+        REQUIRE(CamFrustum.Intersects(UnitBox));
+        REQUIRE_FALSE(CamFrustum.Intersects(UnitBox.Transform(glm::translate(glm::vec3(0.0f, 0.0f, 10.0f)))));
+        REQUIRE_FALSE(CamFrustum.Intersects(UnitBox.Transform(glm::translate(glm::vec3(0.0f, 0.0f, -200.0f)))));
+        REQUIRE_FALSE(CamFrustum.Intersects(UnitBox.Transform(glm::translate(glm::vec3(50.0f, 0.0f, 0.0f)))));
+    }
+
+    SECTION("Batched culling matches the single box test")
+    {
+        std::mt19937 Rng(42);
+        std::uniform_real_distribution<float> Position(-60.0f, 60.0f);
+        std::uniform_real_distribution<float> Angle(0.0f, 6.28f);
+
+        // Not a multiple of the batch size so that the padding is tested too
+        FrustumCuller Culler;
+        std::vector<uint32> Expected;
+        for (uint32 i = 0; i < 1003; ++i)
+        {
+            const glm::mat4 World = glm::translate(glm::vec3(Position(Rng), Position(Rng), Position(Rng))) * glm::rotate(Angle(Rng), glm::vec3(0.0f, 1.0f, 0.0f));
+            Culler.Add(UnitBox, World);
+            if (CamFrustum.Intersects(UnitBox.Transform(World)))
+            {
+                Expected.push_back(i);
+            }
+        }
+
+        std::vector<uint32> Visible(Culler.GetCount());
+        const uint32 VisibleCount = Culler.Cull(CamFrustum, Visible.data());
+        Visible.resize(VisibleCount);
+
+        REQUIRE(VisibleCount > 0);
+        REQUIRE(VisibleCount < Culler.GetCount());
+        REQUIRE(Visible == Expected);
+    }
+}
+
+TEST_CASE("AABB Tree", "[core]")
+{
+    using namespace Fling;
+
+    std::mt19937 Rng(7);
+    std::uniform_real_distribution<float> Position(-60.0f, 60.0f);
+    std::uniform_real_distribution<float> Size(0.1f, 3.0f);
+
+    auto RandomBox = [&]()
+    {
+        const glm::vec3 Center(Position(Rng), Position(Rng), Position(Rng));
+        const glm::vec3 Extents(Size(Rng), Size(Rng), Size(Rng));
+        AABB Box = {};
+        Box.Min = Center - Extents;
+        Box.Max = Center + Extents;
+        return Box;
+    };
+
+    auto Overlaps = [](const AABB& A, const AABB& B)
+    {
+        return glm::all(glm::lessThanEqual(A.Min, B.Max)) && glm::all(glm::greaterThanEqual(A.Max, B.Min));
+    };
+
+    AABBTree Tree(0.5f);
+    std::vector<AABB> Boxes;
+    std::vector<int32> Proxies;
+    for (uint32 i = 0; i < 1000; ++i)
+    {
+        Boxes.push_back(RandomBox());
+        Proxies.push_back(Tree.CreateProxy(Boxes.back(), i));
+    }
+
+    // Remove some, nudge most of the rest and teleport a few so that both refits and reinserts happen
+    std::vector<bool> Alive(Boxes.size(), true);
+    for (uint32 i = 0; i < Boxes.size(); ++i)
+    {
+        if (i % 10 == 0)
+        {
+            Tree.DestroyProxy(Proxies[i]);
+            Alive[i] = false;
+            continue;
+        }
+
+        const glm::vec3 Offset = (i % 7 == 0) ? glm::vec3(Position(Rng), 0.0f, 0.0f) : glm::vec3(0.1f, -0.1f, 0.05f);
+        Boxes[i].Min += Offset;
+        Boxes[i].Max += Offset;
+        Tree.MoveProxy(Proxies[i], Boxes[i]);
+    }
+
+    REQUIRE(Tree.Validate());
+    REQUIRE(Tree.GetProxyCount() == 900);
+
+    auto Sorted = [](std::vector<uint32> t_Vals)
+    {
+        std::sort(t_Vals.begin(), t_Vals.end());
+        return t_Vals;
+    };
+
+    SECTION("Frustum query matches testing every box")
+    {
+        const glm::mat4 Proj = glm::perspective(glm::radians(45.0f), 1.6f, 0.1f, 100.0f);
+        const glm::mat4 View = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const Frustum CamFrustum = Frustum::FromViewProjection(Proj * View);
+
+        std::vector<uint32> Expected;
+        for (uint32 i = 0; i < Boxes.size(); ++i)
+        {
+            if (Alive[i] && CamFrustum.Intersects(Boxes[i]))
+            {
+                Expected.push_back(i);
+            }
+        }
+
+        std::vector<uint32> Visible;
+        Tree.QueryFrustum(CamFrustum, Visible);
+
+        REQUIRE(!Expected.empty());
+        REQUIRE(Sorted(Visible) == Expected);
+    }
+
+    SECTION("Box and sphere queries match testing every box")
+    {
+        AABB Query = {};
+        Query.Min = glm::vec3(-20.0f);
+        Query.Max = glm::vec3(20.0f);
+
+        const glm::vec3 Center(10.0f, -5.0f, 0.0f);
+        const float Radius = 25.0f;
+
+        std::vector<uint32> ExpectedBox;
+        std::vector<uint32> ExpectedSphere;
+        for (uint32 i = 0; i < Boxes.size(); ++i)
+        {
+            if (!Alive[i])
+            {
+                continue;
+            }
+
+            if (Overlaps(Boxes[i], Query))
+            {
+                ExpectedBox.push_back(i);
+            }
+
+            const glm::vec3 Closest = glm::clamp(Center, Boxes[i].Min, Boxes[i].Max);
+            if (glm::distance(Closest, Center) <= Radius)
+            {
+                ExpectedSphere.push_back(i);
+            }
+        }
+
+        std::vector<uint32> InBox;
+        Tree.QueryAABB(Query, InBox);
+        REQUIRE(Sorted(InBox) == ExpectedBox);
+
+        std::vector<uint32> InSphere;
+        Tree.QuerySphere(Center, Radius, InSphere);
+        REQUIRE(Sorted(InSphere) == ExpectedSphere);
+    }
+
+    SECTION("Ray casts return the closest hit first")
+    {
+        AABBTree RayTree;
+        AABB Box = {};
+        Box.Min = glm::vec3(-1.0f);
+        Box.Max = glm::vec3(1.0f);
+
+        for (uint32 i = 0; i < 5; ++i)
+        {
+            const glm::vec3 Offset(0.0f, 0.0f, -10.0f * static_cast<float>(i + 1));
+            RayTree.CreateProxy(AABB { Box.Min + Offset, Box.Max + Offset }, 4 - i);
+        }
+
+        // Off to the side of the ray
+        RayTree.CreateProxy(AABB { Box.Min + glm::vec3(10.0f, 0.0f, 0.0f), Box.Max + glm::vec3(10.0f, 0.0f, 0.0f) }, 100);
+
+        std::vector<AABBTree::RayHit> Hits;
+        RayTree.RayCast(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -2.0f), 35.0f, Hits);
+
+        REQUIRE(Hits.size() == 3);
+        REQUIRE(Hits[0].UserData == 4);
+        REQUIRE(Hits[0].Distance == Catch::Approx(9.0f));
+        REQUIRE(Hits[1].UserData == 3);
+        REQUIRE(Hits[2].UserData == 2);
+    }
+}
+
+TEST_CASE("Occlusion Culling", "[core]")
+{
+    using namespace Fling;
+
+    const glm::mat4 Proj = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+    const glm::mat4 View = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // A 10x10 wall, 10 units in front of the camera
+    OccluderMesh Wall;
+    Wall.Positions = { { -5.0f, -5.0f, 0.0f }, { 5.0f, -5.0f, 0.0f }, { 5.0f, 5.0f, 0.0f }, { -5.0f, 5.0f, 0.0f } };
+    Wall.Indices = { 0, 1, 2, 0, 2, 3 };
+
+    OcclusionBuffer Buffer(512, 256);
+    Buffer.Begin(Proj * View);
+    Buffer.AddOccluder(Wall, glm::translate(glm::vec3(0.0f, 0.0f, -10.0f)));
+    Buffer.Rasterize();
+
+    REQUIRE(Buffer.GetTriangleCount() == 2);
+    REQUIRE(Buffer.GetDepth(Buffer.GetWidth() / 2, Buffer.GetHeight() / 2) < 1.0f);
+
+    auto BoxAt = [](const glm::vec3& t_Center)
+    {
+        AABB Box = {};
+        Box.Min = t_Center - glm::vec3(1.0f);
+        Box.Max = t_Center + glm::vec3(1.0f);
+        return Box;
+    };
+
+    SECTION("Boxes behind the wall are hidden")
+    {
+        REQUIRE_FALSE(Buffer.IsVisible(BoxAt(glm::vec3(0.0f, 0.0f, -20.0f))));
+        REQUIRE_FALSE(Buffer.IsVisible(BoxAt(glm::vec3(2.0f, -2.0f, -40.0f))));
+    }
+
+    SECTION("Boxes in front of or beside the wall are visible")
+    {
+        REQUIRE(Buffer.IsVisible(BoxAt(glm::vec3(0.0f, 0.0f, -5.0f))));
+        REQUIRE(Buffer.IsVisible(BoxAt(glm::vec3(18.0f, 0.0f, -20.0f))));
+
+        // Only partly behind the edge of the wall
+        REQUIRE(Buffer.IsVisible(BoxAt(glm::vec3(11.0f, 0.0f, -20.0f))));
+
+        // Crossing the near plane
+        REQUIRE(Buffer.IsVisible(BoxAt(glm::vec3(0.0f))));
+    }
+
+    SECTION("Nothing is hidden without occluders")
+    {
+        Buffer.Begin(Proj * View);
+        Buffer.Rasterize();
+        REQUIRE(Buffer.IsVisible(BoxAt(glm::vec3(0.0f, 0.0f, -20.0f))));
+    }
+}
+
+TEST_CASE("Transform Dirty Tracking", "[core]")
+{
+    Fling::Transform Trans = {};
+
+    SECTION("New transforms are dirty")
+    {
+        REQUIRE(Trans.IsDirty());
+
+        Fling::Transform::CalculateWorldMatrix(Trans);
+        REQUIRE_FALSE(Trans.IsDirty());
+    }
+
+    SECTION("Setters mark the transform dirty")
+    {
+        Fling::Transform::CalculateWorldMatrix(Trans);
+        Trans.SetPos(glm::vec3(1.0f, 2.0f, 3.0f));
+        REQUIRE(Trans.IsDirty());
+
+        Fling::Transform::CalculateWorldMatrix(Trans);
+        REQUIRE(Trans.GetWorldMat()[3][0] == Catch::Approx(1.0f));
+        REQUIRE(Trans.GetWorldMat()[3][2] == Catch::Approx(3.0f));
+
+        Trans.SetScale(glm::vec3(2.0f));
+        REQUIRE(Trans.IsDirty());
+
+        Fling::Transform::CalculateWorldMatrix(Trans);
+        Trans.SetRotation(glm::vec3(0.0f, 90.0f, 0.0f));
+        REQUIRE(Trans.IsDirty());
+    }
+
+    SECTION("Edits in place have to be marked")
+    {
+        Fling::Transform::CalculateWorldMatrix(Trans);
+        Trans.m_Pos.x = 5.0f;
+        REQUIRE_FALSE(Trans.IsDirty());
+
+        Trans.MarkDirty();
+        REQUIRE(Trans.IsDirty());
+    }
+}
+
+namespace
+{
+    std::vector<Fling::Transform> MakeRandomTransforms(uint32 t_Count)
+    {
+        std::mt19937 Rng(1337);
+        std::uniform_real_distribution<float> PosDist(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> RotDist(-180.0f, 180.0f);
+        std::uniform_real_distribution<float> ScaleDist(0.5f, 2.0f);
+
+        std::vector<Fling::Transform> Transforms(t_Count);
+        for (Fling::Transform& Trans : Transforms)
+        {
+            Trans.SetPos(glm::vec3(PosDist(Rng), PosDist(Rng), PosDist(Rng)));
+            Trans.SetRotation(glm::vec3(RotDist(Rng), RotDist(Rng), RotDist(Rng)));
+            Trans.SetScale(glm::vec3(ScaleDist(Rng), ScaleDist(Rng), ScaleDist(Rng)));
+        }
+        return Transforms;
+    }
+}
+
+TEST_CASE("Transform Batch", "[core]")
+{
+    using namespace Fling;
+
+    // Not a multiple of the batch width so that a partial batch is flushed
+    std::vector<Transform> Transforms = MakeRandomTransforms(TransformBatch::WIDTH * 12 + 3);
+
+    SECTION("Matches the euler angle matrices")
+    {
+        Transform::CalculateWorldMatrices(Transforms.data(), static_cast<uint32>(Transforms.size()));
+
+        float MaxError = 0.0f;
+        for (const Transform& Trans : Transforms)
+        {
+            REQUIRE_FALSE(Trans.IsDirty());
+            REQUIRE(Trans.HasWorldChanged());
+
+            const glm::mat4 Expected = Trans.GetWorldMatrix();
+            for (int Col = 0; Col < 4; ++Col)
+            {
+                for (int Row = 0; Row < 4; ++Row)
+                {
+                    MaxError = std::max(MaxError, std::abs(Trans.GetWorldMat()[Col][Row] - Expected[Col][Row]));
+                }
+            }
+        }
+        REQUIRE(MaxError < 1e-4f);
+    }
+
+    SECTION("Only dirty transforms are updated")
+    {
+        Transform::CalculateWorldMatrices(Transforms.data(), static_cast<uint32>(Transforms.size()));
+
+        Transforms[5].SetPos(glm::vec3(1.0f, 2.0f, 3.0f));
+        Transform::CalculateWorldMatrices(Transforms.data(), static_cast<uint32>(Transforms.size()));
+
+        REQUIRE(Transforms[5].HasWorldChanged());
+        REQUIRE(Transforms[5].GetWorldMat()[3][1] == Catch::Approx(2.0f));
+        REQUIRE_FALSE(Transforms[4].HasWorldChanged());
+        REQUIRE_FALSE(Transforms[6].HasWorldChanged());
+    }
+}
+
+TEST_CASE("Transform Batch Benchmark", "[.][benchmark]")
+{
+    using namespace Fling;
+
+    JobSystem& Jobs = JobSystem::Get();
+    Jobs.Init();
+
+    for (uint32 Count : { 1000u, 100000u, 1000000u })
+    {
+        std::vector<Transform> Transforms = MakeRandomTransforms(Count);
+        const std::string Suffix = " (" + std::to_string(Count) + ")";
+
+        BENCHMARK("Euler angles, one at a time" + Suffix)
+        {
+            for (Transform& Trans : Transforms)
+            {
+                Trans.m_worldMat = Trans.GetWorldMatrix();
+            }
+            return Transforms[0].m_worldMat[0][0];
+        };
+
+        BENCHMARK("Quaternion batches, one thread" + Suffix)
+        {
+            for (Transform& Trans : Transforms)
+            {
+                Trans.MarkDirty();
+            }
+
+            Transform::CalculateWorldMatrices(Transforms.data(), Count);
+            return Transforms[0].m_worldMat[0][0];
+        };
+
+        BENCHMARK("Quaternion batches on the job system" + Suffix)
+        {
+            for (Transform& Trans : Transforms)
+            {
+                Trans.MarkDirty();
+            }
+
+            Transform* Data = Transforms.data();
+            Jobs.ParallelFor(Count, [Data](uint32 t_Begin, uint32 t_End)
+            {
+                Transform::CalculateWorldMatrices(Data + t_Begin, t_End - t_Begin);
+            }, 4096);
+            return Transforms[0].m_worldMat[0][0];
+        };
+    }
+
+    Jobs.Shutdown();
+}
+
+TEST_CASE("Transform Hierarchy", "[core]")
+{
+    using namespace Fling;
+
+    entt::registry Reg;
+    TransformHierarchy Hierarchies(Reg);
+
+    const entt::entity Parent = Reg.create();
+    const entt::entity Child = Reg.create();
+    const entt::entity GrandChild = Reg.create();
+    Reg.assign<Transform>(Parent).SetPos(glm::vec3(10.0f, 0.0f, 0.0f));
+    Reg.assign<Transform>(Child).SetPos(glm::vec3(1.0f, 0.0f, 0.0f));
+    Reg.assign<Transform>(GrandChild).SetPos(glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // Added in reverse so that the sort has to put the parents first
+    REQUIRE(Hierarchies.SetParent(GrandChild, Child));
+    REQUIRE(Hierarchies.SetParent(Child, Parent));
+    Hierarchies.UpdateWorldMatrices(Reg);
+
+    REQUIRE(Reg.get<Hierarchy>(GrandChild).Depth == 2);
+    REQUIRE(Reg.get<Hierarchy>(GrandChild).Root == Parent);
+    REQUIRE(Reg.get<Hierarchy>(Parent).ChildCount == 1);
+    REQUIRE(Reg.get<Transform>(GrandChild).GetWorldMat()[3][0] == Catch::Approx(11.0f));
+    REQUIRE(Reg.get<Transform>(GrandChild).GetWorldMat()[3][1] == Catch::Approx(1.0f));
+
+    SECTION("Moving a parent moves its children")
+    {
+        Reg.get<Transform>(Parent).SetPos(glm::vec3(0.0f, 0.0f, 5.0f));
+        Hierarchies.UpdateWorldMatrices(Reg);
+
+        REQUIRE(Reg.get<Transform>(GrandChild).HasWorldChanged());
+        REQUIRE(Reg.get<Transform>(GrandChild).GetWorldMat()[3][0] == Catch::Approx(1.0f));
+        REQUIRE(Reg.get<Transform>(GrandChild).GetWorldMat()[3][2] == Catch::Approx(5.0f));
+
+        // Nothing moved since
+        Hierarchies.UpdateWorldMatrices(Reg);
+        REQUIRE_FALSE(Reg.get<Transform>(GrandChild).HasWorldChanged());
+        REQUIRE(Reg.get<Transform>(GrandChild).GetWorldMat()[3][2] == Catch::Approx(5.0f));
+    }
+
+    SECTION("Loops are rejected")
+    {
+        // The rejection is logged
+        Logger::Get().Init();
+
+        REQUIRE_FALSE(Hierarchies.SetParent(Parent, GrandChild));
+        REQUIRE_FALSE(Hierarchies.SetParent(Child, Child));
+        REQUIRE(Reg.get<Hierarchy>(Parent).Parent == entt::null);
+    }
+
+    SECTION("Children of a destroyed parent become roots")
+    {
+        Reg.destroy(Child);
+        Hierarchies.UpdateWorldMatrices(Reg);
+
+        REQUIRE(Reg.get<Hierarchy>(GrandChild).Parent == entt::null);
+        REQUIRE(Reg.get<Hierarchy>(Parent).ChildCount == 0);
+        REQUIRE(Reg.get<Hierarchy>(Parent).FirstChild == entt::null);
+        REQUIRE(Reg.get<Transform>(GrandChild).GetWorldMat()[3][0] == Catch::Approx(0.0f));
+    }
+
+    SECTION("Children can be listed")
+    {
+        const entt::entity Sibling = Reg.create();
+        Reg.assign<Transform>(Sibling);
+        Hierarchies.SetParent(Sibling, Parent);
+
+        std::vector<entt::entity> Children;
+        Hierarchies.EachChild(Parent, [&Children](entt::entity t_Ent) { Children.push_back(t_Ent); });
+        REQUIRE(Children.size() == 2);
+        REQUIRE(std::find(Children.begin(), Children.end(), Child) != Children.end());
+        REQUIRE(std::find(Children.begin(), Children.end(), Sibling) != Children.end());
+    }
+}
+
+TEST_CASE("Light Clustering", "[core]")
+{
+    using namespace Fling;
+
+    const float Near = 0.1f;
+    const float Far = 100.0f;
+    const glm::mat4 Proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, Near, Far);
+    const glm::mat4 View = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    LightClusterGrid Grid(16, 9, 24);
+
+    // Cluster of a point in view space, found the same way as the lighting shader
+    auto ClusterOf = [&](const glm::vec3& t_ViewPos)
+    {
+        const float Depth = -t_ViewPos.z;
+        const float U = (t_ViewPos.x * Proj[0][0] / Depth + 1.0f) * 0.5f;
+        const float V = (1.0f - t_ViewPos.y * Proj[1][1] / Depth) * 0.5f;
+        const uint32 TileX = std::min(static_cast<uint32>(U * 16.0f), 15u);
+        const uint32 TileY = std::min(static_cast<uint32>(V * 9.0f), 8u);
+        return Grid.GetClusterIndex(TileX, TileY, Grid.GetSlice(Depth));
+    };
+
+    auto HasLight = [&](uint32 t_Cluster, uint32 t_Light)
+    {
+        const uint32* Lights = Grid.GetLights(t_Cluster);
+        return std::find(Lights, Lights + Grid.GetLightCount(t_Cluster), t_Light) != Lights + Grid.GetLightCount(t_Cluster);
+    };
+
+    SECTION("Every light is in the clusters of the points it reaches")
+    {
+        std::mt19937 Rand(7);
+        std::uniform_real_distribution<float> Dist(-1.0f, 1.0f);
+
+        std::vector<glm::vec4> Lights;
+        for (uint32 i = 0; i < 500; ++i)
+        {
+            Lights.emplace_back(Dist(Rand) * 20.0f, Dist(Rand) * 10.0f, Dist(Rand) * 20.0f - 21.0f, 1.0f + (Dist(Rand) + 1.0f) * 2.0f);
+        }
+        Grid.Build(View, Proj, Near, Far, Lights.data(), static_cast<uint32>(Lights.size()));
+
+        uint32 Checked = 0;
+        for (uint32 i = 0; i < static_cast<uint32>(Lights.size()); ++i)
+        {
+            for (uint32 Sample = 0; Sample < 16; ++Sample)
+            {
+                const glm::vec3 Offset = glm::vec3(Dist(Rand), Dist(Rand), Dist(Rand)) * (Lights[i].w * 0.57f);
+                const glm::vec3 Point = glm::vec3(Lights[i]) + Offset;
+                const glm::vec3 ViewPoint = glm::vec3(View * glm::vec4(Point, 1.0f));
+                if (-ViewPoint.z < Near || std::abs(ViewPoint.x * Proj[0][0]) > -ViewPoint.z || std::abs(ViewPoint.y * Proj[1][1]) > -ViewPoint.z)
+                {
+                    continue;
+                }
+
+                REQUIRE(HasLight(ClusterOf(ViewPoint), i));
+                ++Checked;
+            }
+        }
+        REQUIRE(Checked > 1000);
+    }
+
+    SECTION("Lights only touch the clusters around them")
+    {
+        // A small light on the left side of the screen, and one behind the camera
+        const glm::vec4 Lights[2] = { { -8.0f, 0.0f, -10.0f, 0.5f }, { 0.0f, 0.0f, 10.0f, 5.0f } };
+        Grid.Build(View, Proj, Near, Far, Lights, 2);
+
+        REQUIRE(HasLight(ClusterOf(glm::vec3(-8.0f, 0.0f, -10.0f)), 0));
+        REQUIRE_FALSE(HasLight(ClusterOf(glm::vec3(8.0f, 0.0f, -10.0f)), 0));
+        REQUIRE_FALSE(HasLight(ClusterOf(glm::vec3(-8.0f, 0.0f, -50.0f)), 0));
+
+        uint32 Total = 0;
+        for (uint32 Cluster = 0; Cluster < Grid.GetClusterCount(); ++Cluster)
+        {
+            REQUIRE_FALSE(HasLight(Cluster, 1));
+            Total += Grid.GetLightCount(Cluster);
+        }
+        REQUIRE(Total > 0);
+        REQUIRE(Grid.GetData().size() == Grid.GetClusterCount() * 2 + Total);
+    }
+}
+
+TEST_CASE("Draw Batch Table", "[core]")
+{
+    using namespace Fling;
+
+    DrawBatchTable Table;
+
+    // Objects with models 0-2 and materials 0-1, in no particular order, with one that isn't drawn
+    const uint32 Models[7] = { 2, 0, 1, 2, 0, 0, 1 };
+    const uint32 Materials[7] = { 1, 1, 0, 1, 0, 1, 0 };
+    for (uint32 i = 0; i < 7; ++i)
+    {
+        Table.Add(Models[i], Materials[i]);
+        if (i == 3)
+        {
+            Table.AddEmpty();
+        }
+    }
+    Table.Build();
+
+    const std::vector<DrawBatchTable::Batch>& Batches = Table.GetBatches();
+    REQUIRE(Table.GetObjectCount() == 8);
+    REQUIRE(Batches.size() == 4);
+    REQUIRE(Table.GetInstanceCount() == 7);
+    REQUIRE(Table.GetObjectBatch(4) == DrawBatchTable::INVALID_BATCH);
+
+    SECTION("Objects with the same model and material share a batch")
+    {
+        for (uint32 Object = 0; Object < Table.GetObjectCount(); ++Object)
+        {
+            const uint32 Batch = Table.GetObjectBatch(Object);
+            if (Batch == DrawBatchTable::INVALID_BATCH)
+            {
+                continue;
+            }
+            const uint32 i = Object < 4 ? Object : Object - 1;
+            REQUIRE(Batches[Batch].Model == Models[i]);
+            REQUIRE(Batches[Batch].Material == Materials[i]);
+        }
+        REQUIRE(Table.GetObjectBatch(0) == Table.GetObjectBatch(3));
+        REQUIRE(Table.GetObjectBatch(1) == Table.GetObjectBatch(6));
+    }
+
+    SECTION("Batches are sorted and their instances don't overlap")
+    {
+        uint32 Next = 0;
+        for (size_t i = 0; i < Batches.size(); ++i)
+        {
+            if (i > 0)
+            {
+                REQUIRE((Batches[i - 1].Material < Batches[i].Material ||
+                    (Batches[i - 1].Material == Batches[i].Material && Batches[i - 1].Model < Batches[i].Model)));
+            }
+            REQUIRE(Batches[i].FirstInstance == Next);
+            Next += Batches[i].ObjectCount;
+        }
+        REQUIRE(Next == Table.GetInstanceCount());
+    }
+
+    SECTION("Clear keeps nothing")
+    {
+        Table.Clear();
+        Table.Add(5, 5);
+        Table.Build();
+        REQUIRE(Table.GetBatches().size() == 1);
+        REQUIRE(Table.GetObjectBatch(0) == 0);
+        REQUIRE(Table.GetInstanceCount() == 1);
+    }
+}
+
+TEST_CASE("Static Mesh Merger", "[core]")
+{
+    using namespace Fling;
+
+    // A unit quad facing +Z, made of two triangles wound counter clockwise
+    std::vector<Vertex> QuadVerts(4);
+    QuadVerts[0].Pos = glm::vec3(0.0f, 0.0f, 0.0f);
+    QuadVerts[1].Pos = glm::vec3(1.0f, 0.0f, 0.0f);
+    QuadVerts[2].Pos = glm::vec3(1.0f, 1.0f, 0.0f);
+    QuadVerts[3].Pos = glm::vec3(0.0f, 1.0f, 0.0f);
+    for (Vertex& Vert : QuadVerts)
+    {
+        Vert.Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+        Vert.Tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+    }
+    const std::vector<uint32> QuadIndices = { 0, 1, 2, 2, 3, 0 };
+
+    auto MakeSource = [&](const glm::mat4& t_World, uint32 t_Material)
+    {
+        StaticMeshMerger::Source Src = {};
+        Src.Verts = QuadVerts.data();
+        Src.VertexCount = static_cast<uint32>(QuadVerts.size());
+        Src.Indices = QuadIndices.data();
+        Src.IndexCount = static_cast<uint32>(QuadIndices.size());
+        Src.World = t_World;
+        Src.Material = t_Material;
+        return Src;
+    };
+
+    SECTION("Meshes are merged by material and cell")
+    {
+        StaticMeshMerger Merger(10.0f);
+        Merger.Add(MakeSource(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f)), 0));
+        Merger.Add(MakeSource(glm::translate(glm::mat4(1.0f), glm::vec3(100.0f, 0.0f, 0.0f)), 0));
+        Merger.Add(MakeSource(glm::translate(glm::mat4(1.0f), glm::vec3(3.0f, 0.0f, 0.0f)), 1));
+        Merger.Add(MakeSource(glm::translate(glm::mat4(1.0f), glm::vec3(5.0f, 2.0f, 0.0f)), 0));
+        Merger.Build();
+
+        const std::vector<StaticMeshMerger::MergedMesh>& Meshes = Merger.GetMeshes();
+        REQUIRE(Meshes.size() == 3);
+
+        uint32 SourceCount = 0;
+        for (const StaticMeshMerger::MergedMesh& Mesh : Meshes)
+        {
+            REQUIRE(Mesh.Sources.size() == Mesh.SourceFirstIndex.size());
+            REQUIRE(Mesh.Verts.size() == Mesh.Sources.size() * QuadVerts.size());
+            REQUIRE(Mesh.Indices.size() == Mesh.Sources.size() * QuadIndices.size());
+            for (uint32 Index : Mesh.Indices)
+            {
+                REQUIRE(Index < Mesh.Verts.size());
+            }
+            SourceCount += static_cast<uint32>(Mesh.Sources.size());
+        }
+        REQUIRE(SourceCount == 4);
+
+        // The first and last sources share a material and a cell
+        const StaticMeshMerger::MergedMesh& First = Meshes[0];
+        REQUIRE(First.Material == 0);
+        REQUIRE(First.Sources == std::vector<uint32>{ 0, 3 });
+        REQUIRE(First.SourceFirstIndex == std::vector<uint32>{ 0, 6 });
+        REQUIRE(First.Verts[4].Pos == glm::vec3(5.0f, 2.0f, 0.0f));
+        REQUIRE(First.Indices[6] == 4);
+        REQUIRE(First.Bounds.Min == glm::vec3(1.0f, 0.0f, 0.0f));
+        REQUIRE(First.Bounds.Max == glm::vec3(6.0f, 3.0f, 0.0f));
+    }
+
+    SECTION("Normals are transformed and mirrored meshes keep their front faces")
+    {
+        StaticMeshMerger Merger(10.0f);
+        const glm::mat4 Offset = glm::translate(glm::mat4(1.0f), glm::vec3(5.0f));
+        const glm::mat4 Mirror = glm::scale(Offset, glm::vec3(-2.0f, 1.0f, 1.0f));
+        const glm::mat4 Turn = glm::rotate(Offset, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        Merger.Add(MakeSource(Mirror, 0));
+        Merger.Add(MakeSource(Turn, 0));
+        Merger.Build();
+
+        REQUIRE(Merger.GetMeshes().size() == 1);
+        const StaticMeshMerger::MergedMesh& Mesh = Merger.GetMeshes()[0];
+
+        for (size_t Tri = 0; Tri < Mesh.Indices.size(); Tri += 3)
+        {
+            const Vertex& A = Mesh.Verts[Mesh.Indices[Tri + 0]];
+            const Vertex& B = Mesh.Verts[Mesh.Indices[Tri + 1]];
+            const Vertex& C = Mesh.Verts[Mesh.Indices[Tri + 2]];
+
+            const glm::vec3 FaceNormal = glm::cross(B.Pos - A.Pos, C.Pos - A.Pos);
+            REQUIRE(glm::dot(FaceNormal, A.Normal) > 0.0f);
+            REQUIRE(glm::length(A.Normal) == Catch::Approx(1.0f));
+            REQUIRE(glm::length(A.Tangent) == Catch::Approx(1.0f));
+            REQUIRE(glm::abs(glm::dot(A.Normal, A.Tangent)) < 0.0001f);
+        }
+    }
+
+    SECTION("Merged meshes are split at the most vertices")
+    {
+        StaticMeshMerger Merger(10.0f, 8);
+        for (uint32 i = 0; i < 5; ++i)
+        {
+            Merger.Add(MakeSource(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, static_cast<float>(i))), 0));
+        }
+        Merger.Build();
+
+        REQUIRE(Merger.GetMeshes().size() == 3);
+        for (const StaticMeshMerger::MergedMesh& Mesh : Merger.GetMeshes())
+        {
+            REQUIRE(Mesh.Verts.size() <= 8);
+        }
+
+        Merger.Clear();
+        Merger.Build();
+        REQUIRE(Merger.GetMeshes().empty());
+        REQUIRE(Merger.GetSourceCount() == 0);
+    }
+}
@@ -0,0 +1,204 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch_all.hpp>
+
+#include "pch.h"
+#include "JobSystem.h"
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+
+TEST_CASE("Job System", "[foundation]")
+{
+    using namespace Fling;
+
+    JobSystem& Jobs = JobSystem::Get();
+
+    SECTION("Runs inline without workers")
+    {
+        REQUIRE_FALSE(Jobs.IsInitialized());
+        REQUIRE(Jobs.GetWorkerCount() == 1);
+
+        uint32 Total = 0;
+        Jobs.ParallelFor(100, [&Total](uint32 t_Begin, uint32 t_End) { Total += t_End - t_Begin; });
+        REQUIRE(Total == 100);
+
+        bool bRan = false;
+        Jobs.Run(Jobs.CreateJob([&bRan]() { bRan = true; }));
+        REQUIRE(bRan);
+    }
+
+    // More workers than this machine may have cores so that stealing is always exercised
+    Jobs.Init(4);
+    REQUIRE(Jobs.IsInitialized());
+    REQUIRE(Jobs.GetWorkerCount() == 4);
+
+    SECTION("Parallel for covers every index once")
+    {
+        std::vector<uint32> Data(100000, 0);
+        Jobs.ParallelFor(static_cast<uint32>(Data.size()), [&Data](uint32 t_Begin, uint32 t_End)
+        {
+            for (uint32 i = t_Begin; i < t_End; ++i)
+            {
+                Data[i] += i;
+            }
+        });
+
+        bool bMatches = true;
+        for (uint32 i = 0; i < Data.size(); ++i)
+        {
+            bMatches &= (Data[i] == i);
+        }
+        REQUIRE(bMatches);
+    }
+
+    SECTION("Parents wait for children, then continuations run")
+    {
+        std::atomic<uint32> ChildCount { 0 };
+        std::atomic<bool> bChildrenDone { false };
+
+        Job* Root = Jobs.CreateJob([]() {});
+        for (uint32 i = 0; i < 200; ++i)
+        {
+            Jobs.Run(Jobs.CreateChildJob(Root, [&ChildCount]() { ChildCount++; }));
+        }
+
+        Job* Continuation = Jobs.CreateJob([&ChildCount, &bChildrenDone]() { bChildrenDone = (ChildCount == 200); });
+        REQUIRE(Jobs.AddContinuation(Root, Continuation));
+
+        Jobs.Run(Root);
+        Jobs.Wait(Root);
+        REQUIRE(ChildCount == 200);
+
+        Jobs.Wait(Continuation);
+        REQUIRE(bChildrenDone);
+    }
+
+    SECTION("Counters track jobs from other threads")
+    {
+        JobCounter Counter;
+        std::atomic<uint32> Ran { 0 };
+
+        std::thread Producer([&Jobs, &Counter, &Ran]()
+        {
+            for (uint32 i = 0; i < 100; ++i)
+            {
+                Jobs.Run(Jobs.CreateJob([&Ran]() { Ran++; }), &Counter);
+            }
+        });
+        Producer.join();
+
+        Jobs.Wait(Counter);
+        REQUIRE(Counter.IsDone());
+        REQUIRE(Ran == 100);
+    }
+
+    SECTION("Job slots are only reused once their job is done")
+    {
+        // More jobs than fit in a ring at once, which used to overwrite jobs that were still queued
+        const uint32 JobCount = JobSystem::MAX_JOBS_PER_WORKER * 3 + 1;
+
+        JobCounter Counter;
+        std::atomic<uint32> Ran { 0 };
+        for (uint32 i = 0; i < JobCount; ++i)
+        {
+            Jobs.Run(Jobs.CreateJob([&Ran]() { Ran++; }), &Counter);
+        }
+        Jobs.Wait(Counter);
+        REQUIRE(Ran == JobCount);
+
+        // Asking for more chunks than the ring holds
+        std::atomic<uint32> Covered { 0 };
+        Jobs.ParallelFor(JobSystem::MAX_JOBS_PER_WORKER * 2 + 1, [&Covered](uint32 t_Begin, uint32 t_End) { Covered += t_End - t_Begin; }, 1);
+        REQUIRE(Covered == JobSystem::MAX_JOBS_PER_WORKER * 2 + 1);
+
+        std::atomic<uint32> SharedRan { 0 };
+        JobCounter SharedCounter;
+        std::thread Producer([&Jobs, &SharedCounter, &SharedRan, JobCount]()
+        {
+            for (uint32 i = 0; i < JobCount; ++i)
+            {
+                Jobs.Run(Jobs.CreateJob([&SharedRan]() { SharedRan++; }), &SharedCounter);
+            }
+        });
+        Producer.join();
+
+        Jobs.Wait(SharedCounter);
+        REQUIRE(SharedRan == JobCount);
+    }
+
+    Jobs.Shutdown();
+    REQUIRE_FALSE(Jobs.IsInitialized());
+}
+
+TEST_CASE("Radix Sort", "[foundation]")
+{
+    using namespace Fling;
+
+    // Checks against std::stable_sort so that the order of equal keys is tested too
+    auto SortMatches = [](std::vector<uint64> t_Keys)
+    {
+        const uint32 Count = static_cast<uint32>(t_Keys.size());
+
+        std::vector<uint32> Values(Count);
+        std::vector<uint32> Expected(Count);
+        for (uint32 i = 0; i < Count; ++i)
+        {
+            Values[i] = i;
+            Expected[i] = i;
+        }
+        std::stable_sort(Expected.begin(), Expected.end(), [&t_Keys](uint32 a, uint32 b) { return t_Keys[a] < t_Keys[b]; });
+
+        std::vector<uint64> TempKeys(Count);
+        std::vector<uint32> TempValues(Count);
+        RadixSort(t_Keys.data(), Values.data(), TempKeys.data(), TempValues.data(), Count);
+
+        return Values == Expected && std::is_sorted(t_Keys.begin(), t_Keys.end());
+    };
+
+    std::mt19937_64 Rng(1234);
+
+    SECTION("Empty and single keys")
+    {
+        REQUIRE(SortMatches({}));
+        REQUIRE(SortMatches({ 42 }));
+    }
+
+    SECTION("Random keys")
+    {
+        std::vector<uint64> Keys(1000);
+        for (uint64& Key : Keys)
+        {
+            Key = Rng();
+        }
+        REQUIRE(SortMatches(Keys));
+    }
+
+    SECTION("Many duplicate keys")
+    {
+        std::vector<uint64> Keys(1000);
+        for (uint64& Key : Keys)
+        {
+            Key = (Rng() % 8) << 40;
+        }
+        REQUIRE(SortMatches(Keys));
+    }
+
+    SECTION("Split across workers")
+    {
+        JobSystem& Jobs = JobSystem::Get();
+        Jobs.Init(4);
+
+        std::vector<uint64> Keys(100000);
+        for (uint64& Key : Keys)
+        {
+            Key = Rng() & 0xFFFF00FFFFFFull;
+        }
+        REQUIRE(SortMatches(Keys));
+
+        Jobs.Shutdown();
+    }
+}
@@ -7,8 +7,51 @@
 #include "FlingConfig.h"
 #include "ResourceManager.h"
 
+#include <atomic>
+
 // @see TestConf.ini
 
+namespace
+{
+    /** Text file resource that can be decoded on a loader thread */
+    class TextResource : public Fling::Resource
+    {
+    public:
+        struct LoadData
+        {
+            std::string Text;
+        };
+
+        static std::unique_ptr<LoadData> Decode(Fling::Guid t_ID)
+        {
+            ++DecodeCount;
+            std::unique_ptr<LoadData> Data = std::make_unique<LoadData>();
+            std::ifstream File(Fling::Resource::GetFilepathReleativeToAssets(t_ID));
+            std::getline(File, Data->Text, '\0');
+            return Data;
+        }
+
+        explicit TextResource(Fling::Guid t_ID)
+            : TextResource(t_ID, Decode(t_ID))
+        {
+        }
+
+        TextResource(Fling::Guid t_ID, std::unique_ptr<LoadData> t_Data)
+            : Fling::Resource(t_ID)
+            , Text(t_Data ? t_Data->Text : "")
+        {
+        }
+
+        virtual uint64 GetCpuMemoryUsage() const override { return Text.size(); }
+
+        std::string Text;
+
+        static std::atomic<int> DecodeCount;
+    };
+
+    std::atomic<int> TextResource::DecodeCount { 0 };
+}
+
 TEST_CASE("Engine Config File", "[resource]")
 {
     using namespace Fling;
@@ -58,4 +101,153 @@ TEST_CASE("Engine Config File", "[resource]")
     ResourceManager::Get().Shutdown();
     Logger::Get().Shutdown();
     FlingConfig::Get().Shutdown();
-}
\ No newline at end of file
+}
+
+TEST_CASE("Async Resource Loading", "[resource]")
+{
+    using namespace Fling;
+    Logger::Get().Init();
+    ResourceManager::Get().Init();
+    FlingConfig::Get().Init();
+
+    TextResource::DecodeCount = 0;
+
+    SECTION("Requests for the same file share one load")
+    {
+        int CallbackCount = 0;
+        std::shared_ptr<TextResource> First;
+        std::shared_ptr<TextResource> Second;
+
+        AsyncResource<TextResource> Handle = ResourceManager::LoadResourceAsync<TextResource>("TestFile.txt",
+            [&](std::shared_ptr<TextResource> t_Res) { First = t_Res; ++CallbackCount; });
+        ResourceManager::LoadResourceAsync<TextResource>("TestFile.txt",
+            [&](std::shared_ptr<TextResource> t_Res) { Second = t_Res; ++CallbackCount; });
+
+        ResourceManager::Get().WaitForPendingLoads();
+
+        REQUIRE(Handle.IsReady());
+        REQUIRE(CallbackCount == 2);
+        REQUIRE(First != nullptr);
+        REQUIRE(First == Second);
+        REQUIRE(First == Handle.Get());
+        REQUIRE_FALSE(First->Text.empty());
+        REQUIRE(TextResource::DecodeCount == 1);
+        REQUIRE(ResourceManager::Get().GetPendingLoadCount() == 0);
+    }
+
+    SECTION("Blocking load joins an async load")
+    {
+        bool bCalledBack = false;
+        AsyncResource<TextResource> Handle = ResourceManager::LoadResourceAsync<TextResource>("TestFile.txt",
+            [&](std::shared_ptr<TextResource>) { bCalledBack = true; });
+
+        std::shared_ptr<TextResource> Res = ResourceManager::LoadResource<TextResource>("TestFile.txt");
+        REQUIRE(Res != nullptr);
+        REQUIRE(Handle.Get() == Res);
+        REQUIRE(TextResource::DecodeCount == 1);
+        REQUIRE(bCalledBack);
+    }
+
+    SECTION("Already loaded resources call back on Update")
+    {
+        std::shared_ptr<TextResource> Res = ResourceManager::LoadResource<TextResource>("TestFile.txt");
+
+        std::shared_ptr<TextResource> FromCallback;
+        ResourceManager::LoadResourceAsync<TextResource>("TestFile.txt",
+            [&](std::shared_ptr<TextResource> t_Res) { FromCallback = t_Res; });
+        REQUIRE(FromCallback == nullptr);
+
+        ResourceManager::Get().Update();
+        REQUIRE(FromCallback == Res);
+        REQUIRE(TextResource::DecodeCount == 1);
+    }
+
+    ResourceManager::Get().Shutdown();
+    Logger::Get().Shutdown();
+    FlingConfig::Get().Shutdown();
+}
+
+TEST_CASE("Resource Handles", "[resource]")
+{
+    using namespace Fling;
+    Logger::Get().Init();
+    ResourceManager::Get().Init();
+    FlingConfig::Get().Init();
+
+    SECTION("Handles count references")
+    {
+        Handle<TextResource> First = ResourceManager::LoadHandle<TextResource>("TestFile.txt");
+        REQUIRE(First);
+
+        Handle<TextResource> Second = First;
+        REQUIRE(Second == First);
+        REQUIRE(Second.Get() == First.Get());
+
+        First.Reset();
+        REQUIRE_FALSE(First);
+        REQUIRE(Second);
+        REQUIRE_FALSE(Second->Text.empty());
+    }
+
+    SECTION("Unreferenced resources are unloaded over budget")
+    {
+        Handle<TextResource> Res = ResourceManager::LoadHandle<TextResource>("TestFile.txt");
+        REQUIRE(ResourceManager::Get().GetCpuMemoryUsage() > 0);
+
+        // Anything with a handle stays loaded no matter the budget
+        ResourceManager::Get().SetMemoryBudget(1, 0);
+        for (int i = 0; i < 10; ++i)
+        {
+            ResourceManager::Get().Update();
+        }
+        REQUIRE(ResourceManager::Get().IsLoaded(HS("TestFile.txt")));
+
+        // Frames in flight get a chance to finish with it before it goes
+        Res.Reset();
+        ResourceManager::Get().Update();
+        REQUIRE(ResourceManager::Get().IsLoaded(HS("TestFile.txt")));
+
+        for (int i = 0; i < 10; ++i)
+        {
+            ResourceManager::Get().Update();
+        }
+        REQUIRE_FALSE(ResourceManager::Get().IsLoaded(HS("TestFile.txt")));
+        REQUIRE(ResourceManager::Get().GetCpuMemoryUsage() == 0);
+        REQUIRE(ResourceManager::Get().GetEvictionCount() > 0);
+
+        ResourceManager::Get().SetMemoryBudget(0, 0);
+    }
+
+    SECTION("Outside shared_ptr's keep a resource loaded")
+    {
+        std::shared_ptr<TextResource> Res = ResourceManager::LoadResource<TextResource>("TestFile.txt");
+
+        ResourceManager::Get().SetMemoryBudget(1, 0);
+        for (int i = 0; i < 10; ++i)
+        {
+            ResourceManager::Get().Update();
+        }
+        REQUIRE(ResourceManager::Get().IsLoaded(HS("TestFile.txt")));
+
+        ResourceManager::Get().SetMemoryBudget(0, 0);
+    }
+
+    SECTION("Handles go stale when the resource is unloaded")
+    {
+        Handle<TextResource> Res = ResourceManager::LoadHandle<TextResource>("TestFile.txt");
+        REQUIRE(Res);
+
+        ResourceManager::Get().Shutdown();
+        REQUIRE_FALSE(Res);
+
+        // Reusing the slot must not bring the old handle back to life
+        Handle<TextResource> Reloaded = ResourceManager::LoadHandle<TextResource>("TestFile.txt");
+        REQUIRE(Reloaded);
+        REQUIRE_FALSE(Res);
+        REQUIRE(Res != Reloaded);
+    }
+
+    ResourceManager::Get().Shutdown();
+    Logger::Get().Shutdown();
+    FlingConfig::Get().Shutdown();
+}
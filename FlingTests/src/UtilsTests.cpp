@@ -12,6 +12,15 @@
 #include "StackAllocator.h"
 #include "Memory.h"
 #include "CircularBuffer.hpp"
+#include "TlsfAllocator.h"
+#include "ConcurrentHashMap.hpp"
+#include "Profiler.h"
+#include "Stats.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
 
 TEST_CASE("Timing", "[utils]")
 {
@@ -105,4 +114,278 @@ TEST_CASE("Circular Buffer", "[utils]")
     // Circular buffer of char's 
     Fling::CircularBuffer<int32, 128> CircBuf {};
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("TLSF Allocator", "[utils]")
+{
+    using namespace Fling;
+
+    TlsfAllocator Tlsf(1024);
+    REQUIRE(Tlsf.IsEmpty());
+    REQUIRE(Tlsf.GetFreeBytes() == 1024);
+
+    SECTION("Allocate and free")
+    {
+        TlsfAllocator::Allocation A = Tlsf.Allocate(100);
+        TlsfAllocator::Allocation B = Tlsf.Allocate(200);
+        REQUIRE(A.IsValid());
+        REQUIRE(B.IsValid());
+        REQUIRE(A.Offset != B.Offset);
+        REQUIRE(Tlsf.GetAllocationCount() == 2);
+        REQUIRE(Tlsf.GetUsedBytes() >= 300);
+
+        Tlsf.Free(A);
+        Tlsf.Free(B);
+        REQUIRE(Tlsf.IsEmpty());
+
+        // Everything should be merged back into one region
+        REQUIRE(Tlsf.GetFreeRegionCount() == 1);
+        REQUIRE(Tlsf.GetLargestFreeRegion() == 1024);
+    }
+
+    SECTION("Alignment")
+    {
+        TlsfAllocator::Allocation A = Tlsf.Allocate(3);
+        TlsfAllocator::Allocation B = Tlsf.Allocate(64, 256);
+        REQUIRE(A.IsValid());
+        REQUIRE(B.IsValid());
+        REQUIRE(B.Offset % 256 == 0);
+
+        Tlsf.Free(B);
+        Tlsf.Free(A);
+        REQUIRE(Tlsf.GetLargestFreeRegion() == 1024);
+    }
+
+    SECTION("Out of space")
+    {
+        TlsfAllocator::Allocation A = Tlsf.Allocate(1024);
+        REQUIRE(A.IsValid());
+        REQUIRE(Tlsf.GetFreeBytes() == 0);
+        REQUIRE_FALSE(Tlsf.Allocate(1).IsValid());
+
+        Tlsf.Free(A);
+        REQUIRE_FALSE(Tlsf.Allocate(2048).IsValid());
+    }
+
+    SECTION("Holes are reused")
+    {
+        TlsfAllocator::Allocation A = Tlsf.Allocate(256);
+        TlsfAllocator::Allocation B = Tlsf.Allocate(256);
+        TlsfAllocator::Allocation C = Tlsf.Allocate(256);
+        Tlsf.Free(B);
+        REQUIRE(Tlsf.GetFreeRegionCount() == 2);
+
+        TlsfAllocator::Allocation D = Tlsf.Allocate(256);
+        REQUIRE(D.IsValid());
+        REQUIRE(D.Offset == B.Offset);
+
+        Tlsf.Free(A);
+        Tlsf.Free(C);
+        Tlsf.Free(D);
+        REQUIRE(Tlsf.GetFreeRegionCount() == 1);
+    }
+
+    SECTION("Empty allocator packs allocations in order")
+    {
+        // The mesh arena compacts by allocating every mesh again out of an empty allocator
+        uint64 Expected = 0;
+        for (uint64 Size : { 7ull, 100ull, 1ull, 300ull, 16ull })
+        {
+            TlsfAllocator::Allocation A = Tlsf.Allocate(Size);
+            REQUIRE(A.IsValid());
+            REQUIRE(A.Offset == Expected);
+            Expected += Tlsf.GetAllocationSize(A);
+        }
+        REQUIRE(Tlsf.GetFreeRegionCount() == 1);
+    }
+}
+
+TEST_CASE("Concurrent Hash Map", "[utils]")
+{
+    using namespace Fling;
+
+    ConcurrentHashMap<uint32, int32> Map(8);
+    REQUIRE(Map.Size() == 0);
+
+    SECTION("Insert, find and erase")
+    {
+        Map.Insert(42, 1);
+        Map.Insert(42, 2);
+        REQUIRE(Map.Size() == 1);
+
+        int32 Value = 0;
+        REQUIRE(Map.Find(42, Value));
+        REQUIRE(Value == 2);
+        REQUIRE_FALSE(Map.Contains(7));
+
+        int32 Existing = 0;
+        REQUIRE_FALSE(Map.InsertIfAbsent(42, 3, Existing));
+        REQUIRE(Existing == 2);
+
+        REQUIRE(Map.Erase(42));
+        REQUIRE_FALSE(Map.Erase(42));
+        REQUIRE_FALSE(Map.Contains(42));
+        REQUIRE(Map.Size() == 0);
+    }
+
+    SECTION("Grows past its initial capacity")
+    {
+        for (uint32 i = 0; i < 1000; ++i)
+        {
+            Map.Insert(i * 8, static_cast<int32>(i));
+        }
+        REQUIRE(Map.Size() == 1000);
+
+        for (uint32 i = 0; i < 1000; ++i)
+        {
+            int32 Value = -1;
+            REQUIRE(Map.Find(i * 8, Value));
+            REQUIRE(Value == static_cast<int32>(i));
+        }
+    }
+
+    SECTION("Tombstones are reused")
+    {
+        // Keys that all collide, so every erase leaves a tombstone in the same probe
+        for (uint32 i = 0; i < 100; ++i)
+        {
+            Map.Insert(i * 64, 1);
+            Map.Insert(i * 64 + 64, 2);
+            REQUIRE(Map.Erase(i * 64));
+        }
+        REQUIRE(Map.Size() == 1);
+        REQUIRE(Map.Contains(100 * 64));
+    }
+
+    SECTION("Readers while writing")
+    {
+        for (uint32 i = 0; i < 64; ++i)
+        {
+            Map.Insert(i, static_cast<int32>(i));
+        }
+
+        std::atomic<bool> bFailed { false };
+        std::vector<std::thread> Readers;
+        for (uint32 t = 0; t < 4; ++t)
+        {
+            Readers.emplace_back([&Map, &bFailed]()
+            {
+                for (uint32 Iter = 0; Iter < 1000; ++Iter)
+                {
+                    int32 Value = -1;
+                    const uint32 Key = Iter % 64;
+                    if (!Map.Find(Key, Value) || Value != static_cast<int32>(Key))
+                    {
+                        bFailed = true;
+                    }
+                }
+            });
+        }
+
+        // Writes that force the map to grow while the readers are running
+        for (uint32 i = 64; i < 2048; ++i)
+        {
+            Map.Insert(i, static_cast<int32>(i));
+        }
+
+        for (std::thread& Reader : Readers)
+        {
+            Reader.join();
+        }
+
+        REQUIRE_FALSE(bFailed);
+        REQUIRE(Map.Size() == 2048);
+    }
+}
+
+TEST_CASE("Profiler", "[utils]")
+{
+    using namespace Fling;
+
+    Profiler& Prof = Profiler::Get();
+    Prof.SetEnabled(true);
+    Prof.NewFrame();
+
+    {
+        ProfileScope Outer("Outer");
+        {
+            ProfileScope Inner("Inner");
+        }
+    }
+
+    std::thread Worker([]()
+    {
+        Profiler::Get().SetThreadName("Profiler Test Worker");
+        for (uint32 i = 0; i < Profiler::EVENTS_PER_THREAD * 2; ++i)
+        {
+            ProfileScope Spin("Spin");
+        }
+    });
+    Worker.join();
+
+    Prof.NewFrame();
+
+    std::vector<ProfileThreadEvents> Threads;
+    uint64 FrameStart = 0;
+    uint64 FrameEnd = 0;
+    Prof.GetLastFrame(Threads, FrameStart, FrameEnd);
+    REQUIRE(FrameEnd > FrameStart);
+
+    SECTION("Zones are nested and kept per thread")
+    {
+        bool bFoundNested = false;
+        bool bFoundWorker = false;
+        for (const ProfileThreadEvents& Thread : Threads)
+        {
+            for (const ProfileEvent& Event : Thread.Events)
+            {
+                REQUIRE(Event.Start >= FrameStart);
+                REQUIRE(Event.End < FrameEnd);
+                bFoundNested |= (std::string(Event.Name) == "Inner" && Event.Depth == 1);
+            }
+
+            if (Thread.ThreadName == "Profiler Test Worker")
+            {
+                bFoundWorker = true;
+
+                // The oldest events were overwritten
+                REQUIRE(Thread.Events.size() == Profiler::EVENTS_PER_THREAD);
+            }
+        }
+        REQUIRE(bFoundNested);
+        REQUIRE(bFoundWorker);
+    }
+
+    SECTION("Chrome trace export")
+    {
+        const std::string TracePath = (std::filesystem::temp_directory_path() / "FlingProfilerTest.json").string();
+        REQUIRE(Prof.WriteChromeTrace(TracePath));
+
+        std::ifstream Trace(TracePath);
+        REQUIRE(Trace.is_open());
+        const std::string Contents((std::istreambuf_iterator<char>(Trace)), std::istreambuf_iterator<char>());
+        REQUIRE(Contents.find("\"traceEvents\"") != std::string::npos);
+        REQUIRE(Contents.find("\"name\":\"Outer\",\"ph\":\"X\"") != std::string::npos);
+        REQUIRE(Contents.find("Profiler Test Worker") != std::string::npos);
+    }
+}
+
+TEST_CASE("GPU Stats", "[utils]")
+{
+    using namespace Fling;
+
+    std::vector<Stats::GpuPass> Passes(2);
+    Passes[0].Name = "Offscreen";
+    Passes[0].TimeMs = 1.5f;
+    Passes[0].VertexInvocations = 300;
+    Passes[1].Name = "Geometry";
+    Passes[1].TimeMs = 0.5f;
+
+    Stats::Gpu::SetFrame(42, Passes);
+
+    REQUIRE(Stats::Gpu::GetFrameNumber() == 42);
+    REQUIRE(Stats::Gpu::GetPasses().size() == 2);
+    REQUIRE(Stats::Gpu::GetPasses()[0].Name == "Offscreen");
+    REQUIRE(Stats::Gpu::GetPasses()[0].VertexInvocations == 300);
+    REQUIRE(Stats::Gpu::GetFrameTimeMs() == 2.0f);
+}
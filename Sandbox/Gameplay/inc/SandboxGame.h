@@ -23,6 +23,9 @@ namespace Sandbox
 		*/
 		void Update(entt::registry& t_Reg, float DeltaTime) override final;
 
+		/** Adds the rotation and mover systems */
+		void RegisterSystems(Fling::SystemScheduler& t_Scheduler) override final;
+
 		/* Called when the engine is shutting down */
 		void OnStopGame(entt::registry& t_Reg) override final;
 
@@ -43,21 +43,37 @@ namespace Sandbox
 
     void Game::Update(entt::registry& t_Reg, float DeltaTime)
     {
-        if (m_DoRotations)
+        // Gameplay logic lives in the systems from RegisterSystems
+    }
+
+    void Game::RegisterSystems(SystemScheduler& t_Scheduler)
+    {
+        t_Scheduler.AddSystem("Rotators", [this](entt::registry& t_Reg, float DeltaTime)
         {
+            if (!m_DoRotations)
+            {
+                return;
+            }
+
             glm::vec3 RotOffset(0.0f, 15.0f * DeltaTime, 0.0f);
 
-            // For each active mesh renderer
-            t_Reg.view<Transform, Rotator>().each([&](auto ent, Transform& t_Trans, Rotator& t_MeshRend)
+            SystemScheduler::ParallelEach<Transform, Rotator>(t_Reg, [RotOffset](entt::entity ent, Transform& t_Trans, Rotator& t_Rotator)
             {
                 const glm::vec3& curRot = t_Trans.GetRotation();
                 t_Trans.SetRotation(curRot + RotOffset);
             });
-        }
+        })
+        .Reads<Rotator>()
+        .Writes<Transform>();
 
-        if (m_MovePointLights)
+        t_Scheduler.AddSystem("Movers", [this](entt::registry& t_Reg, float DeltaTime)
         {
-            t_Reg.view<Transform, Mover>().each([&](auto ent, Transform& t_Trans, Mover& t_Mover)
+            if (!m_MovePointLights)
+            {
+                return;
+            }
+
+            SystemScheduler::ParallelEach<Transform, Mover>(t_Reg, [DeltaTime](entt::entity ent, Transform& t_Trans, Mover& t_Mover)
             {
                 glm::vec3 curPos = t_Trans.GetPos();
 
@@ -73,7 +89,8 @@ namespace Sandbox
                 glm::vec3 newPos = glm::lerp(curPos, t_Mover.TargetPos,  t_Mover.Speed * DeltaTime);
                 t_Trans.SetPos(newPos);
             });
-        }
+        })
+        .Writes<Transform, Mover>();
     }
 
 	void Game::OnStopGame(entt::registry& t_Reg)